@@ -0,0 +1,413 @@
+#include "AssetArchive.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include "Lz4.h"
+#include "SimpleLogger.h"
+
+namespace
+{
+	// Small entries are not worth a thread per chunk
+	const uint32_t MinChunksPerThread = 2;
+
+	// A part of one file, compressed on a worker thread. Compressed stays empty when the chunk does not shrink.
+	struct ChunkJob
+	{
+		size_t File;
+		size_t Offset;
+		size_t Size;
+		std::vector<uint8_t> Compressed;
+	};
+
+	uint32_t GetChunkCount(uint64_t size)
+	{
+		return uint32_t((size + AssetArchive::ChunkSize - 1) / AssetArchive::ChunkSize);
+	}
+
+	size_t GetChunkSize(uint64_t size, uint32_t chunk)
+	{
+		return size_t(std::min(uint64_t(AssetArchive::ChunkSize), size - uint64_t(chunk) * AssetArchive::ChunkSize));
+	}
+
+	void WritePadding(std::ofstream& out, uint64_t& offset, uint64_t alignment)
+	{
+		static const char zeros[AssetArchive::Alignment] = {};
+		const uint64_t padding = (alignment - offset % alignment) % alignment;
+		out.write(zeros, std::streamsize(padding));
+		offset += padding;
+	}
+
+	// Calls function(index) for indices [0, count) on up to threadCount threads
+	template <typename Function>
+	void ParallelFor(size_t count, unsigned threadCount, const Function& function)
+	{
+		threadCount = unsigned(std::min<size_t>(threadCount, std::max<size_t>(1, count)));
+		std::atomic<size_t> next(0);
+		const auto work = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				function(i);
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < threadCount; ++t)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers) worker.join();
+	}
+}
+
+const char* const AssetArchive::DefaultName = "assets.pack";
+
+// All offsets are from the beginning of the file
+struct AssetArchive::Header
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EntryCount;
+	uint32_t ChunkCount;
+	uint64_t EntryOffset;
+	uint64_t ChunkOffset;
+	uint64_t NameOffset;
+	uint64_t NameSize;
+};
+
+std::string AssetArchive::NormalizePath(const std::string& path)
+{
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find_first_of("\\/", start);
+		if (end == std::string::npos) end = path.size();
+		std::string part = path.substr(start, end - start);
+		start = end + 1;
+
+		if (part.empty() || part == ".") continue;
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+		{
+			parts.pop_back();
+			continue;
+		}
+		for (char& c : part)
+			c = char(tolower(static_cast<unsigned char>(c)));
+		parts.push_back(part);
+	}
+
+	std::string result;
+	for (const std::string& part : parts)
+		result += (result.empty() ? "" : "/") + part;
+	return result;
+}
+
+uint64_t AssetArchive::HashPath(const std::string& normalizedPath)
+{
+	return HashData(normalizedPath.data(), normalizedPath.size());
+}
+
+bool AssetArchive::Build(const std::string& filename, const std::vector<std::string>& files, bool compress, unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// Every source stays mapped until the archive is written
+	std::vector<std::unique_ptr<MappedFile>> sources;
+	std::vector<std::string> names;
+	std::unordered_set<std::string> added;
+	std::vector<ArchiveEntry> entries;
+	for (const std::string& source : files)
+	{
+		const std::string name = NormalizePath(source);
+		if (!added.insert(name).second)
+		{
+			LOG_WARNING << "\"" << source << "\" is already in the archive as \"" << name << "\", skipped." << std::endl;
+			continue;
+		}
+
+		std::unique_ptr<MappedFile> mapped(new MappedFile());
+		if (!mapped->Open(source))
+		{
+			LOG_ERROR << "Failed to add \"" << source << "\" to archive \"" << filename << "\"." << std::endl;
+			return false;
+		}
+
+		ArchiveEntry entry = {};
+		entry.PathHash = HashPath(name);
+		entry.Size = mapped->GetSize();
+		entry.StoredSize = entry.Size;
+		entries.push_back(entry);
+		names.push_back(name);
+		sources.push_back(std::move(mapped));
+	}
+
+	std::vector<ChunkJob> jobs;
+	if (compress)
+	{
+		for (size_t f = 0; f != sources.size(); ++f)
+			for (uint32_t c = 0; c != GetChunkCount(entries[f].Size); ++c)
+				jobs.push_back({ f, size_t(c) * ChunkSize, GetChunkSize(entries[f].Size, c), {} });
+
+		ParallelFor(jobs.size(), threadCount, [&](size_t j)
+		{
+			ChunkJob& job = jobs[j];
+			job.Compressed.resize(Lz4::GetMaxCompressedSize(job.Size));
+			const size_t size = Lz4::Compress(sources[job.File]->GetData() + job.Offset, job.Size, job.Compressed.data(), job.Compressed.size());
+			job.Compressed.resize(size > 0 && size < job.Size ? size : 0);
+			job.Compressed.shrink_to_fit();
+		});
+	}
+
+	// Keep the compressed chunks of entries that shrink enough to be worth decompressing
+	std::vector<uint32_t> chunkSizes;
+	std::vector<const ChunkJob*> entryChunks(sources.size(), nullptr);
+	for (size_t j = 0; j != jobs.size();)
+	{
+		ArchiveEntry& entry = entries[jobs[j].File];
+		const uint32_t count = GetChunkCount(entry.Size);
+		uint64_t stored = 0;
+		for (uint32_t c = 0; c != count; ++c)
+			stored += jobs[j + c].Compressed.empty() ? jobs[j + c].Size : jobs[j + c].Compressed.size();
+
+		if (stored <= entry.Size - entry.Size / 8)
+		{
+			entry.StoredSize = stored;
+			entry.FirstChunk = uint32_t(chunkSizes.size());
+			entry.ChunkCount = count;
+			entryChunks[jobs[j].File] = &jobs[j];
+			for (uint32_t c = 0; c != count; ++c)
+				chunkSizes.push_back(uint32_t(jobs[j + c].Compressed.empty() ? jobs[j + c].Size : jobs[j + c].Compressed.size()));
+		}
+		j += count;
+	}
+
+	// Write to a temporary file first so a crash never leaves a half written archive behind
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			LOG_ERROR << "Failed to create archive \"" << filename << "\"." << std::endl;
+			return false;
+		}
+
+		Header header = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t offset = sizeof(header);
+		for (size_t f = 0; f != sources.size(); ++f)
+		{
+			WritePadding(out, offset, Alignment);
+			ArchiveEntry& entry = entries[f];
+			entry.Offset = offset;
+			if (const ChunkJob* chunk = entryChunks[f])
+			{
+				for (uint32_t c = 0; c != entry.ChunkCount; ++c, ++chunk)
+				{
+					if (chunk->Compressed.empty())
+						out.write(sources[f]->GetData() + chunk->Offset, std::streamsize(chunk->Size));
+					else
+						out.write(reinterpret_cast<const char*>(chunk->Compressed.data()), std::streamsize(chunk->Compressed.size()));
+				}
+			}
+			else
+				out.write(sources[f]->GetData(), std::streamsize(entry.Size));
+			offset += entry.StoredSize;
+		}
+
+		// The table of contents, sorted by path hash for Find
+		std::string nameTable;
+		for (size_t f = 0; f != sources.size(); ++f)
+		{
+			entries[f].NameOffset = uint32_t(nameTable.size());
+			entries[f].NameLength = uint32_t(names[f].size());
+			nameTable += names[f];
+		}
+		std::sort(entries.begin(), entries.end(), [](const ArchiveEntry& a, const ArchiveEntry& b) { return a.PathHash < b.PathHash; });
+
+		WritePadding(out, offset, sizeof(uint64_t));
+		header.EntryOffset = offset;
+		out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(ArchiveEntry)));
+		offset += entries.size() * sizeof(ArchiveEntry);
+		header.ChunkOffset = offset;
+		out.write(reinterpret_cast<const char*>(chunkSizes.data()), std::streamsize(chunkSizes.size() * sizeof(uint32_t)));
+		offset += chunkSizes.size() * sizeof(uint32_t);
+		header.NameOffset = offset;
+		header.NameSize = nameTable.size();
+		out.write(nameTable.data(), std::streamsize(nameTable.size()));
+
+		header.Magic = Magic;
+		header.Version = Version;
+		header.EntryCount = uint32_t(entries.size());
+		header.ChunkCount = uint32_t(chunkSizes.size());
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!out)
+		{
+			LOG_ERROR << "Failed to write archive \"" << filename << "\"." << std::endl;
+			out.close();
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		LOG_ERROR << "Failed to replace archive \"" << filename << "\"." << std::endl;
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+
+	uint64_t size = 0;
+	uint64_t stored = 0;
+	size_t compressed = 0;
+	for (const ArchiveEntry& entry : entries)
+	{
+		size += entry.Size;
+		stored += entry.StoredSize;
+		compressed += entry.ChunkCount != 0;
+	}
+	LOG_INFO << "Packed " << entries.size() << " files into \"" << filename << "\", " << compressed << " of them compressed: "
+		<< size << " -> " << stored << " bytes." << std::endl;
+	return true;
+}
+
+AssetArchive::AssetArchive()
+{
+	entries = nullptr;
+	entryCount = 0;
+	chunks = nullptr;
+	names = nullptr;
+}
+
+bool AssetArchive::Open(const std::string& filename)
+{
+	Close();
+
+	if (!file.Open(filename)) return false;
+
+	const uint64_t size = file.GetSize();
+	const Header* h = reinterpret_cast<const Header*>(file.GetData());
+	if (size < sizeof(Header) || h->Magic != Magic || h->Version != Version)
+	{
+		LOG_WARNING << "\"" << filename << "\" is not an asset archive of version " << Version << "." << std::endl;
+		Close();
+		return false;
+	}
+
+	const auto inside = [size](uint64_t offset, uint64_t bytes)
+	{
+		return offset <= size && bytes <= size - offset;
+	};
+	bool valid = h->EntryOffset % sizeof(uint64_t) == 0 && h->ChunkOffset % sizeof(uint32_t) == 0 &&
+		inside(h->EntryOffset, uint64_t(h->EntryCount) * sizeof(ArchiveEntry)) &&
+		inside(h->ChunkOffset, uint64_t(h->ChunkCount) * sizeof(uint32_t)) &&
+		inside(h->NameOffset, h->NameSize);
+	if (valid)
+	{
+		entries = reinterpret_cast<const ArchiveEntry*>(file.GetData() + h->EntryOffset);
+		entryCount = h->EntryCount;
+		chunks = reinterpret_cast<const uint32_t*>(file.GetData() + h->ChunkOffset);
+		names = file.GetData() + h->NameOffset;
+	}
+
+	// Read trusts every entry to lie inside the file and its chunks to add up
+	for (size_t i = 0; valid && i != entryCount; ++i)
+	{
+		const ArchiveEntry& e = entries[i];
+		valid = inside(e.Offset, e.StoredSize) && uint64_t(e.NameOffset) + e.NameLength <= h->NameSize &&
+			(i == 0 || entries[i - 1].PathHash <= e.PathHash);
+		if (!valid || e.ChunkCount == 0)
+		{
+			valid = valid && e.StoredSize == e.Size;
+			continue;
+		}
+
+		valid = e.ChunkCount == GetChunkCount(e.Size) && uint64_t(e.FirstChunk) + e.ChunkCount <= h->ChunkCount;
+		uint64_t stored = 0;
+		for (uint32_t c = 0; valid && c != e.ChunkCount; ++c)
+		{
+			valid = chunks[e.FirstChunk + c] <= GetChunkSize(e.Size, c);
+			stored += chunks[e.FirstChunk + c];
+		}
+		valid = valid && stored == e.StoredSize;
+	}
+
+	if (!valid)
+	{
+		LOG_WARNING << "Asset archive \"" << filename << "\" is corrupted." << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	file.Close();
+	entries = nullptr;
+	entryCount = 0;
+	chunks = nullptr;
+	names = nullptr;
+}
+
+const ArchiveEntry* AssetArchive::Find(const std::string& path) const
+{
+	const std::string name = NormalizePath(path);
+	const uint64_t hash = HashPath(name);
+	const ArchiveEntry* end = entries + entryCount;
+	for (const ArchiveEntry* e = std::lower_bound(entries, end, hash, [](const ArchiveEntry& a, uint64_t h) { return a.PathHash < h; });
+		e != end && e->PathHash == hash; ++e)
+	{
+		// Different paths with the same hash are told apart by name
+		if (e->NameLength == name.size() && memcmp(names + e->NameOffset, name.data(), name.size()) == 0)
+			return e;
+	}
+	return nullptr;
+}
+
+const char* AssetArchive::GetData(const ArchiveEntry& entry) const
+{
+	return entry.ChunkCount == 0 ? file.GetData() + entry.Offset : nullptr;
+}
+
+bool AssetArchive::Read(const ArchiveEntry& entry, char* output, unsigned threadCount) const
+{
+	const char* stored = file.GetData() + entry.Offset;
+	if (entry.ChunkCount == 0)
+	{
+		memcpy(output, stored, size_t(entry.Size));
+		return true;
+	}
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, std::max(1u, entry.ChunkCount / MinChunksPerThread));
+
+	std::vector<uint64_t> offsets(entry.ChunkCount);
+	for (uint32_t c = 1; c != entry.ChunkCount; ++c)
+		offsets[c] = offsets[c - 1] + chunks[entry.FirstChunk + c - 1];
+
+	std::atomic<bool> failed(false);
+	ParallelFor(entry.ChunkCount, threadCount, [&](size_t c)
+	{
+		const uint32_t storedSize = chunks[entry.FirstChunk + c];
+		const size_t size = GetChunkSize(entry.Size, uint32_t(c));
+		char* destination = output + c * ChunkSize;
+		if (storedSize == size)
+			memcpy(destination, stored + offsets[c], size);
+		else if (!Lz4::Decompress(stored + offsets[c], storedSize, destination, size))
+			failed = true;
+	});
+	return !failed;
+}
+
+std::string AssetArchive::GetName(const ArchiveEntry& entry) const
+{
+	return std::string(names + entry.NameOffset, entry.NameLength);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileSystem.h"
+
+// One file in an archive, found by the hash of its normalized path
+struct ArchiveEntry
+{
+	uint64_t PathHash;
+	// From the beginning of the archive, a multiple of AssetArchive::Alignment
+	uint64_t Offset;
+	uint64_t Size;
+	uint64_t StoredSize;
+	// Compressed entries are split into chunks of AssetArchive::ChunkSize bytes that decompress independently.
+	// ChunkCount is 0 for entries stored as they are.
+	uint32_t FirstChunk;
+	uint32_t ChunkCount;
+	uint32_t NameOffset;
+	uint32_t NameLength;
+};
+
+// Many asset files packed into one, so startup opens and maps a single file instead of dozens. The table of
+// contents at the end of the archive is sorted by path hash. Every entry starts on its own page, entries stored as
+// they are can be used in place in the mapping, and compressed ones are LZ4 chunks decompressed on several threads.
+class AssetArchive
+{
+public:
+	static const uint32_t Magic = 0x4b434150; // "PACK"
+	static const uint32_t Version = 1;
+	static const uint64_t Alignment = 4096;
+	static const uint32_t ChunkSize = 64 * 1024;
+	// "assets.pack" next to the executable, mounted at startup when it exists
+	static const char* const DefaultName;
+
+	// Lower case with '/' separators and no "." or ".." parts, how paths are hashed and stored
+	static std::string NormalizePath(const std::string& path);
+	static uint64_t HashPath(const std::string& normalizedPath);
+
+	// Pack files under the names they are given by. With compress set, entries are compressed where that saves at
+	// least an eighth of their size, on threadCount threads (0 picks one per core).
+	static bool Build(const std::string& filename, const std::vector<std::string>& files, bool compress, unsigned threadCount = 0);
+
+	AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	// Checks the table of contents and that every entry lies inside the file
+	bool Open(const std::string& filename);
+	void Close();
+	bool IsOpen() const { return file.IsOpen(); }
+
+	// nullptr when there is no such file
+	const ArchiveEntry* Find(const std::string& path) const;
+	// The entry's bytes in the mapping, or nullptr for a compressed entry
+	const char* GetData(const ArchiveEntry& entry) const;
+	// Copy or decompress an entry into output, which must hold entry.Size bytes. Chunks are spread over
+	// threadCount threads, 0 picks one per core. Does not log, loader threads call it.
+	bool Read(const ArchiveEntry& entry, char* output, unsigned threadCount = 0) const;
+
+	size_t GetEntryCount() const { return entryCount; }
+	const ArchiveEntry* GetEntries() const { return entries; }
+	std::string GetName(const ArchiveEntry& entry) const;
+
+private:
+	struct Header;
+
+	MappedFile file;
+	const ArchiveEntry* entries;
+	size_t entryCount;
+	// Stored size of every chunk, a chunk as large as its uncompressed size is stored as it is
+	const uint32_t* chunks;
+	const char* names;
+};
@@ -0,0 +1,183 @@
+#include "AssetCache.h"
+#include "SimpleLogger.h"
+
+AssetCache::AssetCache(size_t budget)
+	: budget(budget)
+{
+	leastRecent = NoEntry;
+	mostRecent = NoEntry;
+	stats = {};
+}
+
+std::shared_ptr<void> AssetCache::Acquire(const std::string& id)
+{
+	const auto found = entriesById.find(id);
+	if (found == entriesById.end())
+	{
+		++stats.Misses;
+		return nullptr;
+	}
+
+	++stats.Hits;
+	Entry& e = entries[found->second];
+	if (e.References++ == 0)
+	{
+		Unlink(found->second);
+		--stats.Unreferenced;
+	}
+	return e.Asset;
+}
+
+void AssetCache::Insert(const std::string& id, std::shared_ptr<void> asset, size_t cpuBytes, size_t gpuBytes)
+{
+	const auto found = entriesById.find(id);
+	if (found != entriesById.end())
+	{
+		Entry& e = entries[found->second];
+		if (e.References++ == 0)
+		{
+			Unlink(found->second);
+			--stats.Unreferenced;
+		}
+		return;
+	}
+
+	uint32_t entry;
+	if (!freeEntries.empty())
+	{
+		entry = freeEntries.back();
+		freeEntries.pop_back();
+	}
+	else
+	{
+		entry = uint32_t(entries.size());
+		entries.emplace_back();
+	}
+	entries[entry] = { true, id, std::move(asset), cpuBytes, gpuBytes, 1, NoEntry, NoEntry };
+	entriesById[id] = entry;
+	++stats.Assets;
+	stats.CpuBytes += cpuBytes;
+	stats.GpuBytes += gpuBytes;
+	Trim();
+}
+
+void AssetCache::Release(const std::string& id)
+{
+	const auto found = entriesById.find(id);
+	if (found == entriesById.end()) return;
+	Entry& e = entries[found->second];
+	if (e.References == 0)
+	{
+		LOG_WARNING << "AssetCache: \"" << id << "\" released more often than it was acquired." << std::endl;
+		return;
+	}
+	if (--e.References > 0) return;
+
+	LinkLast(found->second);
+	++stats.Unreferenced;
+	Trim();
+}
+
+void AssetCache::SetBudget(size_t b)
+{
+	budget = b;
+	Trim();
+}
+
+void AssetCache::EvictUnreferenced()
+{
+	while (leastRecent != NoEntry)
+		Evict(leastRecent);
+}
+
+int AssetCache::GetReferences(const std::string& id) const
+{
+	const auto found = entriesById.find(id);
+	return found == entriesById.end() ? 0 : entries[found->second].References;
+}
+
+void AssetCache::Unlink(uint32_t entry)
+{
+	Entry& e = entries[entry];
+	if (e.Previous != NoEntry) entries[e.Previous].Next = e.Next;
+	else leastRecent = e.Next;
+	if (e.Next != NoEntry) entries[e.Next].Previous = e.Previous;
+	else mostRecent = e.Previous;
+	e.Previous = NoEntry;
+	e.Next = NoEntry;
+}
+
+void AssetCache::LinkLast(uint32_t entry)
+{
+	Entry& e = entries[entry];
+	e.Previous = mostRecent;
+	e.Next = NoEntry;
+	if (mostRecent != NoEntry) entries[mostRecent].Next = entry;
+	else leastRecent = entry;
+	mostRecent = entry;
+}
+
+void AssetCache::Evict(uint32_t entry)
+{
+	Unlink(entry);
+	Entry& e = entries[entry];
+	entriesById.erase(e.Id);
+	--stats.Assets;
+	--stats.Unreferenced;
+	stats.CpuBytes -= e.CpuBytes;
+	stats.GpuBytes -= e.GpuBytes;
+	++stats.Evictions;
+	stats.EvictedBytes += e.CpuBytes + e.GpuBytes;
+	// Frees the asset unless somebody kept a pointer without a reference
+	e = { false, std::string(), nullptr, 0, 0, 0, NoEntry, NoEntry };
+	freeEntries.push_back(entry);
+}
+
+void AssetCache::Trim()
+{
+	while (leastRecent != NoEntry && stats.CpuBytes + stats.GpuBytes > budget)
+		Evict(leastRecent);
+}
+
+void AssetCache::LogStats() const
+{
+	const size_t lookups = stats.Hits + stats.Misses;
+	LOG_INFO << "AssetCache: " << stats.Assets << " assets (" << stats.Unreferenced << " unreferenced) holding " << stats.CpuBytes
+		<< " CPU and " << stats.GpuBytes << " GPU bytes of a " << budget << " byte budget, " << stats.Hits << " hits, " << stats.Misses
+		<< " misses (" << (lookups ? 100.0 * stats.Hits / lookups : 0.0) << "% hit rate), " << stats.Evictions << " evictions freeing "
+		<< stats.EvictedBytes << " bytes." << std::endl;
+}
+
+bool AssetCache::Validate() const
+{
+	size_t used = 0;
+	size_t listed = 0;
+	size_t cpuBytes = 0;
+	size_t gpuBytes = 0;
+	for (uint32_t entry = 0; entry != entries.size(); ++entry)
+	{
+		const Entry& e = entries[entry];
+		if (!e.Used) continue;
+		++used;
+		const auto found = entriesById.find(e.Id);
+		if (found == entriesById.end() || found->second != entry || e.References < 0) return false;
+		if (e.References == 0) ++listed;
+		cpuBytes += e.CpuBytes;
+		gpuBytes += e.GpuBytes;
+	}
+	if (used + freeEntries.size() != entries.size() || used != entriesById.size() || used != stats.Assets) return false;
+	if (listed != stats.Unreferenced || cpuBytes != stats.CpuBytes || gpuBytes != stats.GpuBytes) return false;
+	// Nothing evictable is left over the budget
+	if (listed != 0 && cpuBytes + gpuBytes > budget) return false;
+
+	// The recency list holds the unreferenced entries
+	size_t count = 0;
+	uint32_t previous = NoEntry;
+	for (uint32_t entry = leastRecent; entry != NoEntry; entry = entries[entry].Next)
+	{
+		const Entry& e = entries[entry];
+		if (++count > listed || !e.Used || e.References != 0 || e.Previous != previous) return false;
+		previous = entry;
+	}
+	return count == listed && previous == mostRecent;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct AssetCacheStats
+{
+	size_t Hits;
+	size_t Misses;
+	size_t Evictions;
+	size_t EvictedBytes;
+	// What is cached now, referenced or not
+	size_t Assets;
+	size_t Unreferenced;
+	size_t CpuBytes;
+	size_t GpuBytes;
+};
+
+// Loaded assets by ID with the CPU and GPU memory each holds. Acquire and Release count references; an asset nobody
+// references stays cached for the next Acquire, in a recency list least recently released first, and is evicted from
+// the front of it while the cache holds more than its budget. Referenced assets are never evicted, so what is in use
+// may exceed the budget on its own. Assets are type-erased shared_ptrs and evicting one drops the cache's pointer,
+// whatever it owns is freed by its own destructor. Pure bookkeeping, no device involved.
+class AssetCache
+{
+public:
+	// Bytes of CPU and GPU memory together
+	explicit AssetCache(size_t budget);
+
+	AssetCache(const AssetCache&) = delete;
+	AssetCache& operator=(const AssetCache&) = delete;
+
+	// The cached asset referenced once more, null on a miss
+	std::shared_ptr<void> Acquire(const std::string& id);
+	template<typename T>
+	std::shared_ptr<T> Acquire(const std::string& id) { return std::static_pointer_cast<T>(Acquire(id)); }
+	// Add a loaded asset referenced once, evicting down to the budget. An id that is cached already keeps the asset
+	// it has and is referenced once more instead.
+	void Insert(const std::string& id, std::shared_ptr<void> asset, size_t cpuBytes, size_t gpuBytes);
+	// One reference less. Unknown ids are ignored.
+	void Release(const std::string& id);
+
+	// Evicts down to the new budget
+	void SetBudget(size_t b);
+	size_t GetBudget() const { return budget; }
+	// Evict every asset nobody references
+	void EvictUnreferenced();
+
+	bool Contains(const std::string& id) const { return entriesById.count(id) != 0; }
+	int GetReferences(const std::string& id) const;
+	const AssetCacheStats& GetStats() const { return stats; }
+	void LogStats() const;
+
+	// Check the entries, the recency list and the byte counts agree, for tests and benchmarks
+	bool Validate() const;
+
+private:
+	static const uint32_t NoEntry = ~0u;
+
+	struct Entry
+	{
+		bool Used;
+		std::string Id;
+		std::shared_ptr<void> Asset;
+		size_t CpuBytes;
+		size_t GpuBytes;
+		int References;
+		// Recency list of unreferenced entries, least recently released first
+		uint32_t Previous;
+		uint32_t Next;
+	};
+
+	void Unlink(uint32_t entry);
+	void LinkLast(uint32_t entry);
+	void Evict(uint32_t entry);
+	// Evict least recently released assets while over the budget
+	void Trim();
+
+	size_t budget;
+	std::vector<Entry> entries;
+	std::vector<uint32_t> freeEntries;
+	std::unordered_map<std::string, uint32_t> entriesById;
+	uint32_t leastRecent;
+	uint32_t mostRecent;
+	AssetCacheStats stats;
+};
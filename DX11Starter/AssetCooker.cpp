@@ -0,0 +1,472 @@
+#include "AssetCooker.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "CookedMesh.h"
+#include "FileSystem.h"
+#include "ImageDecoder.h"
+#include "MeshCooker.h"
+#include "ObjParser.h"
+#include "SimpleLogger.h"
+#include "StreamingMeshCooker.h"
+#include "TextureCooker.h"
+
+const char* const AssetCooker::ManifestName = "cook.manifest";
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// A map as the MTL names it, relative to the model's folder like the loader resolves it
+	struct TextureMap
+	{
+		std::string Name;
+		TextureUsage Usage;
+	};
+
+	struct ArtifactRecord
+	{
+		uint64_t Key;
+		FileStamp Stamp;
+	};
+
+	// What the last cook saw
+	struct Manifest
+	{
+		std::unordered_map<std::string, FileStamp> Files;
+		// OBJ to the MTL it uses, empty for none
+		std::unordered_map<std::string, std::string> MtlLibs;
+		// MTL to the maps its materials use
+		std::unordered_map<std::string, std::vector<TextureMap>> Maps;
+		std::unordered_map<std::string, ArtifactRecord> Artifacts;
+	};
+
+	std::string GetManifestHeader()
+	{
+		std::ostringstream header;
+		header << "cook\t" << AssetCooker::Version << "\t" << CookedMesh::Version << "\t" << TextureCooker::Version;
+		return header.str();
+	}
+
+	// One record per line, fields separated by tabs with paths last, since they may contain spaces.
+	// A manifest of other versions is ignored, everything it lists gets looked at again.
+	bool LoadManifest(const std::string& filename, Manifest& manifest)
+	{
+		std::ifstream in(filename);
+		std::string line;
+		if (!in || !std::getline(in, line) || line != GetManifestHeader()) return false;
+
+		while (std::getline(in, line))
+		{
+			std::istringstream fields(line);
+			std::string type;
+			std::getline(fields, type, '\t');
+			if (type == "file")
+			{
+				FileStamp stamp;
+				std::string path;
+				fields >> stamp.Size >> stamp.ModifiedTime;
+				fields.ignore(1);
+				std::getline(fields, path);
+				manifest.Files[path] = stamp;
+			}
+			else if (type == "obj")
+			{
+				std::string obj;
+				std::string mtl;
+				std::getline(fields, obj, '\t');
+				std::getline(fields, mtl);
+				manifest.MtlLibs[obj] = mtl;
+			}
+			else if (type == "mtl")
+			{
+				std::string mtl;
+				std::getline(fields, mtl);
+				manifest.Maps[mtl];
+			}
+			else if (type == "map")
+			{
+				int usage = 0;
+				std::string mtl;
+				std::string name;
+				fields >> usage;
+				fields.ignore(1);
+				std::getline(fields, mtl, '\t');
+				std::getline(fields, name);
+				manifest.Maps[mtl].push_back({ name, TextureUsage(usage) });
+			}
+			else if (type == "artifact")
+			{
+				ArtifactRecord record;
+				std::string path;
+				fields >> record.Key >> record.Stamp.Size >> record.Stamp.ModifiedTime;
+				fields.ignore(1);
+				std::getline(fields, path);
+				manifest.Artifacts[path] = record;
+			}
+		}
+		return true;
+	}
+
+	bool SaveManifest(const std::string& filename, const Manifest& manifest)
+	{
+		// Write to a temporary file first so a crash never leaves a half written manifest behind
+		const std::string tempFilename = filename + ".tmp";
+		{
+			std::ofstream out(tempFilename, std::ios::trunc);
+			if (!out) return false;
+
+			out << GetManifestHeader() << "\n";
+			for (const auto& file : manifest.Files)
+				out << "file\t" << file.second.Size << "\t" << file.second.ModifiedTime << "\t" << file.first << "\n";
+			for (const auto& mtlLib : manifest.MtlLibs)
+				out << "obj\t" << mtlLib.first << "\t" << mtlLib.second << "\n";
+			for (const auto& maps : manifest.Maps)
+			{
+				out << "mtl\t" << maps.first << "\n";
+				for (const TextureMap& map : maps.second)
+					out << "map\t" << int(map.Usage) << "\t" << maps.first << "\t" << map.Name << "\n";
+			}
+			for (const auto& artifact : manifest.Artifacts)
+				out << "artifact\t" << artifact.second.Key << "\t" << artifact.second.Stamp.Size << "\t"
+					<< artifact.second.Stamp.ModifiedTime << "\t" << artifact.first << "\n";
+			if (!out)
+			{
+				out.close();
+				std::remove(tempFilename.c_str());
+				return false;
+			}
+		}
+
+		std::remove(filename.c_str());
+		if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+		{
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// A node of the graph with an artifact: a model, or an image as one usage
+	struct Asset
+	{
+		// The files the artifact is made from, the source first
+		std::vector<std::string> Inputs;
+		TextureUsage Usage;
+		uint64_t Key;
+		AssetReport Report;
+	};
+
+	const char* GetStateName(AssetState state)
+	{
+		switch (state)
+		{
+		case AssetUpToDate: return "Up to date";
+		case AssetVerified: return "Verified";
+		case AssetCooked: return "Cooked";
+		case AssetRaw: return "Not compressible";
+		default: return "FAILED";
+		}
+	}
+
+	// Textures run on worker threads: nothing here logs, and MappedFile is only opened on files that exist
+	class TextureCookJob
+	{
+	public:
+		TextureCookJob(std::vector<Asset>& textures, const std::vector<size_t>& stale)
+			: textures(textures), stale(stale), next(0), hashed(0)
+		{
+		}
+
+		void Work()
+		{
+			ImageDecoder decoder;
+			for (size_t n = next++; n < stale.size(); n = next++)
+			{
+				Asset& asset = textures[stale[n]];
+				const Clock::time_point start = Clock::now();
+				asset.Report.State = Cook(asset, decoder);
+				asset.Report.Seconds = SecondsSince(start);
+			}
+		}
+
+		size_t GetFilesHashed() const { return hashed; }
+
+	private:
+		AssetState Cook(Asset& asset, ImageDecoder& decoder)
+		{
+			const std::string& filename = asset.Inputs.front();
+			MappedFile source;
+			if (!FileExists(filename) || !source.Open(filename)) return AssetFailed;
+
+			// The key TextureManager checks the cooked file against
+			++hashed;
+			asset.Key = HashData(source.GetData(), source.GetSize(), uint64_t(asset.Usage));
+			{
+				MappedFile artifact;
+				if (FileExists(asset.Report.Artifact) && artifact.Open(asset.Report.Artifact)
+					&& TextureCooker::IsUpToDate(artifact.GetData(), artifact.GetSize(), asset.Key))
+					return AssetVerified;
+			}
+
+			// Copies of an image cooked under another name are only written again
+			std::shared_ptr<const std::vector<uint8_t>> dds;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				const auto found = cookedByKey.find(asset.Key);
+				if (found != cookedByKey.end()) dds = found->second;
+			}
+			if (!dds)
+			{
+				std::vector<uint8_t> pixels;
+				UINT width = 0;
+				UINT height = 0;
+				if (!decoder.Decode(source.GetData(), source.GetSize(), pixels, width, height)) return AssetFailed;
+
+				std::shared_ptr<std::vector<uint8_t>> cooked = std::make_shared<std::vector<uint8_t>>();
+				if (!TextureCooker::Cook(pixels.data(), width, height, asset.Usage, asset.Key, *cooked)) return AssetRaw;
+				dds = cooked;
+				std::lock_guard<std::mutex> lock(mutex);
+				cookedByKey.emplace(asset.Key, dds);
+			}
+			return TextureCooker::Write(asset.Report.Artifact, *dds) ? AssetCooked : AssetFailed;
+		}
+
+		std::vector<Asset>& textures;
+		const std::vector<size_t>& stale;
+		std::atomic<size_t> next;
+		std::atomic<size_t> hashed;
+
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::shared_ptr<const std::vector<uint8_t>>> cookedByKey;
+	};
+}
+
+bool AssetCooker::Cook(const std::string& folder, AssetCookResult& result, unsigned threadCount)
+{
+	const Clock::time_point start = Clock::now();
+	result = AssetCookResult();
+
+	const std::string manifestFilename = folder + PathSeparator + ManifestName;
+	Manifest previous;
+	if (!LoadManifest(manifestFilename, previous))
+		previous = Manifest();
+	Manifest next;
+
+	// Every input is looked at once per cook, and counts as unchanged when its stamp is the one of the last cook
+	const auto unchanged = [&](const std::string& filename)
+	{
+		auto stamp = next.Files.find(filename);
+		if (stamp == next.Files.end())
+		{
+			FileStamp current;
+			GetFileStamp(filename, current);
+			stamp = next.Files.emplace(filename, current).first;
+		}
+		const auto known = previous.Files.find(filename);
+		return known != previous.Files.end() && known->second == stamp->second;
+	};
+
+	// OBJ -> MTL -> texture maps, from the manifest where the files are unchanged
+	std::vector<Asset> meshes;
+	std::vector<Asset> textures;
+	std::unordered_map<std::string, size_t> texturesByPath;
+	for (const std::string& obj : ListFiles(folder, ".obj"))
+	{
+		const std::string modelFolder = GetFolder(obj);
+		const auto knownMtl = previous.MtlLibs.find(obj);
+		std::string mtl;
+		if (knownMtl != previous.MtlLibs.end() && unchanged(obj))
+			mtl = knownMtl->second;
+		else
+		{
+			MappedFile file;
+			if (FileExists(obj) && file.Open(obj))
+			{
+				const std::string mtlLib = ObjParser::FindMtlLib(file.GetData(), file.GetEnd());
+				if (!mtlLib.empty()) mtl = modelFolder + mtlLib;
+			}
+		}
+		next.MtlLibs[obj] = mtl;
+
+		Asset mesh = {};
+		mesh.Inputs.push_back(obj);
+		if (!mtl.empty()) mesh.Inputs.push_back(mtl);
+		mesh.Report = { obj, obj + ".cooked", AssetFailed, 0.0 };
+		if (mtl.empty())
+		{
+			meshes.push_back(mesh);
+			continue;
+		}
+
+		if (next.Maps.find(mtl) == next.Maps.end())
+		{
+			const auto knownMaps = previous.Maps.find(mtl);
+			std::vector<TextureMap>& maps = next.Maps[mtl];
+			if (knownMaps != previous.Maps.end() && unchanged(mtl))
+				maps = knownMaps->second;
+			else
+			{
+				MappedFile file;
+				std::vector<MtlMaterial> materials;
+				if (FileExists(mtl) && file.Open(mtl))
+					ObjParser::ParseMtl(file.GetData(), file.GetEnd(), materials);
+				for (const MtlMaterial& material : materials)
+				{
+					if (!material.DiffuseMap.empty()) maps.push_back({ material.DiffuseMap, TextureColor });
+					if (!material.NormalMap.empty()) maps.push_back({ material.NormalMap, TextureNormal });
+				}
+			}
+		}
+
+		// The maps go into the cooked mesh too, small ones are packed into its atlases
+		for (const TextureMap& map : next.Maps[mtl])
+			mesh.Inputs.push_back(modelFolder + map.Name);
+		meshes.push_back(mesh);
+
+		for (const TextureMap& map : next.Maps[mtl])
+		{
+			const std::string filename = modelFolder + map.Name;
+			if (!texturesByPath.emplace(filename, textures.size()).second) continue;
+
+			Asset texture = {};
+			texture.Inputs.push_back(filename);
+			texture.Usage = map.Usage;
+			texture.Report = { filename, filename + ".dds", AssetFailed, 0.0 };
+			textures.push_back(texture);
+		}
+	}
+
+	// Nothing to read when the inputs and the artifact all have the stamps of the last cook
+	const auto upToDate = [&](Asset& asset)
+	{
+		bool same = true;
+		for (const std::string& input : asset.Inputs)
+			same = unchanged(input) && same;
+		const auto record = previous.Artifacts.find(asset.Report.Artifact);
+		if (!same || record == previous.Artifacts.end()) return false;
+
+		FileStamp stamp;
+		GetFileStamp(asset.Report.Artifact, stamp);
+		if (stamp != record->second.Stamp) return false;
+		asset.Key = record->second.Key;
+		asset.Report.State = AssetUpToDate;
+		return true;
+	};
+
+	std::vector<size_t> staleTextures;
+	for (size_t i = 0; i != textures.size(); ++i)
+		if (!upToDate(textures[i])) staleTextures.push_back(i);
+
+	// Textures on the workers, meshes here, they are internally parallel and log
+	TextureCookJob textureJob(textures, staleTextures);
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = unsigned(std::min<size_t>(threadCount, staleTextures.size()));
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threadCount; ++t)
+		workers.emplace_back(&TextureCookJob::Work, &textureJob);
+
+	for (Asset& mesh : meshes)
+	{
+		if (upToDate(mesh)) continue;
+
+		const Clock::time_point meshStart = Clock::now();
+		const std::string& obj = mesh.Inputs.front();
+		std::vector<SourceStamp> stamps;
+		mesh.Key = CookedMesh::HashSources(obj, mesh.Inputs.size() > 1 ? mesh.Inputs[1] : "", &stamps);
+		result.FilesHashed += mesh.Inputs.size();
+
+		CookedMesh cooked;
+		if (FileExists(mesh.Report.Artifact) && cooked.Open(mesh.Report.Artifact) && cooked.GetSourceHash() == mesh.Key)
+			mesh.Report.State = AssetVerified;
+		else
+		{
+			cooked.Close();
+			// OBJs too large to cook in memory are streamed, the other meshes wait for them
+			FileStamp stamp;
+			StreamingCookStats stats;
+			MeshData data;
+			if (GetFileStamp(obj, stamp) && stamp.Size >= StreamingMeshCooker::Threshold)
+				mesh.Report.State = StreamingMeshCooker::Cook(obj, mesh.Report.Artifact, mesh.Key, StreamingMeshCooker::DefaultSettings(), stats, stamps)
+					? AssetCooked : AssetFailed;
+			else
+				mesh.Report.State = MeshCooker::CookObj(obj, data) && CookedMesh::Write(mesh.Report.Artifact, data, mesh.Key, stamps)
+					? AssetCooked : AssetFailed;
+		}
+		mesh.Report.Seconds = SecondsSince(meshStart);
+	}
+
+	for (std::thread& worker : workers) worker.join();
+	result.FilesHashed += textureJob.GetFilesHashed();
+
+	// Failed assets get no record and are looked at again next time
+	bool succeeded = true;
+	for (std::vector<Asset>* assets : { &meshes, &textures })
+		for (const Asset& asset : *assets)
+		{
+			result.Assets.push_back(asset.Report);
+			if (asset.Report.State == AssetFailed)
+			{
+				succeeded = false;
+				continue;
+			}
+			ArtifactRecord record = { asset.Key, {} };
+			GetFileStamp(asset.Report.Artifact, record.Stamp);
+			next.Artifacts[asset.Report.Artifact] = record;
+		}
+
+	if (!SaveManifest(manifestFilename, next))
+	{
+		LOG_WARNING << "Failed to write cook manifest \"" << manifestFilename << "\"." << std::endl;
+		succeeded = false;
+	}
+
+	result.Seconds = SecondsSince(start);
+	return succeeded;
+}
+
+void AssetCooker::LogResult(const AssetCookResult& result)
+{
+	std::vector<AssetReport> assets = result.Assets;
+	std::stable_sort(assets.begin(), assets.end(), [](const AssetReport& a, const AssetReport& b) { return a.Seconds > b.Seconds; });
+
+	size_t counts[AssetFailed + 1] = {};
+	for (const AssetReport& asset : assets)
+	{
+		++counts[asset.State];
+		if (asset.State == AssetFailed)
+			LOG_WARNING << GetStateName(asset.State) << " \"" << asset.Artifact << "\" from \"" << asset.Source << "\" in " << asset.Seconds * 1000.0 << " ms." << std::endl;
+		else
+			LOG_INFO << GetStateName(asset.State) << " \"" << asset.Artifact << "\" from \"" << asset.Source << "\" in " << asset.Seconds * 1000.0 << " ms." << std::endl;
+	}
+
+	LOG_INFO << "Cooked " << assets.size() << " assets in " << result.Seconds * 1000.0 << " ms: " << counts[AssetCooked] << " cooked, "
+		<< counts[AssetVerified] << " verified, " << counts[AssetUpToDate] << " up to date, " << counts[AssetRaw] << " not compressible, "
+		<< counts[AssetFailed] << " failed, " << result.FilesHashed << " files hashed." << std::endl;
+}
+
+std::vector<std::string> AssetCooker::ListAssets(const std::string& folder)
+{
+	const std::string manifestFilename = folder + PathSeparator + ManifestName;
+	std::vector<std::string> assets;
+	for (const std::string& file : ListFiles(folder, ""))
+	{
+		const bool temporary = file.size() > 4 && file.compare(file.size() - 4, 4, ".tmp") == 0;
+		if (!temporary && file != manifestFilename)
+			assets.push_back(file);
+	}
+	return assets;
+}
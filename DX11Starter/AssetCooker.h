@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum AssetState
+{
+	// Inputs and artifact untouched since the last cook, nothing was read
+	AssetUpToDate,
+	// Some file was touched, but hashing showed the artifact still matches its inputs
+	AssetVerified,
+	AssetCooked,
+	// The image cannot be block compressed, it is loaded as it is
+	AssetRaw,
+	AssetFailed,
+};
+
+struct AssetReport
+{
+	// The OBJ or image, and the file cooked from it
+	std::string Source;
+	std::string Artifact;
+	AssetState State;
+	double Seconds;
+};
+
+struct AssetCookResult
+{
+	std::vector<AssetReport> Assets;
+	// Files whose contents had to be read to hash them
+	size_t FilesHashed;
+	double Seconds;
+};
+
+// Offline cook of every model under a folder. The dependency graph goes from each OBJ to its MTL and on to the
+// texture maps the materials use; every artifact ("<model>.obj.cooked" and "<image>.dds") is keyed by the content
+// hash of its inputs, the same key the loaders check. A manifest next to the models remembers the size and write
+// time of every file at the last cook, so unchanged files are neither read nor hashed and a rebuild with nothing
+// to do only looks at file stamps. Textures are decoded and compressed on worker threads while meshes cook on
+// the calling thread.
+class AssetCooker
+{
+public:
+	// "cook.manifest" in the cooked folder
+	static const char* const ManifestName;
+	// Bump whenever the manifest layout changes. The cooker versions are stored in it as well.
+	static const uint32_t Version = 1;
+
+	// threadCount 0 picks one texture worker per core. Returns false if any asset failed.
+	static bool Cook(const std::string& folder, AssetCookResult& result, unsigned threadCount = 0);
+	// Every asset with its state and time, slowest first, then the totals
+	static void LogResult(const AssetCookResult& result);
+	// Every file under folder a build ships, sources and artifacts, without the manifest and leftover temporary files
+	static std::vector<std::string> ListAssets(const std::string& folder);
+};
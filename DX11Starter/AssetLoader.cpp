@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <chrono>
+#include "AssetLoader.h"
+#include "SimpleLogger.h"
+#include "Skybox.h"
+#include "VirtualFile.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// What the cache keeps of a model
+	struct CachedModel
+	{
+		std::vector<std::shared_ptr<Mesh>> Meshes;
+		std::vector<std::shared_ptr<BlinnPhongMaterial>> Materials;
+	};
+
+	std::string GetCacheId(const std::string& filename, VertexFormat vertexFormat)
+	{
+		return filename + "|" + std::to_string(int(vertexFormat));
+	}
+
+	bool ReadWhole(const std::string& filename, std::vector<char>& contents)
+	{
+		VirtualFile file;
+		if (!file.Open(filename)) return false;
+		contents.assign(file.GetData(), file.GetEnd());
+		return true;
+	}
+}
+
+AssetLoader::AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, GeometryArena* arena, TextureManager* textures, unsigned threadCount)
+{
+	this->device = device;
+	this->context = context;
+	this->arena = arena;
+	this->textures = textures;
+	cache = nullptr;
+	stopping = false;
+	busy = 0;
+	stats = {};
+
+	threadCount = std::max(1u, threadCount);
+	for (unsigned t = 0; t < threadCount; ++t)
+		workers.emplace_back(&AssetLoader::Work, this);
+
+	LOG_INFO << "AssetLoader created at <0x" << this << "> with " << threadCount << " load threads." << std::endl;
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	workAvailable.notify_all();
+	for (std::thread& worker : workers) worker.join();
+
+	// What the cache keeps stays there for the next loader
+	for (AssetHandle handle = 0; handle != AssetHandle(assets.size()); ++handle)
+		Release(handle);
+
+	LOG_INFO << "AssetLoader destroyed at <0x" << this << ">." << std::endl;
+}
+
+AssetHandle AssetLoader::LoadModel(const std::string& filename, VertexFormat vertexFormat)
+{
+	const AssetHandle handle = AssetHandle(assets.size());
+	const std::string cacheId = GetCacheId(filename, vertexFormat);
+	assets.push_back({ LoadQueued, filename, nullptr, {}, {}, {}, 0, cacheId, false, 0, 0 });
+	++stats.Queued;
+
+	const std::shared_ptr<CachedModel> cached = cache ? cache->Acquire<CachedModel>(cacheId) : nullptr;
+	if (cached)
+	{
+		Asset& asset = assets.back();
+		asset.State = LoadReady;
+		asset.Meshes = cached->Meshes;
+		asset.Materials = cached->Materials;
+		asset.Cached = true;
+		++stats.Ready;
+		++stats.Reused;
+		reused.push_back(handle);
+		return handle;
+	}
+	++busy;
+
+	// Reading starts now, while earlier models are prepared
+	Mesh::Preload(filename);
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.push_back({ handle, filename, "", vertexFormat });
+	workAvailable.notify_one();
+	return handle;
+}
+
+AssetHandle AssetLoader::LoadSkybox(Skybox* skybox, const std::string& cubemapFile, const std::string& irradianceFile)
+{
+	const AssetHandle handle = AssetHandle(assets.size());
+	assets.push_back({ LoadQueued, cubemapFile, skybox, {}, {}, {}, 0, std::string(), false, 0, 0 });
+	++stats.Queued;
+	++busy;
+
+	VirtualFile::Preload({ cubemapFile, irradianceFile });
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.push_back({ handle, cubemapFile, irradianceFile, VertexFormatFull });
+	workAvailable.notify_one();
+	return handle;
+}
+
+void AssetLoader::Work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (stopping) return;
+
+		const Job job = queue.front();
+		queue.pop_front();
+		lock.unlock();
+
+		const Clock::time_point start = Clock::now();
+		Completion completion = { job.Handle, false, nullptr, {}, {}, 0.0 };
+		if (job.IrradianceFilename.empty())
+		{
+			completion.Model.reset(new PreparedModel());
+			completion.Succeeded = Mesh::PrepareFile(job.Filename, job.Format, *completion.Model);
+		}
+		else
+		{
+			// A missing irradiance map leaves it empty, like the Skybox constructor does
+			completion.Succeeded = ReadWhole(job.Filename, completion.Cubemap);
+			ReadWhole(job.IrradianceFilename, completion.Irradiance);
+		}
+		completion.Seconds = SecondsSince(start);
+		completions.Push(std::move(completion));
+
+		lock.lock();
+	}
+}
+
+void AssetLoader::Update(std::vector<AssetHandle>& changed)
+{
+	const Clock::time_point start = Clock::now();
+
+	changed.insert(changed.end(), reused.begin(), reused.end());
+	reused.clear();
+
+	// Creating a model's buffers is the part that costs a frame, one per Update keeps that to one model
+	completions.PopAll(arrived);
+	if (!arrived.empty())
+	{
+		Completion completion = std::move(arrived.front());
+		arrived.pop_front();
+		stats.LoadSeconds += completion.Seconds;
+		Create(completion);
+		changed.push_back(completion.Handle);
+	}
+
+	if (textures) textures->Update();
+	for (size_t i = 0; i != assets.size(); ++i)
+	{
+		Asset& asset = assets[i];
+		if (asset.State != LoadPlaceholder || asset.TexturesRemaining > 0) continue;
+
+		for (size_t m = 0; m != asset.Meshes.size(); ++m)
+		{
+			const int32_t material = asset.MeshMaterials[m];
+			if (material >= 0)
+				asset.Meshes[m]->SetMaterial(asset.Materials[material]);
+		}
+		asset.State = LoadReady;
+		++stats.Ready;
+		--busy;
+		changed.push_back(AssetHandle(i));
+
+		if (cache)
+		{
+			cache->Insert(asset.CacheId, std::make_shared<CachedModel>(CachedModel{ asset.Meshes, asset.Materials }), asset.CpuBytes, asset.GpuBytes);
+			asset.Cached = true;
+		}
+	}
+
+	const double seconds = SecondsSince(start);
+	stats.UpdateSeconds += seconds;
+	stats.LongestUpdateSeconds = std::max(stats.LongestUpdateSeconds, seconds);
+}
+
+void AssetLoader::Create(Completion& completion)
+{
+	Asset& asset = assets[completion.Handle];
+	if (!completion.Succeeded)
+	{
+		LOG_WARNING << "AssetLoader: \"" << asset.Filename << "\" could not be loaded." << std::endl;
+		asset.State = LoadFailed;
+		++stats.Failed;
+		--busy;
+		return;
+	}
+
+	if (!completion.Model)
+	{
+		if (asset.Sky && device)
+			asset.Sky->LoadCubemaps(completion.Cubemap.data(), completion.Cubemap.size(),
+				completion.Irradiance.empty() ? nullptr : completion.Irradiance.data(), completion.Irradiance.size());
+		asset.State = LoadReady;
+		++stats.Ready;
+		--busy;
+		return;
+	}
+
+	// Waits for its textures in Update, even when it requested none
+	asset.State = LoadPlaceholder;
+	const PreparedModel& model = *completion.Model;
+	asset.CpuBytes = 0;
+	asset.GpuBytes = 0;
+	for (const PreparedSubmesh& submesh : model.Submeshes)
+	{
+		asset.CpuBytes += sizeof(Mesh) + submesh.Lods.size() * sizeof(MeshLod) + submesh.Clusters.size() * sizeof(MeshCluster);
+		asset.GpuBytes += submesh.Vertices.size() + submesh.Indices.size();
+	}
+	if (!device) return;
+
+	auto result = Mesh::CreateFromPrepared(model, device, context, arena, textures, &asset.TexturesRemaining);
+	asset.Meshes = std::move(result.first);
+	asset.Materials = std::move(result.second);
+	for (size_t m = 0; m != asset.Meshes.size(); ++m)
+	{
+		const int32_t material = model.Submeshes[m].Material;
+		asset.MeshMaterials.push_back(material >= 0 && size_t(material) < model.Materials.size() ? material : -1);
+		asset.Meshes[m]->SetMaterial(BlinnPhongMaterial::GetDefault());
+	}
+}
+
+void AssetLoader::Release(AssetHandle handle)
+{
+	Asset& asset = assets[handle];
+	asset.Meshes.clear();
+	asset.Materials.clear();
+	if (asset.Cached) cache->Release(asset.CacheId);
+	asset.Cached = false;
+}
+
+LoadState AssetLoader::GetState(AssetHandle handle) const
+{
+	return assets[handle].State;
+}
+
+const std::vector<std::shared_ptr<Mesh>>& AssetLoader::GetMeshes(AssetHandle handle) const
+{
+	return assets[handle].Meshes;
+}
+
+const std::vector<std::shared_ptr<BlinnPhongMaterial>>& AssetLoader::GetMaterials(AssetHandle handle) const
+{
+	return assets[handle].Materials;
+}
+
+bool AssetLoader::IsIdle() const
+{
+	return busy == 0;
+}
+
+void AssetLoader::LogStats() const
+{
+	LOG_INFO << "AssetLoader: " << stats.Ready << " of " << stats.Queued << " assets ready, " << stats.Reused << " of them from the cache, " << stats.Failed << " failed, "
+		<< stats.LoadSeconds * 1000.0 << " ms loading in the background, " << stats.UpdateSeconds * 1000.0
+		<< " ms on the render thread, at most " << stats.LongestUpdateSeconds * 1000.0 << " ms in a frame." << std::endl;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <d3d11.h>
+#include "AssetCache.h"
+#include "CompletionQueue.h"
+#include "Mesh.h"
+
+class Skybox;
+
+// A load queued on an AssetLoader
+typedef int AssetHandle;
+
+enum LoadState
+{
+	// Queued or on a loader thread
+	LoadQueued,
+	// Meshes are made and drawn with BlinnPhongMaterial::GetDefault() while the texture maps of their materials load
+	LoadPlaceholder,
+	LoadReady,
+	LoadFailed,
+};
+
+struct AssetLoaderStats
+{
+	size_t Queued;
+	size_t Ready;
+	// Ready at once from the cache
+	size_t Reused;
+	size_t Failed;
+	// Reading and preparing summed over the loader threads
+	double LoadSeconds;
+	// Spent in Update on the render thread, and the most of it a single frame paid
+	double UpdateSeconds;
+	double LongestUpdateSeconds;
+};
+
+// Loads models and skyboxes without stopping the frames. Load* returns a handle at once; loader threads read and
+// prepare the files and hand them back through a CompletionQueue, and Update, once a frame on the thread that owns
+// the context, makes the GPU resources of one of them. Models show with the default material until TextureManager
+// delivered the maps of all their materials, then get their own. Without a device models are only prepared, for
+// benchmarking. With an AssetCache, ready models are added to it and loading one again while it is cached takes it
+// from there, ready at once.
+class AssetLoader
+{
+public:
+	// textures has to outlive the loader, and not be updated after it while the models' maps are pending
+	AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, GeometryArena* arena, TextureManager* textures, unsigned threadCount = 1);
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	AssetHandle LoadModel(const std::string& filename, VertexFormat vertexFormat);
+	// The maps are created into skybox, which has to outlive the load
+	AssetHandle LoadSkybox(Skybox* skybox, const std::string& cubemapFile, const std::string& irradianceFile);
+	// Drop the meshes and materials of a model that is ready or failed, and its reference in the cache, which keeps
+	// it while the budget allows. The handle is not used after.
+	void Release(AssetHandle handle);
+
+	// Models are looked up in and added to cache, which has to outlive the loader. Set it before loading any.
+	void SetCache(AssetCache* c) { cache = c; }
+
+	// Take what the loader threads finished, create at most one of them and update textures. Appends every asset
+	// whose state changed to changed, possibly twice.
+	void Update(std::vector<AssetHandle>& changed);
+
+	LoadState GetState(AssetHandle handle) const;
+	// Once a model is past LoadQueued. Its meshes keep the default material until LoadReady.
+	const std::vector<std::shared_ptr<Mesh>>& GetMeshes(AssetHandle handle) const;
+	const std::vector<std::shared_ptr<BlinnPhongMaterial>>& GetMaterials(AssetHandle handle) const;
+	// Nothing queued, preparing or waiting for textures
+	bool IsIdle() const;
+
+	const AssetLoaderStats& GetStats() const { return stats; }
+	void LogStats() const;
+
+private:
+	struct Asset
+	{
+		LoadState State;
+		std::string Filename;
+		Skybox* Sky;
+		std::vector<std::shared_ptr<Mesh>> Meshes;
+		std::vector<std::shared_ptr<BlinnPhongMaterial>> Materials;
+		// Material index of every mesh, the one it gets once the maps are in
+		std::vector<int32_t> MeshMaterials;
+		// Texture maps requested and not delivered yet, counted by TextureManager
+		int TexturesRemaining;
+		// Key in the cache, and whether the asset holds a reference there
+		std::string CacheId;
+		bool Cached;
+		// Geometry the model keeps on the CPU and in the arena. Texture maps are shared between models by
+		// TextureManager and budgeted by TextureStreamer, they are not counted.
+		size_t CpuBytes;
+		size_t GpuBytes;
+	};
+
+	struct Job
+	{
+		AssetHandle Handle;
+		std::string Filename;
+		// Set for skyboxes
+		std::string IrradianceFilename;
+		VertexFormat Format;
+	};
+
+	struct Completion
+	{
+		AssetHandle Handle;
+		bool Succeeded;
+		std::unique_ptr<PreparedModel> Model;
+		std::vector<char> Cubemap;
+		std::vector<char> Irradiance;
+		double Seconds;
+	};
+
+	void Work();
+	// Make the GPU resources of a finished load
+	void Create(Completion& completion);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	GeometryArena* arena;
+	TextureManager* textures;
+	AssetCache* cache;
+
+	// Guards the jobs
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::deque<Job> queue;
+	bool stopping;
+	std::vector<std::thread> workers;
+
+	CompletionQueue<Completion> completions;
+	// Taken from completions, waiting for an Update of their own
+	std::deque<Completion> arrived;
+	// Found in the cache, reported by the next Update
+	std::vector<AssetHandle> reused;
+	// A deque, TextureManager counts down TexturesRemaining through pointers
+	std::deque<Asset> assets;
+	size_t busy;
+	AssetLoaderStats stats;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AssetRegistryStats
+{
+	size_t Published;
+	size_t Reclaimed;
+	// Replaced versions some reader may still see
+	size_t Pending;
+	uint64_t Epoch;
+};
+
+// The current version of every asset in a slot, read without locks while other threads publish new ones. Readers
+// bracket their reads with Enter and Exit, a frame on the render thread, a job on a worker, and every version they
+// Get in between stays valid until their Exit. Publishing swaps the slot's pointer atomically and retires the old
+// version stamped with the epoch; Reclaim, at a frame boundary, deletes the retired versions older than the epoch of
+// every reader still inside and moves the epoch on. A reader that saw a version entered at or before its stamp, so
+// once all of them are past it nobody can. A read is an atomic load, Enter and Exit a store each, and no reference
+// counts are touched.
+template<typename T>
+class AssetRegistry
+{
+public:
+	static const uint32_t NoSlot = ~0u;
+	static const int MaxReaders = 64;
+
+	// Slots are allocated once, readers never see the array move
+	explicit AssetRegistry(uint32_t capacity)
+		: slots(new std::atomic<T*>[capacity]), capacity(capacity), slotCount(0), epoch(1)
+	{
+		for (uint32_t slot = 0; slot != capacity; ++slot)
+			slots[slot].store(nullptr);
+		for (Reader& reader : readers)
+		{
+			reader.Epoch.store(0);
+			reader.Registered = false;
+		}
+		stats = {};
+	}
+
+	// No reader may be inside any more
+	~AssetRegistry()
+	{
+		for (uint32_t slot = 0; slot != slotCount; ++slot)
+			delete slots[slot].load();
+		for (const Retired& r : retired)
+			delete r.Version;
+	}
+
+	AssetRegistry(const AssetRegistry&) = delete;
+	AssetRegistry& operator=(const AssetRegistry&) = delete;
+
+	// A slot holding version, which may be null. NoSlot when all capacity slots are taken.
+	uint32_t Add(std::unique_ptr<T> version)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (slotCount == capacity) return NoSlot;
+		slots[slotCount].store(version.release());
+		return slotCount++;
+	}
+
+	// Make version the one readers get from now on. From any thread.
+	void Publish(uint32_t slot, std::unique_ptr<T> version)
+	{
+		T* previous = slots[slot].exchange(version.release());
+		std::lock_guard<std::mutex> lock(mutex);
+		++stats.Published;
+		if (previous) retired.push_back({ previous, epoch.load() });
+	}
+
+	// Delete what no reader can see any more and start a new epoch. Returns the versions deleted.
+	size_t Reclaim()
+	{
+		std::vector<T*> reclaimable;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			uint64_t oldest = ~0ull;
+			for (const Reader& reader : readers)
+			{
+				const uint64_t e = reader.Epoch.load();
+				if (e != 0) oldest = std::min(oldest, e);
+			}
+
+			size_t kept = 0;
+			for (const Retired& r : retired)
+			{
+				if (r.Epoch < oldest) reclaimable.push_back(r.Version);
+				else retired[kept++] = r;
+			}
+			retired.resize(kept);
+			stats.Reclaimed += reclaimable.size();
+			epoch.fetch_add(1);
+		}
+		// Outside the lock, destroying a version may take a while
+		for (T* version : reclaimable)
+			delete version;
+		return reclaimable.size();
+	}
+
+	// A reader for one thread, -1 when there are MaxReaders already
+	int RegisterReader()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int r = 0; r < MaxReaders; ++r)
+		{
+			if (readers[r].Registered) continue;
+			readers[r].Registered = true;
+			return r;
+		}
+		return -1;
+	}
+	void UnregisterReader(int reader)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		readers[reader].Epoch.store(0);
+		readers[reader].Registered = false;
+	}
+
+	// Only from the reader's own thread, and not nested
+	void Enter(int reader) { readers[reader].Epoch.store(epoch.load()); }
+	void Exit(int reader) { readers[reader].Epoch.store(0); }
+	// Valid until the reader's Exit. Only between Enter and Exit.
+	const T* Get(uint32_t slot) const { return slots[slot].load(); }
+
+	// Enter and Exit for a scope
+	class ReadScope
+	{
+	public:
+		ReadScope(AssetRegistry& registry, int reader) : registry(registry), reader(reader) { registry.Enter(reader); }
+		~ReadScope() { registry.Exit(reader); }
+		ReadScope(const ReadScope&) = delete;
+		ReadScope& operator=(const ReadScope&) = delete;
+
+	private:
+		AssetRegistry& registry;
+		int reader;
+	};
+
+	uint32_t GetSlotCount() const { return slotCount; }
+	AssetRegistryStats GetStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetRegistryStats s = stats;
+		s.Pending = retired.size();
+		s.Epoch = epoch.load();
+		return s;
+	}
+
+private:
+	// The epoch the reader entered in, 0 outside. A cache line each, readers store to it every frame.
+	struct alignas(64) Reader
+	{
+		std::atomic<uint64_t> Epoch;
+		bool Registered;
+	};
+
+	struct Retired
+	{
+		T* Version;
+		uint64_t Epoch;
+	};
+
+	std::unique_ptr<std::atomic<T*>[]> slots;
+	uint32_t capacity;
+	std::atomic<uint32_t> slotCount;
+	std::atomic<uint64_t> epoch;
+	Reader readers[MaxReaders];
+
+	// Guards everything below, and the writer side of the above
+	std::mutex mutex;
+	std::vector<Retired> retired;
+	AssetRegistryStats stats;
+};
@@ -0,0 +1,604 @@
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+	size_t RoundUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	// An open file with its size, read with blocking calls by the thread backend and handed to io_uring otherwise
+	struct InputFile
+	{
+#ifdef _WIN32
+		HANDLE Handle;
+#else
+		int Descriptor;
+#endif
+		uint64_t Size;
+		bool Direct;
+	};
+
+	void CloseInput(InputFile& file)
+	{
+#ifdef _WIN32
+		if (file.Handle != INVALID_HANDLE_VALUE) { CloseHandle(file.Handle); }
+		file.Handle = INVALID_HANDLE_VALUE;
+#else
+		if (file.Descriptor >= 0) { close(file.Descriptor); }
+		file.Descriptor = -1;
+#endif
+	}
+
+	bool OpenInput(const std::string& filename, bool direct, InputFile& file)
+	{
+		file.Size = 0;
+		file.Direct = direct;
+#ifdef _WIN32
+		// Sequential scan makes the cache manager read further ahead
+		file.Handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0), nullptr);
+		if (file.Handle == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file.Handle, &size))
+		{
+			CloseInput(file);
+			return false;
+		}
+		file.Size = uint64_t(size.QuadPart);
+#else
+		file.Descriptor = open(filename.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+		if (file.Descriptor < 0) return false;
+
+		struct stat st {};
+		if (fstat(file.Descriptor, &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			CloseInput(file);
+			return false;
+		}
+		file.Size = uint64_t(st.st_size);
+		// Have the kernel fetch the whole file while its blocks are still being queued
+		if (!direct) posix_fadvise(file.Descriptor, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+		return true;
+	}
+
+	// Large files are opened again without the file cache when direct reads are wanted. Not every file system
+	// takes them, those files stay cached.
+	bool OpenInput(const std::string& filename, bool direct, InputFile& file, FileBuffer& buffer)
+	{
+		if (!OpenInput(filename, false, file)) return false;
+		if (direct && file.Size >= AsyncFileReader::DirectMinSize)
+		{
+			InputFile directFile;
+			if (OpenInput(filename, true, directFile) && directFile.Size == file.Size)
+			{
+				CloseInput(file);
+				file = directFile;
+			}
+			else
+				CloseInput(directFile);
+		}
+
+		if (!buffer.Allocate(size_t(file.Size), AsyncFileReader::Alignment))
+		{
+			CloseInput(file);
+			return false;
+		}
+		return true;
+	}
+
+	// Where reads of a file stop, whole alignment units for direct reads
+	uint64_t GetReadEnd(const InputFile& file)
+	{
+		return file.Direct ? RoundUp(size_t(file.Size), AsyncFileReader::Alignment) : file.Size;
+	}
+
+	// The next block of a file from offset
+	size_t GetBlockLength(const InputFile& file, uint64_t offset)
+	{
+		return size_t(std::min(uint64_t(AsyncFileReader::BlockSize), GetReadEnd(file) - offset));
+	}
+
+	// Only short at the end of the file
+	bool ReadInput(const InputFile& file, uint64_t offset, char* output, size_t length, size_t& read)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD bytes = 0;
+		if (!::ReadFile(file.Handle, output, DWORD(length), &bytes, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+			return false;
+		read = bytes;
+#else
+		ssize_t result;
+		do
+		{
+			result = pread(file.Descriptor, output, length, off_t(offset));
+		} while (result < 0 && errno == EINTR);
+		if (result < 0) return false;
+		read = size_t(result);
+#endif
+		return true;
+	}
+
+	// [offset, end) of a file into output with blocking reads, a block at a time. Fails on an error or when the file
+	// got shorter since it was opened.
+	bool ReadRange(const InputFile& file, char* output, uint64_t offset, uint64_t end)
+	{
+		end = std::min(end, GetReadEnd(file));
+		while (offset < std::min(end, file.Size))
+		{
+			size_t read = 0;
+			if (!ReadInput(file, offset, output + offset, size_t(std::min(uint64_t(AsyncFileReader::BlockSize), end - offset)), read) || read == 0)
+				return false;
+			offset += read;
+		}
+		return true;
+	}
+}
+
+FileBuffer::FileBuffer()
+{
+	data = nullptr;
+	size = 0;
+}
+
+FileBuffer::~FileBuffer()
+{
+	Release();
+}
+
+FileBuffer::FileBuffer(FileBuffer&& other)
+{
+	data = other.data;
+	size = other.size;
+	other.data = nullptr;
+	other.size = 0;
+}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		data = other.data;
+		size = other.size;
+		other.data = nullptr;
+		other.size = 0;
+	}
+	return *this;
+}
+
+bool FileBuffer::Allocate(size_t size, size_t alignment)
+{
+	Release();
+	// Never empty, so even an empty file has somewhere to point
+	const size_t capacity = std::max(alignment, RoundUp(size, alignment));
+#ifdef _WIN32
+	data = static_cast<char*>(_aligned_malloc(capacity, alignment));
+#else
+	void* memory = nullptr;
+	data = posix_memalign(&memory, alignment, capacity) == 0 ? static_cast<char*>(memory) : nullptr;
+#endif
+	this->size = data ? size : 0;
+	return data != nullptr;
+}
+
+void FileBuffer::Release()
+{
+#ifdef _WIN32
+	if (data) { _aligned_free(data); }
+#else
+	free(data);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+struct AsyncFileReader::Request
+{
+	AsyncRead Read;
+	AsyncReadCallback Callback;
+	InputFile File;
+	bool Opened;
+	bool Failed;
+	// The first byte no block has been queued for yet, and the blocks the kernel still has
+	uint64_t NextOffset;
+	unsigned InFlight;
+};
+
+#ifdef __linux__
+// The submission and completion queues shared with the kernel, through the raw system calls
+struct AsyncFileReader::Ring
+{
+	// One read of a request, user_data of its submission
+	struct Block
+	{
+		Request* Owner;
+		// What is left of the block, Offset moves on after a short read
+		uint64_t Offset;
+		uint64_t End;
+		iovec Vector;
+	};
+
+	Ring()
+	{
+		Descriptor = -1;
+		RingMemory = CqMemory = SqeMemory = MAP_FAILED;
+		RingSize = CqSize = SqeSize = 0;
+		Unpublished = 0;
+	}
+
+	~Ring()
+	{
+		if (SqeMemory != MAP_FAILED) { munmap(SqeMemory, SqeSize); }
+		if (CqMemory != MAP_FAILED && CqMemory != RingMemory) { munmap(CqMemory, CqSize); }
+		if (RingMemory != MAP_FAILED) { munmap(RingMemory, RingSize); }
+		if (Descriptor >= 0) { close(Descriptor); }
+	}
+
+	bool Setup(unsigned entries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		Descriptor = int(syscall(__NR_io_uring_setup, entries, &params));
+		if (Descriptor < 0) return false;
+
+		RingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		CqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		// Newer kernels map both rings at once
+		const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single) RingSize = CqSize = std::max(RingSize, CqSize);
+		RingMemory = mmap(nullptr, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_SQ_RING);
+		if (RingMemory == MAP_FAILED) return false;
+		CqMemory = single ? RingMemory : mmap(nullptr, CqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_CQ_RING);
+		if (CqMemory == MAP_FAILED) return false;
+		SqeSize = params.sq_entries * sizeof(io_uring_sqe);
+		SqeMemory = mmap(nullptr, SqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_SQES);
+		if (SqeMemory == MAP_FAILED) return false;
+
+		char* sq = static_cast<char*>(RingMemory);
+		SqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		SqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		SqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		SqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		Sqes = static_cast<io_uring_sqe*>(SqeMemory);
+		char* cq = static_cast<char*>(CqMemory);
+		CqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		CqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		CqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		Cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	// Only visible to the kernel once Enter publishes the tail
+	void Prepare(Block& block)
+	{
+		const unsigned tail = *SqTail + Unpublished++;
+		io_uring_sqe& sqe = Sqes[tail & SqMask];
+		memset(&sqe, 0, sizeof(sqe));
+		block.Vector.iov_base = block.Owner->Read.Contents.GetData() + block.Offset;
+		block.Vector.iov_len = size_t(block.End - block.Offset);
+		sqe.opcode = IORING_OP_READV;
+		sqe.fd = block.Owner->File.Descriptor;
+		sqe.off = block.Offset;
+		sqe.addr = reinterpret_cast<uint64_t>(&block.Vector);
+		sqe.len = 1;
+		sqe.user_data = reinterpret_cast<uint64_t>(&block);
+		SqArray[tail & SqMask] = tail & SqMask;
+	}
+
+	// Submit everything prepared in one call and wait for at least one completion. Fails if the kernel refuses for
+	// another reason than being interrupted or busy, the ring must not be entered again then.
+	bool Enter()
+	{
+		__atomic_store_n(SqTail, *SqTail + Unpublished, __ATOMIC_RELEASE);
+		Unpublished = 0;
+		for (;;)
+		{
+			const unsigned unsubmitted = *SqTail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE);
+			const long result = syscall(__NR_io_uring_enter, Descriptor, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (result >= 0) return true;
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+		}
+	}
+
+	// After a failed Enter, the blocks whose submissions the kernel never took. Only the ones it took complete.
+	void TakeUnsubmitted(std::vector<Block*>& blocks)
+	{
+		for (unsigned head = __atomic_load_n(SqHead, __ATOMIC_ACQUIRE); head != *SqTail; ++head)
+			blocks.push_back(reinterpret_cast<Block*>(Sqes[SqArray[head & SqMask]].user_data));
+	}
+
+	int Descriptor;
+	void* RingMemory;
+	void* CqMemory;
+	void* SqeMemory;
+	size_t RingSize;
+	size_t CqSize;
+	size_t SqeSize;
+	unsigned* SqHead;
+	unsigned* SqTail;
+	unsigned SqMask;
+	unsigned* SqArray;
+	// Prepared since the last Enter
+	unsigned Unpublished;
+	io_uring_sqe* Sqes;
+	unsigned* CqHead;
+	unsigned* CqTail;
+	unsigned CqMask;
+	io_uring_cqe* Cqes;
+};
+#else
+struct AsyncFileReader::Ring
+{
+};
+#endif
+
+AsyncFileReader::AsyncFileReader(unsigned queueDepth, bool direct, AsyncBackend backend)
+{
+	if (queueDepth == 0)
+		queueDepth = std::max(1u, std::thread::hardware_concurrency());
+	this->queueDepth = queueDepth;
+	this->direct = direct;
+	pending = 0;
+	inFlight = 0;
+	peakInFlight = 0;
+	stopping = false;
+
+	this->backend = AsyncBackendThreads;
+#ifdef __linux__
+	if (backend != AsyncBackendThreads)
+	{
+		ring.reset(new Ring());
+		if (ring->Setup(queueDepth))
+			this->backend = AsyncBackendIoUring;
+		else
+			ring.reset();
+	}
+#endif
+
+	if (this->backend == AsyncBackendIoUring)
+		threads.emplace_back(&AsyncFileReader::RunRing, this);
+	else
+		for (unsigned t = 0; t < queueDepth; ++t)
+			threads.emplace_back(&AsyncFileReader::RunThread, this);
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
+
+void AsyncFileReader::Read(const std::string& filename, AsyncReadCallback callback)
+{
+	std::unique_ptr<Request> request(new Request());
+	request->Read.Filename = filename;
+	request->Read.Succeeded = false;
+	request->Callback = std::move(callback);
+	request->Opened = false;
+	request->Failed = false;
+	request->NextOffset = 0;
+	request->InFlight = 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.push_back(std::move(request));
+	++pending;
+	workAvailable.notify_one();
+}
+
+void AsyncFileReader::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return pending == 0; });
+}
+
+void AsyncFileReader::Complete(std::unique_ptr<Request>& request)
+{
+	if (request->Opened) CloseInput(request->File);
+	request->Read.Succeeded = request->Opened && !request->Failed;
+	if (!request->Read.Succeeded) request->Read.Contents.Release();
+	request->Callback(request->Read);
+	request.reset();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (--pending == 0) workDone.notify_all();
+}
+
+void AsyncFileReader::RunThread()
+{
+	for (;;)
+	{
+		std::unique_ptr<Request> request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty()) return;
+			request = std::move(queue.front());
+			queue.pop_front();
+			peakInFlight = std::max(peakInFlight, ++inFlight);
+		}
+
+		request->Opened = OpenInput(request->Read.Filename, direct, request->File, request->Read.Contents);
+		request->Failed = request->Opened && !ReadRange(request->File, request->Read.Contents.GetData(), 0, GetReadEnd(request->File));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--inFlight;
+		}
+		Complete(request);
+	}
+}
+
+#ifdef __linux__
+void AsyncFileReader::RunRing()
+{
+	typedef Ring::Block Block;
+	std::vector<Block> blocks(queueDepth);
+	std::vector<Block*> freeBlocks;
+	for (Block& block : blocks)
+		freeBlocks.push_back(&block);
+	// Blocks the kernel read only part of, to go again from where they stopped
+	std::vector<Block*> retries;
+	// Files in the order they were queued, older ones get their blocks first
+	std::deque<std::unique_ptr<Request>> active;
+
+	// Blocks the kernel finished go back to the free ones, or to the retries if it read only part of them
+	const auto reap = [&]()
+	{
+		unsigned head = *ring->CqHead;
+		const unsigned tail = __atomic_load_n(ring->CqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head)
+		{
+			const io_uring_cqe& cqe = ring->Cqes[head & ring->CqMask];
+			Block* block = reinterpret_cast<Block*>(cqe.user_data);
+			Request& request = *block->Owner;
+			// Direct reads of the last block ask for more than is left
+			const uint64_t expected = std::min(block->End, request.File.Size) - block->Offset;
+			if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+			{
+				retries.push_back(block);
+				continue;
+			}
+			if (cqe.res > 0 && uint64_t(cqe.res) < expected)
+			{
+				// Go on from where the read stopped
+				block->Offset += uint64_t(cqe.res);
+				retries.push_back(block);
+				continue;
+			}
+			if (cqe.res <= 0 && expected > 0)
+				request.Failed = true;
+			--request.InFlight;
+			freeBlocks.push_back(block);
+		}
+		__atomic_store_n(ring->CqHead, head, __ATOMIC_RELEASE);
+	};
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (active.empty())
+			{
+				workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (queue.empty()) return;
+			}
+			while (!queue.empty())
+			{
+				active.push_back(std::move(queue.front()));
+				queue.pop_front();
+			}
+		}
+
+		for (Block* block : retries)
+			ring->Prepare(*block);
+		retries.clear();
+
+		// Files are only opened once there is a block free for them
+		for (std::unique_ptr<Request>& request : active)
+		{
+			if (freeBlocks.empty()) break;
+			if (!request->Opened && !request->Failed)
+			{
+				request->Opened = OpenInput(request->Read.Filename, direct, request->File, request->Read.Contents);
+				request->Failed = !request->Opened;
+			}
+			while (!request->Failed && request->NextOffset < request->File.Size && !freeBlocks.empty())
+			{
+				Block* block = freeBlocks.back();
+				freeBlocks.pop_back();
+				block->Owner = request.get();
+				block->Offset = request->NextOffset;
+				block->End = block->Offset + GetBlockLength(request->File, block->Offset);
+				ring->Prepare(*block);
+				request->NextOffset = block->End;
+				++request->InFlight;
+			}
+		}
+
+		// Files that were read, failed or are empty, once the kernel gave back all their blocks
+		for (auto request = active.begin(); request != active.end();)
+		{
+			const Request& r = **request;
+			if (r.InFlight == 0 && (r.Failed || (r.Opened && r.NextOffset >= r.File.Size)))
+			{
+				Complete(*request);
+				request = active.erase(request);
+			}
+			else
+				++request;
+		}
+
+		const unsigned blocksInFlight = unsigned(blocks.size() - freeBlocks.size());
+		if (blocksInFlight == 0) continue;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			peakInFlight = std::max(peakInFlight, blocksInFlight);
+		}
+
+		if (!ring->Enter()) break;
+		reap();
+	}
+
+	// The ring is broken. The blocks the kernel took still complete, the others and whatever the completions left
+	// are read here with blocking reads, then this thread goes on like the thread backend.
+	ring->TakeUnsubmitted(retries);
+	while (blocks.size() - freeBlocks.size() > retries.size())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		reap();
+	}
+	for (Block* block : retries)
+	{
+		Request& request = *block->Owner;
+		request.Failed = request.Failed || !ReadRange(request.File, request.Read.Contents.GetData(), block->Offset, block->End);
+	}
+	for (std::unique_ptr<Request>& request : active)
+	{
+		if (!request->Opened && !request->Failed)
+		{
+			request->Opened = OpenInput(request->Read.Filename, direct, request->File, request->Read.Contents);
+			request->Failed = !request->Opened;
+		}
+		request->Failed = request->Failed ||
+			!ReadRange(request->File, request->Read.Contents.GetData(), request->NextOffset, GetReadEnd(request->File));
+		Complete(request);
+	}
+	RunThread();
+}
+#else
+void AsyncFileReader::RunRing()
+{
+}
+#endif
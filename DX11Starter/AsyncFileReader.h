@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Memory for a whole file, aligned for direct I/O
+class FileBuffer
+{
+public:
+	FileBuffer();
+	~FileBuffer();
+
+	FileBuffer(FileBuffer&& other);
+	FileBuffer& operator=(FileBuffer&& other);
+	FileBuffer(const FileBuffer&) = delete;
+	FileBuffer& operator=(const FileBuffer&) = delete;
+
+	// Room for size bytes rounded up to whole alignment units, direct reads write up to that
+	bool Allocate(size_t size, size_t alignment);
+	void Release();
+
+	// Getters
+	char* GetData() const { return data; }
+	const char* GetEnd() const { return data + size; }
+	size_t GetSize() const { return size; }
+
+private:
+	char* data;
+	size_t size;
+};
+
+struct AsyncRead
+{
+	std::string Filename;
+	bool Succeeded;
+	FileBuffer Contents;
+};
+
+// Runs on the reader's own threads once a file is read, it must not log. It may move the contents out.
+typedef std::function<void(AsyncRead& read)> AsyncReadCallback;
+
+enum AsyncBackend
+{
+	// io_uring where the kernel has it, threads otherwise
+	AsyncBackendDefault,
+	// One thread submits reads to an io_uring and reaps their completions, Linux only
+	AsyncBackendIoUring,
+	// Threads that each read one file at a time with blocking calls
+	AsyncBackendThreads,
+};
+
+// Reads whole files in the background, so loaders can queue everything they need at once and decode what already
+// arrived while the rest is on its way. Files are read in blocks of BlockSize; with io_uring every queued block up to
+// the queue depth goes to the kernel in one submission, and each opened file is hinted to the kernel's read-ahead.
+// Direct reads bypass the file cache for files of at least DirectMinSize, like archives that are read only once.
+class AsyncFileReader
+{
+public:
+	static const size_t Alignment = 4096;
+	static const size_t BlockSize = 256 * 1024;
+	static const size_t DirectMinSize = 1024 * 1024;
+
+	// queueDepth is the most blocks in flight for io_uring and the number of threads otherwise, 0 picks one thread
+	// per core
+	AsyncFileReader(unsigned queueDepth = 32, bool direct = false, AsyncBackend backend = AsyncBackendDefault);
+	// Waits for every queued read
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	// Thread safe. The callback gets the file's contents, or Succeeded false if it cannot be opened or read.
+	void Read(const std::string& filename, AsyncReadCallback callback);
+	// Until every read queued so far has called its callback
+	void Wait();
+
+	// What the reader ended up using, io_uring falls back to threads when the kernel refuses it. A ring the kernel
+	// stops taking submissions on later finishes its reads with blocking calls and goes on as a single thread.
+	AsyncBackend GetBackend() const { return backend; }
+	unsigned GetQueueDepth() const { return queueDepth; }
+	// Most blocks, or files with threads, that were in flight at the same time
+	unsigned GetPeakInFlight() const { return peakInFlight; }
+
+private:
+	struct Request;
+	struct Ring;
+
+	void RunRing();
+	void RunThread();
+	void Complete(std::unique_ptr<Request>& request);
+
+	AsyncBackend backend;
+	unsigned queueDepth;
+	bool direct;
+	std::unique_ptr<Ring> ring;
+
+	// Guards everything below
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	std::deque<std::unique_ptr<Request>> queue;
+	size_t pending;
+	unsigned inFlight;
+	unsigned peakInFlight;
+	bool stopping;
+	std::vector<std::thread> threads;
+};
@@ -12,7 +12,7 @@ struct VertexToPixel
     float4 worldPos				: POSITION0;
     float3 normal				: NORMAL;
     float2 uv					: TEXCOORD;
-    float3 tangent				: TANGENT;
+    float4 tangent				: TANGENT;
     float4 lViewSpacePos		: POSITION1;
 };
 
@@ -326,8 +326,8 @@ PixelOutput main(VertexToPixel input)
 
     float3 v = normalize(float4(CameraPosition, 1.0f) - input.worldPos).xyz;
     float3 n = normalize(input.normal);
-    float3 t = normalize(input.tangent - dot(input.tangent, n) * n);
-    float3 b = normalize(cross(n, t));
+    float3 t = normalize(input.tangent.xyz - dot(input.tangent.xyz, n) * n);
+    float3 b = normalize(cross(n, t)) * (input.tangent.w < 0.0f ? -1.0f : 1.0f);
     float3 l;
     float4 result = float4(0, 0, 0, 0);
     float4 directLighting = float4(0, 0, 0, 0);
@@ -336,8 +336,9 @@ PixelOutput main(VertexToPixel input)
     if (hasNormalMap)
     {
         // Normal Mapping
-        float4 normalMapping = normalTexture.Sample(basicSampler, input.uv);
-        normalMapping = normalMapping * 2 - 1;
+        // Cooked normal maps are BC5 with only x and y, z is rebuilt from them
+        float2 normalXY = normalTexture.Sample(basicSampler, input.uv).xy * 2 - 1;
+        float3 normalMapping = float3(normalXY, sqrt(saturate(1 - dot(normalXY, normalXY))));
 
         float3x3 TBN = float3x3(t, b, n);
 
@@ -0,0 +1,2275 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "AssetArchive.h"
+#include "AssetCache.h"
+#include "AssetLoader.h"
+#include "AssetRegistry.h"
+#include "AssetCooker.h"
+#include "Benchmark.h"
+#include "BlockCompressor.h"
+#include "ClusterCuller.h"
+#include "CompletionQueue.h"
+#include "FileSystem.h"
+#include "GltfParser.h"
+#include "ImageDecoder.h"
+#include "LodSelector.h"
+#include "Lz4.h"
+#include "MeshCodec.h"
+#include "MeshCooker.h"
+#include "MeshSimplifier.h"
+#include "MipGenerator.h"
+#include "ObjParser.h"
+#include "SimpleLogger.h"
+#include "StreamingMeshCooker.h"
+#include "TangentGenerator.h"
+#include "TextureAtlas.h"
+#include "TextureCooker.h"
+#include "TextureManager.h"
+#include "TextureResidency.h"
+#include "VertexPacker.h"
+#include "VirtualFile.h"
+#include "VirtualTexture.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	const int Iterations = 10;
+
+	bool SameObjData(const ObjData& a, const ObjData& b)
+	{
+		if (a.MtlLib != b.MtlLib) return false;
+		if (a.Positions.size() != b.Positions.size() || a.Normals.size() != b.Normals.size() ||
+			a.TexCoords.size() != b.TexCoords.size() || a.Faces.size() != b.Faces.size() || a.Groups.size() != b.Groups.size())
+			return false;
+		if (memcmp(a.Positions.data(), b.Positions.data(), a.Positions.size() * sizeof(DirectX::XMFLOAT3)) != 0) return false;
+		if (memcmp(a.Normals.data(), b.Normals.data(), a.Normals.size() * sizeof(DirectX::XMFLOAT3)) != 0) return false;
+		if (memcmp(a.TexCoords.data(), b.TexCoords.data(), a.TexCoords.size() * sizeof(DirectX::XMFLOAT2)) != 0) return false;
+		for (size_t i = 0; i < a.Faces.size(); ++i)
+		{
+			if (a.Faces[i].HasNormal != b.Faces[i].HasNormal) return false;
+			if (memcmp(a.Faces[i].Corners, b.Faces[i].Corners, sizeof(a.Faces[i].Corners)) != 0) return false;
+		}
+		for (size_t i = 0; i < a.Groups.size(); ++i)
+		{
+			if (a.Groups[i].Material != b.Groups[i].Material || a.Groups[i].FirstFace != b.Groups[i].FirstFace ||
+				a.Groups[i].FaceCount != b.Groups[i].FaceCount)
+				return false;
+		}
+		return true;
+	}
+
+	struct CameraPose
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Forward;
+	};
+
+	std::vector<CameraPose> LoadCameraPath(const std::string& filename)
+	{
+		std::vector<CameraPose> path;
+		std::ifstream in(filename);
+		CameraPose pose{};
+		while (in >> pose.Position.x >> pose.Position.y >> pose.Position.z >> pose.Forward.x >> pose.Forward.y >> pose.Forward.z)
+			path.push_back(pose);
+		return path;
+	}
+
+	// Once around the model looking at its center, and a turn on the spot in its center
+	// like inside a room
+	void MakeCameraPaths(const DirectX::XMFLOAT3& center, float radius, std::vector<CameraPose>& orbit, std::vector<CameraPose>& inside)
+	{
+		const int frames = 120;
+		for (int f = 0; f < frames; ++f)
+		{
+			const float angle = DirectX::XM_2PI * float(f) / float(frames);
+			const DirectX::XMFLOAT3 direction(std::sin(angle), -0.25f, std::cos(angle));
+			const DirectX::XMFLOAT3 position(center.x - direction.x * 1.5f * radius, center.y - direction.y * 1.5f * radius,
+				center.z - direction.z * 1.5f * radius);
+			orbit.push_back({ position, direction });
+			inside.push_back({ center, DirectX::XMFLOAT3(std::sin(angle), 0.0f, std::cos(angle)) });
+		}
+	}
+
+	// Clusters of every submesh with indices relative to the submesh, like Mesh has them
+	std::vector<std::vector<MeshCluster>> GetMeshClusters(const MeshData& data)
+	{
+		std::vector<std::vector<MeshCluster>> meshClusters(data.Submeshes.size());
+		for (size_t m = 0; m != data.Submeshes.size(); ++m)
+		{
+			const SubmeshRange& submesh = data.Submeshes[m];
+			for (uint32_t c = submesh.FirstCluster; c != submesh.FirstCluster + submesh.ClusterCount; ++c)
+			{
+				const ClusterRange& range = data.Clusters[c];
+				meshClusters[m].push_back({ range.FirstIndex - submesh.FirstIndex, range.IndexCount,
+					range.Center, range.Radius, range.ConeAxis, range.ConeCutoff });
+			}
+		}
+		return meshClusters;
+	}
+
+	// Triangles of a range that face the eye, which cone culling must never have removed
+	size_t CountFrontFaces(const MeshData& data, const SubmeshRange& submesh, const MeshCluster& cluster, const DirectX::XMFLOAT3& eye)
+	{
+		size_t front = 0;
+		const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+		const int* indices = data.Indices.data() + submesh.FirstIndex + cluster.FirstIndex;
+		const DirectX::XMVECTOR e = XMLoadFloat3(&eye);
+		for (size_t i = 0; i + 2 < cluster.IndexCount; i += 3)
+		{
+			const DirectX::XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].Position);
+			const DirectX::XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			const DirectX::XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			const DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+			front += DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, DirectX::XMVectorSubtract(e, p0))) > 0.0f;
+		}
+		return front;
+	}
+
+	void BenchmarkCameraPath(const char* label, const MeshData& data, const std::vector<std::vector<MeshCluster>>& meshClusters,
+		float radius, const std::vector<CameraPose>& path)
+	{
+		if (path.empty()) return;
+
+		DirectX::XMFLOAT4X4 world{};
+		XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+		const DirectX::XMMATRIX projection = XMMatrixTranspose(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 1280.0f / 720.0f,
+			radius * 0.001f, radius * 100.0f));
+
+		std::vector<ClusterView> views;
+		for (const CameraPose& pose : path)
+		{
+			const DirectX::XMFLOAT3 up = std::abs(pose.Forward.y) > 0.99f ? DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f) : DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+			const DirectX::XMMATRIX view = XMMatrixTranspose(DirectX::XMMatrixLookToLH(XMLoadFloat3(&pose.Position), XMLoadFloat3(&pose.Forward), XMLoadFloat3(&up)));
+			views.push_back(ClusterCuller::MakeView(world, view, projection, 1.0f));
+		}
+
+		std::vector<std::vector<ClusterBlock>> blocks;
+		for (const std::vector<MeshCluster>& clusters : meshClusters)
+			blocks.push_back(ClusterCuller::BuildBlocks(clusters.data(), clusters.size()));
+
+		// Counts over the whole path, checked against the scalar version and the triangles themselves
+		ClusterCullStats total{};
+		size_t tested = 0;
+		size_t ranges = 0;
+		size_t drawnTriangles = 0;
+		size_t submeshTriangles = 0;
+		size_t mismatches = 0;
+		size_t wronglyCulled = 0;
+		std::vector<DrawRange> simd;
+		std::vector<DrawRange> scalar;
+		for (const ClusterView& view : views)
+		{
+			for (size_t m = 0; m != data.Submeshes.size(); ++m)
+			{
+				const SubmeshRange& submesh = data.Submeshes[m];
+				const std::vector<MeshCluster>& clusters = meshClusters[m];
+				simd.clear();
+				scalar.clear();
+				const ClusterCullStats stats = ClusterCuller::Cull(view, blocks[m].data(), clusters.data(), clusters.size(), simd);
+				ClusterCuller::CullScalar(view, clusters.data(), clusters.size(), scalar);
+
+				mismatches += simd.size() != scalar.size() || !std::equal(simd.begin(), simd.end(), scalar.begin(),
+					[](const DrawRange& a, const DrawRange& b) { return a.FirstIndex == b.FirstIndex && a.IndexCount == b.IndexCount; });
+				total.Visible += stats.Visible;
+				total.FrustumCulled += stats.FrustumCulled;
+				total.ConeCulled += stats.ConeCulled;
+				tested += clusters.size();
+				ranges += simd.size();
+				for (const DrawRange& range : simd)
+					drawnTriangles += range.IndexCount / 3;
+
+				// What whole submesh culling would draw
+				if (ClusterCuller::IsSphereVisible(view, submesh.BoundingBoxCenter,
+					DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&submesh.BoundingBoxExtents)))))
+					submeshTriangles += submesh.IndexCount / 3;
+
+				// Every triangle of a cluster culled by its cone has to face away
+				size_t next = 0;
+				for (const MeshCluster& cluster : clusters)
+				{
+					while (next < simd.size() && simd[next].FirstIndex + simd[next].IndexCount <= cluster.FirstIndex) ++next;
+					const bool drawn = next < simd.size() && simd[next].FirstIndex <= cluster.FirstIndex;
+					if (!drawn && ClusterCuller::IsSphereVisible(view, cluster.Center, cluster.Radius))
+						wronglyCulled += CountFrontFaces(data, submesh, cluster, view.Eye);
+				}
+			}
+		}
+
+		// Timing on its own, without the checks
+		const int repeats = 20;
+		Clock::time_point start = Clock::now();
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (const ClusterView& view : views)
+			{
+				for (size_t m = 0; m != meshClusters.size(); ++m)
+				{
+					simd.clear();
+					ClusterCuller::Cull(view, blocks[m].data(), meshClusters[m].data(), meshClusters[m].size(), simd);
+				}
+			}
+		}
+		const double simdSeconds = SecondsSince(start);
+		start = Clock::now();
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (const ClusterView& view : views)
+			{
+				for (size_t m = 0; m != meshClusters.size(); ++m)
+				{
+					scalar.clear();
+					ClusterCuller::CullScalar(view, meshClusters[m].data(), meshClusters[m].size(), scalar);
+				}
+			}
+		}
+		const double scalarSeconds = SecondsSince(start);
+
+		const double frames = double(views.size());
+		const double totalTriangles = double(data.Indices.size() / 3) * frames;
+		LOG_INFO << "  " << label << " path, " << views.size() << " frames: " << tested / views.size() << " clusters, "
+			<< 100.0 * total.FrustumCulled / tested << "% frustum culled, " << 100.0 * total.ConeCulled / tested << "% cone culled, "
+			<< ranges / frames << " draw ranges per frame." << std::endl;
+		LOG_INFO << "    triangles drawn " << 100.0 * drawnTriangles / totalTriangles << "% (whole submesh culling "
+			<< 100.0 * submeshTriangles / totalTriangles << "%), " << simdSeconds * 1e9 / (double(tested) * repeats) << " ns per cluster ("
+			<< scalarSeconds * 1e9 / (double(tested) * repeats) << " scalar), " << (mismatches ? "SIMD MISMATCH" : "SIMD matches scalar") << ", "
+			<< wronglyCulled << " front faces culled." << std::endl;
+	}
+
+	void BenchmarkObjScaling(const std::string& name, const char* begin, const char* end)
+	{
+		ObjData reference;
+		ObjParser::ParseObj(begin, end, reference);
+
+		// 1, 2, 4, ... and finally every core
+		const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned> threadCounts;
+		for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+
+		double singleThreaded = 0.0;
+		for (unsigned threads : threadCounts)
+		{
+			bool identical = true;
+			const Clock::time_point start = Clock::now();
+			for (int i = 0; i < Iterations; ++i)
+			{
+				ObjData obj;
+				ObjParser::ParseObjParallel(begin, end, obj, threads);
+				if (i == 0) identical = SameObjData(reference, obj);
+			}
+			const double seconds = SecondsSince(start) / Iterations;
+			if (threads == 1) singleThreaded = seconds;
+
+			LOG_INFO << "Parallel parse \"" << name << "\" with " << threads << " threads: "
+				<< seconds * 1000.0 << " ms, " << (end - begin) / seconds / (1024.0 * 1024.0) << " MB/s, speedup "
+				<< singleThreaded / seconds << "x, " << (identical ? "identical" : "MISMATCH") << "." << std::endl;
+		}
+	}
+
+	enum TestImage
+	{
+		TestImageColor,
+		TestImageColorAlpha,
+		TestImageNormal,
+		TestImageGray,
+	};
+
+	// Synthetic RGBA8 images with smooth gradients, edges and noise, so compression runs without image codecs
+	std::vector<uint8_t> MakeTestImage(TestImage kind, uint32_t size)
+	{
+		std::mt19937 random(740);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		const auto clamp = [](float value) { return uint8_t(std::min(255.0f, std::max(0.0f, value + 0.5f))); };
+		const float frequency = 6.2831853f * 4.0f / size;
+
+		std::vector<uint8_t> pixels(size_t(size) * size * 4);
+		for (uint32_t y = 0; y != size; ++y)
+			for (uint32_t x = 0; x != size; ++x)
+			{
+				uint8_t* p = &pixels[(size_t(y) * size + x) * 4];
+				const float u = float(x) / size;
+				const float v = float(y) / size;
+				// Tiles with hard edges on top of the gradients
+				const bool tile = ((x / 64) + (y / 64)) % 2 == 0;
+				switch (kind)
+				{
+				case TestImageColor:
+				case TestImageColorAlpha:
+					p[0] = clamp(255.0f * u + noise(random) + (tile ? 30.0f : 0.0f));
+					p[1] = clamp(255.0f * v + noise(random));
+					p[2] = clamp(128.0f + 100.0f * std::sin(x * frequency) * std::cos(y * frequency) + noise(random));
+					p[3] = kind == TestImageColor ? 255 : clamp(255.0f * (1.0f - std::hypot(u - 0.5f, v - 0.5f) * 1.4f));
+					break;
+				case TestImageNormal:
+				{
+					// Normals of the height field sin(x) * cos(y), eight times finer than the color so blocks see curvature
+					const float dx = std::cos(x * frequency * 8.0f) * std::cos(y * frequency * 8.0f) * 0.8f;
+					const float dy = -std::sin(x * frequency * 8.0f) * std::sin(y * frequency * 8.0f) * 0.8f;
+					const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+					p[0] = clamp((-dx / length * 0.5f + 0.5f) * 255.0f);
+					p[1] = clamp((-dy / length * 0.5f + 0.5f) * 255.0f);
+					p[2] = clamp((1.0f / length * 0.5f + 0.5f) * 255.0f);
+					p[3] = 255;
+					break;
+				}
+				case TestImageGray:
+					p[0] = p[1] = p[2] = clamp(128.0f + 90.0f * std::sin((x + y) * frequency) + noise(random) + (tile ? 20.0f : -20.0f));
+					p[3] = 255;
+					break;
+				}
+			}
+		return pixels;
+	}
+
+	// Drop a file from the file cache so the next read comes from the disk. Linux is told to forget the pages. Windows
+	// purges the cached pages of a file opened without buffering when nothing else has it open, which is as close as
+	// it gets without administrator rights, so cold numbers there are best effort.
+	void EvictFromCache(const std::string& filename)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		const int file = open(filename.c_str(), O_RDONLY);
+		if (file < 0) return;
+		posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+		close(file);
+#endif
+	}
+
+	struct LoadPass
+	{
+		double Seconds;
+		size_t Bytes;
+		// Of every file's contents in order, to check all ways of loading see the same bytes
+		uint64_t Hash;
+	};
+
+	// Open every file through VirtualFile, with archive mounted unless it is empty, and hash it like a loader would
+	// touch every byte. Mounting and unmounting are part of the time.
+	LoadPass LoadFiles(const std::vector<std::string>& files, const std::string& archive, unsigned threadCount)
+	{
+		const Clock::time_point start = Clock::now();
+		LoadPass pass = { 0.0, 0, 0 };
+		if (!archive.empty()) VirtualFile::Mount(archive);
+		for (const std::string& filename : files)
+		{
+			VirtualFile file;
+			if (!file.Open(filename, threadCount)) continue;
+			pass.Hash = HashData(file.GetData(), file.GetSize(), pass.Hash);
+			pass.Bytes += file.GetSize();
+		}
+		VirtualFile::UnmountAll();
+		pass.Seconds = SecondsSince(start);
+		return pass;
+	}
+
+	// One pass right after dropping everything it reads from the file cache, then the best of several warm ones
+	void BenchmarkLoad(const char* label, const std::vector<std::string>& files, const std::string& archive, uint64_t expectedHash)
+	{
+		for (const std::string& filename : files)
+			EvictFromCache(filename);
+		if (!archive.empty()) EvictFromCache(archive);
+		const LoadPass cold = LoadFiles(files, archive, 0);
+
+		LoadPass warm = cold;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			const LoadPass pass = LoadFiles(files, archive, 0);
+			if (pass.Seconds < warm.Seconds) warm = pass;
+		}
+
+		LOG_INFO << "  " << label << ": cold " << cold.Seconds * 1000.0 << " ms (" << cold.Bytes / cold.Seconds / 1e6 << " MB/s), warm "
+			<< warm.Seconds * 1000.0 << " ms (" << warm.Bytes / warm.Seconds / 1e6 << " MB/s), contents "
+			<< (cold.Hash == expectedHash && warm.Hash == expectedHash ? "match" : "MISMATCH") << "." << std::endl;
+	}
+
+	// The full detail level of every submesh as a glTF mesh, counter-clockwise like glTF wants. Interleaved the
+	// attributes are laid out like Vertex, otherwise every attribute gets its own tightly packed accessor and UVs in
+	// [0, 1] become normalized unsigned shorts.
+	bool WriteGlb(const std::string& filename, const MeshData& data, bool interleaved)
+	{
+		std::vector<char> binary;
+		std::ostringstream views;
+		std::ostringstream accessors;
+		std::ostringstream meshes;
+		size_t viewCount = 0;
+		size_t accessorCount = 0;
+		const auto addView = [&](const void* bytes, size_t size, size_t stride)
+		{
+			views << (viewCount ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << binary.size() << ",\"byteLength\":" << size;
+			if (stride) views << ",\"byteStride\":" << stride;
+			views << "}";
+			binary.insert(binary.end(), static_cast<const char*>(bytes), static_cast<const char*>(bytes) + size);
+			binary.resize((binary.size() + 3) / 4 * 4);
+			return viewCount++;
+		};
+		const auto addAccessor = [&](size_t view, size_t offset, size_t count, int componentType, const char* type, bool normalized,
+			const std::string& bounds = std::string())
+		{
+			accessors << (accessorCount ? "," : "") << "{\"bufferView\":" << view << ",\"byteOffset\":" << offset << ",\"count\":" << count
+				<< ",\"componentType\":" << componentType << ",\"type\":\"" << type << "\"" << (normalized ? ",\"normalized\":true" : "") << bounds << "}";
+			return accessorCount++;
+		};
+
+		for (size_t m = 0; m != data.Submeshes.size(); ++m)
+		{
+			const SubmeshRange& submesh = data.Submeshes[m];
+			const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+			DirectX::XMFLOAT3 lower(FLT_MAX, FLT_MAX, FLT_MAX);
+			DirectX::XMFLOAT3 upper(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			bool unitUVs = true;
+			for (uint32_t v = 0; v != submesh.VertexCount; ++v)
+			{
+				const Vertex& vertex = vertices[v];
+				lower = { std::min(lower.x, vertex.Position.x), std::min(lower.y, vertex.Position.y), std::min(lower.z, vertex.Position.z) };
+				upper = { std::max(upper.x, vertex.Position.x), std::max(upper.y, vertex.Position.y), std::max(upper.z, vertex.Position.z) };
+				unitUVs = unitUVs && vertex.UV.x >= 0.0f && vertex.UV.x <= 1.0f && vertex.UV.y >= 0.0f && vertex.UV.y <= 1.0f;
+			}
+			// Positions have to have bounds
+			std::ostringstream bounds;
+			bounds.precision(9);
+			bounds << ",\"min\":[" << lower.x << "," << lower.y << "," << lower.z << "],\"max\":[" << upper.x << "," << upper.y << "," << upper.z << "]";
+
+			size_t attributes[4];
+			if (interleaved)
+			{
+				const size_t view = addView(vertices, submesh.VertexCount * sizeof(Vertex), sizeof(Vertex));
+				attributes[0] = addAccessor(view, offsetof(Vertex, Position), submesh.VertexCount, GltfFloat, "VEC3", false, bounds.str());
+				attributes[1] = addAccessor(view, offsetof(Vertex, Normal), submesh.VertexCount, GltfFloat, "VEC3", false);
+				attributes[2] = addAccessor(view, offsetof(Vertex, UV), submesh.VertexCount, GltfFloat, "VEC2", false);
+				attributes[3] = addAccessor(view, offsetof(Vertex, Tangent), submesh.VertexCount, GltfFloat, "VEC4", false);
+			}
+			else
+			{
+				std::vector<DirectX::XMFLOAT3> positions;
+				std::vector<DirectX::XMFLOAT3> normals;
+				std::vector<DirectX::XMFLOAT2> uvs;
+				std::vector<uint16_t> quantizedUVs;
+				std::vector<DirectX::XMFLOAT4> tangents;
+				for (uint32_t v = 0; v != submesh.VertexCount; ++v)
+				{
+					positions.push_back(vertices[v].Position);
+					normals.push_back(vertices[v].Normal);
+					uvs.push_back(vertices[v].UV);
+					quantizedUVs.push_back(uint16_t(vertices[v].UV.x * 65535.0f + 0.5f));
+					quantizedUVs.push_back(uint16_t(vertices[v].UV.y * 65535.0f + 0.5f));
+					tangents.push_back(vertices[v].Tangent);
+				}
+				attributes[0] = addAccessor(addView(positions.data(), positions.size() * sizeof(positions[0]), 0), 0, submesh.VertexCount, GltfFloat, "VEC3", false, bounds.str());
+				attributes[1] = addAccessor(addView(normals.data(), normals.size() * sizeof(normals[0]), 0), 0, submesh.VertexCount, GltfFloat, "VEC3", false);
+				attributes[2] = unitUVs
+					? addAccessor(addView(quantizedUVs.data(), quantizedUVs.size() * sizeof(uint16_t), 0), 0, submesh.VertexCount, GltfUnsignedShort, "VEC2", true)
+					: addAccessor(addView(uvs.data(), uvs.size() * sizeof(uvs[0]), 0), 0, submesh.VertexCount, GltfFloat, "VEC2", false);
+				attributes[3] = addAccessor(addView(tangents.data(), tangents.size() * sizeof(tangents[0]), 0), 0, submesh.VertexCount, GltfFloat, "VEC4", false);
+			}
+			std::vector<uint32_t> indices(data.Indices.begin() + submesh.FirstIndex, data.Indices.begin() + submesh.FirstIndex + submesh.IndexCount);
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				std::swap(indices[i + 1], indices[i + 2]);
+			const size_t indexAccessor = addAccessor(addView(indices.data(), indices.size() * sizeof(uint32_t), 0), 0, indices.size(), GltfUnsignedInt, "SCALAR", false);
+
+			meshes << (m ? "," : "") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << attributes[0] << ",\"NORMAL\":" << attributes[1]
+				<< ",\"TEXCOORD_0\":" << attributes[2] << ",\"TANGENT\":" << attributes[3] << "},\"indices\":" << indexAccessor << "}]}";
+		}
+
+		std::ostringstream nodes;
+		for (size_t m = 0; m != data.Submeshes.size(); ++m)
+			nodes << (m ? "," : "") << "{\"mesh\":" << m << "}";
+		std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(binary.size()) +
+			"}],\"bufferViews\":[" + views.str() + "],\"accessors\":[" + accessors.str() + "],\"meshes\":[" + meshes.str() +
+			"],\"nodes\":[" + nodes.str() + "]}";
+		json.resize((json.size() + 3) / 4 * 4, ' ');
+
+		// Header, JSON chunk, binary chunk
+		const uint32_t header[5] = { 0x46546C67, 2, uint32_t(12 + 8 + json.size() + 8 + binary.size()), uint32_t(json.size()), 0x4E4F534A };
+		const uint32_t binaryHeader[2] = { uint32_t(binary.size()), 0x004E4942 };
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(json.data(), json.size());
+		file.write(reinterpret_cast<const char*>(binaryHeader), sizeof(binaryHeader));
+		file.write(binary.data(), binary.size());
+		return bool(file);
+	}
+
+	// What GltfLoader does on the CPU: parse, then map or convert the vertices and read the indices of every primitive
+	// for upload, handing them to use(vertices, vertexCount, indices16, indices32, indexCount) with the indices in one
+	// of the two. Returns the primitives mapped.
+	template <typename Use>
+	size_t LoadGlbGeometry(const std::string& filename, bool& succeeded, const Use& use)
+	{
+		MappedFile file;
+		GltfData gltf;
+		succeeded = file.Open(filename) && GltfParser::ParseGlb(file.GetData(), file.GetSize(), gltf);
+		size_t mapped = 0;
+		std::vector<Vertex> converted;
+		std::vector<uint16_t> indices16;
+		std::vector<int> indices32;
+		for (const GltfMesh& mesh : gltf.Meshes)
+			for (const GltfPrimitive& primitive : mesh.Primitives)
+			{
+				const size_t vertexCount = GltfParser::GetVertexCount(gltf, primitive);
+				const size_t indexCount = GltfParser::GetIndexCount(gltf, primitive);
+				const Vertex* vertices = GltfParser::MapVertices(gltf, primitive);
+				if (vertices)
+					++mapped;
+				else
+				{
+					converted.resize(vertexCount);
+					GltfParser::ReadVertices(gltf, primitive, converted.data());
+					vertices = converted.data();
+				}
+
+				if (VertexPacker::CanUse16BitIndices(vertexCount))
+				{
+					indices16.resize(indexCount);
+					succeeded = GltfParser::ReadIndices(gltf, primitive, vertexCount, indices16.data()) && succeeded;
+					use(vertices, vertexCount, indices16.data(), nullptr, indexCount);
+				}
+				else
+				{
+					indices32.resize(indexCount);
+					succeeded = GltfParser::ReadIndices(gltf, primitive, vertexCount, indices32.data()) && succeeded;
+					use(vertices, vertexCount, nullptr, indices32.data(), indexCount);
+				}
+			}
+		return mapped;
+	}
+
+	// Stands in for TextureStreamer: loads finish a few frames after they begin, and every call is checked against
+	// what TextureStreamingDevice promises
+	class FakeStreamingDevice : public TextureStreamingDevice
+	{
+	public:
+		explicit FakeStreamingDevice(unsigned latency) : valid(true), latency(latency), frame(0) {}
+
+		void AddTexture(uint32_t tail)
+		{
+			resident.push_back(tail);
+			loading.push_back(false);
+			loaded.push_back(~0u);
+		}
+
+		void BeginLoad(int texture, uint32_t firstMip) override
+		{
+			if (loading[texture] || firstMip >= resident[texture]) valid = false;
+			loading[texture] = true;
+			loads.push_back({ texture, firstMip, frame + latency });
+		}
+
+		void PollLoads(std::vector<TextureLoad>& finished) override
+		{
+			++frame;
+			std::fill(loaded.begin(), loaded.end(), ~0u);
+			for (size_t i = 0; i != loads.size();)
+			{
+				if (loads[i].Due > frame) { ++i; continue; }
+				finished.push_back({ loads[i].Texture, loads[i].FirstMip, true });
+				loading[loads[i].Texture] = false;
+				loaded[loads[i].Texture] = loads[i].FirstMip;
+				loads[i] = loads.back();
+				loads.pop_back();
+			}
+		}
+
+		void SetResidentMip(int texture, uint32_t firstMip) override
+		{
+			// Finer mips only from a load that finished this frame and brought them
+			if (firstMip < resident[texture] && (loaded[texture] == ~0u || firstMip < loaded[texture])) valid = false;
+			if (loading[texture]) valid = false;
+			resident[texture] = firstMip;
+			loaded[texture] = ~0u;
+		}
+
+		std::vector<uint32_t> resident;
+		bool valid;
+
+	private:
+		struct PendingLoad
+		{
+			int Texture;
+			uint32_t FirstMip;
+			uint64_t Due;
+		};
+
+		unsigned latency;
+		uint64_t frame;
+		std::vector<bool> loading;
+		std::vector<uint32_t> loaded;
+		std::vector<PendingLoad> loads;
+	};
+
+	struct StreamingRun
+	{
+		size_t PeakResident;
+		size_t PeakDesired;
+		size_t PeakPending;
+		uint32_t MinBias;
+		uint32_t MaxBias;
+		size_t Loads;
+		size_t Evictions;
+		size_t TailBytes;
+		double UpdateSeconds;
+		int Frames;
+		// Resident bytes never above the budget, or the tails when they alone are over it
+		bool WithinBudget;
+		// The device was only asked what TextureStreamingDevice allows
+		bool DeviceValid;
+		// Once the camera stops everything reaches its target and the queue empties
+		bool Settled;
+	};
+
+	// A camera flying down a row of textured objects and stopping halfway back, like walking through a level.
+	// Each object covers 600 / distance pixels of radius and has one UV unit per object unit.
+	StreamingRun RunTextureStreaming(const std::vector<uint32_t>& sizes, size_t budget, bool log)
+	{
+		const int moveFrames = 600;
+		const int settleFrames = 200;
+		const int objectCount = 160;
+		const float spacing = 3.0f;
+		const float farPlane = 60.0f;
+
+		TextureStreamingSettings settings = { budget, 64, 4, 30, 0.1f };
+		FakeStreamingDevice device(3);
+		TextureResidency residency(device, settings);
+		for (uint32_t size : sizes)
+		{
+			const uint32_t mipCount = MipGenerator::GetLevelCount(size, size);
+			std::vector<size_t> mipBytes;
+			uint32_t coarsestFirstMip = 0;
+			for (uint32_t m = 0; m != mipCount; ++m)
+			{
+				mipBytes.push_back(BlockCompressor::GetCompressedSize(DXGI_FORMAT_BC1_UNORM, std::max(size >> m, 1u), std::max(size >> m, 1u)));
+				if (TextureCooker::CanCook(size >> m, size >> m)) coarsestFirstMip = m;
+			}
+			const int texture = residency.Add(size, size, mipBytes, coarsestFirstMip);
+			device.AddTexture(residency.GetTailMip(texture));
+		}
+
+		StreamingRun run = {};
+		run.MinBias = ~0u;
+		run.WithinBudget = true;
+		for (size_t t = 0; t != sizes.size(); ++t)
+			run.TailBytes += residency.GetBytes(int(t), residency.GetTailMip(int(t)));
+
+		const float rowLength = spacing * objectCount;
+		for (int frame = 0; frame != moveFrames + settleFrames; ++frame)
+		{
+			const float camera = frame < moveFrames ? -20.0f + (rowLength + 40.0f) * frame / moveFrames : rowLength * 0.5f;
+			for (int o = 0; o != objectCount; ++o)
+			{
+				const float distance = o * spacing - camera;
+				if (distance <= 0.0f || distance > farPlane) continue;
+				const float projectedRadius = 600.0f / std::max(distance, 1.0f);
+				// Objects share textures, some of them with a neighbour farther away
+				residency.Request(int((o * 7) % sizes.size()), projectedRadius, 3.14159265f * projectedRadius * projectedRadius);
+			}
+
+			const Clock::time_point start = Clock::now();
+			residency.Update();
+			run.UpdateSeconds += SecondsSince(start);
+
+			const TextureStreamingStats& stats = residency.GetStats();
+			size_t resident = 0;
+			for (size_t t = 0; t != sizes.size(); ++t)
+				resident += residency.GetBytes(int(t), device.resident[t]);
+			if (resident != stats.ResidentBytes || resident > std::max(budget, run.TailBytes)) run.WithinBudget = false;
+			run.PeakResident = std::max(run.PeakResident, resident);
+			run.PeakDesired = std::max(run.PeakDesired, stats.DesiredBytes);
+			run.PeakPending = std::max(run.PeakPending, stats.PendingRequests + stats.LoadsInFlight);
+			run.MinBias = std::min(run.MinBias, stats.MipBias);
+			run.MaxBias = std::max(run.MaxBias, stats.MipBias);
+			run.Loads += stats.Loaded;
+			run.Evictions += stats.Evicted;
+			if (log && frame % 100 == 0)
+			{
+				LOG_INFO << "    frame " << frame << ": " << stats.ResidentBytes << " bytes resident, " << stats.DesiredBytes << " wanted, "
+					<< stats.LoadsInFlight << " loading, " << stats.PendingRequests << " waiting, mip bias " << stats.MipBias << " with "
+					<< stats.Boosted << " textures a mip finer." << std::endl;
+			}
+		}
+		run.Frames = moveFrames + settleFrames;
+		run.DeviceValid = device.valid;
+
+		const TextureStreamingStats& last = residency.GetStats();
+		run.Settled = last.LoadsInFlight == 0 && last.PendingRequests == 0;
+		for (size_t t = 0; t != sizes.size(); ++t)
+			if (device.resident[t] != residency.GetTargetMip(int(t)) || residency.GetResidentMip(int(t)) != device.resident[t]) run.Settled = false;
+		return run;
+	}
+
+	// The feedback a frame at viewProjection would give, worked out on the CPU: every triangle facing the eye and
+	// inside the frustum asks for the pages its UV bounds cover, at the mip its texels per pixel on a 1280 by 720
+	// screen want. Nothing is occluded, so it asks for more than a feedback pass would. One entry per triangle and
+	// page, the repeats stand in for how much of the screen wants a page.
+	void MakeVirtualTextureFeedback(const MeshData& data, const std::vector<uint32_t>& textures, uint32_t textureSize, const VirtualTextureCache& cache,
+		const DirectX::XMMATRIX& viewProjection, const DirectX::XMFLOAT3& eye, float nearPlane, std::vector<VirtualPageId>& feedback)
+	{
+		const DirectX::XMVECTOR e = XMLoadFloat3(&eye);
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			if (submesh.Material < 0) continue;
+			const uint32_t texture = textures[submesh.Material];
+			const VirtualPageTable& table = cache.GetPageTable(texture);
+			const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+			const int* indices = data.Indices.data() + submesh.FirstIndex;
+			for (size_t i = 0; i + 2 < submesh.IndexCount; i += 3)
+			{
+				const Vertex* corners[3] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+				const DirectX::XMVECTOR p0 = XMLoadFloat3(&corners[0]->Position);
+				const DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(XMLoadFloat3(&corners[1]->Position), p0),
+					DirectX::XMVectorSubtract(XMLoadFloat3(&corners[2]->Position), p0));
+				if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, DirectX::XMVectorSubtract(e, p0))) <= 0.0f) continue;
+
+				// Outside when all three corners are past the same plane
+				DirectX::XMFLOAT4 clip[3];
+				for (int k = 0; k != 3; ++k)
+					XMStoreFloat4(&clip[k], DirectX::XMVector3Transform(XMLoadFloat3(&corners[k]->Position), viewProjection));
+				int outside[6] = {};
+				for (const DirectX::XMFLOAT4& c : clip)
+				{
+					outside[0] += c.x < -c.w;
+					outside[1] += c.x > c.w;
+					outside[2] += c.y < -c.w;
+					outside[3] += c.y > c.w;
+					outside[4] += c.z < 0.0f;
+					outside[5] += c.z > c.w;
+				}
+				if (std::find(std::begin(outside), std::end(outside), 3) != std::end(outside)) continue;
+
+				// Pixels covered, with corners behind the eye pulled onto the near plane and at most the screen
+				float sx[3];
+				float sy[3];
+				for (int k = 0; k != 3; ++k)
+				{
+					const float w = std::max(clip[k].w, nearPlane);
+					sx[k] = clip[k].x / w * 640.0f;
+					sy[k] = clip[k].y / w * 360.0f;
+				}
+				const float pixels = std::min(std::max(0.5f * std::abs((sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0])), 0.5f), 1280.0f * 720.0f);
+				const DirectX::XMFLOAT2& uv0 = corners[0]->UV;
+				const DirectX::XMFLOAT2& uv1 = corners[1]->UV;
+				const DirectX::XMFLOAT2& uv2 = corners[2]->UV;
+				const float texels = 0.5f * std::abs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y)) * float(textureSize) * float(textureSize);
+				const float texelsPerPixel = std::sqrt(texels / pixels);
+				const uint32_t mip = texelsPerPixel <= 1.0f ? 0 : std::min(uint32_t(std::log2(texelsPerPixel)), table.GetMipCount() - 1);
+
+				// UVs repeat, bounds wider than the texture take all of it
+				const uint32_t pagesX = table.GetPagesX(mip);
+				const uint32_t pagesY = table.GetPagesY(mip);
+				const double x0 = std::floor(double(std::min({ uv0.x, uv1.x, uv2.x })) * pagesX);
+				const double x1 = std::floor(double(std::max({ uv0.x, uv1.x, uv2.x })) * pagesX);
+				const double y0 = std::floor(double(std::min({ uv0.y, uv1.y, uv2.y })) * pagesY);
+				const double y1 = std::floor(double(std::max({ uv0.y, uv1.y, uv2.y })) * pagesY);
+				const uint32_t spanX = x1 - x0 + 1.0 >= pagesX ? pagesX : uint32_t(x1 - x0) + 1;
+				const uint32_t spanY = y1 - y0 + 1.0 >= pagesY ? pagesY : uint32_t(y1 - y0) + 1;
+				const int64_t firstX = int64_t(x0) % int64_t(pagesX) + pagesX;
+				const int64_t firstY = int64_t(y0) % int64_t(pagesY) + pagesY;
+				for (uint32_t y = 0; y != spanY; ++y)
+					for (uint32_t x = 0; x != spanX; ++x)
+						feedback.push_back(VirtualTextureCache::MakePageId(texture, mip, uint32_t((firstX + x) % pagesX), uint32_t((firstY + y) % pagesY)));
+			}
+		}
+	}
+
+	// Every material of a model as a textureSize virtual texture sharing a cache of physicalPages, along a camera path
+	// and then a while where the path stopped. Loads finish two frames after they start. Logs hit rate and resident
+	// memory every tenth of the path, and checks the page tables and the cache after every frame.
+	void BenchmarkVirtualTexturePath(const char* label, const MeshData& data, float radius, const std::vector<CameraPose>& path,
+		uint32_t textureSize, uint32_t physicalPages)
+	{
+		if (path.empty()) return;
+
+		const VirtualTextureSettings settings = { 128, 4, physicalPages, 64, 32, 64 };
+		const uint32_t pageTexels = settings.PageSize + 2 * settings.PageBorder;
+		const size_t bytesPerPage = BlockCompressor::GetCompressedSize(DXGI_FORMAT_BC1_UNORM, pageTexels, pageTexels);
+		VirtualTextureCache cache(settings, bytesPerPage);
+		std::vector<uint32_t> textures;
+		for (size_t m = 0; m != data.Materials.size(); ++m)
+			textures.push_back(cache.AddTexture(textureSize, textureSize));
+
+		const float nearPlane = radius * 0.001f;
+		const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 1280.0f / 720.0f, nearPlane, radius * 100.0f);
+
+		struct PendingLoad
+		{
+			VirtualPageLoad Load;
+			size_t Due;
+		};
+		std::vector<PendingLoad> pending;
+		std::vector<VirtualPageLoad> loads;
+		std::vector<VirtualPageId> feedback;
+
+		const size_t settleFrames = 30;
+		const size_t frames = path.size() + settleFrames;
+		const size_t sampleEvery = std::max(path.size() / 10, size_t(1));
+		double analyzeSeconds = 0.0;
+		double hitRateSum = 0.0;
+		double lowestHitRate = 1.0;
+		size_t peakResident = 0;
+		size_t peakFeedback = 0;
+		size_t peakRequested = 0;
+		size_t loaded = 0;
+		size_t evicted = 0;
+		size_t starved = 0;
+		bool consistent = true;
+		std::ostringstream hitCurve;
+		std::ostringstream residentCurve;
+		for (size_t frame = 0; frame != frames; ++frame)
+		{
+			for (size_t i = 0; i != pending.size();)
+			{
+				if (pending[i].Due > frame) { ++i; continue; }
+				cache.CompleteLoad(pending[i].Load, true);
+				pending[i] = pending.back();
+				pending.pop_back();
+			}
+
+			const CameraPose& pose = path[std::min(frame, path.size() - 1)];
+			const DirectX::XMFLOAT3 up = std::abs(pose.Forward.y) > 0.99f ? DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f) : DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+			const DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(XMLoadFloat3(&pose.Position), XMLoadFloat3(&pose.Forward), XMLoadFloat3(&up));
+			feedback.clear();
+			MakeVirtualTextureFeedback(data, textures, textureSize, cache, XMMatrixMultiply(view, projection), pose.Position, nearPlane, feedback);
+			peakFeedback = std::max(peakFeedback, feedback.size());
+
+			loads.clear();
+			const Clock::time_point start = Clock::now();
+			cache.Update(feedback.data(), feedback.size(), loads);
+			analyzeSeconds += SecondsSince(start);
+			for (const VirtualPageLoad& load : loads)
+				pending.push_back({ load, frame + 2 });
+			if (!cache.Validate()) consistent = false;
+
+			const VirtualTextureStats& stats = cache.GetStats();
+			const double hitRate = stats.Requested ? double(stats.Hits) / stats.Requested : 1.0;
+			if (frame < path.size())
+			{
+				hitRateSum += hitRate;
+				if (frame >= 10) lowestHitRate = std::min(lowestHitRate, hitRate);
+				if (frame % sampleEvery == 0)
+				{
+					hitCurve << " " << int(hitRate * 100.0 + 0.5);
+					residentCurve << " " << stats.ResidentBytes / 1024;
+				}
+			}
+			peakResident = std::max(peakResident, stats.ResidentPages);
+			peakRequested = std::max(peakRequested, stats.Requested);
+			loaded += stats.LoadsFinished;
+			evicted += stats.Evicted;
+			starved += stats.Starved ? 1 : 0;
+		}
+
+		const VirtualTextureStats& last = cache.GetStats();
+		LOG_INFO << "  " << label << " path, " << physicalPages << " page cache of " << physicalPages * bytesPerPage << " bytes: " << path.size()
+			<< " frames and " << settleFrames << " still, " << analyzeSeconds * 1e6 / frames << " us per analysis of up to " << peakFeedback
+			<< " requests for " << peakRequested << " pages, mean hit rate " << hitRateSum * 100.0 / path.size() << "%, lowest " << lowestHitRate * 100.0 << "% after frame 10, peak "
+			<< peakResident << " pages (" << peakResident * bytesPerPage << " bytes) resident, " << loaded << " loads, " << evicted
+			<< " evictions, " << starved << " frames starved for slots. Page tables " << (consistent ? "consistent" : "INCONSISTENT") << ", "
+			<< (last.Hits == last.Requested ? std::string("all hits") : std::to_string(last.Requested - last.Hits) + " misses") << " once the camera stops." << std::endl;
+		LOG_INFO << "    hit rate %:" << hitCurve.str() << std::endl;
+		LOG_INFO << "    resident KB:" << residentCurve.str() << std::endl;
+	}
+
+	// Size and pixels of a map for packing. Without an image decoder the size comes from a PNG header and the pixels
+	// are a pattern unique to every texel, which checks placement just as well. Empty if neither works.
+	AtlasBitmap LoadAtlasImage(const std::string& filename, uint32_t seed, ImageDecoder& decoder)
+	{
+		AtlasBitmap image = {};
+		MappedFile file;
+		if (!FileExists(filename) || !file.Open(filename)) return image;
+		UINT width = 0;
+		UINT height = 0;
+		if (decoder.Decode(file.GetData(), file.GetSize(), image.Pixels, width, height))
+		{
+			image.Width = width;
+			image.Height = height;
+			return image;
+		}
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(file.GetData());
+		if (file.GetSize() < 24 || memcmp(bytes + 1, "PNG", 3) != 0 || memcmp(bytes + 12, "IHDR", 4) != 0) return image;
+		const auto bigEndian = [](const uint8_t* p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]; };
+		image.Width = bigEndian(bytes + 16);
+		image.Height = bigEndian(bytes + 20);
+		image.Pixels.resize(size_t(image.Width) * image.Height * 4);
+		for (uint32_t y = 0; y != image.Height; ++y)
+			for (uint32_t x = 0; x != image.Width; ++x)
+			{
+				const uint32_t texel = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+				uint8_t* pixel = &image.Pixels[(size_t(y) * image.Width + x) * 4];
+				memcpy(pixel, &texel, 3);
+				pixel[3] = 255;
+			}
+		return image;
+	}
+
+	// Hashes of every triangle with what its material draws, sorted, to compare meshes whatever their submeshes
+	std::vector<uint64_t> HashTriangles(const MeshData& data)
+	{
+		std::vector<uint64_t> hashes;
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			uint64_t surface = 0;
+			if (submesh.Material >= 0)
+			{
+				const MtlMaterial& material = data.Materials[submesh.Material];
+				const std::string maps = material.DiffuseMap + "|" + material.NormalMap;
+				surface = HashData(maps.data(), maps.size(), HashData(&material.Diffuse, sizeof(material.Diffuse)));
+			}
+			for (uint32_t i = submesh.FirstIndex; i + 2 < submesh.FirstIndex + submesh.IndexCount; i += 3)
+			{
+				uint64_t hash = surface;
+				for (uint32_t c = 0; c != 3; ++c)
+					hash = HashData(&data.Vertices[submesh.FirstVertex + data.Indices[i + c]], sizeof(Vertex), hash);
+				hashes.push_back(hash);
+			}
+		}
+		std::sort(hashes.begin(), hashes.end());
+		return hashes;
+	}
+}
+
+void RunBenchmarks(const std::string& modelFolder)
+{
+	LOG_INFO << "Running benchmarks on \"" << modelFolder << "\"." << std::endl;
+
+	BenchmarkObjParser(modelFolder);
+	BenchmarkObjParserScaling(modelFolder);
+	BenchmarkVertexPacking(modelFolder);
+	BenchmarkTangentGenerator(modelFolder);
+	BenchmarkTextureDecode(modelFolder);
+	BenchmarkTextureCooker(modelFolder);
+	BenchmarkMipGenerator(modelFolder);
+	BenchmarkMeshSimplifier(modelFolder);
+	BenchmarkClusterCulling(modelFolder);
+	BenchmarkAssetCooker(modelFolder);
+	BenchmarkAssetArchive(modelFolder);
+	BenchmarkMeshCodec(modelFolder);
+	BenchmarkStreamingMeshCooker(modelFolder);
+	BenchmarkGltfLoader(modelFolder);
+	BenchmarkTextureStreaming(modelFolder);
+	BenchmarkVirtualTexturing(modelFolder);
+	BenchmarkTextureAtlas(modelFolder);
+	BenchmarkAsyncLoading(modelFolder);
+	BenchmarkAssetCache(modelFolder);
+	BenchmarkAssetRegistry(modelFolder);
+}
+
+void BenchmarkObjParser(const std::string& modelFolder)
+{
+	size_t totalBytes = 0;
+	double totalSeconds = 0.0;
+
+	std::vector<std::string> files = ListFiles(modelFolder, ".obj");
+	std::vector<std::string> mtlFiles = ListFiles(modelFolder, ".mtl");
+	files.insert(files.end(), mtlFiles.begin(), mtlFiles.end());
+
+	for (const std::string& file : files)
+	{
+		const bool isMtl = file.size() > 4 && file.compare(file.size() - 4, 4, ".mtl") == 0;
+
+		// Opening and mapping is part of the load time
+		const Clock::time_point start = Clock::now();
+		size_t bytes = 0;
+		size_t elements = 0;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			MappedFile mapped;
+			if (!mapped.Open(file)) break;
+			bytes += mapped.GetSize();
+
+			if (isMtl)
+			{
+				std::vector<MtlMaterial> materials;
+				ObjParser::ParseMtl(mapped.GetData(), mapped.GetEnd(), materials);
+				elements = materials.size();
+			}
+			else
+			{
+				ObjData obj;
+				ObjParser::ParseObj(mapped.GetData(), mapped.GetEnd(), obj);
+				elements = obj.Faces.size();
+			}
+		}
+		const double seconds = SecondsSince(start);
+		if (bytes == 0) continue;
+
+		totalBytes += bytes;
+		totalSeconds += seconds;
+
+		LOG_INFO << "Parse \"" << file << "\": " << bytes / Iterations << " bytes, "
+			<< elements << (isMtl ? " materials, " : " faces, ")
+			<< seconds * 1000.0 / Iterations << " ms, "
+			<< bytes / seconds / (1024.0 * 1024.0) << " MB/s." << std::endl;
+	}
+
+	if (totalSeconds > 0.0)
+	{
+		LOG_INFO << "Parse total: " << totalBytes / Iterations << " bytes in " << totalSeconds * 1000.0 / Iterations << " ms, "
+			<< totalBytes / totalSeconds / (1024.0 * 1024.0) << " MB/s." << std::endl;
+	}
+}
+
+void BenchmarkObjParserScaling(const std::string& modelFolder)
+{
+	// Our models are small, so also build one large synthetic scene out of all of them
+	std::string scene;
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MappedFile mapped;
+		if (!mapped.Open(file)) continue;
+
+		BenchmarkObjScaling(file, mapped.GetData(), mapped.GetEnd());
+		scene.append(mapped.GetData(), mapped.GetSize());
+		scene.push_back('\n');
+	}
+
+	std::string large;
+	while (!scene.empty() && large.size() < 64 * 1024 * 1024)
+		large += scene;
+	if (!large.empty())
+		BenchmarkObjScaling("<all models, 64 MB>", large.data(), large.data() + large.size());
+}
+
+void BenchmarkVertexPacking(const std::string& modelFolder)
+{
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data, false)) continue;
+
+		// Indices are 32-bit in the full layout, otherwise 16-bit wherever the submesh allows it
+		size_t fullBytes = 0;
+		size_t indexBytes = 0;
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			fullBytes += submesh.VertexCount * sizeof(Vertex) + submesh.IndexCount * sizeof(int);
+			indexBytes += submesh.IndexCount * (VertexPacker::CanUse16BitIndices(submesh.VertexCount) ? sizeof(uint16_t) : sizeof(int));
+		}
+
+		LOG_INFO << "Vertex packing of \"" << file << "\", " << data.Vertices.size() << " vertices, "
+			<< data.Indices.size() << " indices, " << fullBytes << " bytes in the full layout:" << std::endl;
+
+		for (int f = VertexFormatPacked; f < VertexFormatCount; ++f)
+		{
+			const VertexFormat format = VertexFormat(f);
+			const size_t vertexSize = VertexPacker::GetVertexSize(format);
+
+			QuantizationError error{};
+			size_t bytes = indexBytes;
+			double seconds = 0.0;
+			for (const SubmeshRange& submesh : data.Submeshes)
+			{
+				const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+				const VertexDequantization dequantization = VertexPacker::ComputeDequantization(vertices, submesh.VertexCount, format);
+
+				std::vector<char> packed(submesh.VertexCount * vertexSize);
+				std::vector<Vertex> unpacked(submesh.VertexCount);
+				const Clock::time_point start = Clock::now();
+				VertexPacker::Pack(vertices, submesh.VertexCount, format, dequantization, packed.data());
+				seconds += SecondsSince(start);
+				VertexPacker::Unpack(packed.data(), submesh.VertexCount, format, dequantization, unpacked.data());
+
+				const QuantizationError submeshError = VertexPacker::MeasureError(vertices, unpacked.data(), submesh.VertexCount);
+				error.Position = std::max(error.Position, submeshError.Position);
+				error.NormalDegrees = std::max(error.NormalDegrees, submeshError.NormalDegrees);
+				error.TangentDegrees = std::max(error.TangentDegrees, submeshError.TangentDegrees);
+				error.UV = std::max(error.UV, submeshError.UV);
+				error.HandednessMismatches += submeshError.HandednessMismatches;
+				bytes += packed.size();
+			}
+
+			LOG_INFO << "  " << VertexPacker::GetFormatName(format) << " (" << vertexSize << " bytes per vertex): "
+				<< bytes << " bytes, " << 100.0 * bytes / fullBytes << "% of full, packed in " << seconds * 1000.0 << " ms." << std::endl;
+			LOG_INFO << "  max error: position " << error.Position << ", normal " << error.NormalDegrees << " deg, tangent "
+				<< error.TangentDegrees << " deg, UV " << error.UV << ", " << error.HandednessMismatches << " handedness mismatches." << std::endl;
+		}
+	}
+}
+
+void BenchmarkTangentGenerator(const std::string& modelFolder)
+{
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data, false)) continue;
+		size_t triangles = 0;
+		for (const SubmeshRange& submesh : data.Submeshes)
+			triangles += submesh.IndexCount / 3;
+
+		// Every corner against the port of mikktspace.c
+		float maxDegrees = 0.0f;
+		size_t signMismatches = 0;
+		size_t splits = 0;
+		double seconds = 0.0;
+		double referenceSeconds = 0.0;
+		std::vector<Vertex> vertices;
+		std::vector<int> indices;
+		std::vector<DirectX::XMFLOAT4> reference;
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			const Vertex* submeshVertices = data.Vertices.data() + submesh.FirstVertex;
+			const int* submeshIndices = data.Indices.data() + submesh.FirstIndex;
+
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < Iterations; ++i)
+				TangentGenerator::Generate(submeshVertices, submesh.VertexCount, submeshIndices, submesh.IndexCount, vertices, indices);
+			seconds += SecondsSince(start) / Iterations;
+
+			start = Clock::now();
+			TangentGenerator::GenerateReference(submeshVertices, submesh.VertexCount, submeshIndices, submesh.IndexCount, reference);
+			referenceSeconds += SecondsSince(start);
+
+			splits += vertices.size() - submesh.VertexCount;
+			for (size_t c = 0; c != reference.size(); ++c)
+			{
+				const DirectX::XMFLOAT4& expected = reference[c];
+				const DirectX::XMFLOAT4& actual = vertices[indices[c]].Tangent;
+				if ((expected.w < 0.0f) != (actual.w < 0.0f)) ++signMismatches;
+				// From the distance between the unit vectors, the arc cosine of their dot product is too coarse near 0
+				const float dx = expected.x - actual.x;
+				const float dy = expected.y - actual.y;
+				const float dz = expected.z - actual.z;
+				const float chord = std::min(2.0f, std::sqrt(dx * dx + dy * dy + dz * dz));
+				const float degrees = 2.0f * std::asin(chord * 0.5f) * 180.0f / DirectX::XM_PI;
+				maxDegrees = std::max(maxDegrees, degrees);
+			}
+		}
+
+		// The SIMD arc cosine is an approximation, so the angle weights differ slightly
+		const bool matches = maxDegrees < 0.01f && signMismatches == 0;
+		LOG_INFO << "Tangents of \"" << file << "\", " << triangles << " triangles: " << seconds * 1000.0 << " ms, "
+			<< triangles / seconds / 1e6 << " M triangles/s, reference " << referenceSeconds * 1000.0 << " ms ("
+			<< referenceSeconds / seconds << "x slower), " << splits << " split vertices." << std::endl;
+		LOG_INFO << "  max difference to reference " << maxDegrees << " deg, " << signMismatches << " sign mismatches, "
+			<< (matches ? "matches reference" : "MISMATCH") << "." << std::endl;
+
+		// The whole stage, submeshes spread over 1, 2, 4, ... and finally every core
+		const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned> threadCounts;
+		for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+
+		double singleThreaded = 0.0;
+		for (unsigned threads : threadCounts)
+		{
+			double stageSeconds = 0.0;
+			for (int i = 0; i < Iterations; ++i)
+			{
+				MeshData copy = data;
+				const Clock::time_point start = Clock::now();
+				MeshCooker::GenerateTangents(copy, threads);
+				stageSeconds += SecondsSince(start);
+			}
+			stageSeconds /= Iterations;
+			if (threads == 1) singleThreaded = stageSeconds;
+
+			LOG_INFO << "  " << data.Submeshes.size() << " submeshes on " << threads << " threads: " << stageSeconds * 1000.0 << " ms, "
+				<< triangles / stageSeconds / 1e6 << " M triangles/s, speedup " << singleThreaded / stageSeconds << "x." << std::endl;
+		}
+	}
+}
+
+void BenchmarkTextureDecode(const std::string& modelFolder)
+{
+	// Every texture map of every material, like loading all models into one scene
+	std::vector<std::pair<std::string, TextureUsage>> maps;
+	for (const std::string& file : ListFiles(modelFolder, ".mtl"))
+	{
+		MappedFile mtlFile;
+		if (!mtlFile.Open(file)) continue;
+		std::vector<MtlMaterial> materials;
+		ObjParser::ParseMtl(mtlFile.GetData(), mtlFile.GetEnd(), materials);
+		for (const MtlMaterial& material : materials)
+		{
+			if (!material.DiffuseMap.empty()) maps.push_back({ GetFolder(file) + material.DiffuseMap, TextureColor });
+			if (!material.NormalMap.empty()) maps.push_back({ GetFolder(file) + material.NormalMap, TextureNormal });
+		}
+	}
+	if (maps.empty()) return;
+
+	const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	double singleThreaded = 0.0;
+	for (unsigned threads : threadCounts)
+	{
+		// Decoding and cooking only, without a device no textures are created. Runs after the first one find the
+		// images cooked by it.
+		TextureManager textures(nullptr, nullptr, threads);
+		std::vector<ID3D11ShaderResourceView*> views(maps.size(), nullptr);
+		const Clock::time_point start = Clock::now();
+		for (size_t i = 0; i != maps.size(); ++i)
+			textures.Request(maps[i].first, maps[i].second, &views[i]);
+		textures.Flush();
+		const double seconds = SecondsSince(start);
+		if (threads == 1) singleThreaded = seconds;
+
+		const TextureStats& stats = textures.GetStats();
+		LOG_INFO << "Texture decode on " << threads << " threads: " << stats.Requests << " maps, " << stats.Files << " files, "
+			<< stats.Textures << " distinct images in " << seconds * 1000.0 << " ms, speedup " << singleThreaded / seconds << "x, "
+			<< stats.ResidentBytes << " bytes resident, " << stats.SavedBytes << " bytes saved by sharing, " << stats.Cooked << " cooked, "
+			<< stats.CookedLoaded << " loaded cooked." << std::endl;
+	}
+}
+
+void BenchmarkTextureCooker(const std::string&)
+{
+	const uint32_t size = 1024;
+
+	// Whole cook of the top level and all mips, the way the texture loader does it on one thread per image
+	const std::vector<uint8_t> pixels = MakeTestImage(TestImageColor, size);
+	std::vector<uint8_t> dds;
+	const Clock::time_point start = Clock::now();
+	for (int i = 0; i < Iterations; ++i)
+		TextureCooker::Cook(pixels.data(), size, size, TextureColor, 0, dds);
+	const double seconds = SecondsSince(start) / Iterations;
+	LOG_INFO << "Cook " << size << "x" << size << " color with mips: " << seconds * 1000.0 << " ms, " << dds.size() << " bytes, "
+		<< (TextureCooker::IsUpToDate(dds.data(), dds.size(), 0) ? "up to date" : "NOT UP TO DATE") << "." << std::endl;
+}
+
+void BenchmarkMipGenerator(const std::string&)
+{
+	struct Case
+	{
+		const char* Name;
+		TestImage Image;
+		MipSettings Settings;
+	};
+	const Case cases[] = {
+		{ "box sRGB color", TestImageColor, { MipFilterBox, true, false } },
+		{ "Kaiser sRGB color", TestImageColor, { MipFilterKaiser, true, false } },
+		{ "box normals", TestImageNormal, { MipFilterBox, false, true } },
+		{ "Kaiser normals", TestImageNormal, { MipFilterKaiser, false, true } },
+	};
+	const uint32_t size = 2048;
+	const double megapixels = double(size) * size / 1e6;
+
+	const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	std::vector<MipLevel> levels;
+	for (const Case& test : cases)
+	{
+		const std::vector<uint8_t> pixels = MakeTestImage(test.Image, size);
+		double singleThreaded = 0.0;
+		for (unsigned threads : threadCounts)
+		{
+			const Clock::time_point start = Clock::now();
+			for (int i = 0; i < Iterations; ++i)
+				MipGenerator::Generate(pixels.data(), size, size, test.Settings, levels, threads);
+			const double seconds = SecondsSince(start) / Iterations;
+			if (threads == 1) singleThreaded = seconds;
+
+			LOG_INFO << "Mips of " << size << "x" << size << " " << test.Name << " on " << threads << " threads: " << seconds * 1000.0
+				<< " ms, " << megapixels / seconds << " MP/s, speedup " << singleThreaded / seconds << "x." << std::endl;
+		}
+
+		// Every level below the top has to hold unit normals, up to the 8 bit quantization
+		if (test.Settings.NormalMap)
+		{
+			float worst = 0.0f;
+			for (size_t level = 1; level != levels.size(); ++level)
+				for (size_t i = 0; i != levels[level].Pixels.size(); i += 4)
+				{
+					const uint8_t* p = &levels[level].Pixels[i];
+					const float x = p[0] / 127.5f - 1.0f;
+					const float y = p[1] / 127.5f - 1.0f;
+					const float z = p[2] / 127.5f - 1.0f;
+					worst = std::max(worst, std::abs(std::sqrt(x * x + y * y + z * z) - 1.0f));
+				}
+			LOG_INFO << "  " << test.Name << " largest normal length error " << worst << ", " << (worst < 0.02f ? "normalized" : "NOT NORMALIZED") << "." << std::endl;
+		}
+	}
+
+	// A black and white checkerboard averages to half the light, which is 188 in sRGB and not 128
+	std::vector<uint8_t> checkerboard(64 * 64 * 4, 255);
+	for (uint32_t y = 0; y != 64; ++y)
+		for (uint32_t x = 0; x != 64; ++x)
+			if ((x + y) % 2) memset(&checkerboard[(y * 64 + x) * 4], 0, 3);
+	MipGenerator::Generate(checkerboard.data(), 64, 64, { MipFilterBox, true, false }, levels);
+	const int gray = levels[1].Pixels[0];
+	LOG_INFO << "sRGB checkerboard filters to " << gray << ", " << (gray == 188 ? "linear" : "NOT LINEAR") << "." << std::endl;
+}
+
+void BenchmarkMeshSimplifier(const std::string& modelFolder)
+{
+	const LodChainSettings lodChain = MeshCooker::DefaultLodChain();
+	LodChainSettings noLods = lodChain;
+	noLods.MaxLevels = 1;
+
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data, true, noLods)) continue;
+		const size_t triangles = data.Indices.size() / 3;
+
+		const Clock::time_point start = Clock::now();
+		for (int i = 0; i < Iterations; ++i)
+			MeshCooker::GenerateLods(data, lodChain);
+		const double seconds = SecondsSince(start) / Iterations;
+
+		LOG_INFO << "Simplify \"" << file << "\": " << triangles << " triangles into " << data.Lods.size() << " levels of "
+			<< data.Submeshes.size() << " submeshes in " << seconds * 1000.0 << " ms, " << triangles / seconds / 1e6 << " M triangles/s." << std::endl;
+
+		// Triangles per frame with the model in front of a 1280x720 camera at growing distances
+		DirectX::XMFLOAT3 center{};
+		DirectX::XMFLOAT3 extents{};
+		MeshCooker::ComputeBoundingBox(data.Vertices.data(), data.Vertices.size(), center, extents);
+		const float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&extents)));
+		if (radius <= 0.0f) continue;
+
+		DirectX::XMFLOAT4X4 world{};
+		XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+		const DirectX::XMMATRIX projection = XMMatrixTranspose(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 1280.0f / 720.0f, 0.1f, 1000.0f));
+		const LodSelection selection = LodSelector::CameraDefaults();
+
+		for (float distance = 2.0f; distance <= 256.0f; distance *= 2.0f)
+		{
+			const DirectX::XMMATRIX view = XMMatrixTranspose(DirectX::XMMatrixTranslation(-center.x, -center.y, -center.z + distance * radius));
+
+			size_t drawn = 0;
+			for (const SubmeshRange& submesh : data.Submeshes)
+			{
+				std::vector<MeshLod> lods;
+				for (uint32_t l = submesh.FirstLod; l != submesh.FirstLod + submesh.LodCount; ++l)
+					lods.push_back({ data.Lods[l].FirstIndex, data.Lods[l].IndexCount, data.Lods[l].Error });
+
+				const float submeshRadius = DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&submesh.BoundingBoxExtents)));
+				const float projected = LodSelector::ProjectedRadius(submesh.BoundingBoxCenter, submeshRadius, world, view, projection, 720.0f);
+				const int level = LodSelector::Select(lods.data(), int(lods.size()), submeshRadius, projected, selection, -1);
+				drawn += lods[level].IndexCount / 3;
+			}
+
+			LOG_INFO << "  at " << distance << "x radius: " << drawn << " of " << triangles << " triangles per frame ("
+				<< 100.0 * drawn / triangles << "%)." << std::endl;
+		}
+	}
+}
+
+void BenchmarkClusterCulling(const std::string& modelFolder)
+{
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data)) continue;
+
+		DirectX::XMFLOAT3 center{};
+		DirectX::XMFLOAT3 extents{};
+		MeshCooker::ComputeBoundingBox(data.Vertices.data(), data.Vertices.size(), center, extents);
+		const float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&extents)));
+		if (radius <= 0.0f) continue;
+
+		const std::vector<std::vector<MeshCluster>> meshClusters = GetMeshClusters(data);
+		size_t clusterTriangles = 0;
+		for (const ClusterRange& cluster : data.Clusters)
+			clusterTriangles += cluster.IndexCount / 3;
+		LOG_INFO << "Cluster culling \"" << file << "\": " << data.Clusters.size() << " clusters, "
+			<< double(clusterTriangles) / data.Clusters.size() << " triangles per cluster." << std::endl;
+
+		std::vector<CameraPose> orbit;
+		std::vector<CameraPose> inside;
+		MakeCameraPaths(center, radius, orbit, inside);
+		BenchmarkCameraPath("orbit", data, meshClusters, radius, orbit);
+		BenchmarkCameraPath("inside", data, meshClusters, radius, inside);
+		BenchmarkCameraPath("recorded", data, meshClusters, radius, LoadCameraPath(file + ".path"));
+	}
+}
+
+void BenchmarkAssetCooker(const std::string& modelFolder)
+{
+	// The first cook does whatever the folder needs, the second one has nothing left to do
+	AssetCookResult first;
+	AssetCooker::Cook(modelFolder, first);
+	AssetCookResult second;
+	const bool succeeded = AssetCooker::Cook(modelFolder, second);
+	AssetCooker::LogResult(second);
+
+	size_t unchanged = 0;
+	for (const AssetReport& asset : second.Assets)
+		if (asset.State == AssetUpToDate) ++unchanged;
+	LOG_INFO << "Asset cook of " << first.Assets.size() << " assets: " << first.Seconds * 1000.0 << " ms, then "
+		<< second.Seconds * 1000.0 << " ms with nothing changed, " << second.FilesHashed << " files hashed, "
+		<< (succeeded && unchanged == second.Assets.size() ? "all up to date" : "NOT ALL UP TO DATE") << "." << std::endl;
+}
+
+void BenchmarkAssetArchive(const std::string& modelFolder)
+{
+	const std::vector<std::string> files = AssetCooker::ListAssets(modelFolder);
+	const std::string rawArchive = "benchmark.raw.pack";
+	const std::string compressedArchive = "benchmark.lz4.pack";
+
+	// The contents every way of loading has to see, straight from the loose files
+	uint64_t expectedHash = 0;
+	size_t totalBytes = 0;
+	for (const std::string& filename : files)
+	{
+		MappedFile file;
+		if (!file.Open(filename)) continue;
+		expectedHash = HashData(file.GetData(), file.GetSize(), expectedHash);
+		totalBytes += file.GetSize();
+	}
+
+	Clock::time_point start = Clock::now();
+	const bool rawBuilt = AssetArchive::Build(rawArchive, files, false);
+	const double rawSeconds = SecondsSince(start);
+	start = Clock::now();
+	const bool compressedBuilt = AssetArchive::Build(compressedArchive, files, true);
+	const double compressedSeconds = SecondsSince(start);
+	FileStamp rawStamp;
+	FileStamp compressedStamp;
+	if (!rawBuilt || !compressedBuilt || !GetFileStamp(rawArchive, rawStamp) || !GetFileStamp(compressedArchive, compressedStamp))
+	{
+		LOG_ERROR << "Failed to build the benchmark archives." << std::endl;
+		std::remove(rawArchive.c_str());
+		std::remove(compressedArchive.c_str());
+		return;
+	}
+
+	LOG_INFO << "Asset archive of " << files.size() << " files, " << totalBytes << " bytes: uncompressed " << rawStamp.Size << " bytes in "
+		<< rawSeconds * 1000.0 << " ms, LZ4 " << compressedStamp.Size << " bytes in " << compressedSeconds * 1000.0 << " ms." << std::endl;
+	BenchmarkLoad("Loose files", files, "", expectedHash);
+	BenchmarkLoad("Uncompressed archive", files, rawArchive, expectedHash);
+	BenchmarkLoad("LZ4 archive", files, compressedArchive, expectedHash);
+
+	// Decompression alone, everything is in the file cache by now
+	AssetArchive archive;
+	if (archive.Open(compressedArchive))
+	{
+		size_t compressedBytes = 0;
+		std::vector<char> output;
+		for (size_t e = 0; e != archive.GetEntryCount(); ++e)
+			if (archive.GetEntries()[e].ChunkCount != 0)
+			{
+				compressedBytes += size_t(archive.GetEntries()[e].Size);
+				output.resize(std::max(output.size(), size_t(archive.GetEntries()[e].Size)));
+			}
+
+		std::vector<unsigned> threadCounts = { 1, 2, 4 };
+		const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		if (hardwareThreads > 4) threadCounts.push_back(hardwareThreads);
+		for (unsigned threads : threadCounts)
+		{
+			double best = 1e30;
+			bool succeeded = true;
+			for (int i = 0; i < Iterations; ++i)
+			{
+				start = Clock::now();
+				for (size_t e = 0; e != archive.GetEntryCount(); ++e)
+					if (archive.GetEntries()[e].ChunkCount != 0)
+						succeeded = archive.Read(archive.GetEntries()[e], output.data(), threads) && succeeded;
+				best = std::min(best, SecondsSince(start));
+			}
+			LOG_INFO << "  Decompressing " << compressedBytes << " bytes on " << threads << " threads: " << best * 1000.0 << " ms ("
+				<< compressedBytes / best / 1e6 << " MB/s)" << (succeeded ? "." : ", FAILED.") << std::endl;
+		}
+		archive.Close();
+	}
+
+	std::remove(rawArchive.c_str());
+	std::remove(compressedArchive.c_str());
+}
+
+void BenchmarkMeshCodec(const std::string& modelFolder)
+{
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data)) continue;
+		const size_t vertexBytes = data.Vertices.size() * sizeof(Vertex);
+		const size_t indexBytes = data.Indices.size() * sizeof(int);
+		const std::vector<char> vertices = MeshCodec::Encode(data.Vertices.data(), data.Vertices.size(), sizeof(Vertex));
+		const std::vector<char> indices = MeshCodec::Encode(data.Indices.data(), data.Indices.size(), sizeof(int));
+
+		// Plain LZ4 of the same bytes in blocks of the same size, what the archive would do with them
+		size_t lz4Bytes = 0;
+		std::vector<char> compressed(Lz4::GetMaxCompressedSize(MeshCodec::BlockSize));
+		for (const auto& buffer : { std::make_pair(reinterpret_cast<const char*>(data.Vertices.data()), vertexBytes),
+			std::make_pair(reinterpret_cast<const char*>(data.Indices.data()), indexBytes) })
+			for (size_t offset = 0; offset < buffer.second; offset += MeshCodec::BlockSize)
+			{
+				const size_t size = std::min(MeshCodec::BlockSize, buffer.second - offset);
+				const size_t compressedSize = Lz4::Compress(buffer.first + offset, size, compressed.data(), compressed.size());
+				lz4Bytes += compressedSize != 0 && compressedSize < size ? compressedSize : size;
+			}
+
+		std::vector<Vertex> decodedVertices(data.Vertices.size());
+		std::vector<int> decodedIndices(data.Indices.size());
+		double vertexBest = 1e30;
+		double indexBest = 1e30;
+		bool succeeded = true;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			succeeded = MeshCodec::Decode(vertices.data(), vertices.size(), decodedVertices.data(), decodedVertices.size(), sizeof(Vertex)) && succeeded;
+			vertexBest = std::min(vertexBest, SecondsSince(start));
+			start = Clock::now();
+			succeeded = MeshCodec::Decode(indices.data(), indices.size(), decodedIndices.data(), decodedIndices.size(), sizeof(int)) && succeeded;
+			indexBest = std::min(indexBest, SecondsSince(start));
+		}
+		const bool match = succeeded && memcmp(decodedVertices.data(), data.Vertices.data(), vertexBytes) == 0 &&
+			memcmp(decodedIndices.data(), data.Indices.data(), indexBytes) == 0;
+
+		LOG_INFO << "Mesh codec \"" << file << "\": vertices " << vertexBytes << " -> " << vertices.size() << " bytes ("
+			<< double(vertexBytes) / vertices.size() << ":1, " << vertexBytes / vertexBest / 1e9 << " GB/s), indices " << indexBytes
+			<< " -> " << indices.size() << " bytes (" << double(indexBytes) / indices.size() << ":1, " << indexBytes / indexBest / 1e9
+			<< " GB/s), plain LZ4 " << double(vertexBytes + indexBytes) / lz4Bytes << ":1, contents " << (match ? "match" : "MISMATCH") << "." << std::endl;
+	}
+}
+
+void BenchmarkStreamingMeshCooker(const std::string& modelFolder)
+{
+	const std::string referenceFilename = "benchmark.reference.cooked";
+	const std::string streamedFilename = "benchmark.streamed.cooked";
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MappedFile source;
+		if (!source.Open(file)) continue;
+		const uint64_t sourceHash = HashData(source.GetData(), source.GetSize());
+		source.Close();
+
+		MeshData data;
+		Clock::time_point start = Clock::now();
+		const AtlasSettings noAtlas = {};
+		if (!MeshCooker::CookObj(file, data, true, MeshCooker::DefaultLodChain(), noAtlas) || !CookedMesh::Write(referenceFilename, data, sourceHash)) continue;
+		const double inMemorySeconds = SecondsSince(start);
+		const size_t inMemoryBytes = data.Vertices.capacity() * sizeof(Vertex) + data.Indices.capacity() * sizeof(int);
+
+		// A budget the whole file fits in has to give the same bytes as the in-memory cook
+		StreamingCookSettings settings = StreamingMeshCooker::DefaultSettings();
+		StreamingCookStats fitting;
+		bool match = StreamingMeshCooker::Cook(file, streamedFilename, sourceHash, settings, fitting);
+		MappedFile reference;
+		MappedFile streamed;
+		match = match && reference.Open(referenceFilename) && streamed.Open(streamedFilename) && reference.GetSize() == streamed.GetSize() &&
+			memcmp(reference.GetData(), streamed.GetData(), reference.GetSize()) == 0;
+		reference.Close();
+		streamed.Close();
+
+		// A budget small enough to split groups, which still has to give every triangle
+		settings.MemoryBudget = 1024 * 1024;
+		StreamingCookStats split;
+		CookedMesh cooked;
+		bool complete = StreamingMeshCooker::Cook(file, streamedFilename, sourceHash, settings, split) && cooked.Open(streamedFilename);
+		if (complete)
+		{
+			uint32_t triangles = 0;
+			for (uint32_t s = 0; s != cooked.GetSubmeshCount(); ++s)
+				triangles += cooked.GetSubmeshes()[s].IndexCount / 3;
+			uint32_t expected = 0;
+			for (const SubmeshRange& submesh : data.Submeshes)
+				expected += submesh.IndexCount / 3;
+			complete = triangles == expected;
+		}
+		cooked.Close();
+
+		LOG_INFO << "Streaming cook \"" << file << "\": in memory " << inMemorySeconds * 1000.0 << " ms holding " << inMemoryBytes
+			<< " bytes of geometry, streamed " << fitting.Seconds * 1000.0 << " ms (" << fitting.SourceBytes / fitting.Seconds / 1e6
+			<< " MB/s) peak " << fitting.PeakMemory << " bytes, cooked files " << (match ? "match" : "MISMATCH") << "; 1 MB budget "
+			<< split.Seconds * 1000.0 << " ms, " << split.Groups << " groups into " << split.Submeshes << " submeshes, peak "
+			<< split.PeakMemory << " bytes, " << split.SpillBytes << " bytes spilled, triangles " << (complete ? "match" : "MISMATCH")
+			<< "." << std::endl;
+	}
+	std::remove(referenceFilename.c_str());
+	std::remove(streamedFilename.c_str());
+}
+
+void BenchmarkGltfLoader(const std::string& modelFolder)
+{
+	const std::string cookedFilename = "benchmark.cooked";
+	const std::string glbFilenames[2] = { "benchmark.interleaved.glb", "benchmark.separate.glb" };
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data)) continue;
+		if (!CookedMesh::Write(cookedFilename, data, 0) || !WriteGlb(glbFilenames[0], data, true) || !WriteGlb(glbFilenames[1], data, false))
+		{
+			LOG_ERROR << "Failed to write the benchmark files of \"" << file << "\"." << std::endl;
+			continue;
+		}
+
+		// What the GLBs have to give back: the full detail level of every submesh
+		std::vector<Vertex> expectedVertices;
+		std::vector<int> expectedIndices;
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			expectedVertices.insert(expectedVertices.end(), data.Vertices.begin() + submesh.FirstVertex,
+				data.Vertices.begin() + submesh.FirstVertex + submesh.VertexCount);
+			expectedIndices.insert(expectedIndices.end(), data.Indices.begin() + submesh.FirstIndex,
+				data.Indices.begin() + submesh.FirstIndex + submesh.IndexCount);
+		}
+
+		// The OBJ the way Mesh::LoadFromFile goes without a cooked file, and with one
+		double objBest = 1e30;
+		double cookedBest = 1e30;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			MeshData cooked;
+			MeshCooker::CookObj(file, cooked);
+			objBest = std::min(objBest, SecondsSince(start));
+			start = Clock::now();
+			CookedMesh mesh;
+			mesh.Open(cookedFilename);
+			cookedBest = std::min(cookedBest, SecondsSince(start));
+		}
+
+		std::ostringstream results;
+		for (int g = 0; g != 2; ++g)
+		{
+			double best = 1e30;
+			bool succeeded = true;
+			size_t mapped = 0;
+			for (int i = 0; i < Iterations; ++i)
+			{
+				const Clock::time_point start = Clock::now();
+				mapped = LoadGlbGeometry(glbFilenames[g], succeeded, [](const Vertex*, size_t, const uint16_t*, const int*, size_t) {});
+				best = std::min(best, SecondsSince(start));
+			}
+
+			// Positions, normals and tangents exactly, UVs to within their 16 bits
+			std::vector<Vertex> vertices;
+			std::vector<int> indices;
+			LoadGlbGeometry(glbFilenames[g], succeeded, [&](const Vertex* v, size_t vertexCount, const uint16_t* indices16, const int* indices32, size_t indexCount)
+			{
+				vertices.insert(vertices.end(), v, v + vertexCount);
+				if (indices16)
+					indices.insert(indices.end(), indices16, indices16 + indexCount);
+				else
+					indices.insert(indices.end(), indices32, indices32 + indexCount);
+			});
+			bool match = succeeded && vertices.size() == expectedVertices.size() && indices == expectedIndices;
+			for (size_t v = 0; match && v != vertices.size(); ++v)
+			{
+				const Vertex& a = vertices[v];
+				const Vertex& b = expectedVertices[v];
+				match = memcmp(&a.Position, &b.Position, sizeof(a.Position)) == 0 && memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) == 0 &&
+					memcmp(&a.Tangent, &b.Tangent, sizeof(a.Tangent)) == 0 && fabsf(a.UV.x - b.UV.x) <= 1.0f / 65535.0f && fabsf(a.UV.y - b.UV.y) <= 1.0f / 65535.0f;
+			}
+
+			results << (g == 0 ? "interleaved GLB " : ", separate GLB ") << best * 1000.0 << " ms (" << mapped << "/" << data.Submeshes.size()
+				<< " primitives mapped, contents " << (match ? "match" : "MISMATCH") << ")";
+		}
+
+		LOG_INFO << "glTF loading \"" << file << "\": OBJ " << objBest * 1000.0 << " ms, cooked mesh " << cookedBest * 1000.0 << " ms, "
+			<< results.str() << "." << std::endl;
+	}
+	std::remove(cookedFilename.c_str());
+	for (const std::string& filename : glbFilenames)
+		std::remove(filename.c_str());
+}
+
+void BenchmarkTextureStreaming(const std::string&)
+{
+	// 96 square textures of 256 to 2048 texels, block compressed like cooked ones
+	std::vector<uint32_t> sizes;
+	for (int t = 0; t != 96; ++t)
+		sizes.push_back(256u << (t % 4));
+
+	// Unlimited first to see what the path wants, then budgets it has to squeeze into
+	const StreamingRun unlimited = RunTextureStreaming(sizes, size_t(1) << 40, false);
+	const size_t budgets[] = { size_t(1) << 40, unlimited.PeakDesired / 2, unlimited.PeakDesired / 8, unlimited.TailBytes / 2 };
+	for (size_t budget : budgets)
+	{
+		LOG_INFO << "Texture streaming of " << sizes.size() << " textures with a budget of " << budget << " bytes:" << std::endl;
+		const StreamingRun run = RunTextureStreaming(sizes, budget, true);
+		LOG_INFO << "  " << run.Frames << " frames, " << run.UpdateSeconds * 1e6 / run.Frames << " us per update, peak "
+			<< run.PeakResident << " bytes resident and " << run.PeakDesired << " wanted (tails " << run.TailBytes << "), mip bias "
+			<< run.MinBias << " to " << run.MaxBias << ", at most " << run.PeakPending << " pending, " << run.Loads << " loads and "
+			<< run.Evictions << " evictions. " << (run.WithinBudget ? "Within budget" : "OVER BUDGET") << ", device calls "
+			<< (run.DeviceValid ? "valid" : "INVALID") << ", " << (run.Settled ? "settled" : "NOT SETTLED") << "." << std::endl;
+	}
+}
+
+void BenchmarkVirtualTexturing(const std::string& modelFolder)
+{
+	// The textures under models are a few hundred texels at most, far too small to need pages, so every material
+	// stands in for one authored at this size
+	const uint32_t textureSize = 8192;
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data) || data.Materials.empty()) continue;
+
+		DirectX::XMFLOAT3 center{};
+		DirectX::XMFLOAT3 extents{};
+		MeshCooker::ComputeBoundingBox(data.Vertices.data(), data.Vertices.size(), center, extents);
+		const float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&extents)));
+		if (radius <= 0.0f) continue;
+
+		LOG_INFO << "Virtual texturing \"" << file << "\": " << data.Materials.size() << " materials as " << textureSize << " texel textures." << std::endl;
+		std::vector<CameraPose> orbit;
+		std::vector<CameraPose> inside;
+		MakeCameraPaths(center, radius, orbit, inside);
+		const std::vector<CameraPose> recorded = LoadCameraPath(file + ".path");
+		// Room for what a view wants, and a cache too small for it
+		for (uint32_t physicalPages : { 2048u, 256u })
+		{
+			BenchmarkVirtualTexturePath("orbit", data, radius, orbit, textureSize, physicalPages);
+			BenchmarkVirtualTexturePath("inside", data, radius, inside, textureSize, physicalPages);
+			BenchmarkVirtualTexturePath("recorded", data, radius, recorded, textureSize, physicalPages);
+		}
+	}
+}
+
+void BenchmarkTextureAtlas(const std::string& modelFolder)
+{
+	const AtlasSettings settings = MeshCooker::DefaultAtlas();
+	const AtlasSettings noAtlas = {};
+	ImageDecoder decoder;
+	for (const std::string& file : ListFiles(modelFolder, ".obj"))
+	{
+		MeshData data;
+		if (!MeshCooker::CookObj(file, data, true, MeshCooker::DefaultLodChain(), noAtlas)) continue;
+		// Without levels of detail and clusters, like CookObj has it when it packs
+		data.Lods.clear();
+		data.Clusters.clear();
+		const MeshData original = data;
+
+		const std::string folder = GetFolder(file);
+		const std::vector<std::string> maps = MeshCooker::FindAtlasMaps(data);
+		std::vector<AtlasBitmap> images;
+		for (size_t i = 0; i != maps.size(); ++i)
+			images.push_back(LoadAtlasImage(folder + maps[i], uint32_t(i + 1), decoder));
+
+		AtlasStats stats = {};
+		MeshCooker::CountDraws(data, stats.DrawsBefore, stats.BindsBefore, stats.TexturesBefore);
+		const std::string prefix = "benchmark.atlas";
+		std::vector<AtlasBitmap> atlases;
+		const Clock::time_point start = Clock::now();
+		MeshCooker::PackAtlases(data, maps, images, prefix, settings, atlases, stats);
+		const double packSeconds = SecondsSince(start);
+
+		// Where each packed map went, from the UVs that moved: the offset has to be the same for every vertex
+		struct Placement
+		{
+			int Atlas;
+			double X;
+			double Y;
+			bool Found;
+		};
+		std::vector<Placement> placements(maps.size(), Placement{ -1, 0.0, 0.0, false });
+		bool consistent = true;
+		for (const SubmeshRange& submesh : data.Submeshes)
+		{
+			if (submesh.Material < 0) continue;
+			const std::string& map = original.Materials[submesh.Material].DiffuseMap;
+			const std::string& moved = data.Materials[submesh.Material].DiffuseMap;
+			if (map == moved) continue;
+			const size_t i = std::find(maps.begin(), maps.end(), map) - maps.begin();
+			if (i == maps.size() || moved.compare(0, prefix.size(), prefix) != 0)
+			{
+				consistent = false;
+				continue;
+			}
+			const int atlas = atoi(moved.c_str() + prefix.size());
+			if (atlas < 0 || size_t(atlas) >= atlases.size())
+			{
+				consistent = false;
+				continue;
+			}
+			const AtlasBitmap& image = images[i];
+			DirectX::XMFLOAT2 tile;
+			consistent = MeshCooker::FindUvTile(original.Vertices.data() + submesh.FirstVertex, submesh.VertexCount, tile) && consistent;
+			for (uint32_t v = submesh.FirstVertex; v != submesh.FirstVertex + submesh.VertexCount; ++v)
+			{
+				const DirectX::XMFLOAT2& uv = original.Vertices[v].UV;
+				const DirectX::XMFLOAT2& atlasUv = data.Vertices[v].UV;
+				const double u = std::min(std::max(double(uv.x - tile.x), 0.0), 1.0);
+				const double w = std::min(std::max(double(uv.y - tile.y), 0.0), 1.0);
+				const double x = double(atlasUv.x) * atlases[atlas].Width - u * image.Width;
+				const double y = double(atlasUv.y) * atlases[atlas].Height - w * image.Height;
+				Placement& placement = placements[i];
+				if (!placement.Found)
+					placement = { atlas, std::round(x), std::round(y), true };
+				consistent = consistent && placement.Atlas == atlas && std::fabs(x - placement.X) < 0.01 && std::fabs(y - placement.Y) < 0.01;
+			}
+		}
+
+		// Every placement in its atlas with its padding, none overlapping, and the texels there the image's own with the
+		// edge repeated around it
+		const int padding = int(settings.Padding);
+		size_t texelMismatches = 0;
+		for (size_t i = 0; i != maps.size(); ++i)
+		{
+			const Placement& placement = placements[i];
+			if (!placement.Found) continue;
+			const AtlasBitmap& image = images[i];
+			const AtlasBitmap& atlas = atlases[placement.Atlas];
+			const int left = int(placement.X) - padding;
+			const int top = int(placement.Y) - padding;
+			const int right = int(placement.X) + int(image.Width) + padding;
+			const int bottom = int(placement.Y) + int(image.Height) + padding;
+			if (left < 0 || top < 0 || right > int(atlas.Width) || bottom > int(atlas.Height))
+			{
+				consistent = false;
+				continue;
+			}
+			for (size_t j = 0; j != i; ++j)
+			{
+				const Placement& other = placements[j];
+				if (!other.Found || other.Atlas != placement.Atlas) continue;
+				const bool apart = int(other.X) + int(images[j].Width) + padding <= left || right <= int(other.X) - padding
+					|| int(other.Y) + int(images[j].Height) + padding <= top || bottom <= int(other.Y) - padding;
+				consistent = consistent && apart;
+			}
+			for (int y = top; y != bottom; ++y)
+				for (int x = left; x != right; ++x)
+				{
+					const int sx = std::min(std::max(x - int(placement.X), 0), int(image.Width) - 1);
+					const int sy = std::min(std::max(y - int(placement.Y), 0), int(image.Height) - 1);
+					texelMismatches += memcmp(&atlas.Pixels[(size_t(y) * atlas.Width + x) * 4], &image.Pixels[(size_t(sy) * image.Width + sx) * 4], 4) != 0;
+				}
+		}
+
+		// The atlases as written, read back when there is a decoder
+		std::string roundTrip = "no image decoder to read the PNGs back";
+		for (size_t a = 0; a != atlases.size(); ++a)
+		{
+			std::vector<uint8_t> png;
+			TextureAtlas::EncodePng(atlases[a].Pixels.data(), atlases[a].Width, atlases[a].Height, png);
+			std::vector<uint8_t> decoded;
+			UINT width = 0;
+			UINT height = 0;
+			if (!decoder.Decode(reinterpret_cast<const char*>(png.data()), png.size(), decoded, width, height)) break;
+			const bool same = width == atlases[a].Width && height == atlases[a].Height && decoded == atlases[a].Pixels;
+			roundTrip = same && roundTrip != "PNG round trip MISMATCH" ? "PNG round trip matches" : "PNG round trip MISMATCH";
+		}
+
+		const std::vector<uint64_t> before = HashTriangles(data);
+		const Clock::time_point mergeStart = Clock::now();
+		MeshCooker::MergeSubmeshes(data);
+		const double mergeSeconds = SecondsSince(mergeStart);
+		MeshCooker::CountDraws(data, stats.DrawsAfter, stats.BindsAfter, stats.TexturesAfter);
+		const bool merged = before == HashTriangles(data);
+
+		LOG_INFO << "Texture atlas \"" << file << "\": " << maps.size() << " maps can be packed, " << stats.ImagesPacked << " packed into "
+			<< stats.Atlases << " atlases of " << stats.AtlasTexels << " texels, " << (stats.AtlasTexels ? 100.0 * stats.ImageTexels / stats.AtlasTexels : 0.0)
+			<< "% occupied, in " << packSeconds * 1e3 << " ms. Draws " << stats.DrawsBefore << " -> " << stats.DrawsAfter << ", texture binds "
+			<< stats.BindsBefore << " -> " << stats.BindsAfter << ", textures " << stats.TexturesBefore << " -> " << stats.TexturesAfter
+			<< ", merged in " << mergeSeconds * 1e3 << " ms." << std::endl;
+		LOG_INFO << "  UVs and placements " << (consistent ? "consistent" : "INCONSISTENT") << ", " << texelMismatches << " texel mismatches, "
+			<< "triangles " << (merged ? "match" : "MISMATCH") << " after merging, " << roundTrip << "." << std::endl;
+	}
+}
+
+void BenchmarkAsyncLoading(const std::string& modelFolder)
+{
+	// The queue on its own: every item has to come out once, and each producer's in the order it pushed them
+	{
+		const int producers = 4;
+		const int itemsPerProducer = 250000;
+		CompletionQueue<std::pair<int, int>> queue;
+		std::vector<std::thread> threads;
+		const Clock::time_point start = Clock::now();
+		for (int p = 0; p < producers; ++p)
+			threads.emplace_back([&queue, p]
+			{
+				for (int i = 0; i < itemsPerProducer; ++i)
+					queue.Push(std::make_pair(p, i));
+			});
+
+		std::vector<int> next(producers, 0);
+		std::vector<std::pair<int, int>> popped;
+		size_t received = 0;
+		size_t pops = 0;
+		bool consistent = true;
+		while (received < size_t(producers) * itemsPerProducer)
+		{
+			popped.clear();
+			received += queue.PopAll(popped);
+			pops += popped.empty() ? 0 : 1;
+			for (const auto& item : popped)
+			{
+				consistent = consistent && item.first >= 0 && item.first < producers && item.second == next[item.first];
+				if (item.first >= 0 && item.first < producers) next[item.first] = item.second + 1;
+			}
+		}
+		for (std::thread& thread : threads) thread.join();
+		consistent = consistent && queue.IsEmpty() && received == size_t(producers) * itemsPerProducer;
+		const double seconds = SecondsSince(start);
+
+		LOG_INFO << "CompletionQueue: " << producers << " producers pushed " << received << " items in " << seconds * 1000.0 << " ms ("
+			<< received / seconds / 1e6 << " M/s), taken in " << pops << " pops, " << (consistent ? "consistent" : "INCONSISTENT") << "." << std::endl;
+	}
+
+	const std::vector<std::string> files = ListFiles(modelFolder, ".obj");
+	if (files.empty()) return;
+
+	// Blocking, one model after another, the way Game::Init loaded them. Also leaves every cooked mesh up to date.
+	Clock::time_point start = Clock::now();
+	size_t prepared = 0;
+	for (const std::string& file : files)
+	{
+		PreparedModel model;
+		if (Mesh::PrepareFile(file, VertexFormatQuantized, model)) ++prepared;
+	}
+	const double blockingSeconds = SecondsSince(start);
+
+	// In the background, with a frame loop at 60 Hz taking what arrives. The first frame can be drawn as soon as
+	// everything is queued.
+	start = Clock::now();
+	AssetLoader loader(nullptr, nullptr, nullptr, nullptr);
+	for (const std::string& file : files)
+		loader.LoadModel(file, VertexFormatQuantized);
+	const double firstFrameSeconds = SecondsSince(start);
+
+	std::vector<AssetHandle> changed;
+	int frames = 0;
+	double firstModelSeconds = 0.0;
+	while (!loader.IsIdle())
+	{
+		const Clock::time_point frameStart = Clock::now();
+		changed.clear();
+		loader.Update(changed);
+		if (firstModelSeconds == 0.0 && !changed.empty()) firstModelSeconds = SecondsSince(start);
+		++frames;
+		std::this_thread::sleep_until(frameStart + std::chrono::microseconds(16667));
+	}
+	const double asyncSeconds = SecondsSince(start);
+
+	const AssetLoaderStats& stats = loader.GetStats();
+	const bool complete = stats.Ready == prepared && stats.Failed == files.size() - prepared;
+	LOG_INFO << "Async loading " << files.size() << " models: blocking " << blockingSeconds * 1000.0 << " ms before the first frame; in the background first frame after "
+		<< firstFrameSeconds * 1000.0 << " ms, first model after " << firstModelSeconds * 1000.0 << " ms, all after " << asyncSeconds * 1000.0 << " ms over "
+		<< frames << " frames, longest Update " << stats.LongestUpdateSeconds * 1000.0 << " ms, " << stats.LoadSeconds * 1000.0
+		<< " ms of loading off the frame loop, models " << (complete ? "complete" : "INCOMPLETE") << "." << std::endl;
+}
+
+void BenchmarkAssetCache(const std::string& modelFolder)
+{
+	// Scenes of assets picked with a skew towards a few popular ones, each scene acquiring its assets, inserting the
+	// missing ones as if loaded, then releasing the previous scene's. A plain list and map replays the same scenes as
+	// the reference the cache has to agree with.
+	const int assetCount = 2000;
+	const int sceneCount = 2000;
+	const int assetsPerScene = 40;
+	std::mt19937 random(740);
+	std::vector<size_t> cpuBytes(assetCount);
+	std::vector<size_t> gpuBytes(assetCount);
+	size_t totalBytes = 0;
+	for (int a = 0; a < assetCount; ++a)
+	{
+		cpuBytes[a] = 1024 + random() % (256 * 1024);
+		gpuBytes[a] = random() % (16 * 1024 * 1024);
+		totalBytes += cpuBytes[a] + gpuBytes[a];
+	}
+	std::vector<std::vector<int>> scenes(sceneCount);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	for (std::vector<int>& scene : scenes)
+	{
+		while (int(scene.size()) < assetsPerScene)
+		{
+			// About Zipf with exponent 1 over the assets
+			const int a = std::min(assetCount - 1, int(std::pow(double(assetCount), uniform(random))) - 1);
+			if (std::find(scene.begin(), scene.end(), a) == scene.end()) scene.push_back(a);
+		}
+	}
+	std::vector<std::string> ids(assetCount);
+	for (int a = 0; a < assetCount; ++a)
+		ids[a] = "asset" + std::to_string(a);
+
+	for (int divisor : { 0, 64, 16, 4, 1 })
+	{
+		const size_t budget = divisor ? totalBytes / divisor : 0;
+		AssetCache cache(budget);
+
+		struct Reference
+		{
+			int References;
+			std::list<int>::iterator Recent;
+		};
+		std::list<int> recent;
+		std::map<int, Reference> reference;
+		size_t referenceBytes = 0;
+		size_t referenceHits = 0;
+		size_t referenceEvictions = 0;
+		const auto referenceTrim = [&]()
+		{
+			while (!recent.empty() && referenceBytes > budget)
+			{
+				const int a = recent.front();
+				recent.pop_front();
+				reference.erase(a);
+				referenceBytes -= cpuBytes[a] + gpuBytes[a];
+				++referenceEvictions;
+			}
+		};
+
+		bool consistent = true;
+		double seconds = 0.0;
+		size_t operations = 0;
+		const std::vector<int>* previous = nullptr;
+		std::vector<std::shared_ptr<int>> held;
+		for (const std::vector<int>& scene : scenes)
+		{
+			const Clock::time_point start = Clock::now();
+			for (int a : scene)
+			{
+				std::shared_ptr<int> asset = cache.Acquire<int>(ids[a]);
+				if (!asset)
+				{
+					asset = std::make_shared<int>(a);
+					cache.Insert(ids[a], asset, cpuBytes[a], gpuBytes[a]);
+				}
+				consistent = consistent && *asset == a;
+				held.push_back(asset);
+			}
+			if (previous)
+				for (int a : *previous)
+					cache.Release(ids[a]);
+			seconds += SecondsSince(start);
+			operations += scene.size() + (previous ? previous->size() : 0);
+
+			for (int a : scene)
+			{
+				const auto found = reference.find(a);
+				if (found != reference.end())
+				{
+					++referenceHits;
+					if (found->second.References++ == 0) recent.erase(found->second.Recent);
+					continue;
+				}
+				reference[a] = { 1, recent.end() };
+				referenceBytes += cpuBytes[a] + gpuBytes[a];
+				referenceTrim();
+			}
+			if (previous)
+			{
+				for (int a : *previous)
+				{
+					Reference& r = reference[a];
+					if (--r.References == 0) r.Recent = recent.insert(recent.end(), a);
+				}
+				referenceTrim();
+			}
+			held.erase(held.begin(), held.end() - scene.size());
+			previous = &scene;
+
+			// Assets in use are never evicted, and the cache holds what the reference does
+			consistent = consistent && cache.Validate() && cache.GetStats().Hits == referenceHits && cache.GetStats().Evictions == referenceEvictions
+				&& cache.GetStats().Assets == reference.size() && cache.GetStats().CpuBytes + cache.GetStats().GpuBytes == referenceBytes;
+			for (int a : scene)
+				consistent = consistent && cache.GetReferences(ids[a]) == 1;
+		}
+		for (int a : *previous)
+			cache.Release(ids[a]);
+		held.clear();
+		const AssetCacheStats afterRelease = cache.GetStats();
+		cache.EvictUnreferenced();
+		consistent = consistent && cache.Validate() && cache.GetStats().Assets == 0 && cache.GetStats().CpuBytes + cache.GetStats().GpuBytes == 0;
+
+		const AssetCacheStats& stats = cache.GetStats();
+		LOG_INFO << "Asset cache with a budget of " << (divisor ? 100.0 / divisor : 0.0) << "% of " << totalBytes / (1024 * 1024) << " MB: "
+			<< 100.0 * stats.Hits / (stats.Hits + stats.Misses) << "% hit rate over " << sceneCount << " scenes, " << afterRelease.Evictions
+			<< " evictions freeing " << afterRelease.EvictedBytes / (1024 * 1024) << " MB, " << seconds * 1e9 / operations << " ns per acquire or release, "
+			<< (consistent ? "consistent" : "INCONSISTENT") << "." << std::endl;
+	}
+
+	// Every model through an AssetLoader twice, the second time from the cache
+	const std::vector<std::string> files = ListFiles(modelFolder, ".obj");
+	if (files.empty()) return;
+	AssetCache cache(256 * 1024 * 1024);
+	double loadSeconds[2] = {};
+	size_t reused[2] = {};
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const Clock::time_point start = Clock::now();
+		AssetLoader loader(nullptr, nullptr, nullptr, nullptr);
+		loader.SetCache(&cache);
+		for (const std::string& file : files)
+			loader.LoadModel(file, VertexFormatQuantized);
+		std::vector<AssetHandle> changed;
+		while (!loader.IsIdle())
+		{
+			changed.clear();
+			loader.Update(changed);
+			std::this_thread::yield();
+		}
+		loadSeconds[pass] = SecondsSince(start);
+		reused[pass] = loader.GetStats().Reused;
+	}
+	const bool reusedAll = reused[0] == 0 && reused[1] == cache.GetStats().Assets && cache.Validate();
+	LOG_INFO << "Loading " << files.size() << " models: " << loadSeconds[0] * 1000.0 << " ms, again with them cached " << loadSeconds[1] * 1000.0
+		<< " ms, " << reused[1] << " taken from the cache, " << (reusedAll ? "consistent" : "INCONSISTENT") << "." << std::endl;
+	cache.LogStats();
+}
+
+void BenchmarkAssetRegistry(const std::string&)
+{
+	// Readers on all but two cores going through every slot, writers replacing versions of their own slots, and
+	// Reclaim at frame boundaries. A version is poisoned when deleted, so a reader holding one past its reclamation
+	// sees it, and each reader checks versions of a slot never go back.
+	struct Version
+	{
+		Version(uint32_t slot, uint64_t serial, std::atomic<int>* live) : Slot(slot), Serial(serial), Check(serial * 2654435761u + slot), Live(live) { ++*Live; }
+		~Version() { Check = 0; --*Live; }
+		bool IsValid(uint32_t slot) const { return Slot == slot && Check == Serial * 2654435761u + slot; }
+		uint32_t Slot;
+		uint64_t Serial;
+		uint64_t Check;
+		std::atomic<int>* Live;
+	};
+
+	const uint32_t slotCount = 256;
+	const int writerCount = 2;
+	const int readerCount = std::max(2, int(std::thread::hardware_concurrency()) - writerCount);
+	std::atomic<int> live(0);
+	{
+		AssetRegistry<Version> registry(slotCount);
+		for (uint32_t slot = 0; slot != slotCount; ++slot)
+			registry.Add(std::unique_ptr<Version>(new Version(slot, 0, &live)));
+
+		std::atomic<bool> stop(false);
+		std::atomic<bool> consistent(true);
+		std::atomic<size_t> reads(0);
+		std::vector<std::thread> threads;
+		for (int r = 0; r < readerCount; ++r)
+		{
+			threads.emplace_back([&]
+			{
+				const int reader = registry.RegisterReader();
+				std::vector<uint64_t> seen(slotCount, 0);
+				std::vector<const Version*> held(slotCount);
+				size_t count = 0;
+				bool ok = reader >= 0;
+				while (ok && !stop.load(std::memory_order_relaxed))
+				{
+					AssetRegistry<Version>::ReadScope scope(registry, reader);
+					for (uint32_t slot = 0; slot != slotCount; ++slot)
+					{
+						const Version* version = registry.Get(slot);
+						ok = ok && version && version->IsValid(slot) && version->Serial >= seen[slot];
+						if (!ok) break;
+						seen[slot] = version->Serial;
+						held[slot] = version;
+					}
+					// Everything got in the scope is still there at its end
+					for (uint32_t slot = 0; ok && slot != slotCount; ++slot)
+						ok = held[slot]->IsValid(slot);
+					count += slotCount;
+				}
+				if (reader >= 0) registry.UnregisterReader(reader);
+				if (!ok) consistent = false;
+				reads += count;
+			});
+		}
+		std::atomic<size_t> publishes(0);
+		for (int w = 0; w < writerCount; ++w)
+		{
+			threads.emplace_back([&, w]
+			{
+				std::mt19937 random(740 + w);
+				uint64_t serial = 0;
+				size_t count = 0;
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					// Slots of this writer only, so versions of a slot come in order
+					const uint32_t slot = uint32_t(random() % (slotCount / writerCount)) * writerCount + w;
+					registry.Publish(slot, std::unique_ptr<Version>(new Version(slot, ++serial, &live)));
+					++count;
+				}
+				publishes += count;
+			});
+		}
+
+		const Clock::time_point start = Clock::now();
+		size_t frames = 0;
+		size_t mostPending = 0;
+		while (SecondsSince(start) < 1.0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+			registry.Reclaim();
+			mostPending = std::max(mostPending, registry.GetStats().Pending);
+			++frames;
+		}
+		stop = true;
+		for (std::thread& thread : threads) thread.join();
+		const double seconds = SecondsSince(start);
+
+		// With every reader gone everything retired goes
+		registry.Reclaim();
+		const AssetRegistryStats stats = registry.GetStats();
+		const bool reclaimedAll = stats.Pending == 0 && stats.Reclaimed == stats.Published && live.load() == int(slotCount);
+		LOG_INFO << "Asset registry stress: " << readerCount << " readers did " << reads.load() / seconds / 1e6 << " M reads/s while "
+			<< writerCount << " writers published " << publishes.load() / seconds / 1e3 << " K versions/s, reclaimed over " << frames
+			<< " frames with at most " << mostPending << " pending, " << (consistent && reclaimedAll ? "consistent" : "INCONSISTENT") << "." << std::endl;
+	}
+	const bool freed = live.load() == 0;
+
+	// Read side on one thread: a frame of lookups through the registry, against the shared_ptr array GameEntity reads
+	// directly and against std::atomic_load of a shared_ptr, the lock-free alternative with a reference count
+	{
+		const uint32_t entityCount = 1024;
+		const int frameCount = 2000;
+		std::vector<std::shared_ptr<Version>> direct;
+		AssetRegistry<Version> registry(entityCount);
+		for (uint32_t e = 0; e != entityCount; ++e)
+		{
+			direct.push_back(std::make_shared<Version>(e, 1, &live));
+			registry.Add(std::unique_ptr<Version>(new Version(e, 1, &live)));
+		}
+		const int reader = registry.RegisterReader();
+
+		uint64_t sum = 0;
+		Clock::time_point start = Clock::now();
+		for (int f = 0; f < frameCount; ++f)
+			for (uint32_t e = 0; e != entityCount; ++e)
+				sum += direct[e].get()->Serial;
+		const double directSeconds = SecondsSince(start);
+
+		start = Clock::now();
+		for (int f = 0; f < frameCount; ++f)
+		{
+			registry.Enter(reader);
+			for (uint32_t e = 0; e != entityCount; ++e)
+				sum += registry.Get(e)->Serial;
+			registry.Exit(reader);
+			registry.Reclaim();
+		}
+		const double registrySeconds = SecondsSince(start);
+
+		start = Clock::now();
+		for (int f = 0; f < frameCount / 10; ++f)
+			for (uint32_t e = 0; e != entityCount; ++e)
+				sum += std::atomic_load(&direct[e])->Serial;
+		const double sharedSeconds = SecondsSince(start) * 10.0;
+
+		const double lookups = double(frameCount) * entityCount;
+		LOG_INFO << "Asset registry read side over " << entityCount << " entities: direct " << directSeconds * 1e9 / lookups << " ns, registry "
+			<< registrySeconds * 1e9 / lookups << " ns with Enter, Exit and Reclaim every frame, atomic shared_ptr " << sharedSeconds * 1e9 / lookups
+			<< " ns per lookup (" << (sum == uint64_t(frameCount) * entityCount * 2 + uint64_t(frameCount / 10) * entityCount ? "consistent" : "INCONSISTENT")
+			<< ", versions " << (freed ? "freed" : "LEAKED") << ")." << std::endl;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+
+// Headless benchmarks. Started with "-benchmark" on the command line,
+// no window or D3D device is created. Results go to the default logger.
+// Components that build without the Windows SDK have bench executables under Tests instead.
+void RunBenchmarks(const std::string& modelFolder);
+
+// OBJ/MTL text parsing throughput for every model under modelFolder
+void BenchmarkObjParser(const std::string& modelFolder);
+
+// Chunked parallel OBJ parsing with 1..N threads, checked against the sequential parser
+void BenchmarkObjParserScaling(const std::string& modelFolder);
+
+// Round-trip error and GPU byte count of each packed vertex format with 16-bit indices
+void BenchmarkVertexPacking(const std::string& modelFolder);
+
+// MikkTSpace tangent generation throughput, single threaded and across submeshes on 1..N threads. Every face corner
+// is checked against the reference port of mikktspace.c.
+void BenchmarkTangentGenerator(const std::string& modelFolder);
+
+// Parallel decoding of every texture map under modelFolder with 1..N threads, and the memory saved by sharing
+// identical images
+void BenchmarkTextureDecode(const std::string& modelFolder);
+
+// Time to cook one synthetic color texture with its mips the way the texture loader does. Block compression on its
+// own is timed by Tests/BlockCompressorBench. Needs no files, modelFolder is unused.
+void BenchmarkTextureCooker(const std::string& modelFolder);
+
+// Mip chain generation throughput per filter with 1..N threads on synthetic color and normal images. Normals are
+// checked to stay unit length and sRGB filtering to happen in linear light. Needs no files, modelFolder is unused.
+void BenchmarkMipGenerator(const std::string& modelFolder);
+
+// Level of detail chain generation throughput, and triangles per frame with screen size based selection
+void BenchmarkMeshSimplifier(const std::string& modelFolder);
+
+// Cull rates and cost per cluster of SIMD and scalar cluster culling along camera paths around and through
+// every model. "<model>.obj.path" files recorded in the game with B are replayed as well.
+void BenchmarkClusterCulling(const std::string& modelFolder);
+
+// Incremental cook of modelFolder twice in a row. The second one must find everything up to date from file stamps
+// alone, its time is the cost of a rebuild with nothing to do.
+void BenchmarkAssetCooker(const std::string& modelFolder);
+
+// Loading every asset under modelFolder from loose files, from an uncompressed archive used in place and from an LZ4
+// archive, once with the files dropped from the file cache and then warm. Checks all three see the same contents,
+// and times decompressing the LZ4 archive on 1..N threads.
+void BenchmarkAssetArchive(const std::string& modelFolder);
+
+// Compression ratio and single threaded decode speed of the mesh codec on the cooked vertices and indices of every
+// model, next to the ratio plain LZ4 gets on the same bytes. Checks the decoded buffers match.
+void BenchmarkMeshCodec(const std::string& modelFolder);
+
+// Cooking every model with StreamingMeshCooker next to the in-memory cook: with the default budget the cooked files
+// have to be the same, with a 1 MB one groups get split and every triangle still has to be there. Throughput and peak
+// memory of both.
+void BenchmarkStreamingMeshCooker(const std::string& modelFolder);
+
+// Every model written as GLB twice, with attributes interleaved like Vertex and with separate accessors and 16 bit UVs,
+// then the CPU side of GltfLoader on both next to cooking the OBJ and opening its cooked mesh. Checks the GLBs give
+// back the vertices and indices they were written from.
+void BenchmarkGltfLoader(const std::string& modelFolder);
+
+// TextureResidency on a fake device along a camera path down a row of textured objects, with no budget, half and an
+// eighth of what the path wants and less than the smallest mips need. Checks resident memory stays in the budget,
+// the device is only asked what it allows, and everything reaches its target once the camera stops. Needs no
+// files, modelFolder is unused.
+void BenchmarkTextureStreaming(const std::string& modelFolder);
+
+// Every material of every model as an 8192 texel virtual texture in a VirtualTextureCache, with page requests worked
+// out on the CPU from the triangles in view, along the orbit and inside camera paths and "<model>.obj.path" when
+// there is one. A cache with room for the views and one too small for them. Logs hit rate and resident memory along
+// the paths, and checks the page tables and the cache agree after every frame.
+void BenchmarkVirtualTexturing(const std::string& modelFolder);
+
+// The small diffuse maps of every model packed into atlases the way MeshCooker does at cook time, then submeshes that
+// share a material merged. Checks every moved UV lands on its map's place, placements are apart and inside their
+// atlas, the texels there and the padding around them are the map's, and merging keeps every triangle. Logs
+// occupancy and the draws, binds and textures saved. Without an image decoder the maps are patterns of their size.
+void BenchmarkTextureAtlas(const std::string& modelFolder);
+
+// CompletionQueue with producers pushing as fast as they can, checked for every item arriving once and in order per
+// producer. Then every model loaded blocking one after another, next to AssetLoader with a 60 Hz frame loop running:
+// time to the first frame, to the first model and to all of them, and the longest frame Update took.
+void BenchmarkAsyncLoading(const std::string& modelFolder);
+
+// AssetCache replaying scenes of synthetic assets, a few of them popular, at budgets from nothing to everything: hit
+// rate, evictions and the cost of an acquire or release. Checked after every scene against a plain LRU list replaying
+// the same scenes, and for assets in use never being evicted. Then every model under modelFolder loaded through
+// AssetLoader twice, the second time from the cache.
+void BenchmarkAssetCache(const std::string& modelFolder);
+
+// AssetRegistry with readers on most cores going through every slot while two writers publish new versions and the
+// main thread reclaims every half millisecond. Checks no reader sees a reclaimed or out of order version and every
+// replaced version gets reclaimed. Then the cost of a lookup through the registry on one thread, next to reading
+// the shared_ptr array directly like GameEntity did and to std::atomic_load of a shared_ptr. Needs no files,
+// modelFolder is unused.
+void BenchmarkAssetRegistry(const std::string& modelFolder);
@@ -0,0 +1,707 @@
+#include "BlockCompressor.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <DirectXMath.h>
+
+namespace
+{
+	// The 16 pixels of a block in 0..255, four per vector, one set of vectors per channel
+	struct PixelBlock
+	{
+		DirectX::XMVECTOR Channels[4][4];
+	};
+
+	PixelBlock LoadBlock(const uint8_t pixels[64])
+	{
+		PixelBlock block;
+		for (int c = 0; c != 4; ++c)
+			for (int g = 0; g != 4; ++g)
+			{
+				const uint8_t* p = pixels + g * 16 + c;
+				block.Channels[c][g] = DirectX::XMVectorSet(p[0], p[4], p[8], p[12]);
+			}
+		return block;
+	}
+
+	float SumLanes(DirectX::FXMVECTOR v)
+	{
+		return DirectX::XMVectorGetX(v) + DirectX::XMVectorGetY(v) + DirectX::XMVectorGetZ(v) + DirectX::XMVectorGetW(v);
+	}
+
+	// Mean and principal axis of the colors in channels [first, first + count), the axis by power iteration on
+	// their covariance. A block of one color keeps the first channel as axis.
+	void FindAxis(const PixelBlock& block, int first, int count, float mean[4], float axis[4])
+	{
+		for (int c = first; c != first + count; ++c)
+		{
+			const DirectX::XMVECTOR* v = block.Channels[c];
+			mean[c] = SumLanes(DirectX::XMVectorAdd(DirectX::XMVectorAdd(v[0], v[1]), DirectX::XMVectorAdd(v[2], v[3]))) / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = first; i != first + count; ++i)
+			for (int j = i; j != first + count; ++j)
+			{
+				const DirectX::XMVECTOR meanI = DirectX::XMVectorReplicate(mean[i]);
+				const DirectX::XMVECTOR meanJ = DirectX::XMVectorReplicate(mean[j]);
+				DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+				for (int g = 0; g != 4; ++g)
+					sum = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSubtract(block.Channels[i][g], meanI),
+						DirectX::XMVectorSubtract(block.Channels[j][g], meanJ), sum);
+				covariance[i][j] = covariance[j][i] = SumLanes(sum);
+			}
+
+		// Start along the channel that varies most, it is never orthogonal to the principal axis
+		int widest = first;
+		for (int c = first; c != first + count; ++c)
+			if (covariance[c][c] > covariance[widest][widest]) widest = c;
+		for (int c = 0; c != 4; ++c)
+			axis[c] = c == widest ? 1.0f : 0.0f;
+
+		for (int iteration = 0; iteration != 8; ++iteration)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int i = first; i != first + count; ++i)
+			{
+				for (int j = first; j != first + count; ++j)
+					next[i] += covariance[i][j] * axis[j];
+				largest = std::max(largest, std::abs(next[i]));
+			}
+			if (largest == 0.0f) break;
+			for (int c = first; c != first + count; ++c)
+				axis[c] = next[c] / largest;
+		}
+
+		float length = 0.0f;
+		for (int c = first; c != first + count; ++c)
+			length += axis[c] * axis[c];
+		length = std::sqrt(length);
+		for (int c = first; c != first + count; ++c)
+			axis[c] /= length;
+	}
+
+	// Endpoints spanning the projections of the colors onto the axis, low to high
+	void FitEndpoints(const PixelBlock& block, int first, int count, float low[4], float high[4])
+	{
+		float mean[4];
+		float axis[4];
+		FindAxis(block, first, count, mean, axis);
+
+		DirectX::XMVECTOR minimum = DirectX::XMVectorReplicate(FLT_MAX);
+		DirectX::XMVECTOR maximum = DirectX::XMVectorReplicate(-FLT_MAX);
+		for (int g = 0; g != 4; ++g)
+		{
+			DirectX::XMVECTOR projection = DirectX::XMVectorZero();
+			for (int c = first; c != first + count; ++c)
+				projection = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSubtract(block.Channels[c][g], DirectX::XMVectorReplicate(mean[c])),
+					DirectX::XMVectorReplicate(axis[c]), projection);
+			minimum = DirectX::XMVectorMin(minimum, projection);
+			maximum = DirectX::XMVectorMax(maximum, projection);
+		}
+		DirectX::XMFLOAT4 lows;
+		DirectX::XMFLOAT4 highs;
+		DirectX::XMStoreFloat4(&lows, minimum);
+		DirectX::XMStoreFloat4(&highs, maximum);
+		const float lowest = std::min(std::min(lows.x, lows.y), std::min(lows.z, lows.w));
+		const float highest = std::max(std::max(highs.x, highs.y), std::max(highs.z, highs.w));
+
+		for (int c = first; c != first + count; ++c)
+		{
+			low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lowest));
+			high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * highest));
+		}
+	}
+
+	// Nearest palette entry of every pixel over channels [first, first + count), returns the summed squared error
+	float FindIndices(const PixelBlock& block, int first, int count, const float (*palette)[4], int paletteSize, uint8_t indices[16])
+	{
+		float error = 0.0f;
+		for (int g = 0; g != 4; ++g)
+		{
+			DirectX::XMVECTOR best = DirectX::XMVectorReplicate(FLT_MAX);
+			DirectX::XMVECTOR bestIndex = DirectX::XMVectorZero();
+			for (int k = 0; k != paletteSize; ++k)
+			{
+				DirectX::XMVECTOR distance = DirectX::XMVectorZero();
+				for (int c = first; c != first + count; ++c)
+				{
+					const DirectX::XMVECTOR d = DirectX::XMVectorSubtract(block.Channels[c][g], DirectX::XMVectorReplicate(palette[k][c]));
+					distance = DirectX::XMVectorMultiplyAdd(d, d, distance);
+				}
+				const DirectX::XMVECTOR closer = DirectX::XMVectorLess(distance, best);
+				best = DirectX::XMVectorSelect(best, distance, closer);
+				bestIndex = DirectX::XMVectorSelect(bestIndex, DirectX::XMVectorReplicate(float(k)), closer);
+			}
+
+			DirectX::XMFLOAT4 stored;
+			DirectX::XMStoreFloat4(&stored, bestIndex);
+			indices[g * 4 + 0] = uint8_t(stored.x);
+			indices[g * 4 + 1] = uint8_t(stored.y);
+			indices[g * 4 + 2] = uint8_t(stored.z);
+			indices[g * 4 + 3] = uint8_t(stored.w);
+			error += SumLanes(best);
+		}
+		return error;
+	}
+
+	// Endpoints with the least squared error for fixed per pixel weights of the second endpoint.
+	// Fails when all weights are the same and the system has no single solution.
+	bool SolveEndpoints(const uint8_t pixels[64], int first, int count, const float weights[16], float low[4], float high[4])
+	{
+		float aa = 0.0f;
+		float bb = 0.0f;
+		float ab = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i != 16; ++i)
+		{
+			const float b = weights[i];
+			const float a = 1.0f - b;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int c = first; c != first + count; ++c)
+			{
+				ax[c] += a * pixels[i * 4 + c];
+				bx[c] += b * pixels[i * 4 + c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f) return false;
+		for (int c = first; c != first + count; ++c)
+		{
+			low[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+			high[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+		}
+		return true;
+	}
+
+	// Bits are stored from the lowest bit of the first byte up, the order BC7 uses
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* output) : output(output), position(0) {}
+
+		void Write(uint32_t value, int bits)
+		{
+			for (int b = 0; b != bits; ++b, ++position)
+				if ((value >> b) & 1) output[position / 8] |= uint8_t(1 << (position % 8));
+		}
+
+	private:
+		uint8_t* output;
+		int position;
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8_t* input) : input(input), position(0) {}
+
+		uint32_t Read(int bits)
+		{
+			uint32_t value = 0;
+			for (int b = 0; b != bits; ++b, ++position)
+				value |= uint32_t((input[position / 8] >> (position % 8)) & 1) << b;
+			return value;
+		}
+
+	private:
+		const uint8_t* input;
+		int position;
+	};
+
+	// BC1
+
+	uint16_t To565(const float color[4])
+	{
+		const int r = std::min(31, std::max(0, int(color[0] * 31.0f / 255.0f + 0.5f)));
+		const int g = std::min(63, std::max(0, int(color[1] * 63.0f / 255.0f + 0.5f)));
+		const int b = std::min(31, std::max(0, int(color[2] * 31.0f / 255.0f + 0.5f)));
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void From565(uint16_t value, float color[4])
+	{
+		const int r = value >> 11;
+		const int g = (value >> 5) & 63;
+		const int b = value & 31;
+		color[0] = float((r << 3) | (r >> 2));
+		color[1] = float((g << 2) | (g >> 4));
+		color[2] = float((b << 3) | (b >> 2));
+		color[3] = 255.0f;
+	}
+
+	// The four color palette, which BC3 always uses and BC1 uses when the first endpoint is larger
+	void MakeBC1Palette(uint16_t c0, uint16_t c1, bool fourColors, float palette[4][4])
+	{
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int c = 0; c != 3; ++c)
+		{
+			if (fourColors)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+				palette[3][c] = 0.0f;
+			}
+		}
+		palette[2][3] = 255.0f;
+		palette[3][3] = fourColors ? 255.0f : 0.0f;
+	}
+
+	float EvaluateBC1(const PixelBlock& block, uint16_t c0, uint16_t c1, uint8_t indices[16])
+	{
+		float palette[4][4];
+		MakeBC1Palette(c0, c1, true, palette);
+		return FindIndices(block, 0, 3, palette, 4, indices);
+	}
+
+	void EncodeBC1(const uint8_t pixels[64], const PixelBlock& block, uint8_t* output)
+	{
+		float low[4];
+		float high[4];
+		FitEndpoints(block, 0, 3, low, high);
+		uint16_t c0 = To565(high);
+		uint16_t c1 = To565(low);
+		uint8_t indices[16];
+		float error = EvaluateBC1(block, c0, c1, indices);
+
+		// Refit the endpoints to the pixels each index covers
+		static const float Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float weights[16];
+		for (int i = 0; i != 16; ++i)
+			weights[i] = Weights[indices[i]];
+		if (SolveEndpoints(pixels, 0, 3, weights, high, low))
+		{
+			const uint16_t refined0 = To565(high);
+			const uint16_t refined1 = To565(low);
+			uint8_t refinedIndices[16];
+			const float refinedError = EvaluateBC1(block, refined0, refined1, refinedIndices);
+			if (refinedError < error)
+			{
+				c0 = refined0;
+				c1 = refined1;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+		}
+
+		// The four color mode needs the first endpoint larger, swapping them swaps indices 0 and 1, and 2 and 3
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+			for (uint8_t& index : indices) index ^= 1;
+		}
+		else if (c0 == c1)
+			memset(indices, 0, sizeof(indices));
+
+		uint32_t bits = 0;
+		for (int i = 0; i != 16; ++i)
+			bits |= uint32_t(indices[i]) << (2 * i);
+		output[0] = uint8_t(c0);
+		output[1] = uint8_t(c0 >> 8);
+		output[2] = uint8_t(c1);
+		output[3] = uint8_t(c1 >> 8);
+		for (int b = 0; b != 4; ++b)
+			output[4 + b] = uint8_t(bits >> (8 * b));
+	}
+
+	void DecodeBC1(const uint8_t* input, bool alwaysFourColors, uint8_t pixels[64])
+	{
+		const uint16_t c0 = uint16_t(input[0] | (input[1] << 8));
+		const uint16_t c1 = uint16_t(input[2] | (input[3] << 8));
+		float palette[4][4];
+		MakeBC1Palette(c0, c1, alwaysFourColors || c0 > c1, palette);
+
+		const uint32_t bits = uint32_t(input[4]) | (uint32_t(input[5]) << 8) | (uint32_t(input[6]) << 16) | (uint32_t(input[7]) << 24);
+		for (int i = 0; i != 16; ++i)
+		{
+			const float* color = palette[(bits >> (2 * i)) & 3];
+			for (int c = 0; c != 4; ++c)
+				pixels[i * 4 + c] = uint8_t(color[c] + 0.5f);
+		}
+	}
+
+	// BC4, also the alpha block of BC3 and both halves of BC5
+
+	void MakeBC4Palette(int a0, int a1, int channel, float palette[8][4])
+	{
+		palette[0][channel] = float(a0);
+		palette[1][channel] = float(a1);
+		if (a0 > a1)
+		{
+			for (int i = 2; i != 8; ++i)
+				palette[i][channel] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+		}
+		else
+		{
+			for (int i = 2; i != 6; ++i)
+				palette[i][channel] = ((6 - i) * a0 + (i - 1) * a1) / 5.0f;
+			palette[6][channel] = 0.0f;
+			palette[7][channel] = 255.0f;
+		}
+	}
+
+	void EncodeBC4(const PixelBlock& block, int channel, uint8_t* output)
+	{
+		const DirectX::XMVECTOR* v = block.Channels[channel];
+		DirectX::XMFLOAT4 lows;
+		DirectX::XMFLOAT4 highs;
+		DirectX::XMStoreFloat4(&lows, DirectX::XMVectorMin(DirectX::XMVectorMin(v[0], v[1]), DirectX::XMVectorMin(v[2], v[3])));
+		DirectX::XMStoreFloat4(&highs, DirectX::XMVectorMax(DirectX::XMVectorMax(v[0], v[1]), DirectX::XMVectorMax(v[2], v[3])));
+		const int a0 = int(std::max(std::max(highs.x, highs.y), std::max(highs.z, highs.w)));
+		const int a1 = int(std::min(std::min(lows.x, lows.y), std::min(lows.z, lows.w)));
+
+		// The eight value mode between the extremes, all indices 0 when the block is flat
+		uint64_t bits = 0;
+		if (a0 > a1)
+		{
+			float palette[8][4];
+			MakeBC4Palette(a0, a1, channel, palette);
+			uint8_t indices[16];
+			FindIndices(block, channel, 1, palette, 8, indices);
+			for (int i = 0; i != 16; ++i)
+				bits |= uint64_t(indices[i]) << (3 * i);
+		}
+
+		output[0] = uint8_t(a0);
+		output[1] = uint8_t(a1);
+		for (int b = 0; b != 6; ++b)
+			output[2 + b] = uint8_t(bits >> (8 * b));
+	}
+
+	void DecodeBC4(const uint8_t* input, int channel, uint8_t pixels[64])
+	{
+		float palette[8][4];
+		MakeBC4Palette(input[0], input[1], channel, palette);
+		uint64_t bits = 0;
+		for (int b = 0; b != 6; ++b)
+			bits |= uint64_t(input[2 + b]) << (8 * b);
+		for (int i = 0; i != 16; ++i)
+			pixels[i * 4 + channel] = uint8_t(palette[(bits >> (3 * i)) & 7][channel] + 0.5f);
+	}
+
+	// BC7 mode 6: 7 bit RGBA endpoints with a shared lowest bit each, 4 bit indices
+
+	const int Mode6Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Mode6Endpoints
+	{
+		int Q0[4];
+		int Q1[4];
+		int P0;
+		int P1;
+	};
+
+	void MakeMode6Palette(const Mode6Endpoints& e, float palette[16][4])
+	{
+		for (int c = 0; c != 4; ++c)
+		{
+			const int e0 = (e.Q0[c] << 1) | e.P0;
+			const int e1 = (e.Q1[c] << 1) | e.P1;
+			for (int k = 0; k != 16; ++k)
+				palette[k][c] = float(((64 - Mode6Weights[k]) * e0 + Mode6Weights[k] * e1 + 32) >> 6);
+		}
+	}
+
+	void QuantizeMode6(const float color[4], int p, int q[4])
+	{
+		for (int c = 0; c != 4; ++c)
+			q[c] = std::min(127, std::max(0, int(std::floor((color[c] - p) / 2.0f + 0.5f))));
+	}
+
+	// Best of the four combinations of the lowest bits for these endpoints
+	float FitMode6(const PixelBlock& block, const float low[4], const float high[4], Mode6Endpoints& best, uint8_t indices[16])
+	{
+		float bestError = FLT_MAX;
+		for (int p = 0; p != 4; ++p)
+		{
+			Mode6Endpoints e;
+			e.P0 = p & 1;
+			e.P1 = p >> 1;
+			QuantizeMode6(low, e.P0, e.Q0);
+			QuantizeMode6(high, e.P1, e.Q1);
+
+			float palette[16][4];
+			MakeMode6Palette(e, palette);
+			uint8_t candidate[16];
+			const float error = FindIndices(block, 0, 4, palette, 16, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				best = e;
+				memcpy(indices, candidate, sizeof(candidate));
+			}
+		}
+		return bestError;
+	}
+
+	void EncodeBC7(const uint8_t pixels[64], const PixelBlock& block, uint8_t* output)
+	{
+		float low[4];
+		float high[4];
+		FitEndpoints(block, 0, 4, low, high);
+		Mode6Endpoints endpoints;
+		uint8_t indices[16];
+		const float error = FitMode6(block, low, high, endpoints, indices);
+
+		float weights[16];
+		for (int i = 0; i != 16; ++i)
+			weights[i] = Mode6Weights[indices[i]] / 64.0f;
+		if (SolveEndpoints(pixels, 0, 4, weights, low, high))
+		{
+			Mode6Endpoints refined;
+			uint8_t refinedIndices[16];
+			if (FitMode6(block, low, high, refined, refinedIndices) < error)
+			{
+				endpoints = refined;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+		}
+
+		// The first index is stored without its highest bit, which therefore has to be 0
+		if (indices[0] & 8)
+		{
+			std::swap(endpoints.Q0, endpoints.Q1);
+			std::swap(endpoints.P0, endpoints.P1);
+			for (uint8_t& index : indices) index = uint8_t(15 - index);
+		}
+
+		memset(output, 0, 16);
+		BitWriter writer(output);
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c != 4; ++c)
+		{
+			writer.Write(uint32_t(endpoints.Q0[c]), 7);
+			writer.Write(uint32_t(endpoints.Q1[c]), 7);
+		}
+		writer.Write(uint32_t(endpoints.P0), 1);
+		writer.Write(uint32_t(endpoints.P1), 1);
+		writer.Write(indices[0], 3);
+		for (int i = 1; i != 16; ++i)
+			writer.Write(indices[i], 4);
+	}
+
+	void DecodeBC7(const uint8_t* input, uint8_t pixels[64])
+	{
+		if ((input[0] & 0x7F) != 0x40)
+		{
+			memset(pixels, 0, 64);
+			return;
+		}
+
+		BitReader reader(input);
+		reader.Read(7);
+		Mode6Endpoints endpoints;
+		for (int c = 0; c != 4; ++c)
+		{
+			endpoints.Q0[c] = int(reader.Read(7));
+			endpoints.Q1[c] = int(reader.Read(7));
+		}
+		endpoints.P0 = int(reader.Read(1));
+		endpoints.P1 = int(reader.Read(1));
+
+		float palette[16][4];
+		MakeMode6Palette(endpoints, palette);
+		for (int i = 0; i != 16; ++i)
+		{
+			const float* color = palette[reader.Read(i == 0 ? 3 : 4)];
+			for (int c = 0; c != 4; ++c)
+				pixels[i * 4 + c] = uint8_t(color[c]);
+		}
+	}
+
+	// sRGB variants share the block layout of their UNORM format
+	DXGI_FORMAT GetLayout(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM_SRGB: return DXGI_FORMAT_BC1_UNORM;
+		case DXGI_FORMAT_BC3_UNORM_SRGB: return DXGI_FORMAT_BC3_UNORM;
+		case DXGI_FORMAT_BC7_UNORM_SRGB: return DXGI_FORMAT_BC7_UNORM;
+		default: return format;
+		}
+	}
+
+	void EncodeBlock(const uint8_t pixels[64], DXGI_FORMAT layout, uint8_t* output)
+	{
+		const PixelBlock block = LoadBlock(pixels);
+		switch (layout)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+			EncodeBC1(pixels, block, output);
+			break;
+		case DXGI_FORMAT_BC3_UNORM:
+			EncodeBC4(block, 3, output);
+			EncodeBC1(pixels, block, output + 8);
+			break;
+		case DXGI_FORMAT_BC4_UNORM:
+			EncodeBC4(block, 0, output);
+			break;
+		case DXGI_FORMAT_BC5_UNORM:
+			EncodeBC4(block, 0, output);
+			EncodeBC4(block, 1, output + 8);
+			break;
+		case DXGI_FORMAT_BC7_UNORM:
+			EncodeBC7(pixels, block, output);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void DecodeBlock(const uint8_t* input, DXGI_FORMAT layout, uint8_t pixels[64])
+	{
+		for (int i = 0; i != 16; ++i)
+		{
+			pixels[i * 4 + 0] = 0;
+			pixels[i * 4 + 1] = 0;
+			pixels[i * 4 + 2] = 0;
+			pixels[i * 4 + 3] = 255;
+		}
+
+		switch (layout)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+			DecodeBC1(input, false, pixels);
+			break;
+		case DXGI_FORMAT_BC3_UNORM:
+			DecodeBC1(input + 8, true, pixels);
+			DecodeBC4(input, 3, pixels);
+			break;
+		case DXGI_FORMAT_BC4_UNORM:
+			DecodeBC4(input, 0, pixels);
+			break;
+		case DXGI_FORMAT_BC5_UNORM:
+			DecodeBC4(input, 0, pixels);
+			DecodeBC4(input + 8, 1, pixels);
+			break;
+		case DXGI_FORMAT_BC7_UNORM:
+			DecodeBC7(input, pixels);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+bool BlockCompressor::IsSupported(DXGI_FORMAT format)
+{
+	switch (GetLayout(format))
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+size_t BlockCompressor::GetBlockSize(DXGI_FORMAT format)
+{
+	const DXGI_FORMAT layout = GetLayout(format);
+	return layout == DXGI_FORMAT_BC1_UNORM || layout == DXGI_FORMAT_BC4_UNORM ? 8 : 16;
+}
+
+size_t BlockCompressor::GetCompressedSize(DXGI_FORMAT format, uint32_t width, uint32_t height)
+{
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+int BlockCompressor::GetChannelCount(DXGI_FORMAT format)
+{
+	switch (GetLayout(format))
+	{
+	case DXGI_FORMAT_BC4_UNORM: return 1;
+	case DXGI_FORMAT_BC5_UNORM: return 2;
+	case DXGI_FORMAT_BC1_UNORM: return 3;
+	default: return 4;
+	}
+}
+
+void BlockCompressor::Compress(const uint8_t* rgba, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* blocks, unsigned threadCount)
+{
+	const DXGI_FORMAT layout = GetLayout(format);
+	const uint32_t blocksWide = (width + 3) / 4;
+	const uint32_t blocksHigh = (height + 3) / 4;
+	const size_t blockSize = GetBlockSize(format);
+
+	std::atomic<uint32_t> nextRow(0);
+	const auto work = [&]()
+	{
+		uint8_t pixels[64];
+		for (uint32_t by = nextRow++; by < blocksHigh; by = nextRow++)
+			for (uint32_t bx = 0; bx != blocksWide; ++bx)
+			{
+				for (uint32_t y = 0; y != 4; ++y)
+				{
+					const uint8_t* row = rgba + size_t(std::min(by * 4 + y, height - 1)) * width * 4;
+					for (uint32_t x = 0; x != 4; ++x)
+						memcpy(pixels + (y * 4 + x) * 4, row + size_t(std::min(bx * 4 + x, width - 1)) * 4, 4);
+				}
+				EncodeBlock(pixels, layout, blocks + (size_t(by) * blocksWide + bx) * blockSize);
+			}
+	};
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, std::max(1u, blocksHigh));
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threadCount; ++t)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers) worker.join();
+}
+
+void BlockCompressor::Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* rgba)
+{
+	const DXGI_FORMAT layout = GetLayout(format);
+	const uint32_t blocksWide = (width + 3) / 4;
+	const uint32_t blocksHigh = (height + 3) / 4;
+	const size_t blockSize = GetBlockSize(format);
+
+	uint8_t pixels[64];
+	for (uint32_t by = 0; by != blocksHigh; ++by)
+		for (uint32_t bx = 0; bx != blocksWide; ++bx)
+		{
+			DecodeBlock(blocks + (size_t(by) * blocksWide + bx) * blockSize, layout, pixels);
+			for (uint32_t y = 0; y != 4 && by * 4 + y < height; ++y)
+				for (uint32_t x = 0; x != 4 && bx * 4 + x < width; ++x)
+					memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+		}
+}
+
+ChannelPsnr BlockCompressor::MeasurePsnr(const uint8_t* a, const uint8_t* b, size_t pixelCount)
+{
+	double squaredError[4] = {};
+	for (size_t i = 0; i != pixelCount; ++i)
+		for (int c = 0; c != 4; ++c)
+		{
+			const double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+			squaredError[c] += d * d;
+		}
+
+	ChannelPsnr psnr;
+	for (int c = 0; c != 4; ++c)
+	{
+		const double meanSquaredError = squaredError[c] / std::max<size_t>(1, pixelCount);
+		psnr.Channels[c] = meanSquaredError == 0.0 ? std::numeric_limits<float>::infinity()
+			: float(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+	}
+	return psnr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <dxgiformat.h>
+
+// Peak signal to noise ratio of each channel in dB, infinite where the images are identical
+struct ChannelPsnr
+{
+	float Channels[4];
+};
+
+// CPU encoder for the block compressed formats D3D11 samples directly: BC1 (RGB), BC3 (RGB with a separate alpha
+// block), BC4 (red), BC5 (red and green) and BC7 (RGBA). Every 4x4 block is fit along the principal axis of its
+// colors, with one least squares refinement of the endpoints; distances to the palette are computed four pixels
+// at a time. BC7 uses mode 6 only, a single RGBA line with 16 interpolation steps.
+class BlockCompressor
+{
+public:
+	// The five formats in their UNORM and, where they exist, UNORM_SRGB variants
+	static bool IsSupported(DXGI_FORMAT format);
+	// 8 bytes for BC1 and BC4, 16 for the others
+	static size_t GetBlockSize(DXGI_FORMAT format);
+	static size_t GetCompressedSize(DXGI_FORMAT format, uint32_t width, uint32_t height);
+	// Channels a format keeps: 1 for BC4, 2 for BC5, 3 for BC1 and 4 for the others
+	static int GetChannelCount(DXGI_FORMAT format);
+
+	// Compress RGBA8 pixels, rows of width * 4 bytes, into rows of blocks. Edge blocks of sizes that are not a
+	// multiple of 4 repeat the last row and column. Rows of blocks are spread over threadCount threads,
+	// 0 picks one per core. sRGB variants are encoded like UNORM ones, the error is measured on the stored values.
+	static void Compress(const uint8_t* rgba, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* blocks, unsigned threadCount = 1);
+	// Back to RGBA8, like the GPU would sample it: missing color channels are 0 and missing alpha is 255.
+	// BC7 blocks in modes other than 6 come out black.
+	static void Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* rgba);
+
+	static ChannelPsnr MeasurePsnr(const uint8_t* a, const uint8_t* b, size_t pixelCount);
+};
@@ -0,0 +1,221 @@
+#include "ClusterCuller.h"
+#include <cmath>
+
+namespace
+{
+	// Stored in place of cutoffs that can never cull, so the test fails even for an eye
+	// exactly on the axis
+	const float NeverCull = 2.0f;
+
+	void AddRange(const MeshCluster& cluster, std::vector<DrawRange>& ranges)
+	{
+		if (!ranges.empty() && ranges.back().FirstIndex + ranges.back().IndexCount == cluster.FirstIndex)
+			ranges.back().IndexCount += cluster.IndexCount;
+		else
+			ranges.push_back({ cluster.FirstIndex, cluster.IndexCount });
+	}
+
+	void SetLane(DirectX::XMFLOAT4& lanes, size_t lane, float value)
+	{
+		(&lanes.x)[lane] = value;
+	}
+}
+
+ClusterView ClusterCuller::MakeView(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection, float cullMode)
+{
+	const DirectX::XMMATRIX w = XMMatrixTranspose(XMLoadFloat4x4(&world));
+	const DirectX::XMMATRIX v = XMMatrixTranspose(view);
+	const DirectX::XMMATRIX p = XMMatrixTranspose(projection);
+
+	ClusterView result{};
+
+	// Object space planes come straight from the columns of world * view * projection
+	// (Gribb and Hartmann), which are the rows of its transpose
+	const DirectX::XMMATRIX clip = XMMatrixTranspose(w * v * p);
+	const DirectX::XMVECTOR planes[6] =
+	{
+		DirectX::XMVectorAdd(clip.r[3], clip.r[0]),
+		DirectX::XMVectorSubtract(clip.r[3], clip.r[0]),
+		DirectX::XMVectorAdd(clip.r[3], clip.r[1]),
+		DirectX::XMVectorSubtract(clip.r[3], clip.r[1]),
+		clip.r[2],
+		DirectX::XMVectorSubtract(clip.r[3], clip.r[2]),
+	};
+	for (int i = 0; i != 6; ++i)
+	{
+		const float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(planes[i]));
+		XMStoreFloat4(&result.Planes[i], DirectX::XMVectorScale(planes[i], length > 0.0f ? 1.0f / length : 0.0f));
+	}
+
+	DirectX::XMFLOAT4X4 projection4x4{};
+	XMStoreFloat4x4(&projection4x4, p);
+	result.Orthographic = projection4x4._34 == 0.0f;
+
+	// The view space origin or forward axis taken back into object space
+	DirectX::XMVECTOR determinant;
+	const DirectX::XMMATRIX objectFromView = XMMatrixInverse(&determinant, w * v);
+	if (result.Orthographic)
+		XMStoreFloat3(&result.Eye, DirectX::XMVector3Normalize(objectFromView.r[2]));
+	else
+		XMStoreFloat3(&result.Eye, objectFromView.r[3]);
+
+	// A mirroring world matrix flips the winding the rasterizer sees
+	result.ConeSign = DirectX::XMVectorGetX(determinant) < 0.0f ? -cullMode : cullMode;
+	return result;
+}
+
+std::vector<ClusterBlock> ClusterCuller::BuildBlocks(const MeshCluster* clusters, size_t count)
+{
+	// Unused lanes of the last block stay zero, Cull never looks at them
+	std::vector<ClusterBlock> blocks((count + 3) / 4, ClusterBlock{});
+	for (size_t i = 0; i != count; ++i)
+	{
+		const MeshCluster& c = clusters[i];
+		ClusterBlock& block = blocks[i / 4];
+		const size_t lane = i % 4;
+		SetLane(block.CenterX, lane, c.Center.x);
+		SetLane(block.CenterY, lane, c.Center.y);
+		SetLane(block.CenterZ, lane, c.Center.z);
+		SetLane(block.Radius, lane, c.Radius);
+		SetLane(block.AxisX, lane, c.ConeAxis.x);
+		SetLane(block.AxisY, lane, c.ConeAxis.y);
+		SetLane(block.AxisZ, lane, c.ConeAxis.z);
+		SetLane(block.Cutoff, lane, c.ConeCutoff >= 1.0f ? NeverCull : c.ConeCutoff);
+	}
+	return blocks;
+}
+
+bool ClusterCuller::IsSphereVisible(const ClusterView& view, const DirectX::XMFLOAT3& center, float radius)
+{
+	for (const DirectX::XMFLOAT4& plane : view.Planes)
+	{
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+ClusterCullStats ClusterCuller::Cull(const ClusterView& view, const ClusterBlock* blocks, const MeshCluster* clusters, size_t count,
+	std::vector<DrawRange>& ranges)
+{
+	ClusterCullStats stats{};
+
+	DirectX::XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int i = 0; i != 6; ++i)
+	{
+		const DirectX::XMVECTOR plane = XMLoadFloat4(&view.Planes[i]);
+		planeX[i] = DirectX::XMVectorSplatX(plane);
+		planeY[i] = DirectX::XMVectorSplatY(plane);
+		planeZ[i] = DirectX::XMVectorSplatZ(plane);
+		planeW[i] = DirectX::XMVectorSplatW(plane);
+	}
+	const DirectX::XMVECTOR eyeX = DirectX::XMVectorReplicate(view.Eye.x);
+	const DirectX::XMVECTOR eyeY = DirectX::XMVectorReplicate(view.Eye.y);
+	const DirectX::XMVECTOR eyeZ = DirectX::XMVectorReplicate(view.Eye.z);
+	const DirectX::XMVECTOR coneSign = DirectX::XMVectorReplicate(view.ConeSign);
+
+	for (size_t b = 0; b != (count + 3) / 4; ++b)
+	{
+		const ClusterBlock& block = blocks[b];
+		const DirectX::XMVECTOR centerX = XMLoadFloat4(&block.CenterX);
+		const DirectX::XMVECTOR centerY = XMLoadFloat4(&block.CenterY);
+		const DirectX::XMVECTOR centerZ = XMLoadFloat4(&block.CenterZ);
+		const DirectX::XMVECTOR radius = XMLoadFloat4(&block.Radius);
+
+		// Inside unless the sphere is entirely behind one of the planes
+		const DirectX::XMVECTOR negativeRadius = DirectX::XMVectorNegate(radius);
+		DirectX::XMVECTOR inside = DirectX::XMVectorTrueInt();
+		for (int i = 0; i != 6; ++i)
+		{
+			const DirectX::XMVECTOR distance = DirectX::XMVectorMultiplyAdd(centerX, planeX[i],
+				DirectX::XMVectorMultiplyAdd(centerY, planeY[i], DirectX::XMVectorMultiplyAdd(centerZ, planeZ[i], planeW[i])));
+			inside = DirectX::XMVectorAndInt(inside, DirectX::XMVectorGreaterOrEqual(distance, negativeRadius));
+		}
+
+		DirectX::XMVECTOR facingAway = DirectX::XMVectorZero();
+		if (view.ConeSign != 0.0f)
+		{
+			const DirectX::XMVECTOR axisX = XMLoadFloat4(&block.AxisX);
+			const DirectX::XMVECTOR axisY = XMLoadFloat4(&block.AxisY);
+			const DirectX::XMVECTOR axisZ = XMLoadFloat4(&block.AxisZ);
+			const DirectX::XMVECTOR cutoff = XMLoadFloat4(&block.Cutoff);
+			if (view.Orthographic)
+			{
+				// The same direction everywhere, no slack for the sphere needed
+				const DirectX::XMVECTOR dot = DirectX::XMVectorMultiplyAdd(eyeX, axisX,
+					DirectX::XMVectorMultiplyAdd(eyeY, axisY, DirectX::XMVectorMultiply(eyeZ, axisZ)));
+				facingAway = DirectX::XMVectorGreaterOrEqual(DirectX::XMVectorMultiply(dot, coneSign), cutoff);
+			}
+			else
+			{
+				const DirectX::XMVECTOR toCenterX = DirectX::XMVectorSubtract(centerX, eyeX);
+				const DirectX::XMVECTOR toCenterY = DirectX::XMVectorSubtract(centerY, eyeY);
+				const DirectX::XMVECTOR toCenterZ = DirectX::XMVectorSubtract(centerZ, eyeZ);
+				const DirectX::XMVECTOR dot = DirectX::XMVectorMultiplyAdd(toCenterX, axisX,
+					DirectX::XMVectorMultiplyAdd(toCenterY, axisY, DirectX::XMVectorMultiply(toCenterZ, axisZ)));
+				const DirectX::XMVECTOR length = DirectX::XMVectorSqrt(DirectX::XMVectorMultiplyAdd(toCenterX, toCenterX,
+					DirectX::XMVectorMultiplyAdd(toCenterY, toCenterY, DirectX::XMVectorMultiply(toCenterZ, toCenterZ))));
+				facingAway = DirectX::XMVectorGreaterOrEqual(DirectX::XMVectorMultiply(dot, coneSign),
+					DirectX::XMVectorMultiplyAdd(cutoff, length, radius));
+			}
+		}
+
+		uint32_t insideLanes[4];
+		uint32_t facingAwayLanes[4];
+		DirectX::XMStoreInt4(insideLanes, inside);
+		DirectX::XMStoreInt4(facingAwayLanes, facingAway);
+		for (size_t lane = 0; lane != 4 && b * 4 + lane < count; ++lane)
+		{
+			if (!insideLanes[lane])
+				++stats.FrustumCulled;
+			else if (facingAwayLanes[lane])
+				++stats.ConeCulled;
+			else
+			{
+				++stats.Visible;
+				AddRange(clusters[b * 4 + lane], ranges);
+			}
+		}
+	}
+	return stats;
+}
+
+ClusterCullStats ClusterCuller::CullScalar(const ClusterView& view, const MeshCluster* clusters, size_t count, std::vector<DrawRange>& ranges)
+{
+	ClusterCullStats stats{};
+	for (size_t i = 0; i != count; ++i)
+	{
+		const MeshCluster& c = clusters[i];
+		if (!IsSphereVisible(view, c.Center, c.Radius))
+		{
+			++stats.FrustumCulled;
+			continue;
+		}
+
+		if (view.ConeSign != 0.0f && c.ConeCutoff < 1.0f)
+		{
+			bool facingAway;
+			if (view.Orthographic)
+			{
+				const float dot = view.Eye.x * c.ConeAxis.x + view.Eye.y * c.ConeAxis.y + view.Eye.z * c.ConeAxis.z;
+				facingAway = dot * view.ConeSign >= c.ConeCutoff;
+			}
+			else
+			{
+				const DirectX::XMFLOAT3 toCenter(c.Center.x - view.Eye.x, c.Center.y - view.Eye.y, c.Center.z - view.Eye.z);
+				const float dot = toCenter.x * c.ConeAxis.x + toCenter.y * c.ConeAxis.y + toCenter.z * c.ConeAxis.z;
+				const float length = std::sqrt(toCenter.x * toCenter.x + toCenter.y * toCenter.y + toCenter.z * toCenter.z);
+				facingAway = dot * view.ConeSign >= c.ConeCutoff * length + c.Radius;
+			}
+			if (facingAway)
+			{
+				++stats.ConeCulled;
+				continue;
+			}
+		}
+
+		++stats.Visible;
+		AddRange(c, ranges);
+	}
+	return stats;
+}
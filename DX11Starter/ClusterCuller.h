@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <DirectXMath.h>
+
+// One cluster inside a mesh's index buffer, see ClusterRange
+struct MeshCluster
+{
+	unsigned FirstIndex;
+	unsigned IndexCount;
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// Bounds of four clusters, one per lane, so they can be tested together
+struct ClusterBlock
+{
+	DirectX::XMFLOAT4 CenterX;
+	DirectX::XMFLOAT4 CenterY;
+	DirectX::XMFLOAT4 CenterZ;
+	DirectX::XMFLOAT4 Radius;
+	DirectX::XMFLOAT4 AxisX;
+	DirectX::XMFLOAT4 AxisY;
+	DirectX::XMFLOAT4 AxisZ;
+	DirectX::XMFLOAT4 Cutoff;
+};
+
+// A camera or light brought into the object space of one mesh
+struct ClusterView
+{
+	// Frustum planes, normalized, positive inside
+	DirectX::XMFLOAT4 Planes[6];
+	// Eye position for perspective projections, view direction for orthographic ones
+	DirectX::XMFLOAT3 Eye;
+	bool Orthographic;
+	// 1 culls clusters facing away from the eye, -1 clusters facing it, 0 turns cone culling off
+	float ConeSign;
+};
+
+// Part of the index buffer to draw
+struct DrawRange
+{
+	unsigned FirstIndex;
+	unsigned IndexCount;
+};
+
+struct ClusterCullStats
+{
+	size_t Visible;
+	size_t FrustumCulled;
+	size_t ConeCulled;
+};
+
+// Culls the clusters of a mesh against a view frustum and their normal cones.
+// Matrices are transposed for HLSL like everywhere else.
+class ClusterCuller
+{
+public:
+	// cullMode is the rasterizer's: 1 for D3D11_CULL_BACK, -1 for D3D11_CULL_FRONT, 0 for D3D11_CULL_NONE.
+	// Mirroring world matrices are taken care of.
+	static ClusterView MakeView(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection, float cullMode);
+
+	static std::vector<ClusterBlock> BuildBlocks(const MeshCluster* clusters, size_t count);
+
+	static bool IsSphereVisible(const ClusterView& view, const DirectX::XMFLOAT3& center, float radius);
+
+	// Append the index ranges of the visible clusters to ranges. Neighbouring visible clusters
+	// are merged into one range. Tests four clusters at a time.
+	static ClusterCullStats Cull(const ClusterView& view, const ClusterBlock* blocks, const MeshCluster* clusters, size_t count,
+		std::vector<DrawRange>& ranges);
+	// The same one cluster at a time, for comparison
+	static ClusterCullStats CullScalar(const ClusterView& view, const MeshCluster* clusters, size_t count, std::vector<DrawRange>& ranges);
+};
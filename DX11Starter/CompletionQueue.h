@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Hands finished work from any number of threads to one consumer without locks. Producers push onto a list with
+// a compare and swap; the consumer takes the whole list with one exchange, so a node is never popped while another
+// thread looks at it, and reverses it into the order it was pushed.
+template<typename T>
+class CompletionQueue
+{
+public:
+	CompletionQueue() : head(nullptr) {}
+	~CompletionQueue()
+	{
+		Node* node = head.load(std::memory_order_acquire);
+		while (node)
+		{
+			Node* next = node->Next;
+			delete node;
+			node = next;
+		}
+	}
+
+	CompletionQueue(const CompletionQueue&) = delete;
+	CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+	// From any thread
+	void Push(T value)
+	{
+		Node* node = new Node{ std::move(value), head.load(std::memory_order_relaxed) };
+		while (!head.compare_exchange_weak(node->Next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	// From one thread at a time. Appends everything pushed so far to out with push_back, in the order each producer
+	// pushed it, and returns how many.
+	template<typename Container>
+	size_t PopAll(Container& out)
+	{
+		Node* node = head.exchange(nullptr, std::memory_order_acquire);
+		Node* oldest = nullptr;
+		while (node)
+		{
+			Node* next = node->Next;
+			node->Next = oldest;
+			oldest = node;
+			node = next;
+		}
+
+		size_t count = 0;
+		while (oldest)
+		{
+			out.push_back(std::move(oldest->Value));
+			Node* next = oldest->Next;
+			delete oldest;
+			oldest = next;
+			++count;
+		}
+		return count;
+	}
+
+	bool IsEmpty() const { return head.load(std::memory_order_acquire) == nullptr; }
+
+private:
+	struct Node
+	{
+		T Value;
+		Node* Next;
+	};
+
+	std::atomic<Node*> head;
+};
@@ -0,0 +1,569 @@
+#include "CookedMesh.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "FileSystem.h"
+#include "MeshCodec.h"
+#include "ObjParser.h"
+#include "SimpleLogger.h"
+
+// A vertex or index section, in memory or in a file holding nothing else
+struct CookedSection
+{
+	const char* Data;
+	std::string Filename;
+	size_t Count;
+	size_t Stride;
+
+	// Filled in by EncodeSection, both stay empty when the section is stored as it is
+	std::vector<char> Encoded;
+	std::string EncodedFilename;
+	uint64_t StoredSize;
+};
+
+namespace
+{
+	// A section stored as it is until EncodeSection fills in the rest
+	CookedSection MakeSection(const char* data, const std::string& filename, size_t count, size_t stride)
+	{
+		CookedSection section{};
+		section.Data = data;
+		section.Filename = filename;
+		section.Count = count;
+		section.Stride = stride;
+		section.StoredSize = 0;
+		return section;
+	}
+
+	struct CookedString
+	{
+		uint32_t Offset;
+		uint32_t Length;
+	};
+
+	struct CookedMaterial
+	{
+		CookedString Name;
+		CookedString DiffuseMap;
+		CookedString NormalMap;
+		DirectX::XMFLOAT4 Ambient;
+		DirectX::XMFLOAT4 Diffuse;
+		DirectX::XMFLOAT4 Specular;
+		DirectX::XMFLOAT4 Emission;
+		float Shininess;
+	};
+
+	struct CookedSourceStamp
+	{
+		CookedString Filename;
+		FileStamp Stamp;
+	};
+
+	const uint64_t SectionAlignment = 16;
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+
+	CookedString AddString(const std::string& str, std::string& table)
+	{
+		const CookedString result = { uint32_t(table.size()), uint32_t(str.size()) };
+		table += str;
+		return result;
+	}
+
+	// Encoded sections have to save at least this fraction of their size to be stored encoded
+	const uint64_t MinSavings = 8;
+	// Codec blocks encoded at once when a section comes from a file
+	const size_t BlocksPerRead = 64;
+
+	// Sections from files are encoded into "<cooked>.<suffix>.tmp" a few blocks at a time, which gives the same bytes
+	// as encoding them in one go
+	bool EncodeSection(CookedSection& section, const std::string& filename, const char* suffix)
+	{
+		const uint64_t size = uint64_t(section.Count) * section.Stride;
+		section.StoredSize = size;
+		uint64_t encodedSize = 0;
+		if (section.Data)
+		{
+			section.Encoded = MeshCodec::Encode(section.Data, section.Count, section.Stride);
+			encodedSize = section.Encoded.size();
+		}
+		else
+		{
+			std::ifstream in(section.Filename, std::ios::binary);
+			section.EncodedFilename = filename + "." + suffix + ".tmp";
+			std::ofstream out(section.EncodedFilename, std::ios::binary | std::ios::trunc);
+			const size_t readCount = MeshCodec::GetBlockElements(section.Stride) * BlocksPerRead;
+			std::vector<char> elements(readCount * section.Stride);
+			for (size_t first = 0; first < section.Count && in && out; first += readCount)
+			{
+				const size_t count = std::min(readCount, section.Count - first);
+				in.read(elements.data(), std::streamsize(count * section.Stride));
+				const std::vector<char> encoded = MeshCodec::Encode(elements.data(), count, section.Stride);
+				out.write(encoded.data(), std::streamsize(encoded.size()));
+				encodedSize += encoded.size();
+			}
+			out.close();
+			if (!in || !out)
+			{
+				std::remove(section.EncodedFilename.c_str());
+				section.EncodedFilename.clear();
+				return false;
+			}
+		}
+
+		if (encodedSize <= size - size / MinSavings)
+			section.StoredSize = encodedSize;
+		else
+		{
+			section.Encoded.clear();
+			if (!section.EncodedFilename.empty()) std::remove(section.EncodedFilename.c_str());
+			section.EncodedFilename.clear();
+		}
+		return true;
+	}
+
+	bool CopyFile(const std::string& filename, std::ostream& out)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		std::vector<char> buffer(1024 * 1024);
+		while (in)
+		{
+			in.read(buffer.data(), std::streamsize(buffer.size()));
+			out.write(buffer.data(), in.gcount());
+		}
+		return in.eof() && out;
+	}
+
+	bool WriteSection(const CookedSection& section, std::ostream& out)
+	{
+		if (!section.Encoded.empty())
+			out.write(section.Encoded.data(), std::streamsize(section.Encoded.size()));
+		else if (!section.EncodedFilename.empty())
+			return CopyFile(section.EncodedFilename, out);
+		else if (section.Data)
+			out.write(section.Data, std::streamsize(section.StoredSize));
+		else
+			return CopyFile(section.Filename, out);
+		return bool(out);
+	}
+
+	// Stamped before it is read, so a change while hashing makes the stamp stale rather than the hash
+	uint64_t HashFile(const std::string& filename, uint64_t seed, std::vector<SourceStamp>* stamps, bool& archived)
+	{
+		if (stamps)
+		{
+			SourceStamp stamp = { filename, {} };
+			GetFileStamp(filename, stamp.Stamp);
+			stamps->push_back(stamp);
+		}
+		VirtualFile file;
+		if (!VirtualFile::Exists(filename) || !file.Open(filename)) return seed;
+		archived = archived || file.IsArchived();
+		return HashData(file.GetData(), file.GetSize(), seed);
+	}
+}
+
+// All offsets are from the beginning of the file
+struct CookedMesh::Header
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t SourceHash;
+
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t SubmeshCount;
+	uint32_t MaterialCount;
+	uint32_t LodCount;
+	uint32_t ClusterCount;
+	uint32_t SourceCount;
+
+	CookedString MtlLib;
+
+	uint64_t SubmeshOffset;
+	uint64_t LodOffset;
+	uint64_t ClusterOffset;
+	uint64_t MaterialOffset;
+	uint64_t SourceOffset;
+	uint64_t StringOffset;
+	uint64_t StringSize;
+	uint64_t VertexOffset;
+	uint64_t IndexOffset;
+	// Equal to the raw size for sections stored as they are
+	uint64_t VertexStoredSize;
+	uint64_t IndexStoredSize;
+};
+
+CookedMesh::CookedMesh()
+{
+	header = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+}
+
+bool CookedMesh::Open(const std::string& filename)
+{
+	Close();
+
+	if (!VirtualFile::Exists(filename) || !file.Open(filename)) return false;
+
+	const uint64_t size = file.GetSize();
+	const Header* h = reinterpret_cast<const Header*>(file.GetData());
+	if (size < sizeof(Header) || h->Magic != Magic || h->Version != Version)
+	{
+		Close();
+		return false;
+	}
+
+	// Every section has to lie inside the file
+	const auto inside = [size](uint64_t offset, uint64_t bytes)
+	{
+		return offset <= size && bytes <= size - offset;
+	};
+	if (!inside(h->SubmeshOffset, uint64_t(h->SubmeshCount) * sizeof(SubmeshRange)) ||
+		!inside(h->LodOffset, uint64_t(h->LodCount) * sizeof(LodRange)) ||
+		!inside(h->ClusterOffset, uint64_t(h->ClusterCount) * sizeof(ClusterRange)) ||
+		!inside(h->MaterialOffset, uint64_t(h->MaterialCount) * sizeof(CookedMaterial)) ||
+		!inside(h->SourceOffset, uint64_t(h->SourceCount) * sizeof(CookedSourceStamp)) ||
+		!inside(h->StringOffset, h->StringSize) ||
+		!inside(h->VertexOffset, h->VertexStoredSize) || h->VertexStoredSize > uint64_t(h->VertexCount) * sizeof(Vertex) ||
+		!inside(h->IndexOffset, h->IndexStoredSize) || h->IndexStoredSize > uint64_t(h->IndexCount) * sizeof(int))
+	{
+		LOG_WARNING << "Cooked mesh \"" << filename << "\" is corrupted." << std::endl;
+		Close();
+		return false;
+	}
+
+	const char* strings = file.GetData() + h->StringOffset;
+	bool stringsValid = true;
+	const auto getString = [&](const CookedString& s)
+	{
+		if (uint64_t(s.Offset) + s.Length > h->StringSize)
+		{
+			stringsValid = false;
+			return std::string();
+		}
+		return std::string(strings + s.Offset, s.Length);
+	};
+
+	mtlLib = getString(h->MtlLib);
+
+	const CookedMaterial* cookedMaterials = reinterpret_cast<const CookedMaterial*>(file.GetData() + h->MaterialOffset);
+	materials.resize(h->MaterialCount);
+	for (uint32_t i = 0; i != h->MaterialCount; ++i)
+	{
+		const CookedMaterial& c = cookedMaterials[i];
+		MtlMaterial& m = materials[i];
+		m.Name = getString(c.Name);
+		m.DiffuseMap = getString(c.DiffuseMap);
+		m.NormalMap = getString(c.NormalMap);
+		m.Ambient = c.Ambient;
+		m.Diffuse = c.Diffuse;
+		m.Specular = c.Specular;
+		m.Emission = c.Emission;
+		m.Shininess = c.Shininess;
+	}
+
+	const CookedSourceStamp* cookedSources = reinterpret_cast<const CookedSourceStamp*>(file.GetData() + h->SourceOffset);
+	sources.resize(h->SourceCount);
+	for (uint32_t i = 0; i != h->SourceCount; ++i)
+	{
+		sources[i].Filename = getString(cookedSources[i].Filename);
+		sources[i].Stamp = cookedSources[i].Stamp;
+	}
+
+	// Submesh, level of detail and cluster ranges have to stay inside the vertex and index sections
+	const SubmeshRange* submeshes = reinterpret_cast<const SubmeshRange*>(file.GetData() + h->SubmeshOffset);
+	const LodRange* lods = reinterpret_cast<const LodRange*>(file.GetData() + h->LodOffset);
+	const ClusterRange* clusters = reinterpret_cast<const ClusterRange*>(file.GetData() + h->ClusterOffset);
+	bool rangesValid = true;
+	for (uint32_t i = 0; i != h->SubmeshCount; ++i)
+	{
+		const SubmeshRange& s = submeshes[i];
+		rangesValid &= uint64_t(s.FirstVertex) + s.VertexCount <= h->VertexCount;
+		rangesValid &= uint64_t(s.FirstIndex) + s.IndexCount <= h->IndexCount;
+		rangesValid &= s.Material < int32_t(h->MaterialCount);
+		rangesValid &= s.LodCount > 0 && uint64_t(s.FirstLod) + s.LodCount <= h->LodCount;
+		rangesValid &= uint64_t(s.FirstCluster) + s.ClusterCount <= h->ClusterCount;
+	}
+	for (uint32_t i = 0; i != h->LodCount; ++i)
+		rangesValid &= uint64_t(lods[i].FirstIndex) + lods[i].IndexCount <= h->IndexCount;
+	for (uint32_t i = 0; i != h->ClusterCount; ++i)
+		rangesValid &= uint64_t(clusters[i].FirstIndex) + clusters[i].IndexCount <= h->IndexCount;
+
+	if (!stringsValid || !rangesValid)
+	{
+		LOG_WARNING << "Cooked mesh \"" << filename << "\" is corrupted." << std::endl;
+		Close();
+		return false;
+	}
+
+	vertices = reinterpret_cast<const Vertex*>(file.GetData() + h->VertexOffset);
+	if (h->VertexStoredSize != uint64_t(h->VertexCount) * sizeof(Vertex))
+	{
+		decodedVertices.resize(h->VertexCount);
+		if (!MeshCodec::Decode(vertices, size_t(h->VertexStoredSize), decodedVertices.data(), h->VertexCount, sizeof(Vertex), 0))
+		{
+			LOG_WARNING << "Cooked mesh \"" << filename << "\" is corrupted." << std::endl;
+			Close();
+			return false;
+		}
+		vertices = decodedVertices.data();
+	}
+
+	indices = reinterpret_cast<const int*>(file.GetData() + h->IndexOffset);
+	if (h->IndexStoredSize != uint64_t(h->IndexCount) * sizeof(int))
+	{
+		decodedIndices.resize(h->IndexCount);
+		if (!MeshCodec::Decode(indices, size_t(h->IndexStoredSize), decodedIndices.data(), h->IndexCount, sizeof(int), 0))
+		{
+			LOG_WARNING << "Cooked mesh \"" << filename << "\" is corrupted." << std::endl;
+			Close();
+			return false;
+		}
+		indices = decodedIndices.data();
+	}
+
+	header = h;
+	return true;
+}
+
+void CookedMesh::Close()
+{
+	file.Close();
+	header = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+	std::vector<Vertex>().swap(decodedVertices);
+	std::vector<int>().swap(decodedIndices);
+	mtlLib.clear();
+	materials.clear();
+	sources.clear();
+}
+
+bool CookedMesh::Write(const std::string& filename, const MeshData& data, uint64_t sourceHash, const std::vector<SourceStamp>& sourceStamps)
+{
+	CookedSection vertices = MakeSection(reinterpret_cast<const char*>(data.Vertices.data()), "", data.Vertices.size(), sizeof(Vertex));
+	CookedSection indices = MakeSection(reinterpret_cast<const char*>(data.Indices.data()), "", data.Indices.size(), sizeof(int));
+	return Write(filename, data, sourceHash, sourceStamps, vertices, indices);
+}
+
+bool CookedMesh::Write(const std::string& filename, const MeshData& data, uint64_t sourceHash,
+	const std::string& vertexFilename, size_t vertexCount, const std::string& indexFilename, size_t indexCount,
+	const std::vector<SourceStamp>& sourceStamps)
+{
+	CookedSection vertices = MakeSection(nullptr, vertexFilename, vertexCount, sizeof(Vertex));
+	CookedSection indices = MakeSection(nullptr, indexFilename, indexCount, sizeof(int));
+	return Write(filename, data, sourceHash, sourceStamps, vertices, indices);
+}
+
+bool CookedMesh::Write(const std::string& filename, const MeshData& data, uint64_t sourceHash, const std::vector<SourceStamp>& sourceStamps,
+	CookedSection& vertices, CookedSection& indices)
+{
+	std::string strings;
+	std::vector<CookedMaterial> cookedMaterials(data.Materials.size());
+	for (size_t i = 0; i != data.Materials.size(); ++i)
+	{
+		const MtlMaterial& m = data.Materials[i];
+		CookedMaterial& c = cookedMaterials[i];
+		c.Name = AddString(m.Name, strings);
+		c.DiffuseMap = AddString(m.DiffuseMap, strings);
+		c.NormalMap = AddString(m.NormalMap, strings);
+		c.Ambient = m.Ambient;
+		c.Diffuse = m.Diffuse;
+		c.Specular = m.Specular;
+		c.Emission = m.Emission;
+		c.Shininess = m.Shininess;
+	}
+	std::vector<CookedSourceStamp> cookedSources(sourceStamps.size());
+	for (size_t i = 0; i != sourceStamps.size(); ++i)
+	{
+		cookedSources[i].Filename = AddString(sourceStamps[i].Filename, strings);
+		cookedSources[i].Stamp = sourceStamps[i].Stamp;
+	}
+
+	if (!EncodeSection(vertices, filename, "vertices") || !EncodeSection(indices, filename, "indices"))
+	{
+		LOG_WARNING << "Failed to write cooked mesh \"" << filename << "\"." << std::endl;
+		if (!vertices.EncodedFilename.empty()) std::remove(vertices.EncodedFilename.c_str());
+		return false;
+	}
+
+	Header h{};
+	h.Magic = Magic;
+	h.Version = Version;
+	h.SourceHash = sourceHash;
+	h.VertexCount = uint32_t(vertices.Count);
+	h.IndexCount = uint32_t(indices.Count);
+	h.SubmeshCount = uint32_t(data.Submeshes.size());
+	h.MaterialCount = uint32_t(cookedMaterials.size());
+	h.LodCount = uint32_t(data.Lods.size());
+	h.ClusterCount = uint32_t(data.Clusters.size());
+	h.SourceCount = uint32_t(cookedSources.size());
+	h.MtlLib = AddString(data.MtlLib, strings);
+
+	h.SubmeshOffset = Align(sizeof(Header));
+	h.LodOffset = Align(h.SubmeshOffset + data.Submeshes.size() * sizeof(SubmeshRange));
+	h.ClusterOffset = Align(h.LodOffset + data.Lods.size() * sizeof(LodRange));
+	h.MaterialOffset = Align(h.ClusterOffset + data.Clusters.size() * sizeof(ClusterRange));
+	h.SourceOffset = Align(h.MaterialOffset + cookedMaterials.size() * sizeof(CookedMaterial));
+	h.StringOffset = Align(h.SourceOffset + cookedSources.size() * sizeof(CookedSourceStamp));
+	h.StringSize = strings.size();
+	h.VertexStoredSize = vertices.StoredSize;
+	h.IndexStoredSize = indices.StoredSize;
+	h.VertexOffset = Align(h.StringOffset + strings.size());
+	h.IndexOffset = Align(h.VertexOffset + h.VertexStoredSize);
+
+	// Write to a temporary file first so a crash never leaves a half written cache behind
+	const std::string tempFilename = filename + ".tmp";
+	std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+
+	const char padding[SectionAlignment] = {};
+	const auto pad = [&](uint64_t offset)
+	{
+		const uint64_t position = uint64_t(out.tellp());
+		out.write(padding, std::streamsize(offset - position));
+	};
+	const auto writeSection = [&](uint64_t offset, const void* bytes, size_t size)
+	{
+		pad(offset);
+		if (size) out.write(static_cast<const char*>(bytes), std::streamsize(size));
+	};
+
+	bool written = bool(out);
+	if (written)
+	{
+		out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+		writeSection(h.SubmeshOffset, data.Submeshes.data(), data.Submeshes.size() * sizeof(SubmeshRange));
+		writeSection(h.LodOffset, data.Lods.data(), data.Lods.size() * sizeof(LodRange));
+		writeSection(h.ClusterOffset, data.Clusters.data(), data.Clusters.size() * sizeof(ClusterRange));
+		writeSection(h.MaterialOffset, cookedMaterials.data(), cookedMaterials.size() * sizeof(CookedMaterial));
+		writeSection(h.SourceOffset, cookedSources.data(), cookedSources.size() * sizeof(CookedSourceStamp));
+		writeSection(h.StringOffset, strings.data(), strings.size());
+		pad(h.VertexOffset);
+		written = WriteSection(vertices, out);
+		pad(h.IndexOffset);
+		written = WriteSection(indices, out) && written;
+		out.close();
+		written = written && out;
+	}
+
+	for (const CookedSection* section : { &vertices, &indices })
+		if (!section->EncodedFilename.empty()) std::remove(section->EncodedFilename.c_str());
+
+	if (!written)
+	{
+		LOG_WARNING << "Failed to write cooked mesh \"" << filename << "\"." << std::endl;
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		LOG_WARNING << "Failed to write cooked mesh \"" << filename << "\"." << std::endl;
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+
+	LOG_INFO << "Cooked mesh \"" << filename << "\" written, geometry " << vertices.Count * sizeof(Vertex) + indices.Count * sizeof(int)
+		<< " -> " << h.VertexStoredSize + h.IndexStoredSize << " bytes." << std::endl;
+	return true;
+}
+
+uint64_t CookedMesh::HashSources(const std::string& objFilename, const std::string& mtlFilename, std::vector<SourceStamp>* stamps)
+{
+	if (stamps) stamps->clear();
+	bool archived = false;
+	uint64_t hash = HashFile(objFilename, Version, stamps, archived);
+	if (!mtlFilename.empty())
+	{
+		hash = HashFile(mtlFilename, hash, stamps, archived);
+
+		// Maps are relative to the OBJ like the loader resolves them, missing ones leave the hash as it is
+		VirtualFile mtlFile;
+		if (VirtualFile::Exists(mtlFilename) && mtlFile.Open(mtlFilename))
+		{
+			std::vector<MtlMaterial> materials;
+			ObjParser::ParseMtl(mtlFile.GetData(), mtlFile.GetEnd(), materials);
+			const std::string folder = GetFolder(objFilename);
+			for (const MtlMaterial& material : materials)
+			{
+				if (!material.DiffuseMap.empty()) hash = HashFile(folder + material.DiffuseMap, hash, stamps, archived);
+				if (!material.NormalMap.empty()) hash = HashFile(folder + material.NormalMap, hash, stamps, archived);
+			}
+		}
+	}
+	if (stamps && archived) stamps->clear();
+	return hash;
+}
+
+bool CookedMesh::SourcesUnchanged() const
+{
+	if (!header || sources.empty()) return false;
+	for (const SourceStamp& source : sources)
+	{
+		FileStamp stamp;
+		GetFileStamp(source.Filename, stamp);
+		if (stamp != source.Stamp || VirtualFile::InArchive(source.Filename)) return false;
+	}
+	return true;
+}
+
+uint64_t CookedMesh::GetSourceHash() const
+{
+	return header ? header->SourceHash : 0;
+}
+
+const Vertex* CookedMesh::GetVertices() const
+{
+	return header ? vertices : nullptr;
+}
+
+const int* CookedMesh::GetIndices() const
+{
+	return header ? indices : nullptr;
+}
+
+const SubmeshRange* CookedMesh::GetSubmeshes() const
+{
+	return header ? reinterpret_cast<const SubmeshRange*>(file.GetData() + header->SubmeshOffset) : nullptr;
+}
+
+const LodRange* CookedMesh::GetLods() const
+{
+	return header ? reinterpret_cast<const LodRange*>(file.GetData() + header->LodOffset) : nullptr;
+}
+
+const ClusterRange* CookedMesh::GetClusters() const
+{
+	return header ? reinterpret_cast<const ClusterRange*>(file.GetData() + header->ClusterOffset) : nullptr;
+}
+
+uint32_t CookedMesh::GetVertexCount() const
+{
+	return header ? header->VertexCount : 0;
+}
+
+uint32_t CookedMesh::GetIndexCount() const
+{
+	return header ? header->IndexCount : 0;
+}
+
+uint32_t CookedMesh::GetSubmeshCount() const
+{
+	return header ? header->SubmeshCount : 0;
+}
+
+uint32_t CookedMesh::GetLodCount() const
+{
+	return header ? header->LodCount : 0;
+}
+
+uint32_t CookedMesh::GetClusterCount() const
+{
+	return header ? header->ClusterCount : 0;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "FileSystem.h"
+#include "ObjParser.h"
+#include "VirtualFile.h"
+
+struct CookedSection;
+
+// A submesh inside the shared vertex/index arrays of a MeshData.
+// Indices are relative to FirstVertex.
+struct SubmeshRange
+{
+	uint32_t FirstVertex;
+	uint32_t VertexCount;
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	// Index into the material list, -1 for the default material
+	int32_t Material;
+
+	DirectX::XMFLOAT3 BoundingBoxCenter;
+	DirectX::XMFLOAT3 BoundingBoxExtents;
+
+	// Levels of detail in MeshData::Lods, the first one is the full submesh
+	uint32_t FirstLod;
+	uint32_t LodCount;
+
+	// Clusters of the full detail level in MeshData::Clusters
+	uint32_t FirstCluster;
+	uint32_t ClusterCount;
+};
+
+// One level of detail of a submesh. Indices are relative to the submesh's FirstVertex,
+// all levels share its vertices.
+struct LodRange
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	// Largest distance the simplification moved the surface, in object space
+	float Error;
+};
+
+// A small piece of the full detail level of a submesh with bounds for culling it on its own.
+// Clusters of a submesh cover its indices in order, without gaps.
+struct ClusterRange
+{
+	// Into MeshData::Indices like SubmeshRange::FirstIndex
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+
+	// Bounding sphere in object space
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	// Normal cone. Every triangle faces away from eye if
+	// dot(Center - eye, ConeAxis) >= ConeCutoff * length(Center - eye) + Radius.
+	// A cutoff of 1 or more never culls.
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// A loose file a cooked mesh was made from, with its size and write time from when it was hashed.
+// Missing files have an all zero stamp.
+struct SourceStamp
+{
+	std::string Filename;
+	FileStamp Stamp;
+};
+
+// Fully processed (welded, normals and tangents generated) geometry of a model
+struct MeshData
+{
+	std::string MtlLib;
+
+	std::vector<Vertex> Vertices;
+	std::vector<int> Indices;
+	std::vector<SubmeshRange> Submeshes;
+	std::vector<LodRange> Lods;
+	std::vector<ClusterRange> Clusters;
+	std::vector<MtlMaterial> Materials;
+};
+
+// Binary cache of a MeshData, written next to the source as "<model>.obj.cooked".
+// The file is memory-mapped and everything but the vertices and indices is used in place, so
+// loading a cooked model does no parsing. Vertex and index sections are stored with MeshCodec
+// when that makes them at least an eighth smaller and decoded on open, otherwise used in place too.
+class CookedMesh
+{
+public:
+	static const uint32_t Magic = 0x4853454d; // "MESH"
+	// Bump whenever the layout or the processing that produces MeshData changes
+	static const uint32_t Version = 9;
+
+	CookedMesh();
+
+	// Fails (without logging) if the file is missing, truncated or of another version
+	bool Open(const std::string& filename);
+	void Close();
+
+	// sourceStamps come from HashSources, without them SourcesUnchanged is always false
+	static bool Write(const std::string& filename, const MeshData& data, uint64_t sourceHash,
+		const std::vector<SourceStamp>& sourceStamps = std::vector<SourceStamp>());
+	// Like Write, with the vertices and indices read from files that hold nothing but them instead of from data.
+	// They are encoded and copied a few blocks at a time, for meshes too large to have in memory at once.
+	static bool Write(const std::string& filename, const MeshData& data, uint64_t sourceHash,
+		const std::string& vertexFilename, size_t vertexCount, const std::string& indexFilename, size_t indexCount,
+		const std::vector<SourceStamp>& sourceStamps = std::vector<SourceStamp>());
+
+	// Hash of the OBJ and MTL contents, and of the maps the MTL names since small ones are packed into atlases,
+	// plus the cook version. mtlFilename may be empty. stamps, if given, gets the stamp of every file hashed, taken
+	// before reading it. It stays empty when one of them is in an archive, those have no stamp of their own.
+	static uint64_t HashSources(const std::string& objFilename, const std::string& mtlFilename, std::vector<SourceStamp>* stamps = nullptr);
+
+	// True if every source stamped when the mesh was cooked still has the same size and write time and is not hidden
+	// by an archive, which is much cheaper than HashSources. When false, compare GetSourceHash with HashSources.
+	bool SourcesUnchanged() const;
+
+	// Getters
+	uint64_t GetSourceHash() const;
+	const std::string& GetMtlLib() const { return mtlLib; }
+	const Vertex* GetVertices() const;
+	const int* GetIndices() const;
+	const SubmeshRange* GetSubmeshes() const;
+	const LodRange* GetLods() const;
+	const ClusterRange* GetClusters() const;
+	uint32_t GetVertexCount() const;
+	uint32_t GetIndexCount() const;
+	uint32_t GetSubmeshCount() const;
+	uint32_t GetLodCount() const;
+	uint32_t GetClusterCount() const;
+	const std::vector<MtlMaterial>& GetMaterials() const { return materials; }
+
+private:
+	struct Header;
+
+	static bool Write(const std::string& filename, const MeshData& data, uint64_t sourceHash, const std::vector<SourceStamp>& sourceStamps,
+		CookedSection& vertices, CookedSection& indices);
+
+	VirtualFile file;
+	const Header* header;
+
+	// Into the file, or into the decoded sections
+	const Vertex* vertices;
+	const int* indices;
+	std::vector<Vertex> decodedVertices;
+	std::vector<int> decodedIndices;
+
+	// Strings are small, so they are copied out instead of used in place
+	std::string mtlLib;
+	std::vector<MtlMaterial> materials;
+	std::vector<SourceStamp> sources;
+};
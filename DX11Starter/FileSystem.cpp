@@ -0,0 +1,255 @@
+#include "FileSystem.h"
+#include <cctype>
+#include <cstring>
+#include "SimpleLogger.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const char PathSeparator = '\\';
+#else
+const char PathSeparator = '/';
+#endif
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	opened = false;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		LOG_WARNING << "Failed to open file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	size = size_t(fileSize.QuadPart);
+	opened = true;
+
+	// Empty files cannot be mapped
+	if (size == 0) return true;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle)
+		data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	fileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		LOG_WARNING << "Failed to open file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+
+	struct stat st {};
+	fstat(fileDescriptor, &st);
+	size = size_t(st.st_size);
+	opened = true;
+
+	// Empty files cannot be mapped
+	if (size == 0) return true;
+
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (view != MAP_FAILED)
+	{
+		madvise(view, size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(view);
+	}
+#endif
+
+	if (!data)
+	{
+		LOG_WARNING << "Failed to map file \"" << filename << "\"." << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data) { UnmapViewOfFile(data); }
+	if (mappingHandle) { CloseHandle(mappingHandle); }
+	if (fileHandle != INVALID_HANDLE_VALUE) { CloseHandle(fileHandle); }
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data) { munmap(const_cast<char*>(data), size); }
+	if (fileDescriptor >= 0) { close(fileDescriptor); }
+	fileDescriptor = -1;
+#endif
+
+	data = nullptr;
+	size = 0;
+	opened = false;
+}
+
+static bool EndsWith(const std::string& str, const std::string& suffix)
+{
+	if (suffix.size() > str.size()) return false;
+	for (size_t i = 0; i < suffix.size(); ++i)
+	{
+		if (tolower(str[str.size() - suffix.size() + i]) != tolower(suffix[i]))
+			return false;
+	}
+	return true;
+}
+
+static void ListFilesRecursive(const std::string& folder, const std::string& extension, std::vector<std::string>& result)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((folder + "\\*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE) return;
+
+	do
+	{
+		const std::string name(findData.cFileName);
+		if (name == "." || name == "..") continue;
+
+		const std::string path = folder + PathSeparator + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ListFilesRecursive(path, extension, result);
+		else if (EndsWith(name, extension))
+			result.push_back(path);
+	} while (FindNextFileA(find, &findData));
+
+	FindClose(find);
+#else
+	DIR* dir = opendir(folder.c_str());
+	if (!dir) return;
+
+	while (dirent* entry = readdir(dir))
+	{
+		const std::string name(entry->d_name);
+		if (name == "." || name == "..") continue;
+
+		const std::string path = folder + PathSeparator + name;
+		struct stat st {};
+		if (stat(path.c_str(), &st) != 0) continue;
+		if (S_ISDIR(st.st_mode))
+			ListFilesRecursive(path, extension, result);
+		else if (EndsWith(name, extension))
+			result.push_back(path);
+	}
+
+	closedir(dir);
+#endif
+}
+
+std::vector<std::string> ListFiles(const std::string& folder, const std::string& extension)
+{
+	std::vector<std::string> result;
+	ListFilesRecursive(folder, extension, result);
+	return result;
+}
+
+std::string GetFolder(const std::string& filename)
+{
+	const size_t pos = filename.find_last_of("\\/");
+	if (pos == std::string::npos) return "";
+	return filename.substr(0, pos + 1);
+}
+
+bool FileExists(const std::string& filename)
+{
+#ifdef _WIN32
+	const DWORD attributes = GetFileAttributesA(filename.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st {};
+	return stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+bool GetFileStamp(const std::string& filename, FileStamp& stamp)
+{
+	stamp = {};
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) || (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	stamp.Size = (uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	stamp.ModifiedTime = (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st {};
+	if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+	stamp.Size = uint64_t(st.st_size);
+	stamp.ModifiedTime = uint64_t(st.st_mtim.tv_sec) * 1000000000ull + uint64_t(st.st_mtim.tv_nsec);
+#endif
+	return true;
+}
+
+static uint64_t Mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t HashData(const void* data, size_t size, uint64_t seed)
+{
+	const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t h = seed ^ (size * prime);
+
+	// Four independent lanes so the multiplies can overlap
+	uint64_t lanes[4] = { h, h + prime, h - prime, ~h };
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (unsigned l = 0; l != 4; ++l)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i + l * 8, 8);
+			lanes[l] = (lanes[l] ^ Mix(word)) * prime;
+		}
+	}
+	for (unsigned l = 0; l != 4; ++l)
+		h = (h ^ Mix(lanes[l])) * prime;
+
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		h = (h ^ Mix(word)) * prime;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + i, size - i);
+	h = (h ^ Mix(tail)) * prime;
+
+	return Mix(h);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file.
+// The mapping stays valid until Close() or destruction.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return opened; }
+
+	// Getters
+	const char* GetData() const { return data; }
+	const char* GetEnd() const { return data + size; }
+	size_t GetSize() const { return size; }
+
+private:
+	const char* data;
+	size_t size;
+	bool opened;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
+
+// Collect every file under folder (recursively) whose name ends with extension.
+// An empty extension matches every file.
+std::vector<std::string> ListFiles(const std::string& folder, const std::string& extension);
+
+// Folder part of a path, including the trailing separator.
+std::string GetFolder(const std::string& filename);
+
+bool FileExists(const std::string& filename);
+
+// Size and last write time of a file, enough to tell it changed without reading it
+struct FileStamp
+{
+	uint64_t Size;
+	uint64_t ModifiedTime;
+};
+
+inline bool operator==(const FileStamp& a, const FileStamp& b) { return a.Size == b.Size && a.ModifiedTime == b.ModifiedTime; }
+inline bool operator!=(const FileStamp& a, const FileStamp& b) { return !(a == b); }
+
+// Fails for missing files and folders, stamp is then all zero.
+// Write times are in the platform's own units, only compare them with each other.
+bool GetFileStamp(const std::string& filename, FileStamp& stamp);
+
+// Fast non-cryptographic 64-bit hash, used to detect changed source files
+uint64_t HashData(const void* data, size_t size, uint64_t seed = 0);
+
+extern const char PathSeparator;
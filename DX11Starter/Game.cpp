@@ -1,5 +1,6 @@
 #include <map>
 #include <array>
+#include <chrono>
 #include "Game.h"
 #include "Vertex.h"
 #include "SimpleLogger.h"
@@ -10,6 +11,9 @@
 #include <codecvt>
 #include <WICTextureLoader.h>
 #include "BlinnPhongMaterial.h"
+#include "AssetArchive.h"
+#include "TextureStreamer.h"
+#include "VirtualFile.h"
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -33,6 +37,12 @@ Game::Game(HINSTANCE hInstance)
 	// Initialize fields
 	vertexBuffer = 0;
 	indexBuffer = 0;
+	geometryArena = nullptr;
+	textureManager = nullptr;
+	textureStreamer = nullptr;
+	assetLoader = nullptr;
+	assetCache = nullptr;
+	modelRegistry = nullptr;
 
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
@@ -68,6 +78,11 @@ Game::~Game()
 	delete ppDarkCornerShader;
 	delete ppGaussianBlurUShader;
 	delete ppGaussianBlurVShader;
+	for (int f = 0; f < VertexFormatCount; ++f)
+	{
+		delete packedVertexShaders[f];
+		delete packedShadowVertexShaders[f];
+	}
 
 
 	if (drawingRenderState) { drawingRenderState->Release(); }
@@ -81,6 +96,19 @@ Game::~Game()
 		delete entities[i];
 	}
 	delete[] entities;
+	// Every version of the models, after the entities drawing them and before the streamer their materials are in
+	delete modelRegistry;
+	// Holds meshes and materials of its own, and waits for its threads
+	delete assetLoader;
+	// Then what the cache kept, before the arena its meshes came from
+	delete assetCache;
+
+	// Meshes give their ranges back when destroyed, so the arena goes after the entities
+	delete geometryArena;
+	// Its workers may still read from the archive until it is gone
+	delete textureManager;
+	delete textureStreamer;
+	VirtualFile::UnmountAll();
 
 	for (int i = 0; i < skyboxCount; ++i)
 	{
@@ -108,9 +136,17 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	initStart = std::chrono::high_resolution_clock::now();
+	firstFrameDrawn = false;
+
 	// Initialize Loggers
 	ADD_LOGGER(info, std::cout);
 
+	// Everything below reads through the archive built with "-pack" when there is one,
+	// loose files are only used for what it does not have
+	if (FileExists(AssetArchive::DefaultName) && VirtualFile::Mount(AssetArchive::DefaultName))
+		LOG_INFO << "Mounted asset archive \"" << AssetArchive::DefaultName << "\"." << std::endl;
+
 	vertexShader = new SimpleVertexShader(device, context);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
 
@@ -150,6 +186,29 @@ void Game::Init()
 	ppGaussianBlurVShader = new SimplePixelShader(device, context);
 	ppGaussianBlurVShader->LoadShaderFile(L"PPGaussianBlurVPS.cso");
 
+	packedVertexShaders[VertexFormatFull] = nullptr;
+	packedShadowVertexShaders[VertexFormatFull] = nullptr;
+	for (int f = VertexFormatPacked; f < VertexFormatCount; ++f)
+	{
+		packedVertexShaders[f] = LoadPackedVertexShader(L"PackedVertexShader.cso", VertexFormat(f));
+		packedShadowVertexShaders[f] = LoadPackedVertexShader(L"PackedShadowVS.cso", VertexFormat(f));
+	}
+
+	cameraLod = LodSelector::CameraDefaults();
+	shadowLod = LodSelector::ShadowDefaults();
+	for (int p = 0; p < 2; ++p)
+	{
+		drawnTriangles[p] = 0;
+		fullTriangles[p] = 0;
+		visibleClusters[p] = 0;
+		testedClusters[p] = 0;
+		cullSeconds[p] = 0.0;
+	}
+	drawCalls = 0;
+	bufferBinds = 0;
+	reportFrames = 0;
+	reportTime = 0.0f;
+
 	BlinnPhongMaterial::GetDefault()->SetVertexShaderPtr(vertexShader);
 	BlinnPhongMaterial::GetDefault()->SetPixelShaderPtr(blinnPhongPixelShader);
 
@@ -157,8 +216,28 @@ void Game::Init()
 	entities = new GameEntity *[entityCount];
 
 	// Create GameEntity & Initial Transform
-	const auto modelData1 = Mesh::LoadFromFile("models\\Groudon\\0.obj", device, context);
-	const auto modelData2 = Mesh::LoadFromFile("models\\Rock\\quad.obj", device, context);
+	geometryArena = new GeometryArena(device, context);
+	textureManager = new TextureManager(device, context);
+	// Cooked textures start with their smallest mips, the rest follows as the camera gets close
+	textureStreamer = new TextureStreamer(device, context);
+	textureManager->SetStreamer(textureStreamer);
+	// Models and skyboxes load in the background, the entities get their meshes as they arrive
+	assetLoader = new AssetLoader(device, context, geometryArena, textureManager);
+	// Models nothing uses any more stay loaded up to the budget, for loading them again
+	assetCache = new AssetCache(256 * 1024 * 1024);
+	assetLoader->SetCache(assetCache);
+	entityModels.resize(entityCount);
+	entityModels[0].Model = assetLoader->LoadModel("models\\Groudon\\0.obj", VertexFormatQuantized);
+	entityModels[0].Albedo = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	entityModels[0].Roughness = 0.5f;
+	entityModels[0].Metalness = 0.1f;
+	entityModels[entityCount - 1].Model = assetLoader->LoadModel("models\\Rock\\quad.obj", VertexFormatQuantized);
+	entityModels[entityCount - 1].Albedo = XMFLOAT3(0.5f, 0.5f, 0.5f);
+	entityModels[entityCount - 1].Roughness = 1.0f;
+	entityModels[entityCount - 1].Metalness = 0.0f;
+	// Entities draw the version of their model in the registry, replaced as it loads while frames go on
+	modelRegistry = new ModelRegistry(64);
+	renderReader = modelRegistry->RegisterReader();
 
 	//for (int i = 0; i < 10; ++i)
 	//for (int j = 0; j < 10; ++j)
@@ -167,11 +246,11 @@ void Game::Init()
 	//	entities[10 * i + j]->SetScale(XMFLOAT3(1.0f, 1.0f, 1.0f));
 	//	entities[10 * i + j]->SetTranslation(XMFLOAT3(3.0f * (j - 9.0f / 2.0f), 1.0f, 3.0f * (i - 9.0f / 2.0f)));
 	//}
-	entities[0] = new GameEntity(modelData1.first);
+	entities[0] = new GameEntity();
 	entities[0]->SetScale(XMFLOAT3(0.005f, 0.005f, 0.005f));
 	entities[0]->SetTranslation(XMFLOAT3(0.0f, 0.0f, 0.0f));
 
-	entities[entityCount - 1] = new GameEntity(modelData2.first);
+	entities[entityCount - 1] = new GameEntity();
 	entities[entityCount - 1]->SetScale(XMFLOAT3(1.0f, 10.0f, 10.0f));
 	XMFLOAT3 zAxis{ 0.0f, 0.0f, 1.0f };
 	XMFLOAT4 q{};
@@ -184,126 +263,30 @@ void Game::Init()
 	//entities[2]->SetScale(XMFLOAT3(1.0f, 1.0f, 1.0f));
 	//entities[2]->SetTranslation(XMFLOAT3(0.0f, -2.0f, 0.0f));
 
-	for (int k = 0; k < entities[0]->GetMeshCount(); ++k)
-	{
-		auto originalMaterial = entities[0]->GetMeshAt(k)->GetMaterial();
-		// Test the new BRDF Material
-		std::shared_ptr<BrdfMaterial> brdfMaterial = std::make_shared<BrdfMaterial>(vertexShader, brdfPixelShader, device);
-		// Gold
-		brdfMaterial->parameters.albedo = { 1.0f, 1.0f, 1.0f };
-		//brdfMaterial->parameters.albedo = { 1.000000f, 0.765557f, 0.336057f };
-		brdfMaterial->parameters.roughness = 0.5f;
-		brdfMaterial->parameters.metalness = 0.1f;
-		ID3D11Resource* resource;
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		if (originalMaterial->diffuseSrvPtr)
-		{
-			originalMaterial->diffuseSrvPtr->GetResource(&resource);
-			originalMaterial->diffuseSrvPtr->GetDesc(&srvDesc);
-			device->CreateShaderResourceView(resource, &srvDesc, &brdfMaterial->diffuseSrvPtr);
-			resource->Release();
-		}
-		if (originalMaterial->normalSrvPtr)
-		{
-			originalMaterial->normalSrvPtr->GetResource(&resource);
-			originalMaterial->normalSrvPtr->GetDesc(&srvDesc);
-			device->CreateShaderResourceView(resource, &srvDesc, &brdfMaterial->normalSrvPtr);
-			resource->Release();
-		}
-		brdfMaterial->InitializeSampler();
-		entities[0]->GetMeshAt(k)->SetMaterial(brdfMaterial);
-	}
-
-	for (int k = 0; k < entities[entityCount - 1]->GetMeshCount(); ++k)
-	{
-		auto originalMaterial = entities[entityCount - 1]->GetMeshAt(k)->GetMaterial();
-		// Test the new BRDF Material
-		std::shared_ptr<BrdfMaterial> brdfMaterial = std::make_shared<BrdfMaterial>(vertexShader, brdfPixelShader, device);
-		// Gold
-		brdfMaterial->parameters.albedo = { 0.5f, 0.5f, 0.5f };
-		brdfMaterial->parameters.roughness = 1.0f;
-		brdfMaterial->parameters.metalness = 0.0f;
-		ID3D11Resource* resource;
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		if (originalMaterial->diffuseSrvPtr)
-		{
-			originalMaterial->diffuseSrvPtr->GetResource(&resource);
-			originalMaterial->diffuseSrvPtr->GetDesc(&srvDesc);
-			device->CreateShaderResourceView(resource, &srvDesc, &brdfMaterial->diffuseSrvPtr);
-			resource->Release();
-		}
-		if (originalMaterial->normalSrvPtr)
-		{
-			originalMaterial->normalSrvPtr->GetResource(&resource);
-			originalMaterial->normalSrvPtr->GetDesc(&srvDesc);
-			device->CreateShaderResourceView(resource, &srvDesc, &brdfMaterial->normalSrvPtr);
-			resource->Release();
-		}
-		brdfMaterial->InitializeSampler();
-		entities[entityCount - 1]->GetMeshAt(k)->SetMaterial(brdfMaterial);
-	}
-
-	// Get the AABB bounding box of the scene
-	XMVECTOR meshMin;
-	XMVECTOR meshMax;
-	sceneAABBMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-	sceneAABBMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
-	// Calculate the AABB for the scene by iterating through all the meshes in the SDKMesh file.
 	for (int i = 0; i < entityCount; ++i)
 	{
-		for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
-		{
-			auto msh = entities[i]->GetMeshAt(j);
-			XMFLOAT3 bbCenter = msh->BoundingBoxCenter;
-			XMFLOAT3 bbExtent = msh->BoundingBoxExtents;
-			XMVECTOR cen = XMLoadFloat3(&bbCenter);
-			XMVECTOR ext = XMLoadFloat3(&bbExtent);
-			XMVECTOR min = cen - ext;
-			XMVECTOR max = cen + ext;
-
-
-			XMFLOAT4X4 worldMat = entities[i]->GetWorldMatrix();
-			XMMATRIX mat = XMLoadFloat4x4(&worldMat);
-			mat = XMMatrixTranspose(mat);
-
-			BoundingBox bb;
-			BoundingBox::CreateFromPoints(bb, min, max);
-			bb.Transform(bb, mat);
-
-			meshMin = XMVectorSet(bb.Center.x - bb.Extents.x,
-				bb.Center.y - bb.Extents.y,
-				bb.Center.z - bb.Extents.z,
-				1.0f);
-
-			meshMax = XMVectorSet(bb.Center.x + bb.Extents.x,
-				bb.Center.y + bb.Extents.y,
-				bb.Center.z + bb.Extents.z,
-				1.0f);
-
-			sceneAABBMin = XMVectorMin(meshMin, sceneAABBMin);
-			sceneAABBMax = XMVectorMax(meshMax, sceneAABBMax);
-		}
+		entityModels[i].Slot = modelRegistry->Add(nullptr);
+		entityModels[i].Placed = false;
+		entityModels[i].Ready = false;
+		entities[i]->SetModel(modelRegistry, entityModels[i].Slot);
 	}
 
-	XMFLOAT4 aabbMin{};
-	XMFLOAT4 aabbMax{};
-	DirectX::XMStoreFloat4(&aabbMin, sceneAABBMin);
-	DirectX::XMStoreFloat4(&aabbMax, sceneAABBMax);
-
-	LOG_DEBUG << "AABB MIN: x = " << aabbMin.x << ", y = " << aabbMin.y << ", z = " << aabbMin.z << ", w = " << aabbMin.w << std::endl;
-	LOG_DEBUG << "AABB MAX: x = " << aabbMax.x << ", y = " << aabbMax.y << ", z = " << aabbMax.z << ", w = " << aabbMax.w << std::endl;
+	// A unit box until the models are in
+	UpdateSceneBounds();
 
 	skyboxCount = 3;
 	skyboxes = new Skybox *[skyboxCount];
-	skyboxes[0] = new Skybox(device, context, "models\\Skyboxes\\Environment2HiDef.cubemap.dds", "models\\Skyboxes\\Environment2Light.cubemap.dds");
-	skyboxes[1] = new Skybox(device, context, "models\\Skyboxes\\Environment3HiDef.cubemap.dds", "models\\Skyboxes\\Environment3Light.cubemap.dds");
-	skyboxes[2] = new Skybox(device, context, "models\\Skyboxes\\Environment1HiDef.cubemap.dds", "models\\Skyboxes\\Environment1Light.cubemap.dds");
-	currentSkybox = 0;
+	// Drawn black until their maps are loaded
 	for (int i = 0; i < skyboxCount; ++i)
 	{
+		skyboxes[i] = new Skybox(device, context, "", "");
 		skyboxes[i]->SetVertexShader(skyboxVertexShader);
 		skyboxes[i]->SetPixelShader(skyboxPixelShader);
 	}
+	currentSkybox = 0;
+	assetLoader->LoadSkybox(skyboxes[0], "models\\Skyboxes\\Environment2HiDef.cubemap.dds", "models\\Skyboxes\\Environment2Light.cubemap.dds");
+	assetLoader->LoadSkybox(skyboxes[1], "models\\Skyboxes\\Environment3HiDef.cubemap.dds", "models\\Skyboxes\\Environment3Light.cubemap.dds");
+	assetLoader->LoadSkybox(skyboxes[2], "models\\Skyboxes\\Environment1HiDef.cubemap.dds", "models\\Skyboxes\\Environment1Light.cubemap.dds");
 
 	// Initialize Light
 	lightCount = 1;
@@ -446,6 +429,8 @@ bool turnOnNormalMap = true;
 bool visualizeCascade = false;
 bool rotateSkybox = false;
 bool modelAnimationDir = false;
+bool clusterCulling = true;
+bool recordCameraPath = false;
 
 float cascadeBlendArea = 0.001f;
 
@@ -454,6 +439,35 @@ float cascadeBlendArea = 0.001f;
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	// The frame reads the models of the entities from here to the end of Draw, what is published meanwhile shows
+	// from the next frame on
+	modelRegistry->Enter(renderReader);
+
+	// Whatever finished loading since the last frame
+	changedAssets.clear();
+	assetLoader->Update(changedAssets);
+	bool meshesChanged = false;
+	for (AssetHandle handle : changedAssets)
+		meshesChanged = OnAssetChanged(handle) || meshesChanged;
+	for (int i = 0; i < entityCount; ++i)
+		entities[i]->BeginFrame();
+	if (meshesChanged)
+	{
+		UpdateSceneBounds();
+		for (int i = 0; i < lightCount; ++i)
+			lights[i]->SetSceneBounds(sceneAABBMin, sceneAABBMax);
+	}
+	if (!changedAssets.empty() && assetLoader->IsIdle())
+	{
+		LOG_INFO << "All assets ready " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - initStart).count()
+			<< " ms after Init started." << std::endl;
+		assetLoader->LogStats();
+		assetCache->LogStats();
+		geometryArena->LogStats();
+		textureManager->LogStats();
+		VirtualFile::DropPreloaded();
+	}
+
 	if (animateLight)
 	{
 		XMFLOAT3 yAxis = { 0.0f, 1.0f, 0.0f };
@@ -565,6 +579,27 @@ void Game::Update(float deltaTime, float totalTime)
 	{
 		visualizeCascade = !visualizeCascade;
 	}
+	if (GetAsyncKeyState('C') & 0x1)
+	{
+		clusterCulling = !clusterCulling;
+		LOG_INFO << "Cluster culling " << (clusterCulling ? "on" : "off") << "." << std::endl;
+	}
+	if (GetAsyncKeyState('B') & 0x1)
+	{
+		recordCameraPath = !recordCameraPath;
+		if (recordCameraPath)
+		{
+			cameraPath.open("models\\Groudon\\0.obj.path", std::ios::trunc);
+			LOG_INFO << "Recording camera path." << std::endl;
+		}
+		else
+		{
+			cameraPath.close();
+			LOG_INFO << "Camera path saved." << std::endl;
+		}
+	}
+	if (recordCameraPath)
+		RecordCameraPath();
 
 	// Change Skybox
 	if (GetAsyncKeyState('K') & 0x1)
@@ -595,7 +630,9 @@ void Game::Update(float deltaTime, float totalTime)
 		{
 			for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 			{
-				BrdfMaterial* material = reinterpret_cast<BrdfMaterial*>(entities[i]->GetMeshAt(j)->GetMaterial());
+				// Meshes still waiting for their maps are drawn with the default material
+				BrdfMaterial* material = dynamic_cast<BrdfMaterial*>(entities[i]->GetMaterialAt(j));
+				if (!material) continue;
 				material->parameters.roughness += materialSpeed * deltaTime;
 				if (material->parameters.roughness > 1.0f) material->parameters.roughness = 1.0f;
 			}
@@ -608,7 +645,9 @@ void Game::Update(float deltaTime, float totalTime)
 		{
 			for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 			{
-				BrdfMaterial* material = reinterpret_cast<BrdfMaterial*>(entities[i]->GetMeshAt(j)->GetMaterial());
+				// Meshes still waiting for their maps are drawn with the default material
+				BrdfMaterial* material = dynamic_cast<BrdfMaterial*>(entities[i]->GetMaterialAt(j));
+				if (!material) continue;
 				material->parameters.roughness -= materialSpeed * deltaTime;
 				if (material->parameters.roughness < 0.0f) material->parameters.roughness = 0.0f;
 			}
@@ -622,7 +661,9 @@ void Game::Update(float deltaTime, float totalTime)
 		{
 			for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 			{
-				BrdfMaterial* material = reinterpret_cast<BrdfMaterial*>(entities[i]->GetMeshAt(j)->GetMaterial());
+				// Meshes still waiting for their maps are drawn with the default material
+				BrdfMaterial* material = dynamic_cast<BrdfMaterial*>(entities[i]->GetMaterialAt(j));
+				if (!material) continue;
 				material->parameters.metalness += materialSpeed * deltaTime;
 				if (material->parameters.metalness > 1.0f) material->parameters.metalness = 1.0f;
 			}
@@ -635,7 +676,9 @@ void Game::Update(float deltaTime, float totalTime)
 		{
 			for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 			{
-				BrdfMaterial* material = reinterpret_cast<BrdfMaterial*>(entities[i]->GetMeshAt(j)->GetMaterial());
+				// Meshes still waiting for their maps are drawn with the default material
+				BrdfMaterial* material = dynamic_cast<BrdfMaterial*>(entities[i]->GetMaterialAt(j));
+				if (!material) continue;
 				material->parameters.metalness -= materialSpeed * deltaTime;
 				if (material->parameters.metalness < 0.0f) material->parameters.metalness = 0.0f;
 			}
@@ -673,6 +716,10 @@ void Game::Draw(float deltaTime, float totalTime)
 		context->ClearDepthStencilView(lights[i]->GetShadowDepthView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 	}
 
+	// Nothing is known to be bound at the start of a frame
+	boundVertexBuffer = nullptr;
+	boundIndexBuffer = nullptr;
+
 	// Update camera view matrix before drawing
 	camera->UpdateViewMatrix();
 
@@ -711,39 +758,57 @@ void Game::Draw(float deltaTime, float totalTime)
 			{
 				for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 				{
+					const Mesh* mesh = entities[i]->GetMeshAt(j);
+					int& lodLevel = entities[i]->GetLodLevel(j, 1 + c);
+					lodLevel = mesh->SelectLod(entities[i]->GetWorldMatrix(), lights[l]->GetViewMatrix(), lights[l]->GetProjectionMatrixAt(c),
+						lights[l]->GetShadowViewportAt(c)->Height, shadowLod, lodLevel);
+					fullTriangles[1] += mesh->GetIndexCount() / 3;
+
+					// Shadow passes cull front faces
+					const ClusterView clusterView = ClusterCuller::MakeView(entities[i]->GetWorldMatrix(), lights[l]->GetViewMatrix(),
+						lights[l]->GetProjectionMatrixAt(c), -1.0f);
+					if (!CollectDrawRanges(mesh, lodLevel, clusterView, 1)) continue;
+
+					SimpleVertexShader* meshShadowVertexShader = mesh->GetVertexFormat() == VertexFormatFull ? shadowVertexShader : packedShadowVertexShaders[mesh->GetVertexFormat()];
+
 					XMFLOAT4X4 viewMat{};
 					XMFLOAT4X4 projMat{};
 					XMStoreFloat4x4(&viewMat, lights[l]->GetViewMatrix());
 					XMStoreFloat4x4(&projMat, lights[l]->GetProjectionMatrixAt(c));
 					bool result;
-					result = shadowVertexShader->SetMatrix4x4("world", entities[i]->GetWorldMatrix());
+					result = meshShadowVertexShader->SetMatrix4x4("world", entities[i]->GetWorldMatrix());
 					if (!result) LOG_WARNING << "Error setting parameter " << "world" << " to vertex shader. Variable not found." << std::endl;
 
-					result = shadowVertexShader->SetMatrix4x4("view", viewMat);
+					result = meshShadowVertexShader->SetMatrix4x4("view", viewMat);
 					if (!result) LOG_WARNING << "Error setting parameter " << "view" << " to vertex shader. Variable not found." << std::endl;
 
-					result = shadowVertexShader->SetMatrix4x4("projection", projMat);
+					result = meshShadowVertexShader->SetMatrix4x4("projection", projMat);
 					if (!result) LOG_WARNING << "Error setting parameter " << "projection" << " to vertex shader. Variable not found." << std::endl;
 
-					shadowVertexShader->CopyAllBufferData();
+					if (mesh->GetVertexFormat() != VertexFormatFull)
+					{
+						meshShadowVertexShader->SetFloat3("positionScale", mesh->GetDequantization().PositionScale);
+						meshShadowVertexShader->SetFloat3("positionOffset", mesh->GetDequantization().PositionOffset);
+					}
+
+					meshShadowVertexShader->CopyAllBufferData();
 
-					shadowVertexShader->SetShader();
+					meshShadowVertexShader->SetShader();
 					context->PSSetShader(nullptr, nullptr, 0);
 
-					ID3D11Buffer * vertexBuffer = entities[i]->GetMeshAt(j)->GetVertexBuffer();
-					ID3D11Buffer * indexBuffer = entities[i]->GetMeshAt(j)->GetIndexBuffer();
 					// Set buffers in the input assembler
-					//  - Do this ONCE PER OBJECT you're drawing, since each object might
-					//    have different geometry.
-					UINT stride = sizeof(Vertex);
-					UINT offset = 0;
-					context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-					context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
-					context->DrawIndexed(
-						entities[i]->GetMeshAt(j)->GetIndexCount(),		// The number of indices to use (we could draw a subset if we wanted)
-						0,								// Offset to the first index we want to use
-						0);								// Offset to add to each index when looking up vertices
+					//  - Meshes in the geometry arena share their buffers, so this
+					//    only rebinds when the previous mesh used different ones.
+					BindMeshBuffers(mesh);
+
+					for (const DrawRange& range : drawRanges)
+					{
+						context->DrawIndexed(
+							range.IndexCount,							// The number of indices of the visible part
+							mesh->GetStartIndex() + range.FirstIndex,	// Offset to the first index of the visible part
+							mesh->GetBaseVertex());						// Offset to add to each index when looking up vertices
+					}
+					drawCalls += drawRanges.size();
 				}
 			}
 		}
@@ -768,6 +833,24 @@ void Game::Draw(float deltaTime, float totalTime)
 	{
 		for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
 		{
+			const Mesh* mesh = entities[i]->GetMeshAt(j);
+			int& lodLevel = entities[i]->GetLodLevel(j, 0);
+			lodLevel = mesh->SelectLod(entities[i]->GetWorldMatrix(), camera->GetViewMatrix(), camera->GetProjectionMatrix(),
+				float(height), cameraLod, lodLevel);
+			fullTriangles[0] += mesh->GetIndexCount() / 3;
+
+			const ClusterView clusterView = ClusterCuller::MakeView(entities[i]->GetWorldMatrix(), camera->GetViewMatrix(),
+				camera->GetProjectionMatrix(), 1.0f);
+			if (!CollectDrawRanges(mesh, lodLevel, clusterView, 0)) continue;
+
+			// Textures stream in at the mips this draw shows
+			float screenArea;
+			const float pixelsPerUv = mesh->GetPixelsPerUv(entities[i]->GetWorldMatrix(), camera->GetViewMatrix(),
+				camera->GetProjectionMatrix(), float(height), screenArea);
+			textureStreamer->Request(entities[i]->GetMaterialAt(j), pixelsPerUv, screenArea);
+
+			SimpleVertexShader* meshVertexShader = mesh->GetVertexFormat() == VertexFormatFull ? entities[i]->GetMaterialAt(j)->GetVertexShaderPtr() : packedVertexShaders[mesh->GetVertexFormat()];
+
 			// Send data to shader variables
 			//  - Do this ONCE PER OBJECT you're drawing
 			//  - This is actually a complex process of copying data to a local buffer
@@ -780,19 +863,19 @@ void Game::Draw(float deltaTime, float totalTime)
 			//XMStoreFloat4x4(&viewMat, lights[0]->GetViewMatrix());
 			//XMStoreFloat4x4(&projMat, lights[0]->GetProjectionMatrixAt(0));
 			bool result;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetMatrix4x4("world", entities[i]->GetWorldMatrix());
+			result = meshVertexShader->SetMatrix4x4("world", entities[i]->GetWorldMatrix());
 			if (!result) LOG_WARNING << "Error setting parameter " << "world" << " to vertex shader. Variable not found." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetMatrix4x4("itworld", entities[i]->GetWorldMatrixIT());
+			result = meshVertexShader->SetMatrix4x4("itworld", entities[i]->GetWorldMatrixIT());
 			if (!result) LOG_WARNING << "Error setting parameter " << "itworld" << " to vertex shader. Variable not found." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetMatrix4x4("view", viewMat);
+			result = meshVertexShader->SetMatrix4x4("view", viewMat);
 			if (!result) LOG_WARNING << "Error setting parameter " << "view" << " to vertex shader. Variable not found." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetMatrix4x4("projection", projMat);
+			result = meshVertexShader->SetMatrix4x4("projection", projMat);
 			if (!result) LOG_WARNING << "Error setting parameter " << "projection" << " to vertex shader. Variable not found." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetInt("lightCount", lightCount);
+			result = meshVertexShader->SetInt("lightCount", lightCount);
 			if (!result) LOG_WARNING << "Error setting parameter " << "lightCount" << " to vertex shader. Variable not found." << std::endl;
 
 			// Set lights' matrices
@@ -800,16 +883,16 @@ void Game::Draw(float deltaTime, float totalTime)
 			{
 				XMFLOAT4X4 lViewMat{};
 				XMStoreFloat4x4(&lViewMat, lights[0]->GetViewMatrix());
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetMatrix4x4("lView", lViewMat);
+				result = meshVertexShader->SetMatrix4x4("lView", lViewMat);
 				if (!result) LOG_WARNING << "Error setting parameter " << "lView" << " to vertex shader. Variable." << std::endl;
 
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetInt("pcfBlurForLoopStart", 3 / -2);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetInt("pcfBlurForLoopEnd", 3 / 2 + 1);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("cascadeBlendArea", cascadeBlendArea);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("texelSize", 1.0f / 2048.0f);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("nativeTexelSizeInX", 1.0f / 2048.0f / lights[0]->GetCascadeCount());
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("shadowBias", 0);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("shadowPartitionSize", 1.0f / lights[0]->GetCascadeCount());
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetInt("pcfBlurForLoopStart", 3 / -2);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetInt("pcfBlurForLoopEnd", 3 / 2 + 1);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("cascadeBlendArea", cascadeBlendArea);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("texelSize", 1.0f / 2048.0f);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("nativeTexelSizeInX", 1.0f / 2048.0f / lights[0]->GetCascadeCount());
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("shadowBias", 0);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("shadowPartitionSize", 1.0f / lights[0]->GetCascadeCount());
 
 				XMMATRIX matTextureScale = XMMatrixScaling(0.5f, -0.5f, 1.0f);
 				XMMATRIX matTextureTranslation = XMMatrixTranslation(.5f, .5f, 0.f);
@@ -828,26 +911,26 @@ void Game::Draw(float deltaTime, float totalTime)
 					cascadeOffset[index].w = 0;
 				}
 
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetData("cascadeOffset", &cascadeOffset, sizeof(XMFLOAT4) * 3);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetData("cascadeScale", &cascadeScale, sizeof(XMFLOAT4) * 3);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetData("cascadeOffset", &cascadeOffset, sizeof(XMFLOAT4) * 3);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetData("cascadeScale", &cascadeScale, sizeof(XMFLOAT4) * 3);
 
 				// The border padding values keep the pixel shader from reading the borders during PCF filtering.
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("maxBorderPadding", (2048.0f - 1.0f) / 2048.0f);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("minBorderPadding", (1.0f) / 2048.0f);
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetInt("cascadeLevels", lights[0]->GetCascadeCount());
-				result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetInt("visualizeCascades", visualizeCascade ? 1 : 0);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("maxBorderPadding", (2048.0f - 1.0f) / 2048.0f);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("minBorderPadding", (1.0f) / 2048.0f);
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetInt("cascadeLevels", lights[0]->GetCascadeCount());
+				result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetInt("visualizeCascades", visualizeCascade ? 1 : 0);
 
-				//result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetMatrix4x4("cascadeProjection", lProjMat);
+				//result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetMatrix4x4("cascadeProjection", lProjMat);
 				//if (!result) LOG_WARNING << "Error setting parameter " << "cascadeProjection" << " to pixel shader. Variable not found." << std::endl;
 			}
 
 
 
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetInt("lightCount", lightCount);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetInt("lightCount", lightCount);
 			if (!result) LOG_WARNING << "Error setting parameter " << "lightCount" << " to pixel shader. Variable not found." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetData(
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetData(
 				"lights",					// The name of the (eventual) variable in the shader
 				lightData,							// The address of the data to copy
 				sizeof(LightStructure) * 24);		// The size of the data to copy
@@ -855,9 +938,9 @@ void Game::Draw(float deltaTime, float totalTime)
 
 
 			void* materialData;
-			const size_t materialSize = entities[i]->GetMeshAt(j)->GetMaterial()->GetMaterialStruct(&materialData);
+			const size_t materialSize = entities[i]->GetMaterialAt(j)->GetMaterialStruct(&materialData);
 			// Material Data
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetData(
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetData(
 				"material",
 				materialData,
 				int(materialSize)
@@ -865,75 +948,83 @@ void Game::Draw(float deltaTime, float totalTime)
 			if (!result) LOG_WARNING << "Error setting parameter " << "material" << " to pixel shader. Variable not found or size incorrect." << std::endl;
 
 
-			const bool hasNormalMap = entities[i]->GetMeshAt(j)->GetMaterial()->normalSrvPtr != nullptr;
-			const bool hasDiffuseTexture = entities[i]->GetMeshAt(j)->GetMaterial()->diffuseSrvPtr != nullptr;
+			const bool hasNormalMap = entities[i]->GetMaterialAt(j)->normalSrvPtr != nullptr;
+			const bool hasDiffuseTexture = entities[i]->GetMaterialAt(j)->diffuseSrvPtr != nullptr;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("hasNormalMap", turnOnNormalMap && hasNormalMap ? 1.0f : 0.0f);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("hasNormalMap", turnOnNormalMap && hasNormalMap ? 1.0f : 0.0f);
 			if (!result) LOG_WARNING << "Error setting parameter " << "hasNormalMap" << " to pixel shader. Variable not found or size incorrect." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat("hasDiffuseTexture", hasDiffuseTexture ? 1.0f : 0.0f);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat("hasDiffuseTexture", hasDiffuseTexture ? 1.0f : 0.0f);
 			if (!result) LOG_WARNING << "Error setting parameter " << "hasDiffuseTexture" << " to pixel shader. Variable not found or size incorrect." << std::endl;
 
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetFloat3("CameraPosition", camera->GetPosition());
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetFloat3("CameraPosition", camera->GetPosition());
 			if (!result) LOG_WARNING << "Error setting parameter " << "CameraPosition" << " to pixel shader. Variable not found or size incorrect." << std::endl;
 
 			XMMATRIX skyboxRotationMatrix = XMMatrixTranspose(XMMatrixRotationQuaternion(XMQuaternionInverse(skyboxes[currentSkybox]->GetRotationQuaternion())));
 			XMFLOAT4X4 m{};
 			XMStoreFloat4x4(&m, skyboxRotationMatrix);
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetMatrix4x4("SkyboxRotation", m);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetMatrix4x4("SkyboxRotation", m);
 			if (!result) LOG_WARNING << "Error setting parameter " << "SkyboxRotation" << " to pixel shader. Variable not found or size incorrect." << std::endl;
 			// Sampler and Texture
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetSamplerState("basicSampler", entities[i]->GetMeshAt(j)->GetMaterial()->GetSamplerState());
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetSamplerState("basicSampler", entities[i]->GetMaterialAt(j)->GetSamplerState());
 			if (!result) LOG_WARNING << "Error setting sampler state " << "basicSampler" << " to pixel shader. Variable not found." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetSamplerState("shadowSampler", comparisonSampler);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetSamplerState("shadowSampler", comparisonSampler);
 			if (!result) LOG_WARNING << "Error setting sampler state " << "shadowSampler" << " to pixel shader. Variable not found." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("diffuseTexture", entities[i]->GetMeshAt(j)->GetMaterial()->diffuseSrvPtr);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("diffuseTexture", entities[i]->GetMaterialAt(j)->diffuseSrvPtr);
 			if (!result) LOG_WARNING << "Error setting shader resource view " << "diffuseTexture" << " to pixel shader. Variable not found." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("normalTexture", entities[i]->GetMeshAt(j)->GetMaterial()->normalSrvPtr);
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("normalTexture", entities[i]->GetMaterialAt(j)->normalSrvPtr);
 			if (!result) LOG_WARNING << "Error setting shader resource view " << "normalTexture" << " to pixel shader. Variable not found." << std::endl;
 
 			// Set All IBL data
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("cubemap", skyboxes[currentSkybox]->GetCubemapSrv());
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("cubemap", skyboxes[currentSkybox]->GetCubemapSrv());
 			if (!result) LOG_WARNING << "Error setting shader resource view " << "cubemap" << " to pixel shader. Variable not found." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("irradianceMap", skyboxes[currentSkybox]->GetIrradianceSrv());
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("irradianceMap", skyboxes[currentSkybox]->GetIrradianceSrv());
 			if (!result) LOG_WARNING << "Error setting shader resource view " << "irradianceMap" << " to pixel shader. Variable not found." << std::endl;
-			result = entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("shadowMap", lights[0]->GetShadowResourceView());
+			result = entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("shadowMap", lights[0]->GetShadowResourceView());
 			if (!result) LOG_WARNING << "Error setting shader resource view " << "shadowMap" << " to pixel shader. Variable not found." << std::endl;
 
+			if (mesh->GetVertexFormat() != VertexFormatFull)
+			{
+				const VertexDequantization& dequantization = mesh->GetDequantization();
+				meshVertexShader->SetFloat3("positionScale", dequantization.PositionScale);
+				meshVertexShader->SetFloat3("positionOffset", dequantization.PositionOffset);
+				meshVertexShader->SetFloat2("uvScale", dequantization.UVScale);
+				meshVertexShader->SetFloat2("uvOffset", dequantization.UVOffset);
+			}
+
 			// Once you've set all of the data you care to change for
 			// the next draw call, you need to actually send it to the GPU
 			//  - If you skip this, the "SetMatrix" calls above won't make it to the GPU!
-			entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->CopyAllBufferData();
-			entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->CopyAllBufferData();
+			meshVertexShader->CopyAllBufferData();
+			entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->CopyAllBufferData();
 
 			// Set the vertex and pixel shaders to use for the next Draw() command
 			//  - These don't technically need to be set every frame...YET
 			//  - Once you start applying different shaders to different objects,
 			//    you'll need to swap the current shaders before each draw
-			entities[i]->GetMeshAt(j)->GetMaterial()->GetVertexShaderPtr()->SetShader();
-			entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShader();
+			meshVertexShader->SetShader();
+			entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShader();
 
-			ID3D11Buffer * vertexBuffer = entities[i]->GetMeshAt(j)->GetVertexBuffer();
-			ID3D11Buffer * indexBuffer = entities[i]->GetMeshAt(j)->GetIndexBuffer();
 			// Set buffers in the input assembler
-			//  - Do this ONCE PER OBJECT you're drawing, since each object might
-			//    have different geometry.
-			UINT stride = sizeof(Vertex);
-			UINT offset = 0;
-			context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-			context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+			//  - Meshes in the geometry arena share their buffers, so this
+			//    only rebinds when the previous mesh used different ones.
+			BindMeshBuffers(mesh);
 
 			// Finally do the actual drawing
 			//  - Do this ONCE PER OBJECT you intend to draw
 			//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
 			//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 			//     vertices in the currently set VERTEX BUFFER
-			context->DrawIndexed(
-				entities[i]->GetMeshAt(j)->GetIndexCount(),		// The number of indices to use (we could draw a subset if we wanted)
-				0,								// Offset to the first index we want to use
-				0);								// Offset to add to each index when looking up vertices
+			for (const DrawRange& range : drawRanges)
+			{
+				context->DrawIndexed(
+					range.IndexCount,							// The number of indices of the visible part
+					mesh->GetStartIndex() + range.FirstIndex,	// Offset to the first index of the visible part
+					mesh->GetBaseVertex());						// Offset to add to each index when looking up vertices
+			}
+			drawCalls += drawRanges.size();
 
 			// Unbind shadowMap
-			entities[i]->GetMeshAt(j)->GetMaterial()->GetPixelShaderPtr()->SetShaderResourceView("shadowMap", nullptr);
+			entities[i]->GetMaterialAt(j)->GetPixelShaderPtr()->SetShaderResourceView("shadowMap", nullptr);
 		}
 	}
 
@@ -1015,6 +1106,249 @@ void Game::Draw(float deltaTime, float totalTime)
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
 	swapChain->Present(0, 0);
+	if (!firstFrameDrawn)
+	{
+		LOG_INFO << "First frame drawn " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - initStart).count()
+			<< " ms after Init started." << std::endl;
+		firstFrameDrawn = true;
+	}
+
+	// Mips for this frame's requests, materials see new ones from the next frame on
+	textureStreamer->Update();
+	ReportTriangleCounts(totalTime);
+
+	// Models replaced before this frame are not drawn any more
+	modelRegistry->Exit(renderReader);
+	modelRegistry->Reclaim();
+}
+
+// --------------------------------------------------------
+// Bind the vertex and index buffers of a mesh unless they
+// are bound already
+// --------------------------------------------------------
+void Game::BindMeshBuffers(const Mesh* mesh)
+{
+	ID3D11Buffer* vertexBuffer = mesh->GetVertexBuffer();
+	ID3D11Buffer* indexBuffer = mesh->GetIndexBuffer();
+	// Each buffer holds one vertex or index format, so the stride and format come along with it
+	if (vertexBuffer != boundVertexBuffer)
+	{
+		UINT stride = mesh->GetVertexStride();
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		boundVertexBuffer = vertexBuffer;
+		++bufferBinds;
+	}
+	if (indexBuffer != boundIndexBuffer)
+	{
+		context->IASetIndexBuffer(indexBuffer, mesh->GetIndexFormat(), 0);
+		boundIndexBuffer = indexBuffer;
+		++bufferBinds;
+	}
+}
+
+// --------------------------------------------------------
+// Fill drawRanges with the visible parts of a mesh for one
+// pass (0 camera, 1 shadows) and count what gets drawn
+// --------------------------------------------------------
+bool Game::CollectDrawRanges(const Mesh* mesh, int lodLevel, const ClusterView& view, int pass)
+{
+	drawRanges.clear();
+	if (lodLevel == 0 && clusterCulling)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		const ClusterCullStats stats = mesh->CullClusters(view, drawRanges);
+		cullSeconds[pass] += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		visibleClusters[pass] += stats.Visible;
+		testedClusters[pass] += stats.Visible + stats.FrustumCulled + stats.ConeCulled;
+	}
+	else if (mesh->IsVisible(view))
+	{
+		const MeshLod& lod = mesh->GetLod(lodLevel);
+		drawRanges.push_back({ lod.FirstIndex, lod.IndexCount });
+	}
+
+	for (const DrawRange& range : drawRanges)
+		drawnTriangles[pass] += range.IndexCount / 3;
+	return !drawRanges.empty();
+}
+
+// --------------------------------------------------------
+// Log the average triangles and clusters per frame once per second,
+// next to what the same frames would cost at full detail, and
+// where texture streaming stands in the last frame
+// --------------------------------------------------------
+void Game::ReportTriangleCounts(float totalTime)
+{
+	++reportFrames;
+	if (totalTime - reportTime < 1.0f)
+		return;
+
+	LOG_INFO << "Triangles per frame: camera " << drawnTriangles[0] / reportFrames << " of " << fullTriangles[0] / reportFrames
+		<< ", shadows " << drawnTriangles[1] / reportFrames << " of " << fullTriangles[1] / reportFrames << "." << std::endl;
+	LOG_INFO << "Draw calls per frame: " << drawCalls / reportFrames << " with " << bufferBinds / reportFrames << " buffer binds." << std::endl;
+	textureStreamer->LogStats();
+	if (testedClusters[0] + testedClusters[1] > 0)
+	{
+		LOG_INFO << "Clusters per frame: camera " << visibleClusters[0] / reportFrames << " of " << testedClusters[0] / reportFrames
+			<< ", shadows " << visibleClusters[1] / reportFrames << " of " << testedClusters[1] / reportFrames << ", "
+			<< (cullSeconds[0] + cullSeconds[1]) * 1e9 / double(testedClusters[0] + testedClusters[1]) << " ns per cluster." << std::endl;
+	}
+
+	for (int p = 0; p < 2; ++p)
+	{
+		drawnTriangles[p] = 0;
+		fullTriangles[p] = 0;
+		visibleClusters[p] = 0;
+		testedClusters[p] = 0;
+		cullSeconds[p] = 0.0;
+	}
+	drawCalls = 0;
+	bufferBinds = 0;
+	reportFrames = 0;
+	reportTime = totalTime;
+}
+
+// --------------------------------------------------------
+// Append the camera of this frame to the recorded path
+// --------------------------------------------------------
+void Game::RecordCameraPath()
+{
+	// Object space of the first entity, so the path fits the mesh on its own
+	const XMMATRIX objectFromWorld = XMMatrixInverse(nullptr, XMMatrixTranspose(XMLoadFloat4x4(&entities[0]->GetWorldMatrix())));
+	const XMFLOAT3 position = camera->GetPosition();
+	const XMFLOAT3 forward = camera->GetForward();
+	XMFLOAT3 objectPosition{};
+	XMFLOAT3 objectForward{};
+	XMStoreFloat3(&objectPosition, XMVector3TransformCoord(XMLoadFloat3(&position), objectFromWorld));
+	XMStoreFloat3(&objectForward, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&forward), objectFromWorld)));
+	cameraPath << objectPosition.x << " " << objectPosition.y << " " << objectPosition.z << " "
+		<< objectForward.x << " " << objectForward.y << " " << objectForward.z << "\n";
+}
+
+// --------------------------------------------------------
+// Publish the meshes of models that arrived for their
+// entities, and BRDF materials once the texture maps are in.
+// Returns whether any entity got new meshes.
+// --------------------------------------------------------
+bool Game::OnAssetChanged(AssetHandle handle)
+{
+	const LoadState state = assetLoader->GetState(handle);
+	bool meshesChanged = false;
+	for (int i = 0; i < entityCount; ++i)
+	{
+		EntityModel& model = entityModels[i];
+		if (model.Model != handle || model.Ready) continue;
+		if (state == LoadPlaceholder && !model.Placed)
+		{
+			std::unique_ptr<ModelVersion> version(new ModelVersion());
+			version->Meshes = assetLoader->GetMeshes(handle);
+			modelRegistry->Publish(model.Slot, std::move(version));
+			model.Placed = true;
+			meshesChanged = true;
+		}
+		if (state == LoadReady)
+		{
+			PublishBrdfMaterials(model);
+			meshesChanged = meshesChanged || !model.Placed;
+			model.Placed = true;
+			model.Ready = true;
+		}
+	}
+	return meshesChanged;
+}
+
+// --------------------------------------------------------
+// Publish a model's meshes with BRDF materials sharing the
+// texture maps of their own
+// --------------------------------------------------------
+void Game::PublishBrdfMaterials(const EntityModel& model)
+{
+	std::unique_ptr<ModelVersion> version(new ModelVersion());
+	version->Meshes = assetLoader->GetMeshes(model.Model);
+	for (const std::shared_ptr<Mesh>& mesh : version->Meshes)
+	{
+		auto originalMaterial = mesh->GetMaterial();
+		// Test the new BRDF Material
+		std::shared_ptr<BrdfMaterial> brdfMaterial = std::make_shared<BrdfMaterial>(vertexShader, brdfPixelShader, device);
+		brdfMaterial->parameters.albedo = model.Albedo;
+		brdfMaterial->parameters.roughness = model.Roughness;
+		brdfMaterial->parameters.metalness = model.Metalness;
+		// Share the views, every material releases its own reference
+		brdfMaterial->diffuseSrvPtr = originalMaterial->diffuseSrvPtr;
+		brdfMaterial->normalSrvPtr = originalMaterial->normalSrvPtr;
+		if (brdfMaterial->diffuseSrvPtr) { brdfMaterial->diffuseSrvPtr->AddRef(); }
+		if (brdfMaterial->normalSrvPtr) { brdfMaterial->normalSrvPtr->AddRef(); }
+		brdfMaterial->InitializeSampler();
+		textureStreamer->AddMaterial(brdfMaterial.get());
+		version->Materials.push_back(brdfMaterial);
+	}
+	// Takes them out of the streamer again when it is reclaimed
+	version->Streamer = textureStreamer;
+	modelRegistry->Publish(model.Slot, std::move(version));
+}
+
+// --------------------------------------------------------
+// Get the AABB bounding box of the scene, a unit box while
+// no model is loaded
+// --------------------------------------------------------
+void Game::UpdateSceneBounds()
+{
+	XMVECTOR meshMin;
+	XMVECTOR meshMax;
+	sceneAABBMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+	sceneAABBMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	bool empty = true;
+	// Calculate the AABB for the scene by iterating through all the meshes in the SDKMesh file.
+	for (int i = 0; i < entityCount; ++i)
+	{
+		for (int j = 0; j < entities[i]->GetMeshCount(); ++j)
+		{
+			auto msh = entities[i]->GetMeshAt(j);
+			XMFLOAT3 bbCenter = msh->BoundingBoxCenter;
+			XMFLOAT3 bbExtent = msh->BoundingBoxExtents;
+			XMVECTOR cen = XMLoadFloat3(&bbCenter);
+			XMVECTOR ext = XMLoadFloat3(&bbExtent);
+			XMVECTOR min = cen - ext;
+			XMVECTOR max = cen + ext;
+
+
+			XMFLOAT4X4 worldMat = entities[i]->GetWorldMatrix();
+			XMMATRIX mat = XMLoadFloat4x4(&worldMat);
+			mat = XMMatrixTranspose(mat);
+
+			BoundingBox bb;
+			BoundingBox::CreateFromPoints(bb, min, max);
+			bb.Transform(bb, mat);
+
+			meshMin = XMVectorSet(bb.Center.x - bb.Extents.x,
+				bb.Center.y - bb.Extents.y,
+				bb.Center.z - bb.Extents.z,
+				1.0f);
+
+			meshMax = XMVectorSet(bb.Center.x + bb.Extents.x,
+				bb.Center.y + bb.Extents.y,
+				bb.Center.z + bb.Extents.z,
+				1.0f);
+
+			sceneAABBMin = XMVectorMin(meshMin, sceneAABBMin);
+			sceneAABBMax = XMVectorMax(meshMax, sceneAABBMax);
+			empty = false;
+		}
+	}
+	if (empty)
+	{
+		sceneAABBMin = XMVectorSet(-1.0f, -1.0f, -1.0f, 1.0f);
+		sceneAABBMax = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+
+	XMFLOAT4 aabbMin{};
+	XMFLOAT4 aabbMax{};
+	DirectX::XMStoreFloat4(&aabbMin, sceneAABBMin);
+	DirectX::XMStoreFloat4(&aabbMax, sceneAABBMax);
+
+	LOG_DEBUG << "AABB MIN: x = " << aabbMin.x << ", y = " << aabbMin.y << ", z = " << aabbMin.z << ", w = " << aabbMin.w << std::endl;
+	LOG_DEBUG << "AABB MAX: x = " << aabbMax.x << ", y = " << aabbMax.y << ", z = " << aabbMax.z << ", w = " << aabbMax.w << std::endl;
 }
 
 void Game::PostRender(int resourceIndex, int targetIndex, SimplePixelShader* pixelShader, const std::vector<std::pair<std::string, std::pair<void*, unsigned>>>& data)
@@ -1113,6 +1447,34 @@ void Game::PostRenderCopy(int resourceIndex, int targetIndex, float xScale, floa
 	PostRender(resourceIndex, targetIndex, ppCopyShader, scaleData);
 }
 
+// --------------------------------------------------------
+// Load a vertex shader for one of the packed vertex formats.
+// Reflection would create an all-float input layout, so the
+// layout is built from Mesh::GetInputElements instead.
+// --------------------------------------------------------
+SimpleVertexShader* Game::LoadPackedVertexShader(LPCWSTR shaderFile, VertexFormat format)
+{
+	ID3D11InputLayout* inputLayout = nullptr;
+	ID3DBlob* shaderBlob = nullptr;
+	if (SUCCEEDED(ISimpleShader::ReadShaderBlob(shaderFile, &shaderBlob)))
+	{
+		const std::vector<D3D11_INPUT_ELEMENT_DESC> elements = Mesh::GetInputElements(format);
+		const HRESULT hr = device->CreateInputLayout(elements.data(), UINT(elements.size()),
+			shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &inputLayout);
+		if (FAILED(hr))
+			LOG_ERROR << "Failed to create the " << VertexPacker::GetFormatName(format) << " vertex input layout." << std::endl;
+		shaderBlob->Release();
+	}
+	else
+	{
+		LOG_ERROR << "Failed to read " << VertexPacker::GetFormatName(format) << " vertex shader." << std::endl;
+	}
+
+	SimpleVertexShader* shader = new SimpleVertexShader(device, context, inputLayout, false);
+	shader->LoadShaderFile(shaderFile);
+	return shader;
+}
+
 
 #pragma region Mouse Input
 
@@ -1196,3 +1558,4 @@ void Game::OnMouseWheel(float wheelDelta, int x, int y)
 	}
 }
 #pragma endregion
+
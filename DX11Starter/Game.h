@@ -5,8 +5,11 @@
 #include "GameEntity.h"
 #include "FirstPersonCamera.h"
 #include "Light.h"
+#include <chrono>
 #include <fstream>
 #include "Skybox.h"
+#include "AssetLoader.h"
+#include "VertexPacker.h"
 #include <DirectXCollision.h>
 
 class Game 
@@ -63,6 +66,50 @@ private:
 	SimplePixelShader* ppGaussianBlurUShader;
 	SimplePixelShader* ppGaussianBlurVShader;
 
+	// Shaders for the packed vertex formats, indexed by VertexFormat. VertexFormatFull uses the ones above.
+	SimpleVertexShader* packedVertexShaders[VertexFormatCount];
+	SimpleVertexShader* packedShadowVertexShaders[VertexFormatCount];
+
+	// Shared vertex and index buffers of all loaded meshes
+	GeometryArena* geometryArena;
+	// Decodes the textures of all loaded models, each distinct image once
+	TextureManager* textureManager;
+	// Keeps the mips of the cooked textures that the camera needs within a memory budget
+	TextureStreamer* textureStreamer;
+	// Buffers in the input assembler during the mesh passes, so meshes sharing them skip the rebind
+	ID3D11Buffer* boundVertexBuffer;
+	ID3D11Buffer* boundIndexBuffer;
+	void BindMeshBuffers(const Mesh* mesh);
+	SimpleVertexShader* LoadPackedVertexShader(LPCWSTR shaderFile, VertexFormat format);
+
+	// Loads the models and skyboxes while the first frames are drawn
+	AssetLoader* assetLoader;
+	// Every model loaded, kept under a memory budget once no entity uses it
+	AssetCache* assetCache;
+	// Current version of every entity's model, read by the frames without locks
+	ModelRegistry* modelRegistry;
+	int renderReader;
+	// The model of every entity, its slot in the registry and the BRDF material its meshes get once it is ready
+	struct EntityModel
+	{
+		AssetHandle Model;
+		DirectX::XMFLOAT3 Albedo;
+		float Roughness;
+		float Metalness;
+		uint32_t Slot;
+		// Meshes published, and with their materials
+		bool Placed;
+		bool Ready;
+	};
+	std::vector<EntityModel> entityModels;
+	std::vector<AssetHandle> changedAssets;
+	bool OnAssetChanged(AssetHandle handle);
+	void PublishBrdfMaterials(const EntityModel& model);
+	void UpdateSceneBounds();
+	// Time to the first frame and to all assets, from the start of Init
+	std::chrono::high_resolution_clock::time_point initStart;
+	bool firstFrameDrawn;
+
 	// Keeps track of the old mouse position.  Useful for 
 	// determining how far the mouse moved in a single frame.
 	POINT prevMousePos;
@@ -89,5 +136,35 @@ private:
 	LightStructure* lightData;
 	SimpleVertexShader* shadowVertexShader;
 	SimplePixelShader* shadowPixelShader;
+
+	// Level of detail
+	LodSelection cameraLod;
+	LodSelection shadowLod;
+
+	// Triangles drawn and triangles at full detail, camera pass and shadow passes,
+	// summed up over the frames since the last report
+	size_t drawnTriangles[2];
+	size_t fullTriangles[2];
+	// Clusters drawn and tested and the time spent culling them, same passes
+	size_t visibleClusters[2];
+	size_t testedClusters[2];
+	double cullSeconds[2];
+	// Draw calls and vertex/index buffer binds
+	size_t drawCalls;
+	size_t bufferBinds;
+	int reportFrames;
+	float reportTime;
+	void ReportTriangleCounts(float totalTime);
+
+	// Parts of the index buffer for the current draw, kept to reuse the memory
+	std::vector<DrawRange> drawRanges;
+	// Pick the parts of a mesh to draw with its level of detail, culling the clusters of the full detail level.
+	// Returns false if nothing is visible.
+	bool CollectDrawRanges(const Mesh* mesh, int lodLevel, const ClusterView& view, int pass);
+
+	// Camera path, one "position forward" line per frame in the object space of the first entity,
+	// for BenchmarkClusterCulling to replay
+	std::ofstream cameraPath;
+	void RecordCameraPath();
 };
 
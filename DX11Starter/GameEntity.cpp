@@ -1,11 +1,26 @@
 #include "GameEntity.h"
 #include "SimpleLogger.h"
+#include "TextureStreamer.h"
+
+ModelVersion::~ModelVersion()
+{
+	// The streamer would write the views of materials that are gone
+	if (!Streamer) return;
+	for (const std::shared_ptr<Material>& material : Materials)
+	{
+		if (material) Streamer->RemoveMaterial(material.get());
+	}
+}
 
 GameEntity::GameEntity()
 {
 	meshCount = 0;
 	meshes = nullptr;
 	InitializeTransform();
+	lodLevels.assign(meshCount * LodSlotCount, -1);
+	registry = nullptr;
+	modelSlot = 0;
+	model = nullptr;
 
 	LOG_INFO << "GameEntity created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
 }
@@ -16,6 +31,10 @@ GameEntity::GameEntity(const std::shared_ptr<Mesh>& m)
 	meshes = new std::shared_ptr<Mesh>[1];
 	meshes[0] = m;
 	InitializeTransform();
+	lodLevels.assign(meshCount * LodSlotCount, -1);
+	registry = nullptr;
+	modelSlot = 0;
+	model = nullptr;
 
 	LOG_INFO << "GameEntity created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
 }
@@ -29,6 +48,10 @@ GameEntity::GameEntity(std::vector<std::shared_ptr<Mesh>> m)
 		meshes[i] = m[i];
 	}
 	InitializeTransform();
+	lodLevels.assign(meshCount * LodSlotCount, -1);
+	registry = nullptr;
+	modelSlot = 0;
+	model = nullptr;
 
 	LOG_INFO << "GameEntity created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
 }
@@ -107,14 +130,45 @@ DirectX::XMFLOAT4X4& GameEntity::GetWorldMatrixIT()
 
 int GameEntity::GetMeshCount() const
 {
+	if (registry) return model ? int(model->Meshes.size()) : 0;
 	return meshCount;
 }
 
 Mesh* GameEntity::GetMeshAt(int index) const
 {
+	if (registry) return model->Meshes[index].get();
 	return meshes[index].get();
 }
 
+Material* GameEntity::GetMaterialAt(int index) const
+{
+	if (registry && size_t(index) < model->Materials.size() && model->Materials[index])
+		return model->Materials[index].get();
+	return GetMeshAt(index)->GetMaterial();
+}
+
+void GameEntity::SetModel(const ModelRegistry* r, uint32_t slot)
+{
+	registry = r;
+	modelSlot = slot;
+	model = nullptr;
+}
+
+void GameEntity::BeginFrame()
+{
+	if (!registry) return;
+	const ModelVersion* current = registry->Get(modelSlot);
+	if (current == model) return;
+	model = current;
+	// Levels of detail start over with the new meshes
+	lodLevels.assign(GetMeshCount() * LodSlotCount, -1);
+}
+
+int& GameEntity::GetLodLevel(int mesh, int slot)
+{
+	return lodLevels[mesh * LodSlotCount + slot];
+}
+
 void GameEntity::MoveToward(DirectX::XMFLOAT3 direction, const float distance)
 {
 	const DirectX::XMVECTOR dir = XMLoadFloat3(&direction);
@@ -4,6 +4,28 @@
 #include <DirectXMath.h>
 #include "Mesh.h"
 #include "Material.h"
+#include "AssetRegistry.h"
+
+class TextureStreamer;
+
+// What an entity draws: its meshes, and the material for each instead of the mesh's own where not null. Replaced as
+// a whole by publishing a new one, so the render thread never sees half of a change.
+struct ModelVersion
+{
+	ModelVersion() : Streamer(nullptr) {}
+	// Removes the materials from Streamer. Versions are reclaimed on the render thread, the one Streamer runs on.
+	~ModelVersion();
+
+	ModelVersion(const ModelVersion&) = delete;
+	ModelVersion& operator=(const ModelVersion&) = delete;
+
+	std::vector<std::shared_ptr<Mesh>> Meshes;
+	// Belong to this version alone, nothing else may hold them once it is reclaimed
+	std::vector<std::shared_ptr<Material>> Materials;
+	// Keeps the views of Materials current, null if they were not added to one. Has to outlive the version.
+	TextureStreamer* Streamer;
+};
+typedef AssetRegistry<ModelVersion> ModelRegistry;
 
 class GameEntity
 {
@@ -26,6 +48,20 @@ public:
 
 	int GetMeshCount() const;
 	Mesh* GetMeshAt(int index) const;
+	// The material a mesh is drawn with
+	Material* GetMaterialAt(int index) const;
+
+	// Draw the model in a registry slot instead of the meshes given on construction, the version that was current at
+	// the last BeginFrame. registry has to outlive the entity.
+	void SetModel(const ModelRegistry* r, uint32_t slot);
+	// Pin the current version of the model for this frame. Only inside the frame's read of the registry, the meshes
+	// are valid until it ends.
+	void BeginFrame();
+
+	// Level of detail each mesh got last frame, -1 before the first one.
+	// Slot 0 is the camera pass, the shadow cascades follow.
+	static const int LodSlotCount = 4;
+	int& GetLodLevel(int mesh, int slot);
 
 	void MoveToward(DirectX::XMFLOAT3 direction, float distance);
 	void RotateAxis(DirectX::XMFLOAT3 axis, float radian);
@@ -41,6 +77,10 @@ private:
 
 	int meshCount;
 	std::shared_ptr<Mesh>* meshes;
+	std::vector<int> lodLevels;
+	const ModelRegistry* registry;
+	uint32_t modelSlot;
+	const ModelVersion* model;
 
 	bool shouldUpdate = true;
 
@@ -0,0 +1,190 @@
+#include "GeometryArena.h"
+#include <algorithm>
+#include "SimpleLogger.h"
+
+GeometryArena::GeometryArena(ID3D11Device* device, ID3D11DeviceContext* context, UINT initialVertices, UINT initialIndices)
+{
+	this->device = device;
+	this->context = context;
+	this->initialVertices = initialVertices;
+	this->initialIndices = initialIndices;
+
+	for (int f = 0; f < VertexFormatCount; ++f)
+	{
+		vertexPools[f].Buffer = nullptr;
+		vertexPools[f].ElementSize = UINT(VertexPacker::GetVertexSize(VertexFormat(f)));
+		vertexPools[f].BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	}
+	indexPools[0].Buffer = nullptr;
+	indexPools[0].ElementSize = sizeof(uint16_t);
+	indexPools[0].BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexPools[1].Buffer = nullptr;
+	indexPools[1].ElementSize = sizeof(uint32_t);
+	indexPools[1].BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+	LOG_INFO << "GeometryArena created at <0x" << this << ">." << std::endl;
+}
+
+GeometryArena::~GeometryArena()
+{
+	for (Pool& pool : vertexPools)
+		if (pool.Buffer) { pool.Buffer->Release(); }
+	for (Pool& pool : indexPools)
+		if (pool.Buffer) { pool.Buffer->Release(); }
+
+	LOG_INFO << "GeometryArena destroyed at <0x" << this << ">." << std::endl;
+}
+
+GeometryAllocation GeometryArena::Allocate(const void* vertices, UINT vertexCount, VertexFormat vertexFormat,
+	const void* indices, UINT indexCount, DXGI_FORMAT indexFormat)
+{
+	GeometryAllocation allocation{};
+	allocation.Format = vertexFormat;
+	allocation.IndexFormat = indexFormat;
+	allocation.Vertices = Store(vertexPools[vertexFormat], vertices, vertexCount);
+	allocation.Indices = allocation.Vertices == RangeAllocator::InvalidHandle
+		? RangeAllocator::InvalidHandle : Store(GetIndexPool(indexFormat), indices, indexCount);
+	if (!IsValid(allocation))
+	{
+		Free(allocation);
+		allocation.Vertices = RangeAllocator::InvalidHandle;
+		allocation.Indices = RangeAllocator::InvalidHandle;
+	}
+	return allocation;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	vertexPools[allocation.Format].Allocator.Free(allocation.Vertices);
+	GetIndexPool(allocation.IndexFormat).Allocator.Free(allocation.Indices);
+}
+
+void GeometryArena::Defragment()
+{
+	for (Pool& pool : vertexPools)
+	{
+		// Nothing to gain once all free space is one range
+		const RangeAllocator& allocator = pool.Allocator;
+		if (pool.Buffer && allocator.GetLargestFreeRange() != allocator.GetCapacity() - allocator.GetUsed())
+			Defragment(pool);
+	}
+	for (Pool& pool : indexPools)
+	{
+		const RangeAllocator& allocator = pool.Allocator;
+		if (pool.Buffer && allocator.GetLargestFreeRange() != allocator.GetCapacity() - allocator.GetUsed())
+			Defragment(pool);
+	}
+}
+
+UINT GeometryArena::GetBaseVertex(const GeometryAllocation& allocation) const
+{
+	return vertexPools[allocation.Format].Allocator.GetOffset(allocation.Vertices);
+}
+
+UINT GeometryArena::GetStartIndex(const GeometryAllocation& allocation) const
+{
+	return GetIndexPool(allocation.IndexFormat).Allocator.GetOffset(allocation.Indices);
+}
+
+void GeometryArena::LogStats() const
+{
+	const auto log = [](const char* name, const Pool& pool)
+	{
+		if (!pool.Buffer) return;
+		const RangeAllocator& allocator = pool.Allocator;
+		LOG_INFO << "GeometryArena " << name << ": " << allocator.GetAllocationCount() << " allocations, "
+			<< allocator.GetUsed() << " of " << allocator.GetCapacity() << " elements used ("
+			<< size_t(allocator.GetCapacity()) * pool.ElementSize << " bytes), " << allocator.GetFreeRangeCount() << " free ranges." << std::endl;
+	};
+	for (int f = 0; f < VertexFormatCount; ++f)
+		log(VertexPacker::GetFormatName(VertexFormat(f)), vertexPools[f]);
+	log("16-bit indices", indexPools[0]);
+	log("32-bit indices", indexPools[1]);
+}
+
+ID3D11Buffer* GeometryArena::CreateBuffer(const Pool& pool, UINT capacity) const
+{
+	// Default usage instead of immutable, so ranges can be filled and moved later
+	D3D11_BUFFER_DESC bd;
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.ByteWidth = capacity * pool.ElementSize;
+	bd.BindFlags = pool.BindFlags;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+	bd.StructureByteStride = 0;
+
+	ID3D11Buffer* buffer = nullptr;
+	if (FAILED(device->CreateBuffer(&bd, nullptr, &buffer)))
+	{
+		LOG_ERROR << "Failed to create a " << bd.ByteWidth << " byte geometry arena buffer." << std::endl;
+		return nullptr;
+	}
+	return buffer;
+}
+
+UINT GeometryArena::GetInitialCapacity(const Pool& pool) const
+{
+	return pool.BindFlags == D3D11_BIND_VERTEX_BUFFER ? initialVertices : initialIndices;
+}
+
+RangeAllocator::Handle GeometryArena::Store(Pool& pool, const void* data, UINT count)
+{
+	RangeAllocator::Handle handle = pool.Allocator.Allocate(count);
+	if (handle == RangeAllocator::InvalidHandle && count > 0)
+	{
+		// Free space may only be scattered, otherwise make room at the end
+		const UINT capacity = pool.Allocator.GetCapacity();
+		bool rebuilt;
+		if (pool.Buffer && capacity - pool.Allocator.GetUsed() >= count)
+			rebuilt = Defragment(pool);
+		else
+		{
+			const UINT newCapacity = std::max(std::max(capacity * 2, pool.Allocator.GetUsed() + count), GetInitialCapacity(pool));
+			std::vector<RangeAllocator::Move> moves;
+			if (capacity > 0) moves.push_back({ 0, 0, capacity });
+			rebuilt = Rebuild(pool, newCapacity, moves);
+			if (rebuilt) pool.Allocator.Grow(newCapacity);
+		}
+		if (!rebuilt) return RangeAllocator::InvalidHandle;
+		handle = pool.Allocator.Allocate(count);
+	}
+	if (handle == RangeAllocator::InvalidHandle || !pool.Buffer) return handle;
+
+	D3D11_BOX box = {};
+	box.left = pool.Allocator.GetOffset(handle) * pool.ElementSize;
+	box.right = box.left + count * pool.ElementSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(pool.Buffer, 0, &box, data, 0, 0);
+	return handle;
+}
+
+bool GeometryArena::Defragment(Pool& pool)
+{
+	// Packed on a copy, the pool's allocator has to keep matching its buffer if the new one cannot be made
+	RangeAllocator packed = pool.Allocator;
+	if (!Rebuild(pool, packed.GetCapacity(), packed.Defragment())) return false;
+	pool.Allocator = std::move(packed);
+	return true;
+}
+
+bool GeometryArena::Rebuild(Pool& pool, UINT capacity, const std::vector<RangeAllocator::Move>& moves)
+{
+	ID3D11Buffer* buffer = device ? CreateBuffer(pool, capacity) : nullptr;
+	if (!buffer) return false;
+
+	// Copies go to a new buffer, D3D11 does not allow overlapping copies within one
+	for (const RangeAllocator::Move& move : moves)
+	{
+		D3D11_BOX box = {};
+		box.left = move.From * pool.ElementSize;
+		box.right = box.left + move.Size * pool.ElementSize;
+		box.bottom = 1;
+		box.back = 1;
+		context->CopySubresourceRegion(buffer, 0, move.To * pool.ElementSize, 0, 0, pool.Buffer, 0, &box);
+	}
+
+	if (pool.Buffer) { pool.Buffer->Release(); }
+	pool.Buffer = buffer;
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <d3d11.h>
+#include "RangeAllocator.h"
+#include "VertexPacker.h"
+
+// Where a mesh lives inside a GeometryArena
+struct GeometryAllocation
+{
+	VertexFormat Format;
+	DXGI_FORMAT IndexFormat;
+	RangeAllocator::Handle Vertices;
+	RangeAllocator::Handle Indices;
+};
+
+// Vertices and indices of many meshes sub-allocated out of a few large buffers: one vertex buffer per
+// vertex format and one index buffer per index format. Meshes sharing a format draw without rebinding
+// anything, using base vertex and start index offsets. Buffers are created on first use and
+// grow by doubling when full.
+class GeometryArena
+{
+public:
+	GeometryArena(ID3D11Device* device, ID3D11DeviceContext* context, UINT initialVertices = 1 << 18, UINT initialIndices = 1 << 20);
+	~GeometryArena();
+
+	// Copy a mesh into the arena. indexFormat is DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT,
+	// indices are relative to the mesh's first vertex. Either both ranges are stored or neither is,
+	// see IsValid.
+	GeometryAllocation Allocate(const void* vertices, UINT vertexCount, VertexFormat vertexFormat,
+		const void* indices, UINT indexCount, DXGI_FORMAT indexFormat);
+	void Free(const GeometryAllocation& allocation);
+	// False when the arena could not make room, the mesh needs buffers of its own then
+	static bool IsValid(const GeometryAllocation& allocation)
+	{
+		return allocation.Vertices != RangeAllocator::InvalidHandle && allocation.Indices != RangeAllocator::InvalidHandle;
+	}
+
+	// Pack every buffer to the front, copying on the GPU. Allocations stay valid, their offsets change.
+	// A pool whose new buffer cannot be created stays as it is.
+	void Defragment();
+
+	ID3D11Buffer* GetVertexBuffer(VertexFormat vertexFormat) const { return vertexPools[vertexFormat].Buffer; }
+	ID3D11Buffer* GetIndexBuffer(DXGI_FORMAT indexFormat) const { return GetIndexPool(indexFormat).Buffer; }
+	// Offsets for DrawIndexed
+	UINT GetBaseVertex(const GeometryAllocation& allocation) const;
+	UINT GetStartIndex(const GeometryAllocation& allocation) const;
+
+	void LogStats() const;
+
+private:
+	struct Pool
+	{
+		ID3D11Buffer* Buffer;
+		UINT ElementSize;
+		UINT BindFlags;
+		RangeAllocator Allocator;
+	};
+
+	Pool& GetIndexPool(DXGI_FORMAT indexFormat) { return indexPools[indexFormat == DXGI_FORMAT_R16_UINT ? 0 : 1]; }
+	const Pool& GetIndexPool(DXGI_FORMAT indexFormat) const { return indexPools[indexFormat == DXGI_FORMAT_R16_UINT ? 0 : 1]; }
+
+	ID3D11Buffer* CreateBuffer(const Pool& pool, UINT capacity) const;
+	UINT GetInitialCapacity(const Pool& pool) const;
+	// Allocate, growing or packing the pool if needed, and upload the data. InvalidHandle when there is no room.
+	RangeAllocator::Handle Store(Pool& pool, const void* data, UINT count);
+	// Move the live ranges of a pool into a new buffer of the given capacity. False, with the pool's buffer left
+	// as it was, when the buffer cannot be created; the caller changes the allocator only after it succeeded.
+	bool Rebuild(Pool& pool, UINT capacity, const std::vector<RangeAllocator::Move>& moves);
+	// Pack the pool to the front, or leave it as it was
+	bool Defragment(Pool& pool);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	UINT initialVertices;
+	UINT initialIndices;
+
+	Pool vertexPools[VertexFormatCount];
+	// 16-bit and 32-bit
+	Pool indexPools[2];
+};
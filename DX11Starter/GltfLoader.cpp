@@ -0,0 +1,237 @@
+#include "GltfLoader.h"
+#include "FileSystem.h"
+#include "GltfParser.h"
+#include "MeshCooker.h"
+#include "SimpleLogger.h"
+#include "VirtualFile.h"
+
+namespace
+{
+	std::shared_ptr<BrdfMaterial> CreateMaterial(const GltfMaterial& source, const std::string& folder, ID3D11Device* device,
+		SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, TextureManager& textures)
+	{
+		std::shared_ptr<BrdfMaterial> material = std::make_shared<BrdfMaterial>(vertexShader, pixelShader, device);
+		material->parameters.albedo = { source.BaseColor.x, source.BaseColor.y, source.BaseColor.z };
+		material->parameters.roughness = source.Roughness;
+		material->parameters.metalness = source.Metalness;
+		if (!source.BaseColorMap.empty())
+			textures.Request(folder + source.BaseColorMap, TextureColor, &material->diffuseSrvPtr);
+		if (!source.NormalMap.empty())
+			textures.Request(folder + source.NormalMap, TextureNormal, &material->normalSrvPtr);
+		material->InitializeSampler();
+		return material;
+	}
+
+	// Missing normals and tangents are made like MeshCooker::CookObj makes them, in vertices of our own
+	void GenerateMissing(const GltfPrimitive& primitive, std::vector<Vertex>& vertices, std::vector<int>& indices)
+	{
+		MeshData data;
+		data.Vertices = std::move(vertices);
+		data.Indices = std::move(indices);
+		SubmeshRange submesh{};
+		submesh.VertexCount = uint32_t(data.Vertices.size());
+		submesh.IndexCount = uint32_t(data.Indices.size());
+		data.Submeshes.push_back(submesh);
+
+		if (primitive.Normal < 0)
+			MeshCooker::GenerateNormals(data);
+		if (primitive.Tangent < 0)
+			MeshCooker::GenerateTangents(data);
+		vertices = std::move(data.Vertices);
+		indices = std::move(data.Indices);
+	}
+}
+
+bool GltfLoader::Load(const std::string& filename, ID3D11Device* device, ID3D11DeviceContext* context,
+	SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, GltfModel& model,
+	VertexFormat vertexFormat, GeometryArena* arena, TextureManager* textures)
+{
+	model = GltfModel();
+
+	// Stays open until the buffers are created, mapped vertices point into it
+	VirtualFile file;
+	if (!file.Open(filename))
+	{
+		LOG_ERROR << "Failed to open GLB file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+	GltfData gltf;
+	if (!GltfParser::ParseGlb(file.GetData(), file.GetSize(), gltf))
+	{
+		LOG_ERROR << "Failed to parse GLB file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+	LOG_INFO << "GLB file \"" << filename << "\" opened: " << gltf.Meshes.size() << " meshes, " << gltf.Nodes.size() << " nodes." << std::endl;
+
+	// Without a shared manager the textures still decode in parallel, and are ready on return
+	std::unique_ptr<TextureManager> ownTextures;
+	if (!textures)
+	{
+		ownTextures.reset(new TextureManager(device, context));
+		textures = ownTextures.get();
+	}
+	const std::string folder = GetFolder(filename);
+	for (const GltfMaterial& material : gltf.Materials)
+		model.Materials.push_back(CreateMaterial(material, folder, device, vertexShader, pixelShader, *textures));
+	// The glTF default material
+	model.Materials.push_back(CreateMaterial(GltfMaterial(), folder, device, vertexShader, pixelShader, *textures));
+
+	std::vector<Vertex> convertedVertices;
+	std::vector<int> convertedIndices;
+	std::vector<char> packedVertices;
+	std::vector<uint16_t> packedIndices;
+	for (const GltfMesh& gltfMesh : gltf.Meshes)
+	{
+		model.Meshes.emplace_back();
+		for (const GltfPrimitive& primitive : gltfMesh.Primitives)
+		{
+			const size_t vertexCount = GltfParser::GetVertexCount(gltf, primitive);
+			const size_t indexCount = GltfParser::GetIndexCount(gltf, primitive);
+			if (primitive.Mode != 4 || indexCount == 0)
+			{
+				LOG_WARNING << "Skipped a primitive of mesh \"" << gltfMesh.Name << "\" that is not a triangle list." << std::endl;
+				continue;
+			}
+
+			// Straight from the file when it can be, then the indices go where the vertices ended up
+			const Vertex* vertices = GltfParser::MapVertices(gltf, primitive);
+			const void* indexData;
+			DXGI_FORMAT indexFormat;
+			size_t uploadVertexCount = vertexCount;
+			bool indicesValid;
+			if (vertices)
+				++model.MappedPrimitives;
+			else
+			{
+				++model.ConvertedPrimitives;
+				convertedVertices.resize(vertexCount);
+				GltfParser::ReadVertices(gltf, primitive, convertedVertices.data());
+				if (primitive.Normal < 0 || primitive.Tangent < 0)
+				{
+					convertedIndices.resize(indexCount);
+					if (!GltfParser::ReadIndices(gltf, primitive, vertexCount, convertedIndices.data()))
+					{
+						LOG_ERROR << "Mesh \"" << gltfMesh.Name << "\" of \"" << filename << "\" has indices out of range." << std::endl;
+						return false;
+					}
+					GenerateMissing(primitive, convertedVertices, convertedIndices);
+					uploadVertexCount = convertedVertices.size();
+				}
+				vertices = convertedVertices.data();
+			}
+
+			if (VertexPacker::CanUse16BitIndices(uploadVertexCount))
+			{
+				packedIndices.resize(indexCount);
+				if (!convertedIndices.empty())
+				{
+					VertexPacker::PackIndices16(convertedIndices.data(), indexCount, packedIndices.data());
+					indicesValid = true;
+				}
+				else
+					indicesValid = GltfParser::ReadIndices(gltf, primitive, vertexCount, packedIndices.data());
+				indexData = packedIndices.data();
+				indexFormat = DXGI_FORMAT_R16_UINT;
+			}
+			else
+			{
+				if (convertedIndices.empty())
+				{
+					convertedIndices.resize(indexCount);
+					indicesValid = GltfParser::ReadIndices(gltf, primitive, vertexCount, convertedIndices.data());
+				}
+				else
+					indicesValid = true;
+				indexData = convertedIndices.data();
+				indexFormat = DXGI_FORMAT_R32_UINT;
+			}
+			if (!indicesValid)
+			{
+				LOG_ERROR << "Mesh \"" << gltfMesh.Name << "\" of \"" << filename << "\" has indices out of range." << std::endl;
+				return false;
+			}
+
+			// Positions have to have bounds in glTF, so the vertices are only read again when packing them
+			DirectX::XMFLOAT3 center;
+			DirectX::XMFLOAT3 extents;
+			const GltfAccessor& position = gltf.Accessors[primitive.Position];
+			if (position.HasBounds && uploadVertexCount == vertexCount)
+			{
+				center = { (position.Min.x + position.Max.x) * 0.5f, (position.Min.y + position.Max.y) * 0.5f, (position.Min.z + position.Max.z) * 0.5f };
+				extents = { (position.Max.x - position.Min.x) * 0.5f, (position.Max.y - position.Min.y) * 0.5f, (position.Max.z - position.Min.z) * 0.5f };
+			}
+			else
+				MeshCooker::ComputeBoundingBox(vertices, uploadVertexCount, center, extents);
+
+			const VertexDequantization dequantization = VertexPacker::ComputeDequantization(vertices, uploadVertexCount, vertexFormat);
+			const void* vertexData = vertices;
+			if (vertexFormat != VertexFormatFull)
+			{
+				packedVertices.resize(uploadVertexCount * VertexPacker::GetVertexSize(vertexFormat));
+				VertexPacker::Pack(vertices, uploadVertexCount, vertexFormat, dequantization, packedVertices.data());
+				vertexData = packedVertices.data();
+			}
+
+			std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(vertexData, int(uploadVertexCount), vertexFormat, dequantization,
+				indexData, int(indexCount), indexFormat, center, extents, device, arena);
+			mesh->SetUvDensity(indexFormat == DXGI_FORMAT_R16_UINT ? MeshCooker::ComputeUvDensity(vertices, packedIndices.data(), indexCount)
+				: MeshCooker::ComputeUvDensity(vertices, convertedIndices.data(), indexCount));
+			const bool hasMaterial = primitive.Material >= 0 && size_t(primitive.Material) < gltf.Materials.size();
+			mesh->SetMaterial(model.Materials[hasMaterial ? primitive.Material : gltf.Materials.size()]);
+			model.Meshes.back().push_back(mesh);
+			convertedIndices.clear();
+		}
+	}
+	file.Close();
+
+	// Entities get the transforms of their nodes relative to the scene, nodes reached twice are only placed once
+	std::vector<unsigned char> visited(gltf.Nodes.size());
+	std::vector<std::pair<int, DirectX::XMFLOAT4X4>> stack;
+	DirectX::XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+	for (int root : gltf.RootNodes)
+		stack.emplace_back(root, identity);
+	while (!stack.empty())
+	{
+		const int n = stack.back().first;
+		const DirectX::XMMATRIX parent = XMLoadFloat4x4(&stack.back().second);
+		stack.pop_back();
+		if (visited[n]) continue;
+		visited[n] = 1;
+
+		const GltfNode& node = gltf.Nodes[n];
+		const DirectX::XMMATRIX world = XMLoadFloat4x4(&node.Transform) * parent;
+		DirectX::XMFLOAT4X4 worldMatrix;
+		XMStoreFloat4x4(&worldMatrix, world);
+		for (int child : node.Children)
+			stack.emplace_back(child, worldMatrix);
+
+		if (node.Mesh < 0 || model.Meshes[node.Mesh].empty()) continue;
+		DirectX::XMVECTOR scale;
+		DirectX::XMVECTOR rotation;
+		DirectX::XMVECTOR translation;
+		if (!XMMatrixDecompose(&scale, &rotation, &translation, world))
+		{
+			LOG_WARNING << "Node \"" << node.Name << "\" has a transform that is not scale, rotation and translation, it is left out." << std::endl;
+			continue;
+		}
+		DirectX::XMFLOAT3 entityScale;
+		DirectX::XMFLOAT4 entityRotation;
+		DirectX::XMFLOAT3 entityTranslation;
+		XMStoreFloat3(&entityScale, scale);
+		XMStoreFloat4(&entityRotation, rotation);
+		XMStoreFloat3(&entityTranslation, translation);
+
+		std::unique_ptr<GameEntity> entity(new GameEntity(model.Meshes[node.Mesh]));
+		entity->SetScale(entityScale);
+		entity->SetRotation(entityRotation);
+		entity->SetTranslation(entityTranslation);
+		model.Entities.push_back(std::move(entity));
+	}
+
+	LOG_INFO << "Loaded \"" << filename << "\": " << model.MappedPrimitives << " primitives mapped from the file, "
+		<< model.ConvertedPrimitives << " converted, " << model.Entities.size() << " entities." << std::endl;
+
+	if (ownTextures) ownTextures->Flush();
+	return true;
+}
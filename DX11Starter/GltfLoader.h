@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <d3d11.h>
+#include "BrdfMaterial.h"
+#include "GameEntity.h"
+#include "Mesh.h"
+
+struct GltfModel
+{
+	// The Meshes of every glTF mesh, one per triangle list primitive
+	std::vector<std::vector<std::shared_ptr<Mesh>>> Meshes;
+	// One per glTF material, then one for primitives without a material
+	std::vector<std::shared_ptr<BrdfMaterial>> Materials;
+	// An entity for every node with a mesh, placed where the scene puts the node
+	std::vector<std::unique_ptr<GameEntity>> Entities;
+
+	// Primitives uploaded straight from the file, and the ones that were converted first
+	size_t MappedPrimitives = 0;
+	size_t ConvertedPrimitives = 0;
+};
+
+// Loads binary glTF 2.0 models. Vertices already laid out like Vertex go from the file to the vertex buffer without
+// a copy; indices are narrowed to 16 bits where they fit and get the winding of the OBJ loader on the way. Missing
+// normals and tangents are generated like for OBJs. There is no cook step, so meshes have a single level of detail
+// and no clusters.
+class GltfLoader
+{
+public:
+	// Materials are BrdfMaterials with the given shaders, their textures are requested from textures and are set once
+	// it is flushed. Without one they are loaded before returning.
+	static bool Load(const std::string& filename, ID3D11Device* device, ID3D11DeviceContext* context,
+		SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, GltfModel& model,
+		VertexFormat vertexFormat = VertexFormatFull, GeometryArena* arena = nullptr, TextureManager* textures = nullptr);
+};
@@ -0,0 +1,752 @@
+#include "GltfParser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include "SimpleLogger.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GLTF_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t GlbMagic = 0x46546C67;
+	const uint32_t GlbVersion = 2;
+	const uint32_t JsonChunk = 0x4E4F534A;
+	const uint32_t BinaryChunk = 0x004E4942;
+	const int TriangleMode = 4;
+	// Deeper JSON than this is not something an exporter wrote
+	const int MaxJsonDepth = 64;
+
+	enum JsonType { JsonNull, JsonBool, JsonNumber, JsonString, JsonArray, JsonObject };
+
+	struct JsonValue
+	{
+		JsonType Kind = JsonNull;
+		double Number = 0.0;
+		std::string String;
+		std::vector<JsonValue> Elements;
+		std::vector<std::pair<std::string, JsonValue>> Members;
+
+		const JsonValue* Find(const char* name) const
+		{
+			for (const auto& member : Members)
+				if (member.first == name) return &member.second;
+			return nullptr;
+		}
+	};
+
+	// Just enough JSON for glTF: UTF-8 input, numbers as doubles
+	class JsonReader
+	{
+	public:
+		JsonReader(const char* begin, const char* end) : p(begin), end(end) {}
+
+		bool Read(JsonValue& value)
+		{
+			if (!ReadValue(value, 0)) return false;
+			SkipSpace();
+			return p == end;
+		}
+
+	private:
+		const char* p;
+		const char* end;
+
+		void SkipSpace()
+		{
+			while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+		}
+
+		bool Expect(const char* word)
+		{
+			const size_t length = strlen(word);
+			if (size_t(end - p) < length || memcmp(p, word, length) != 0) return false;
+			p += length;
+			return true;
+		}
+
+		bool ReadValue(JsonValue& value, int depth)
+		{
+			SkipSpace();
+			if (p == end || depth > MaxJsonDepth) return false;
+			switch (*p)
+			{
+			case '{':
+				value.Kind = JsonObject;
+				++p;
+				SkipSpace();
+				if (p != end && *p == '}') return ++p, true;
+				for (;;)
+				{
+					SkipSpace();
+					value.Members.emplace_back();
+					if (!ReadString(value.Members.back().first)) return false;
+					SkipSpace();
+					if (p == end || *p++ != ':') return false;
+					if (!ReadValue(value.Members.back().second, depth + 1)) return false;
+					SkipSpace();
+					if (p == end) return false;
+					if (*p == '}') return ++p, true;
+					if (*p++ != ',') return false;
+				}
+			case '[':
+				value.Kind = JsonArray;
+				++p;
+				SkipSpace();
+				if (p != end && *p == ']') return ++p, true;
+				for (;;)
+				{
+					value.Elements.emplace_back();
+					if (!ReadValue(value.Elements.back(), depth + 1)) return false;
+					SkipSpace();
+					if (p == end) return false;
+					if (*p == ']') return ++p, true;
+					if (*p++ != ',') return false;
+				}
+			case '"':
+				value.Kind = JsonString;
+				return ReadString(value.String);
+			case 't':
+				value.Kind = JsonBool;
+				value.Number = 1.0;
+				return Expect("true");
+			case 'f':
+				value.Kind = JsonBool;
+				return Expect("false");
+			case 'n':
+				return Expect("null");
+			default:
+				value.Kind = JsonNumber;
+				return ReadNumber(value.Number);
+			}
+		}
+
+		bool ReadNumber(double& number)
+		{
+			// strtod needs a terminated string, and no number an exporter writes is longer than this
+			char text[64];
+			size_t length = 0;
+			while (p != end && length + 1 < sizeof(text) && (isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' ||
+				*p == '.' || *p == 'e' || *p == 'E'))
+				text[length++] = *p++;
+			text[length] = '\0';
+			char* parsed;
+			number = strtod(text, &parsed);
+			return length != 0 && parsed == text + length;
+		}
+
+		static void AppendUtf8(uint32_t code, std::string& text)
+		{
+			if (code < 0x80)
+				text += char(code);
+			else if (code < 0x800)
+			{
+				text += char(0xC0 | code >> 6);
+				text += char(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				text += char(0xE0 | code >> 12);
+				text += char(0x80 | (code >> 6 & 0x3F));
+				text += char(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				text += char(0xF0 | code >> 18);
+				text += char(0x80 | (code >> 12 & 0x3F));
+				text += char(0x80 | (code >> 6 & 0x3F));
+				text += char(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool ReadHex(uint32_t& code)
+		{
+			if (end - p < 4) return false;
+			code = 0;
+			for (int i = 0; i != 4; ++i)
+			{
+				const char c = *p++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= uint32_t(c - '0');
+				else if (c >= 'a' && c <= 'f') code |= uint32_t(c - 'a' + 10);
+				else if (c >= 'A' && c <= 'F') code |= uint32_t(c - 'A' + 10);
+				else return false;
+			}
+			return true;
+		}
+
+		bool ReadString(std::string& text)
+		{
+			if (p == end || *p++ != '"') return false;
+			while (p != end && *p != '"')
+			{
+				if (*p != '\\')
+				{
+					text += *p++;
+					continue;
+				}
+				if (++p == end) return false;
+				switch (*p++)
+				{
+				case '"': text += '"'; break;
+				case '\\': text += '\\'; break;
+				case '/': text += '/'; break;
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u':
+				{
+					uint32_t code;
+					if (!ReadHex(code)) return false;
+					// A surrogate pair is one code point
+					uint32_t low;
+					if (code >= 0xD800 && code < 0xDC00 && Expect("\\u") && ReadHex(low) && low >= 0xDC00 && low < 0xE000)
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					AppendUtf8(code, text);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return p != end && *p++ == '"';
+		}
+	};
+
+	const std::vector<JsonValue>& GetArray(const JsonValue& object, const char* name)
+	{
+		static const std::vector<JsonValue> empty;
+		const JsonValue* value = object.Find(name);
+		return value && value->Kind == JsonArray ? value->Elements : empty;
+	}
+
+	double GetNumber(const JsonValue& object, const char* name, double fallback)
+	{
+		const JsonValue* value = object.Find(name);
+		return value && (value->Kind == JsonNumber || value->Kind == JsonBool) ? value->Number : fallback;
+	}
+
+	int GetIndex(const JsonValue& object, const char* name)
+	{
+		return int(GetNumber(object, name, -1.0));
+	}
+
+	std::string GetString(const JsonValue& object, const char* name)
+	{
+		const JsonValue* value = object.Find(name);
+		return value && value->Kind == JsonString ? value->String : std::string();
+	}
+
+	const JsonValue& GetMember(const JsonValue& object, const char* name)
+	{
+		static const JsonValue empty;
+		const JsonValue* value = object.Find(name);
+		return value && value->Kind == JsonObject ? *value : empty;
+	}
+
+	size_t GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case GltfByte:
+		case GltfUnsignedByte: return 1;
+		case GltfShort:
+		case GltfUnsignedShort: return 2;
+		case GltfUnsignedInt:
+		case GltfFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	int GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	size_t GetStride(const GltfData& gltf, const GltfAccessor& accessor)
+	{
+		const GltfBufferView& view = gltf.BufferViews[accessor.BufferView];
+		return view.ByteStride ? view.ByteStride : GetComponentSize(accessor.ComponentType) * accessor.ComponentCount;
+	}
+
+	const char* GetElements(const GltfData& gltf, const GltfAccessor& accessor)
+	{
+		return gltf.Binary + gltf.BufferViews[accessor.BufferView].ByteOffset + accessor.ByteOffset;
+	}
+
+	// Images are only supported as files next to the GLB
+	std::string GetImage(const JsonValue& root, const JsonValue& textureInfo)
+	{
+		const int texture = GetIndex(textureInfo, "index");
+		const std::vector<JsonValue>& textures = GetArray(root, "textures");
+		if (texture < 0 || size_t(texture) >= textures.size()) return std::string();
+		const int image = GetIndex(textures[texture], "source");
+		const std::vector<JsonValue>& images = GetArray(root, "images");
+		if (image < 0 || size_t(image) >= images.size()) return std::string();
+		const std::string uri = GetString(images[image], "uri");
+		if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+		{
+			LOG_WARNING << "Embedded glTF image " << image << " is not supported." << std::endl;
+			return std::string();
+		}
+		return uri;
+	}
+
+	bool ParseAccessors(const JsonValue& root, GltfData& gltf)
+	{
+		for (const JsonValue& json : GetArray(root, "bufferViews"))
+		{
+			if (GetIndex(json, "buffer") != 0) return false;
+			gltf.BufferViews.push_back({ size_t(GetNumber(json, "byteOffset", 0.0)), size_t(GetNumber(json, "byteLength", 0.0)),
+				size_t(GetNumber(json, "byteStride", 0.0)) });
+			const GltfBufferView& view = gltf.BufferViews.back();
+			if (view.ByteOffset > gltf.BinarySize || view.ByteLength > gltf.BinarySize - view.ByteOffset) return false;
+		}
+
+		for (const JsonValue& json : GetArray(root, "accessors"))
+		{
+			GltfAccessor accessor{};
+			accessor.BufferView = GetIndex(json, "bufferView");
+			accessor.ByteOffset = size_t(GetNumber(json, "byteOffset", 0.0));
+			accessor.Count = size_t(GetNumber(json, "count", 0.0));
+			accessor.ComponentType = int(GetNumber(json, "componentType", 0.0));
+			accessor.ComponentCount = GetComponentCount(GetString(json, "type"));
+			accessor.Normalized = GetNumber(json, "normalized", 0.0) != 0.0;
+			const std::vector<JsonValue>& min = GetArray(json, "min");
+			const std::vector<JsonValue>& max = GetArray(json, "max");
+			if (min.size() >= 3 && max.size() >= 3)
+			{
+				accessor.HasBounds = true;
+				accessor.Min = { float(min[0].Number), float(min[1].Number), float(min[2].Number) };
+				accessor.Max = { float(max[0].Number), float(max[1].Number), float(max[2].Number) };
+			}
+			gltf.Accessors.push_back(accessor);
+
+			// Every element has to be inside its buffer view, so reading them never checks again
+			const size_t elementSize = GetComponentSize(accessor.ComponentType) * accessor.ComponentCount;
+			if (accessor.BufferView < 0 || size_t(accessor.BufferView) >= gltf.BufferViews.size() || elementSize == 0 ||
+				json.Find("sparse") || accessor.ByteOffset % GetComponentSize(accessor.ComponentType) != 0)
+				return false;
+			const GltfBufferView& view = gltf.BufferViews[accessor.BufferView];
+			const size_t stride = GetStride(gltf, accessor);
+			if (accessor.Count != 0 && (accessor.ByteOffset > view.ByteLength || elementSize > view.ByteLength - accessor.ByteOffset ||
+				(view.ByteLength - accessor.ByteOffset - elementSize) / stride < accessor.Count - 1))
+				return false;
+		}
+		return true;
+	}
+
+	bool ParseMeshes(const JsonValue& root, GltfData& gltf)
+	{
+		const auto isAccessor = [&](int accessor, int componentCount)
+		{
+			return accessor < 0 || (size_t(accessor) < gltf.Accessors.size() && gltf.Accessors[accessor].ComponentCount == componentCount);
+		};
+
+		for (const JsonValue& json : GetArray(root, "meshes"))
+		{
+			gltf.Meshes.emplace_back();
+			GltfMesh& mesh = gltf.Meshes.back();
+			mesh.Name = GetString(json, "name");
+			for (const JsonValue& primitiveJson : GetArray(json, "primitives"))
+			{
+				const JsonValue& attributes = GetMember(primitiveJson, "attributes");
+				GltfPrimitive primitive;
+				primitive.Position = GetIndex(attributes, "POSITION");
+				primitive.Normal = GetIndex(attributes, "NORMAL");
+				primitive.TexCoord = GetIndex(attributes, "TEXCOORD_0");
+				primitive.Tangent = GetIndex(attributes, "TANGENT");
+				primitive.Indices = GetIndex(primitiveJson, "indices");
+				primitive.Material = GetIndex(primitiveJson, "material");
+				primitive.Mode = int(GetNumber(primitiveJson, "mode", double(TriangleMode)));
+
+				if (primitive.Position < 0 || !isAccessor(primitive.Position, 3) || !isAccessor(primitive.Normal, 3) ||
+					!isAccessor(primitive.TexCoord, 2) || !isAccessor(primitive.Tangent, 4) || !isAccessor(primitive.Indices, 1))
+					return false;
+				const size_t vertexCount = gltf.Accessors[primitive.Position].Count;
+				for (int attribute : { primitive.Normal, primitive.TexCoord, primitive.Tangent })
+					if (attribute >= 0 && gltf.Accessors[attribute].Count != vertexCount) return false;
+				if (primitive.Indices >= 0 && gltf.Accessors[primitive.Indices].ComponentType != GltfUnsignedByte &&
+					gltf.Accessors[primitive.Indices].ComponentType != GltfUnsignedShort &&
+					gltf.Accessors[primitive.Indices].ComponentType != GltfUnsignedInt)
+					return false;
+				mesh.Primitives.push_back(primitive);
+			}
+		}
+		return true;
+	}
+
+	void ParseMaterials(const JsonValue& root, GltfData& gltf)
+	{
+		for (const JsonValue& json : GetArray(root, "materials"))
+		{
+			GltfMaterial material;
+			material.Name = GetString(json, "name");
+			const JsonValue& pbr = GetMember(json, "pbrMetallicRoughness");
+			const std::vector<JsonValue>& baseColor = GetArray(pbr, "baseColorFactor");
+			if (baseColor.size() == 4)
+				material.BaseColor = { float(baseColor[0].Number), float(baseColor[1].Number), float(baseColor[2].Number), float(baseColor[3].Number) };
+			material.Roughness = float(GetNumber(pbr, "roughnessFactor", 1.0));
+			material.Metalness = float(GetNumber(pbr, "metallicFactor", 1.0));
+			if (pbr.Find("baseColorTexture"))
+				material.BaseColorMap = GetImage(root, GetMember(pbr, "baseColorTexture"));
+			if (json.Find("normalTexture"))
+				material.NormalMap = GetImage(root, GetMember(json, "normalTexture"));
+			gltf.Materials.push_back(material);
+		}
+	}
+
+	bool ParseNodes(const JsonValue& root, GltfData& gltf)
+	{
+		const std::vector<JsonValue>& nodes = GetArray(root, "nodes");
+		std::vector<unsigned char> isChild(nodes.size());
+		for (const JsonValue& json : nodes)
+		{
+			GltfNode node;
+			node.Name = GetString(json, "name");
+			node.Mesh = GetIndex(json, "mesh");
+			if (node.Mesh >= int(gltf.Meshes.size())) return false;
+			for (const JsonValue& child : GetArray(json, "children"))
+			{
+				const int c = int(child.Number);
+				if (c < 0 || size_t(c) >= nodes.size()) return false;
+				node.Children.push_back(c);
+				isChild[c] = 1;
+			}
+
+			// glTF matrices are column major for column vectors, read in order they are row major for row vectors
+			const std::vector<JsonValue>& matrix = GetArray(json, "matrix");
+			if (matrix.size() == 16)
+			{
+				for (int i = 0; i != 16; ++i)
+					node.Transform.m[i / 4][i % 4] = float(matrix[i].Number);
+			}
+			else
+			{
+				const std::vector<JsonValue>& t = GetArray(json, "translation");
+				const std::vector<JsonValue>& r = GetArray(json, "rotation");
+				const std::vector<JsonValue>& s = GetArray(json, "scale");
+				const DirectX::XMMATRIX scale = s.size() == 3 ? DirectX::XMMatrixScaling(float(s[0].Number), float(s[1].Number), float(s[2].Number)) : DirectX::XMMatrixIdentity();
+				const DirectX::XMMATRIX rotation = r.size() == 4 ? DirectX::XMMatrixRotationQuaternion(
+					DirectX::XMVectorSet(float(r[0].Number), float(r[1].Number), float(r[2].Number), float(r[3].Number))) : DirectX::XMMatrixIdentity();
+				const DirectX::XMMATRIX translation = t.size() == 3 ? DirectX::XMMatrixTranslation(float(t[0].Number), float(t[1].Number), float(t[2].Number)) : DirectX::XMMatrixIdentity();
+				XMStoreFloat4x4(&node.Transform, scale * rotation * translation);
+			}
+			gltf.Nodes.push_back(node);
+		}
+
+		const std::vector<JsonValue>& scenes = GetArray(root, "scenes");
+		const int scene = int(GetNumber(root, "scene", 0.0));
+		if (scene >= 0 && size_t(scene) < scenes.size())
+		{
+			for (const JsonValue& node : GetArray(scenes[scene], "nodes"))
+			{
+				if (node.Number < 0.0 || size_t(node.Number) >= nodes.size()) return false;
+				gltf.RootNodes.push_back(int(node.Number));
+			}
+		}
+		else
+		{
+			for (size_t n = 0; n != nodes.size(); ++n)
+				if (!isChild[n]) gltf.RootNodes.push_back(int(n));
+		}
+		return true;
+	}
+
+	float ReadComponent(const char* p, int componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case GltfByte:
+		{
+			const int8_t value = int8_t(*p);
+			return normalized ? std::max(value / 127.0f, -1.0f) : float(value);
+		}
+		case GltfUnsignedByte:
+		{
+			const uint8_t value = uint8_t(*p);
+			return normalized ? value / 255.0f : float(value);
+		}
+		case GltfShort:
+		{
+			int16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : float(value);
+		}
+		case GltfUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? value / 65535.0f : float(value);
+		}
+		case GltfUnsignedInt:
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return float(value);
+		}
+		default:
+		{
+			float value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		}
+	}
+
+#ifdef GLTF_SSE2
+	// Four components of any type to floats in one register
+	__m128 LoadComponents(const char* p, int componentType, bool normalized)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		int32_t bytes;
+		switch (componentType)
+		{
+		case GltfByte:
+		{
+			memcpy(&bytes, p, sizeof(bytes));
+			__m128i value = _mm_cvtsi32_si128(bytes);
+			value = _mm_unpacklo_epi8(value, value);
+			value = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 24);
+			const __m128 result = _mm_cvtepi32_ps(value);
+			return normalized ? _mm_max_ps(_mm_mul_ps(result, _mm_set1_ps(1.0f / 127.0f)), _mm_set1_ps(-1.0f)) : result;
+		}
+		case GltfUnsignedByte:
+		{
+			memcpy(&bytes, p, sizeof(bytes));
+			const __m128i value = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+			const __m128 result = _mm_cvtepi32_ps(value);
+			return normalized ? _mm_mul_ps(result, _mm_set1_ps(1.0f / 255.0f)) : result;
+		}
+		case GltfShort:
+		{
+			__m128i value = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+			value = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+			const __m128 result = _mm_cvtepi32_ps(value);
+			return normalized ? _mm_max_ps(_mm_mul_ps(result, _mm_set1_ps(1.0f / 32767.0f)), _mm_set1_ps(-1.0f)) : result;
+		}
+		case GltfUnsignedShort:
+		{
+			const __m128i value = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+			const __m128 result = _mm_cvtepi32_ps(value);
+			return normalized ? _mm_mul_ps(result, _mm_set1_ps(1.0f / 65535.0f)) : result;
+		}
+		default:
+			return _mm_loadu_ps(reinterpret_cast<const float*>(p));
+		}
+	}
+#endif
+
+	// The components of every element as floats, outputStride bytes apart. Vectorized elements store four floats,
+	// overwriting the start of whatever follows the attribute in the vertex, so attributes go in the order of Vertex.
+	void ReadAttribute(const GltfData& gltf, const GltfAccessor& accessor, char* output, size_t outputStride)
+	{
+		const char* elements = GetElements(gltf, accessor);
+		const size_t stride = GetStride(gltf, accessor);
+		const size_t componentSize = GetComponentSize(accessor.ComponentType);
+		size_t i = 0;
+#ifdef GLTF_SSE2
+		// Unsigned ints above 2^31 would come out negative
+		if (accessor.ComponentType != GltfUnsignedInt)
+		{
+			// Elements whose four components can be read without going past the binary chunk
+			const size_t readSize = 4 * componentSize;
+			const size_t available = size_t(gltf.Binary + gltf.BinarySize - elements);
+			const size_t vectorCount = available < readSize ? 0 : std::min(accessor.Count, (available - readSize) / stride + 1);
+			for (; i != vectorCount; ++i)
+				_mm_storeu_ps(reinterpret_cast<float*>(output + i * outputStride),
+					LoadComponents(elements + i * stride, accessor.ComponentType, accessor.Normalized));
+		}
+#endif
+		for (; i != accessor.Count; ++i)
+		{
+			float* destination = reinterpret_cast<float*>(output + i * outputStride);
+			for (int c = 0; c != accessor.ComponentCount; ++c)
+				destination[c] = ReadComponent(elements + i * stride + c * componentSize, accessor.ComponentType, accessor.Normalized);
+		}
+	}
+
+	void FillAttribute(size_t count, const float* value, int componentCount, char* output, size_t outputStride)
+	{
+		for (size_t i = 0; i != count; ++i)
+			memcpy(output + i * outputStride, value, componentCount * sizeof(float));
+	}
+
+	// Swaps the last two corners of every triangle and tracks the largest index
+	template <typename Source, typename Index>
+	uint32_t ReadTriangles(const char* elements, size_t stride, size_t count, Index* indices)
+	{
+		uint32_t largest = 0;
+		for (size_t i = 0; i != count; i += 3)
+		{
+			Source corners[3];
+			for (int c = 0; c != 3; ++c)
+				memcpy(&corners[c], elements + (i + c) * stride, sizeof(Source));
+			largest = std::max(largest, uint32_t(std::max(corners[0], std::max(corners[1], corners[2]))));
+			indices[i] = Index(corners[0]);
+			indices[i + 1] = Index(corners[2]);
+			indices[i + 2] = Index(corners[1]);
+		}
+		return largest;
+	}
+
+	template <typename Index>
+	bool ReadIndicesAs(const GltfData& gltf, const GltfPrimitive& primitive, size_t vertexCount, Index* indices)
+	{
+		const size_t count = GltfParser::GetIndexCount(gltf, primitive);
+		if (count == 0) return true;
+		if (primitive.Indices < 0)
+		{
+			if (vertexCount - 1 > size_t(Index(~Index(0)))) return false;
+			for (size_t i = 0; i != count; i += 3)
+			{
+				indices[i] = Index(i);
+				indices[i + 1] = Index(i + 2);
+				indices[i + 2] = Index(i + 1);
+			}
+			return true;
+		}
+
+		const GltfAccessor& accessor = gltf.Accessors[primitive.Indices];
+		const char* elements = GetElements(gltf, accessor);
+		const size_t stride = GetStride(gltf, accessor);
+		uint32_t largest;
+		if (accessor.ComponentType == GltfUnsignedByte)
+			largest = ReadTriangles<uint8_t>(elements, stride, count, indices);
+		else if (accessor.ComponentType == GltfUnsignedShort)
+			largest = ReadTriangles<uint16_t>(elements, stride, count, indices);
+		else
+			largest = ReadTriangles<uint32_t>(elements, stride, count, indices);
+		return largest < vertexCount;
+	}
+}
+
+bool GltfParser::ParseGlb(const char* data, size_t size, GltfData& gltf)
+{
+	gltf = GltfData();
+
+	// Header, then the JSON chunk and the binary chunk
+	uint32_t header[5];
+	if (size < sizeof(header))
+	{
+		LOG_ERROR << "GLB is too short for a header." << std::endl;
+		return false;
+	}
+	memcpy(header, data, sizeof(header));
+	if (header[0] != GlbMagic || header[1] != GlbVersion || header[2] > size || header[2] < sizeof(header) || header[4] != JsonChunk ||
+		header[3] > header[2] - sizeof(header))
+	{
+		LOG_ERROR << "Not a glTF 2.0 binary file." << std::endl;
+		return false;
+	}
+	const char* json = data + sizeof(header);
+	const size_t jsonSize = header[3];
+	const size_t binaryHeader = sizeof(header) + (jsonSize + 3) / 4 * 4;
+	uint32_t chunk[2];
+	if (binaryHeader + sizeof(chunk) <= header[2])
+	{
+		memcpy(chunk, data + binaryHeader, sizeof(chunk));
+		if (chunk[1] == BinaryChunk && chunk[0] <= header[2] - binaryHeader - sizeof(chunk))
+		{
+			gltf.Binary = data + binaryHeader + sizeof(chunk);
+			gltf.BinarySize = chunk[0];
+		}
+	}
+
+	JsonValue root;
+	if (!JsonReader(json, json + jsonSize).Read(root) || root.Kind != JsonObject)
+	{
+		LOG_ERROR << "Failed to parse the JSON of a GLB." << std::endl;
+		return false;
+	}
+	for (const JsonValue& buffer : GetArray(root, "buffers"))
+		if (buffer.Find("uri"))
+		{
+			LOG_ERROR << "GLB buffers in other files are not supported." << std::endl;
+			return false;
+		}
+	for (const JsonValue& extension : GetArray(root, "extensionsRequired"))
+		LOG_WARNING << "glTF extension \"" << extension.String << "\" is required but not supported." << std::endl;
+
+	if (!ParseAccessors(root, gltf) || !ParseMeshes(root, gltf) || !ParseNodes(root, gltf))
+	{
+		LOG_ERROR << "GLB has buffer views, accessors, meshes or nodes out of range or of unsupported types." << std::endl;
+		return false;
+	}
+	ParseMaterials(root, gltf);
+	return true;
+}
+
+const Vertex* GltfParser::MapVertices(const GltfData& gltf, const GltfPrimitive& primitive)
+{
+	if (primitive.Normal < 0 || primitive.TexCoord < 0 || primitive.Tangent < 0) return nullptr;
+
+	const GltfAccessor& position = gltf.Accessors[primitive.Position];
+	const size_t offsets[4] = { offsetof(Vertex, Position), offsetof(Vertex, Normal), offsetof(Vertex, UV), offsetof(Vertex, Tangent) };
+	const int attributes[4] = { primitive.Position, primitive.Normal, primitive.TexCoord, primitive.Tangent };
+	for (int a = 0; a != 4; ++a)
+	{
+		const GltfAccessor& accessor = gltf.Accessors[attributes[a]];
+		if (accessor.ComponentType != GltfFloat || accessor.Normalized || accessor.BufferView != position.BufferView ||
+			accessor.ByteOffset != position.ByteOffset + offsets[a] - offsets[0])
+			return nullptr;
+	}
+	if (gltf.BufferViews[position.BufferView].ByteStride != sizeof(Vertex)) return nullptr;
+
+	const char* vertices = GetElements(gltf, position);
+	if (reinterpret_cast<uintptr_t>(vertices) % alignof(Vertex) != 0) return nullptr;
+	return reinterpret_cast<const Vertex*>(vertices);
+}
+
+void GltfParser::ReadVertices(const GltfData& gltf, const GltfPrimitive& primitive, Vertex* vertices)
+{
+	const size_t count = GetVertexCount(gltf, primitive);
+	char* output = reinterpret_cast<char*>(vertices);
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float noTangent[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	ReadAttribute(gltf, gltf.Accessors[primitive.Position], output + offsetof(Vertex, Position), sizeof(Vertex));
+	if (primitive.Normal >= 0)
+		ReadAttribute(gltf, gltf.Accessors[primitive.Normal], output + offsetof(Vertex, Normal), sizeof(Vertex));
+	else
+		FillAttribute(count, zero, 3, output + offsetof(Vertex, Normal), sizeof(Vertex));
+	if (primitive.TexCoord >= 0)
+		ReadAttribute(gltf, gltf.Accessors[primitive.TexCoord], output + offsetof(Vertex, UV), sizeof(Vertex));
+	else
+		FillAttribute(count, zero, 2, output + offsetof(Vertex, UV), sizeof(Vertex));
+	if (primitive.Tangent >= 0)
+		ReadAttribute(gltf, gltf.Accessors[primitive.Tangent], output + offsetof(Vertex, Tangent), sizeof(Vertex));
+	else
+		FillAttribute(count, noTangent, 4, output + offsetof(Vertex, Tangent), sizeof(Vertex));
+}
+
+size_t GltfParser::GetVertexCount(const GltfData& gltf, const GltfPrimitive& primitive)
+{
+	return gltf.Accessors[primitive.Position].Count;
+}
+
+size_t GltfParser::GetIndexCount(const GltfData& gltf, const GltfPrimitive& primitive)
+{
+	const size_t count = primitive.Indices >= 0 ? gltf.Accessors[primitive.Indices].Count : GetVertexCount(gltf, primitive);
+	return count / 3 * 3;
+}
+
+bool GltfParser::ReadIndices(const GltfData& gltf, const GltfPrimitive& primitive, size_t vertexCount, uint16_t* indices)
+{
+	return ReadIndicesAs(gltf, primitive, vertexCount, indices);
+}
+
+bool GltfParser::ReadIndices(const GltfData& gltf, const GltfPrimitive& primitive, size_t vertexCount, int* indices)
+{
+	return ReadIndicesAs(gltf, primitive, vertexCount, indices);
+}
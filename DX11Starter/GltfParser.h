@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// Component types as the glTF JSON numbers them
+enum GltfComponentType
+{
+	GltfByte = 5120,
+	GltfUnsignedByte = 5121,
+	GltfShort = 5122,
+	GltfUnsignedShort = 5123,
+	GltfUnsignedInt = 5125,
+	GltfFloat = 5126
+};
+
+struct GltfBufferView
+{
+	// Offset into the binary chunk
+	size_t ByteOffset;
+	size_t ByteLength;
+	// 0 when the elements are tightly packed
+	size_t ByteStride;
+};
+
+struct GltfAccessor
+{
+	int BufferView;
+	size_t ByteOffset;
+	size_t Count;
+	int ComponentType;
+	// 1 for SCALAR up to 4 for VEC4
+	int ComponentCount;
+	bool Normalized;
+	// Only set for accessors that have min and max, which positions must
+	bool HasBounds;
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+// Accessor indices of one draw, -1 for attributes it does not have
+struct GltfPrimitive
+{
+	int Position;
+	int Normal;
+	int TexCoord;
+	int Tangent;
+	int Indices;
+	int Material;
+	// 4 for triangle lists, the only mode loaded
+	int Mode;
+};
+
+struct GltfMesh
+{
+	std::string Name;
+	std::vector<GltfPrimitive> Primitives;
+};
+
+struct GltfMaterial
+{
+	std::string Name;
+	DirectX::XMFLOAT4 BaseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float Roughness = 1.0f;
+	float Metalness = 1.0f;
+	// Image file names relative to the GLB, empty if the material has none or they are embedded
+	std::string BaseColorMap;
+	std::string NormalMap;
+};
+
+struct GltfNode
+{
+	std::string Name;
+	int Mesh;
+	std::vector<int> Children;
+	// Relative to the parent, row vector convention like DirectXMath
+	DirectX::XMFLOAT4X4 Transform;
+};
+
+// The parts of a GLB the engine uses. Accessors point into Binary, which belongs to whoever holds the file.
+struct GltfData
+{
+	std::vector<GltfBufferView> BufferViews;
+	std::vector<GltfAccessor> Accessors;
+	std::vector<GltfMesh> Meshes;
+	std::vector<GltfMaterial> Materials;
+	std::vector<GltfNode> Nodes;
+	// Nodes of the default scene, or every node without a parent if the file has no scenes
+	std::vector<int> RootNodes;
+
+	const char* Binary = nullptr;
+	size_t BinarySize = 0;
+};
+
+// Reads binary glTF 2.0 files. Nothing is copied out of the binary chunk: a primitive whose attributes are already
+// interleaved like Vertex is used right where it is in the file, others are converted to Vertex with SSE2.
+class GltfParser
+{
+public:
+	// Parse the JSON chunk of a GLB in memory and check every accessor lies inside the binary chunk.
+	// Buffers in other files, sparse accessors and embedded images are not supported.
+	static bool ParseGlb(const char* data, size_t size, GltfData& gltf);
+
+	// The vertices of a primitive inside the binary chunk if position, normal, texcoord and tangent are floats
+	// interleaved in one buffer view exactly like Vertex, otherwise nullptr.
+	static const Vertex* MapVertices(const GltfData& gltf, const GltfPrimitive& primitive);
+	// Convert the attributes of a primitive to count vertices. Missing normals are left zero and missing tangents
+	// (0, 0, 0, 1) for MeshCooker to generate.
+	static void ReadVertices(const GltfData& gltf, const GltfPrimitive& primitive, Vertex* vertices);
+	static size_t GetVertexCount(const GltfData& gltf, const GltfPrimitive& primitive);
+
+	static size_t GetIndexCount(const GltfData& gltf, const GltfPrimitive& primitive);
+	// Triangles get the clockwise winding of the OBJ loader. Non-indexed primitives get 0, 2, 1, 3, 5, 4...
+	// Returns false if an index is not below vertexCount.
+	static bool ReadIndices(const GltfData& gltf, const GltfPrimitive& primitive, size_t vertexCount, uint16_t* indices);
+	static bool ReadIndices(const GltfData& gltf, const GltfPrimitive& primitive, size_t vertexCount, int* indices);
+};
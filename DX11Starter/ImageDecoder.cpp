@@ -0,0 +1,77 @@
+#include "ImageDecoder.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <wincodec.h>
+#pragma comment(lib, "windowscodecs.lib")
+
+ImageDecoder::ImageDecoder()
+{
+	comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+	factory = nullptr;
+	CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, __uuidof(IWICImagingFactory), reinterpret_cast<void**>(&factory));
+}
+
+ImageDecoder::~ImageDecoder()
+{
+	if (factory) { factory->Release(); }
+	if (comInitialized) { CoUninitialize(); }
+}
+
+bool ImageDecoder::Decode(const char* data, size_t size, std::vector<uint8_t>& pixels, UINT& width, UINT& height)
+{
+	if (!factory) return false;
+
+	IWICStream* stream = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICBitmapScaler* scaler = nullptr;
+	IWICFormatConverter* converter = nullptr;
+
+	HRESULT hr = factory->CreateStream(&stream);
+	if (SUCCEEDED(hr)) hr = stream->InitializeFromMemory(reinterpret_cast<BYTE*>(const_cast<char*>(data)), DWORD(size));
+	if (SUCCEEDED(hr)) hr = factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr)) hr = frame->GetSize(&width, &height);
+
+	IWICBitmapSource* source = frame;
+	const UINT maxSize = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+	if (SUCCEEDED(hr) && (width > maxSize || height > maxSize))
+	{
+		const double scale = double(maxSize) / std::max(width, height);
+		width = std::max(1u, UINT(width * scale));
+		height = std::max(1u, UINT(height * scale));
+		hr = factory->CreateBitmapScaler(&scaler);
+		if (SUCCEEDED(hr)) hr = scaler->Initialize(frame, width, height, WICBitmapInterpolationModeFant);
+		source = scaler;
+	}
+
+	if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr)) hr = converter->Initialize(source, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))
+	{
+		pixels.resize(size_t(width) * height * 4);
+		hr = converter->CopyPixels(nullptr, width * 4, UINT(pixels.size()), pixels.data());
+	}
+
+	if (converter) { converter->Release(); }
+	if (scaler) { scaler->Release(); }
+	if (frame) { frame->Release(); }
+	if (decoder) { decoder->Release(); }
+	if (stream) { stream->Release(); }
+	return SUCCEEDED(hr);
+}
+#else
+ImageDecoder::ImageDecoder()
+{
+}
+
+ImageDecoder::~ImageDecoder()
+{
+}
+
+bool ImageDecoder::Decode(const char*, size_t, std::vector<uint8_t>&, UINT&, UINT&)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <d3d11.h>
+
+#ifdef _WIN32
+struct IWICImagingFactory;
+#endif
+
+// Image file decoding for one thread. WIC needs COM on every thread that uses it, so every worker that decodes
+// makes its own decoder.
+class ImageDecoder
+{
+public:
+	ImageDecoder();
+	~ImageDecoder();
+
+	ImageDecoder(const ImageDecoder&) = delete;
+	ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+	// RGBA pixels of the first frame, scaled down if larger than a texture can be.
+	// There are no image codecs outside Windows, it always fails there.
+	bool Decode(const char* data, size_t size, std::vector<uint8_t>& pixels, UINT& width, UINT& height);
+
+private:
+#ifdef _WIN32
+	bool comInitialized;
+	IWICImagingFactory* factory;
+#endif
+};
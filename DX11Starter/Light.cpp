@@ -143,6 +143,12 @@ void Light::SetPosition(DirectX::XMFLOAT3 p) const
 	Data->Position = p;
 }
 
+void Light::SetSceneBounds(DirectX::XMVECTOR aabbMin, DirectX::XMVECTOR aabbMax)
+{
+	sceneAABBMin = aabbMin;
+	sceneAABBMax = aabbMax;
+}
+
 void Light::SetColor(DirectX::XMFLOAT3 c) const
 {
 	Data->Color = c;
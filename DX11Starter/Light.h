@@ -45,6 +45,8 @@ public:
 	void SetRange(float r) const;
 	void SetIntensity(float i) const;
 	void SetSpotFallOff(float s) const;
+	// Bounds of everything that casts shadows, when models arrive after the light is made
+	void SetSceneBounds(DirectX::XMVECTOR aabbMin, DirectX::XMVECTOR aabbMax);
 
 	void UpdateMatrices();
 private:
@@ -0,0 +1,46 @@
+#include "LodSelector.h"
+#include <algorithm>
+#include <cfloat>
+
+float LodSelector::ProjectedRadius(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection, float viewportHeight)
+{
+	const DirectX::XMMATRIX w = XMMatrixTranspose(XMLoadFloat4x4(&world));
+	const DirectX::XMMATRIX v = XMMatrixTranspose(view);
+	DirectX::XMFLOAT4X4 p{};
+	XMStoreFloat4x4(&p, XMMatrixTranspose(projection));
+
+	// The largest axis scale of the world matrix bounds the sphere after non-uniform scaling
+	const float scale = std::max(std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(w.r[0])),
+		DirectX::XMVectorGetX(DirectX::XMVector3Length(w.r[1]))), DirectX::XMVectorGetX(DirectX::XMVector3Length(w.r[2])));
+	const float worldRadius = radius * scale;
+
+	const DirectX::XMVECTOR viewCenter = XMVector3TransformCoord(XMVector3TransformCoord(XMLoadFloat3(&center), w), v);
+	const float depth = DirectX::XMVectorGetZ(viewCenter);
+
+	// Clip space w is the view depth for perspective projections and 1 for orthographic ones
+	const float clipW = p._34 * depth + p._44;
+	if (p._34 != 0.0f && depth <= worldRadius) return FLT_MAX;
+
+	return worldRadius * p._22 * 0.5f * viewportHeight / clipW;
+}
+
+int LodSelector::Select(const MeshLod* lods, int lodCount, float radius, float projectedRadius, const LodSelection& selection, int previousLevel)
+{
+	if (lodCount <= 1 || radius <= 0.0f) return 0;
+
+	// Object space errors scale with the radius on screen
+	const float pixelsPerUnit = projectedRadius / radius;
+	const int previous = previousLevel < 0 ? -1 : previousLevel - selection.Bias;
+
+	int level = 0;
+	for (int l = 1; l < lodCount; ++l)
+	{
+		float limit = selection.PixelError;
+		if (previous >= 0 && l > previous) limit *= 1.0f - selection.Hysteresis;
+		if (lods[l].Error * pixelsPerUnit > limit) break;
+		level = l;
+	}
+
+	return std::min(std::max(level + selection.Bias, 0), lodCount - 1);
+}
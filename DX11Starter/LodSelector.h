@@ -0,0 +1,42 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// One level of detail inside a mesh's index buffer
+struct MeshLod
+{
+	unsigned FirstIndex;
+	unsigned IndexCount;
+	// Largest distance the simplification moved the surface, in object space
+	float Error;
+};
+
+// Screen space error budget for picking a level of detail
+struct LodSelection
+{
+	// Largest simplification error allowed on screen, in pixels (shadow map texels for shadow passes)
+	float PixelError;
+	// A coarser level is only picked once its error is below PixelError * (1 - Hysteresis),
+	// so meshes near a switching distance do not flicker between two levels
+	float Hysteresis;
+	// Added to the picked level, positive is coarser
+	int Bias;
+};
+
+// Picks levels of detail from the projected size of a bounding sphere.
+// Matrices are transposed for HLSL like everywhere else.
+class LodSelector
+{
+public:
+	static LodSelection CameraDefaults() { return { 1.0f, 0.25f, 0 }; }
+	// Shadow maps are blurred by the filter and cascades are lower resolution than the screen
+	static LodSelection ShadowDefaults() { return { 2.0f, 0.25f, 1 }; }
+
+	// Radius in pixels of a world-transformed bounding sphere, for perspective and orthographic projections.
+	// Returns FLT_MAX when the camera is inside the sphere.
+	static float ProjectedRadius(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT4X4& world,
+		const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection, float viewportHeight);
+
+	// previousLevel is what the same mesh got in the same pass last frame, -1 if nothing
+	static int Select(const MeshLod* lods, int lodCount, float radius, float projectedRadius, const LodSelection& selection, int previousLevel);
+};
@@ -0,0 +1,181 @@
+#include "Lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const size_t MinMatch = 4;
+	const size_t MaxOffset = 65535;
+	// The format ends every block with at least five literals, and no match starts in the last twelve bytes
+	const size_t LastLiterals = 5;
+	const size_t MatchSafeDistance = 12;
+	const int HashBits = 14;
+	// Copies shorter than this go 16 bytes at a time when both buffers have room past their end
+	const size_t WildCopy = 16;
+
+	uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	// The bytes after a token nibble of 15
+	uint8_t* WriteLength(uint8_t* out, size_t length)
+	{
+		for (length -= 15; length >= 255; length -= 255)
+			*out++ = 255;
+		*out++ = uint8_t(length);
+		return out;
+	}
+
+	bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do
+		{
+			if (in == end) return false;
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	uint8_t* WriteSequence(uint8_t* out, uint8_t* outEnd, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		// Token, literal length, literals, offset and match length
+		const size_t worstCase = 1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1;
+		if (size_t(outEnd - out) < worstCase) return nullptr;
+
+		uint8_t* token = out++;
+		*token = uint8_t(std::min<size_t>(literalCount, 15) << 4);
+		if (literalCount >= 15) out = WriteLength(out, literalCount);
+		memcpy(out, literals, literalCount);
+		out += literalCount;
+		if (matchLength == 0) return out;
+
+		*out++ = uint8_t(offset);
+		*out++ = uint8_t(offset >> 8);
+		const size_t matchCode = matchLength - MinMatch;
+		*token |= uint8_t(std::min<size_t>(matchCode, 15));
+		if (matchCode >= 15) out = WriteLength(out, matchCode);
+		return out;
+	}
+}
+
+size_t Lz4::GetMaxCompressedSize(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::Compress(const void* source, size_t size, void* destination, size_t capacity)
+{
+	const uint8_t* const input = static_cast<const uint8_t*>(source);
+	const uint8_t* const inputEnd = input + size;
+	uint8_t* const output = static_cast<uint8_t*>(destination);
+	uint8_t* const outputEnd = output + capacity;
+	uint8_t* out = output;
+	const uint8_t* anchor = input;
+
+	if (size > MatchSafeDistance)
+	{
+		// Positions from the start of the block. Empty slots point at the start, which is checked like any other.
+		std::vector<uint32_t> table(size_t(1) << HashBits, 0);
+		const uint8_t* const matchStartLimit = inputEnd - MatchSafeDistance;
+		const uint8_t* const matchEndLimit = inputEnd - LastLiterals;
+		const uint8_t* p = input;
+		while (p < matchStartLimit)
+		{
+			const uint32_t sequence = Read32(p);
+			uint32_t& slot = table[Hash(sequence)];
+			const uint8_t* match = input + slot;
+			slot = uint32_t(p - input);
+			if (match >= p || size_t(p - match) > MaxOffset || Read32(match) != sequence)
+			{
+				// Step further the longer nothing matched, so incompressible data goes by quickly
+				p += 1 + (size_t(p - anchor) >> 6);
+				continue;
+			}
+
+			// Grow the match back over the pending literals, then forward up to the last literals
+			while (p > anchor && match > input && p[-1] == match[-1])
+			{
+				--p;
+				--match;
+			}
+			size_t length = MinMatch;
+			while (p + length < matchEndLimit && p[length] == match[length])
+				++length;
+
+			out = WriteSequence(out, outputEnd, anchor, size_t(p - anchor), size_t(p - match), length);
+			if (!out) return 0;
+			p += length;
+			anchor = p;
+			// The position just before the next search, for matches that continue a repeated pattern
+			if (p < matchStartLimit)
+				table[Hash(Read32(p - 2))] = uint32_t(p - 2 - input);
+		}
+	}
+
+	out = WriteSequence(out, outputEnd, anchor, size_t(inputEnd - anchor), 0, 0);
+	return out ? size_t(out - output) : 0;
+}
+
+bool Lz4::Decompress(const void* source, size_t size, void* destination, size_t outputSize)
+{
+	const uint8_t* in = static_cast<const uint8_t*>(source);
+	const uint8_t* const inEnd = in + size;
+	uint8_t* const output = static_cast<uint8_t*>(destination);
+	uint8_t* const outEnd = output + outputSize;
+	uint8_t* out = output;
+
+	while (in < inEnd)
+	{
+		const uint8_t token = *in++;
+		size_t literals = token >> 4;
+		if (literals == 15 && !ReadLength(in, inEnd, literals)) return false;
+		if (literals > size_t(inEnd - in) || literals > size_t(outEnd - out)) return false;
+		if (literals <= WildCopy && size_t(inEnd - in) >= WildCopy && size_t(outEnd - out) >= WildCopy)
+			memcpy(out, in, WildCopy);
+		else
+			memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+
+		// Only the last sequence has no match
+		if (in == inEnd) break;
+		if (inEnd - in < 2) return false;
+		const size_t offset = size_t(in[0]) | size_t(in[1]) << 8;
+		in += 2;
+		if (offset == 0 || offset > size_t(out - output)) return false;
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(in, inEnd, length)) return false;
+		length += MinMatch;
+		if (length > size_t(outEnd - out)) return false;
+
+		const uint8_t* match = out - offset;
+		if (offset >= WildCopy && size_t(outEnd - out) >= length + WildCopy)
+		{
+			// Every 16 bytes read were written before this copy started
+			for (size_t i = 0; i < length; i += WildCopy)
+				memcpy(out + i, match + i, WildCopy);
+		}
+		else if (offset >= length)
+			memcpy(out, match, length);
+		else
+		{
+			// The match overlaps what it writes, a repeating pattern
+			for (size_t i = 0; i != length; ++i)
+				out[i] = match[i];
+		}
+		out += length;
+	}
+	return out == outEnd;
+}
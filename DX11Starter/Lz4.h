@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compressor and decompressor for the LZ4 block format: runs of literals followed by matches of at least 4 bytes
+// up to 64 KB back. Matches are found through a single hash table of the last position of every 4 byte sequence,
+// which keeps compression fast and decompression a sequence of copies. Blocks are independent of each other.
+class Lz4
+{
+public:
+	// Worst case size of the compressed form of size bytes
+	static size_t GetMaxCompressedSize(size_t size);
+
+	// Returns the compressed size, or 0 if it would not fit in capacity bytes
+	static size_t Compress(const void* source, size_t size, void* destination, size_t capacity);
+	// The block has to decompress to exactly outputSize bytes. Returns false for a corrupted block, without ever
+	// reading or writing outside the two buffers.
+	static bool Decompress(const void* source, size_t size, void* destination, size_t outputSize);
+};
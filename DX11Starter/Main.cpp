@@ -1,6 +1,11 @@
 
 #include <Windows.h>
+#include <fstream>
 #include "Game.h"
+#include "AssetArchive.h"
+#include "AssetCooker.h"
+#include "Benchmark.h"
+#include "SimpleLogger.h"
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -44,6 +49,40 @@ int WINAPI WinMain(
 		}
 	}
 
+	// Headless benchmark mode: run the CPU side benchmarks
+	// and quit before any window or device is created
+	if (strstr(lpCmdLine, "-benchmark"))
+	{
+		std::ofstream benchmarkLog("benchmark.log");
+		ADD_LOGGER(info, benchmarkLog);
+		RunBenchmarks("models");
+		return 0;
+	}
+
+	// Offline cook: bring the cooked meshes and textures under models up to date,
+	// touching only what changed since the last cook, and quit
+	if (strstr(lpCmdLine, "-cook"))
+	{
+		std::ofstream cookLog("cook.log");
+		ADD_LOGGER(info, cookLog);
+		AssetCookResult result;
+		const bool succeeded = AssetCooker::Cook("models", result);
+		AssetCooker::LogResult(result);
+		return succeeded ? 0 : 1;
+	}
+
+	// Pack everything under models and the compiled shaders into the archive the game mounts at startup.
+	// Run "-cook" first so the cooked meshes and textures go in next to their sources.
+	if (strstr(lpCmdLine, "-pack"))
+	{
+		std::ofstream packLog("pack.log");
+		ADD_LOGGER(info, packLog);
+		std::vector<std::string> files = AssetCooker::ListAssets("models");
+		const std::vector<std::string> shaders = ListFiles(".", ".cso");
+		files.insert(files.end(), shaders.begin(), shaders.end());
+		return AssetArchive::Build(AssetArchive::DefaultName, files, true) ? 0 : 1;
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
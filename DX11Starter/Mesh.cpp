@@ -1,27 +1,86 @@
+#include <cfloat>
 #include <cstdio>
-#include <map>
-#include <sstream>
-#include <fstream>
+#include <cstring>
 #include <utility>
-#include <locale>
-#include <codecvt>
 #include <DirectXMath.h>
-#include <WICTextureLoader.h>
 #include "Mesh.h"
 #include "SimpleLogger.h"
+#include "FileSystem.h"
+#include "ObjParser.h"
+#include "CookedMesh.h"
+#include "MeshCooker.h"
+#include "StreamingMeshCooker.h"
+#include "VirtualFile.h"
 
 
-Mesh::Mesh(Vertex* vertices, int verticesCount, int* indices, int indicesCount, ID3D11Device* device)
+Mesh::Mesh(const Vertex* vertices, int verticesCount, const int* indices, int indicesCount, ID3D11Device* device)
 {
 	indexCount = indicesCount;
+	uvDensity = 0.0f;
 	material = nullptr;
+	arena = nullptr;
+	arenaAllocation = {};
 
+	vertexFormat = VertexFormatFull;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	dequantization = VertexPacker::ComputeDequantization(nullptr, 0, VertexFormatFull);
+	lods.push_back({ 0, UINT(indicesCount), 0.0f });
+
+	CreateBuffers(vertices, sizeof(Vertex) * verticesCount, indices, sizeof(int) * indicesCount, device);
+	MeshCooker::ComputeBoundingBox(vertices, size_t(verticesCount), BoundingBoxCenter, BoundingBoxExtents);
+
+	LOG_INFO << "Mesh created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
+}
+
+Mesh::Mesh(const void* vertices, int verticesCount, VertexFormat vertexFormat, const VertexDequantization& dequantization,
+	const void* indices, int indicesCount, DXGI_FORMAT indexFormat,
+	const DirectX::XMFLOAT3& boundingBoxCenter, const DirectX::XMFLOAT3& boundingBoxExtents, ID3D11Device* device,
+	GeometryArena* arena)
+{
+	indexCount = indicesCount;
+	uvDensity = 0.0f;
+	material = nullptr;
+	this->arena = arena;
+	arenaAllocation = {};
+
+	this->vertexFormat = vertexFormat;
+	this->vertexStride = UINT(VertexPacker::GetVertexSize(vertexFormat));
+	this->indexFormat = indexFormat;
+	this->dequantization = dequantization;
+	lods.push_back({ 0, UINT(indicesCount), 0.0f });
+
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	if (arena)
+	{
+		arenaAllocation = arena->Allocate(vertices, UINT(verticesCount), vertexFormat, indices, UINT(indicesCount), indexFormat);
+		// An arena that cannot make room leaves the mesh to buffers of its own
+		if (!GeometryArena::IsValid(arenaAllocation))
+		{
+			LOG_WARNING << "Mesh at <0x" << this << "> does not fit in the geometry arena, it gets buffers of its own." << std::endl;
+			this->arena = nullptr;
+		}
+	}
+	if (!this->arena)
+	{
+		const UINT indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+		CreateBuffers(vertices, vertexStride * verticesCount, indices, indexSize * indicesCount, device);
+	}
+	BoundingBoxCenter = boundingBoxCenter;
+	BoundingBoxExtents = boundingBoxExtents;
+
+	LOG_INFO << "Mesh created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
+}
+
+void Mesh::CreateBuffers(const void* vertices, UINT vertexBytes, const void* indices, UINT indexBytes, ID3D11Device* device)
+{
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * verticesCount;       // 3 = number of vertices in the buffer
+	vbd.ByteWidth = vertexBytes;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -48,7 +107,7 @@ Mesh::Mesh(Vertex* vertices, int verticesCount, int* indices, int indicesCount,
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * indexCount;         // 3 = number of indices in the buffer
+	ibd.ByteWidth = indexBytes;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -62,75 +121,17 @@ Mesh::Mesh(Vertex* vertices, int verticesCount, int* indices, int indicesCount,
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
-
-	// Calculate Bounding Box out of vertices
-	DirectX::XMFLOAT3 lower = { FLT_MAX , FLT_MAX , FLT_MAX };
-	DirectX::XMFLOAT3 upper = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
-
-	for (int i = 0; i < verticesCount; ++i)
-	{
-		if (lower.x > vertices[i].Position.x)
-			lower.x = vertices[i].Position.x;
-		if (lower.y > vertices[i].Position.y)
-			lower.y = vertices[i].Position.y;
-		if (lower.z > vertices[i].Position.z)
-			lower.z = vertices[i].Position.z;
-		if (upper.x < vertices[i].Position.x)
-			upper.x = vertices[i].Position.x;
-		if (upper.y < vertices[i].Position.y)
-			upper.y = vertices[i].Position.y;
-		if (upper.z < vertices[i].Position.z)
-			upper.z = vertices[i].Position.z;
-	}
-
-	const DirectX::XMFLOAT3 half((upper.x - lower.x) * 0.5f,
-		(upper.y - lower.y) * 0.5f,
-		(upper.z - lower.z) * 0.5f);
-
-	BoundingBoxCenter.x = lower.x + half.x;
-	BoundingBoxCenter.y = lower.y + half.y;
-	BoundingBoxCenter.z = lower.z + half.z;
-
-	BoundingBoxExtents = half;
-
-	LOG_INFO << "Mesh created at <0x" << this << "> by " << __FUNCTION__ << "." << std::endl;
 }
 
-
 Mesh::~Mesh()
 {
 	if (vertexBuffer) { vertexBuffer->Release(); }
 	if (indexBuffer) { indexBuffer->Release(); }
+	if (arena) { arena->Free(arenaAllocation); }
 
 	LOG_INFO << "Mesh destroyed at <0x" << this << ">." << std::endl;
 }
 
-std::vector<std::string> split(std::string str, char ch)
-{
-	std::vector<std::string> result;
-	std::string temp(std::move(str));
-	size_t pos;
-
-	while ((pos = temp.find(ch)) != std::string::npos)
-	{
-		std::string s(temp.begin(), temp.begin() + pos);
-		result.push_back(s);
-		temp = std::string(temp.begin() + pos + 1, temp.end());
-	}
-	result.push_back(temp);
-
-	return result;
-}
-
-template <typename T>
-T str2num(const std::string & str, T & num)
-{
-	std::stringstream ss;
-	ss << str;
-	ss >> num;
-	return num;
-}
-
 Material* Mesh::GetMaterial() const
 {
 	if (material == nullptr)
@@ -147,400 +148,306 @@ void Mesh::SetMaterial(std::shared_ptr<Material> m)
 	material = std::move(m);
 }
 
-std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> Mesh::LoadFromFile(const std::string & filename, ID3D11Device * device, ID3D11DeviceContext * context)
+void Mesh::SetLods(std::vector<MeshLod> l)
 {
-	std::vector<std::shared_ptr<Mesh>> meshList;
-	std::vector<std::shared_ptr<BlinnPhongMaterial>> materialList;
-	std::map<std::string, std::shared_ptr<BlinnPhongMaterial>> materialMap;
-
-	std::vector<DirectX::XMFLOAT3> positions;
-	std::vector<DirectX::XMFLOAT3> normals;
-	std::vector<DirectX::XMFLOAT2> texcoords;
-
-	std::vector<DirectX::XMVECTOR> tangentsPerPositions;
+	if (l.empty()) return;
+	lods = std::move(l);
+	indexCount = int(lods[0].IndexCount);
+}
 
-	std::vector<std::vector<int>> indices;
-	std::vector<std::vector<int>> vertices;
+float Mesh::GetBoundingRadius() const
+{
+	return DirectX::XMVectorGetX(DirectX::XMVector3Length(XMLoadFloat3(&BoundingBoxExtents)));
+}
 
-	std::vector<std::string> mtlOfMeshes;
+int Mesh::SelectLod(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection,
+	float viewportHeight, const LodSelection& selection, int previousLevel) const
+{
+	const float radius = GetBoundingRadius();
+	const float projectedRadius = LodSelector::ProjectedRadius(BoundingBoxCenter, radius, world, view, projection, viewportHeight);
+	return LodSelector::Select(lods.data(), int(lods.size()), radius, projectedRadius, selection, previousLevel);
+}
 
-	int* indexBuffer = nullptr;
-	Vertex* vertexBuffer = nullptr;
+float Mesh::GetPixelsPerUv(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection,
+	float viewportHeight, float& screenArea) const
+{
+	screenArea = 0.0f;
+	const float radius = GetBoundingRadius();
+	if (uvDensity <= 0.0f || radius <= 0.0f) return 0.0f;
+
+	// Like levels of detail, object space sizes scale with the radius on screen. Inside the sphere it covers the screen.
+	const float projectedRadius = LodSelector::ProjectedRadius(BoundingBoxCenter, radius, world, view, projection, viewportHeight);
+	screenArea = projectedRadius == FLT_MAX ? viewportHeight * viewportHeight : DirectX::XM_PI * projectedRadius * projectedRadius;
+	return projectedRadius / radius / uvDensity;
+}
 
-	std::string currentMtl;
+void Mesh::SetClusters(std::vector<MeshCluster> c)
+{
+	clusters = std::move(c);
+	clusterBlocks = ClusterCuller::BuildBlocks(clusters.data(), clusters.size());
+}
 
-	materialMap[""] = BlinnPhongMaterial::GetDefault();
+bool Mesh::IsVisible(const ClusterView& view) const
+{
+	return ClusterCuller::IsSphereVisible(view, BoundingBoxCenter, GetBoundingRadius());
+}
 
-	// Read .obj file
-	std::ifstream fin(filename);
-	LOG_INFO << "OBJ file \"" << filename << "\" opened." << std::endl;
-	std::string line;
-	std::string mtlFile;
-	std::string folder;
-	while (getline(fin, line))
+ClusterCullStats Mesh::CullClusters(const ClusterView& view, std::vector<DrawRange>& ranges) const
+{
+	if (clusters.empty())
 	{
-		auto s = split(line, ' ');
-		std::string first_token(s[0]);
-		if (first_token == "mtllib")
+		ClusterCullStats stats{};
+		if (IsVisible(view))
 		{
-			auto base = split(filename, '\\');
-			mtlFile = "";
-			for (unsigned i = 0; i != base.size() - 1; ++i)
-			{
-				folder += base[i] + "\\";
-			}
-			mtlFile = folder + s[1];
+			ranges.push_back({ lods[0].FirstIndex, lods[0].IndexCount });
+			stats.Visible = 1;
 		}
-		if (first_token == "v")
-		{
-			DirectX::XMFLOAT3 v = {};
-			str2num(s[1], v.x);
-			str2num(s[2], v.y);
-			str2num(s[3], v.z);
-			v.z *= -1.0f;
-			positions.push_back(v);
+		else
+			stats.FrustumCulled = 1;
+		return stats;
+	}
+	return ClusterCuller::Cull(view, clusterBlocks.data(), clusters.data(), clusters.size(), ranges);
+}
 
-		}
-		else if (first_token == "vn")
-		{
-			DirectX::XMFLOAT3 n = {};
-			str2num(s[1], n.x);
-			str2num(s[2], n.y);
-			str2num(s[3], n.z);
-			n.z *= -1.0f;
-			normals.push_back(n);
-		}
-		else if (first_token == "vt")
-		{
-			DirectX::XMFLOAT2 t = {};
-			str2num(s[1], t.x);
-			str2num(s[2], t.y);
-			t.y = 1.0f - t.y;
-			texcoords.push_back(t);
-		}
-		else if (first_token == "f")
+namespace
+{
+	// Texture maps are only requested, they are filled in when textures is flushed
+	std::vector<std::shared_ptr<BlinnPhongMaterial>> CreateMaterials(const std::vector<MtlMaterial>& mtlMaterials, const std::string& folder,
+		ID3D11Device* device, TextureManager& textures, int* remaining)
+	{
+		std::vector<std::shared_ptr<BlinnPhongMaterial>> materialList;
+		for (const MtlMaterial& m : mtlMaterials)
 		{
-			tangentsPerPositions.resize(positions.size(), DirectX::XMVectorZero());
-			int index[3];
-			int vtxV[3];
-			int vtxT[3];
-			int vtxN[3];
-			int vtxTan[3];
-			int vtxBit[3];
-			bool hasNormal = true;
-			for (unsigned i = 0; i != s.size() - 1; ++i)
+			std::shared_ptr<BlinnPhongMaterial> current_mtl = std::make_shared<BlinnPhongMaterial>(device);
+			current_mtl->parameters.ambient = m.Ambient;
+			current_mtl->parameters.diffuse = m.Diffuse;
+			current_mtl->parameters.specular = m.Specular;
+			current_mtl->parameters.emission = m.Emission;
+			current_mtl->parameters.shininess = m.Shininess;
+
+			if (!m.DiffuseMap.empty())
 			{
-				std::string p(s[i + 1]);
-				auto p_detail = split(p, '/');
-				int v = -1, n = -1, t = -1;
-				str2num(p_detail[0], vtxV[i]);
-				str2num(p_detail[1], vtxT[i]);
-				if (p_detail.size() > 2)
-					str2num(p_detail[2], vtxN[i]);
-				else
-					hasNormal = false;
+				textures.Request(folder + m.DiffuseMap, TextureColor, &current_mtl->diffuseSrvPtr, remaining);
+				current_mtl->InitializeSampler();
 			}
-			// No normal data, generate it
-			if (!hasNormal)
+			if (!m.NormalMap.empty())
 			{
-				if (normals.size() < positions.size())
-					normals.resize(positions.size(), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
-				DirectX::XMFLOAT3 pos0 = positions[vtxV[0] - 1];
-				DirectX::XMFLOAT3 pos1 = positions[vtxV[1] - 1];
-				DirectX::XMFLOAT3 pos2 = positions[vtxV[2] - 1];
-
-				DirectX::XMVECTOR posV0 = XMLoadFloat3(&pos0);
-				DirectX::XMVECTOR posV1 = XMLoadFloat3(&pos1);
-				DirectX::XMVECTOR posV2 = XMLoadFloat3(&pos2);
-
-				DirectX::XMVECTOR v1 = DirectX::XMVectorSubtract(posV1, posV0);
-				DirectX::XMVECTOR v2 = DirectX::XMVectorSubtract(posV1, posV2);
-
-				DirectX::XMVECTOR nV = DirectX::XMVector3Cross(v1, v2);
-
-				DirectX::XMFLOAT3 n{};
-				XMStoreFloat3(&n, nV);
-
-				DirectX::XMVECTOR n0 = XMLoadFloat3(&normals[vtxV[0] - 1]);
-				DirectX::XMVECTOR n1 = XMLoadFloat3(&normals[vtxV[1] - 1]);
-				DirectX::XMVECTOR n2 = XMLoadFloat3(&normals[vtxV[2] - 1]);
-
-				n0 = DirectX::XMVectorAdd(n0, nV);
-				n1 = DirectX::XMVectorAdd(n1, nV);
-				n2 = DirectX::XMVectorAdd(n2, nV);
-
-				XMStoreFloat3(&normals[vtxV[0] - 1], n0);
-				XMStoreFloat3(&normals[vtxV[1] - 1], n1);
-				XMStoreFloat3(&normals[vtxV[2] - 1], n2);
-
-				vtxN[0] = vtxV[0];
-				vtxN[1] = vtxV[1];
-				vtxN[2] = vtxV[2];
+				textures.Request(folder + m.NormalMap, TextureNormal, &current_mtl->normalSrvPtr, remaining);
+				current_mtl->InitializeSampler();
 			}
 
-			// Now to calculate tangent and bitangent
-			// We work relative to v0
-			DirectX::XMVECTOR P0 = XMLoadFloat3(&positions[vtxV[0] - 1]);
-			DirectX::XMVECTOR P1 = XMLoadFloat3(&positions[vtxV[1] - 1]);
-			DirectX::XMVECTOR P2 = XMLoadFloat3(&positions[vtxV[2] - 1]);
-
-			DirectX::XMVECTOR Q1V = DirectX::XMVectorSubtract(P1, P0);
-			DirectX::XMVECTOR Q2V = DirectX::XMVectorSubtract(P2, P0);
-
-			DirectX::XMFLOAT3 Q1{};
-			DirectX::XMFLOAT3 Q2{};
-			XMStoreFloat3(&Q1, Q1V);
-			XMStoreFloat3(&Q2, Q2V);
-
-			DirectX::XMFLOAT2 uv0 = texcoords[vtxT[0] - 1];
-			DirectX::XMFLOAT2 uv1 = texcoords[vtxT[1] - 1];
-			DirectX::XMFLOAT2 uv2 = texcoords[vtxT[2] - 1];
-
-			float s1 = uv1.x - uv0.x;
-			float t1 = uv1.y - uv0.y;
-			float s2 = uv2.x - uv0.x;
-			float t2 = uv2.y - uv0.x;
-
-			float inv = 1.0f / ((s1 * t2) - (s2 * t1));
-			float Tx = inv * (t2 * Q1.x - t1 * Q2.x);
-			float Ty = inv * (t2 * Q1.y - t1 * Q2.y);
-			float Tz = inv * (t2 * Q1.z - t1 * Q2.z);
-
-			DirectX::XMFLOAT3 T = { Tx, Ty, Tz };
-			DirectX::XMVECTOR TV = XMLoadFloat3(&T);
-			TV = DirectX::XMVector3Normalize(TV);
-
-			DirectX::XMVECTOR N0V = XMLoadFloat3(&normals[vtxN[0] - 1]);
-			DirectX::XMVECTOR N1V = XMLoadFloat3(&normals[vtxN[1] - 1]);
-			DirectX::XMVECTOR N2V = XMLoadFloat3(&normals[vtxN[2] - 1]);
-
-			DirectX::XMVECTOR B0V = DirectX::XMVector3Cross(N0V, TV);
-			DirectX::XMVECTOR B1V = DirectX::XMVector3Cross(N0V, TV);
-			DirectX::XMVECTOR B2V = DirectX::XMVector3Cross(N0V, TV);
-
-			DirectX::XMVECTOR T0V = DirectX::XMVector3Cross(B0V, N0V);
-			DirectX::XMVECTOR T1V = DirectX::XMVector3Cross(B1V, N1V);
-			DirectX::XMVECTOR T2V = DirectX::XMVector3Cross(B2V, N2V);
+			materialList.push_back(current_mtl);
+		}
+		return materialList;
+	}
+}
 
-			DirectX::XMFLOAT3 T0{};
-			DirectX::XMFLOAT3 T1{};
-			DirectX::XMFLOAT3 T2{};
+void Mesh::Preload(const std::string& filename)
+{
+	VirtualFile::Preload({ filename + ".cooked", filename });
+}
 
-			XMStoreFloat3(&T0, T0V);
-			XMStoreFloat3(&T1, T1V);
-			XMStoreFloat3(&T2, T2V);
+std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> Mesh::LoadFromFile(const std::string & filename, ID3D11Device * device, ID3D11DeviceContext * context,
+	VertexFormat vertexFormat, GeometryArena* arena, TextureManager* textures)
+{
+	PreparedModel model;
+	if (!PrepareFile(filename, vertexFormat, model))
+	{
+		std::vector<std::shared_ptr<BlinnPhongMaterial>> materialList;
+		materialList.push_back(BlinnPhongMaterial::GetDefault());
+		return std::make_pair(std::vector<std::shared_ptr<Mesh>>(), materialList);
+	}
+	return CreateFromPrepared(model, device, context, arena, textures);
+}
 
-			tangentsPerPositions[vtxV[0] - 1] = DirectX::XMVectorAdd(tangentsPerPositions[vtxV[0] - 1], T0V);
-			tangentsPerPositions[vtxV[1] - 1] = DirectX::XMVectorAdd(tangentsPerPositions[vtxV[1] - 1], T1V);
-			tangentsPerPositions[vtxV[2] - 1] = DirectX::XMVectorAdd(tangentsPerPositions[vtxV[2] - 1], T2V);
+bool Mesh::PrepareFile(const std::string& filename, VertexFormat vertexFormat, PreparedModel& model)
+{
+	model.Filename = filename;
+	model.Format = vertexFormat;
+	model.Submeshes.clear();
+	model.Materials.clear();
+
+	const std::string folder = GetFolder(filename);
+	const std::string cookedFilename = filename + ".cooked";
+
+	// Either points into the mapped cooked file, its decoded sections, or into data
+	const Vertex* vertices;
+	const int* indices;
+	const SubmeshRange* submeshes;
+	size_t submeshCount;
+	const LodRange* lodRanges;
+	const ClusterRange* clusterRanges;
+
+	// Sources with the size and write time they were cooked with are not hashed again
+	CookedMesh cooked;
+	MeshData data;
+	bool useCooked = cooked.Open(cookedFilename) && (cooked.SourcesUnchanged() ||
+		cooked.GetSourceHash() == CookedMesh::HashSources(filename, cooked.GetMtlLib().empty() ? "" : folder + cooked.GetMtlLib()));
+	if (useCooked)
+		LOG_INFO << "Cooked mesh \"" << cookedFilename << "\" is up to date." << std::endl;
+
+	// OBJs too large to cook in memory are streamed into the cooked file and loaded from there
+	FileStamp stamp;
+	if (!useCooked && GetFileStamp(filename, stamp) && stamp.Size >= StreamingMeshCooker::Threshold)
+	{
+		cooked.Close();
+		std::string mtlLib;
+		MappedFile objFile;
+		if (objFile.Open(filename))
+			mtlLib = ObjParser::FindMtlLib(objFile.GetData(), objFile.GetEnd());
+		objFile.Close();
+
+		StreamingCookStats stats;
+		std::vector<SourceStamp> stamps;
+		const uint64_t sourceHash = CookedMesh::HashSources(filename, mtlLib.empty() ? "" : folder + mtlLib, &stamps);
+		useCooked = StreamingMeshCooker::Cook(filename, cookedFilename, sourceHash, StreamingMeshCooker::DefaultSettings(), stats, stamps) &&
+			cooked.Open(cookedFilename);
+		if (!useCooked) return false;
+	}
 
-			for (unsigned i = 0; i != s.size() - 1; ++i)
-			{
-				std::vector<int> vertexData = { vtxV[i], vtxN[i], vtxT[i], vtxTan[i], vtxBit[i] };
-				index[i] = int(vertices.size());
-				vertices.push_back(vertexData);
-			}
+	if (useCooked)
+	{
+		vertices = cooked.GetVertices();
+		indices = cooked.GetIndices();
+		submeshes = cooked.GetSubmeshes();
+		submeshCount = cooked.GetSubmeshCount();
+		lodRanges = cooked.GetLods();
+		clusterRanges = cooked.GetClusters();
+		model.Materials = cooked.GetMaterials();
+	}
+	else
+	{
+		cooked.Close();
+		if (!MeshCooker::CookObj(filename, data)) return false;
+		std::vector<SourceStamp> stamps;
+		const uint64_t sourceHash = CookedMesh::HashSources(filename, data.MtlLib.empty() ? "" : folder + data.MtlLib, &stamps);
+		CookedMesh::Write(cookedFilename, data, sourceHash, stamps);
+
+		vertices = data.Vertices.data();
+		indices = data.Indices.data();
+		submeshes = data.Submeshes.data();
+		submeshCount = data.Submeshes.size();
+		lodRanges = data.Lods.data();
+		clusterRanges = data.Clusters.data();
+		model.Materials.swap(data.Materials);
+	}
 
-			indices.push_back({ index[0], index[2], index[1] });
+	size_t sourceBytes = 0;
+	size_t packedBytes = 0;
+	std::vector<int> lodIndices;
+	model.Submeshes.resize(submeshCount);
+	for (size_t m = 0; m != submeshCount; ++m)
+	{
+		const SubmeshRange& submesh = submeshes[m];
+		const Vertex* submeshVertices = vertices + submesh.FirstVertex;
+		PreparedSubmesh& prepared = model.Submeshes[m];
 
-			// I don't want to do 4th face so no.
-		}
-		else if (first_token == "usemtl")
+		// Levels of detail one after another in a single index buffer
+		lodIndices.clear();
+		for (uint32_t l = submesh.FirstLod; l != submesh.FirstLod + submesh.LodCount; ++l)
 		{
-			if (!currentMtl.empty())
-			{
-				// Create new mesh
-				indexBuffer = new int[indices.size() * 3];
-				vertexBuffer = new Vertex[vertices.size()];
-				// Generate indexBuffer
-				for (unsigned i = 0; i != indices.size(); ++i)
-				{
-					for (unsigned j = 0; j < 3; ++j)
-					{
-						indexBuffer[i * 3 + j] = indices[i][j];
-					}
-				}
-				// Generate vertexBuffer
-				int i = 0;
-				for (auto& it : vertices)
-				{
-					DirectX::XMFLOAT3 tangent{};
-					XMStoreFloat3(&tangent, DirectX::XMVector3Normalize(tangentsPerPositions[it[0] - 1]));
-					DirectX::XMVECTOR normal = XMLoadFloat3(&normals[it[1] - 1]);
-					normal = DirectX::XMVector3Normalize(normal);
-					XMStoreFloat3(&normals[it[1] - 1], normal);
-					Vertex vtx{ positions[it[0] - 1], normals[it[1] - 1], texcoords[it[2] - 1], tangent };
-					vertexBuffer[i] = vtx;
-
-					++i;
-				}
-				std::shared_ptr<Mesh> newMesh = std::make_shared<Mesh>(vertexBuffer, int(vertices.size()), indexBuffer, int(indices.size()) * 3, device);
-				meshList.push_back(newMesh);
-				mtlOfMeshes.push_back(currentMtl);
-
-				delete[] indexBuffer;
-				delete[] vertexBuffer;
-
-				indices.clear();
-				vertices.clear();
-			}
+			const LodRange& range = lodRanges[l];
+			prepared.Lods.push_back({ UINT(lodIndices.size()), range.IndexCount, range.Error });
+			lodIndices.insert(lodIndices.end(), indices + range.FirstIndex, indices + range.FirstIndex + range.IndexCount);
+		}
 
-			currentMtl = s[1];
+		// Clusters cover the full detail level, which comes first
+		for (uint32_t c = submesh.FirstCluster; c != submesh.FirstCluster + submesh.ClusterCount; ++c)
+		{
+			const ClusterRange& range = clusterRanges[c];
+			prepared.Clusters.push_back({ range.FirstIndex - lodRanges[submesh.FirstLod].FirstIndex, range.IndexCount,
+				range.Center, range.Radius, range.ConeAxis, range.ConeCutoff });
 		}
-	}
 
-	// Create new mesh
-	indexBuffer = new int[indices.size() * 3];
-	vertexBuffer = new Vertex[vertices.size()];
-	// Generate indexBuffer
-	for (unsigned i = 0; i != indices.size(); ++i)
-	{
-		for (unsigned j = 0; j < 3; ++j)
+		prepared.VertexCount = int(submesh.VertexCount);
+		prepared.Dequantization = VertexPacker::ComputeDequantization(submeshVertices, submesh.VertexCount, vertexFormat);
+		prepared.Vertices.resize(submesh.VertexCount * VertexPacker::GetVertexSize(vertexFormat));
+		if (vertexFormat != VertexFormatFull)
+			VertexPacker::Pack(submeshVertices, submesh.VertexCount, vertexFormat, prepared.Dequantization, prepared.Vertices.data());
+		else
+			memcpy(prepared.Vertices.data(), submeshVertices, prepared.Vertices.size());
+
+		prepared.IndexCount = int(lodIndices.size());
+		prepared.IndexFormat = DXGI_FORMAT_R32_UINT;
+		size_t indexSize = sizeof(int);
+		if (VertexPacker::CanUse16BitIndices(submesh.VertexCount))
 		{
-			indexBuffer[i * 3 + j] = indices[i][j];
+			prepared.IndexFormat = DXGI_FORMAT_R16_UINT;
+			indexSize = sizeof(uint16_t);
+			prepared.Indices.resize(lodIndices.size() * indexSize);
+			VertexPacker::PackIndices16(lodIndices.data(), lodIndices.size(), reinterpret_cast<uint16_t*>(prepared.Indices.data()));
 		}
+		else
+			prepared.Indices.assign(reinterpret_cast<const char*>(lodIndices.data()), reinterpret_cast<const char*>(lodIndices.data() + lodIndices.size()));
+
+		prepared.BoundingBoxCenter = submesh.BoundingBoxCenter;
+		prepared.BoundingBoxExtents = submesh.BoundingBoxExtents;
+		prepared.UvDensity = prepared.Lods.empty() ? 0.0f
+			: MeshCooker::ComputeUvDensity(submeshVertices, lodIndices.data(), prepared.Lods[0].IndexCount);
+		prepared.Material = submesh.Material;
+
+		sourceBytes += submesh.VertexCount * sizeof(Vertex) + lodIndices.size() * sizeof(int);
+		packedBytes += prepared.Vertices.size() + prepared.Indices.size();
 	}
-	// Generate vertexBuffer
-	int i = 0;
-	for (auto& it : vertices)
-	{
-		DirectX::XMFLOAT3 tangent{};
-		XMStoreFloat3(&tangent, DirectX::XMVector3Normalize(tangentsPerPositions[it[0] - 1]));
-		DirectX::XMVECTOR normal = XMLoadFloat3(&normals[it[1] - 1]);
-		normal = DirectX::XMVector3Normalize(normal);
-		XMStoreFloat3(&normals[it[1] - 1], normal);
-		Vertex vtx{ positions[it[0] - 1], normals[it[1] - 1], texcoords[it[2] - 1], tangent };
-		vertexBuffer[i] = vtx;
-
-		++i;
-	}
-	std::shared_ptr<Mesh> newMesh = std::make_shared<Mesh>(vertexBuffer, int(vertices.size()), indexBuffer, int(indices.size() * 3), device);
-	meshList.push_back(newMesh);
-	mtlOfMeshes.push_back(currentMtl);
 
-	delete[] indexBuffer;
-	delete[] vertexBuffer;
+	LOG_INFO << "Geometry of \"" << filename << "\" in " << VertexPacker::GetFormatName(vertexFormat) << " format: "
+		<< sourceBytes << " -> " << packedBytes << " bytes." << std::endl;
+	return true;
+}
 
-	indices.clear();
-	vertices.clear();
+std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> Mesh::CreateFromPrepared(const PreparedModel& model,
+	ID3D11Device* device, ID3D11DeviceContext* context, GeometryArena* arena, TextureManager* textures, int* texturesRemaining)
+{
+	std::vector<std::shared_ptr<Mesh>> meshList;
+	std::vector<std::shared_ptr<BlinnPhongMaterial>> materialList;
 
-	// Read .mtl file
-	if (!mtlFile.empty())
+	// Without a shared manager the textures of this file still decode in parallel, and are ready on return
+	std::unique_ptr<TextureManager> ownTextures;
+	if (!textures)
 	{
-		std::ifstream mltFin(mtlFile);
-		LOG_INFO << "MTL file \"" << mtlFile << "\" opened." << std::endl;
-		std::string mtlLine;
-		std::shared_ptr<BlinnPhongMaterial> current_mtl = nullptr;
-		std::string currentName;
-		while (getline(mltFin, mtlLine))
-		{
-			auto s = split(mtlLine, ' ');
-			std::string first_token(s[0]);
-			if (first_token == "newmtl")
-			{
-				if (current_mtl != nullptr)
-				{
-					// save last material
-					materialList.push_back(current_mtl);
-					materialMap[currentName] = current_mtl;
-				}
-
-				currentName = s[1];
-				current_mtl = std::make_shared<BlinnPhongMaterial>(device);
-			}
-			else if (first_token == "Kd")
-			{
-				float r, g, b;
-				str2num(s[1], r);
-				str2num(s[2], g);
-				str2num(s[3], b);
-				current_mtl->parameters.diffuse = DirectX::XMFLOAT4(r, g, b, 1.0f);
-			}
-			else if (first_token == "Ka")
-			{
-				float r, g, b;
-				str2num(s[1], r);
-				str2num(s[2], g);
-				str2num(s[3], b);
-				current_mtl->parameters.ambient = DirectX::XMFLOAT4(r, g, b, 1.0f);
-			}
-			else if (first_token == "Ks")
-			{
-				float r, g, b;
-				str2num(s[1], r);
-				str2num(s[2], g);
-				str2num(s[3], b);
-				current_mtl->parameters.specular = DirectX::XMFLOAT4(r, g, b, 1.0f);
-			}
-			else if (first_token == "Ke")
-			{
-				float r, g, b;
-				str2num(s[1], r);
-				str2num(s[2], g);
-				str2num(s[3], b);
-				current_mtl->parameters.emission = DirectX::XMFLOAT4(r, g, b, 1.0f);
-			}
-			else if (first_token == "Ns")
-			{
-				//current_mtl->shininess = 20;
-				str2num(s[1], current_mtl->parameters.shininess);
-			}
-			else if (first_token == "map_Kd")
-			{
-				// texture file
-				std::string name = folder + s[1];
-				// string -> wstring
-				std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> cv;
-				std::wstring wName = cv.from_bytes(name);
-				HRESULT hr = DirectX::CreateWICTextureFromFileEx(device, context, wName.c_str(), D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE,
-					0, 0, DirectX::WIC_LOADER_FORCE_SRGB, nullptr, &current_mtl->diffuseSrvPtr);
-				if (FAILED(hr))
-				{
-					LOG_WARNING << "Failed to load diffuse texture file \"" << name << "\"." << std::endl;
-				}
-				else
-				{
-					LOG_INFO << "Load diffuse texture file \"" << name << "\"." << std::endl;
-					current_mtl->InitializeSampler();
-				}
-			}
-			else if (first_token == "map_Bump")
-			{
-				// texture file
-				std::string name = folder + s[1];
-				// string -> wstring
-				std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> cv;
-				std::wstring wName = cv.from_bytes(name);
-				HRESULT hr = DirectX::CreateWICTextureFromFile(device, context, wName.c_str(), nullptr, &current_mtl->normalSrvPtr);
-				if (FAILED(hr))
-				{
-					LOG_WARNING << "Failed to load normal texture file \"" << name << "\"." << std::endl;
-				}
-				else
-				{
-					LOG_INFO << "Load normal texture file \"" << name << "\"." << std::endl;
-					current_mtl->InitializeSampler();
-				}
-			}
-		}
-
-		// save last material
-		materialList.push_back(current_mtl);
-		materialMap[currentName] = current_mtl;
+		ownTextures.reset(new TextureManager(device, context));
+		textures = ownTextures.get();
 	}
-	else
+	materialList = CreateMaterials(model.Materials, GetFolder(model.Filename), device, *textures, texturesRemaining);
+	if (materialList.empty())
 	{
-		LOG_INFO << "No mtl data in file \"" << filename << "\" found. Fallback to default material." << std::endl;
+		LOG_INFO << "No mtl data in file \"" << model.Filename << "\" found. Fallback to default material." << std::endl;
 		materialList.push_back(BlinnPhongMaterial::GetDefault());
 	}
 
-	// Set Material of Mesh
-	for (unsigned m = 0; m != meshList.size(); ++m)
+	for (const PreparedSubmesh& submesh : model.Submeshes)
 	{
-		meshList[m]->SetMaterial(materialMap[mtlOfMeshes[m]]);
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(submesh.Vertices.data(), submesh.VertexCount, model.Format, submesh.Dequantization,
+			submesh.Indices.data(), submesh.IndexCount, submesh.IndexFormat, submesh.BoundingBoxCenter, submesh.BoundingBoxExtents, device, arena);
+		mesh->SetLods(submesh.Lods);
+		mesh->SetClusters(submesh.Clusters);
+		mesh->SetUvDensity(submesh.UvDensity);
+
+		// Set Material of Mesh
+		if (submesh.Material >= 0 && size_t(submesh.Material) < model.Materials.size())
+			mesh->SetMaterial(materialList[submesh.Material]);
+		else
+			mesh->SetMaterial(BlinnPhongMaterial::GetDefault());
+
+		meshList.push_back(mesh);
 	}
 
+	if (ownTextures) ownTextures->Flush();
 
 	std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> result(meshList, materialList);
 	return result;
 }
+
+std::vector<D3D11_INPUT_ELEMENT_DESC> Mesh::GetInputElements(VertexFormat vertexFormat)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
+	if (vertexFormat == VertexFormatFull) return elements;
+
+	const bool quantized = vertexFormat == VertexFormatQuantized;
+	const UINT positionSize = quantized ? sizeof(uint16_t) * 4 : sizeof(DirectX::XMFLOAT3);
+	elements.push_back({ "POSITION", 0, quantized ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	elements.push_back({ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, positionSize, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	elements.push_back({ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, positionSize + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	elements.push_back({ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, positionSize + 8, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	return elements;
+}
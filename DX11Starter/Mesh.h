@@ -5,37 +5,152 @@
 #include <d3d11.h>
 #include <vector>
 #include "Vertex.h"
+#include "VertexPacker.h"
+#include "LodSelector.h"
+#include "ClusterCuller.h"
+#include "GeometryArena.h"
+#include "TextureManager.h"
 #include "Material.h"
 #include "BlinnPhongMaterial.h"
+#include "ObjParser.h"
+
+// A submesh read and packed by Mesh::PrepareFile, everything its Mesh is made from
+struct PreparedSubmesh
+{
+	// Vertices in the model's vertex format, levels of detail one after another in indices of indexFormat
+	std::vector<char> Vertices;
+	int VertexCount;
+	VertexDequantization Dequantization;
+	std::vector<char> Indices;
+	int IndexCount;
+	DXGI_FORMAT IndexFormat;
+	DirectX::XMFLOAT3 BoundingBoxCenter;
+	DirectX::XMFLOAT3 BoundingBoxExtents;
+	std::vector<MeshLod> Lods;
+	std::vector<MeshCluster> Clusters;
+	float UvDensity;
+	// Index into the model's materials, -1 for the default material
+	int32_t Material;
+};
+
+// A model read, cooked if needed and packed on any thread, waiting for Mesh::CreateFromPrepared on the one that
+// owns the device
+struct PreparedModel
+{
+	std::string Filename;
+	VertexFormat Format;
+	std::vector<PreparedSubmesh> Submeshes;
+	std::vector<MtlMaterial> Materials;
+};
 
 class Mesh
 {
 public:
-	Mesh(Vertex* vertices, int verticesCount, int* indices, int indicesCount, ID3D11Device* device);
+	Mesh(const Vertex* vertices, int verticesCount, const int* indices, int indicesCount, ID3D11Device* device);
+	// Vertices already packed into vertexFormat, DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT indices
+	// and a precomputed bounding box. indices may hold several levels of detail, see SetLods.
+	// With an arena the geometry goes into its shared buffers instead of buffers of its own;
+	// the arena has to outlive the mesh.
+	Mesh(const void* vertices, int verticesCount, VertexFormat vertexFormat, const VertexDequantization& dequantization,
+		const void* indices, int indicesCount, DXGI_FORMAT indexFormat,
+		const DirectX::XMFLOAT3& boundingBoxCenter, const DirectX::XMFLOAT3& boundingBoxExtents, ID3D11Device* device,
+		GeometryArena* arena = nullptr);
 	~Mesh();
 
 	// Getters
-	ID3D11Buffer* GetVertexBuffer() const { return vertexBuffer; }
-	ID3D11Buffer* GetIndexBuffer() const { return indexBuffer; }
+	ID3D11Buffer* GetVertexBuffer() const { return arena ? arena->GetVertexBuffer(vertexFormat) : vertexBuffer; }
+	ID3D11Buffer* GetIndexBuffer() const { return arena ? arena->GetIndexBuffer(indexFormat) : indexBuffer; }
+	// Where the mesh starts in its buffers, to add to the start index and base vertex of draws
+	UINT GetStartIndex() const { return arena ? arena->GetStartIndex(arenaAllocation) : 0; }
+	UINT GetBaseVertex() const { return arena ? arena->GetBaseVertex(arenaAllocation) : 0; }
+	// Index count of the full detail level
 	int GetIndexCount() const { return indexCount; }
+	VertexFormat GetVertexFormat() const { return vertexFormat; }
+	UINT GetVertexStride() const { return vertexStride; }
+	DXGI_FORMAT GetIndexFormat() const { return indexFormat; }
+	const VertexDequantization& GetDequantization() const { return dequantization; }
 	Material* GetMaterial() const;
 
 	void SetMaterial(std::shared_ptr<Material> m);
 
-	static std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> LoadFromFile(const std::string& filename, ID3D11Device* device, ID3D11DeviceContext* context);
+	// Levels of detail inside the index buffer, level 0 is the full mesh
+	int GetLodCount() const { return int(lods.size()); }
+	const MeshLod& GetLod(int level) const { return lods[level]; }
+	void SetLods(std::vector<MeshLod> l);
+
+	// Radius of the sphere around the bounding box
+	float GetBoundingRadius() const;
+	// Level of detail for drawing with this world matrix from a camera or light.
+	// previousLevel is the level of the same draw last frame, -1 if none.
+	int SelectLod(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection,
+		float viewportHeight, const LodSelection& selection, int previousLevel) const;
+
+	// UV units per object space unit, see MeshCooker::ComputeUvDensity. 0 until set.
+	float GetUvDensity() const { return uvDensity; }
+	void SetUvDensity(float density) { uvDensity = density; }
+	// Pixels one UV unit covers on screen with this world matrix, for TextureStreamer, and the pixels the bounding
+	// sphere covers. 0 without a UV density.
+	float GetPixelsPerUv(const DirectX::XMFLOAT4X4& world, const DirectX::XMMATRIX& view, const DirectX::XMMATRIX& projection,
+		float viewportHeight, float& screenArea) const;
+
+	// Clusters of the full detail level, see ClusterCuller
+	int GetClusterCount() const { return int(clusters.size()); }
+	const MeshCluster* GetClusters() const { return clusters.data(); }
+	void SetClusters(std::vector<MeshCluster> c);
+
+	// Bounding sphere test against the frustum of a view made for this mesh's world matrix
+	bool IsVisible(const ClusterView& view) const;
+	// Append the index ranges of the visible parts of the full detail level to ranges.
+	// Without clusters that is the whole level if the mesh is visible at all.
+	ClusterCullStats CullClusters(const ClusterView& view, std::vector<DrawRange>& ranges) const;
+
+	// Loads "<filename>.cooked" if it is up to date, otherwise parses the OBJ and writes the cooked file.
+	// Submeshes with at most 65536 vertices get 16-bit indices. All levels of detail go into one index buffer.
+	// Submeshes are sub-allocated from arena if there is one.
+	// Texture maps are requested from textures and are only set once it is flushed, so the textures of several
+	// models decode together. Without one they are loaded before returning.
+	static std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> LoadFromFile(const std::string& filename, ID3D11Device* device, ID3D11DeviceContext* context,
+		VertexFormat vertexFormat = VertexFormatFull, GeometryArena* arena = nullptr, TextureManager* textures = nullptr);
+	// The part of LoadFromFile that needs no device: the cooked mesh opened, or the OBJ cooked, and every submesh
+	// packed into model. Runs on any thread. False if the model cannot be loaded.
+	static bool PrepareFile(const std::string& filename, VertexFormat vertexFormat, PreparedModel& model);
+	// The rest of LoadFromFile, on the thread that owns the context. Texture maps are requested from textures like
+	// there, and texturesRemaining, when given, counts down as they are done, see TextureManager::Request.
+	static std::pair<std::vector<std::shared_ptr<Mesh>>, std::vector<std::shared_ptr<BlinnPhongMaterial>>> CreateFromPrepared(const PreparedModel& model,
+		ID3D11Device* device, ID3D11DeviceContext* context, GeometryArena* arena = nullptr, TextureManager* textures = nullptr,
+		int* texturesRemaining = nullptr);
+	// Start reading the cooked mesh and the OBJ of a model in the background. Preloading every model before
+	// loading the first one overlaps reading the later ones with building the earlier ones.
+	static void Preload(const std::string& filename);
+
+	// Input layout of the packed formats for PackedVertexShader and PackedShadowVS
+	static std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements(VertexFormat vertexFormat);
 
 	// Bounding Box
 	DirectX::XMFLOAT3 BoundingBoxCenter;
 	DirectX::XMFLOAT3 BoundingBoxExtents;
 
 private:
-	// Buffers to hold actual geometry data
+	void CreateBuffers(const void* vertices, UINT vertexBytes, const void* indices, UINT indexBytes, ID3D11Device* device);
+
+	// Buffers to hold actual geometry data, unless it is in an arena
 	ID3D11Buffer* vertexBuffer;
 	ID3D11Buffer* indexBuffer;
+	GeometryArena* arena;
+	GeometryAllocation arenaAllocation;
 
 	// Material
 	std::shared_ptr<Material> material;
 
 	int indexCount;
+	float uvDensity;
+	std::vector<MeshLod> lods;
+	std::vector<MeshCluster> clusters;
+	std::vector<ClusterBlock> clusterBlocks;
+
+	VertexFormat vertexFormat;
+	UINT vertexStride;
+	DXGI_FORMAT indexFormat;
+	VertexDequantization dequantization;
 };
 
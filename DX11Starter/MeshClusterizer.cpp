@@ -0,0 +1,121 @@
+#include "MeshClusterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// A triangle whose normal is further than this (cosine) from the average normal of the
+	// cluster so far starts a new cluster, which keeps the normal cones narrow enough to cull
+	const float ConeSplitCosine = 0.5f;
+	// Clusters below this many triangles are never split for their normals
+	const size_t MinConeTriangles = 16;
+
+	// Unit normal of a triangle facing the side it is drawn from, zero if degenerate
+	DirectX::XMVECTOR TriangleNormal(const Vertex* vertices, const int* triangle)
+	{
+		const DirectX::XMVECTOR p0 = XMLoadFloat3(&vertices[triangle[0]].Position);
+		const DirectX::XMVECTOR p1 = XMLoadFloat3(&vertices[triangle[1]].Position);
+		const DirectX::XMVECTOR p2 = XMLoadFloat3(&vertices[triangle[2]].Position);
+		const DirectX::XMVECTOR n = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+		const float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(n));
+		return length > 0.0f ? DirectX::XMVectorScale(n, 1.0f / length) : DirectX::XMVectorZero();
+	}
+}
+
+void MeshClusterizer::Build(const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+	uint32_t firstIndex, std::vector<ClusterRange>& clusters)
+{
+	// Number of the last cluster that used each vertex, 0 for none
+	std::vector<size_t> lastCluster(vertexCount, 0);
+	size_t clusterNumber = 1;
+
+	size_t start = 0;
+	size_t clusterVertices = 0;
+	DirectX::XMVECTOR normalSum = DirectX::XMVectorZero();
+
+	const auto finish = [&](size_t end)
+	{
+		ClusterRange cluster{};
+		cluster.FirstIndex = firstIndex + uint32_t(start);
+		cluster.IndexCount = uint32_t(end - start);
+		ComputeBounds(indices + start, end - start, vertices, cluster);
+		clusters.push_back(cluster);
+
+		start = end;
+		clusterVertices = 0;
+		normalSum = DirectX::XMVectorZero();
+		++clusterNumber;
+	};
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const int* triangle = indices + i;
+		const DirectX::XMVECTOR normal = TriangleNormal(vertices, triangle);
+
+		size_t newVertices = 0;
+		for (size_t k = 0; k != 3; ++k)
+			newVertices += lastCluster[triangle[k]] != clusterNumber;
+
+		const size_t triangles = (i - start) / 3;
+		bool split = triangles == MaxTriangles || clusterVertices + newVertices > MaxVertices;
+		if (!split && triangles >= MinConeTriangles)
+		{
+			const DirectX::XMVECTOR average = DirectX::XMVector3Normalize(normalSum);
+			split = DirectX::XMVectorGetX(DirectX::XMVector3Dot(average, normal)) < ConeSplitCosine;
+		}
+		if (split && triangles > 0)
+			finish(i);
+
+		for (size_t k = 0; k != 3; ++k)
+		{
+			clusterVertices += lastCluster[triangle[k]] != clusterNumber;
+			lastCluster[triangle[k]] = clusterNumber;
+		}
+		normalSum = DirectX::XMVectorAdd(normalSum, normal);
+	}
+	if (start < indexCount - indexCount % 3)
+		finish(indexCount - indexCount % 3);
+}
+
+void MeshClusterizer::ComputeBounds(const int* indices, size_t indexCount, const Vertex* vertices, ClusterRange& cluster)
+{
+	// Sphere around the bounding box of the corners
+	DirectX::XMVECTOR lower = DirectX::XMVectorReplicate(FLT_MAX);
+	DirectX::XMVECTOR upper = DirectX::XMVectorReplicate(-FLT_MAX);
+	for (size_t i = 0; i != indexCount; ++i)
+	{
+		const DirectX::XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].Position);
+		lower = DirectX::XMVectorMin(lower, p);
+		upper = DirectX::XMVectorMax(upper, p);
+	}
+	const DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(lower, upper), 0.5f);
+	float radius = 0.0f;
+	for (size_t i = 0; i != indexCount; ++i)
+	{
+		const DirectX::XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].Position);
+		radius = std::max(radius, DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(p, center))));
+	}
+	XMStoreFloat3(&cluster.Center, center);
+	cluster.Radius = radius;
+
+	// Cone around the average triangle normal, opened up to the normal furthest from it
+	DirectX::XMVECTOR axis = DirectX::XMVectorZero();
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+		axis = DirectX::XMVectorAdd(axis, TriangleNormal(vertices, indices + i));
+	axis = DirectX::XMVector3Normalize(axis);
+
+	float minDot = 1.0f;
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const DirectX::XMVECTOR normal = TriangleNormal(vertices, indices + i);
+		if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(normal)) == 0.0f) continue;
+		minDot = std::min(minDot, DirectX::XMVectorGetX(DirectX::XMVector3Dot(axis, normal)));
+	}
+	XMStoreFloat3(&cluster.ConeAxis, axis);
+
+	// A cluster faces away once the view direction is within 90 degrees minus the cone angle
+	// of the axis, so the cutoff is the sine of the cone angle. Cones this wide hardly ever
+	// cull anything and are not worth testing.
+	cluster.ConeCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Vertex.h"
+#include "CookedMesh.h"
+
+// Splits triangle lists into small clusters with a bounding sphere and a normal cone each,
+// so the renderer can skip the parts of a large mesh that are off screen or facing away.
+// Triangles keep their order, every cluster is a contiguous index range.
+class MeshClusterizer
+{
+public:
+	// Upper limits of one cluster, the same as for mesh shader meshlets
+	static const size_t MaxVertices = 64;
+	static const size_t MaxTriangles = 124;
+
+	// Append the clusters of a triangle list to clusters. firstIndex is the position of indices[0]
+	// in the index buffer the ranges refer to.
+	static void Build(const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		uint32_t firstIndex, std::vector<ClusterRange>& clusters);
+
+	// Bounding sphere and normal cone of the triangles of one cluster
+	static void ComputeBounds(const int* indices, size_t indexCount, const Vertex* vertices, ClusterRange& cluster);
+};
@@ -0,0 +1,262 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include "Lz4.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MESH_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Fewer blocks than this per thread are not worth starting a thread for
+	const size_t MinBlocksPerThread = 4;
+
+	uint32_t ZigZag(uint32_t delta)
+	{
+		return (delta << 1) ^ (0u - (delta >> 31));
+	}
+
+	uint32_t UnZigZag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	// Byte b of word w of every element goes to plane w * 4 + b, planes are count bytes long
+	void EncodeBlock(const uint8_t* elements, size_t count, size_t stride, uint8_t* planes)
+	{
+		for (size_t w = 0; w != stride / 4; ++w)
+		{
+			uint8_t* plane = planes + w * 4 * count;
+			uint32_t previous = 0;
+			for (size_t i = 0; i != count; ++i)
+			{
+				uint32_t value;
+				memcpy(&value, elements + i * stride + w * 4, sizeof(value));
+				const uint32_t coded = ZigZag(value - previous);
+				previous = value;
+				for (size_t b = 0; b != 4; ++b)
+					plane[b * count + i] = uint8_t(coded >> (b * 8));
+			}
+		}
+	}
+
+	// Elements [first, count) of word w, previous is the value of element first - 1
+	void DecodeWord(const uint8_t* planes, size_t count, size_t stride, size_t w, size_t first, uint32_t previous, uint8_t* output)
+	{
+		const uint8_t* plane = planes + w * 4 * count;
+		for (size_t i = first; i != count; ++i)
+		{
+			const uint32_t coded = uint32_t(plane[i]) | uint32_t(plane[count + i]) << 8 |
+				uint32_t(plane[2 * count + i]) << 16 | uint32_t(plane[3 * count + i]) << 24;
+			previous += UnZigZag(coded);
+			memcpy(output + i * stride + w * 4, &previous, sizeof(previous));
+		}
+	}
+
+#ifdef MESH_CODEC_SSE2
+	// Word w of elements [i, i + 16) out of its four planes, four elements per register. previous holds the value of
+	// element i - 1 in every lane and is moved on to element i + 15.
+	void DecodeWord16(const uint8_t* planes, size_t count, size_t w, size_t i, __m128i& previous, __m128i words[4])
+	{
+		const uint8_t* plane = planes + w * 4 * count + i;
+		const __m128i byte0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane));
+		const __m128i byte1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + count));
+		const __m128i byte2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + 2 * count));
+		const __m128i byte3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + 3 * count));
+
+		const __m128i low01 = _mm_unpacklo_epi8(byte0, byte1);
+		const __m128i high01 = _mm_unpackhi_epi8(byte0, byte1);
+		const __m128i low23 = _mm_unpacklo_epi8(byte2, byte3);
+		const __m128i high23 = _mm_unpackhi_epi8(byte2, byte3);
+		words[0] = _mm_unpacklo_epi16(low01, low23);
+		words[1] = _mm_unpackhi_epi16(low01, low23);
+		words[2] = _mm_unpacklo_epi16(high01, high23);
+		words[3] = _mm_unpackhi_epi16(high01, high23);
+
+		const __m128i one = _mm_set1_epi32(1);
+		for (int r = 0; r != 4; ++r)
+		{
+			// Undo the zigzag, then a prefix sum of the four deltas on top of the previous value
+			__m128i value = _mm_xor_si128(_mm_srli_epi32(words[r], 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(words[r], one)));
+			value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+			value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+			value = _mm_add_epi32(value, previous);
+			previous = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+			words[r] = value;
+		}
+	}
+
+	void DecodeBlock(const uint8_t* planes, size_t count, size_t stride, uint8_t* output)
+	{
+		const size_t wordCount = stride / 4;
+		const size_t vectorCount = count & ~size_t(15);
+		size_t w = 0;
+
+		if (wordCount == 1)
+		{
+			// Indices, the elements are contiguous
+			__m128i previous = _mm_setzero_si128();
+			__m128i words[4];
+			for (size_t i = 0; i != vectorCount; i += 16)
+			{
+				DecodeWord16(planes, count, 0, i, previous, words);
+				for (int r = 0; r != 4; ++r)
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(output + (i + r * 4) * 4), words[r]);
+			}
+			DecodeWord(planes, count, stride, 0, vectorCount, uint32_t(_mm_cvtsi128_si32(previous)), output);
+			return;
+		}
+
+		// Four words of four elements at a time, transposed so each element's words are stored together
+		for (; w + 4 <= wordCount; w += 4)
+		{
+			__m128i previous[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+			__m128i words[4][4];
+			for (size_t i = 0; i != vectorCount; i += 16)
+			{
+				for (int k = 0; k != 4; ++k)
+					DecodeWord16(planes, count, w + k, i, previous[k], words[k]);
+
+				for (int r = 0; r != 4; ++r)
+				{
+					const __m128i t0 = _mm_unpacklo_epi32(words[0][r], words[1][r]);
+					const __m128i t1 = _mm_unpacklo_epi32(words[2][r], words[3][r]);
+					const __m128i t2 = _mm_unpackhi_epi32(words[0][r], words[1][r]);
+					const __m128i t3 = _mm_unpackhi_epi32(words[2][r], words[3][r]);
+					uint8_t* element = output + (i + r * 4) * stride + w * 4;
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(element), _mm_unpacklo_epi64(t0, t1));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(element + stride), _mm_unpackhi_epi64(t0, t1));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(element + 2 * stride), _mm_unpacklo_epi64(t2, t3));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(element + 3 * stride), _mm_unpackhi_epi64(t2, t3));
+				}
+			}
+			for (int k = 0; k != 4; ++k)
+				DecodeWord(planes, count, stride, w + k, vectorCount, uint32_t(_mm_cvtsi128_si32(previous[k])), output);
+		}
+
+		for (; w != wordCount; ++w)
+			DecodeWord(planes, count, stride, w, 0, 0, output);
+	}
+#else
+	void DecodeBlock(const uint8_t* planes, size_t count, size_t stride, uint8_t* output)
+	{
+		for (size_t w = 0; w != stride / 4; ++w)
+			DecodeWord(planes, count, stride, w, 0, 0, output);
+	}
+#endif
+
+	// Calls function(index) for indices [0, count) on up to threadCount threads
+	template <typename Function>
+	void ParallelFor(size_t count, unsigned threadCount, const Function& function)
+	{
+		threadCount = unsigned(std::min<size_t>(threadCount, std::max<size_t>(1, count)));
+		std::atomic<size_t> next(0);
+		const auto work = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				function(i);
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < threadCount; ++t)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers) worker.join();
+	}
+}
+
+size_t MeshCodec::GetBlockElements(size_t stride)
+{
+	// A multiple of the 16 the vectorized decoder does at once
+	return std::max<size_t>(16, BlockSize / stride & ~size_t(15));
+}
+
+size_t MeshCodec::GetMaxEncodedSize(size_t count, size_t stride)
+{
+	const size_t blockElements = GetBlockElements(stride);
+	return (count + blockElements - 1) / blockElements * sizeof(uint32_t) + count * stride;
+}
+
+std::vector<char> MeshCodec::Encode(const void* elements, size_t count, size_t stride)
+{
+	const size_t blockElements = GetBlockElements(stride);
+	std::vector<char> output(GetMaxEncodedSize(count, stride));
+	std::vector<uint8_t> planes(blockElements * stride);
+	size_t size = 0;
+
+	// Every block is its stored size followed by its planes, compressed unless that does not make them smaller
+	for (size_t first = 0; first < count; first += blockElements)
+	{
+		const size_t blockCount = std::min(blockElements, count - first);
+		const size_t planeSize = blockCount * stride;
+		EncodeBlock(static_cast<const uint8_t*>(elements) + first * stride, blockCount, stride, planes.data());
+
+		char* block = output.data() + size + sizeof(uint32_t);
+		uint32_t storedSize = uint32_t(Lz4::Compress(planes.data(), planeSize, block, planeSize - 1));
+		if (storedSize == 0)
+		{
+			memcpy(block, planes.data(), planeSize);
+			storedSize = uint32_t(planeSize);
+		}
+		memcpy(output.data() + size, &storedSize, sizeof(storedSize));
+		size += sizeof(uint32_t) + storedSize;
+	}
+
+	output.resize(size);
+	return output;
+}
+
+bool MeshCodec::Decode(const void* source, size_t size, void* destination, size_t count, size_t stride, unsigned threadCount)
+{
+	if (stride == 0 || stride % 4 != 0 || count > SIZE_MAX / stride) return false;
+	const size_t blockElements = GetBlockElements(stride);
+	const size_t blockTotal = (count + blockElements - 1) / blockElements;
+
+	// Where every block starts, which also checks they exactly fill the source
+	const char* input = static_cast<const char*>(source);
+	std::vector<size_t> offsets(blockTotal);
+	size_t offset = 0;
+	for (size_t b = 0; b != blockTotal; ++b)
+	{
+		uint32_t storedSize;
+		if (size - offset < sizeof(storedSize)) return false;
+		memcpy(&storedSize, input + offset, sizeof(storedSize));
+		offset += sizeof(storedSize);
+		if (size - offset < storedSize || storedSize > std::min(blockElements, count - b * blockElements) * stride) return false;
+		offsets[b] = offset;
+		offset += storedSize;
+	}
+	if (offset != size) return false;
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = unsigned(std::min<size_t>(threadCount, std::max<size_t>(1, blockTotal / MinBlocksPerThread)));
+
+	std::atomic<bool> failed(false);
+	ParallelFor(blockTotal, threadCount, [&](size_t b)
+	{
+		const size_t first = b * blockElements;
+		const size_t blockCount = std::min(blockElements, count - first);
+		const size_t planeSize = blockCount * stride;
+		const size_t storedSize = (b + 1 == blockTotal ? size : offsets[b + 1] - sizeof(uint32_t)) - offsets[b];
+		const uint8_t* planes = reinterpret_cast<const uint8_t*>(input + offsets[b]);
+
+		std::vector<uint8_t> decompressed;
+		if (storedSize != planeSize)
+		{
+			decompressed.resize(planeSize);
+			if (!Lz4::Decompress(planes, storedSize, decompressed.data(), planeSize))
+			{
+				failed = true;
+				return;
+			}
+			planes = decompressed.data();
+		}
+		DecodeBlock(planes, blockCount, stride, static_cast<uint8_t*>(destination) + first * stride);
+	});
+	return !failed;
+}
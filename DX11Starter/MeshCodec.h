@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless codec for vertex and index buffers. Every 32 bit word of an element is stored as the zigzagged difference to
+// the same word of the previous element, so neighbouring vertices and indices turn into small numbers. Those are split
+// into byte planes, the lowest byte of every element first, which puts the mostly zero high bytes into long runs for
+// LZ4. Elements are coded in independent blocks whose planes fit in BlockSize bytes, and decoding undoes the planes
+// and the differences for 16 elements at a time with SSE2.
+class MeshCodec
+{
+public:
+	static const size_t BlockSize = 64 * 1024;
+
+	// Elements per block. Encoding a multiple of this many elements at a time and putting the results together gives
+	// the same bytes as encoding them all at once.
+	static size_t GetBlockElements(size_t stride);
+	// Worst case size of count elements of stride bytes, stride has to be a multiple of 4
+	static size_t GetMaxEncodedSize(size_t count, size_t stride);
+
+	// Vertices are coded with the size of a vertex as stride, 32 bit indices with a stride of 4
+	static std::vector<char> Encode(const void* elements, size_t count, size_t stride);
+	// Writes exactly count elements to destination, which can be the memory the buffer is uploaded from. Blocks are
+	// spread over threadCount threads, 0 picks one per core. Returns false for corrupted data, without ever reading
+	// or writing outside the two buffers. Does not log.
+	static bool Decode(const void* source, size_t size, void* destination, size_t count, size_t stride, unsigned threadCount = 1);
+};
@@ -0,0 +1,721 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "MeshCooker.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshClusterizer.h"
+#include "TangentGenerator.h"
+#include "TextureCooker.h"
+#include "ImageDecoder.h"
+#include "VertexPacker.h"
+#include "ObjParser.h"
+#include "FileSystem.h"
+#include "VirtualFile.h"
+#include "SimpleLogger.h"
+
+namespace
+{
+	template<typename Index>
+	float ComputeUvDensityOf(const Vertex* vertices, const Index* indices, size_t indexCount)
+	{
+		double area = 0.0;
+		double uvArea = 0.0;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			const Vertex& a = vertices[indices[i]];
+			const Vertex& b = vertices[indices[i + 1]];
+			const Vertex& c = vertices[indices[i + 2]];
+			const DirectX::XMVECTOR p0 = XMLoadFloat3(&a.Position);
+			const DirectX::XMVECTOR edges = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(XMLoadFloat3(&b.Position), p0),
+				DirectX::XMVectorSubtract(XMLoadFloat3(&c.Position), p0));
+			area += DirectX::XMVectorGetX(DirectX::XMVector3Length(edges));
+			uvArea += std::fabs(double(b.UV.x - a.UV.x) * (c.UV.y - a.UV.y) - double(c.UV.x - a.UV.x) * (b.UV.y - a.UV.y));
+		}
+		if (area <= 0.0 || uvArea <= 0.0) return 0.0f;
+		return float(std::sqrt(uvArea / area));
+	}
+
+	DirectX::XMFLOAT2 GetTexCoord(const std::vector<DirectX::XMFLOAT2>& texcoords, int index)
+	{
+		// Faces without texture coordinates ("v//vn") fall back to the origin
+		if (index <= 0) return DirectX::XMFLOAT2(0.0f, 0.0f);
+		return texcoords[index - 1];
+	}
+
+	DirectX::XMFLOAT3 GetNormal(const std::vector<DirectX::XMFLOAT3>& normals, int index)
+	{
+		// Faces without normals get a zero normal for GenerateNormals to replace
+		if (index <= 0) return DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		// Normalized from the file's value every time, so the result does not depend on which groups came first
+		DirectX::XMFLOAT3 normal;
+		XMStoreFloat3(&normal, DirectX::XMVector3Normalize(XMLoadFloat3(&normals[index - 1])));
+		return normal;
+	}
+
+	// Hash of an OBJ index triple, used to weld face corners into shared vertices
+	struct ObjIndexHash
+	{
+		size_t operator()(const ObjIndex& index) const
+		{
+			size_t h = size_t(index.Position) * 73856093u;
+			h ^= size_t(index.Normal) * 19349663u;
+			h ^= size_t(index.TexCoord) * 83492791u;
+			return h;
+		}
+	};
+
+	struct ObjIndexEqual
+	{
+		bool operator()(const ObjIndex& a, const ObjIndex& b) const
+		{
+			return a.Position == b.Position && a.Normal == b.Normal && a.TexCoord == b.TexCoord;
+		}
+	};
+
+	typedef std::unordered_map<ObjIndex, int, ObjIndexHash, ObjIndexEqual> WeldMap;
+
+	struct PositionHash
+	{
+		size_t operator()(const DirectX::XMFLOAT3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return size_t(bits[0] * 73856093u) ^ size_t(bits[1] * 19349663u) ^ size_t(bits[2] * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	// Mark the vertices whose position is also used by another submesh
+	std::vector<unsigned char> FindSharedVertices(const MeshData& data)
+	{
+		const uint32_t shared = ~0u;
+		std::unordered_map<DirectX::XMFLOAT3, uint32_t, PositionHash, PositionEqual> owners;
+		owners.reserve(data.Vertices.size());
+		for (uint32_t m = 0; m != uint32_t(data.Submeshes.size()); ++m)
+		{
+			const SubmeshRange& submesh = data.Submeshes[m];
+			for (uint32_t v = submesh.FirstVertex; v != submesh.FirstVertex + submesh.VertexCount; ++v)
+			{
+				uint32_t& owner = owners.emplace(data.Vertices[v].Position, m).first->second;
+				if (owner != m) owner = shared;
+			}
+		}
+
+		std::vector<unsigned char> locked(data.Vertices.size());
+		for (size_t v = 0; v != data.Vertices.size(); ++v)
+			locked[v] = owners[data.Vertices[v].Position] == shared;
+		return locked;
+	}
+
+	// Return the vertex for an index triple, adding it if it has not been seen in this submesh
+	int WeldVertex(const ObjIndex& index, WeldMap& weldMap, std::vector<ObjIndex>& vertices)
+	{
+		const auto inserted = weldMap.emplace(index, int(vertices.size()));
+		if (inserted.second)
+			vertices.push_back(index);
+		return inserted.first->second;
+	}
+
+	// Append the welded vertices and indices of one submesh to data
+	void AddSubmesh(const std::vector<ObjIndex>& vertices, const std::vector<int>& indices,
+		const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<DirectX::XMFLOAT3>& normals, const std::vector<DirectX::XMFLOAT2>& texcoords,
+		int32_t material, MeshData& data)
+	{
+		SubmeshRange submesh{};
+		submesh.FirstVertex = uint32_t(data.Vertices.size());
+		submesh.VertexCount = uint32_t(vertices.size());
+		submesh.FirstIndex = uint32_t(data.Indices.size());
+		submesh.IndexCount = uint32_t(indices.size());
+		submesh.Material = material;
+
+		// Generate vertexBuffer
+		data.Vertices.resize(data.Vertices.size() + vertices.size());
+		Vertex* vertexBuffer = data.Vertices.data() + submesh.FirstVertex;
+		for (size_t i = 0; i != vertices.size(); ++i)
+		{
+			const ObjIndex& it = vertices[i];
+			// The parser dropped faces with indices out of range. Tangents come later from GenerateTangents
+			const DirectX::XMFLOAT4 tangent(0.0f, 0.0f, 0.0f, 1.0f);
+			vertexBuffer[i] = { positions[it.Position - 1], GetNormal(normals, it.Normal), GetTexCoord(texcoords, it.TexCoord), tangent };
+		}
+		data.Indices.insert(data.Indices.end(), indices.begin(), indices.end());
+
+		MeshCooker::ComputeBoundingBox(vertexBuffer, submesh.VertexCount, submesh.BoundingBoxCenter, submesh.BoundingBoxExtents);
+		data.Submeshes.push_back(submesh);
+
+		// One vertex per face corner is what we would have without welding
+		const size_t unweldedBytes = indices.size() * (sizeof(Vertex) + sizeof(int));
+		const size_t weldedBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(int);
+		LOG_INFO << "Welded submesh: " << indices.size() << " -> " << vertices.size() << " vertices, "
+			<< unweldedBytes << " -> " << weldedBytes << " bytes." << std::endl;
+	}
+
+	// Materials that draw the same, whatever their names
+	bool SameSurface(const MtlMaterial& a, const MtlMaterial& b)
+	{
+		const auto same = [](const DirectX::XMFLOAT4& x, const DirectX::XMFLOAT4& y) { return x.x == y.x && x.y == y.y && x.z == y.z && x.w == y.w; };
+		return same(a.Ambient, b.Ambient) && same(a.Diffuse, b.Diffuse) && same(a.Specular, b.Specular) && same(a.Emission, b.Emission)
+			&& a.Shininess == b.Shininess && a.DiffuseMap == b.DiffuseMap && a.NormalMap == b.NormalMap;
+	}
+
+}
+
+bool MeshCooker::CookObj(const std::string& filename, MeshData& data, bool optimize, const LodChainSettings& lodChain,
+	const AtlasSettings& atlas)
+{
+	// Read .obj file
+	VirtualFile objFile;
+	if (!objFile.Open(filename))
+	{
+		LOG_ERROR << "Failed to open OBJ file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+	LOG_INFO << "OBJ file \"" << filename << "\" opened." << std::endl;
+
+	ObjData obj;
+	ObjParser::ParseObjParallel(objFile.GetData(), objFile.GetEnd(), obj);
+	objFile.Close();
+
+	const std::string folder = GetFolder(filename);
+	data.MtlLib = obj.MtlLib;
+	LoadMaterials(folder, obj.MtlLib, data.Materials);
+
+	for (const ObjGroup& group : obj.Groups)
+		WeldGroup(obj, group, FindMaterial(data.Materials, group.Material), data);
+
+	GenerateNormals(data);
+	const size_t weldedCount = data.Vertices.size();
+	GenerateTangents(data);
+	LOG_INFO << "Generated tangents: " << weldedCount << " -> " << data.Vertices.size() << " vertices after splitting." << std::endl;
+
+	// After tangents, moving UVs into an atlas only scales them
+	if (atlas.MaxImageSize > 0)
+		CookAtlases(data, filename, atlas);
+
+	if (optimize)
+		OptimizeSubmeshes(data);
+
+	GenerateClusters(data);
+	GenerateLods(data, lodChain, optimize);
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		std::ostringstream chain;
+		for (uint32_t l = submesh.FirstLod; l != submesh.FirstLod + submesh.LodCount; ++l)
+			chain << (l == submesh.FirstLod ? "" : " -> ") << data.Lods[l].IndexCount / 3 << " (" << data.Lods[l].Error << ")";
+		LOG_INFO << "Level of detail chain: " << chain.str() << " triangles (error)." << std::endl;
+	}
+	LOG_INFO << "Clustered " << data.Submeshes.size() << " submeshes into " << data.Clusters.size() << " clusters." << std::endl;
+
+	return true;
+}
+
+void MeshCooker::LoadMaterials(const std::string& folder, const std::string& mtlLib, std::vector<MtlMaterial>& materials)
+{
+	// Read .mtl file
+	VirtualFile mtlFile;
+	if (!mtlLib.empty() && mtlFile.Open(folder + mtlLib))
+	{
+		LOG_INFO << "MTL file \"" << folder + mtlLib << "\" opened." << std::endl;
+		ObjParser::ParseMtl(mtlFile.GetData(), mtlFile.GetEnd(), materials);
+	}
+}
+
+int32_t MeshCooker::FindMaterial(const std::vector<MtlMaterial>& materials, const std::string& name)
+{
+	// Later definitions of the same name win
+	for (size_t m = materials.size(); m-- != 0;)
+		if (materials[m].Name == name) return int32_t(m);
+	return -1;
+}
+
+void MeshCooker::WeldGroup(const ObjData& obj, const ObjGroup& group, int32_t material, MeshData& data)
+{
+	if (group.FaceCount == 0) return;
+
+	// Unique vertices of the submesh and the indices into them
+	std::vector<ObjIndex> vertices;
+	std::vector<int> indices;
+	WeldMap weldMap;
+	indices.reserve(group.FaceCount * 3);
+	weldMap.reserve(group.FaceCount * 3);
+
+	for (size_t f = group.FirstFace; f != group.FirstFace + group.FaceCount; ++f)
+	{
+		const ObjFace& face = obj.Faces[f];
+		int index[3];
+		for (unsigned i = 0; i != 3; ++i)
+		{
+			// No normal data, GenerateNormals fills it in
+			const ObjIndex vertexData = { face.Corners[i].Position, face.Corners[i].TexCoord, face.HasNormal ? face.Corners[i].Normal : 0 };
+			index[i] = WeldVertex(vertexData, weldMap, vertices);
+		}
+
+		indices.push_back(index[0]);
+		indices.push_back(index[2]);
+		indices.push_back(index[1]);
+	}
+
+	AddSubmesh(vertices, indices, obj.Positions, obj.Normals, obj.TexCoords, material, data);
+}
+
+bool MeshCooker::FindUvTile(const Vertex* vertices, size_t vertexCount, DirectX::XMFLOAT2& tile)
+{
+	if (vertexCount == 0) return false;
+	DirectX::XMFLOAT2 lowest = vertices[0].UV;
+	DirectX::XMFLOAT2 highest = vertices[0].UV;
+	for (size_t v = 1; v != vertexCount; ++v)
+	{
+		const DirectX::XMFLOAT2& uv = vertices[v].UV;
+		lowest = DirectX::XMFLOAT2(std::min(lowest.x, uv.x), std::min(lowest.y, uv.y));
+		highest = DirectX::XMFLOAT2(std::max(highest.x, uv.x), std::max(highest.y, uv.y));
+	}
+
+	// A little outside the tile is rounding, clamped when the UVs move
+	const float epsilon = 1.0f / 1024.0f;
+	tile = DirectX::XMFLOAT2(std::floor(lowest.x + epsilon), std::floor(lowest.y + epsilon));
+	return highest.x <= tile.x + 1.0f + epsilon && highest.y <= tile.y + 1.0f + epsilon;
+}
+
+std::vector<std::string> MeshCooker::FindAtlasMaps(const MeshData& data)
+{
+	std::vector<unsigned char> inRange(data.Materials.size(), 1);
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		DirectX::XMFLOAT2 tile;
+		if (submesh.Material >= 0 && size_t(submesh.Material) < data.Materials.size()
+			&& !FindUvTile(data.Vertices.data() + submesh.FirstVertex, submesh.VertexCount, tile))
+			inRange[submesh.Material] = 0;
+	}
+
+	// A map goes in only if every material sampling it can take the move
+	std::vector<std::string> maps;
+	std::unordered_set<std::string> rejected;
+	for (size_t m = 0; m != data.Materials.size(); ++m)
+	{
+		const MtlMaterial& material = data.Materials[m];
+		if (material.DiffuseMap.empty()) continue;
+		if (!inRange[m] || !material.NormalMap.empty())
+			rejected.insert(material.DiffuseMap);
+		else if (std::find(maps.begin(), maps.end(), material.DiffuseMap) == maps.end())
+			maps.push_back(material.DiffuseMap);
+	}
+	for (const MtlMaterial& material : data.Materials)
+		if (!material.NormalMap.empty()) rejected.insert(material.NormalMap);
+	maps.erase(std::remove_if(maps.begin(), maps.end(), [&](const std::string& map) { return rejected.count(map) != 0; }), maps.end());
+	return maps;
+}
+
+void MeshCooker::PackAtlases(MeshData& data, const std::vector<std::string>& maps, const std::vector<AtlasBitmap>& images,
+	const std::string& atlasPrefix, const AtlasSettings& settings, std::vector<AtlasBitmap>& atlases, AtlasStats& stats)
+{
+	// Images that failed to decode are empty and stay out
+	std::vector<AtlasImage> placements(images.size());
+	for (size_t i = 0; i != images.size(); ++i)
+		placements[i] = { images[i].Pixels.empty() ? 0 : images[i].Width, images[i].Pixels.empty() ? 0 : images[i].Height, -1, 0, 0 };
+	std::vector<AtlasPage> pages;
+	if (!TextureAtlas::Pack(placements, settings, pages)) return;
+
+	const size_t firstAtlas = atlases.size();
+	for (const AtlasPage& page : pages)
+	{
+		atlases.push_back({ page.Width, page.Height, std::vector<uint8_t>(size_t(page.Width) * page.Height * 4) });
+		stats.AtlasTexels += size_t(page.Width) * page.Height;
+		stats.ImageTexels += page.ImageTexels;
+	}
+	stats.Atlases += pages.size();
+
+	std::unordered_map<std::string, size_t> packed;
+	for (size_t i = 0; i != placements.size(); ++i)
+	{
+		const AtlasImage& image = placements[i];
+		if (image.Atlas < 0) continue;
+		AtlasBitmap& atlas = atlases[firstAtlas + image.Atlas];
+		TextureAtlas::Blit(images[i].Pixels.data(), image, settings.Padding, atlas.Pixels.data(), atlas.Width);
+		packed.emplace(maps[i], i);
+		++stats.ImagesPacked;
+	}
+
+	// Every submesh has vertices of its own, so each is moved once
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		if (submesh.Material < 0 || size_t(submesh.Material) >= data.Materials.size()) continue;
+		const auto found = packed.find(data.Materials[submesh.Material].DiffuseMap);
+		if (found == packed.end()) continue;
+		const AtlasImage& image = placements[found->second];
+		const AtlasPage& page = pages[image.Atlas];
+		DirectX::XMFLOAT2 tile;
+		FindUvTile(data.Vertices.data() + submesh.FirstVertex, submesh.VertexCount, tile);
+		for (uint32_t v = submesh.FirstVertex; v != submesh.FirstVertex + submesh.VertexCount; ++v)
+		{
+			DirectX::XMFLOAT2& uv = data.Vertices[v].UV;
+			const DirectX::XMFLOAT2 clamped(std::min(std::max(uv.x - tile.x, 0.0f), 1.0f), std::min(std::max(uv.y - tile.y, 0.0f), 1.0f));
+			uv = TextureAtlas::MapUv(clamped, image, page);
+		}
+	}
+
+	for (MtlMaterial& material : data.Materials)
+	{
+		const auto found = packed.find(material.DiffuseMap);
+		if (found != packed.end())
+			material.DiffuseMap = atlasPrefix + std::to_string(firstAtlas + placements[found->second].Atlas) + ".png";
+	}
+}
+
+AtlasStats MeshCooker::CookAtlases(MeshData& data, const std::string& filename, const AtlasSettings& settings)
+{
+	AtlasStats stats = {};
+	CountDraws(data, stats.DrawsBefore, stats.BindsBefore, stats.TexturesBefore);
+
+	const std::string folder = GetFolder(filename);
+	const std::vector<std::string> maps = FindAtlasMaps(data);
+	std::vector<AtlasBitmap> images(maps.size());
+	ImageDecoder decoder;
+	for (size_t i = 0; i != maps.size() && maps.size() > 1; ++i)
+	{
+		VirtualFile file;
+		UINT width = 0;
+		UINT height = 0;
+		if (!VirtualFile::Exists(folder + maps[i]) || !file.Open(folder + maps[i])
+			|| !decoder.Decode(file.GetData(), file.GetSize(), images[i].Pixels, width, height))
+		{
+			images[i].Pixels.clear();
+			continue;
+		}
+		images[i].Width = width;
+		images[i].Height = height;
+	}
+
+	// "<model>.atlasN.png" with the DDS TextureManager looks for next to it, under the key it would cook it with
+	std::vector<AtlasBitmap> atlases;
+	PackAtlases(data, maps, images, filename.substr(folder.size()) + ".atlas", settings, atlases, stats);
+	for (size_t a = 0; a != atlases.size(); ++a)
+	{
+		const AtlasBitmap& atlas = atlases[a];
+		const std::string atlasFilename = filename + ".atlas" + std::to_string(a) + ".png";
+		std::vector<uint8_t> png;
+		TextureAtlas::EncodePng(atlas.Pixels.data(), atlas.Width, atlas.Height, png);
+		std::vector<uint8_t> dds;
+		if (!TextureCooker::Write(atlasFilename, png))
+			LOG_WARNING << "Failed to write texture atlas \"" << atlasFilename << "\"." << std::endl;
+		else if (!TextureCooker::Cook(atlas.Pixels.data(), atlas.Width, atlas.Height, TextureColor,
+			HashData(png.data(), png.size(), uint64_t(TextureColor)), dds) || !TextureCooker::Write(atlasFilename + ".dds", dds))
+			LOG_WARNING << "Failed to cook texture atlas \"" << atlasFilename << "\", it is cooked when loaded." << std::endl;
+	}
+
+	MergeSubmeshes(data);
+	CountDraws(data, stats.DrawsAfter, stats.BindsAfter, stats.TexturesAfter);
+	if (stats.Atlases != 0)
+		LOG_INFO << "Packed " << stats.ImagesPacked << " maps into " << stats.Atlases << " atlases, "
+			<< 100.0 * stats.ImageTexels / stats.AtlasTexels << "% occupied." << std::endl;
+	LOG_INFO << "Atlases and merging: " << stats.DrawsBefore << " -> " << stats.DrawsAfter << " draws, " << stats.BindsBefore << " -> "
+		<< stats.BindsAfter << " texture binds, " << stats.TexturesBefore << " -> " << stats.TexturesAfter << " textures." << std::endl;
+	return stats;
+}
+
+void MeshCooker::CountDraws(const MeshData& data, size_t& draws, size_t& binds, size_t& textures)
+{
+	std::unordered_set<std::string> maps;
+	draws = data.Submeshes.size();
+	binds = 0;
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		if (submesh.Material < 0 || size_t(submesh.Material) >= data.Materials.size()) continue;
+		const MtlMaterial& material = data.Materials[submesh.Material];
+		for (const std::string* map : { &material.DiffuseMap, &material.NormalMap })
+		{
+			if (map->empty()) continue;
+			++binds;
+			maps.insert(*map);
+		}
+	}
+	textures = maps.size();
+}
+
+void MeshCooker::MergeSubmeshes(MeshData& data)
+{
+	// Submeshes in the order of the first of each group, the others after it, as long as the group keeps 16 bit indices
+	std::vector<std::vector<size_t>> groups;
+	std::vector<uint32_t> groupVertices;
+	for (size_t s = 0; s != data.Submeshes.size(); ++s)
+	{
+		const SubmeshRange& submesh = data.Submeshes[s];
+		size_t g = 0;
+		for (; g != groups.size(); ++g)
+		{
+			const int32_t a = data.Submeshes[groups[g].front()].Material;
+			const int32_t b = submesh.Material;
+			const bool same = a == b || (a >= 0 && b >= 0 && SameSurface(data.Materials[a], data.Materials[b]));
+			if (same && VertexPacker::CanUse16BitIndices(groupVertices[g] + submesh.VertexCount)) break;
+		}
+		if (g == groups.size())
+		{
+			groups.emplace_back();
+			groupVertices.push_back(0);
+		}
+		groups[g].push_back(s);
+		groupVertices[g] += submesh.VertexCount;
+	}
+	if (groups.size() == data.Submeshes.size()) return;
+
+	// Materials that are still used, in their old order
+	std::vector<int32_t> remap(data.Materials.size(), -1);
+	for (const std::vector<size_t>& group : groups)
+	{
+		const int32_t material = data.Submeshes[group.front()].Material;
+		if (material >= 0) remap[material] = 0;
+	}
+	std::vector<MtlMaterial> materials;
+	for (size_t m = 0; m != data.Materials.size(); ++m)
+	{
+		if (remap[m] < 0) continue;
+		remap[m] = int32_t(materials.size());
+		materials.push_back(data.Materials[m]);
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<int> indices;
+	std::vector<SubmeshRange> submeshes;
+	vertices.reserve(data.Vertices.size());
+	indices.reserve(data.Indices.size());
+	for (const std::vector<size_t>& group : groups)
+	{
+		SubmeshRange merged{};
+		merged.FirstVertex = uint32_t(vertices.size());
+		merged.FirstIndex = uint32_t(indices.size());
+		const int32_t material = data.Submeshes[group.front()].Material;
+		merged.Material = material >= 0 ? remap[material] : -1;
+		for (size_t s : group)
+		{
+			const SubmeshRange& submesh = data.Submeshes[s];
+			const int offset = int(vertices.size()) - int(merged.FirstVertex);
+			vertices.insert(vertices.end(), data.Vertices.begin() + submesh.FirstVertex, data.Vertices.begin() + submesh.FirstVertex + submesh.VertexCount);
+			for (uint32_t i = submesh.FirstIndex; i != submesh.FirstIndex + submesh.IndexCount; ++i)
+				indices.push_back(data.Indices[i] + offset);
+		}
+		merged.VertexCount = uint32_t(vertices.size()) - merged.FirstVertex;
+		merged.IndexCount = uint32_t(indices.size()) - merged.FirstIndex;
+		ComputeBoundingBox(vertices.data() + merged.FirstVertex, merged.VertexCount, merged.BoundingBoxCenter, merged.BoundingBoxExtents);
+		submeshes.push_back(merged);
+	}
+
+	LOG_INFO << "Merged " << data.Submeshes.size() << " submeshes into " << submeshes.size() << "." << std::endl;
+	data.Vertices.swap(vertices);
+	data.Indices.swap(indices);
+	data.Submeshes.swap(submeshes);
+	data.Materials.swap(materials);
+}
+
+void MeshCooker::OptimizeSubmeshes(MeshData& data)
+{
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		Vertex* vertexBuffer = data.Vertices.data() + submesh.FirstVertex;
+		int* indexBuffer = data.Indices.data() + submesh.FirstIndex;
+
+		const VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(indexBuffer, submesh.IndexCount, submesh.VertexCount);
+		MeshOptimizer::Optimize(vertexBuffer, submesh.VertexCount, indexBuffer, submesh.IndexCount);
+		const VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(indexBuffer, submesh.IndexCount, submesh.VertexCount);
+
+		LOG_INFO << "Optimized submesh: ACMR " << before.Acmr << " -> " << after.Acmr
+			<< ", ATVR " << before.Atvr << " -> " << after.Atvr << "." << std::endl;
+	}
+}
+
+void MeshCooker::GenerateNormals(MeshData& data)
+{
+	const auto missing = [](const Vertex& vertex) { return vertex.Normal.x == 0.0f && vertex.Normal.y == 0.0f && vertex.Normal.z == 0.0f; };
+
+	// Area weighted face normals summed per position, across submeshes so shared edges stay smooth
+	std::unordered_map<DirectX::XMFLOAT3, DirectX::XMVECTOR, PositionHash, PositionEqual> sums;
+	for (const SubmeshRange& submesh : data.Submeshes)
+	{
+		const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+		const int* indices = data.Indices.data() + submesh.FirstIndex;
+		for (uint32_t i = 0; i + 2 < submesh.IndexCount; i += 3)
+		{
+			const Vertex& v0 = vertices[indices[i]];
+			const Vertex& v1 = vertices[indices[i + 1]];
+			const Vertex& v2 = vertices[indices[i + 2]];
+			if (!missing(v0) || !missing(v1) || !missing(v2)) continue;
+
+			const DirectX::XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+			const DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(XMLoadFloat3(&v1.Position), p0),
+				DirectX::XMVectorSubtract(XMLoadFloat3(&v2.Position), p0));
+			for (const Vertex* v : { &v0, &v1, &v2 })
+			{
+				DirectX::XMVECTOR& sum = sums.emplace(v->Position, DirectX::XMVectorZero()).first->second;
+				sum = DirectX::XMVectorAdd(sum, normal);
+			}
+		}
+	}
+	if (sums.empty()) return;
+
+	for (Vertex& vertex : data.Vertices)
+	{
+		const auto sum = sums.find(vertex.Position);
+		if (missing(vertex) && sum != sums.end())
+			XMStoreFloat3(&vertex.Normal, DirectX::XMVector3Normalize(sum->second));
+	}
+	LOG_INFO << "Generated normals for " << sums.size() << " positions." << std::endl;
+}
+
+void MeshCooker::GenerateTangents(MeshData& data, unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = unsigned(std::min(size_t(threadCount), data.Submeshes.size()));
+
+	// Submeshes are independent, threads take the next one until none are left
+	std::vector<std::vector<Vertex>> vertices(data.Submeshes.size());
+	std::atomic<size_t> next(0);
+	const auto work = [&data, &vertices, &next]()
+	{
+		std::vector<int> indices;
+		for (size_t m = next++; m < data.Submeshes.size(); m = next++)
+		{
+			const SubmeshRange& submesh = data.Submeshes[m];
+			int* submeshIndices = data.Indices.data() + submesh.FirstIndex;
+			TangentGenerator::Generate(data.Vertices.data() + submesh.FirstVertex, submesh.VertexCount,
+				submeshIndices, submesh.IndexCount, vertices[m], indices);
+			std::copy(indices.begin(), indices.end(), submeshIndices);
+		}
+	};
+	{
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < threadCount; ++t)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	// Split vertices are appended to their submesh, the ones before keep their place
+	data.Vertices.clear();
+	for (size_t m = 0; m != data.Submeshes.size(); ++m)
+	{
+		data.Submeshes[m].FirstVertex = uint32_t(data.Vertices.size());
+		data.Submeshes[m].VertexCount = uint32_t(vertices[m].size());
+		data.Vertices.insert(data.Vertices.end(), vertices[m].begin(), vertices[m].end());
+	}
+}
+
+void MeshCooker::GenerateLods(MeshData& data, const LodChainSettings& lodChain, bool optimize, const std::vector<unsigned char>* locked)
+{
+	// Drop any previous chain, the full detail indices come first in data.Indices
+	size_t fullIndexCount = 0;
+	for (const SubmeshRange& submesh : data.Submeshes)
+		fullIndexCount = std::max(fullIndexCount, size_t(submesh.FirstIndex) + submesh.IndexCount);
+	data.Indices.resize(fullIndexCount);
+	data.Lods.clear();
+
+	std::vector<unsigned char> shared;
+	if (!locked)
+	{
+		shared = FindSharedVertices(data);
+		locked = &shared;
+	}
+
+	std::vector<int> source;
+	std::vector<int> simplified;
+	for (SubmeshRange& submesh : data.Submeshes)
+	{
+		submesh.FirstLod = uint32_t(data.Lods.size());
+		data.Lods.push_back({ submesh.FirstIndex, submesh.IndexCount, 0.0f });
+
+		const Vertex* vertices = data.Vertices.data() + submesh.FirstVertex;
+		source.assign(data.Indices.begin() + submesh.FirstIndex, data.Indices.begin() + submesh.FirstIndex + submesh.IndexCount);
+		simplified.resize(source.size());
+
+		const DirectX::XMVECTOR extents = XMLoadFloat3(&submesh.BoundingBoxExtents);
+		const float maxError = lodChain.MaxError * DirectX::XMVectorGetX(DirectX::XMVector3Length(extents));
+
+		// Every level is simplified from the full detail indices so the errors do not add up
+		size_t previousCount = source.size();
+		for (unsigned level = 1; level < lodChain.MaxLevels; ++level)
+		{
+			const size_t target = size_t(float(previousCount / 3) * lodChain.Reduction) * 3;
+			float error = 0.0f;
+			const size_t count = MeshSimplifier::Simplify(simplified.data(), source.data(), source.size(), vertices, submesh.VertexCount,
+				target, maxError, locked->data() + submesh.FirstVertex, &error);
+
+			// Stop once a level saves less than a quarter of the triangles of the one before
+			if (count == 0 || count * 4 > previousCount * 3) break;
+
+			if (optimize)
+				MeshOptimizer::OptimizeVertexCache(simplified.data(), count, submesh.VertexCount);
+
+			data.Lods.push_back({ uint32_t(data.Indices.size()), uint32_t(count), error });
+			data.Indices.insert(data.Indices.end(), simplified.begin(), simplified.begin() + count);
+			previousCount = count;
+		}
+		submesh.LodCount = uint32_t(data.Lods.size()) - submesh.FirstLod;
+	}
+}
+
+void MeshCooker::GenerateClusters(MeshData& data)
+{
+	data.Clusters.clear();
+	for (SubmeshRange& submesh : data.Submeshes)
+	{
+		submesh.FirstCluster = uint32_t(data.Clusters.size());
+		MeshClusterizer::Build(data.Indices.data() + submesh.FirstIndex, submesh.IndexCount, data.Vertices.data() + submesh.FirstVertex,
+			submesh.VertexCount, submesh.FirstIndex, data.Clusters);
+		submesh.ClusterCount = uint32_t(data.Clusters.size()) - submesh.FirstCluster;
+	}
+}
+
+void MeshCooker::ComputeBoundingBox(const Vertex* vertices, size_t verticesCount, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents)
+{
+	// Calculate Bounding Box out of vertices
+	DirectX::XMFLOAT3 lower = { FLT_MAX , FLT_MAX , FLT_MAX };
+	DirectX::XMFLOAT3 upper = { -FLT_MAX , -FLT_MAX , -FLT_MAX };
+
+	for (size_t i = 0; i < verticesCount; ++i)
+	{
+		if (lower.x > vertices[i].Position.x)
+			lower.x = vertices[i].Position.x;
+		if (lower.y > vertices[i].Position.y)
+			lower.y = vertices[i].Position.y;
+		if (lower.z > vertices[i].Position.z)
+			lower.z = vertices[i].Position.z;
+		if (upper.x < vertices[i].Position.x)
+			upper.x = vertices[i].Position.x;
+		if (upper.y < vertices[i].Position.y)
+			upper.y = vertices[i].Position.y;
+		if (upper.z < vertices[i].Position.z)
+			upper.z = vertices[i].Position.z;
+	}
+
+	const DirectX::XMFLOAT3 half((upper.x - lower.x) * 0.5f,
+		(upper.y - lower.y) * 0.5f,
+		(upper.z - lower.z) * 0.5f);
+
+	center.x = lower.x + half.x;
+	center.y = lower.y + half.y;
+	center.z = lower.z + half.z;
+
+	extents = half;
+}
+
+float MeshCooker::ComputeUvDensity(const Vertex* vertices, const int* indices, size_t indexCount)
+{
+	return ComputeUvDensityOf(vertices, indices, indexCount);
+}
+
+float MeshCooker::ComputeUvDensity(const Vertex* vertices, const uint16_t* indices, size_t indexCount)
+{
+	return ComputeUvDensityOf(vertices, indices, indexCount);
+}
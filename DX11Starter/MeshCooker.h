@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "CookedMesh.h"
+#include "TextureAtlas.h"
+
+// Level of detail chain built for every submesh
+struct LodChainSettings
+{
+	// Levels including the full detail one, 1 turns simplification off
+	unsigned MaxLevels;
+	// Target triangle count of every level relative to the one before it
+	float Reduction;
+	// Largest allowed simplification error relative to the bounding radius of the submesh
+	float MaxError;
+};
+
+// Turns source models into MeshData. Runs on the CPU only, no device needed.
+class MeshCooker
+{
+public:
+	// Changing these needs a CookedMesh::Version bump to recook existing files
+	static LodChainSettings DefaultLodChain() { return { 5, 0.5f, 0.1f }; }
+	static AtlasSettings DefaultAtlas() { return { 256, 2048, 8 }; }
+
+	// Parse an OBJ and its MTL into welded submeshes with generated normals and tangents.
+	// With optimize set, index and vertex order of every submesh go through MeshOptimizer.
+	// Small maps are packed into atlases next to the OBJ and submeshes that then share a material merged, unless
+	// atlas.MaxImageSize is 0.
+	static bool CookObj(const std::string& filename, MeshData& data, bool optimize = true, const LodChainSettings& lodChain = DefaultLodChain(),
+		const AtlasSettings& atlas = DefaultAtlas());
+
+	// Parse the MTL named by an OBJ's mtllib, relative to folder. Nothing happens when mtlLib is empty or missing.
+	static void LoadMaterials(const std::string& folder, const std::string& mtlLib, std::vector<MtlMaterial>& materials);
+	// Index of the material a usemtl names, -1 if there is none
+	static int32_t FindMaterial(const std::vector<MtlMaterial>& materials, const std::string& name);
+	// Weld the faces of a group into a new submesh of data, with zero normals where faces have none and no tangents yet
+	static void WeldGroup(const ObjData& obj, const ObjGroup& group, int32_t material, MeshData& data);
+
+	// The whole tile of UV space a submesh's vertices keep inside, which samples the same as [0, 1] since materials
+	// wrap. False when they cross into another, the texture repeats over them.
+	static bool FindUvTile(const Vertex* vertices, size_t vertexCount, DirectX::XMFLOAT2& tile);
+	// Maps that can go into an atlas: diffuse maps of materials without a normal map whose submeshes each keep to a
+	// tile, repeating textures cannot share one. Distinct names in the order of the materials.
+	static std::vector<std::string> FindAtlasMaps(const MeshData& data);
+	// Pack the decoded images of maps, as FindAtlasMaps names them, into atlases appended to atlases as images of
+	// their own. Submeshes of materials whose map went into atlas N get their UVs moved from their tile to its place
+	// and the map renamed to atlasPrefix + "N.png". Counts the packing into stats, see CookAtlases for the rest.
+	static void PackAtlases(MeshData& data, const std::vector<std::string>& maps, const std::vector<AtlasBitmap>& images,
+		const std::string& atlasPrefix, const AtlasSettings& settings, std::vector<AtlasBitmap>& atlases, AtlasStats& stats);
+	// Decode what FindAtlasMaps picks, pack it and write the atlases next to the OBJ as "<model>.obj.atlasN.png" with the
+	// DDS TextureManager would cook from them, then MergeSubmeshes. Maps that fail to decode stay as they are.
+	static AtlasStats CookAtlases(MeshData& data, const std::string& filename, const AtlasSettings& settings);
+	// Make submeshes whose materials only differ in name one submesh each, dropping the materials no longer used.
+	// Only before levels of detail and clusters are generated.
+	static void MergeSubmeshes(MeshData& data);
+	// Draws of a model, one per submesh, the texture views they bind between them and the distinct maps
+	static void CountDraws(const MeshData& data, size_t& draws, size_t& binds, size_t& textures);
+
+	// Give vertices with a zero normal the normalized sum of the face normals of triangles without normals around their position
+	static void GenerateNormals(MeshData& data);
+
+	// Replace the tangents of every submesh with MikkTSpace ones, splitting vertices where needed. Indices keep their
+	// place and existing vertices their index, so levels of detail and clusters stay valid.
+	// Submeshes run in parallel on threadCount threads, 0 picks one per core.
+	static void GenerateTangents(MeshData& data, unsigned threadCount = 0);
+
+	// Reorder the indices and vertices of every submesh with MeshOptimizer
+	static void OptimizeSubmeshes(MeshData& data);
+
+	// Replace the levels of detail of every submesh with a chain simplified from its full detail indices.
+	// Vertices flagged in locked are never moved. Without it those are the ones whose position several
+	// submeshes share, material boundaries.
+	static void GenerateLods(MeshData& data, const LodChainSettings& lodChain, bool optimize = true, const std::vector<unsigned char>* locked = nullptr);
+
+	// Replace the clusters of every submesh with ones built from its full detail indices
+	static void GenerateClusters(MeshData& data);
+
+	static void ComputeBoundingBox(const Vertex* vertices, size_t verticesCount, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents);
+	// UV units per object space unit over the triangles, the square root of their area in UV over their area.
+	// 0 if either is 0.
+	static float ComputeUvDensity(const Vertex* vertices, const int* indices, size_t indexCount);
+	static float ComputeUvDensity(const Vertex* vertices, const uint16_t* indices, size_t indexCount);
+};
@@ -0,0 +1,467 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// Triangles using each vertex, stored as one array with per-vertex offsets
+	struct Adjacency
+	{
+		std::vector<unsigned> Counts;
+		std::vector<unsigned> Offsets;
+		std::vector<unsigned> Faces;
+
+		void Build(const int* indices, size_t indexCount, size_t vertexCount)
+		{
+			const size_t faceCount = indexCount / 3;
+
+			Counts.assign(vertexCount, 0);
+			for (size_t i = 0; i != faceCount * 3; ++i)
+				++Counts[indices[i]];
+
+			Offsets.assign(vertexCount + 1, 0);
+			for (size_t v = 0; v != vertexCount; ++v)
+				Offsets[v + 1] = Offsets[v] + Counts[v];
+
+			Faces.resize(faceCount * 3);
+			std::vector<unsigned> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t f = 0; f != faceCount; ++f)
+			{
+				for (unsigned c = 0; c != 3; ++c)
+					Faces[fill[indices[f * 3 + c]]++] = unsigned(f);
+			}
+		}
+	};
+
+	// FIFO cache where a vertex stays resident for cacheSize misses after it was loaded
+	struct CacheSimulator
+	{
+		std::vector<unsigned> LoadTime;
+		unsigned Time;
+		unsigned Size;
+
+		CacheSimulator(size_t vertexCount, unsigned cacheSize)
+			: LoadTime(vertexCount, 0), Time(cacheSize + 1), Size(cacheSize)
+		{
+		}
+
+		bool InCache(int v) const
+		{
+			return Time - LoadTime[v] <= Size;
+		}
+
+		// Returns 1 on a miss
+		unsigned Access(int v)
+		{
+			if (InCache(v)) return 0;
+			LoadTime[v] = Time++;
+			return 1;
+		}
+
+		// Empty the cache
+		void Flush()
+		{
+			Time += Size + 1;
+		}
+	};
+
+	int NextVertex(const std::vector<int>& candidates, std::vector<int>& deadEnd, size_t& cursor,
+		const std::vector<unsigned>& liveCount, const CacheSimulator& cache)
+	{
+		// Prefer the candidate that entered the cache earliest but will still be in it after its fan is emitted
+		int best = -1;
+		int bestPriority = -1;
+		for (int v : candidates)
+		{
+			if (liveCount[v] == 0) continue;
+
+			int priority = 0;
+			const unsigned age = cache.Time - cache.LoadTime[v];
+			if (age + 2 * liveCount[v] <= cache.Size)
+				priority = int(age);
+			if (priority > bestPriority)
+			{
+				best = v;
+				bestPriority = priority;
+			}
+		}
+		if (best >= 0) return best;
+
+		// Dead end, go back to recently used vertices
+		while (!deadEnd.empty())
+		{
+			const int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[v] > 0) return v;
+		}
+
+		// Nothing recent left, continue with the next vertex in input order
+		for (; cursor < liveCount.size(); ++cursor)
+		{
+			if (liveCount[cursor] > 0) return int(cursor);
+		}
+		return -1;
+	}
+
+	DirectX::XMVECTOR FaceCross(const Vertex* vertices, const int* face)
+	{
+		const DirectX::XMVECTOR p0 = XMLoadFloat3(&vertices[face[0]].Position);
+		const DirectX::XMVECTOR p1 = XMLoadFloat3(&vertices[face[1]].Position);
+		const DirectX::XMVECTOR p2 = XMLoadFloat3(&vertices[face[2]].Position);
+		return DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+	}
+}
+
+void MeshOptimizer::Optimize(Vertex* vertices, size_t vertexCount, int* indices, size_t indexCount)
+{
+	// Some exporters already emit a good order, only keep the results that actually are better
+	std::vector<int> previous(indices, indices + indexCount);
+	const VertexCacheStats inputCache = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	if (AnalyzeVertexCache(indices, indexCount, vertexCount).Acmr > inputCache.Acmr)
+		std::copy(previous.begin(), previous.end(), indices);
+
+	const float threshold = 1.05f;
+	previous.assign(indices, indices + indexCount);
+	const float cacheAcmr = AnalyzeVertexCache(indices, indexCount, vertexCount).Acmr;
+	const OverdrawStats inputOverdraw = AnalyzeOverdraw(indices, indexCount, vertices, vertexCount);
+	OptimizeOverdraw(indices, indexCount, vertices, vertexCount, threshold);
+	if (AnalyzeOverdraw(indices, indexCount, vertices, vertexCount).Overdraw >= inputOverdraw.Overdraw ||
+		AnalyzeVertexCache(indices, indexCount, vertexCount).Acmr > cacheAcmr * threshold)
+		std::copy(previous.begin(), previous.end(), indices);
+
+	OptimizeVertexFetch(vertices, vertexCount, indices, indexCount);
+}
+
+void MeshOptimizer::OptimizeVertexCache(int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+	const size_t faceCount = indexCount / 3;
+	if (faceCount == 0) return;
+
+	Adjacency adjacency;
+	adjacency.Build(indices, indexCount, vertexCount);
+	std::vector<unsigned>& liveCount = adjacency.Counts;
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> emitted(faceCount, false);
+	std::vector<int> deadEnd;
+	std::vector<int> candidates;
+	std::vector<int> result;
+	result.reserve(faceCount * 3);
+	deadEnd.reserve(faceCount * 3);
+
+	size_t cursor = 0;
+	int current = indices[0];
+	while (current >= 0)
+	{
+		// Emit the whole fan around the current vertex
+		candidates.clear();
+		for (unsigned a = adjacency.Offsets[current]; a != adjacency.Offsets[current + 1]; ++a)
+		{
+			const unsigned face = adjacency.Faces[a];
+			if (emitted[face]) continue;
+			emitted[face] = true;
+
+			for (unsigned c = 0; c != 3; ++c)
+			{
+				const int v = indices[face * 3 + c];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveCount[v];
+				cache.Access(v);
+			}
+		}
+
+		current = NextVertex(candidates, deadEnd, cursor, liveCount, cache);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold, unsigned cacheSize)
+{
+	const size_t faceCount = indexCount / 3;
+	if (faceCount == 0) return;
+
+	// Hard boundaries: a triangle missing all three vertices starts over anyway
+	std::vector<size_t> hardClusters;
+	{
+		CacheSimulator cache(vertexCount, cacheSize);
+		for (size_t f = 0; f != faceCount; ++f)
+		{
+			unsigned misses = 0;
+			for (unsigned c = 0; c != 3; ++c)
+				misses += cache.Access(indices[f * 3 + c]);
+			if (f == 0 || misses == 3)
+				hardClusters.push_back(f);
+		}
+	}
+	hardClusters.push_back(faceCount);
+
+	// Soft boundaries: split further wherever the running ACMR is already within threshold of the cluster's
+	std::vector<size_t> clusters;
+	{
+		CacheSimulator cache(vertexCount, cacheSize);
+		for (size_t h = 0; h + 1 < hardClusters.size(); ++h)
+		{
+			const size_t begin = hardClusters[h];
+			const size_t end = hardClusters[h + 1];
+
+			cache.Flush();
+			unsigned clusterMisses = 0;
+			for (size_t i = begin * 3; i != end * 3; ++i)
+				clusterMisses += cache.Access(indices[i]);
+			const float target = float(clusterMisses) / float(end - begin) * threshold;
+
+			cache.Flush();
+			clusters.push_back(begin);
+			unsigned misses = 0;
+			size_t start = begin;
+			for (size_t f = begin; f != end; ++f)
+			{
+				for (unsigned c = 0; c != 3; ++c)
+					misses += cache.Access(indices[f * 3 + c]);
+
+				if (f + 1 != end && float(misses) / float(f + 1 - start) <= target)
+				{
+					clusters.push_back(f + 1);
+					cache.Flush();
+					misses = 0;
+					start = f + 1;
+				}
+			}
+		}
+	}
+	clusters.push_back(faceCount);
+
+	// Mesh centroid
+	DirectX::XMVECTOR meshCentroid = DirectX::XMVectorZero();
+	for (size_t v = 0; v != vertexCount; ++v)
+		meshCentroid = DirectX::XMVectorAdd(meshCentroid, XMLoadFloat3(&vertices[v].Position));
+	if (vertexCount)
+		meshCentroid = DirectX::XMVectorScale(meshCentroid, 1.0f / float(vertexCount));
+
+	// Clusters facing away from the center are likely to occlude the rest, draw them first
+	const size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c != clusterCount; ++c)
+	{
+		DirectX::XMVECTOR centroid = DirectX::XMVectorZero();
+		DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+		float area = 0.0f;
+		for (size_t f = clusters[c]; f != clusters[c + 1]; ++f)
+		{
+			const int* face = indices + f * 3;
+			const DirectX::XMVECTOR cross = FaceCross(vertices, face);
+			const float faceArea = DirectX::XMVectorGetX(DirectX::XMVector3Length(cross));
+
+			DirectX::XMVECTOR faceCenter = DirectX::XMVectorAdd(XMLoadFloat3(&vertices[face[0]].Position), XMLoadFloat3(&vertices[face[1]].Position));
+			faceCenter = DirectX::XMVectorAdd(faceCenter, XMLoadFloat3(&vertices[face[2]].Position));
+			centroid = DirectX::XMVectorAdd(centroid, DirectX::XMVectorScale(faceCenter, faceArea / 3.0f));
+			normal = DirectX::XMVectorAdd(normal, cross);
+			area += faceArea;
+		}
+
+		if (area > 0.0f)
+			centroid = DirectX::XMVectorScale(centroid, 1.0f / area);
+		normal = DirectX::XMVector3Normalize(normal);
+		sortKeys[c] = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorSubtract(centroid, meshCentroid), normal));
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c != clusterCount; ++c) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<int> result;
+	result.reserve(faceCount * 3);
+	for (size_t c : order)
+		result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, size_t vertexCount, int* indices, size_t indexCount)
+{
+	std::vector<int> remap(vertexCount, -1);
+	int next = 0;
+	for (size_t i = 0; i != indexCount; ++i)
+	{
+		int& target = remap[indices[i]];
+		if (target < 0) target = next++;
+		indices[i] = target;
+	}
+
+	const size_t used = size_t(next);
+	for (size_t v = 0; v != vertexCount; ++v)
+	{
+		if (remap[v] < 0) remap[v] = next++;
+	}
+
+	std::vector<Vertex> reordered(vertexCount);
+	for (size_t v = 0; v != vertexCount; ++v)
+		reordered[remap[v]] = vertices[v];
+	std::copy(reordered.begin(), reordered.end(), vertices);
+
+	return used;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+	VertexCacheStats stats{};
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t uniqueVertices = 0;
+	for (size_t i = 0; i != indexCount; ++i)
+	{
+		stats.VerticesTransformed += cache.Access(indices[i]);
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			++uniqueVertices;
+		}
+	}
+
+	if (indexCount >= 3)
+		stats.Acmr = float(stats.VerticesTransformed) / float(indexCount / 3);
+	if (uniqueVertices)
+		stats.Atvr = float(stats.VerticesTransformed) / float(uniqueVertices);
+	return stats;
+}
+
+VertexFetchStats MeshOptimizer::AnalyzeVertexFetch(const int* indices, size_t indexCount, size_t vertexCount, size_t vertexSize)
+{
+	const size_t lineSize = 64;
+	const unsigned cacheLines = 256;
+
+	VertexFetchStats stats{};
+
+	// Lines stay resident for cacheLines misses, like the vertex cache above
+	std::unordered_map<size_t, unsigned> loadTime;
+	unsigned time = cacheLines + 1;
+	std::vector<bool> referenced(vertexCount, false);
+	size_t uniqueVertices = 0;
+	for (size_t i = 0; i != indexCount; ++i)
+	{
+		const size_t v = size_t(indices[i]);
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			++uniqueVertices;
+		}
+
+		const size_t firstLine = v * vertexSize / lineSize;
+		const size_t lastLine = ((v + 1) * vertexSize - 1) / lineSize;
+		for (size_t line = firstLine; line <= lastLine; ++line)
+		{
+			unsigned& loaded = loadTime[line];
+			if (loaded == 0 || time - loaded > cacheLines)
+			{
+				loaded = time++;
+				stats.BytesFetched += lineSize;
+			}
+		}
+	}
+
+	if (uniqueVertices)
+		stats.Overfetch = float(stats.BytesFetched) / float(uniqueVertices * vertexSize);
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::AnalyzeOverdraw(const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+{
+	const int gridSize = 256;
+
+	OverdrawStats stats{};
+	if (vertexCount == 0 || indexCount < 3) return stats;
+
+	DirectX::XMFLOAT3 lower = { FLT_MAX, FLT_MAX, FLT_MAX };
+	DirectX::XMFLOAT3 upper = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v != vertexCount; ++v)
+	{
+		const DirectX::XMFLOAT3& p = vertices[v].Position;
+		lower = DirectX::XMFLOAT3(std::min(lower.x, p.x), std::min(lower.y, p.y), std::min(lower.z, p.z));
+		upper = DirectX::XMFLOAT3(std::max(upper.x, p.x), std::max(upper.y, p.y), std::max(upper.z, p.z));
+	}
+	const DirectX::XMFLOAT3 center((lower.x + upper.x) * 0.5f, (lower.y + upper.y) * 0.5f, (lower.z + upper.z) * 0.5f);
+	const float extent = std::max(std::max(upper.x - lower.x, upper.y - lower.y), std::max(upper.z - lower.z, FLT_MIN));
+	const float scale = float(gridSize) / extent;
+
+	// Right, up and forward of each view, all with the handedness of the mesh
+	// so clockwise (front facing in D3D) stays clockwise on screen
+	const DirectX::XMFLOAT3 views[6][3] =
+	{
+		{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+		{ { -1, 0, 0 }, { 0, 1, 0 }, { 0, 0, -1 } },
+		{ { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+		{ { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+	};
+
+	std::vector<DirectX::XMFLOAT3> projected(vertexCount);
+	std::vector<float> depth(gridSize * gridSize);
+	for (const auto& view : views)
+	{
+		for (size_t v = 0; v != vertexCount; ++v)
+		{
+			const DirectX::XMFLOAT3& p = vertices[v].Position;
+			const DirectX::XMFLOAT3 d(p.x - center.x, p.y - center.y, p.z - center.z);
+			projected[v].x = (d.x * view[0].x + d.y * view[0].y + d.z * view[0].z) * scale + gridSize * 0.5f;
+			projected[v].y = (d.x * view[1].x + d.y * view[1].y + d.z * view[1].z) * scale + gridSize * 0.5f;
+			projected[v].z = d.x * view[2].x + d.y * view[2].y + d.z * view[2].z;
+		}
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+		for (size_t f = 0; f + 2 < indexCount; f += 3)
+		{
+			const DirectX::XMFLOAT3& a = projected[indices[f]];
+			const DirectX::XMFLOAT3& b = projected[indices[f + 1]];
+			const DirectX::XMFLOAT3& c = projected[indices[f + 2]];
+
+			// Back face culling, front faces are clockwise with y up
+			const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+			if (area >= 0.0f) continue;
+
+			const int minX = std::max(0, int(std::min(std::min(a.x, b.x), c.x)));
+			const int maxX = std::min(gridSize - 1, int(std::max(std::max(a.x, b.x), c.x)));
+			const int minY = std::max(0, int(std::min(std::min(a.y, b.y), c.y)));
+			const int maxY = std::min(gridSize - 1, int(std::max(std::max(a.y, b.y), c.y)));
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				const float py = float(y) + 0.5f;
+				for (int x = minX; x <= maxX; ++x)
+				{
+					const float px = float(x) + 0.5f;
+
+					// Edge functions, all negative inside a clockwise triangle
+					const float w0 = (c.x - b.x) * (py - b.y) - (px - b.x) * (c.y - b.y);
+					const float w1 = (a.x - c.x) * (py - c.y) - (px - c.x) * (a.y - c.y);
+					const float w2 = (b.x - a.x) * (py - a.y) - (px - a.x) * (b.y - a.y);
+					if (w0 > 0.0f || w1 > 0.0f || w2 > 0.0f) continue;
+
+					const float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+					float& stored = depth[y * gridSize + x];
+					if (z < stored)
+					{
+						stored = z;
+						++stats.PixelsShaded;
+					}
+				}
+			}
+		}
+
+		for (float z : depth)
+		{
+			if (z != FLT_MAX) ++stats.PixelsCovered;
+		}
+	}
+
+	if (stats.PixelsCovered)
+		stats.Overdraw = float(stats.PixelsShaded) / float(stats.PixelsCovered);
+	return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include "Vertex.h"
+
+struct VertexCacheStats
+{
+	size_t VerticesTransformed;
+	// Average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for large grids, 3 is worst
+	float Acmr;
+	// Average transform to vertex ratio: transformed vertices per unique vertex, 1 is ideal
+	float Atvr;
+};
+
+struct VertexFetchStats
+{
+	size_t BytesFetched;
+	// Bytes fetched from memory per byte of referenced vertex data, 1 is ideal
+	float Overfetch;
+};
+
+struct OverdrawStats
+{
+	size_t PixelsCovered;
+	size_t PixelsShaded;
+	// Shaded per covered pixel, 1 is ideal
+	float Overdraw;
+};
+
+// Index and vertex order optimization for the GPU's post-transform cache, early-z and vertex fetch.
+// Everything runs on the CPU and only needs DirectXMath, so it works without a device.
+// Triangles keep their winding; only their order and the vertex order change.
+class MeshOptimizer
+{
+public:
+	// Post-transform cache size assumed by the optimizer and the analyzer
+	static const unsigned CacheSize = 16;
+
+	// Run all three passes in the recommended order. The cache and overdraw passes are
+	// checked with the analyzers and undone if they made things worse.
+	static void Optimize(Vertex* vertices, size_t vertexCount, int* indices, size_t indexCount);
+
+	// Tipsify (Sander et al. 2007) triangle reordering
+	static void OptimizeVertexCache(int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = CacheSize);
+	// Split the cache optimized order into clusters and draw outward facing clusters first.
+	// A threshold of 1.05 allows the ACMR to get 5% worse.
+	static void OptimizeOverdraw(int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		float threshold = 1.05f, unsigned cacheSize = CacheSize);
+	// Reorder vertices by first use and remap the indices. Returns the number of referenced vertices,
+	// unreferenced ones are moved to the end.
+	static size_t OptimizeVertexFetch(Vertex* vertices, size_t vertexCount, int* indices, size_t indexCount);
+
+	// FIFO post-transform cache simulation
+	static VertexCacheStats AnalyzeVertexCache(const int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = CacheSize);
+	// 64 byte cache line simulation of vertex buffer reads
+	static VertexFetchStats AnalyzeVertexFetch(const int* indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
+	// Software rasterization with back-face culling from the six axis directions
+	static OverdrawStats AnalyzeOverdraw(const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount);
+};
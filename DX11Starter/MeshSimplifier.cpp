@@ -0,0 +1,457 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	const unsigned NoVertex = ~0u;
+
+	// Open borders and seams are weighted up so they stay where they are
+	const double BorderWeight = 10.0;
+
+	enum VertexKind
+	{
+		// Inside a closed surface, can collapse into any neighbor
+		VertexKindManifold,
+		// On an open border, can only collapse along it
+		VertexKindBorder,
+		// On a UV seam (two vertices at one position), both collapse along the seam together
+		VertexKindSeam,
+		// Everything else, never collapses
+		VertexKindLocked
+	};
+
+	// Symmetric 4x4 matrix of the squared distance to a set of planes, weighted by area
+	struct Quadric
+	{
+		double A00, A11, A22, A01, A02, A12;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+
+		void AddPlane(double nx, double ny, double nz, double d, double weight)
+		{
+			A00 += weight * nx * nx;
+			A11 += weight * ny * ny;
+			A22 += weight * nz * nz;
+			A01 += weight * nx * ny;
+			A02 += weight * nx * nz;
+			A12 += weight * ny * nz;
+			B0 += weight * nx * d;
+			B1 += weight * ny * d;
+			B2 += weight * nz * d;
+			C += weight * d * d;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00; A11 += q.A11; A22 += q.A22;
+			A01 += q.A01; A02 += q.A02; A12 += q.A12;
+			B0 += q.B0; B1 += q.B1; B2 += q.B2;
+			C += q.C;
+			Weight += q.Weight;
+		}
+
+		// Weighted mean of the squared distances to the planes
+		double Error(const DirectX::XMFLOAT3& p) const
+		{
+			if (Weight <= 0.0) return 0.0;
+			const double x = p.x, y = p.y, z = p.z;
+			const double r = A00 * x * x + A11 * y * y + A22 * z * z + 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z)
+				+ 2.0 * (B0 * x + B1 * y + B2 * z) + C;
+			return std::abs(r) / Weight;
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned V0;
+		unsigned V1;
+		float Error;
+	};
+
+	// Outgoing half-edges of every vertex, or the triangles around every position
+	struct Adjacency
+	{
+		std::vector<unsigned> Offsets;
+		std::vector<unsigned> Data;
+
+		unsigned Begin(unsigned v) const { return Offsets[v]; }
+		unsigned End(unsigned v) const { return Offsets[v + 1]; }
+
+		void BuildEdges(const std::vector<unsigned>& indices, size_t vertexCount)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			for (unsigned v : indices)
+				++Offsets[v + 1];
+			for (size_t v = 0; v != vertexCount; ++v)
+				Offsets[v + 1] += Offsets[v];
+
+			Data.resize(indices.size());
+			std::vector<unsigned> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i != indices.size(); i += 3)
+			{
+				Data[fill[indices[i + 0]]++] = indices[i + 1];
+				Data[fill[indices[i + 1]]++] = indices[i + 2];
+				Data[fill[indices[i + 2]]++] = indices[i + 0];
+			}
+		}
+
+		void BuildTriangles(const std::vector<unsigned>& indices, const std::vector<unsigned>& remap)
+		{
+			Offsets.assign(remap.size() + 1, 0);
+			for (unsigned v : indices)
+				++Offsets[remap[v] + 1];
+			for (size_t v = 0; v != remap.size(); ++v)
+				Offsets[v + 1] += Offsets[v];
+
+			Data.resize(indices.size());
+			std::vector<unsigned> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i != indices.size(); ++i)
+				Data[fill[remap[indices[i]]]++] = unsigned(i / 3);
+		}
+
+		bool HasEdge(unsigned a, unsigned b) const
+		{
+			for (unsigned e = Begin(a); e != End(a); ++e)
+			{
+				if (Data[e] == b) return true;
+			}
+			return false;
+		}
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const DirectX::XMFLOAT3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return size_t(bits[0] * 73856093u) ^ size_t(bits[1] * 19349663u) ^ size_t(bits[2] * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	// remap: first vertex at the same position. wedge: circular list of the vertices at one position.
+	void BuildPositionRemap(const Vertex* vertices, size_t vertexCount, std::vector<unsigned>& remap, std::vector<unsigned>& wedge)
+	{
+		std::unordered_map<DirectX::XMFLOAT3, unsigned, PositionHash, PositionEqual> firstVertex;
+		firstVertex.reserve(vertexCount);
+
+		remap.resize(vertexCount);
+		wedge.resize(vertexCount);
+		for (unsigned v = 0; v != unsigned(vertexCount); ++v)
+		{
+			const unsigned r = firstVertex.emplace(vertices[v].Position, v).first->second;
+			remap[v] = r;
+			wedge[v] = v;
+			if (r != v)
+			{
+				wedge[v] = wedge[r];
+				wedge[r] = v;
+			}
+		}
+	}
+
+	void ClassifyVertices(const Adjacency& edges, const std::vector<unsigned>& remap, const std::vector<unsigned>& wedge,
+		const unsigned char* locked, std::vector<unsigned>& openOut, std::vector<unsigned>& openInc, std::vector<unsigned char>& kinds)
+	{
+		const unsigned vertexCount = unsigned(remap.size());
+
+		// The one open half-edge leaving or entering each vertex. A vertex with several stores itself.
+		openOut.assign(vertexCount, NoVertex);
+		openInc.assign(vertexCount, NoVertex);
+		for (unsigned v = 0; v != vertexCount; ++v)
+		{
+			for (unsigned e = edges.Begin(v); e != edges.End(v); ++e)
+			{
+				const unsigned target = edges.Data[e];
+				if (edges.HasEdge(target, v)) continue;
+
+				openOut[v] = openOut[v] == NoVertex ? target : v;
+				openInc[target] = openInc[target] == NoVertex ? v : target;
+			}
+		}
+
+		kinds.assign(vertexCount, VertexKindLocked);
+		for (unsigned v = 0; v != vertexCount; ++v)
+		{
+			if (remap[v] != v) continue;
+
+			unsigned char kind = VertexKindLocked;
+			if (wedge[v] == v)
+			{
+				if (openOut[v] == NoVertex && openInc[v] == NoVertex)
+					kind = VertexKindManifold;
+				else if (openOut[v] != NoVertex && openOut[v] != v && openInc[v] != NoVertex && openInc[v] != v)
+					kind = VertexKindBorder;
+			}
+			else if (wedge[wedge[v]] == v)
+			{
+				// Both sides need exactly one open edge in and out, and they must run between the same positions
+				const unsigned w = wedge[v];
+				const bool single = openOut[v] != NoVertex && openOut[v] != v && openInc[v] != NoVertex && openInc[v] != v &&
+					openOut[w] != NoVertex && openOut[w] != w && openInc[w] != NoVertex && openInc[w] != w;
+				if (single && remap[openInc[v]] == remap[openOut[w]] && remap[openOut[v]] == remap[openInc[w]])
+					kind = VertexKindSeam;
+			}
+
+			unsigned u = v;
+			do
+			{
+				if (locked && locked[u]) kind = VertexKindLocked;
+				u = wedge[u];
+			} while (u != v);
+
+			kinds[v] = kind;
+		}
+
+		for (unsigned v = 0; v != vertexCount; ++v)
+			kinds[v] = kinds[remap[v]];
+	}
+
+	bool CanCollapse(unsigned v0, unsigned v1, const std::vector<unsigned char>& kinds,
+		const std::vector<unsigned>& openOut, const std::vector<unsigned>& openInc)
+	{
+		const unsigned char k0 = kinds[v0];
+		if (k0 == VertexKindManifold) return true;
+		if (k0 == VertexKindLocked || kinds[v1] != k0) return false;
+
+		// Borders and seams only slide along their own open edges
+		return openOut[v0] == v1 || openInc[v0] == v1;
+	}
+
+	// Other vertex at the position of a seam vertex that has to follow v0 -> v1
+	unsigned SeamPartner(unsigned v0, unsigned v1, const std::vector<unsigned>& wedge, const std::vector<unsigned>& remap,
+		const std::vector<unsigned>& openOut, const std::vector<unsigned>& openInc)
+	{
+		const unsigned s0 = wedge[v0];
+		const unsigned s1 = openOut[v0] == v1 ? openInc[s0] : openOut[s0];
+		if (s1 == NoVertex || s1 == s0 || remap[s1] != remap[v1]) return NoVertex;
+		return s1;
+	}
+
+	DirectX::XMVECTOR TriangleNormal(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c)
+	{
+		const DirectX::XMVECTOR pa = XMLoadFloat3(&a);
+		return DirectX::XMVector3Cross(DirectX::XMVectorSubtract(XMLoadFloat3(&b), pa), DirectX::XMVectorSubtract(XMLoadFloat3(&c), pa));
+	}
+
+	// Would moving the position of v0 onto v1 turn any of the remaining triangles around v0 over?
+	bool HasTriangleFlips(unsigned v0, unsigned v1, const Adjacency& triangles, const std::vector<unsigned>& indices,
+		const std::vector<unsigned>& remap, const std::vector<unsigned>& collapseRemap, const Vertex* vertices)
+	{
+		const unsigned r0 = remap[v0];
+		const unsigned r1 = remap[v1];
+		const DirectX::XMFLOAT3& p0 = vertices[v0].Position;
+		const DirectX::XMFLOAT3& p1 = vertices[v1].Position;
+
+		for (unsigned t = triangles.Begin(r0); t != triangles.End(r0); ++t)
+		{
+			const unsigned* corners = &indices[triangles.Data[t] * 3];
+
+			// Rotate the corner at v0 to the front, the other two may already have moved in this pass
+			unsigned k = 0;
+			while (k != 3 && remap[corners[k]] != r0) ++k;
+			if (k == 3) continue;
+			const unsigned b = collapseRemap[corners[(k + 1) % 3]];
+			const unsigned c = collapseRemap[corners[(k + 2) % 3]];
+
+			// Triangles on the collapsed edge disappear
+			if (remap[b] == r1 || remap[c] == r1 || remap[b] == remap[c]) continue;
+
+			const DirectX::XMVECTOR before = TriangleNormal(p0, vertices[b].Position, vertices[c].Position);
+			const DirectX::XMVECTOR after = TriangleNormal(p1, vertices[b].Position, vertices[c].Position);
+			if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(before, after)) <= 0.0f) return true;
+		}
+		return false;
+	}
+
+	void ComputeQuadrics(const std::vector<unsigned>& indices, const Vertex* vertices, const Adjacency& edges,
+		const std::vector<unsigned>& remap, std::vector<Quadric>& quadrics)
+	{
+		quadrics.assign(remap.size(), Quadric{});
+
+		for (size_t i = 0; i != indices.size(); i += 3)
+		{
+			const unsigned corners[3] = { indices[i + 0], indices[i + 1], indices[i + 2] };
+			const DirectX::XMVECTOR normal = TriangleNormal(vertices[corners[0]].Position, vertices[corners[1]].Position, vertices[corners[2]].Position);
+			const float doubleArea = DirectX::XMVectorGetX(DirectX::XMVector3Length(normal));
+			if (doubleArea <= 0.0f) continue;
+
+			DirectX::XMFLOAT3 n{};
+			XMStoreFloat3(&n, DirectX::XMVectorScale(normal, 1.0f / doubleArea));
+			const DirectX::XMFLOAT3& p0 = vertices[corners[0]].Position;
+			const double d = -(double(n.x) * p0.x + double(n.y) * p0.y + double(n.z) * p0.z);
+
+			for (unsigned c = 0; c != 3; ++c)
+				quadrics[remap[corners[c]]].AddPlane(n.x, n.y, n.z, d, doubleArea * 0.5);
+
+			// Open edges get a plane through the edge perpendicular to the triangle
+			for (unsigned c = 0; c != 3; ++c)
+			{
+				const unsigned a = corners[c];
+				const unsigned b = corners[(c + 1) % 3];
+				if (edges.HasEdge(b, a)) continue;
+
+				const DirectX::XMVECTOR pa = XMLoadFloat3(&vertices[a].Position);
+				const DirectX::XMVECTOR edge = DirectX::XMVectorSubtract(XMLoadFloat3(&vertices[b].Position), pa);
+				const float lengthSquared = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(edge));
+				if (lengthSquared <= 0.0f) continue;
+
+				DirectX::XMFLOAT3 m{};
+				XMStoreFloat3(&m, DirectX::XMVector3Normalize(DirectX::XMVector3Cross(edge, normal)));
+				const DirectX::XMFLOAT3& pA = vertices[a].Position;
+				const double dm = -(double(m.x) * pA.x + double(m.y) * pA.y + double(m.z) * pA.z);
+
+				quadrics[remap[a]].AddPlane(m.x, m.y, m.z, dm, lengthSquared * BorderWeight);
+				quadrics[remap[b]].AddPlane(m.x, m.y, m.z, dm, lengthSquared * BorderWeight);
+			}
+		}
+	}
+}
+
+size_t MeshSimplifier::Simplify(int* destination, const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+	size_t targetIndexCount, float targetError, const unsigned char* locked, float* resultError)
+{
+	std::vector<unsigned> current(indices, indices + indexCount - indexCount % 3);
+
+	std::vector<unsigned> remap;
+	std::vector<unsigned> wedge;
+	BuildPositionRemap(vertices, vertexCount, remap, wedge);
+
+	Adjacency edges;
+	edges.BuildEdges(current, vertexCount);
+
+	std::vector<Quadric> quadrics;
+	ComputeQuadrics(current, vertices, edges, remap, quadrics);
+
+	const double errorLimit = double(targetError) * double(targetError);
+	double maxError = 0.0;
+
+	Adjacency triangles;
+	std::vector<unsigned> openOut;
+	std::vector<unsigned> openInc;
+	std::vector<unsigned char> kinds;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned> collapseRemap(vertexCount);
+	std::vector<unsigned char> touched(vertexCount);
+
+	// Every pass picks the cheapest independent collapses, applies them and rebuilds the adjacency
+	while (current.size() > targetIndexCount)
+	{
+		triangles.BuildTriangles(current, remap);
+		ClassifyVertices(edges, remap, wedge, locked, openOut, openInc, kinds);
+
+		collapses.clear();
+		for (size_t i = 0; i != current.size(); ++i)
+		{
+			const unsigned a = current[i];
+			const unsigned b = current[i - i % 3 + (i + 1) % 3];
+			if (remap[a] == remap[b]) continue;
+
+			// Edges with an opposite half-edge are seen twice, take them once
+			if (remap[a] > remap[b] && edges.HasEdge(b, a)) continue;
+
+			Collapse best = { NoVertex, NoVertex, FLT_MAX };
+			const unsigned ends[2][2] = { { a, b }, { b, a } };
+			for (const auto& end : ends)
+			{
+				if (!CanCollapse(end[0], end[1], kinds, openOut, openInc)) continue;
+				if (kinds[end[0]] == VertexKindSeam && SeamPartner(end[0], end[1], wedge, remap, openOut, openInc) == NoVertex) continue;
+
+				const float error = float(quadrics[remap[end[0]]].Error(vertices[end[1]].Position));
+				if (error < best.Error)
+					best = { end[0], end[1], error };
+			}
+			if (best.V0 != NoVertex)
+				collapses.push_back(best);
+		}
+		if (collapses.empty()) break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.Error < y.Error; });
+
+		// A manifold collapse removes two triangles. Beyond the goal, do not go much above its error
+		// so a single pass does not jump far ahead of the cheapest collapses.
+		const size_t triangleGoal = (current.size() - targetIndexCount + 2) / 3;
+		const size_t collapseGoal = (triangleGoal + 1) / 2;
+		double passLimit = errorLimit;
+		if (collapseGoal < collapses.size())
+			passLimit = std::min(passLimit, 1.5 * collapses[collapseGoal].Error);
+
+		for (unsigned v = 0; v != unsigned(vertexCount); ++v)
+			collapseRemap[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		size_t trianglesRemoved = 0;
+		size_t collapsesDone = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.Error > passLimit || trianglesRemoved >= triangleGoal) break;
+
+			const unsigned r0 = remap[collapse.V0];
+			const unsigned r1 = remap[collapse.V1];
+			if (touched[r0] || touched[r1]) continue;
+			if (HasTriangleFlips(collapse.V0, collapse.V1, triangles, current, remap, collapseRemap, vertices)) continue;
+
+			if (kinds[collapse.V0] == VertexKindSeam)
+			{
+				collapseRemap[collapse.V0] = collapse.V1;
+				collapseRemap[wedge[collapse.V0]] = SeamPartner(collapse.V0, collapse.V1, wedge, remap, openOut, openInc);
+			}
+			else
+			{
+				unsigned v = collapse.V0;
+				do
+				{
+					collapseRemap[v] = collapse.V1;
+					v = wedge[v];
+				} while (v != collapse.V0);
+			}
+
+			quadrics[r1].Add(quadrics[r0]);
+			touched[r0] = 1;
+			touched[r1] = 1;
+
+			trianglesRemoved += kinds[collapse.V0] == VertexKindBorder ? 1 : 2;
+			maxError = std::max(maxError, double(collapse.Error));
+			++collapsesDone;
+		}
+		if (collapsesDone == 0) break;
+
+		// Apply the collapses and drop the triangles that lost their area
+		size_t write = 0;
+		for (size_t i = 0; i != current.size(); i += 3)
+		{
+			const unsigned a = collapseRemap[current[i + 0]];
+			const unsigned b = collapseRemap[current[i + 1]];
+			const unsigned c = collapseRemap[current[i + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a]) continue;
+
+			current[write++] = a;
+			current[write++] = b;
+			current[write++] = c;
+		}
+		current.resize(write);
+		edges.BuildEdges(current, vertexCount);
+	}
+
+	for (size_t i = 0; i != current.size(); ++i)
+		destination[i] = int(current[i]);
+
+	if (resultError) *resultError = float(std::sqrt(maxError));
+	return current.size();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include "Vertex.h"
+
+// Quadric error metric (Garland and Heckbert 1997) edge collapse simplification.
+// Collapses keep one endpoint instead of placing a new vertex, so the result indexes the
+// original vertex buffer and every level of detail can share it.
+// UV seams and open borders only collapse along themselves, which keeps both sides of a
+// seam together and the outline of a border in place.
+class MeshSimplifier
+{
+public:
+	// Simplify until at most targetIndexCount indices are left or the next collapse would move
+	// the surface more than targetError (object space distance).
+	// locked, if given, has one entry per vertex; nonzero vertices never move. Used for the
+	// boundaries between submeshes of different materials.
+	// destination needs room for indexCount indices. Returns the number written and stores the
+	// largest error of the collapses done in resultError.
+	static size_t Simplify(int* destination, const int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError, const unsigned char* locked = nullptr, float* resultError = nullptr);
+};
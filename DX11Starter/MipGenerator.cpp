@@ -0,0 +1,273 @@
+#include "MipGenerator.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <DirectXMath.h>
+
+namespace
+{
+	// Rows per thread below which a level is not worth splitting
+	const uint32_t MinRowsPerThread = 32;
+
+	// Half width of the Kaiser filter in texels of the smaller level, and the window's shape parameter
+	const float KaiserWidth = 3.0f;
+	const float KaiserAlpha = 4.0f;
+
+	// Zeroth order modified Bessel function of the first kind, by its power series
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; term > sum * 1e-8f; ++k)
+		{
+			const float half = x / (2.0f * k);
+			term *= half * half;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float Sinc(float x)
+	{
+		if (std::abs(x) < 1e-4f) return 1.0f;
+		x *= DirectX::XM_PI;
+		return std::sin(x) / x;
+	}
+
+	// x in texels of the smaller level
+	float Kaiser(float x)
+	{
+		const float t = x / KaiserWidth;
+		if (std::abs(t) >= 1.0f) return 0.0f;
+		return Sinc(x) * BesselI0(KaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(KaiserAlpha);
+	}
+
+	// Source texels and normalized weights of every output texel along one axis, with edges clamped
+	struct FilterTaps
+	{
+		int Count;
+		std::vector<uint32_t> Indices;
+		std::vector<float> Weights;
+	};
+
+	void MakeTaps(uint32_t sourceSize, uint32_t outputSize, MipFilter filter, FilterTaps& taps)
+	{
+		const float scale = float(sourceSize) / outputSize;
+		const float support = (filter == MipFilterBox ? 0.5f : KaiserWidth) * scale;
+		taps.Count = int(std::ceil(support * 2.0f)) + 1;
+		taps.Indices.assign(size_t(outputSize) * taps.Count, 0);
+		taps.Weights.assign(size_t(outputSize) * taps.Count, 0.0f);
+
+		for (uint32_t x = 0; x != outputSize; ++x)
+		{
+			const float center = (x + 0.5f) * scale;
+			const int first = int(std::floor(center - support));
+			uint32_t* indices = &taps.Indices[size_t(x) * taps.Count];
+			float* weights = &taps.Weights[size_t(x) * taps.Count];
+			float sum = 0.0f;
+			for (int k = 0; k != taps.Count; ++k)
+			{
+				const int i = first + k;
+				// The box weighs each texel by how much of it the output texel covers
+				weights[k] = filter == MipFilterBox
+					? std::max(0.0f, std::min(i + 1.0f, center + support) - std::max(float(i), center - support))
+					: Kaiser((i + 0.5f - center) / scale);
+				indices[k] = uint32_t(std::min(std::max(i, 0), int(sourceSize) - 1));
+				sum += weights[k];
+			}
+			for (int k = 0; k != taps.Count; ++k)
+				weights[k] /= sum;
+		}
+	}
+
+	// sRGB to linear for every byte, and the linear values halfway between neighbouring bytes for rounding back
+	struct SrgbTables
+	{
+		SrgbTables()
+		{
+			for (int i = 0; i != 256; ++i)
+				ToLinear[i] = Decode(i / 255.0f);
+			for (int i = 0; i != 255; ++i)
+				Thresholds[i] = Decode((i + 0.5f) / 255.0f);
+		}
+
+		static float Decode(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		// The byte whose sRGB value is closest to a linear one, exactly as if rounding in sRGB
+		uint8_t Encode(float value) const
+		{
+			return uint8_t(std::lower_bound(Thresholds, Thresholds + 255, value) - Thresholds);
+		}
+
+		float ToLinear[256];
+		float Thresholds[255];
+	};
+
+	const SrgbTables& GetSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	void ToFloat(const uint8_t* pixels, uint32_t count, const MipSettings& settings, DirectX::XMFLOAT4* output)
+	{
+		const SrgbTables& srgb = GetSrgbTables();
+		for (uint32_t x = 0; x != count; ++x)
+		{
+			const uint8_t* p = pixels + x * 4;
+			if (settings.NormalMap)
+				output[x] = DirectX::XMFLOAT4(p[0] / 127.5f - 1.0f, p[1] / 127.5f - 1.0f, p[2] / 127.5f - 1.0f, p[3] / 255.0f);
+			else if (settings.Srgb)
+				output[x] = DirectX::XMFLOAT4(srgb.ToLinear[p[0]], srgb.ToLinear[p[1]], srgb.ToLinear[p[2]], p[3] / 255.0f);
+			else
+				output[x] = DirectX::XMFLOAT4(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f);
+		}
+	}
+
+	void ToPixels(const DirectX::XMFLOAT4* texels, uint32_t count, const MipSettings& settings, uint8_t* output)
+	{
+		const SrgbTables& srgb = GetSrgbTables();
+		const DirectX::XMVECTOR zero = DirectX::XMVectorZero();
+		const DirectX::XMVECTOR one = DirectX::XMVectorSplatOne();
+		const DirectX::XMVECTOR half = DirectX::XMVectorReplicate(0.5f);
+		const DirectX::XMVECTOR scale = DirectX::XMVectorReplicate(255.0f);
+		for (uint32_t x = 0; x != count; ++x)
+		{
+			DirectX::XMVECTOR v = DirectX::XMLoadFloat4(&texels[x]);
+			if (settings.NormalMap)
+			{
+				// Filtering shortens normals, put them back on the unit sphere and into 0..1
+				const DirectX::XMVECTOR length = DirectX::XMVector3Length(v);
+				if (DirectX::XMVectorGetX(length) > 1e-6f)
+					v = DirectX::XMVectorSetW(DirectX::XMVectorDivide(v, length), DirectX::XMVectorGetW(v));
+				v = DirectX::XMVectorSetW(DirectX::XMVectorMultiplyAdd(v, half, half), DirectX::XMVectorGetW(v));
+			}
+
+			DirectX::XMFLOAT4 stored;
+			DirectX::XMStoreFloat4(&stored, DirectX::XMVectorMultiplyAdd(DirectX::XMVectorClamp(v, zero, one), scale, half));
+			uint8_t* p = output + x * 4;
+			if (settings.Srgb && !settings.NormalMap)
+			{
+				const DirectX::XMFLOAT4& linear = texels[x];
+				p[0] = srgb.Encode(linear.x);
+				p[1] = srgb.Encode(linear.y);
+				p[2] = srgb.Encode(linear.z);
+			}
+			else
+			{
+				p[0] = uint8_t(stored.x);
+				p[1] = uint8_t(stored.y);
+				p[2] = uint8_t(stored.z);
+			}
+			p[3] = uint8_t(stored.w);
+		}
+	}
+
+	// Calls function(row) for rows [0, rows), split over threads when there are enough of them
+	template <typename Function>
+	void ForEachRow(uint32_t rows, unsigned threadCount, const Function& function)
+	{
+		threadCount = std::min(threadCount, std::max(1u, rows / MinRowsPerThread));
+		std::atomic<uint32_t> nextRow(0);
+		const auto work = [&]()
+		{
+			for (uint32_t y = nextRow++; y < rows; y = nextRow++)
+				function(y);
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < threadCount; ++t)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers) worker.join();
+	}
+}
+
+uint32_t MipGenerator::GetLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+		++count;
+	}
+	return count;
+}
+
+void MipGenerator::Generate(const uint8_t* rgba, uint32_t width, uint32_t height, const MipSettings& settings,
+	std::vector<MipLevel>& levels, unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	levels.resize(GetLevelCount(width, height));
+	levels[0].Width = width;
+	levels[0].Height = height;
+	levels[0].Pixels.assign(rgba, rgba + size_t(width) * height * 4);
+
+	std::vector<DirectX::XMFLOAT4> current(size_t(width) * height);
+	std::vector<DirectX::XMFLOAT4> horizontal;
+	std::vector<DirectX::XMFLOAT4> next;
+	ForEachRow(height, threadCount, [&](uint32_t y)
+	{
+		ToFloat(rgba + size_t(y) * width * 4, width, settings, &current[size_t(y) * width]);
+	});
+
+	FilterTaps columns;
+	FilterTaps rows;
+	for (size_t level = 1; level != levels.size(); ++level)
+	{
+		const uint32_t outputWidth = std::max(1u, width / 2);
+		const uint32_t outputHeight = std::max(1u, height / 2);
+		MakeTaps(width, outputWidth, settings.Filter, columns);
+		MakeTaps(height, outputHeight, settings.Filter, rows);
+
+		// Across every source row first, so the vertical pass reads each of them once per output row
+		horizontal.resize(size_t(outputWidth) * height);
+		ForEachRow(height, threadCount, [&](uint32_t y)
+		{
+			const DirectX::XMFLOAT4* source = &current[size_t(y) * width];
+			DirectX::XMFLOAT4* output = &horizontal[size_t(y) * outputWidth];
+			for (uint32_t x = 0; x != outputWidth; ++x)
+			{
+				const uint32_t* indices = &columns.Indices[size_t(x) * columns.Count];
+				const float* weights = &columns.Weights[size_t(x) * columns.Count];
+				DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+				for (int k = 0; k != columns.Count; ++k)
+					sum = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat4(&source[indices[k]]), DirectX::XMVectorReplicate(weights[k]), sum);
+				DirectX::XMStoreFloat4(&output[x], sum);
+			}
+		});
+
+		MipLevel& mip = levels[level];
+		mip.Width = outputWidth;
+		mip.Height = outputHeight;
+		mip.Pixels.resize(size_t(outputWidth) * outputHeight * 4);
+		next.resize(size_t(outputWidth) * outputHeight);
+		ForEachRow(outputHeight, threadCount, [&](uint32_t y)
+		{
+			DirectX::XMFLOAT4* output = &next[size_t(y) * outputWidth];
+			memset(output, 0, sizeof(DirectX::XMFLOAT4) * outputWidth);
+			for (int k = 0; k != rows.Count; ++k)
+			{
+				const float weight = rows.Weights[size_t(y) * rows.Count + k];
+				if (weight == 0.0f) continue;
+				const DirectX::XMFLOAT4* source = &horizontal[size_t(rows.Indices[size_t(y) * rows.Count + k]) * outputWidth];
+				const DirectX::XMVECTOR w = DirectX::XMVectorReplicate(weight);
+				for (uint32_t x = 0; x != outputWidth; ++x)
+					DirectX::XMStoreFloat4(&output[x], DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat4(&source[x]), w, DirectX::XMLoadFloat4(&output[x])));
+			}
+			ToPixels(output, outputWidth, settings, &mip.Pixels[size_t(y) * outputWidth * 4]);
+		});
+
+		current.swap(next);
+		width = outputWidth;
+		height = outputHeight;
+	}
+}
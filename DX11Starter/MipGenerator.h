@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum MipFilter
+{
+	// Average of the texels under each output texel, cheapest
+	MipFilterBox,
+	// Windowed sinc (Kaiser window, 3 texels wide, alpha 4), keeps detail without aliasing
+	MipFilterKaiser,
+};
+
+struct MipSettings
+{
+	MipFilter Filter;
+	// Color in sRGB, filtered after converting to linear light. Alpha is always linear.
+	bool Srgb;
+	// Tangent space normals in RGB, renormalized on every level
+	bool NormalMap;
+};
+
+struct MipLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	// RGBA8, rows of Width * 4 bytes
+	std::vector<uint8_t> Pixels;
+};
+
+// Full mip chains for RGBA8 images on the CPU, for cooked textures and for images loaded as they are.
+// Each level is filtered separably from the previous one kept in float, so quantization does not build up
+// down the chain; every texel is one vector of its four channels. Rows of a level are spread over threads.
+class MipGenerator
+{
+public:
+	static uint32_t GetLevelCount(uint32_t width, uint32_t height);
+
+	// levels receives the whole chain, the first level a copy of the source, down to 1x1.
+	// threadCount 0 picks one thread per core, small levels always run on one.
+	static void Generate(const uint8_t* rgba, uint32_t width, uint32_t height, const MipSettings& settings,
+		std::vector<MipLevel>& levels, unsigned threadCount = 1);
+};
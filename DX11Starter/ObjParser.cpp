@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include "ObjParser.h"
+
+namespace
+{
+	const double PowersOf10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p != end && IsBlank(*p)) ++p;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		while (p != end && *p != '\n') ++p;
+		return p == end ? end : p + 1;
+	}
+
+	inline const char* TokenEnd(const char* p, const char* end)
+	{
+		while (p != end && !IsBlank(*p) && *p != '\n') ++p;
+		return p;
+	}
+
+	inline bool TokenEquals(const char* p, const char* tokenEnd, const char* keyword)
+	{
+		for (; p != tokenEnd; ++p, ++keyword)
+		{
+			if (*keyword == '\0' || *p != *keyword) return false;
+		}
+		return *keyword == '\0';
+	}
+
+	// Read the next blank-separated token on the current line
+	inline const char* ReadToken(const char* p, const char* end, std::string& token)
+	{
+		p = SkipBlanks(p, end);
+		const char* tokenEnd = TokenEnd(p, end);
+		token.assign(p, tokenEnd);
+		return tokenEnd;
+	}
+
+	inline const char* ReadFloats(const char* p, const char* end, float* values, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			values[i] = 0.0f;
+			p = SkipBlanks(p, end);
+			p = ObjParser::ParseFloat(p, end, values[i]);
+		}
+		return p;
+	}
+
+	// Turn a relative OBJ index (-1 is the last element so far) into an absolute 1-based one
+	inline int ResolveIndex(int index, size_t count)
+	{
+		return index < 0 ? int(count) + index + 1 : index;
+	}
+}
+
+const char* ObjParser::ParseFloat(const char* p, const char* end, float& value)
+{
+	bool negative = false;
+	if (p != end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	// Gather up to 19 significant digits into an integer mantissa
+	uint64_t mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	for (; p != end && IsDigit(*p); ++p)
+	{
+		if (significant < 19)
+		{
+			mantissa = mantissa * 10 + uint64_t(*p - '0');
+			if (mantissa != 0) ++significant;
+		}
+		else
+		{
+			++exponent;
+		}
+	}
+	if (p != end && *p == '.')
+	{
+		++p;
+		for (; p != end && IsDigit(*p); ++p)
+		{
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + uint64_t(*p - '0');
+				if (mantissa != 0) ++significant;
+				--exponent;
+			}
+		}
+	}
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		int e = 0;
+		p = ParseInt(p + 1, end, e);
+		exponent += e;
+	}
+
+	double result = double(mantissa);
+	while (exponent < -22)
+	{
+		result /= PowersOf10[22];
+		exponent += 22;
+	}
+	while (exponent > 22)
+	{
+		result *= PowersOf10[22];
+		exponent -= 22;
+	}
+	if (exponent < 0)
+		result /= PowersOf10[-exponent];
+	else
+		result *= PowersOf10[exponent];
+
+	value = float(negative ? -result : result);
+	return p;
+}
+
+const char* ObjParser::ParseInt(const char* p, const char* end, int& value)
+{
+	bool negative = false;
+	if (p != end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	int result = 0;
+	for (; p != end && IsDigit(*p); ++p)
+	{
+		result = result * 10 + (*p - '0');
+	}
+
+	value = negative ? -result : result;
+	return p;
+}
+
+namespace
+{
+	// One line-aligned piece of a file, parsed on its own
+	struct ObjChunk
+	{
+		ObjData Data;
+		// Faces whose relative indices were resolved against this chunk only.
+		// Bit (3 * corner + attribute) is set for every relative index, attribute being position, texcoord, normal.
+		std::vector<std::pair<size_t, int>> RelativeFaces;
+		// Faces with indices past what the chunk has seen, with the attribute counts of the chunk when they were read.
+		// Whether they are in range is known once the chunks before are counted.
+		std::vector<std::pair<size_t, ObjOffsets>> UncheckedFaces;
+		// Faces before the first usemtl of the chunk continue the previous group
+		bool HasLeadingFaces = false;
+	};
+
+	// Every index must name an attribute declared before the face, the cookers index the attribute arrays with them
+	bool IsFaceInRange(const ObjFace& face, size_t positions, size_t texCoords, size_t normals)
+	{
+		for (const ObjIndex& index : face.Corners)
+		{
+			if (index.Position < 1 || size_t(index.Position) > positions) return false;
+			if (index.TexCoord < 0 || size_t(index.TexCoord) > texCoords) return false;
+			if (index.Normal < 0 || size_t(index.Normal) > normals) return false;
+		}
+		return true;
+	}
+
+	// Close the face ranges of every group, the last one ends at faceCount
+	void CloseGroups(std::vector<ObjGroup>& groups, size_t faceCount)
+	{
+		for (size_t g = 0; g < groups.size(); ++g)
+		{
+			const size_t last = g + 1 < groups.size() ? groups[g + 1].FirstFace : faceCount;
+			groups[g].FaceCount = last - groups[g].FirstFace;
+		}
+	}
+
+	// Relative indices only know about their own chunk, move them past everything before it
+	void ResolveRelativeFaces(ObjChunk& chunk, const ObjOffsets& offsets)
+	{
+		for (const std::pair<size_t, int>& relative : chunk.RelativeFaces)
+		{
+			ObjFace& face = chunk.Data.Faces[relative.first];
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if (relative.second & (1 << (corner * 3))) face.Corners[corner].Position += int(offsets.Position);
+				if (relative.second & (1 << (corner * 3 + 1))) face.Corners[corner].TexCoord += int(offsets.TexCoord);
+				if (relative.second & (1 << (corner * 3 + 2))) face.Corners[corner].Normal += int(offsets.Normal);
+			}
+		}
+	}
+
+	// Drop the unchecked faces still out of range with the chunks before counted, after ResolveRelativeFaces.
+	// Groups start at the first of their faces that is left, as if the sequential parser had skipped the others.
+	void DropInvalidFaces(ObjChunk& chunk, const ObjOffsets& offsets)
+	{
+		if (chunk.UncheckedFaces.empty()) return;
+		std::vector<ObjFace>& faces = chunk.Data.Faces;
+		std::vector<ObjGroup>& groups = chunk.Data.Groups;
+		size_t kept = 0;
+		size_t unchecked = 0;
+		size_t group = 0;
+		for (size_t f = 0; f < faces.size(); ++f)
+		{
+			for (; group < groups.size() && groups[group].FirstFace <= f; ++group)
+				groups[group].FirstFace = kept;
+			bool inRange = true;
+			if (unchecked < chunk.UncheckedFaces.size() && chunk.UncheckedFaces[unchecked].first == f)
+			{
+				const ObjOffsets& counts = chunk.UncheckedFaces[unchecked++].second;
+				inRange = IsFaceInRange(faces[f], offsets.Position + counts.Position, offsets.TexCoord + counts.TexCoord,
+					offsets.Normal + counts.Normal);
+			}
+			if (inRange) faces[kept++] = faces[f];
+		}
+		for (; group < groups.size(); ++group)
+			groups[group].FirstFace = kept;
+		faces.resize(kept);
+		CloseGroups(groups, kept);
+	}
+
+	// Append the groups of a chunk whose faces start at faceOffset, following the same rules as the sequential parser
+	void MergeGroups(const ObjChunk& chunk, size_t faceOffset, ObjData& obj)
+	{
+		for (size_t g = 0; g < chunk.Data.Groups.size(); ++g)
+		{
+			const ObjGroup& group = chunk.Data.Groups[g];
+			if (g == 0 && chunk.HasLeadingFaces)
+			{
+				if (obj.Groups.empty())
+					obj.Groups.push_back({ "", 0, 0 });
+			}
+			else if (obj.Groups.empty())
+				obj.Groups.push_back({ group.Material, faceOffset + group.FirstFace, 0 });
+			else if (obj.Groups.back().Material.empty())
+				obj.Groups.back().Material = group.Material;
+			else
+				obj.Groups.push_back({ group.Material, faceOffset + group.FirstFace, 0 });
+		}
+		if (!chunk.Data.MtlLib.empty())
+			obj.MtlLib = chunk.Data.MtlLib;
+	}
+
+	void ParseObjRange(const char* begin, const char* end, ObjData& obj, ObjChunk* chunk)
+	{
+		const char* p = begin;
+		while (p != end)
+		{
+			p = SkipBlanks(p, end);
+			const char* tokenEnd = TokenEnd(p, end);
+
+			if (TokenEquals(p, tokenEnd, "v"))
+			{
+				DirectX::XMFLOAT3 v;
+				p = ReadFloats(tokenEnd, end, &v.x, 3);
+				v.z *= -1.0f;
+				obj.Positions.push_back(v);
+			}
+			else if (TokenEquals(p, tokenEnd, "vn"))
+			{
+				DirectX::XMFLOAT3 n;
+				p = ReadFloats(tokenEnd, end, &n.x, 3);
+				n.z *= -1.0f;
+				obj.Normals.push_back(n);
+			}
+			else if (TokenEquals(p, tokenEnd, "vt"))
+			{
+				DirectX::XMFLOAT2 t;
+				p = ReadFloats(tokenEnd, end, &t.x, 2);
+				t.y = 1.0f - t.y;
+				obj.TexCoords.push_back(t);
+			}
+			else if (TokenEquals(p, tokenEnd, "f"))
+			{
+				ObjFace face{};
+				face.HasNormal = true;
+				int relativeMask = 0;
+				int corner = 0;
+				p = SkipBlanks(tokenEnd, end);
+				// Only triangles are supported, extra corners are ignored
+				for (; corner < 3 && p != end && *p != '\n'; ++corner)
+				{
+					ObjIndex& index = face.Corners[corner];
+					p = ObjParser::ParseInt(p, end, index.Position);
+					if (index.Position < 0) relativeMask |= 1 << (corner * 3);
+					index.Position = ResolveIndex(index.Position, obj.Positions.size());
+					if (p != end && *p == '/')
+					{
+						++p;
+						if (p != end && *p != '/')
+						{
+							p = ObjParser::ParseInt(p, end, index.TexCoord);
+							if (index.TexCoord < 0) relativeMask |= 1 << (corner * 3 + 1);
+							index.TexCoord = ResolveIndex(index.TexCoord, obj.TexCoords.size());
+						}
+						if (p != end && *p == '/')
+						{
+							p = ObjParser::ParseInt(p + 1, end, index.Normal);
+							if (index.Normal < 0) relativeMask |= 1 << (corner * 3 + 2);
+							// Decided on the index as written, in a chunk a relative one can resolve to 0 until
+							// ResolveRelativeFaces moves it past the normals of the chunks before
+							if (index.Normal == 0) face.HasNormal = false;
+							index.Normal = ResolveIndex(index.Normal, obj.Normals.size());
+						}
+						else
+							face.HasNormal = false;
+					}
+					else
+						face.HasNormal = false;
+					p = SkipBlanks(TokenEnd(p, end), end);
+				}
+
+				if (corner == 3)
+				{
+					// Faces before the first usemtl belong to the first material
+					if (obj.Groups.empty())
+					{
+						obj.Groups.push_back({ "", 0, 0 });
+						if (chunk) chunk->HasLeadingFaces = true;
+					}
+					// A chunk does not know yet how many attributes come before it
+					const bool inRange = IsFaceInRange(face, obj.Positions.size(), obj.TexCoords.size(), obj.Normals.size());
+					if (chunk && !inRange)
+					{
+						const ObjOffsets counts = { obj.Positions.size(), obj.TexCoords.size(), obj.Normals.size(), 0 };
+						chunk->UncheckedFaces.push_back(std::make_pair(obj.Faces.size(), counts));
+					}
+					if (chunk || inRange)
+					{
+						if (chunk && relativeMask)
+							chunk->RelativeFaces.push_back(std::make_pair(obj.Faces.size(), relativeMask));
+						obj.Faces.push_back(face);
+					}
+				}
+			}
+			else if (TokenEquals(p, tokenEnd, "usemtl"))
+			{
+				std::string name;
+				p = ReadToken(tokenEnd, end, name);
+				if (obj.Groups.empty())
+					obj.Groups.push_back({ name, obj.Faces.size(), 0 });
+				else if (!chunk && obj.Groups.back().Material.empty())
+					obj.Groups.back().Material = name;
+				else
+					obj.Groups.push_back({ name, obj.Faces.size(), 0 });
+			}
+			else if (TokenEquals(p, tokenEnd, "mtllib"))
+			{
+				p = ReadToken(tokenEnd, end, obj.MtlLib);
+			}
+			else
+			{
+				p = tokenEnd;
+			}
+
+			p = SkipLine(p, end);
+		}
+
+		CloseGroups(obj.Groups, obj.Faces.size());
+	}
+}
+
+void ObjParser::ParseObj(const char* begin, const char* end, ObjData& obj)
+{
+	ParseObjRange(begin, end, obj, nullptr);
+}
+
+void ObjParser::ParseObjParallel(const char* begin, const char* end, ObjData& obj, unsigned threadCount)
+{
+	const size_t size = size_t(end - begin);
+	if (threadCount == 0)
+	{
+		threadCount = size < ParallelThreshold ? 1 : std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (threadCount <= 1)
+	{
+		ParseObj(begin, end, obj);
+		return;
+	}
+
+	// Split into line-aligned chunks of roughly equal size
+	std::vector<const char*> bounds(1, begin);
+	for (unsigned i = 1; i < threadCount; ++i)
+	{
+		const char* p = std::max(begin + size * i / threadCount, bounds.back());
+		while (p != end && *p != '\n') ++p;
+		if (p != end) ++p;
+		if (p != bounds.back()) bounds.push_back(p);
+	}
+	if (bounds.back() != end) bounds.push_back(end);
+
+	const size_t chunkCount = bounds.size() - 1;
+	std::vector<ObjChunk> chunks(chunkCount);
+	{
+		std::vector<std::thread> workers;
+		for (size_t c = 1; c < chunkCount; ++c)
+			workers.emplace_back(ParseObjRange, bounds[c], bounds[c + 1], std::ref(chunks[c].Data), &chunks[c]);
+		ParseObjRange(bounds[0], bounds[1], chunks[0].Data, &chunks[0]);
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	// Deterministic merge: offsets of every chunk come from the chunks before it
+	std::vector<ObjOffsets> offsets(chunkCount + 1);
+	offsets[0] = { 0, 0, 0, 0 };
+	for (size_t c = 0; c < chunkCount; ++c)
+	{
+		const ObjData& data = chunks[c].Data;
+		offsets[c + 1].Position = offsets[c].Position + data.Positions.size();
+		offsets[c + 1].TexCoord = offsets[c].TexCoord + data.TexCoords.size();
+		offsets[c + 1].Normal = offsets[c].Normal + data.Normals.size();
+	}
+
+	// Face offsets only once the faces out of range are gone
+	auto resolveChunk = [&](size_t c)
+	{
+		ResolveRelativeFaces(chunks[c], offsets[c]);
+		DropInvalidFaces(chunks[c], offsets[c]);
+	};
+	{
+		std::vector<std::thread> workers;
+		for (size_t c = 1; c < chunkCount; ++c)
+			workers.emplace_back(resolveChunk, c);
+		resolveChunk(0);
+		for (std::thread& worker : workers) worker.join();
+	}
+	for (size_t c = 0; c < chunkCount; ++c)
+		offsets[c + 1].Face = offsets[c].Face + chunks[c].Data.Faces.size();
+
+	obj.Positions.resize(offsets[chunkCount].Position);
+	obj.TexCoords.resize(offsets[chunkCount].TexCoord);
+	obj.Normals.resize(offsets[chunkCount].Normal);
+	obj.Faces.resize(offsets[chunkCount].Face);
+
+	auto copyChunk = [&](size_t c)
+	{
+		ObjData& data = chunks[c].Data;
+		const ObjOffsets& o = offsets[c];
+		std::copy(data.Positions.begin(), data.Positions.end(), obj.Positions.begin() + o.Position);
+		std::copy(data.TexCoords.begin(), data.TexCoords.end(), obj.TexCoords.begin() + o.TexCoord);
+		std::copy(data.Normals.begin(), data.Normals.end(), obj.Normals.begin() + o.Normal);
+		std::copy(data.Faces.begin(), data.Faces.end(), obj.Faces.begin() + o.Face);
+
+		// Release the chunk as soon as it is merged, only its groups are still needed
+		std::vector<DirectX::XMFLOAT3>().swap(data.Positions);
+		std::vector<DirectX::XMFLOAT2>().swap(data.TexCoords);
+		std::vector<DirectX::XMFLOAT3>().swap(data.Normals);
+		std::vector<ObjFace>().swap(data.Faces);
+	};
+	{
+		std::vector<std::thread> workers;
+		for (size_t c = 1; c < chunkCount; ++c)
+			workers.emplace_back(copyChunk, c);
+		copyChunk(0);
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	for (size_t c = 0; c < chunkCount; ++c)
+		MergeGroups(chunks[c], offsets[c].Face, obj);
+	CloseGroups(obj.Groups, obj.Faces.size());
+}
+
+ObjStreamParser::ObjStreamParser()
+{
+	offsets = { 0, 0, 0, 0 };
+}
+
+void ObjStreamParser::Parse(const char* begin, const char* end, ObjData& piece)
+{
+	ObjChunk chunk;
+	ParseObjRange(begin, end, chunk.Data, &chunk);
+	ResolveRelativeFaces(chunk, offsets);
+	DropInvalidFaces(chunk, offsets);
+	MergeGroups(chunk, offsets.Face, merged);
+
+	offsets.Position += chunk.Data.Positions.size();
+	offsets.TexCoord += chunk.Data.TexCoords.size();
+	offsets.Normal += chunk.Data.Normals.size();
+	offsets.Face += chunk.Data.Faces.size();
+	CloseGroups(merged.Groups, offsets.Face);
+
+	piece.Positions = std::move(chunk.Data.Positions);
+	piece.TexCoords = std::move(chunk.Data.TexCoords);
+	piece.Normals = std::move(chunk.Data.Normals);
+	piece.Faces = std::move(chunk.Data.Faces);
+}
+
+std::string ObjParser::FindMtlLib(const char* begin, const char* end)
+{
+	std::string mtlLib;
+	for (const char* p = begin; p != end && mtlLib.empty(); p = SkipLine(p, end))
+	{
+		p = SkipBlanks(p, end);
+		const char* tokenEnd = TokenEnd(p, end);
+		if (TokenEquals(p, tokenEnd, "mtllib"))
+			p = ReadToken(tokenEnd, end, mtlLib);
+	}
+	return mtlLib;
+}
+
+void ObjParser::ParseMtl(const char* begin, const char* end, std::vector<MtlMaterial>& materials)
+{
+	MtlMaterial* current = nullptr;
+
+	const char* p = begin;
+	while (p != end)
+	{
+		p = SkipBlanks(p, end);
+		const char* tokenEnd = TokenEnd(p, end);
+
+		if (TokenEquals(p, tokenEnd, "newmtl"))
+		{
+			materials.emplace_back();
+			current = &materials.back();
+			p = ReadToken(tokenEnd, end, current->Name);
+		}
+		else if (current == nullptr)
+		{
+			// Ignore everything before the first newmtl
+			p = tokenEnd;
+		}
+		else if (TokenEquals(p, tokenEnd, "Kd"))
+		{
+			p = ReadFloats(tokenEnd, end, &current->Diffuse.x, 3);
+		}
+		else if (TokenEquals(p, tokenEnd, "Ka"))
+		{
+			p = ReadFloats(tokenEnd, end, &current->Ambient.x, 3);
+		}
+		else if (TokenEquals(p, tokenEnd, "Ks"))
+		{
+			p = ReadFloats(tokenEnd, end, &current->Specular.x, 3);
+		}
+		else if (TokenEquals(p, tokenEnd, "Ke"))
+		{
+			p = ReadFloats(tokenEnd, end, &current->Emission.x, 3);
+		}
+		else if (TokenEquals(p, tokenEnd, "Ns"))
+		{
+			p = ReadFloats(tokenEnd, end, &current->Shininess, 1);
+		}
+		else if (TokenEquals(p, tokenEnd, "map_Kd"))
+		{
+			p = ReadToken(tokenEnd, end, current->DiffuseMap);
+		}
+		else if (TokenEquals(p, tokenEnd, "map_Bump"))
+		{
+			p = ReadToken(tokenEnd, end, current->NormalMap);
+		}
+		else
+		{
+			p = tokenEnd;
+		}
+
+		p = SkipLine(p, end);
+	}
+}
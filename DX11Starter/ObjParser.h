@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+// Indices into the OBJ attribute arrays, 1-based like the file itself.
+// Negative (relative) indices are already resolved. 0 means "not present".
+// Faces with an index past the attributes declared before them, or without a position, are dropped,
+// so every index of a parsed face is in range.
+struct ObjIndex
+{
+	int Position;
+	int TexCoord;
+	int Normal;
+};
+
+struct ObjFace
+{
+	ObjIndex Corners[3];
+	bool HasNormal;
+};
+
+// A run of faces sharing the same usemtl
+struct ObjGroup
+{
+	std::string Material;
+	size_t FirstFace;
+	size_t FaceCount;
+};
+
+struct ObjData
+{
+	std::string MtlLib;
+
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<DirectX::XMFLOAT2> TexCoords;
+
+	std::vector<ObjFace> Faces;
+	std::vector<ObjGroup> Groups;
+};
+
+// Counts of everything parsed before a piece of an OBJ
+struct ObjOffsets
+{
+	size_t Position, TexCoord, Normal, Face;
+};
+
+struct MtlMaterial
+{
+	std::string Name;
+
+	DirectX::XMFLOAT4 Ambient = { 1.0f, 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT4 Diffuse = { 0.0f, 0.0f, 0.0f, 1.0f };
+	DirectX::XMFLOAT4 Specular = { 0.0f, 0.0f, 0.0f, 1.0f };
+	DirectX::XMFLOAT4 Emission = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float Shininess = 0.0f;
+
+	// Texture file names, relative to the .mtl file
+	std::string DiffuseMap;
+	std::string NormalMap;
+};
+
+// In-place tokenizer for OBJ/MTL text.
+// The parser never copies the source text; it only reads through [begin, end).
+// Numbers are parsed without locale or stream involvement.
+class ObjParser
+{
+public:
+	// Positions and normals get their z flipped and texcoords their v flipped,
+	// converting from OBJ's right-handed space to ours.
+	static void ParseObj(const char* begin, const char* end, ObjData& obj);
+	// Parse line-aligned chunks on threadCount threads and merge them in file order.
+	// The result is identical to ParseObj. threadCount 0 picks one thread per core,
+	// or a single thread for files smaller than ParallelThreshold.
+	static void ParseObjParallel(const char* begin, const char* end, ObjData& obj, unsigned threadCount = 0);
+	static void ParseMtl(const char* begin, const char* end, std::vector<MtlMaterial>& materials);
+	// The first mtllib of an OBJ without parsing anything else, for finding what a model depends on
+	static std::string FindMtlLib(const char* begin, const char* end);
+
+	// Low level helpers, return the position right after the parsed value
+	static const char* ParseFloat(const char* p, const char* end, float& value);
+	static const char* ParseInt(const char* p, const char* end, int& value);
+
+	static const size_t ParallelThreshold = 4 * 1024 * 1024;
+};
+
+// Parses an OBJ one line-aligned piece after another, for files too large to have in memory at once. Every piece
+// comes out with its indices resolved against the whole file, and the groups are merged across pieces the way
+// ParseObjParallel merges its chunks, so the pieces put together are what ParseObj makes of the whole file.
+class ObjStreamParser
+{
+public:
+	ObjStreamParser();
+
+	// piece gets the attributes and faces of [begin, end) only, its groups and mtllib are left alone
+	void Parse(const char* begin, const char* end, ObjData& piece);
+
+	// Everything parsed so far
+	const ObjOffsets& GetOffsets() const { return offsets; }
+	const std::vector<ObjGroup>& GetGroups() const { return merged.Groups; }
+	const std::string& GetMtlLib() const { return merged.MtlLib; }
+
+private:
+	ObjOffsets offsets;
+	// Groups with file-wide face ranges and the mtllib, nothing else is kept
+	ObjData merged;
+};
@@ -0,0 +1,34 @@
+// Same as ShadowVS.hlsl, for the packed vertex formats in VertexPacker.h
+struct VertexShaderInput
+{
+	float3 pos			: POSITION;     // Float or unorm16 position
+};
+
+struct VertexToPixel
+{
+	float4 pos		: SV_POSITION;
+};
+
+cbuffer lightData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix projection;
+
+	float3 positionScale;
+	float3 positionOffset;
+}
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+	float4 pos = float4(input.pos * positionScale + positionOffset, 1.0f);
+
+	// Transform the vertex position into projected space.
+	pos = mul(pos, world);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	return output;
+}
@@ -0,0 +1,76 @@
+// Same as VertexShader.hlsl, for the packed vertex formats in VertexPacker.h
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix itworld;
+	matrix view;
+	matrix projection;
+
+	matrix lView;
+
+	int lightCount;
+
+	// Dequantization of unorm16 positions and UVs
+	float3 positionScale;
+	float3 positionOffset;
+	float2 uvScale;
+	float2 uvOffset;
+};
+
+// Positions are either floats or unorm16, normals and tangents octahedral snorm16, UVs unorm16
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float2 tangent		: TANGENT;
+};
+
+struct VertexToPixel
+{
+	float4 position				: SV_POSITION;
+	float4 worldPos				: POSITION0;
+	float3 normal				: NORMAL;
+	float2 uv					: TEXCOORD;
+	float4 tangent				: TANGENT;
+	float4 lViewSpacePos		: POSITION1;
+};
+
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// The lowest bit of the second component is the handedness, see VertexPacker::EncodeTangent
+float4 DecodeTangent(float2 e)
+{
+	int bits = (int)round(e.y * 32767.0f);
+	return float4(DecodeOctahedral(e), (bits & 1) ? -1.0f : 1.0f);
+}
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	float3 position = input.position * positionScale + positionOffset;
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	matrix lWorldView = mul(world, lView);
+
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+	output.worldPos = mul(float4(position, 1.0f), world);
+
+	output.lViewSpacePos = mul(float4(position, 1.0f), lWorldView);
+
+	output.normal = mul(DecodeOctahedral(input.normal), (float3x3)itworld);
+	// Zero tangents (faces without UVs) decode to +z, the pixel shader only uses them with normal maps
+	float4 tangent = DecodeTangent(input.tangent);
+	output.tangent = float4(mul(tangent.xyz, (float3x3)itworld), tangent.w);
+
+	output.uv = input.uv * uvScale + uvOffset;
+
+	return output;
+}
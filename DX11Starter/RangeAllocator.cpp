@@ -0,0 +1,172 @@
+#include "RangeAllocator.h"
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+	this->capacity = 0;
+	used = 0;
+	Grow(capacity);
+}
+
+RangeAllocator::Handle RangeAllocator::Allocate(uint32_t size)
+{
+	if (size == 0) return InvalidHandle;
+
+	// Smallest free range that fits, the lowest offset among equal sizes
+	const auto fit = freeBySize.lower_bound(std::make_pair(size, 0u));
+	if (fit == freeBySize.end()) return InvalidHandle;
+
+	const uint32_t offset = fit->second;
+	const uint32_t rangeSize = fit->first;
+	RemoveFreeRange(freeByOffset.find(offset));
+	if (rangeSize > size)
+		AddFreeRange(offset + size, rangeSize - size);
+
+	Handle handle;
+	if (freeHandles.empty())
+	{
+		handle = Handle(allocations.size());
+		allocations.push_back({ offset, size });
+	}
+	else
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = { offset, size };
+	}
+	used += size;
+	return handle;
+}
+
+void RangeAllocator::Free(Handle handle)
+{
+	if (handle >= allocations.size() || allocations[handle].Size == 0) return;
+
+	uint32_t offset = allocations[handle].Offset;
+	uint32_t size = allocations[handle].Size;
+	used -= size;
+	allocations[handle].Size = 0;
+	freeHandles.push_back(handle);
+
+	// Merge with the free ranges right before and after
+	auto next = freeByOffset.lower_bound(offset);
+	if (next != freeByOffset.begin())
+	{
+		const auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeRange(previous);
+		}
+	}
+	if (next != freeByOffset.end() && next->first == offset + size)
+	{
+		size += next->second;
+		RemoveFreeRange(next);
+	}
+	AddFreeRange(offset, size);
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity)
+{
+	if (newCapacity <= capacity) return;
+
+	uint32_t offset = capacity;
+	uint32_t size = newCapacity - capacity;
+	capacity = newCapacity;
+
+	// Extend a free range that ends at the old capacity
+	if (!freeByOffset.empty())
+	{
+		const auto last = std::prev(freeByOffset.end());
+		if (last->first + last->second == offset)
+		{
+			offset = last->first;
+			size += last->second;
+			RemoveFreeRange(last);
+		}
+	}
+	AddFreeRange(offset, size);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::Defragment()
+{
+	std::vector<Handle> live;
+	for (Handle h = 0; h != Handle(allocations.size()); ++h)
+	{
+		if (allocations[h].Size) live.push_back(h);
+	}
+	std::sort(live.begin(), live.end(), [this](Handle a, Handle b) { return allocations[a].Offset < allocations[b].Offset; });
+
+	std::vector<Move> moves;
+	uint32_t offset = 0;
+	for (Handle h : live)
+	{
+		Allocation& allocation = allocations[h];
+		Move* last = moves.empty() ? nullptr : &moves.back();
+		if (last && last->From + last->Size == allocation.Offset && last->To + last->Size == offset)
+			last->Size += allocation.Size;
+		else
+			moves.push_back({ allocation.Offset, offset, allocation.Size });
+
+		allocation.Offset = offset;
+		offset += allocation.Size;
+	}
+
+	freeByOffset.clear();
+	freeBySize.clear();
+	if (offset < capacity)
+		AddFreeRange(offset, capacity - offset);
+	return moves;
+}
+
+uint32_t RangeAllocator::GetLargestFreeRange() const
+{
+	return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+bool RangeAllocator::Validate() const
+{
+	if (freeByOffset.size() != freeBySize.size()) return false;
+
+	// Every element is covered exactly once, and no two free ranges touch
+	std::vector<std::pair<uint32_t, uint32_t>> ranges(freeByOffset.begin(), freeByOffset.end());
+	uint32_t allocated = 0;
+	for (const Allocation& allocation : allocations)
+	{
+		if (allocation.Size == 0) continue;
+		ranges.push_back({ allocation.Offset, allocation.Size });
+		allocated += allocation.Size;
+	}
+	if (allocated != used) return false;
+	std::sort(ranges.begin(), ranges.end());
+
+	uint32_t offset = 0;
+	for (const auto& range : ranges)
+	{
+		if (range.first != offset) return false;
+		offset += range.second;
+	}
+	if (offset != capacity) return false;
+
+	for (auto it = freeByOffset.begin(); it != freeByOffset.end(); ++it)
+	{
+		const auto next = std::next(it);
+		if (next != freeByOffset.end() && it->first + it->second == next->first) return false;
+	}
+	return true;
+}
+
+void RangeAllocator::AddFreeRange(uint32_t offset, uint32_t size)
+{
+	freeByOffset.emplace(offset, size);
+	freeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator range)
+{
+	freeBySize.erase(std::make_pair(range->second, range->first));
+	freeByOffset.erase(range);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+// Hands out ranges of a linear space of elements, like the vertices or indices of a GPU buffer.
+// Allocations are referred to by handles, so their offsets can change when the space is defragmented.
+// Pure bookkeeping: nothing is copied here, see GeometryArena.
+class RangeAllocator
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle InvalidHandle = ~0u;
+
+	// One allocation moving from its old offset to its new one
+	struct Move
+	{
+		uint32_t From;
+		uint32_t To;
+		uint32_t Size;
+	};
+
+	explicit RangeAllocator(uint32_t capacity = 0);
+
+	// Best fit. Returns InvalidHandle for size 0 or if no free range is large enough.
+	Handle Allocate(uint32_t size);
+	void Free(Handle handle);
+
+	// Add space at the end, capacity never shrinks
+	void Grow(uint32_t newCapacity);
+
+	// Pack every allocation to the front, keeping their order. Returns where each live range goes,
+	// in offset order, with neighbours that stay neighbours merged into one move.
+	std::vector<Move> Defragment();
+
+	// 0 for InvalidHandle and freed handles
+	uint32_t GetOffset(Handle handle) const { return handle < allocations.size() ? allocations[handle].Offset : 0; }
+	uint32_t GetSize(Handle handle) const { return handle < allocations.size() ? allocations[handle].Size : 0; }
+
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetUsed() const { return used; }
+	size_t GetAllocationCount() const { return allocations.size() - freeHandles.size(); }
+	size_t GetFreeRangeCount() const { return freeByOffset.size(); }
+	uint32_t GetLargestFreeRange() const;
+
+	// Check that free and allocated ranges tile the space exactly, for tests and benchmarks
+	bool Validate() const;
+
+private:
+	struct Allocation
+	{
+		uint32_t Offset;
+		// 0 for unused handles
+		uint32_t Size;
+	};
+
+	void AddFreeRange(uint32_t offset, uint32_t size);
+	void RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator range);
+
+	uint32_t capacity;
+	uint32_t used;
+
+	std::vector<Allocation> allocations;
+	std::vector<Handle> freeHandles;
+
+	// Free ranges by offset for merging neighbours, and by size for best fit
+	std::map<uint32_t, uint32_t> freeByOffset;
+	std::set<std::pair<uint32_t, uint32_t>> freeBySize;
+};
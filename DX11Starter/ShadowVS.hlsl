@@ -3,7 +3,7 @@ struct VertexShaderInput
 	float3 pos			: POSITION;     // XYZ position
 	float3 normal		: NORMAL;
 	float2 uv			: TEXCOORD;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 };
 
 struct VertexToPixel
@@ -1,7 +1,7 @@
 #include <cassert>
 #include "SimpleLogger.h"
 
-SimpleLogger SimpleLogger::DefaultLogger = SimpleLogger();
+SimpleLogger SimpleLogger::DefaultLogger;
 
 std::ostream& operator<<(std::ostream& out, const LogLevel value)
 {
@@ -148,6 +148,8 @@ void SimpleLogger::Add(const LogStream& logStream)
 
 SimpleLogger& SimpleLogger::Initialize(const char* time, const char* file, const int line, const char* funcsig, LogLevel level)
 {
+	// Released by the manipulator that ends the statement
+	mutex.lock();
 	for (auto& ls : logStreams)
 	{
 		ls.Initialize(time, file, line, funcsig, level);
@@ -162,5 +164,6 @@ SimpleLogger& SimpleLogger::operator<<(manipulator pf)
 		logStream.Finalize(pf);
 	}
 
+	mutex.unlock();
 	return *this;
 }
\ No newline at end of file
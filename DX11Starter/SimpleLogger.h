@@ -1,4 +1,5 @@
 #pragma once
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -42,6 +43,8 @@ private:
 	size_t fmtPtr;
 };
 
+// A statement holds the logger from LOG_* to the manipulator that ends it, std::endl, so statements from different
+// threads come out whole
 class SimpleLogger
 {
 public:
@@ -60,6 +63,8 @@ public:
 	static SimpleLogger DefaultLogger;
 private:
 	std::vector<LogStream> logStreams;
+	// Recursive for statements that log while they are built
+	std::recursive_mutex mutex;
 };
 
 template <typename T>
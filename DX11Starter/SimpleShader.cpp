@@ -1,4 +1,8 @@
 #include "SimpleShader.h"
+#include <codecvt>
+#include <cstring>
+#include <locale>
+#include "VirtualFile.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -61,6 +65,32 @@ void ISimpleShader::CleanUp()
 	textureTable.clear();
 }
 
+// --------------------------------------------------------
+// Reads a compiled shader into a blob, from the mounted asset
+// archives if one of them has it and from the disk otherwise
+//
+// shaderFile - A "wide string" specifying the compiled shader to load
+// blob       - Receives the blob, released by the caller
+// --------------------------------------------------------
+HRESULT ISimpleShader::ReadShaderBlob(LPCWSTR shaderFile, ID3DBlob** blob)
+{
+	// wstring -> string
+	std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> cv;
+	const std::string filename = cv.to_bytes(shaderFile);
+	if (!VirtualFile::Exists(filename))
+		return E_FAIL;
+
+	VirtualFile file;
+	if (!file.Open(filename))
+		return E_FAIL;
+
+	HRESULT hr = D3DCreateBlob(file.GetSize(), blob);
+	if (FAILED(hr))
+		return hr;
+	memcpy((*blob)->GetBufferPointer(), file.GetData(), file.GetSize());
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table using shader
 // reflection.  This must be a separate step from the constructor since
@@ -73,7 +103,7 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	HRESULT hr = ReadShaderBlob(shaderFile, &shaderBlob);
 	if (hr != S_OK)
 	{
 		return false;
@@ -635,8 +665,12 @@ void SimpleVertexShader::CleanUp()
 bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 {
 	// Clean up first, in the event this method is
-	// called more than once on the same object
+	// called more than once on the same object.
+	// An input layout from the constructor overload has to survive this
+	ID3D11InputLayout* existingLayout = inputLayout;
+	if (existingLayout) existingLayout->AddRef();
 	this->CleanUp();
+	inputLayout = existingLayout;
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateVertexShader(
@@ -68,6 +68,9 @@ public:
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
 
+	// Read a compiled shader through the mounted asset archives, or from the disk
+	static HRESULT ReadShaderBlob(LPCWSTR shaderFile, ID3DBlob** blob);
+
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
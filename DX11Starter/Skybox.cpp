@@ -1,8 +1,7 @@
 #include "Skybox.h"
 #include <DDSTextureLoader.h>
 #include "SimpleLogger.h"
-#include <locale>
-#include <codecvt>
+#include "VirtualFile.h"
 
 Skybox::Skybox(ID3D11Device* d, ID3D11DeviceContext* c, const std::string& cubemapFile, const std::string& irradianceFile)
 {
@@ -11,15 +10,21 @@ Skybox::Skybox(ID3D11Device* d, ID3D11DeviceContext* c, const std::string& cubem
 
 	rotation = DirectX::XMQuaternionIdentity();
 
-	// string -> wstring
-	std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> cv;
-	std::wstring wFilename = cv.from_bytes(cubemapFile);
-	// Load cubemap
-	DirectX::CreateDDSTextureFromFile(device, context, wFilename.c_str(), &cubemapTex, &cubemapSrv);
+	cubemapTex = nullptr;
+	cubemapSrv = nullptr;
+	irradianceTex = nullptr;
+	irradianceSrv = nullptr;
 
-	wFilename = cv.from_bytes(irradianceFile);
-	// Load irradiance map
-	DirectX::CreateDDSTextureFromFile(device, context, wFilename.c_str(), &irradianceTex, &irradianceSrv);
+	// Load cubemap and irradiance map, from the asset archive if one is mounted
+	if (!cubemapFile.empty())
+	{
+		VirtualFile cubemap;
+		VirtualFile irradiance;
+		const bool cubemapOpened = cubemap.Open(cubemapFile);
+		const bool irradianceOpened = irradiance.Open(irradianceFile);
+		LoadCubemaps(cubemapOpened ? cubemap.GetData() : nullptr, cubemapOpened ? cubemap.GetSize() : 0,
+			irradianceOpened ? irradiance.GetData() : nullptr, irradianceOpened ? irradiance.GetSize() : 0);
+	}
 
 	Vertex vertices[8];
 
@@ -105,6 +110,19 @@ Skybox::Skybox(ID3D11Device* d, ID3D11DeviceContext* c, const std::string& cubem
 
 }
 
+void Skybox::LoadCubemaps(const char* cubemap, size_t cubemapSize, const char* irradiance, size_t irradianceSize)
+{
+	if (cubemapTex) { cubemapTex->Release(); cubemapTex = nullptr; }
+	if (cubemapSrv) { cubemapSrv->Release(); cubemapSrv = nullptr; }
+	if (irradianceTex) { irradianceTex->Release(); irradianceTex = nullptr; }
+	if (irradianceSrv) { irradianceSrv->Release(); irradianceSrv = nullptr; }
+
+	if (cubemap)
+		DirectX::CreateDDSTextureFromMemory(device, context, reinterpret_cast<const uint8_t*>(cubemap), cubemapSize, &cubemapTex, &cubemapSrv);
+	if (irradiance)
+		DirectX::CreateDDSTextureFromMemory(device, context, reinterpret_cast<const uint8_t*>(irradiance), irradianceSize, &irradianceTex, &irradianceSrv);
+}
+
 Skybox::~Skybox()
 {
 	if (vertexBuffer) { vertexBuffer->Release(); }
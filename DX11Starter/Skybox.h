@@ -10,9 +10,14 @@
 class Skybox
 {
 public:
+	// An empty cubemapFile leaves both maps to LoadCubemaps, for reading the files in the background
 	Skybox(ID3D11Device* d, ID3D11DeviceContext* c, const std::string& cubemapFile, const std::string& irradianceFile);
 	~Skybox();
 
+	// Create the cube maps from DDS files in memory, replacing any there were. A null file leaves that map empty.
+	// Only on the thread that owns the context.
+	void LoadCubemaps(const char* cubemap, size_t cubemapSize, const char* irradiance, size_t irradianceSize);
+
 	ID3D11Buffer* GetVertexBuffer() const;
 	ID3D11Buffer* GetIndexBuffer() const;
 
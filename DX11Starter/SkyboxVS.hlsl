@@ -10,7 +10,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;
 	float3 normal		: NORMAL;
 	float2 uv			: TEXCOORD;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 };
 
 struct VertexToPixel
@@ -0,0 +1,892 @@
+#include "StreamingMeshCooker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "FileSystem.h"
+#include "ObjParser.h"
+#include "SimpleLogger.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// What a face costs while its submesh is welded, optimized, simplified and clustered, with room to spare
+	const size_t BytesPerFace = 512;
+	const size_t MinJobFaces = 1024;
+	// The OBJ is read in pieces of an eighth of the budget within these
+	const size_t MinPieceSize = 1024 * 1024;
+	const size_t MaxPieceSize = 64 * 1024 * 1024;
+	// Elements read at once from spill files
+	const size_t WindowElements = 64 * 1024;
+	// Resolution of the centroid histogram a group is split at
+	const size_t SplitBins = 1024;
+
+	template <typename T>
+	size_t Bytes(const std::vector<T>& values)
+	{
+		return values.capacity() * sizeof(T);
+	}
+
+	void Track(StreamingCookStats& stats, size_t held)
+	{
+		stats.PeakMemory = std::max(stats.PeakMemory, held);
+	}
+
+	template <typename T>
+	void Write(std::ofstream& out, const std::vector<T>& values, StreamingCookStats& stats)
+	{
+		out.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(T)));
+		stats.SpillBytes += values.size() * sizeof(T);
+	}
+
+	template <typename T>
+	bool Read(std::ifstream& in, uint64_t first, size_t count, std::vector<T>& values)
+	{
+		values.resize(count);
+		in.clear();
+		in.seekg(std::streamoff(first * sizeof(T)));
+		in.read(reinterpret_cast<char*>(values.data()), std::streamsize(count * sizeof(T)));
+		return bool(in);
+	}
+
+	// Temporary files of one cook, removed with it
+	class SpillFiles
+	{
+	public:
+		explicit SpillFiles(const std::string& base) : base(base), created(0) {}
+		~SpillFiles()
+		{
+			for (const std::string& filename : files)
+				std::remove(filename.c_str());
+		}
+
+		std::string Add(const std::string& name)
+		{
+			files.push_back(base + "." + name + std::to_string(created++) + ".spill");
+			return files.back();
+		}
+
+		void Remove(const std::string& filename)
+		{
+			std::remove(filename.c_str());
+			files.erase(std::remove(files.begin(), files.end(), filename), files.end());
+		}
+
+	private:
+		std::string base;
+		size_t created;
+		std::vector<std::string> files;
+	};
+
+	// Elements of a spill file at sorted 1-based OBJ indices, read through a window that only moves forward
+	template <typename T>
+	class AttributeReader
+	{
+	public:
+		bool Open(const std::string& filename, size_t elementCount)
+		{
+			file.open(filename, std::ios::binary);
+			count = elementCount;
+			return file.is_open();
+		}
+
+		// Indices outside the file, like the 0 of a missing texcoord, get zeros
+		bool Gather(const std::vector<int>& sortedIndices, std::vector<T>& values)
+		{
+			values.resize(sortedIndices.size());
+			window.clear();
+			windowFirst = 0;
+			for (size_t i = 0; i != sortedIndices.size(); ++i)
+			{
+				const int index = sortedIndices[i];
+				if (index <= 0 || size_t(index) > count)
+				{
+					values[i] = T{};
+					continue;
+				}
+				const size_t element = size_t(index) - 1;
+				if (element < windowFirst || element >= windowFirst + window.size())
+				{
+					windowFirst = element;
+					if (!Read(file, element, std::min(WindowElements, count - element), window)) return false;
+				}
+				values[i] = window[element - windowFirst];
+			}
+			return true;
+		}
+
+		size_t GetWindowBytes() const { return Bytes(window); }
+
+	private:
+		std::ifstream file;
+		size_t count = 0;
+		std::vector<T> window;
+		size_t windowFirst = 0;
+	};
+
+	// Positions compare by their bits, like the hash maps MeshCooker looks them up in
+	bool PositionLess(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		uint32_t aBits[3];
+		uint32_t bBits[3];
+		memcpy(aBits, &a, sizeof(aBits));
+		memcpy(bBits, &b, sizeof(bBits));
+		return std::lexicographical_compare(aBits, aBits + 3, bBits, bBits + 3);
+	}
+
+	bool SamePosition(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return memcmp(&a, &b, sizeof(a)) == 0;
+	}
+
+	// A face normal added to the sum of one position, for corners without normals
+	struct NormalRecord
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	// A position used by a submesh. After reducing, only positions of several submeshes are left.
+	struct SharedRecord
+	{
+		DirectX::XMFLOAT3 Position;
+		uint32_t Submesh;
+	};
+
+	struct FaceRecord
+	{
+		ObjFace Face;
+		DirectX::XMFLOAT3 Centroid;
+	};
+
+	// Stable sort of a spill file of count records by position, in runs of at most runCount records merged afterwards.
+	// Records of the same position keep the order they were written in.
+	template <typename Record>
+	bool SortByPosition(const std::string& filename, size_t count, size_t runCount, SpillFiles& spills, StreamingCookStats& stats)
+	{
+		const auto less = [](const Record& a, const Record& b) { return PositionLess(a.Position, b.Position); };
+
+		std::vector<std::string> runs;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			std::vector<Record> records;
+			for (size_t first = 0; first < count; first += runCount)
+			{
+				if (!Read(in, first, std::min(runCount, count - first), records)) return false;
+				std::stable_sort(records.begin(), records.end(), less);
+				// stable_sort takes a buffer as large as what it sorts
+				Track(stats, Bytes(records) * 2);
+
+				runs.push_back(count <= runCount ? filename + ".sorted" : spills.Add("run"));
+				std::ofstream out(runs.back(), std::ios::binary | std::ios::trunc);
+				Write(out, records, stats);
+				if (!out) return false;
+			}
+		}
+		if (runs.size() <= 1)
+		{
+			std::remove(filename.c_str());
+			return runs.empty() || std::rename(runs[0].c_str(), filename.c_str()) == 0;
+		}
+
+		// Every run is read through its own buffer, the smallest head goes next and the earlier run wins ties
+		struct Run
+		{
+			std::ifstream File;
+			std::vector<Record> Buffer;
+			size_t Next;
+			size_t Read;
+			size_t Count;
+		};
+		const size_t bufferCount = std::max<size_t>(1024, runCount / (runs.size() + 1));
+		std::vector<Run> readers(runs.size());
+		for (size_t r = 0; r != runs.size(); ++r)
+		{
+			readers[r].File.open(runs[r], std::ios::binary);
+			readers[r].Next = 0;
+			readers[r].Read = 0;
+			readers[r].Count = std::min(runCount, count - r * runCount);
+		}
+		const auto refill = [&](Run& run)
+		{
+			const size_t n = std::min(bufferCount, run.Count - run.Read);
+			run.Next = 0;
+			if (!Read(run.File, run.Read, n, run.Buffer)) return false;
+			run.Read += n;
+			return true;
+		};
+		for (Run& run : readers)
+			if (!refill(run)) return false;
+
+		std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+		std::vector<Record> output;
+		output.reserve(bufferCount);
+		for (size_t written = 0; written != count; ++written)
+		{
+			Run* smallest = nullptr;
+			for (Run& run : readers)
+				if (run.Next != run.Buffer.size() && (!smallest || less(run.Buffer[run.Next], smallest->Buffer[smallest->Next])))
+					smallest = &run;
+			if (!smallest) return false;
+
+			output.push_back(smallest->Buffer[smallest->Next++]);
+			if (smallest->Next == smallest->Buffer.size() && smallest->Read != smallest->Count && !refill(*smallest)) return false;
+			if (output.size() == bufferCount || written + 1 == count)
+			{
+				Write(out, output, stats);
+				output.clear();
+			}
+		}
+		Track(stats, bufferCount * sizeof(Record) * (runs.size() + 1));
+
+		readers.clear();
+		for (const std::string& run : runs)
+			spills.Remove(run);
+		return bool(out);
+	}
+
+	// Goes through a sorted spill file once, calling reduce with every run of records of the same position
+	template <typename Record, typename Reduce>
+	bool ForEachPosition(const std::string& filename, size_t count, const Reduce& reduce)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		std::vector<Record> window;
+		std::vector<Record> same;
+		for (size_t first = 0; first < count; first += window.size())
+		{
+			if (!Read(in, first, std::min(WindowElements, count - first), window)) return false;
+			for (const Record& record : window)
+			{
+				if (!same.empty() && !SamePosition(same.back().Position, record.Position))
+				{
+					reduce(same);
+					same.clear();
+				}
+				same.push_back(record);
+			}
+		}
+		if (!same.empty()) reduce(same);
+		return true;
+	}
+
+	// Looks up sorted unique positions in a spill file of records sorted by position, moving only forward and
+	// skipping ahead with a binary search on the file
+	template <typename Record>
+	class SortedTable
+	{
+	public:
+		bool Open(const std::string& filename, size_t recordCount)
+		{
+			file.open(filename, std::ios::binary);
+			count = recordCount;
+			return file.is_open();
+		}
+
+		bool Find(const std::vector<DirectX::XMFLOAT3>& queries, std::vector<Record>& records, std::vector<unsigned char>& found)
+		{
+			records.resize(queries.size());
+			found.assign(queries.size(), 0);
+			window.clear();
+			windowFirst = 0;
+			std::vector<Record> probe;
+			for (size_t q = 0; q != queries.size() && count != 0; ++q)
+			{
+				if (window.empty() || PositionLess(window.back().Position, queries[q]))
+				{
+					size_t low = windowFirst + window.size();
+					size_t high = count;
+					while (high - low > WindowElements)
+					{
+						const size_t middle = low + (high - low) / 2;
+						if (!Read(file, middle, 1, probe)) return false;
+						if (PositionLess(probe[0].Position, queries[q]))
+							low = middle + 1;
+						else
+							high = middle;
+					}
+					if (low == count) break;
+					windowFirst = low;
+					if (!Read(file, low, std::min(WindowElements, count - low), window)) return false;
+				}
+
+				const auto record = std::lower_bound(window.begin(), window.end(), queries[q],
+					[](const Record& r, const DirectX::XMFLOAT3& p) { return PositionLess(r.Position, p); });
+				if (record != window.end() && SamePosition(record->Position, queries[q]))
+				{
+					records[q] = *record;
+					found[q] = 1;
+				}
+			}
+			return true;
+		}
+
+		size_t GetWindowBytes() const { return Bytes(window); }
+
+	private:
+		std::ifstream file;
+		size_t count = 0;
+		std::vector<Record> window;
+		size_t windowFirst = 0;
+	};
+
+	void SortUnique(std::vector<int>& indices)
+	{
+		std::sort(indices.begin(), indices.end());
+		indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+	}
+
+	void SortUnique(std::vector<DirectX::XMFLOAT3>& positions)
+	{
+		std::sort(positions.begin(), positions.end(), PositionLess);
+		positions.erase(std::unique(positions.begin(), positions.end(), SamePosition), positions.end());
+	}
+
+	int FindIndex(const std::vector<int>& sortedIndices, int index)
+	{
+		return int(std::lower_bound(sortedIndices.begin(), sortedIndices.end(), index) - sortedIndices.begin()) + 1;
+	}
+
+	size_t FindPosition(const std::vector<DirectX::XMFLOAT3>& sortedPositions, const DirectX::XMFLOAT3& position)
+	{
+		return size_t(std::lower_bound(sortedPositions.begin(), sortedPositions.end(), position, PositionLess) - sortedPositions.begin());
+	}
+
+	struct Readers
+	{
+		AttributeReader<DirectX::XMFLOAT3> Positions;
+		AttributeReader<DirectX::XMFLOAT3> Normals;
+		AttributeReader<DirectX::XMFLOAT2> TexCoords;
+		std::ifstream Faces;
+	};
+
+	// A submesh to cook: a range of the face spill, or a piece of a group split spatially when Piece is not empty
+	struct Job
+	{
+		int32_t Material;
+		uint64_t FirstFace;
+		size_t FaceCount;
+		std::string Piece;
+	};
+
+	// The faces of a job with only the attributes they use, indices remapped to them. Welds like the whole file would.
+	bool LoadJob(const Job& job, Readers& readers, bool texCoords, ObjData& local)
+	{
+		if (job.Piece.empty())
+		{
+			if (!Read(readers.Faces, job.FirstFace, job.FaceCount, local.Faces)) return false;
+		}
+		else
+		{
+			std::ifstream in(job.Piece, std::ios::binary);
+			std::vector<FaceRecord> records;
+			if (!Read(in, 0, job.FaceCount, records)) return false;
+			local.Faces.resize(records.size());
+			for (size_t f = 0; f != records.size(); ++f)
+				local.Faces[f] = records[f].Face;
+		}
+
+		std::vector<int> positions;
+		std::vector<int> normals;
+		std::vector<int> texcoords;
+		for (const ObjFace& face : local.Faces)
+			for (const ObjIndex& corner : face.Corners)
+			{
+				positions.push_back(corner.Position);
+				if (corner.Normal > 0) normals.push_back(corner.Normal);
+				if (texCoords && corner.TexCoord > 0) texcoords.push_back(corner.TexCoord);
+			}
+		SortUnique(positions);
+		SortUnique(normals);
+		SortUnique(texcoords);
+		if (!readers.Positions.Gather(positions, local.Positions) || !readers.Normals.Gather(normals, local.Normals) ||
+			!readers.TexCoords.Gather(texcoords, local.TexCoords))
+			return false;
+
+		// Positions out of range point at a zero one instead of outside the array
+		for (ObjFace& face : local.Faces)
+			for (ObjIndex& corner : face.Corners)
+			{
+				corner.Position = FindIndex(positions, corner.Position);
+				corner.Normal = corner.Normal > 0 ? FindIndex(normals, corner.Normal) : 0;
+				corner.TexCoord = texCoords && corner.TexCoord > 0 ? FindIndex(texcoords, corner.TexCoord) : 0;
+			}
+		return true;
+	}
+
+	size_t GetBytes(const ObjData& obj)
+	{
+		return Bytes(obj.Positions) + Bytes(obj.Normals) + Bytes(obj.TexCoords) + Bytes(obj.Faces);
+	}
+
+	size_t GetBytes(const MeshData& data)
+	{
+		return Bytes(data.Vertices) + Bytes(data.Indices) + Bytes(data.Submeshes) + Bytes(data.Lods) + Bytes(data.Clusters);
+	}
+
+	// The normal MeshCooker gives a corner, zero when the face has none
+	DirectX::XMFLOAT3 GetCornerNormal(const ObjData& local, const ObjFace& face, int corner)
+	{
+		DirectX::XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+		const int index = face.HasNormal ? face.Corners[corner].Normal : 0;
+		if (index > 0)
+			XMStoreFloat3(&normal, DirectX::XMVector3Normalize(XMLoadFloat3(&local.Normals[index - 1])));
+		return normal;
+	}
+
+	bool IsMissing(const DirectX::XMFLOAT3& normal)
+	{
+		return normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f;
+	}
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 Lower;
+		DirectX::XMFLOAT3 Upper;
+	};
+
+	Bounds EmptyBounds()
+	{
+		return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	}
+
+	void Grow(Bounds& bounds, const DirectX::XMFLOAT3& point)
+	{
+		bounds.Lower = { std::min(bounds.Lower.x, point.x), std::min(bounds.Lower.y, point.y), std::min(bounds.Lower.z, point.z) };
+		bounds.Upper = { std::max(bounds.Upper.x, point.x), std::max(bounds.Upper.y, point.y), std::max(bounds.Upper.z, point.z) };
+	}
+
+	float GetAxis(const DirectX::XMFLOAT3& point, int axis)
+	{
+		return axis == 0 ? point.x : axis == 1 ? point.y : point.z;
+	}
+
+	// Halves a piece along the longest axis of its centroids until every half fits in a job
+	bool SplitPiece(const std::string& piece, size_t count, const Bounds& bounds, int32_t material, size_t jobFaces,
+		SpillFiles& spills, std::vector<Job>& jobs, StreamingCookStats& stats)
+	{
+		if (count <= jobFaces)
+		{
+			jobs.push_back({ material, 0, count, piece });
+			return true;
+		}
+
+		int axis = 0;
+		for (int a = 1; a != 3; ++a)
+			if (GetAxis(bounds.Upper, a) - GetAxis(bounds.Lower, a) > GetAxis(bounds.Upper, axis) - GetAxis(bounds.Lower, axis)) axis = a;
+		const float lower = GetAxis(bounds.Lower, axis);
+		const float extent = GetAxis(bounds.Upper, axis) - lower;
+		const auto getBin = [&](const FaceRecord& record)
+		{
+			const float t = extent > 0.0f ? (GetAxis(record.Centroid, axis) - lower) / extent : 0.0f;
+			return std::min(SplitBins - 1, size_t(std::max(0.0f, t) * SplitBins));
+		};
+
+		// The bin where half the faces are reached, faces up to it go left
+		std::ifstream in(piece, std::ios::binary);
+		std::vector<FaceRecord> records;
+		std::vector<size_t> histogram(SplitBins);
+		for (size_t first = 0; first < count; first += jobFaces)
+		{
+			if (!Read(in, first, std::min(jobFaces, count - first), records)) return false;
+			for (const FaceRecord& record : records)
+				++histogram[getBin(record)];
+		}
+		size_t splitBin = 0;
+		size_t leftCount = histogram[0];
+		while (leftCount < count / 2)
+			leftCount += histogram[++splitBin];
+		// All in one bin, split in file order instead
+		const bool byOrder = leftCount == count;
+		if (byOrder) leftCount = count / 2;
+
+		const std::string left = spills.Add("piece");
+		const std::string right = spills.Add("piece");
+		Bounds leftBounds = EmptyBounds();
+		Bounds rightBounds = EmptyBounds();
+		{
+			std::ofstream leftOut(left, std::ios::binary | std::ios::trunc);
+			std::ofstream rightOut(right, std::ios::binary | std::ios::trunc);
+			std::vector<FaceRecord> leftRecords;
+			std::vector<FaceRecord> rightRecords;
+			for (size_t first = 0; first < count; first += jobFaces)
+			{
+				if (!Read(in, first, std::min(jobFaces, count - first), records)) return false;
+				leftRecords.clear();
+				rightRecords.clear();
+				for (size_t r = 0; r != records.size(); ++r)
+				{
+					const bool goesLeft = byOrder ? first + r < leftCount : getBin(records[r]) <= splitBin;
+					(goesLeft ? leftRecords : rightRecords).push_back(records[r]);
+					Grow(goesLeft ? leftBounds : rightBounds, records[r].Centroid);
+				}
+				Write(leftOut, leftRecords, stats);
+				Write(rightOut, rightRecords, stats);
+				Track(stats, Bytes(records) + Bytes(leftRecords) + Bytes(rightRecords) + Bytes(histogram));
+			}
+			if (!leftOut || !rightOut) return false;
+		}
+		in.close();
+		spills.Remove(piece);
+
+		return SplitPiece(left, leftCount, leftBounds, material, jobFaces, spills, jobs, stats) &&
+			SplitPiece(right, count - leftCount, rightBounds, material, jobFaces, spills, jobs, stats);
+	}
+
+	// Faces of a group with their centroids into a piece file, then split
+	bool SplitGroup(const ObjGroup& group, int32_t material, size_t jobFaces, Readers& readers, SpillFiles& spills,
+		std::vector<Job>& jobs, StreamingCookStats& stats)
+	{
+		const std::string piece = spills.Add("piece");
+		Bounds bounds = EmptyBounds();
+		{
+			std::ofstream out(piece, std::ios::binary | std::ios::trunc);
+			std::vector<ObjFace> faces;
+			std::vector<int> indices;
+			std::vector<DirectX::XMFLOAT3> positions;
+			std::vector<FaceRecord> records;
+			for (size_t first = 0; first < group.FaceCount; first += jobFaces)
+			{
+				if (!Read(readers.Faces, group.FirstFace + first, std::min(jobFaces, group.FaceCount - first), faces)) return false;
+				indices.clear();
+				for (const ObjFace& face : faces)
+					for (const ObjIndex& corner : face.Corners)
+						indices.push_back(corner.Position);
+				SortUnique(indices);
+				if (!readers.Positions.Gather(indices, positions)) return false;
+
+				records.resize(faces.size());
+				for (size_t f = 0; f != faces.size(); ++f)
+				{
+					DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+					for (const ObjIndex& corner : faces[f].Corners)
+						sum = DirectX::XMVectorAdd(sum, XMLoadFloat3(&positions[FindIndex(indices, corner.Position) - 1]));
+					records[f].Face = faces[f];
+					XMStoreFloat3(&records[f].Centroid, DirectX::XMVectorScale(sum, 1.0f / 3.0f));
+					Grow(bounds, records[f].Centroid);
+				}
+				Write(out, records, stats);
+				Track(stats, Bytes(faces) + Bytes(indices) + Bytes(positions) + Bytes(records));
+			}
+			if (!out) return false;
+		}
+		return SplitPiece(piece, group.FaceCount, bounds, material, jobFaces, spills, jobs, stats);
+	}
+}
+
+bool StreamingMeshCooker::Cook(const std::string& filename, const std::string& cookedFilename, uint64_t sourceHash,
+	const StreamingCookSettings& settings, StreamingCookStats& stats, const std::vector<SourceStamp>& sourceStamps)
+{
+	const Clock::time_point start = Clock::now();
+	stats = StreamingCookStats{};
+	const size_t pieceSize = std::min(MaxPieceSize, std::max(MinPieceSize, settings.MemoryBudget / 8));
+	const size_t jobFaces = std::max(MinJobFaces, settings.MemoryBudget / BytesPerFace);
+	const size_t runCount = std::max<size_t>(WindowElements, settings.MemoryBudget / 4 / sizeof(NormalRecord));
+
+	std::ifstream obj(filename, std::ios::binary);
+	if (!obj)
+	{
+		LOG_ERROR << "Failed to open OBJ file \"" << filename << "\"." << std::endl;
+		return false;
+	}
+	LOG_INFO << "OBJ file \"" << filename << "\" opened for streaming." << std::endl;
+
+	const std::string base = settings.TempFolder.empty() ? cookedFilename : settings.TempFolder + cookedFilename.substr(GetFolder(cookedFilename).size());
+	SpillFiles spills(base);
+	const std::string positionFile = spills.Add("positions");
+	const std::string normalFile = spills.Add("normals");
+	const std::string texCoordFile = spills.Add("texcoords");
+	const std::string faceFile = spills.Add("faces");
+	const auto fail = [&]()
+	{
+		LOG_ERROR << "Failed to stream OBJ file \"" << filename << "\" through spill files next to \"" << base << "\"." << std::endl;
+		return false;
+	};
+
+	// Attributes and faces go to their spill files a piece at a time, pieces end on whole lines
+	ObjStreamParser parser;
+	{
+		std::ofstream positionsOut(positionFile, std::ios::binary | std::ios::trunc);
+		std::ofstream normalsOut(normalFile, std::ios::binary | std::ios::trunc);
+		std::ofstream texCoordsOut(texCoordFile, std::ios::binary | std::ios::trunc);
+		std::ofstream facesOut(faceFile, std::ios::binary | std::ios::trunc);
+		// No larger than the file, a small OBJ should not cost a whole piece
+		obj.seekg(0, std::ios::end);
+		const uint64_t fileSize = uint64_t(obj.tellg());
+		obj.seekg(0, std::ios::beg);
+		std::vector<char> buffer(size_t(std::min<uint64_t>(pieceSize, fileSize + 1)));
+		size_t carried = 0;
+		for (;;)
+		{
+			obj.read(buffer.data() + carried, std::streamsize(buffer.size() - carried));
+			const size_t size = carried + size_t(obj.gcount());
+			stats.SourceBytes += uint64_t(obj.gcount());
+			if (obj.bad()) return fail();
+			const bool last = obj.eof();
+
+			size_t end = size;
+			if (!last)
+			{
+				while (end != 0 && buffer[end - 1] != '\n') --end;
+				// A line longer than the whole buffer
+				if (end == 0)
+				{
+					carried = size;
+					buffer.resize(buffer.size() * 2);
+					continue;
+				}
+			}
+
+			ObjData piece;
+			parser.Parse(buffer.data(), buffer.data() + end, piece);
+			Write(positionsOut, piece.Positions, stats);
+			Write(normalsOut, piece.Normals, stats);
+			Write(texCoordsOut, piece.TexCoords, stats);
+			Write(facesOut, piece.Faces, stats);
+			Track(stats, Bytes(buffer) + GetBytes(piece));
+
+			carried = size - end;
+			memmove(buffer.data(), buffer.data() + end, carried);
+			if (last) break;
+		}
+		if (!positionsOut || !normalsOut || !texCoordsOut || !facesOut) return fail();
+	}
+	obj.close();
+
+	// Everything but the vertices and indices, which are spilled as they are made
+	MeshData tables;
+	tables.MtlLib = parser.GetMtlLib();
+	MeshCooker::LoadMaterials(GetFolder(filename), tables.MtlLib, tables.Materials);
+
+	const ObjOffsets& counts = parser.GetOffsets();
+	Readers readers;
+	if (!readers.Positions.Open(positionFile, counts.Position) || !readers.Normals.Open(normalFile, counts.Normal) ||
+		!readers.TexCoords.Open(texCoordFile, counts.TexCoord))
+		return fail();
+	readers.Faces.open(faceFile, std::ios::binary);
+
+	// Groups too large for the budget are split into pieces that each become a submesh
+	std::vector<Job> jobs;
+	for (const ObjGroup& group : parser.GetGroups())
+	{
+		if (group.FaceCount == 0) continue;
+		++stats.Groups;
+		const int32_t material = MeshCooker::FindMaterial(tables.Materials, group.Material);
+		if (group.FaceCount <= jobFaces)
+			jobs.push_back({ material, group.FirstFace, group.FaceCount, "" });
+		else if (!SplitGroup(group, material, jobFaces, readers, spills, jobs, stats))
+			return fail();
+	}
+
+	const auto held = [&]()
+	{
+		return Bytes(jobs) + GetBytes(tables) + readers.Positions.GetWindowBytes() + readers.Normals.GetWindowBytes() +
+			readers.TexCoords.GetWindowBytes();
+	};
+
+	// What needs every submesh at once: face normals summed by position for corners without normals, and the
+	// positions several submeshes share, which simplification must not move
+	const std::string sumFile = spills.Add("sums");
+	const std::string sharedFile = spills.Add("shared");
+	size_t sumCount = 0;
+	size_t sharedCount = 0;
+	{
+		std::ofstream sumsOut(sumFile, std::ios::binary | std::ios::trunc);
+		std::ofstream sharedOut(sharedFile, std::ios::binary | std::ios::trunc);
+		std::vector<NormalRecord> normals;
+		std::vector<SharedRecord> shared;
+		for (size_t j = 0; j != jobs.size(); ++j)
+		{
+			ObjData local;
+			if (!LoadJob(jobs[j], readers, false, local)) return fail();
+
+			// In the order MeshCooker::GenerateNormals adds them, corners swapped for our winding
+			normals.clear();
+			for (const ObjFace& face : local.Faces)
+			{
+				if (!IsMissing(GetCornerNormal(local, face, 0)) || !IsMissing(GetCornerNormal(local, face, 1)) ||
+					!IsMissing(GetCornerNormal(local, face, 2)))
+					continue;
+				const DirectX::XMFLOAT3& p0 = local.Positions[face.Corners[0].Position - 1];
+				const DirectX::XMFLOAT3& p1 = local.Positions[face.Corners[2].Position - 1];
+				const DirectX::XMFLOAT3& p2 = local.Positions[face.Corners[1].Position - 1];
+				const DirectX::XMVECTOR p0Vector = XMLoadFloat3(&p0);
+				DirectX::XMFLOAT3 normal;
+				XMStoreFloat3(&normal, DirectX::XMVector3Cross(DirectX::XMVectorSubtract(XMLoadFloat3(&p1), p0Vector),
+					DirectX::XMVectorSubtract(XMLoadFloat3(&p2), p0Vector)));
+				for (const DirectX::XMFLOAT3* p : { &p0, &p1, &p2 })
+					normals.push_back({ *p, normal });
+			}
+			Write(sumsOut, normals, stats);
+			sumCount += normals.size();
+
+			SortUnique(local.Positions);
+			shared.resize(local.Positions.size());
+			for (size_t p = 0; p != local.Positions.size(); ++p)
+				shared[p] = { local.Positions[p], uint32_t(j) };
+			Write(sharedOut, shared, stats);
+			sharedCount += shared.size();
+			Track(stats, held() + GetBytes(local) + Bytes(normals) + Bytes(shared));
+		}
+		if (!sumsOut || !sharedOut) return fail();
+	}
+
+	if (!SortByPosition<NormalRecord>(sumFile, sumCount, runCount, spills, stats) ||
+		!SortByPosition<SharedRecord>(sharedFile, sharedCount, runCount, spills, stats))
+		return fail();
+
+	const std::string reducedSumFile = spills.Add("sums");
+	const std::string reducedSharedFile = spills.Add("shared");
+	size_t reducedSumCount = 0;
+	size_t reducedSharedCount = 0;
+	{
+		std::ofstream sumsOut(reducedSumFile, std::ios::binary | std::ios::trunc);
+		std::vector<NormalRecord> sum(1);
+		const bool summed = ForEachPosition<NormalRecord>(sumFile, sumCount, [&](const std::vector<NormalRecord>& same)
+		{
+			DirectX::XMVECTOR total = DirectX::XMVectorZero();
+			for (const NormalRecord& record : same)
+				total = DirectX::XMVectorAdd(total, XMLoadFloat3(&record.Normal));
+			sum[0].Position = same[0].Position;
+			XMStoreFloat3(&sum[0].Normal, total);
+			Write(sumsOut, sum, stats);
+			++reducedSumCount;
+		});
+
+		std::ofstream sharedOut(reducedSharedFile, std::ios::binary | std::ios::trunc);
+		const bool reduced = ForEachPosition<SharedRecord>(sharedFile, sharedCount, [&](const std::vector<SharedRecord>& same)
+		{
+			if (same.size() < 2) return;
+			Write(sharedOut, std::vector<SharedRecord>(1, same[0]), stats);
+			++reducedSharedCount;
+		});
+		if (!summed || !reduced || !sumsOut || !sharedOut) return fail();
+	}
+	spills.Remove(sumFile);
+	spills.Remove(sharedFile);
+
+	SortedTable<NormalRecord> sums;
+	SortedTable<SharedRecord> sharedPositions;
+	if (!sums.Open(reducedSumFile, reducedSumCount) || !sharedPositions.Open(reducedSharedFile, reducedSharedCount)) return fail();
+
+	// Every job through the same steps as MeshCooker::CookObj, full detail indices and levels of detail spilled apart
+	// so they end up in the same order as in a MeshData of the whole file
+	const std::string vertexFile = spills.Add("vertices");
+	const std::string indexFile = spills.Add("indices");
+	const std::string lodFile = spills.Add("lods");
+	size_t vertexTotal = 0;
+	size_t fullTotal = 0;
+	size_t lodTotal = 0;
+	{
+		std::ofstream verticesOut(vertexFile, std::ios::binary | std::ios::trunc);
+		std::ofstream indicesOut(indexFile, std::ios::binary | std::ios::trunc);
+		std::ofstream lodsOut(lodFile, std::ios::binary | std::ios::trunc);
+		std::vector<DirectX::XMFLOAT3> queries;
+		std::vector<NormalRecord> sumRecords;
+		std::vector<SharedRecord> sharedRecords;
+		std::vector<unsigned char> found;
+		for (const Job& job : jobs)
+		{
+			ObjData local;
+			if (!LoadJob(job, readers, true, local)) return fail();
+			MeshData data;
+			MeshCooker::WeldGroup(local, { "", 0, local.Faces.size() }, job.Material, data);
+			const size_t localBytes = GetBytes(local);
+			local = ObjData();
+
+			// Like MeshCooker::GenerateNormals, with the sums of the whole file
+			queries.clear();
+			for (const Vertex& vertex : data.Vertices)
+				if (IsMissing(vertex.Normal)) queries.push_back(vertex.Position);
+			SortUnique(queries);
+			if (!sums.Find(queries, sumRecords, found)) return fail();
+			for (Vertex& vertex : data.Vertices)
+			{
+				if (!IsMissing(vertex.Normal)) continue;
+				const size_t q = FindPosition(queries, vertex.Position);
+				if (found[q])
+					XMStoreFloat3(&vertex.Normal, DirectX::XMVector3Normalize(XMLoadFloat3(&sumRecords[q].Normal)));
+			}
+
+			MeshCooker::GenerateTangents(data, 1);
+			if (settings.Optimize)
+				MeshCooker::OptimizeSubmeshes(data);
+			MeshCooker::GenerateClusters(data);
+
+			queries.clear();
+			for (const Vertex& vertex : data.Vertices)
+				queries.push_back(vertex.Position);
+			SortUnique(queries);
+			if (!sharedPositions.Find(queries, sharedRecords, found)) return fail();
+			std::vector<unsigned char> locked(data.Vertices.size());
+			for (size_t v = 0; v != data.Vertices.size(); ++v)
+				locked[v] = found[FindPosition(queries, data.Vertices[v].Position)];
+			MeshCooker::GenerateLods(data, settings.LodChain, settings.Optimize, &locked);
+			Track(stats, held() + std::max(localBytes, GetBytes(data) + Bytes(queries) + Bytes(found) + Bytes(locked) +
+				Bytes(sumRecords) + Bytes(sharedRecords) + sums.GetWindowBytes() + sharedPositions.GetWindowBytes()));
+
+			// Offsets into the whole mesh, levels of detail after the full detail indices are moved past all of
+			// those once every job is done
+			SubmeshRange submesh = data.Submeshes[0];
+			const uint32_t fullCount = submesh.IndexCount;
+			for (uint32_t l = submesh.FirstLod; l != submesh.FirstLod + submesh.LodCount; ++l)
+			{
+				LodRange lod = data.Lods[l];
+				lod.FirstIndex = l == submesh.FirstLod ? uint32_t(fullTotal) : uint32_t(lodTotal + lod.FirstIndex - fullCount);
+				tables.Lods.push_back(lod);
+			}
+			for (uint32_t c = submesh.FirstCluster; c != submesh.FirstCluster + submesh.ClusterCount; ++c)
+			{
+				ClusterRange cluster = data.Clusters[c];
+				cluster.FirstIndex += uint32_t(fullTotal);
+				tables.Clusters.push_back(cluster);
+			}
+			submesh.FirstVertex = uint32_t(vertexTotal);
+			submesh.FirstIndex = uint32_t(fullTotal);
+			submesh.FirstLod = uint32_t(tables.Lods.size()) - submesh.LodCount;
+			submesh.FirstCluster = uint32_t(tables.Clusters.size()) - submesh.ClusterCount;
+			tables.Submeshes.push_back(submesh);
+
+			Write(verticesOut, data.Vertices, stats);
+			const std::vector<int> full(data.Indices.begin(), data.Indices.begin() + fullCount);
+			const std::vector<int> lods(data.Indices.begin() + fullCount, data.Indices.end());
+			Write(indicesOut, full, stats);
+			Write(lodsOut, lods, stats);
+			vertexTotal += data.Vertices.size();
+			fullTotal += full.size();
+			lodTotal += lods.size();
+		}
+		lodsOut.close();
+
+		// Levels of detail go after every full detail index
+		std::ifstream lodsIn(lodFile, std::ios::binary);
+		std::vector<int> window;
+		for (size_t first = 0; first < lodTotal; first += window.size())
+		{
+			if (!Read(lodsIn, first, std::min(WindowElements, lodTotal - first), window)) return fail();
+			Write(indicesOut, window, stats);
+		}
+		if (!verticesOut || !indicesOut || !lodsOut) return fail();
+	}
+	for (const SubmeshRange& submesh : tables.Submeshes)
+		for (uint32_t l = submesh.FirstLod + 1; l < submesh.FirstLod + submesh.LodCount; ++l)
+			tables.Lods[l].FirstIndex += uint32_t(fullTotal);
+	stats.Submeshes = tables.Submeshes.size();
+	if (reducedSumCount != 0)
+		LOG_INFO << "Generated normals for " << reducedSumCount << " positions." << std::endl;
+
+	if (!CookedMesh::Write(cookedFilename, tables, sourceHash, vertexFile, vertexTotal, indexFile, fullTotal + lodTotal, sourceStamps))
+		return false;
+
+	stats.Seconds = SecondsSince(start);
+	LOG_INFO << "Streamed OBJ \"" << filename << "\": " << stats.SourceBytes << " bytes in " << stats.Seconds * 1000.0 << " ms ("
+		<< stats.SourceBytes / stats.Seconds / 1e6 << " MB/s), " << stats.Groups << " groups into " << stats.Submeshes << " submeshes, peak "
+		<< stats.PeakMemory << " bytes held, " << stats.SpillBytes << " bytes spilled." << std::endl;
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MeshCooker.h"
+
+struct StreamingCookSettings
+{
+	// Roughly the most memory the cook holds at once. Groups with more faces than fit are split spatially.
+	size_t MemoryBudget;
+	// Where spill files go, with a trailing separator like GetFolder returns. Next to the cooked mesh when empty.
+	std::string TempFolder;
+	bool Optimize;
+	LodChainSettings LodChain;
+};
+
+struct StreamingCookStats
+{
+	double Seconds;
+	uint64_t SourceBytes;
+	// Everything written to spill files, some of it more than once
+	uint64_t SpillBytes;
+	size_t Groups;
+	// More than groups when some of them were split
+	size_t Submeshes;
+	// The most the cook's own buffers held at once
+	size_t PeakMemory;
+};
+
+// Cooks OBJs too large to have in memory, in passes over files instead of over arrays. Attributes and faces are spilled
+// to temporary files while the OBJ is read a piece at a time, then every group is welded, optimized, simplified and
+// clustered on its own and appended to spilled vertex and index sections, which CookedMesh::Write copies into the cooked
+// mesh. Groups that do not fit in the budget are split in half along their longest axis until they do. What needs all
+// groups at once, normals generated across submeshes and positions shared by several of them, goes through sorted
+// spill files.
+class StreamingMeshCooker
+{
+public:
+	// Mesh::LoadFromFile and AssetCooker cook OBJs at least this large with Cook
+	static const uint64_t Threshold = 256ull * 1024 * 1024;
+
+	static StreamingCookSettings DefaultSettings() { return { 512u * 1024 * 1024, "", true, MeshCooker::DefaultLodChain() }; }
+
+	// Writes the same cooked mesh as MeshCooker::CookObj without atlases followed by CookedMesh::Write as long as no
+	// group had to be split. Packing and merging need every submesh at once, so maps stay as they are. Logs a summary
+	// with the throughput and peak memory. sourceStamps go into the cooked mesh like with CookedMesh::Write.
+	static bool Cook(const std::string& filename, const std::string& cookedFilename, uint64_t sourceHash,
+		const StreamingCookSettings& settings, StreamingCookStats& stats,
+		const std::vector<SourceStamp>& sourceStamps = std::vector<SourceStamp>());
+};
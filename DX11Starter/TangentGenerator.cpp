@@ -0,0 +1,785 @@
+#include "TangentGenerator.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace
+{
+	// MikkTSpace treats everything within FLT_MIN of zero as zero
+	bool NotZero(float value)
+	{
+		return std::abs(value) > FLT_MIN;
+	}
+
+	// Fans are split where two frames disagree by more than the angular threshold. The default of 180 degrees
+	// comes out as exactly -1 in floats, so only frames pointing in exactly opposite directions split.
+	const float SplitCosine = -1.0f;
+
+	enum TriangleFlags
+	{
+		TriangleDegenerate = 1,
+		// No usable UV mapping, joins any fan and takes its orientation
+		TriangleGroupWithAny = 2,
+		TriangleOrientPreserving = 4,
+	};
+
+	// Triangle frame projected into the tangent plane of one corner, and the triangle's angle at that corner
+	struct CornerFrame
+	{
+		DirectX::XMFLOAT3 Os;
+		DirectX::XMFLOAT3 Ot;
+		float Angle;
+	};
+
+	// Vertices MikkTSpace sees as the same share a key. Adding 0 turns -0 into +0, MikkTSpace compares with ==.
+	struct VertexKey
+	{
+		uint32_t Bits[8];
+	};
+
+	VertexKey MakeKey(const Vertex& v)
+	{
+		const float values[8] = { v.Position.x + 0.0f, v.Position.y + 0.0f, v.Position.z + 0.0f,
+			v.Normal.x + 0.0f, v.Normal.y + 0.0f, v.Normal.z + 0.0f, v.UV.x + 0.0f, v.UV.y + 0.0f };
+		VertexKey key;
+		memcpy(key.Bits, values, sizeof(values));
+		return key;
+	}
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			uint64_t h = 14695981039346656037ull;
+			for (uint32_t bits : key.Bits)
+				h = (h ^ bits) * 1099511628211ull;
+			return size_t(h);
+		}
+	};
+
+	struct VertexKeyEqual
+	{
+		bool operator()(const VertexKey& a, const VertexKey& b) const
+		{
+			return memcmp(a.Bits, b.Bits, sizeof(a.Bits)) == 0;
+		}
+	};
+
+	// One three component vector per lane
+	struct Vector3x4
+	{
+		DirectX::XMVECTOR X, Y, Z;
+	};
+
+	Vector3x4 Gather(const Vertex* vertices, const int corners[4], DirectX::XMFLOAT3 Vertex::* member)
+	{
+		const DirectX::XMFLOAT3& a = vertices[corners[0]].*member;
+		const DirectX::XMFLOAT3& b = vertices[corners[1]].*member;
+		const DirectX::XMFLOAT3& c = vertices[corners[2]].*member;
+		const DirectX::XMFLOAT3& d = vertices[corners[3]].*member;
+		return { DirectX::XMVectorSet(a.x, b.x, c.x, d.x), DirectX::XMVectorSet(a.y, b.y, c.y, d.y), DirectX::XMVectorSet(a.z, b.z, c.z, d.z) };
+	}
+
+	Vector3x4 Add(const Vector3x4& a, const Vector3x4& b)
+	{
+		return { DirectX::XMVectorAdd(a.X, b.X), DirectX::XMVectorAdd(a.Y, b.Y), DirectX::XMVectorAdd(a.Z, b.Z) };
+	}
+
+	Vector3x4 Subtract(const Vector3x4& a, const Vector3x4& b)
+	{
+		return { DirectX::XMVectorSubtract(a.X, b.X), DirectX::XMVectorSubtract(a.Y, b.Y), DirectX::XMVectorSubtract(a.Z, b.Z) };
+	}
+
+	Vector3x4 Scale(DirectX::FXMVECTOR s, const Vector3x4& v)
+	{
+		return { DirectX::XMVectorMultiply(s, v.X), DirectX::XMVectorMultiply(s, v.Y), DirectX::XMVectorMultiply(s, v.Z) };
+	}
+
+	// Summed in the same order as MikkTSpace, so both round the same way
+	DirectX::XMVECTOR Dot(const Vector3x4& a, const Vector3x4& b)
+	{
+		return DirectX::XMVectorAdd(DirectX::XMVectorAdd(DirectX::XMVectorMultiply(a.X, b.X), DirectX::XMVectorMultiply(a.Y, b.Y)),
+			DirectX::XMVectorMultiply(a.Z, b.Z));
+	}
+
+	DirectX::XMVECTOR NotZero(DirectX::FXMVECTOR v)
+	{
+		return DirectX::XMVectorGreater(DirectX::XMVectorAbs(v), DirectX::XMVectorReplicate(FLT_MIN));
+	}
+
+	DirectX::XMVECTOR Equal(const Vector3x4& a, const Vector3x4& b)
+	{
+		return DirectX::XMVectorAndInt(DirectX::XMVectorAndInt(DirectX::XMVectorEqual(a.X, b.X), DirectX::XMVectorEqual(a.Y, b.Y)),
+			DirectX::XMVectorEqual(a.Z, b.Z));
+	}
+
+	// The part of v perpendicular to the unit vector n, normalized unless it is zero
+	Vector3x4 ProjectNormalize(const Vector3x4& v, const Vector3x4& n)
+	{
+		const Vector3x4 p = Subtract(v, Scale(Dot(n, v), n));
+		const DirectX::XMVECTOR notZero = DirectX::XMVectorOrInt(DirectX::XMVectorOrInt(NotZero(p.X), NotZero(p.Y)), NotZero(p.Z));
+		const Vector3x4 normalized = Scale(DirectX::XMVectorDivide(DirectX::XMVectorSplatOne(), DirectX::XMVectorSqrt(Dot(p, p))), p);
+		return { DirectX::XMVectorSelect(p.X, normalized.X, notZero), DirectX::XMVectorSelect(p.Y, normalized.Y, notZero),
+			DirectX::XMVectorSelect(p.Z, normalized.Z, notZero) };
+	}
+
+	void SetLanes(const Vector3x4& v, DirectX::XMFLOAT4 lanes[3])
+	{
+		DirectX::XMStoreFloat4(&lanes[0], v.X);
+		DirectX::XMStoreFloat4(&lanes[1], v.Y);
+		DirectX::XMStoreFloat4(&lanes[2], v.Z);
+	}
+
+	DirectX::XMFLOAT3 GetLane(const DirectX::XMFLOAT4 lanes[3], size_t lane)
+	{
+		return DirectX::XMFLOAT3((&lanes[0].x)[lane], (&lanes[1].x)[lane], (&lanes[2].x)[lane]);
+	}
+
+	// Flags of four triangles starting at first, and their frames at each corner
+	void ComputeFrames(const Vertex* vertices, const int* indices, size_t first, size_t triangleCount,
+		uint8_t* flags, CornerFrame* corners)
+	{
+		// Lanes past the end repeat the last triangle, their results are dropped
+		const size_t lanes = std::min<size_t>(4, triangleCount - first);
+		int corner[3][4];
+		for (size_t lane = 0; lane != 4; ++lane)
+		{
+			const size_t t = first + std::min(lane, lanes - 1);
+			for (int k = 0; k != 3; ++k)
+				corner[k][lane] = indices[t * 3 + k];
+		}
+
+		Vector3x4 p[3];
+		Vector3x4 n[3];
+		DirectX::XMVECTOR u[3];
+		DirectX::XMVECTOR v[3];
+		for (int k = 0; k != 3; ++k)
+		{
+			p[k] = Gather(vertices, corner[k], &Vertex::Position);
+			n[k] = Gather(vertices, corner[k], &Vertex::Normal);
+			const int* c = corner[k];
+			u[k] = DirectX::XMVectorSet(vertices[c[0]].UV.x, vertices[c[1]].UV.x, vertices[c[2]].UV.x, vertices[c[3]].UV.x);
+			v[k] = DirectX::XMVectorSet(vertices[c[0]].UV.y, vertices[c[1]].UV.y, vertices[c[2]].UV.y, vertices[c[3]].UV.y);
+		}
+
+		// Two corners in the same place
+		const DirectX::XMVECTOR degenerate = DirectX::XMVectorOrInt(DirectX::XMVectorOrInt(Equal(p[0], p[1]), Equal(p[0], p[2])), Equal(p[1], p[2]));
+
+		// Derivatives of the position along u and v, scaled by twice the UV area
+		const DirectX::XMVECTOR t21x = DirectX::XMVectorSubtract(u[1], u[0]);
+		const DirectX::XMVECTOR t21y = DirectX::XMVectorSubtract(v[1], v[0]);
+		const DirectX::XMVECTOR t31x = DirectX::XMVectorSubtract(u[2], u[0]);
+		const DirectX::XMVECTOR t31y = DirectX::XMVectorSubtract(v[2], v[0]);
+		const Vector3x4 d1 = Subtract(p[1], p[0]);
+		const Vector3x4 d2 = Subtract(p[2], p[0]);
+		const DirectX::XMVECTOR signedArea = DirectX::XMVectorSubtract(DirectX::XMVectorMultiply(t21x, t31y), DirectX::XMVectorMultiply(t21y, t31x));
+		Vector3x4 os = Subtract(Scale(t31y, d1), Scale(t21y, d2));
+		Vector3x4 ot = Add(Scale(DirectX::XMVectorNegate(t31x), d1), Scale(t21x, d2));
+
+		const DirectX::XMVECTOR orientPreserving = DirectX::XMVectorGreater(signedArea, DirectX::XMVectorZero());
+		const DirectX::XMVECTOR areaNotZero = NotZero(signedArea);
+		const DirectX::XMVECTOR absArea = DirectX::XMVectorAbs(signedArea);
+		const DirectX::XMVECTOR one = DirectX::XMVectorSplatOne();
+		const DirectX::XMVECTOR sign = DirectX::XMVectorSelect(DirectX::XMVectorNegate(one), one, orientPreserving);
+		const DirectX::XMVECTOR lengthOs = DirectX::XMVectorSqrt(Dot(os, os));
+		const DirectX::XMVECTOR lengthOt = DirectX::XMVectorSqrt(Dot(ot, ot));
+		os = Scale(DirectX::XMVectorSelect(one, DirectX::XMVectorDivide(sign, lengthOs), DirectX::XMVectorAndInt(areaNotZero, NotZero(lengthOs))), os);
+		ot = Scale(DirectX::XMVectorSelect(one, DirectX::XMVectorDivide(sign, lengthOt), DirectX::XMVectorAndInt(areaNotZero, NotZero(lengthOt))), ot);
+		const DirectX::XMVECTOR healthy = DirectX::XMVectorAndInt(areaNotZero, DirectX::XMVectorAndInt(
+			NotZero(DirectX::XMVectorDivide(lengthOs, absArea)), NotZero(DirectX::XMVectorDivide(lengthOt, absArea))));
+
+		uint32_t degenerateLanes[4];
+		uint32_t healthyLanes[4];
+		uint32_t orientLanes[4];
+		DirectX::XMStoreInt4(degenerateLanes, degenerate);
+		DirectX::XMStoreInt4(healthyLanes, healthy);
+		DirectX::XMStoreInt4(orientLanes, orientPreserving);
+		for (size_t lane = 0; lane != lanes; ++lane)
+		{
+			flags[first + lane] = uint8_t((degenerateLanes[lane] ? TriangleDegenerate : 0) | (healthyLanes[lane] ? 0 : TriangleGroupWithAny) |
+				(orientLanes[lane] ? TriangleOrientPreserving : 0));
+		}
+
+		for (int k = 0; k != 3; ++k)
+		{
+			const int previous = k > 0 ? k - 1 : 2;
+			const int next = k < 2 ? k + 1 : 0;
+			const Vector3x4 cornerOs = ProjectNormalize(os, n[k]);
+			const Vector3x4 cornerOt = ProjectNormalize(ot, n[k]);
+			const Vector3x4 edge1 = ProjectNormalize(Subtract(p[previous], p[k]), n[k]);
+			const Vector3x4 edge2 = ProjectNormalize(Subtract(p[next], p[k]), n[k]);
+			const DirectX::XMVECTOR angle = DirectX::XMVectorACos(DirectX::XMVectorClamp(Dot(edge1, edge2), DirectX::XMVectorNegate(one), one));
+
+			DirectX::XMFLOAT4 osLanes[3];
+			DirectX::XMFLOAT4 otLanes[3];
+			DirectX::XMFLOAT4 angleLanes;
+			SetLanes(cornerOs, osLanes);
+			SetLanes(cornerOt, otLanes);
+			DirectX::XMStoreFloat4(&angleLanes, angle);
+			for (size_t lane = 0; lane != lanes; ++lane)
+			{
+				CornerFrame& frame = corners[(first + lane) * 3 + k];
+				frame.Os = GetLane(osLanes, lane);
+				frame.Ot = GetLane(otLanes, lane);
+				frame.Angle = (&angleLanes.x)[lane];
+			}
+		}
+	}
+
+	float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// Angle weighted average of the frames of the healthy triangles among corners, in increasing order
+	DirectX::XMFLOAT3 AverageFrames(const int* corners, size_t count, const CornerFrame* frames, const uint8_t* flags)
+	{
+		DirectX::XMFLOAT3 sum(0.0f, 0.0f, 0.0f);
+		for (size_t i = 0; i != count; ++i)
+		{
+			if (flags[corners[i] / 3] & TriangleGroupWithAny) continue;
+			const CornerFrame& frame = frames[corners[i]];
+			sum.x = sum.x + frame.Angle * frame.Os.x;
+			sum.y = sum.y + frame.Angle * frame.Os.y;
+			sum.z = sum.z + frame.Angle * frame.Os.z;
+		}
+		if (!NotZero(sum.x) && !NotZero(sum.y) && !NotZero(sum.z)) return sum;
+		const float inverseLength = 1.0f / std::sqrt(Dot(sum, sum));
+		return DirectX::XMFLOAT3(inverseLength * sum.x, inverseLength * sum.y, inverseLength * sum.z);
+	}
+
+	// Port of mikktspace.c, kept close to the original structure and naming of the steps
+	namespace Reference
+	{
+		struct Vec3
+		{
+			float x, y, z;
+		};
+
+		Vec3 Make(const DirectX::XMFLOAT3& v) { return { v.x, v.y, v.z }; }
+		Vec3 Add(const Vec3& a, const Vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+		Vec3 Subtract(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		Vec3 Scale(float s, const Vec3& v) { return { s * v.x, s * v.y, s * v.z }; }
+		float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		float Length(const Vec3& v) { return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z); }
+		bool Equal(const Vec3& a, const Vec3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+		bool NotZero(const Vec3& v) { return ::NotZero(v.x) || ::NotZero(v.y) || ::NotZero(v.z); }
+		Vec3 Normalize(const Vec3& v) { return Scale(1.0f / Length(v), v); }
+
+		Vec3 ProjectNormalize(const Vec3& v, const Vec3& n)
+		{
+			const Vec3 p = Subtract(v, Scale(Dot(n, v), n));
+			return NotZero(p) ? Normalize(p) : p;
+		}
+
+		// Orders vertices by what MikkTSpace compares, with == semantics for the floats
+		struct VertexLess
+		{
+			bool operator()(const Vertex& a, const Vertex& b) const
+			{
+				const float va[8] = { a.Position.x, a.Position.y, a.Position.z, a.Normal.x, a.Normal.y, a.Normal.z, a.UV.x, a.UV.y };
+				const float vb[8] = { b.Position.x, b.Position.y, b.Position.z, b.Normal.x, b.Normal.y, b.Normal.z, b.UV.x, b.UV.y };
+				for (int i = 0; i != 8; ++i)
+				{
+					if (va[i] < vb[i]) return true;
+					if (vb[i] < va[i]) return false;
+				}
+				return false;
+			}
+		};
+
+		struct TriInfo
+		{
+			int FaceNeighbors[3];
+			int AssignedGroup[3];
+			Vec3 Os;
+			Vec3 Ot;
+			bool Degenerate;
+			bool GroupWithAny;
+			bool OrientPreserving;
+		};
+
+		struct Group
+		{
+			int VertexRepresentative;
+			bool OrientPreserving;
+			std::vector<int> FaceIndices;
+		};
+
+		struct Context
+		{
+			const Vertex* Vertices;
+			std::vector<int> TriList;
+			std::vector<TriInfo> TriInfos;
+			std::vector<Group> Groups;
+
+			Vec3 GetPosition(int index) const { return Make(Vertices[index].Position); }
+			Vec3 GetNormal(int index) const { return Make(Vertices[index].Normal); }
+			DirectX::XMFLOAT2 GetTexCoord(int index) const { return Vertices[index].UV; }
+		};
+
+		void InitTriInfo(Context& context, int f)
+		{
+			TriInfo& info = context.TriInfos[f];
+			for (int i = 0; i != 3; ++i)
+			{
+				info.FaceNeighbors[i] = -1;
+				info.AssignedGroup[i] = -1;
+			}
+			info.Os = info.Ot = { 0.0f, 0.0f, 0.0f };
+			info.GroupWithAny = true;
+			info.OrientPreserving = false;
+
+			const Vec3 v1 = context.GetPosition(context.TriList[f * 3]);
+			const Vec3 v2 = context.GetPosition(context.TriList[f * 3 + 1]);
+			const Vec3 v3 = context.GetPosition(context.TriList[f * 3 + 2]);
+			info.Degenerate = Equal(v1, v2) || Equal(v1, v3) || Equal(v2, v3);
+			if (info.Degenerate) return;
+
+			const DirectX::XMFLOAT2 t1 = context.GetTexCoord(context.TriList[f * 3]);
+			const DirectX::XMFLOAT2 t2 = context.GetTexCoord(context.TriList[f * 3 + 1]);
+			const DirectX::XMFLOAT2 t3 = context.GetTexCoord(context.TriList[f * 3 + 2]);
+			const float t21x = t2.x - t1.x;
+			const float t21y = t2.y - t1.y;
+			const float t31x = t3.x - t1.x;
+			const float t31y = t3.y - t1.y;
+			const Vec3 d1 = Subtract(v2, v1);
+			const Vec3 d2 = Subtract(v3, v1);
+
+			const float signedAreaSTx2 = t21x * t31y - t21y * t31x;
+			info.Os = Subtract(Scale(t31y, d1), Scale(t21y, d2));
+			info.Ot = Add(Scale(-t31x, d1), Scale(t21x, d2));
+			info.OrientPreserving = signedAreaSTx2 > 0.0f;
+
+			if (::NotZero(signedAreaSTx2))
+			{
+				const float absArea = std::abs(signedAreaSTx2);
+				const float lenOs = Length(info.Os);
+				const float lenOt = Length(info.Ot);
+				const float s = info.OrientPreserving ? 1.0f : -1.0f;
+				if (::NotZero(lenOs)) info.Os = Scale(s / lenOs, info.Os);
+				if (::NotZero(lenOt)) info.Ot = Scale(s / lenOt, info.Ot);
+				// MikkTSpace keeps these magnitudes for its full output, only whether they are zero matters here
+				if (::NotZero(lenOs / absArea) && ::NotZero(lenOt / absArea))
+					info.GroupWithAny = false;
+			}
+		}
+
+		void BuildNeighbors(Context& context)
+		{
+			std::map<std::pair<int, int>, std::vector<int>> edges;
+			for (int f = 0; f != int(context.TriInfos.size()); ++f)
+			{
+				if (context.TriInfos[f].Degenerate) continue;
+				for (int i = 0; i != 3; ++i)
+				{
+					const int i0 = context.TriList[f * 3 + i];
+					const int i1 = context.TriList[f * 3 + (i < 2 ? i + 1 : 0)];
+					edges[std::make_pair(std::min(i0, i1), std::max(i0, i1))].push_back(f);
+				}
+			}
+
+			// Every edge pairs up with the first later triangle that has it the other way around and no neighbor there yet
+			for (int f = 0; f != int(context.TriInfos.size()); ++f)
+			{
+				if (context.TriInfos[f].Degenerate) continue;
+				for (int i = 0; i != 3; ++i)
+				{
+					if (context.TriInfos[f].FaceNeighbors[i] != -1) continue;
+					const int i0 = context.TriList[f * 3 + i];
+					const int i1 = context.TriList[f * 3 + (i < 2 ? i + 1 : 0)];
+					for (int t : edges[std::make_pair(std::min(i0, i1), std::max(i0, i1))])
+					{
+						if (t <= f) continue;
+						int edge = -1;
+						for (int j = 0; j != 3; ++j)
+						{
+							if (context.TriList[t * 3 + j] == i1 && context.TriList[t * 3 + (j < 2 ? j + 1 : 0)] == i0) edge = j;
+						}
+						if (edge >= 0 && context.TriInfos[t].FaceNeighbors[edge] == -1)
+						{
+							context.TriInfos[f].FaceNeighbors[i] = t;
+							context.TriInfos[t].FaceNeighbors[edge] = f;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		bool AssignRecur(Context& context, int myTriIndex, int group)
+		{
+			TriInfo& info = context.TriInfos[myTriIndex];
+			const int vertRep = context.Groups[group].VertexRepresentative;
+			const int* verts = &context.TriList[myTriIndex * 3];
+			const int i = verts[0] == vertRep ? 0 : verts[1] == vertRep ? 1 : 2;
+
+			if (info.AssignedGroup[i] == group) return true;
+			if (info.AssignedGroup[i] != -1) return false;
+			if (info.GroupWithAny)
+			{
+				// The first fan to take in a triangle without UVs decides its orientation
+				if (info.AssignedGroup[0] == -1 && info.AssignedGroup[1] == -1 && info.AssignedGroup[2] == -1)
+					info.OrientPreserving = context.Groups[group].OrientPreserving;
+			}
+			if (info.OrientPreserving != context.Groups[group].OrientPreserving) return false;
+
+			context.Groups[group].FaceIndices.push_back(myTriIndex);
+			info.AssignedGroup[i] = group;
+
+			const int neighborL = info.FaceNeighbors[i];
+			const int neighborR = info.FaceNeighbors[i > 0 ? i - 1 : 2];
+			if (neighborL >= 0) AssignRecur(context, neighborL, group);
+			if (neighborR >= 0) AssignRecur(context, neighborR, group);
+			return true;
+		}
+
+		void Build4RuleGroups(Context& context)
+		{
+			for (int f = 0; f != int(context.TriInfos.size()); ++f)
+			{
+				if (context.TriInfos[f].Degenerate) continue;
+				for (int i = 0; i != 3; ++i)
+				{
+					if (context.TriInfos[f].AssignedGroup[i] != -1) continue;
+					const int group = int(context.Groups.size());
+					context.Groups.push_back({ context.TriList[f * 3 + i], context.TriInfos[f].OrientPreserving, std::vector<int>(1, f) });
+					context.TriInfos[f].AssignedGroup[i] = group;
+
+					const int neighborL = context.TriInfos[f].FaceNeighbors[i];
+					const int neighborR = context.TriInfos[f].FaceNeighbors[i > 0 ? i - 1 : 2];
+					if (neighborL >= 0) AssignRecur(context, neighborL, group);
+					if (neighborR >= 0) AssignRecur(context, neighborR, group);
+				}
+			}
+		}
+
+		Vec3 EvalTspace(const Context& context, const std::vector<int>& faces, int vertexRepresentative)
+		{
+			Vec3 os = { 0.0f, 0.0f, 0.0f };
+			for (int f : faces)
+			{
+				const TriInfo& info = context.TriInfos[f];
+				if (info.GroupWithAny) continue;
+
+				const int* verts = &context.TriList[f * 3];
+				const int i = verts[0] == vertexRepresentative ? 0 : verts[1] == vertexRepresentative ? 1 : 2;
+				const Vec3 n = context.GetNormal(verts[i]);
+				const Vec3 vOs = ProjectNormalize(info.Os, n);
+
+				// Weight by the angle between the two edges at the vertex
+				const Vec3 p0 = context.GetPosition(verts[i > 0 ? i - 1 : 2]);
+				const Vec3 p1 = context.GetPosition(verts[i]);
+				const Vec3 p2 = context.GetPosition(verts[i < 2 ? i + 1 : 0]);
+				const Vec3 v1 = ProjectNormalize(Subtract(p0, p1), n);
+				const Vec3 v2 = ProjectNormalize(Subtract(p2, p1), n);
+				float cosine = Dot(v1, v2);
+				cosine = cosine > 1.0f ? 1.0f : (cosine < -1.0f ? -1.0f : cosine);
+				const float angle = float(std::acos(double(cosine)));
+
+				os = Add(os, Scale(angle, vOs));
+			}
+			return NotZero(os) ? Normalize(os) : os;
+		}
+
+		void GenerateTSpaces(Context& context, std::vector<DirectX::XMFLOAT4>& cornerTangents)
+		{
+			for (int g = 0; g != int(context.Groups.size()); ++g)
+			{
+				const Group& group = context.Groups[g];
+				std::vector<std::vector<int>> subGroups;
+				std::vector<Vec3> subGroupTangents;
+				for (int f : group.FaceIndices)
+				{
+					const TriInfo& info = context.TriInfos[f];
+					const int index = info.AssignedGroup[0] == g ? 0 : info.AssignedGroup[1] == g ? 1 : 2;
+					const Vec3 n = context.GetNormal(context.TriList[f * 3 + index]);
+					const Vec3 vOs = ProjectNormalize(info.Os, n);
+					const Vec3 vOt = ProjectNormalize(info.Ot, n);
+
+					std::vector<int> members;
+					for (int t : group.FaceIndices)
+					{
+						const Vec3 vOs2 = ProjectNormalize(context.TriInfos[t].Os, n);
+						const Vec3 vOt2 = ProjectNormalize(context.TriInfos[t].Ot, n);
+						const bool any = info.GroupWithAny || context.TriInfos[t].GroupWithAny;
+						if (any || f == t || (Dot(vOs, vOs2) > SplitCosine && Dot(vOt, vOt2) > SplitCosine))
+							members.push_back(t);
+					}
+					std::sort(members.begin(), members.end());
+
+					size_t l = std::find(subGroups.begin(), subGroups.end(), members) - subGroups.begin();
+					if (l == subGroups.size())
+					{
+						subGroupTangents.push_back(EvalTspace(context, members, group.VertexRepresentative));
+						subGroups.push_back(members);
+					}
+					const Vec3& os = subGroupTangents[l];
+					cornerTangents[f * 3 + index] = DirectX::XMFLOAT4(os.x, os.y, os.z, group.OrientPreserving ? 1.0f : -1.0f);
+				}
+			}
+		}
+
+		void DegenEpilogue(const Context& context, std::vector<DirectX::XMFLOAT4>& cornerTangents)
+		{
+			for (int t = 0; t != int(context.TriInfos.size()); ++t)
+			{
+				if (!context.TriInfos[t].Degenerate) continue;
+				for (int i = 0; i != 3; ++i)
+				{
+					// First corner of a good triangle on the same vertex
+					const int index = context.TriList[t * 3 + i];
+					for (int j = 0; j != int(context.TriList.size()); ++j)
+					{
+						if (context.TriList[j] == index && !context.TriInfos[j / 3].Degenerate)
+						{
+							cornerTangents[t * 3 + i] = cornerTangents[j];
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void TangentGenerator::Generate(const Vertex* vertices, size_t vertexCount, const int* indices, size_t indexCount,
+	std::vector<Vertex>& outputVertices, std::vector<int>& outputIndices)
+{
+	const size_t triangleCount = indexCount / 3;
+	const size_t cornerCount = triangleCount * 3;
+
+	// Corners of the same MikkTSpace vertex get the same id
+	std::vector<int> ids(cornerCount);
+	{
+		std::unordered_map<VertexKey, int, VertexKeyHash, VertexKeyEqual> firstVertex;
+		firstVertex.reserve(vertexCount);
+		std::vector<int> vertexIds(vertexCount);
+		for (size_t v = 0; v != vertexCount; ++v)
+			vertexIds[v] = firstVertex.emplace(MakeKey(vertices[v]), int(v)).first->second;
+		for (size_t c = 0; c != cornerCount; ++c)
+			ids[c] = vertexIds[indices[c]];
+	}
+
+	std::vector<uint8_t> flags(triangleCount);
+	std::vector<CornerFrame> frames(cornerCount);
+	for (size_t t = 0; t < triangleCount; t += 4)
+		ComputeFrames(vertices, indices, t, triangleCount, flags.data(), frames.data());
+
+	// Neighbors across the edge from each corner to the next. Edges are sorted by their vertices and then by
+	// triangle, and each one pairs with the first later triangle that runs along it the other way.
+	struct Edge
+	{
+		uint64_t Key;
+		int Corner;
+	};
+	std::vector<Edge> edges;
+	edges.reserve(cornerCount);
+	for (size_t c = 0; c != cornerCount; ++c)
+	{
+		if (flags[c / 3] & TriangleDegenerate) continue;
+		const uint32_t a = uint32_t(ids[c]);
+		const uint32_t b = uint32_t(ids[c % 3 < 2 ? c + 1 : c - 2]);
+		edges.push_back({ (uint64_t(std::min(a, b)) << 32) | std::max(a, b), int(c) });
+	}
+	std::sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) { return x.Key != y.Key ? x.Key < y.Key : x.Corner < y.Corner; });
+
+	const auto nextCorner = [](int c) { return c % 3 < 2 ? c + 1 : c - 2; };
+	std::vector<int> neighbors(cornerCount, -1);
+	for (size_t e = 0; e != edges.size(); ++e)
+	{
+		const int c = edges[e].Corner;
+		if (neighbors[c] != -1) continue;
+		for (size_t j = e + 1; j != edges.size() && edges[j].Key == edges[e].Key; ++j)
+		{
+			const int other = edges[j].Corner;
+			if (neighbors[other] == -1 && ids[other] == ids[nextCorner(c)] && ids[nextCorner(other)] == ids[c])
+			{
+				neighbors[c] = other / 3;
+				neighbors[other] = c / 3;
+				break;
+			}
+		}
+	}
+
+	// Fans: triangles around a vertex connected through edges that agree on the UV orientation.
+	// The same depth first order as MikkTSpace's recursion, which decides the orientation of triangles without UVs.
+	struct Group
+	{
+		int Vertex;
+		bool OrientPreserving;
+		size_t FirstCorner;
+		size_t CornerCount;
+	};
+	std::vector<Group> groups;
+	std::vector<int> groupOf(cornerCount, -1);
+	std::vector<int> groupCorners;
+	std::vector<int> stack;
+	const auto cornerOf = [&ids](int face, int vertex) { return face * 3 + (ids[face * 3] == vertex ? 0 : ids[face * 3 + 1] == vertex ? 1 : 2); };
+	const auto pushNeighbors = [&](int c)
+	{
+		// Left is visited first, so it goes on the stack last
+		const int left = neighbors[c];
+		const int right = neighbors[c % 3 > 0 ? c - 1 : c + 2];
+		if (right >= 0) stack.push_back(right);
+		if (left >= 0) stack.push_back(left);
+	};
+	for (size_t c = 0; c != cornerCount; ++c)
+	{
+		if ((flags[c / 3] & TriangleDegenerate) || groupOf[c] != -1) continue;
+
+		const int g = int(groups.size());
+		const bool orient = (flags[c / 3] & TriangleOrientPreserving) != 0;
+		groups.push_back({ ids[c], orient, groupCorners.size(), 0 });
+		groupOf[c] = g;
+		groupCorners.push_back(int(c));
+		pushNeighbors(int(c));
+		while (!stack.empty())
+		{
+			const int face = stack.back();
+			stack.pop_back();
+			const int corner = cornerOf(face, ids[c]);
+			if (groupOf[corner] != -1) continue;
+
+			uint8_t& faceFlags = flags[face];
+			if ((faceFlags & TriangleGroupWithAny) && groupOf[face * 3] == -1 && groupOf[face * 3 + 1] == -1 && groupOf[face * 3 + 2] == -1)
+				faceFlags = uint8_t(orient ? faceFlags | TriangleOrientPreserving : faceFlags & ~TriangleOrientPreserving);
+			if (((faceFlags & TriangleOrientPreserving) != 0) != orient) continue;
+
+			groupOf[corner] = g;
+			groupCorners.push_back(corner);
+			pushNeighbors(corner);
+		}
+		groups.back().CornerCount = groupCorners.size() - groups.back().FirstCorner;
+	}
+
+	// Defaults of MikkTSpace for corners that never get a frame
+	std::vector<DirectX::XMFLOAT4> cornerTangents(cornerCount, DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, -1.0f));
+	std::vector<int> members;
+	for (const Group& group : groups)
+	{
+		int* corners = groupCorners.data() + group.FirstCorner;
+		const size_t count = group.CornerCount;
+		const float sign = group.OrientPreserving ? 1.0f : -1.0f;
+
+		// Fans almost never hold two healthy frames pointing in exactly opposite directions
+		bool split = false;
+		for (size_t a = 0; a != count && !split; ++a)
+		{
+			if (flags[corners[a] / 3] & TriangleGroupWithAny) continue;
+			for (size_t b = a + 1; b != count && !split; ++b)
+			{
+				if (flags[corners[b] / 3] & TriangleGroupWithAny) continue;
+				const CornerFrame& fa = frames[corners[a]];
+				const CornerFrame& fb = frames[corners[b]];
+				split = !(Dot(fa.Os, fb.Os) > SplitCosine && Dot(fa.Ot, fb.Ot) > SplitCosine);
+			}
+		}
+
+		if (!split)
+		{
+			// Corner order is triangle order
+			std::sort(corners, corners + count);
+			const DirectX::XMFLOAT3 os = AverageFrames(corners, count, frames.data(), flags.data());
+			for (size_t i = 0; i != count; ++i)
+				cornerTangents[corners[i]] = DirectX::XMFLOAT4(os.x, os.y, os.z, sign);
+			continue;
+		}
+
+		// Every corner averages over the frames that do not oppose its own
+		std::vector<std::vector<int>> subGroups;
+		std::vector<DirectX::XMFLOAT3> subGroupTangents;
+		for (size_t a = 0; a != count; ++a)
+		{
+			const CornerFrame& fa = frames[corners[a]];
+			const bool anyA = (flags[corners[a] / 3] & TriangleGroupWithAny) != 0;
+			members.clear();
+			for (size_t b = 0; b != count; ++b)
+			{
+				const CornerFrame& fb = frames[corners[b]];
+				const bool any = anyA || (flags[corners[b] / 3] & TriangleGroupWithAny);
+				if (any || a == b || (Dot(fa.Os, fb.Os) > SplitCosine && Dot(fa.Ot, fb.Ot) > SplitCosine))
+					members.push_back(corners[b]);
+			}
+			std::sort(members.begin(), members.end());
+
+			const size_t l = std::find(subGroups.begin(), subGroups.end(), members) - subGroups.begin();
+			if (l == subGroups.size())
+			{
+				subGroupTangents.push_back(AverageFrames(members.data(), members.size(), frames.data(), flags.data()));
+				subGroups.push_back(members);
+			}
+			const DirectX::XMFLOAT3& os = subGroupTangents[l];
+			cornerTangents[corners[a]] = DirectX::XMFLOAT4(os.x, os.y, os.z, sign);
+		}
+	}
+
+	// Corners of degenerate triangles copy the first good corner on the same vertex
+	std::vector<int> firstCorner(vertexCount, -1);
+	for (size_t c = 0; c != cornerCount; ++c)
+	{
+		if (!(flags[c / 3] & TriangleDegenerate) && firstCorner[ids[c]] == -1) firstCorner[ids[c]] = int(c);
+	}
+	for (size_t c = 0; c != cornerCount; ++c)
+	{
+		if ((flags[c / 3] & TriangleDegenerate) && firstCorner[ids[c]] != -1) cornerTangents[c] = cornerTangents[firstCorner[ids[c]]];
+	}
+
+	// Back to indexed vertices, with a copy for every further tangent a vertex ends up with
+	outputVertices.assign(vertices, vertices + vertexCount);
+	for (Vertex& vertex : outputVertices)
+		vertex.Tangent = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	outputIndices.assign(indices, indices + indexCount);
+	std::vector<unsigned char> assigned(vertexCount);
+	std::vector<int> nextCopy(vertexCount, -1);
+	for (size_t c = 0; c != cornerCount; ++c)
+	{
+		const DirectX::XMFLOAT4& tangent = cornerTangents[c];
+		int v = indices[c];
+		if (!assigned[v])
+		{
+			assigned[v] = 1;
+			outputVertices[v].Tangent = tangent;
+			continue;
+		}
+		while (memcmp(&outputVertices[v].Tangent, &tangent, sizeof(tangent)) != 0)
+		{
+			if (nextCopy[v] == -1)
+			{
+				nextCopy[v] = int(outputVertices.size());
+				nextCopy.push_back(-1);
+				outputVertices.push_back(vertices[indices[c]]);
+				outputVertices.back().Tangent = tangent;
+			}
+			v = nextCopy[v];
+		}
+		outputIndices[c] = v;
+	}
+}
+
+void TangentGenerator::GenerateReference(const Vertex* vertices, size_t, const int* indices, size_t indexCount,
+	std::vector<DirectX::XMFLOAT4>& cornerTangents)
+{
+	Reference::Context context;
+	context.Vertices = vertices;
+
+	// MikkTSpace welds corners with equal position, normal and UV itself
+	std::map<Vertex, int, Reference::VertexLess> firstVertex;
+	context.TriList.resize(indexCount / 3 * 3);
+	for (size_t i = 0; i != context.TriList.size(); ++i)
+		context.TriList[i] = firstVertex.emplace(vertices[indices[i]], indices[i]).first->second;
+
+	context.TriInfos.resize(indexCount / 3);
+	for (int f = 0; f != int(context.TriInfos.size()); ++f)
+		Reference::InitTriInfo(context, f);
+	Reference::BuildNeighbors(context);
+	Reference::Build4RuleGroups(context);
+
+	cornerTangents.assign(context.TriList.size(), DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, -1.0f));
+	Reference::GenerateTSpaces(context, cornerTangents);
+	Reference::DegenEpilogue(context, cornerTangents);
+}
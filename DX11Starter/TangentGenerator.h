@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Vertex.h"
+
+// Tangent frames for indexed triangle lists that match MikkTSpace (mikktspace.c by Morten S. Mikkelsen, with
+// the default settings of genTangSpaceDefault), so normal maps baked against it line up. Every triangle gets
+// a frame from its UV mapping, and the frames of the triangles in a fan around a vertex that agree on the UV
+// orientation are averaged, weighted by their angle at the vertex.
+class TangentGenerator
+{
+public:
+	// Replace the tangents of a triangle list. Vertices shared by fans that end up with different frames are
+	// split: they come out in their order with the copies appended, and indices keep their order.
+	// Normals must be normalized. Per triangle and per corner math runs on four triangles at once.
+	static void Generate(const Vertex* vertices, size_t vertexCount, const int* indices, size_t indexCount,
+		std::vector<Vertex>& outputVertices, std::vector<int>& outputIndices);
+
+	// Straight port of mikktspace.c, one float at a time, giving the tangent of every face corner.
+	// Reference for Generate.
+	static void GenerateReference(const Vertex* vertices, size_t vertexCount, const int* indices, size_t indexCount,
+		std::vector<DirectX::XMFLOAT4>& cornerTangents);
+};
@@ -0,0 +1,295 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Top edge of what is packed so far as a row of segments, left to right across the whole width
+	class Skyline
+	{
+	public:
+		Skyline(uint32_t width, uint32_t height) : width(width), height(height)
+		{
+			nodes.push_back({ 0, 0, width });
+		}
+
+		// Lowest place a rectangle fits, the leftmost of those
+		bool Find(uint32_t w, uint32_t h, uint32_t& x, uint32_t& y, size_t& node) const
+		{
+			bool found = false;
+			for (size_t i = 0; i != nodes.size(); ++i)
+			{
+				const uint32_t left = nodes[i].X;
+				if (left + w > width) break;
+				uint32_t top = 0;
+				for (size_t j = i; j != nodes.size() && nodes[j].X < left + w; ++j)
+					top = std::max(top, nodes[j].Y);
+				if (top + h > height || (found && top >= y)) continue;
+				found = true;
+				x = left;
+				y = top;
+				node = i;
+			}
+			return found;
+		}
+
+		// A rectangle at what Find returned
+		void Insert(size_t node, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+		{
+			nodes.insert(nodes.begin() + node, { x, y + h, w });
+
+			// Segments under it go, the last one only in part
+			const uint32_t end = x + w;
+			for (size_t i = node + 1; i < nodes.size();)
+			{
+				Node& n = nodes[i];
+				if (n.X >= end) break;
+				if (n.X + n.Width <= end)
+				{
+					nodes.erase(nodes.begin() + i);
+					continue;
+				}
+				n.Width = n.X + n.Width - end;
+				n.X = end;
+				break;
+			}
+
+			for (size_t i = 0; i + 1 < nodes.size();)
+			{
+				if (nodes[i].Y != nodes[i + 1].Y) { ++i; continue; }
+				nodes[i].Width += nodes[i + 1].Width;
+				nodes.erase(nodes.begin() + i + 1);
+			}
+		}
+
+		uint32_t GetHeight() const
+		{
+			uint32_t top = 0;
+			for (const Node& n : nodes)
+				top = std::max(top, n.Y);
+			return top;
+		}
+
+	private:
+		struct Node
+		{
+			uint32_t X;
+			uint32_t Y;
+			uint32_t Width;
+		};
+
+		uint32_t width;
+		uint32_t height;
+		std::vector<Node> nodes;
+	};
+
+	struct Crc32Table
+	{
+		uint32_t Entries[256];
+
+		Crc32Table()
+		{
+			for (uint32_t n = 0; n != 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k != 8; ++k)
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				Entries[n] = c;
+			}
+		}
+	};
+
+	uint32_t Crc32(const uint8_t* data, size_t size)
+	{
+		static const Crc32Table table;
+		uint32_t crc = ~0u;
+		for (size_t i = 0; i != size; ++i)
+			crc = table.Entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(uint8_t(value >> 24));
+		out.push_back(uint8_t(value >> 16));
+		out.push_back(uint8_t(value >> 8));
+		out.push_back(uint8_t(value));
+	}
+
+	void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		PutBigEndian(out, uint32_t(data.size()));
+		const size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		PutBigEndian(out, Crc32(out.data() + start, out.size() - start));
+	}
+}
+
+bool TextureAtlas::Pack(std::vector<AtlasImage>& images, const AtlasSettings& settings, std::vector<AtlasPage>& atlases)
+{
+	const uint32_t alignment = std::max(settings.Padding, 1u);
+	// Atlases are whole blocks, for block compression
+	const uint32_t step = std::max(alignment, 4u);
+
+	std::vector<size_t> pending;
+	for (size_t i = 0; i != images.size(); ++i)
+	{
+		AtlasImage& image = images[i];
+		image.Atlas = -1;
+		if (image.Width == 0 || image.Height == 0 || image.Width > settings.MaxImageSize || image.Height > settings.MaxImageSize) continue;
+		if (AlignUp(image.Width + 2 * settings.Padding, alignment) > settings.MaxAtlasSize
+			|| AlignUp(image.Height + 2 * settings.Padding, alignment) > settings.MaxAtlasSize)
+			continue;
+		pending.push_back(i);
+	}
+	if (pending.size() < 2) return false;
+
+	// Padded sizes, tallest first, then widest
+	const auto paddedWidth = [&](size_t i) { return AlignUp(images[i].Width + 2 * settings.Padding, alignment); };
+	const auto paddedHeight = [&](size_t i) { return AlignUp(images[i].Height + 2 * settings.Padding, alignment); };
+	std::stable_sort(pending.begin(), pending.end(), [&](size_t a, size_t b)
+	{
+		if (paddedHeight(a) != paddedHeight(b)) return paddedHeight(a) > paddedHeight(b);
+		return paddedWidth(a) > paddedWidth(b);
+	});
+
+	while (!pending.empty())
+	{
+		// The width that takes the most images, into the least area
+		uint32_t minWidth = step;
+		for (size_t i : pending)
+			minWidth = std::max(minWidth, AlignUp(paddedWidth(i), step));
+		uint32_t bestWidth = 0;
+		size_t bestCount = 0;
+		uint64_t bestArea = ~0ull;
+		for (uint32_t width = minWidth; width <= settings.MaxAtlasSize; width += step)
+		{
+			// Every image is at least as tall as the last one, no wider atlas can beat that area
+			if (bestCount == pending.size() && uint64_t(width) * paddedHeight(pending.front()) >= bestArea) break;
+
+			Skyline skyline(width, settings.MaxAtlasSize);
+			size_t count = 0;
+			for (size_t i : pending)
+			{
+				uint32_t x = 0;
+				uint32_t y = 0;
+				size_t node = 0;
+				if (!skyline.Find(paddedWidth(i), paddedHeight(i), x, y, node)) continue;
+				skyline.Insert(node, x, y, paddedWidth(i), paddedHeight(i));
+				++count;
+			}
+			const uint64_t area = uint64_t(width) * AlignUp(skyline.GetHeight(), step);
+			if (count > bestCount || (count == bestCount && area < bestArea))
+			{
+				bestWidth = width;
+				bestCount = count;
+				bestArea = area;
+			}
+		}
+		if (bestCount == 0) break;
+
+		// Again at the best width, keeping the places this time
+		AtlasPage page = { bestWidth, 0, 0 };
+		Skyline skyline(bestWidth, settings.MaxAtlasSize);
+		std::vector<size_t> left;
+		for (size_t i : pending)
+		{
+			uint32_t x = 0;
+			uint32_t y = 0;
+			size_t node = 0;
+			if (!skyline.Find(paddedWidth(i), paddedHeight(i), x, y, node))
+			{
+				left.push_back(i);
+				continue;
+			}
+			skyline.Insert(node, x, y, paddedWidth(i), paddedHeight(i));
+			AtlasImage& image = images[i];
+			image.Atlas = int(atlases.size());
+			image.X = x + settings.Padding;
+			image.Y = y + settings.Padding;
+			page.ImageTexels += size_t(image.Width) * image.Height;
+		}
+		page.Height = AlignUp(skyline.GetHeight(), step);
+		atlases.push_back(page);
+		pending.swap(left);
+	}
+	return true;
+}
+
+void TextureAtlas::Blit(const uint8_t* rgba, const AtlasImage& image, uint32_t padding, uint8_t* atlas, uint32_t atlasWidth)
+{
+	const int p = int(padding);
+	const int w = int(image.Width);
+	const int h = int(image.Height);
+	for (int y = -p; y != h + p; ++y)
+	{
+		const int sy = std::min(std::max(y, 0), h - 1);
+		uint8_t* row = atlas + (size_t(int(image.Y) + y) * atlasWidth + image.X) * 4;
+		for (int x = -p; x != w + p; ++x)
+		{
+			const int sx = std::min(std::max(x, 0), w - 1);
+			memcpy(row + x * 4, rgba + (size_t(sy) * w + sx) * 4, 4);
+		}
+	}
+}
+
+DirectX::XMFLOAT2 TextureAtlas::MapUv(const DirectX::XMFLOAT2& uv, const AtlasImage& image, const AtlasPage& atlas)
+{
+	return DirectX::XMFLOAT2((float(image.X) + uv.x * float(image.Width)) / float(atlas.Width),
+		(float(image.Y) + uv.y * float(image.Height)) / float(atlas.Height));
+}
+
+void TextureAtlas::EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& png)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	png.assign(signature, signature + 8);
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	// 8 bits per channel RGBA, deflate, adaptive filters, no interlacing
+	const uint8_t format[5] = { 8, 6, 0, 0, 0 };
+	header.insert(header.end(), format, format + 5);
+	PutChunk(png, "IHDR", header);
+
+	// Rows without filtering in stored deflate blocks of at most 65535 bytes, in a zlib stream
+	const size_t rowSize = size_t(width) * 4 + 1;
+	const size_t rawSize = rowSize * height;
+	std::vector<uint8_t> raw(rawSize);
+	for (uint32_t y = 0; y != height; ++y)
+	{
+		raw[y * rowSize] = 0;
+		memcpy(&raw[y * rowSize + 1], rgba + size_t(y) * width * 4, size_t(width) * 4);
+	}
+
+	std::vector<uint8_t> data = { 0x78, 0x01 };
+	size_t offset = 0;
+	do
+	{
+		const size_t size = std::min<size_t>(rawSize - offset, 65535);
+		data.push_back(offset + size == rawSize ? 1 : 0);
+		data.push_back(uint8_t(size));
+		data.push_back(uint8_t(size >> 8));
+		data.push_back(uint8_t(~size));
+		data.push_back(uint8_t(~size >> 8));
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+		offset += size;
+	} while (offset != rawSize);
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint8_t byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(data, (b << 16) | a);
+	PutChunk(png, "IDAT", data);
+	PutChunk(png, "IEND", {});
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+struct AtlasSettings
+{
+	// Images at most this large on both sides are packed, 0 turns atlases off
+	uint32_t MaxImageSize;
+	// Atlases are at most this large on either side
+	uint32_t MaxAtlasSize;
+	// Texels of its edge repeated around every image, a power of two. Images start at multiples of it, so mips up to
+	// log2(Padding) never filter in a neighbour.
+	uint32_t Padding;
+};
+
+// An image to pack, and where it went. Atlas is -1 for images that were not packed.
+struct AtlasImage
+{
+	uint32_t Width;
+	uint32_t Height;
+	int Atlas;
+	// Top left texel of the image itself, inside its padding
+	uint32_t X;
+	uint32_t Y;
+};
+
+// RGBA8 pixels of an image, rows of Width * 4 bytes
+struct AtlasBitmap
+{
+	uint32_t Width;
+	uint32_t Height;
+	std::vector<uint8_t> Pixels;
+};
+
+struct AtlasPage
+{
+	uint32_t Width;
+	uint32_t Height;
+	// Texels of the images packed into it, without padding
+	size_t ImageTexels;
+};
+
+// What MeshCooker::CookAtlases did to a model
+struct AtlasStats
+{
+	size_t ImagesPacked;
+	size_t Atlases;
+	size_t AtlasTexels;
+	size_t ImageTexels;
+	// Submeshes, texture views they bind between them and distinct images, before and after
+	size_t DrawsBefore;
+	size_t DrawsAfter;
+	size_t BindsBefore;
+	size_t BindsAfter;
+	size_t TexturesBefore;
+	size_t TexturesAfter;
+};
+
+// Packs small images into shared atlases, so the materials that sample them can become one. Images are placed with a
+// skyline, tallest first, into the atlas of the smallest area that takes all of them, more atlases when one of
+// MaxAtlasSize does not. Pure CPU work, MeshCooker decides what to pack and writes the results.
+class TextureAtlas
+{
+public:
+	// Places every image no larger than MaxImageSize, appending an AtlasPage per atlas used. Needs two such images
+	// at least, since an atlas of one saves nothing; returns false and places nothing otherwise.
+	static bool Pack(std::vector<AtlasImage>& images, const AtlasSettings& settings, std::vector<AtlasPage>& atlases);
+
+	// Copy RGBA8 pixels of an image to its place in an atlas of atlasWidth texels per row, with its edge repeated
+	// padding texels around it
+	static void Blit(const uint8_t* rgba, const AtlasImage& image, uint32_t padding, uint8_t* atlas, uint32_t atlasWidth);
+	// Where a UV of an image, in [0, 1], samples the atlas
+	static DirectX::XMFLOAT2 MapUv(const DirectX::XMFLOAT2& uv, const AtlasImage& image, const AtlasPage& atlas);
+
+	// RGBA8 pixels as a PNG the image decoder reads back, stored without compression
+	static void EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& png);
+};
@@ -0,0 +1,215 @@
+#include "TextureCooker.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "BlockCompressor.h"
+
+namespace
+{
+	const uint32_t DdsMagic = 0x20534444; // "DDS "
+
+	struct DdsPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		// Unused by DDS readers, holds the cooker's magic, version and the source hash
+		uint32_t Reserved1[11];
+		DdsPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	// The extension that carries a DXGI format, needed for BC7 and the sRGB formats
+	struct DdsHeaderDx10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	const size_t HeadersSize = sizeof(uint32_t) + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+
+	bool IsOpaque(const uint8_t* rgba, size_t pixelCount)
+	{
+		for (size_t i = 0; i != pixelCount; ++i)
+			if (rgba[i * 4 + 3] != 255) return false;
+		return true;
+	}
+
+	bool IsGray(const uint8_t* rgba, size_t pixelCount)
+	{
+		for (size_t i = 0; i != pixelCount; ++i)
+			if (rgba[i * 4 + 1] != rgba[i * 4] || rgba[i * 4 + 2] != rgba[i * 4]) return false;
+		return true;
+	}
+}
+
+DXGI_FORMAT TextureCooker::ChooseFormat(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage)
+{
+	const size_t pixelCount = size_t(width) * height;
+	switch (usage)
+	{
+	case TextureColor:
+		return IsOpaque(rgba, pixelCount) ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM_SRGB;
+	case TextureNormal:
+		return DXGI_FORMAT_BC5_UNORM;
+	default:
+		if (!IsOpaque(rgba, pixelCount)) return DXGI_FORMAT_BC3_UNORM;
+		return IsGray(rgba, pixelCount) ? DXGI_FORMAT_BC4_UNORM : DXGI_FORMAT_BC1_UNORM;
+	}
+}
+
+bool TextureCooker::CanCook(uint32_t width, uint32_t height)
+{
+	return width > 0 && height > 0 && width % 4 == 0 && height % 4 == 0;
+}
+
+MipSettings TextureCooker::GetMipSettings(TextureUsage usage)
+{
+	return { MipFilterKaiser, usage == TextureColor, usage == TextureNormal };
+}
+
+bool TextureCooker::Cook(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage, uint64_t sourceHash,
+	std::vector<uint8_t>& dds, unsigned threadCount)
+{
+	if (!CanCook(width, height)) return false;
+
+	const DXGI_FORMAT format = ChooseFormat(rgba, width, height, usage);
+	std::vector<MipLevel> levels;
+	MipGenerator::Generate(rgba, width, height, GetMipSettings(usage), levels, threadCount);
+	const uint32_t mipCount = uint32_t(levels.size());
+	size_t size = HeadersSize;
+	for (const MipLevel& level : levels)
+		size += BlockCompressor::GetCompressedSize(format, level.Width, level.Height);
+	dds.assign(size, 0);
+
+	DdsHeader header = {};
+	header.Size = sizeof(DdsHeader);
+	// Caps, height, width, pixel format, mip count and linear size
+	header.Flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+	header.Height = height;
+	header.Width = width;
+	header.PitchOrLinearSize = uint32_t(BlockCompressor::GetCompressedSize(format, width, height));
+	header.MipMapCount = mipCount;
+	header.Reserved1[0] = Magic;
+	header.Reserved1[1] = Version;
+	header.Reserved1[2] = uint32_t(sourceHash);
+	header.Reserved1[3] = uint32_t(sourceHash >> 32);
+	header.PixelFormat.Size = sizeof(DdsPixelFormat);
+	header.PixelFormat.Flags = 0x4;
+	header.PixelFormat.FourCC = 0x30315844; // "DX10"
+	// Texture, mipmap and complex
+	header.Caps = 0x1000 | 0x400000 | 0x8;
+
+	DdsHeaderDx10 extension = {};
+	extension.DxgiFormat = uint32_t(format);
+	extension.ResourceDimension = 3; // Texture2D
+	extension.ArraySize = 1;
+
+	memcpy(dds.data(), &DdsMagic, sizeof(DdsMagic));
+	memcpy(dds.data() + sizeof(DdsMagic), &header, sizeof(header));
+	memcpy(dds.data() + sizeof(DdsMagic) + sizeof(header), &extension, sizeof(extension));
+
+	size_t offset = HeadersSize;
+	for (const MipLevel& level : levels)
+	{
+		BlockCompressor::Compress(level.Pixels.data(), level.Width, level.Height, format, dds.data() + offset, threadCount);
+		offset += BlockCompressor::GetCompressedSize(format, level.Width, level.Height);
+	}
+	return true;
+}
+
+bool TextureCooker::IsUpToDate(const void* dds, size_t size, uint64_t sourceHash)
+{
+	if (size < HeadersSize) return false;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(dds);
+	uint32_t magic;
+	DdsHeader header;
+	memcpy(&magic, bytes, sizeof(magic));
+	memcpy(&header, bytes + sizeof(magic), sizeof(header));
+	return magic == DdsMagic && header.Reserved1[0] == Magic && header.Reserved1[1] == Version
+		&& header.Reserved1[2] == uint32_t(sourceHash) && header.Reserved1[3] == uint32_t(sourceHash >> 32);
+}
+
+bool TextureCooker::ReadLayout(const void* dds, size_t size, CookedTextureLayout& layout)
+{
+	if (size < HeadersSize) return false;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(dds);
+	uint32_t magic;
+	DdsHeader header;
+	DdsHeaderDx10 extension;
+	memcpy(&magic, bytes, sizeof(magic));
+	memcpy(&header, bytes + sizeof(magic), sizeof(header));
+	memcpy(&extension, bytes + sizeof(magic) + sizeof(header), sizeof(extension));
+	if (magic != DdsMagic || header.Reserved1[0] != Magic || header.Reserved1[1] != Version) return false;
+
+	layout.Format = DXGI_FORMAT(extension.DxgiFormat);
+	layout.Width = header.Width;
+	layout.Height = header.Height;
+	if (!BlockCompressor::IsSupported(layout.Format) || !CanCook(layout.Width, layout.Height)
+		|| header.MipMapCount == 0 || header.MipMapCount > MipGenerator::GetLevelCount(layout.Width, layout.Height))
+		return false;
+
+	layout.MipOffsets.clear();
+	layout.MipSizes.clear();
+	size_t offset = HeadersSize;
+	for (uint32_t level = 0; level != header.MipMapCount; ++level)
+	{
+		const size_t mipSize = BlockCompressor::GetCompressedSize(layout.Format, std::max(layout.Width >> level, 1u), std::max(layout.Height >> level, 1u));
+		if (mipSize > size - offset) return false;
+		layout.MipOffsets.push_back(offset);
+		layout.MipSizes.push_back(mipSize);
+		offset += mipSize;
+	}
+	return true;
+}
+
+bool TextureCooker::Write(const std::string& filename, const std::vector<uint8_t>& dds)
+{
+	// Write to a temporary file first so a crash never leaves a half written cache behind
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(dds.data()), std::streamsize(dds.size()));
+		if (!out)
+		{
+			out.close();
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <d3d11.h>
+#include "MipGenerator.h"
+
+// What a material samples a texture as, which decides its compressed format
+enum TextureUsage
+{
+	// Diffuse maps, sampled as sRGB
+	TextureColor,
+	// Tangent space normal maps, only x and y are kept and the shaders rebuild z
+	TextureNormal,
+	// Anything else sampled linearly, like occlusion or specular masks
+	TextureData,
+};
+
+// Where the mips of a cooked DDS are, for reading them one at a time
+struct CookedTextureLayout
+{
+	DXGI_FORMAT Format;
+	uint32_t Width;
+	uint32_t Height;
+	// Offset into the file and size of each mip, most detailed first
+	std::vector<size_t> MipOffsets;
+	std::vector<size_t> MipSizes;
+};
+
+// Turns decoded images into block compressed DDS files with a full mip chain, cached next to the source as
+// "<image>.dds". The loader creates textures from them as they are, instead of decoding the image and making
+// its mips on the GPU every start.
+class TextureCooker
+{
+public:
+	static const uint32_t Magic = 0x4b4f4f43; // "COOK"
+	// Bump whenever the encoder or the mip generation changes
+	static const uint32_t Version = 2;
+
+	// BC1 for opaque and BC7 for translucent color, BC5 for normals, and for data BC4 when the image is gray,
+	// BC1 when it is opaque and BC3 otherwise
+	static DXGI_FORMAT ChooseFormat(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage);
+	// The top level has to be whole blocks, smaller mips are padded
+	static bool CanCook(uint32_t width, uint32_t height);
+	// Kaiser filtered mips, in linear light for color and renormalized for normals
+	static MipSettings GetMipSettings(TextureUsage usage);
+
+	// Compress all mips of RGBA8 pixels into a DDS file image. The source hash goes into the header for IsUpToDate.
+	static bool Cook(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage, uint64_t sourceHash,
+		std::vector<uint8_t>& dds, unsigned threadCount = 1);
+	// True for a DDS this version of the cooker made from the source with this hash
+	static bool IsUpToDate(const void* dds, size_t size, uint64_t sourceHash);
+	// Format, size and mips of a DDS this cooker made, false if it is anything else or cut short
+	static bool ReadLayout(const void* dds, size_t size, CookedTextureLayout& layout);
+	// Through a temporary file, like cooked meshes. Does not log, it runs on loader threads.
+	static bool Write(const std::string& filename, const std::vector<uint8_t>& dds);
+};
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <chrono>
+#include "TextureManager.h"
+#include <DDSTextureLoader.h>
+#include "FileSystem.h"
+#include "ImageDecoder.h"
+#include "SimpleLogger.h"
+#include "TextureStreamer.h"
+#include "VirtualFile.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
+
+TextureManager::TextureManager(ID3D11Device* device, ID3D11DeviceContext* context, unsigned threadCount)
+{
+	this->device = device;
+	this->context = context;
+	streamer = nullptr;
+	pending = 0;
+	stopping = false;
+	stats = {};
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned t = 0; t < threadCount; ++t)
+		workers.emplace_back(&TextureManager::Work, this);
+
+	LOG_INFO << "TextureManager created at <0x" << this << "> with " << threadCount << " decode threads." << std::endl;
+}
+
+TextureManager::~TextureManager()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (std::thread& worker : workers) worker.join();
+
+	// Materials hold references of their own
+	for (Texture& texture : textures)
+		if (texture.View) { texture.View->Release(); }
+
+	LOG_INFO << "TextureManager destroyed at <0x" << this << ">." << std::endl;
+}
+
+void TextureManager::Request(const std::string& filename, TextureUsage usage, ID3D11ShaderResourceView** target, int* remaining)
+{
+	++stats.Requests;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto inserted = filesByPath.emplace(filename + "|" + std::to_string(int(usage)), int(files.size()));
+	if (inserted.second)
+	{
+		files.push_back({ filename, usage, -1, false, false });
+		// Both are read in the background while earlier files decode, the worker finds them in memory
+		VirtualFile::Preload({ filename, filename + ".dds" });
+		queue.push_back(inserted.first->second);
+		++pending;
+		++stats.Files;
+		workAvailable.notify_one();
+	}
+	targets.push_back({ inserted.first->second, target, remaining });
+	if (remaining) ++*remaining;
+}
+
+void TextureManager::Flush()
+{
+	const Clock::time_point start = Clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		workDone.wait(lock, [this] { return pending == 0; });
+	}
+	stats.WaitSeconds += SecondsSince(start);
+	Deliver();
+}
+
+void TextureManager::Update()
+{
+	Deliver();
+}
+
+void TextureManager::Deliver()
+{
+	// Workers only take the lock briefly around each file, creating textures under it does not hold them up long
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Texture& texture : textures)
+	{
+		if (!texture.Finished || (texture.Mips.empty() && texture.Dds.empty())) continue;
+		CreateTexture(texture);
+		++stats.Textures;
+		stats.ResidentBytes += texture.Bytes;
+		std::vector<MipLevel>().swap(texture.Mips);
+		std::vector<uint8_t>().swap(texture.Dds);
+	}
+
+	// Files with the contents of another one wait for that one's worker
+	const auto isDone = [this](const File& file) { return file.Done && (file.Texture < 0 || textures[file.Texture].Finished); };
+	size_t kept = 0;
+	for (const Target& target : targets)
+	{
+		const File& file = files[target.File];
+		if (!isDone(file))
+		{
+			targets[kept++] = target;
+			continue;
+		}
+		if (target.Remaining) --*target.Remaining;
+		if (file.Texture < 0 || !textures[file.Texture].Decoded) continue;
+
+		Texture& texture = textures[file.Texture];
+		if (texture.References++ > 0) stats.SavedBytes += texture.Bytes;
+		if (texture.View)
+		{
+			*target.View = texture.View;
+			texture.View->AddRef();
+		}
+	}
+	targets.resize(kept);
+
+	// Failures are only logged here, the workers do not log
+	for (File& file : files)
+	{
+		if (file.Logged || !isDone(file)) continue;
+		if (file.Texture < 0 || !textures[file.Texture].Decoded)
+			LOG_WARNING << "Failed to load texture file \"" << file.Filename << "\"." << std::endl;
+		else
+			LOG_INFO << "Load texture file \"" << file.Filename << "\"." << std::endl;
+		if (file.Texture >= 0 && textures[file.Texture].WriteFailed)
+		{
+			LOG_WARNING << "Failed to write cooked texture \"" << file.Filename << ".dds\"." << std::endl;
+			textures[file.Texture].WriteFailed = false;
+		}
+		file.Logged = true;
+	}
+}
+
+void TextureManager::LogStats() const
+{
+	LOG_INFO << "TextureManager: " << stats.Requests << " requests for " << stats.Files << " files, " << stats.Textures
+		<< " distinct textures in " << stats.ResidentBytes << " bytes, " << stats.SavedBytes << " bytes saved by sharing, "
+		<< stats.Cooked << " cooked and " << stats.CookedLoaded << " loaded cooked, " << stats.Streamed << " streamed. Decoding took "
+		<< stats.DecodeSeconds * 1000.0 << " ms on " << workers.size() << " threads, waited " << stats.WaitSeconds * 1000.0 << " ms." << std::endl;
+}
+
+void TextureManager::Work()
+{
+	ImageDecoder decoder;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) return;
+
+		const int file = queue.front();
+		queue.pop_front();
+		const std::string filename = files[file].Filename;
+		const TextureUsage usage = files[file].Usage;
+		lock.unlock();
+
+		const Clock::time_point start = Clock::now();
+		VirtualFile mapped;
+		int texture = -1;
+		std::vector<uint8_t> pixels;
+		std::vector<MipLevel> mips;
+		std::vector<uint8_t> dds;
+		UINT width = 0;
+		UINT height = 0;
+		bool decoded = false;
+		bool cooked = false;
+		bool writeFailed = false;
+		// Whether this worker decodes the texture, rather than finding one with the same contents
+		bool first = false;
+		// Opening logs when a file is missing, and the logger is not shared with the workers. Every texture
+		// has a worker of its own, so compressed files are decompressed on this one.
+		if (VirtualFile::Exists(filename) && mapped.Open(filename, 1))
+		{
+			// The first file with these contents decodes them, later ones only point at its texture
+			const uint64_t hash = HashData(mapped.GetData(), mapped.GetSize(), uint64_t(usage));
+			lock.lock();
+			const auto found = texturesByContent.find(hash);
+			if (found == texturesByContent.end())
+			{
+				texture = int(textures.size());
+				textures.push_back({ {}, {}, {}, usage, false, false, false, 0, nullptr, 0 });
+				texturesByContent.emplace(hash, texture);
+				first = true;
+			}
+			else
+				texture = found->second;
+			files[file].Texture = texture;
+			lock.unlock();
+
+			const std::string cookedFilename = filename + ".dds";
+			if (first)
+			{
+				VirtualFile cache;
+				if (VirtualFile::Exists(cookedFilename) && cache.Open(cookedFilename, 1) && TextureCooker::IsUpToDate(cache.GetData(), cache.GetSize(), hash))
+				{
+					dds.assign(cache.GetData(), cache.GetEnd());
+					decoded = true;
+				}
+			}
+			if (first && !decoded)
+			{
+				decoded = decoder.Decode(mapped.GetData(), mapped.GetSize(), pixels, width, height);
+				if (decoded && TextureCooker::Cook(pixels.data(), width, height, usage, hash, dds))
+				{
+					cooked = true;
+					writeFailed = !TextureCooker::Write(cookedFilename, dds);
+				}
+				else if (decoded)
+					MipGenerator::Generate(pixels.data(), width, height, TextureCooker::GetMipSettings(usage), mips);
+			}
+		}
+		const double seconds = SecondsSince(start);
+
+		lock.lock();
+		if (decoded)
+		{
+			Texture& t = textures[texture];
+			t.Mips = std::move(mips);
+			t.Dds = std::move(dds);
+			if (!t.Dds.empty() && !writeFailed) t.CookedFilename = filename + ".dds";
+			t.Decoded = true;
+			t.WriteFailed = writeFailed;
+			t.Bytes = t.Dds.size();
+			for (const MipLevel& mip : t.Mips)
+				t.Bytes += mip.Pixels.size();
+			if (cooked)
+				++stats.Cooked;
+			else if (!t.Dds.empty())
+				++stats.CookedLoaded;
+		}
+		if (first) textures[texture].Finished = true;
+		files[file].Done = true;
+		stats.DecodeSeconds += seconds;
+		if (--pending == 0) workDone.notify_all();
+	}
+}
+
+void TextureManager::CreateTexture(Texture& texture)
+{
+	if (!device) return;
+
+	// Cooked textures come with their mips and format, the streamer only creates the smallest ones
+	if (!texture.Dds.empty() && streamer && !texture.CookedFilename.empty())
+	{
+		const int streamed = streamer->Add(texture.CookedFilename, texture.Dds.data(), texture.Dds.size());
+		if (streamed >= 0)
+		{
+			texture.View = streamer->GetView(streamed);
+			texture.View->AddRef();
+			const TextureResidency& residency = streamer->GetResidency();
+			texture.Bytes = residency.GetBytes(streamed, residency.GetResidentMip(streamed));
+			++stats.Streamed;
+			return;
+		}
+	}
+	if (!texture.Dds.empty())
+	{
+		if (FAILED(DirectX::CreateDDSTextureFromMemory(device, texture.Dds.data(), texture.Dds.size(), nullptr, &texture.View)))
+			LOG_ERROR << "Failed to create a texture from a cooked DDS of " << texture.Dds.size() << " bytes." << std::endl;
+		return;
+	}
+
+	// Uncooked textures come with their mips made like the cooked ones, uploaded once
+	const MipLevel& top = texture.Mips.front();
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = top.Width;
+	desc.Height = top.Height;
+	desc.MipLevels = UINT(texture.Mips.size());
+	desc.ArraySize = 1;
+	desc.Format = texture.Usage == TextureColor ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(texture.Mips.size());
+	for (size_t level = 0; level != texture.Mips.size(); ++level)
+	{
+		data[level].pSysMem = texture.Mips[level].Pixels.data();
+		data[level].SysMemPitch = texture.Mips[level].Width * 4;
+		data[level].SysMemSlicePitch = 0;
+	}
+
+	ID3D11Texture2D* resource = nullptr;
+	if (FAILED(device->CreateTexture2D(&desc, data.data(), &resource)))
+	{
+		LOG_ERROR << "Failed to create a " << top.Width << "x" << top.Height << " texture." << std::endl;
+		return;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = desc.MipLevels;
+	device->CreateShaderResourceView(resource, &srvDesc, &texture.View);
+	resource->Release();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <d3d11.h>
+#include "TextureCooker.h"
+
+class TextureStreamer;
+
+struct TextureStats
+{
+	// Request calls, and the distinct files and distinct images among them
+	size_t Requests;
+	size_t Files;
+	size_t Textures;
+	// GPU memory of the distinct images with their mips, and what requests sharing one would have added
+	size_t ResidentBytes;
+	size_t SavedBytes;
+	// Images compressed this run, and images whose cooked DDS was already up to date
+	size_t Cooked;
+	size_t CookedLoaded;
+	// Cooked images handed to a TextureStreamer, resident with only their tails
+	size_t Streamed;
+	// Reading, hashing, decoding and cooking summed over the workers, and the time Flush waited for them
+	double DecodeSeconds;
+	double WaitSeconds;
+};
+
+// Loads the image files of materials. Files are read, hashed and decoded on worker threads while the caller goes
+// on; Flush then creates the textures, or Update each frame those done so far. Every image is decoded and resident
+// only once: requests for the same path, or for another file with the same contents (like the Eye1_0.png every
+// Pokemon model has), share one texture.
+// Decoded images are block compressed with their mips into "<image>.dds" by TextureCooker, and later runs load
+// that instead of the image while its source hash matches. Images of sizes that are not whole blocks stay RGBA8
+// with the same mips made by MipGenerator. Without a device images are still decoded and cooked, for benchmarking.
+// With a TextureStreamer, cooked images start with only their smallest mips and the streamer brings in the rest.
+class TextureManager
+{
+public:
+	// threadCount 0 picks one worker per core
+	TextureManager(ID3D11Device* device, ID3D11DeviceContext* context, unsigned threadCount = 0);
+	~TextureManager();
+
+	TextureManager(const TextureManager&) = delete;
+	TextureManager& operator=(const TextureManager&) = delete;
+
+	// Queue a file for loading as the given usage. On the Flush or Update that finds it done *target receives a
+	// reference to the shared view, which its owner releases like any other, or stays unchanged if the file fails to
+	// load. remaining, if given, is incremented now and decremented then either way. Both have to stay valid until
+	// then.
+	void Request(const std::string& filename, TextureUsage usage, ID3D11ShaderResourceView** target, int* remaining = nullptr);
+	// Wait for the queued files and create their textures. Only from the thread that calls Request.
+	void Flush();
+	// Create the textures of the files done so far and hand them out, without waiting for the rest, once a frame
+	// while loading in the background. Only from the thread that calls Request.
+	void Update();
+	// Requests not handed out yet
+	size_t GetPendingRequests() const { return targets.size(); }
+	// Cooked textures created by later Flushes are streamed by streamer, which has to outlive their materials' use
+	// of it. Materials still have to be added to it to get the finer mips.
+	void SetStreamer(TextureStreamer* s) { streamer = s; }
+
+	const TextureStats& GetStats() const { return stats; }
+	void LogStats() const;
+
+private:
+	// A distinct image
+	struct Texture
+	{
+		// Decoded RGBA8 mip chain, or the cooked DDS file, until Flush creates the texture
+		std::vector<MipLevel> Mips;
+		std::vector<uint8_t> Dds;
+		// Where the DDS is on disk, empty if it could not be written
+		std::string CookedFilename;
+		TextureUsage Usage;
+		bool Decoded;
+		// Cooked this run but the DDS could not be written, logged by Flush
+		bool WriteFailed;
+		// The worker that decodes it is done, whether it succeeded or not
+		bool Finished;
+		size_t Bytes;
+		ID3D11ShaderResourceView* View;
+		// Requests handed the view so far
+		size_t References;
+	};
+
+	// A distinct path, and the image its contents turned out to be
+	struct File
+	{
+		std::string Filename;
+		TextureUsage Usage;
+		int Texture;
+		// A worker is done with it, Texture is final
+		bool Done;
+		bool Logged;
+	};
+
+	struct Target
+	{
+		int File;
+		ID3D11ShaderResourceView** View;
+		int* Remaining;
+	};
+
+	void Work();
+	// Read, hash and, unless an earlier file had the same contents, decode
+	void Load(int file);
+	void CreateTexture(Texture& texture);
+	// Create what the workers finished and hand out the requests of done files
+	void Deliver();
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	TextureStreamer* streamer;
+
+	// Guards everything below that workers touch
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	std::deque<int> queue;
+	size_t pending;
+	bool stopping;
+	std::vector<std::thread> workers;
+
+	std::vector<File> files;
+	std::vector<Texture> textures;
+	std::unordered_map<std::string, int> filesByPath;
+	// Content hash seeded with the usage, the same image as color and as data is two textures
+	std::unordered_map<uint64_t, int> texturesByContent;
+	std::vector<Target> targets;
+
+	TextureStats stats;
+};
@@ -0,0 +1,197 @@
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cmath>
+
+TextureResidency::TextureResidency(TextureStreamingDevice& device, const TextureStreamingSettings& settings)
+	: device(device), settings(settings)
+{
+	frame = 0;
+	bias = 0;
+	loadingBytes = 0;
+	loadsInFlight = 0;
+	stats = {};
+}
+
+int TextureResidency::Add(uint32_t width, uint32_t height, const std::vector<size_t>& mipBytes, uint32_t coarsestFirstMip)
+{
+	Texture texture = {};
+	texture.Width = width;
+	texture.Height = height;
+	const uint32_t mipCount = std::max(uint32_t(mipBytes.size()), 1u);
+	texture.Bytes.assign(mipCount + 1, 0);
+	for (uint32_t m = uint32_t(mipBytes.size()); m-- > 0;)
+		texture.Bytes[m] = texture.Bytes[m + 1] + mipBytes[m];
+
+	texture.Tail = 0;
+	while (texture.Tail + 1 < mipCount && texture.Tail < coarsestFirstMip && std::max(width >> texture.Tail, height >> texture.Tail) > settings.TailSize)
+		++texture.Tail;
+	texture.Resident = texture.Tail;
+	texture.Desired = texture.Tail;
+	texture.Target = texture.Tail;
+	texture.Loading = texture.Tail;
+	texture.LastRequested = frame;
+	textures.push_back(std::move(texture));
+	return int(textures.size() - 1);
+}
+
+uint32_t TextureResidency::ComputeDesiredMip(uint32_t width, uint32_t height, uint32_t mipCount, float pixelsPerUv)
+{
+	if (mipCount == 0) return 0;
+	if (!(pixelsPerUv > 0.0f)) return mipCount - 1;
+
+	// Mip m has size >> m texels per UV unit, the coarsest one that still has a texel for every pixel
+	const float texelsPerPixel = float(std::max(width, height)) / pixelsPerUv;
+	if (texelsPerPixel <= 1.0f) return 0;
+	return std::min(uint32_t(std::floor(std::log2(texelsPerPixel))), mipCount - 1);
+}
+
+void TextureResidency::Request(int texture, float pixelsPerUv, float screenArea)
+{
+	Texture& t = textures[texture];
+	if (!t.Requested)
+	{
+		t.Requested = true;
+		t.PixelsPerUv = 0.0f;
+		t.ScreenArea = 0.0f;
+	}
+	t.PixelsPerUv = std::max(t.PixelsPerUv, pixelsPerUv);
+	t.ScreenArea += screenArea;
+}
+
+size_t TextureResidency::GetBiasedBytes(uint32_t bias) const
+{
+	size_t bytes = 0;
+	for (const Texture& t : textures)
+		bytes += t.Bytes[std::min(t.Desired + bias, t.Tail)];
+	return bytes;
+}
+
+void TextureResidency::Update()
+{
+	++frame;
+	stats = {};
+	stats.BudgetBytes = settings.BudgetBytes;
+
+	// Loads that finished get the mips they brought in, unless the texture wants fewer by now
+	finished.clear();
+	device.PollLoads(finished);
+	for (const TextureLoad& load : finished)
+	{
+		Texture& t = textures[load.Texture];
+		loadingBytes -= t.Bytes[t.Loading] - t.Bytes[t.Resident];
+		--loadsInFlight;
+		if (load.Succeeded)
+		{
+			t.Resident = std::min(t.Resident, std::max(load.FirstMip, t.Target));
+			device.SetResidentMip(load.Texture, t.Resident);
+			++stats.Loaded;
+		}
+		else
+		{
+			t.Failed = true;
+			++stats.Failed;
+		}
+		t.Loading = t.Resident;
+	}
+
+	// Requests of this frame, textures nobody asked for keep what they wanted for a while
+	for (Texture& t : textures)
+	{
+		const uint32_t mipCount = uint32_t(t.Bytes.size() - 1);
+		if (t.Requested)
+		{
+			t.Desired = ComputeDesiredMip(t.Width, t.Height, mipCount, t.PixelsPerUv);
+			t.Priority = t.ScreenArea;
+			t.LastRequested = frame;
+			t.Requested = false;
+		}
+		else if (frame - t.LastRequested > settings.KeepFrames)
+		{
+			t.Desired = mipCount - 1;
+			t.Priority = 0.0f;
+		}
+		stats.DesiredBytes += t.Bytes[std::min(t.Desired, t.Tail)];
+	}
+
+	// The smallest bias that fits, only lowered with some room to spare. If not even the tails fit nothing loads.
+	const size_t lowered = size_t(double(settings.BudgetBytes) * (1.0 - settings.BudgetHysteresis));
+	uint32_t maxBias = 0;
+	for (const Texture& t : textures)
+		maxBias = std::max(maxBias, t.Tail);
+	uint32_t newBias = maxBias;
+	for (uint32_t b = 0; b < maxBias; ++b)
+	{
+		if (GetBiasedBytes(b) <= (b < bias ? lowered : settings.BudgetBytes))
+		{
+			newBias = b;
+			break;
+		}
+	}
+	bias = newBias;
+
+	// What the bias leaves of the budget goes to the largest textures on screen, a mip finer each
+	byPriority.resize(textures.size());
+	for (size_t i = 0; i != textures.size(); ++i)
+	{
+		Texture& t = textures[i];
+		t.Target = std::min(t.Desired + bias, t.Tail);
+		byPriority[i] = int(i);
+	}
+	if (bias > 0)
+	{
+		std::stable_sort(byPriority.begin(), byPriority.end(), [this](int a, int b) { return textures[a].Priority > textures[b].Priority; });
+		const size_t biasedBytes = GetBiasedBytes(bias);
+		size_t spare = lowered > biasedBytes ? lowered - biasedBytes : 0;
+		for (int i : byPriority)
+		{
+			Texture& t = textures[i];
+			if (t.Priority <= 0.0f) break;
+			const uint32_t finer = std::min(t.Desired + bias - 1, t.Tail);
+			const size_t extra = t.Bytes[finer] - t.Bytes[t.Target];
+			if (finer == t.Target || extra > spare) continue;
+			t.Target = finer;
+			spare -= extra;
+			++stats.Boosted;
+		}
+	}
+
+	// Dropping mips frees memory right away, textures with a load in flight settle when it finishes
+	size_t residentBytes = 0;
+	candidates.clear();
+	for (size_t i = 0; i != textures.size(); ++i)
+	{
+		Texture& t = textures[i];
+		if (t.Target > t.Resident && t.Loading == t.Resident)
+		{
+			t.Resident = t.Target;
+			t.Loading = t.Target;
+			device.SetResidentMip(int(i), t.Target);
+			++stats.Evicted;
+		}
+		residentBytes += t.Bytes[t.Resident];
+		if (t.Target < t.Resident && t.Loading == t.Resident && !t.Failed)
+			candidates.push_back(int(i));
+	}
+
+	// Largest on screen first, skipping loads that do not fit yet for smaller ones that do
+	std::stable_sort(candidates.begin(), candidates.end(), [this](int a, int b) { return textures[a].Priority > textures[b].Priority; });
+	size_t started = 0;
+	for (int i : candidates)
+	{
+		if (loadsInFlight >= settings.MaxLoadsInFlight) break;
+		Texture& t = textures[i];
+		const size_t extra = t.Bytes[t.Target] - t.Bytes[t.Resident];
+		if (residentBytes + loadingBytes + extra > settings.BudgetBytes) continue;
+
+		t.Loading = t.Target;
+		loadingBytes += extra;
+		++loadsInFlight;
+		++started;
+		device.BeginLoad(i, t.Target);
+	}
+
+	stats.ResidentBytes = residentBytes;
+	stats.LoadsInFlight = loadsInFlight;
+	stats.PendingRequests = candidates.size() - started;
+	stats.MipBias = bias;
+}
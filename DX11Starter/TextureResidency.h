@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TextureStreamingSettings
+{
+	// GPU memory for the mips of all streamed textures
+	size_t BudgetBytes;
+	// Mips whose larger side is at most this many texels are always resident, and are all a texture has to start with
+	uint32_t TailSize;
+	// Loads that may be reading at once
+	unsigned MaxLoadsInFlight;
+	// Textures nobody requested keep their mips this many frames before they drop to the tail
+	unsigned KeepFrames;
+	// The mip bias only goes down once the finer mips fit in BudgetBytes * (1 - BudgetHysteresis),
+	// so a scene right at the budget does not stream the same mips in and out every frame
+	float BudgetHysteresis;
+};
+
+// One frame of streaming
+struct TextureStreamingStats
+{
+	size_t BudgetBytes;
+	size_t ResidentBytes;
+	// What the requested mips would take without the bias
+	size_t DesiredBytes;
+	// Loads reading, and textures still waiting for one
+	size_t LoadsInFlight;
+	size_t PendingRequests;
+	// Added to every desired mip to fit the budget
+	uint32_t MipBias;
+	// Textures given a mip finer than the bias with what it left of the budget
+	size_t Boosted;
+	// Loads finished and textures dropping mips this frame
+	size_t Loaded;
+	size_t Evicted;
+	size_t Failed;
+};
+
+// A load the device finished
+struct TextureLoad
+{
+	int Texture;
+	uint32_t FirstMip;
+	bool Succeeded;
+};
+
+// What TextureResidency drives. TextureStreamer implements it with D3D textures read from cooked DDS files,
+// benchmarks with a fake that only keeps count.
+class TextureStreamingDevice
+{
+public:
+	virtual ~TextureStreamingDevice() {}
+
+	// Start bringing mips firstMip and coarser of a texture into memory in the background
+	virtual void BeginLoad(int texture, uint32_t firstMip) = 0;
+	// Append the loads finished since the last call
+	virtual void PollLoads(std::vector<TextureLoad>& finished) = 0;
+	// Make firstMip the most detailed mip the texture has. Finer than before only with the mips of a load that just
+	// finished; every finished load is followed by this for its texture in the same Update, after which the device
+	// can let go of what it read.
+	virtual void SetResidentMip(int texture, uint32_t firstMip) = 0;
+};
+
+// Decides which mips of each texture are resident. Every frame the renderer requests textures with how many pixels
+// one UV unit covers on screen, which gives the mip each one wants; a texture takes the finest mip any request wants
+// and the screen area of all of them as its priority. If the wanted mips do not fit the budget, one mip bias is
+// added to all of them until they do, and what that leaves of the budget takes the textures largest on screen back
+// a mip. Textures over their target drop mips at once, textures under it are loaded largest screen area first, as
+// many at a time as the settings allow and only while what they add fits the budget.
+// Pure bookkeeping: nothing is read or created here, see TextureStreamer.
+class TextureResidency
+{
+public:
+	TextureResidency(TextureStreamingDevice& device, const TextureStreamingSettings& settings);
+
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	// A texture of mips of mipBytes bytes each, most detailed first, with the tail already resident on the device.
+	// Textures never start at a mip coarser than coarsestFirstMip, for devices that cannot make them, like block
+	// compressed ones smaller than a block. Returns its index for the other calls.
+	int Add(uint32_t width, uint32_t height, const std::vector<size_t>& mipBytes, uint32_t coarsestFirstMip = ~0u);
+
+	// The mip whose texels per UV unit are at least pixelsPerUv, clamped to the chain
+	static uint32_t ComputeDesiredMip(uint32_t width, uint32_t height, uint32_t mipCount, float pixelsPerUv);
+	// Seen this frame at pixelsPerUv, covering screenArea pixels
+	void Request(int texture, float pixelsPerUv, float screenArea);
+	// Once per frame after the requests: finish loads, pick the bias and start loads and evictions
+	void Update();
+
+	void SetSettings(const TextureStreamingSettings& s) { settings = s; }
+	const TextureStreamingSettings& GetSettings() const { return settings; }
+
+	size_t GetTextureCount() const { return textures.size(); }
+	uint32_t GetResidentMip(int texture) const { return textures[texture].Resident; }
+	uint32_t GetTargetMip(int texture) const { return textures[texture].Target; }
+	uint32_t GetDesiredMip(int texture) const { return textures[texture].Desired; }
+	uint32_t GetTailMip(int texture) const { return textures[texture].Tail; }
+	// Bytes of mips firstMip and coarser
+	size_t GetBytes(int texture, uint32_t firstMip) const { return textures[texture].Bytes[firstMip]; }
+	// Of the last Update
+	const TextureStreamingStats& GetStats() const { return stats; }
+
+private:
+	struct Texture
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Tail;
+		// Bytes of each mip and the coarser ones, with 0 past the end
+		std::vector<size_t> Bytes;
+		uint32_t Resident;
+		uint32_t Desired;
+		uint32_t Target;
+		// Mip a load is bringing in, or the resident one
+		uint32_t Loading;
+		bool Failed;
+		// Requests of this frame
+		bool Requested;
+		float PixelsPerUv;
+		float ScreenArea;
+		// Priority of the last frame it was requested
+		float Priority;
+		uint64_t LastRequested;
+	};
+
+	// Bytes of the desired mips with bias added, each at most at its tail
+	size_t GetBiasedBytes(uint32_t bias) const;
+
+	TextureStreamingDevice& device;
+	TextureStreamingSettings settings;
+	std::vector<Texture> textures;
+	uint64_t frame;
+	uint32_t bias;
+	// Bytes the loads in flight will add
+	size_t loadingBytes;
+	size_t loadsInFlight;
+	std::vector<TextureLoad> finished;
+	std::vector<int> candidates;
+	std::vector<int> byPriority;
+	TextureStreamingStats stats;
+};
@@ -0,0 +1,281 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include "BlockCompressor.h"
+#include "SimpleLogger.h"
+#include "VirtualFile.h"
+
+TextureStreamingSettings TextureStreamer::DefaultSettings()
+{
+	return { 64 * 1024 * 1024, 64, 4, 120, 0.1f };
+}
+
+TextureStreamer::TextureStreamer(ID3D11Device* device, ID3D11DeviceContext* context, const TextureStreamingSettings& settings)
+	: residency(*this, settings)
+{
+	this->device = device;
+	this->context = context;
+	stopping = false;
+	worker = std::thread(&TextureStreamer::Work, this);
+
+	LOG_INFO << "TextureStreamer created at <0x" << this << "> with a budget of " << settings.BudgetBytes << " bytes." << std::endl;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	worker.join();
+
+	// Materials hold references of their own
+	for (Texture& texture : textures)
+	{
+		if (texture.View) { texture.View->Release(); }
+		if (texture.Resource) { texture.Resource->Release(); }
+	}
+
+	LOG_INFO << "TextureStreamer destroyed at <0x" << this << ">." << std::endl;
+}
+
+int TextureStreamer::Add(const std::string& filename, const void* dds, size_t size)
+{
+	Texture texture = {};
+	if (!TextureCooker::ReadLayout(dds, size, texture.Layout))
+	{
+		LOG_WARNING << "\"" << filename << "\" is not a cooked texture, it is not streamed." << std::endl;
+		return -1;
+	}
+	texture.Filename = filename;
+
+	// Block compressed textures have to start at a mip of whole blocks
+	uint32_t coarsestFirstMip = 0;
+	while (coarsestFirstMip + 1 < texture.Layout.MipSizes.size()
+		&& TextureCooker::CanCook(texture.Layout.Width >> (coarsestFirstMip + 1), texture.Layout.Height >> (coarsestFirstMip + 1)))
+		++coarsestFirstMip;
+	const int index = residency.Add(texture.Layout.Width, texture.Layout.Height, texture.Layout.MipSizes, coarsestFirstMip);
+	const uint32_t tail = residency.GetTailMip(index);
+	const uint8_t* tailData = static_cast<const uint8_t*>(dds) + texture.Layout.MipOffsets[tail];
+	if (!CreateTexture(texture, tail, tailData, &texture.Resource, &texture.View))
+	{
+		// The residency keeps it at its tail for good, nothing is requested for it
+		textures.push_back(std::move(texture));
+		slots.emplace_back();
+		return -1;
+	}
+	texture.Resident = tail;
+	texture.FirstView = texture.View;
+	texturesByView[texture.View] = index;
+	textures.push_back(std::move(texture));
+	slots.emplace_back();
+	return index;
+}
+
+void TextureStreamer::AddSlot(Material* material, ID3D11ShaderResourceView** view)
+{
+	if (!*view) return;
+	const auto found = texturesByView.find(*view);
+	if (found == texturesByView.end()) return;
+
+	// Materials that got the first view catch up with the current one
+	Texture& texture = textures[found->second];
+	if (*view != texture.View)
+	{
+		(*view)->Release();
+		*view = texture.View;
+		texture.View->AddRef();
+	}
+	slots[found->second].push_back({ material, view });
+	texturesByMaterial[material].push_back(found->second);
+}
+
+void TextureStreamer::AddMaterial(Material* material)
+{
+	if (texturesByMaterial.count(material)) return;
+	AddSlot(material, &material->diffuseSrvPtr);
+	AddSlot(material, &material->normalSrvPtr);
+}
+
+void TextureStreamer::RemoveMaterial(Material* material)
+{
+	const auto found = texturesByMaterial.find(material);
+	if (found == texturesByMaterial.end()) return;
+	for (int texture : found->second)
+	{
+		std::vector<Slot>& textureSlots = slots[texture];
+		textureSlots.erase(std::remove_if(textureSlots.begin(), textureSlots.end(),
+			[material](const Slot& slot) { return slot.Owner == material; }), textureSlots.end());
+	}
+	texturesByMaterial.erase(found);
+}
+
+void TextureStreamer::Request(const Material* material, float pixelsPerUv, float screenArea)
+{
+	const auto found = texturesByMaterial.find(material);
+	if (found == texturesByMaterial.end()) return;
+	for (int texture : found->second)
+		residency.Request(texture, pixelsPerUv, screenArea);
+}
+
+void TextureStreamer::Update()
+{
+	residency.Update();
+
+	// Failures are only logged here, the logger is not shared with the worker
+	if (GetStats().Failed > 0)
+		LOG_WARNING << GetStats().Failed << " texture loads failed, their textures stay at the mips they have." << std::endl;
+}
+
+void TextureStreamer::LogStats() const
+{
+	const TextureStreamingStats& stats = GetStats();
+	LOG_INFO << "Texture streaming: " << stats.ResidentBytes << " of " << stats.BudgetBytes << " bytes resident, "
+		<< stats.DesiredBytes << " wanted, mip bias " << stats.MipBias << " with " << stats.Boosted << " textures a mip finer, " << stats.LoadsInFlight << " loads in flight and "
+		<< stats.PendingRequests << " waiting, " << stats.Loaded << " loaded and " << stats.Evicted << " dropped this frame." << std::endl;
+}
+
+void TextureStreamer::BeginLoad(int texture, uint32_t firstMip)
+{
+	const Texture& t = textures[texture];
+	const size_t offset = t.Layout.MipOffsets[firstMip];
+	const size_t size = t.Layout.MipOffsets.back() + t.Layout.MipSizes.back() - offset;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back({ texture, firstMip, t.Filename, offset, size, false, {} });
+	}
+	workAvailable.notify_one();
+}
+
+void TextureStreamer::PollLoads(std::vector<TextureLoad>& finished)
+{
+	std::vector<Load> loads;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loads.swap(done);
+	}
+	for (Load& load : loads)
+	{
+		finished.push_back({ load.Texture, load.FirstMip, load.Succeeded });
+		Texture& texture = textures[load.Texture];
+		texture.Data = std::move(load.Data);
+		texture.DataMip = load.FirstMip;
+	}
+}
+
+void TextureStreamer::SetResidentMip(int texture, uint32_t firstMip)
+{
+	Texture& t = textures[texture];
+	if (firstMip != t.Resident)
+	{
+		// Finer mips come from the load that just finished, coarser ones are all in the current texture
+		const uint8_t* data = nullptr;
+		if (firstMip < t.Resident)
+			data = t.Data.data() + (t.Layout.MipOffsets[firstMip] - t.Layout.MipOffsets[t.DataMip]);
+
+		ID3D11Texture2D* resource = nullptr;
+		ID3D11ShaderResourceView* view = nullptr;
+		if (CreateTexture(t, firstMip, data, &resource, &view))
+		{
+			for (const Slot& slot : slots[texture])
+			{
+				(*slot.View)->Release();
+				*slot.View = view;
+				view->AddRef();
+			}
+			if (t.View != t.FirstView) texturesByView.erase(t.View);
+			texturesByView[view] = texture;
+			t.View->Release();
+			t.Resource->Release();
+			t.View = view;
+			t.Resource = resource;
+			t.Resident = firstMip;
+		}
+	}
+	std::vector<uint8_t>().swap(t.Data);
+}
+
+bool TextureStreamer::CreateTexture(Texture& texture, uint32_t firstMip, const uint8_t* data, ID3D11Texture2D** resource, ID3D11ShaderResourceView** view)
+{
+	if (!device) return false;
+
+	const CookedTextureLayout& layout = texture.Layout;
+	const uint32_t mipCount = uint32_t(layout.MipSizes.size()) - firstMip;
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = std::max(layout.Width >> firstMip, 1u);
+	desc.Height = std::max(layout.Height >> firstMip, 1u);
+	desc.MipLevels = mipCount;
+	desc.ArraySize = 1;
+	desc.Format = layout.Format;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	// Not immutable, dropping mips later copies out of it
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData;
+	if (data)
+	{
+		initialData.resize(mipCount);
+		for (uint32_t level = 0; level != mipCount; ++level)
+		{
+			const uint32_t mip = firstMip + level;
+			initialData[level].pSysMem = data + (layout.MipOffsets[mip] - layout.MipOffsets[firstMip]);
+			initialData[level].SysMemPitch = UINT((std::max(layout.Width >> mip, 1u) + 3) / 4 * BlockCompressor::GetBlockSize(layout.Format));
+			initialData[level].SysMemSlicePitch = 0;
+		}
+	}
+
+	if (FAILED(device->CreateTexture2D(&desc, data ? initialData.data() : nullptr, resource)))
+	{
+		LOG_ERROR << "Failed to create mips " << firstMip << " and coarser of streamed texture \"" << texture.Filename << "\"." << std::endl;
+		return false;
+	}
+	if (!data)
+	{
+		for (uint32_t level = 0; level != mipCount; ++level)
+			context->CopySubresourceRegion(*resource, level, 0, 0, 0, texture.Resource, firstMip + level - texture.Resident, nullptr);
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = desc.MipLevels;
+	if (FAILED(device->CreateShaderResourceView(*resource, &srvDesc, view)))
+	{
+		LOG_ERROR << "Failed to create a view of streamed texture \"" << texture.Filename << "\"." << std::endl;
+		(*resource)->Release();
+		*resource = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void TextureStreamer::Work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+		// Loads still queued are of no use to anyone once the streamer goes
+		if (stopping) return;
+
+		Load load = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		// Opening logs when a file is missing, and the logger is not shared with the worker
+		VirtualFile file;
+		if (VirtualFile::Exists(load.Filename) && file.Open(load.Filename, 1) && load.Offset + load.Size <= file.GetSize())
+		{
+			load.Data.assign(file.GetData() + load.Offset, file.GetData() + load.Offset + load.Size);
+			load.Succeeded = true;
+		}
+
+		lock.lock();
+		done.push_back(std::move(load));
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <d3d11.h>
+#include "Material.h"
+#include "TextureCooker.h"
+#include "TextureResidency.h"
+
+// Streams the mips of cooked textures within a memory budget, as TextureResidency decides. A texture starts with
+// only its tail; finer mips are read from its cooked DDS on a worker thread and the texture is created again with
+// them on the thread that calls Update. Dropping mips copies the ones kept on the GPU. Every change makes a new
+// view, which materials added with AddMaterial get in place of the old one.
+class TextureStreamer : private TextureStreamingDevice
+{
+public:
+	// 64 MB for the streamed mips, tails of 64x64 and smaller
+	static TextureStreamingSettings DefaultSettings();
+
+	TextureStreamer(ID3D11Device* device, ID3D11DeviceContext* context, const TextureStreamingSettings& settings = DefaultSettings());
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// A cooked DDS in memory whose finer mips are read from filename later. Creates its tail and returns the index
+	// of the texture, -1 if it is not a DDS from TextureCooker or the texture cannot be created.
+	int Add(const std::string& filename, const void* dds, size_t size);
+	// The texture's view right now, without a reference for the caller
+	ID3D11ShaderResourceView* GetView(int texture) const { return textures[texture].View; }
+
+	// Keep the views of a material current. Views the streamer did not make are left alone. The material has to
+	// stay alive until it is removed or the streamer is gone.
+	void AddMaterial(Material* material);
+	void RemoveMaterial(Material* material);
+
+	// The textures of a material are on screen this frame, one UV unit covering pixelsPerUv pixels, the whole draw
+	// screenArea pixels
+	void Request(const Material* material, float pixelsPerUv, float screenArea);
+	// Once per frame, after the requests
+	void Update();
+
+	const TextureResidency& GetResidency() const { return residency; }
+	const TextureStreamingStats& GetStats() const { return residency.GetStats(); }
+	void LogStats() const;
+
+private:
+	struct Texture
+	{
+		std::string Filename;
+		CookedTextureLayout Layout;
+		uint32_t Resident;
+		ID3D11Texture2D* Resource;
+		ID3D11ShaderResourceView* View;
+		// The view Add returned, which materials may still hold
+		ID3D11ShaderResourceView* FirstView;
+		// Mips a finished load read, starting at DataMip
+		std::vector<uint8_t> Data;
+		uint32_t DataMip;
+	};
+
+	struct Slot
+	{
+		Material* Owner;
+		ID3D11ShaderResourceView** View;
+	};
+
+	struct Load
+	{
+		int Texture;
+		uint32_t FirstMip;
+		std::string Filename;
+		size_t Offset;
+		size_t Size;
+		bool Succeeded;
+		std::vector<uint8_t> Data;
+	};
+
+	void BeginLoad(int texture, uint32_t firstMip) override;
+	void PollLoads(std::vector<TextureLoad>& finished) override;
+	void SetResidentMip(int texture, uint32_t firstMip) override;
+
+	void Work();
+	// Mips firstMip and coarser, from data holding them one after another or copied from the current texture
+	bool CreateTexture(Texture& texture, uint32_t firstMip, const uint8_t* data, ID3D11Texture2D** resource, ID3D11ShaderResourceView** view);
+	void AddSlot(Material* material, ID3D11ShaderResourceView** view);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	TextureResidency residency;
+
+	std::vector<Texture> textures;
+	std::unordered_map<ID3D11ShaderResourceView*, int> texturesByView;
+	// Per texture, the material views showing it
+	std::vector<std::vector<Slot>> slots;
+	std::unordered_map<const Material*, std::vector<int>> texturesByMaterial;
+
+	// Guards everything below, the worker touches nothing else
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::deque<Load> queue;
+	std::vector<Load> done;
+	bool stopping;
+	std::thread worker;
+};
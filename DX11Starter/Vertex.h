@@ -12,5 +12,5 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
 	DirectX::XMFLOAT3 Normal;       // The normal of the vertex
 	DirectX::XMFLOAT2 UV;			// The texture uv of the vertex
-	DirectX::XMFLOAT3 Tangent;
+	DirectX::XMFLOAT4 Tangent;		// w is the handedness, the bitangent is cross(Normal, Tangent) * w
 };
\ No newline at end of file
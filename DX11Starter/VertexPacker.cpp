@@ -0,0 +1,249 @@
+#include "VertexPacker.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	uint16_t QuantizeUnorm16(float value, float offset, float scale)
+	{
+		if (scale <= 0.0f) return 0;
+		const float normalized = std::min(std::max((value - offset) / scale, 0.0f), 1.0f);
+		return uint16_t(normalized * 65535.0f + 0.5f);
+	}
+
+	float DequantizeUnorm16(uint16_t value, float offset, float scale)
+	{
+		return float(value) / 65535.0f * scale + offset;
+	}
+
+	int16_t QuantizeSnorm16(float value)
+	{
+		const float clamped = std::min(std::max(value, -1.0f), 1.0f);
+		return int16_t(std::floor(clamped * 32767.0f + 0.5f));
+	}
+
+	float DequantizeSnorm16(int16_t value)
+	{
+		// Like the GPU, -32768 and -32767 both map to -1
+		return std::max(float(value) / 32767.0f, -1.0f);
+	}
+
+	float AngleDegrees(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		const DirectX::XMVECTOR va = XMLoadFloat3(&a);
+		const DirectX::XMVECTOR vb = XMLoadFloat3(&b);
+		const float lengths = DirectX::XMVectorGetX(DirectX::XMVector3Length(va)) * DirectX::XMVectorGetX(DirectX::XMVector3Length(vb));
+		// Zero tangents (faces without UVs) carry no direction
+		if (lengths < 1e-12f) return 0.0f;
+		const float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(va, vb)) / lengths;
+		return std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / DirectX::XM_PI;
+	}
+
+	template <typename PackedType>
+	void PackAttributes(const Vertex& vertex, const VertexDequantization& dequantization, PackedType& packed)
+	{
+		VertexPacker::EncodeOctahedral(vertex.Normal, packed.Normal);
+		VertexPacker::EncodeTangent(vertex.Tangent, packed.Tangent);
+		packed.UV[0] = QuantizeUnorm16(vertex.UV.x, dequantization.UVOffset.x, dequantization.UVScale.x);
+		packed.UV[1] = QuantizeUnorm16(vertex.UV.y, dequantization.UVOffset.y, dequantization.UVScale.y);
+	}
+
+	template <typename PackedType>
+	void UnpackAttributes(const PackedType& packed, const VertexDequantization& dequantization, Vertex& vertex)
+	{
+		vertex.Normal = VertexPacker::DecodeOctahedral(packed.Normal);
+		vertex.Tangent = VertexPacker::DecodeTangent(packed.Tangent);
+		vertex.UV.x = DequantizeUnorm16(packed.UV[0], dequantization.UVOffset.x, dequantization.UVScale.x);
+		vertex.UV.y = DequantizeUnorm16(packed.UV[1], dequantization.UVOffset.y, dequantization.UVScale.y);
+	}
+}
+
+size_t VertexPacker::GetVertexSize(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormatPacked: return sizeof(PackedVertex);
+	case VertexFormatQuantized: return sizeof(QuantizedVertex);
+	default: return sizeof(Vertex);
+	}
+}
+
+const char* VertexPacker::GetFormatName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormatPacked: return "packed";
+	case VertexFormatQuantized: return "quantized";
+	default: return "full";
+	}
+}
+
+VertexDequantization VertexPacker::ComputeDequantization(const Vertex* vertices, size_t count, VertexFormat format)
+{
+	VertexDequantization dequantization{};
+	dequantization.PositionScale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+	dequantization.UVScale = DirectX::XMFLOAT2(1.0f, 1.0f);
+	if (count == 0) return dequantization;
+
+	DirectX::XMFLOAT3 lower = { FLT_MAX, FLT_MAX, FLT_MAX };
+	DirectX::XMFLOAT3 upper = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	DirectX::XMFLOAT2 uvLower = { FLT_MAX, FLT_MAX };
+	DirectX::XMFLOAT2 uvUpper = { -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i != count; ++i)
+	{
+		const Vertex& v = vertices[i];
+		lower = DirectX::XMFLOAT3(std::min(lower.x, v.Position.x), std::min(lower.y, v.Position.y), std::min(lower.z, v.Position.z));
+		upper = DirectX::XMFLOAT3(std::max(upper.x, v.Position.x), std::max(upper.y, v.Position.y), std::max(upper.z, v.Position.z));
+		uvLower = DirectX::XMFLOAT2(std::min(uvLower.x, v.UV.x), std::min(uvLower.y, v.UV.y));
+		uvUpper = DirectX::XMFLOAT2(std::max(uvUpper.x, v.UV.x), std::max(uvUpper.y, v.UV.y));
+	}
+
+	// UVs are unorm16 over their own range. That covers tiling UVs outside [0, 1]
+	// and is more precise than half floats, which lose bits above 0.5.
+	dequantization.UVOffset = uvLower;
+	dequantization.UVScale = DirectX::XMFLOAT2(uvUpper.x - uvLower.x, uvUpper.y - uvLower.y);
+
+	if (format == VertexFormatQuantized)
+	{
+		dequantization.PositionOffset = lower;
+		dequantization.PositionScale = DirectX::XMFLOAT3(upper.x - lower.x, upper.y - lower.y, upper.z - lower.z);
+	}
+	return dequantization;
+}
+
+void VertexPacker::Pack(const Vertex* vertices, size_t count, VertexFormat format, const VertexDequantization& dequantization, void* output)
+{
+	if (format == VertexFormatPacked)
+	{
+		PackedVertex* packed = static_cast<PackedVertex*>(output);
+		for (size_t i = 0; i != count; ++i)
+		{
+			packed[i].Position = vertices[i].Position;
+			PackAttributes(vertices[i], dequantization, packed[i]);
+		}
+	}
+	else if (format == VertexFormatQuantized)
+	{
+		QuantizedVertex* packed = static_cast<QuantizedVertex*>(output);
+		for (size_t i = 0; i != count; ++i)
+		{
+			const DirectX::XMFLOAT3& p = vertices[i].Position;
+			packed[i].Position[0] = QuantizeUnorm16(p.x, dequantization.PositionOffset.x, dequantization.PositionScale.x);
+			packed[i].Position[1] = QuantizeUnorm16(p.y, dequantization.PositionOffset.y, dequantization.PositionScale.y);
+			packed[i].Position[2] = QuantizeUnorm16(p.z, dequantization.PositionOffset.z, dequantization.PositionScale.z);
+			packed[i].Position[3] = 0;
+			PackAttributes(vertices[i], dequantization, packed[i]);
+		}
+	}
+	else
+	{
+		std::copy(vertices, vertices + count, static_cast<Vertex*>(output));
+	}
+}
+
+void VertexPacker::Unpack(const void* packed, size_t count, VertexFormat format, const VertexDequantization& dequantization, Vertex* output)
+{
+	if (format == VertexFormatPacked)
+	{
+		const PackedVertex* input = static_cast<const PackedVertex*>(packed);
+		for (size_t i = 0; i != count; ++i)
+		{
+			output[i].Position = input[i].Position;
+			UnpackAttributes(input[i], dequantization, output[i]);
+		}
+	}
+	else if (format == VertexFormatQuantized)
+	{
+		const QuantizedVertex* input = static_cast<const QuantizedVertex*>(packed);
+		for (size_t i = 0; i != count; ++i)
+		{
+			output[i].Position.x = DequantizeUnorm16(input[i].Position[0], dequantization.PositionOffset.x, dequantization.PositionScale.x);
+			output[i].Position.y = DequantizeUnorm16(input[i].Position[1], dequantization.PositionOffset.y, dequantization.PositionScale.y);
+			output[i].Position.z = DequantizeUnorm16(input[i].Position[2], dequantization.PositionOffset.z, dequantization.PositionScale.z);
+			UnpackAttributes(input[i], dequantization, output[i]);
+		}
+	}
+	else
+	{
+		const Vertex* input = static_cast<const Vertex*>(packed);
+		std::copy(input, input + count, output);
+	}
+}
+
+QuantizationError VertexPacker::MeasureError(const Vertex* original, const Vertex* unpacked, size_t count)
+{
+	QuantizationError error{};
+	for (size_t i = 0; i != count; ++i)
+	{
+		const Vertex& a = original[i];
+		const Vertex& b = unpacked[i];
+		error.Position = std::max(error.Position, std::max(std::max(std::abs(a.Position.x - b.Position.x), std::abs(a.Position.y - b.Position.y)),
+			std::abs(a.Position.z - b.Position.z)));
+		error.NormalDegrees = std::max(error.NormalDegrees, AngleDegrees(a.Normal, b.Normal));
+		error.TangentDegrees = std::max(error.TangentDegrees, AngleDegrees(DirectX::XMFLOAT3(a.Tangent.x, a.Tangent.y, a.Tangent.z),
+			DirectX::XMFLOAT3(b.Tangent.x, b.Tangent.y, b.Tangent.z)));
+		if ((a.Tangent.w < 0.0f) != (b.Tangent.w < 0.0f)) ++error.HandednessMismatches;
+		error.UV = std::max(error.UV, std::max(std::abs(a.UV.x - b.UV.x), std::abs(a.UV.y - b.UV.y)));
+	}
+	return error;
+}
+
+void VertexPacker::EncodeOctahedral(const DirectX::XMFLOAT3& direction, int16_t encoded[2])
+{
+	const float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (length <= 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float x = direction.x / length;
+	float y = direction.y / length;
+	// Fold the lower hemisphere over the diagonals
+	if (direction.z < 0.0f)
+	{
+		const float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = QuantizeSnorm16(x);
+	encoded[1] = QuantizeSnorm16(y);
+}
+
+DirectX::XMFLOAT3 VertexPacker::DecodeOctahedral(const int16_t encoded[2])
+{
+	// Same as DecodeOctahedral in PackedVertexShader.hlsl
+	DirectX::XMFLOAT3 n(DequantizeSnorm16(encoded[0]), DequantizeSnorm16(encoded[1]), 0.0f);
+	n.z = 1.0f - std::abs(n.x) - std::abs(n.y);
+	const float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	XMStoreFloat3(&n, DirectX::XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+void VertexPacker::EncodeTangent(const DirectX::XMFLOAT4& tangent, int16_t encoded[2])
+{
+	EncodeOctahedral(DirectX::XMFLOAT3(tangent.x, tangent.y, tangent.z), encoded);
+	// Clearing the bit first leaves [-32766, 32766], so setting it cannot overflow or hit -32768,
+	// which the GPU reads as -1 like -32767
+	const int even = std::max(int(encoded[1]) & ~1, -32766);
+	encoded[1] = int16_t(tangent.w < 0.0f ? even + 1 : even);
+}
+
+DirectX::XMFLOAT4 VertexPacker::DecodeTangent(const int16_t encoded[2])
+{
+	// Same as DecodeTangent in PackedVertexShader.hlsl
+	const DirectX::XMFLOAT3 t = DecodeOctahedral(encoded);
+	return DirectX::XMFLOAT4(t.x, t.y, t.z, encoded[1] & 1 ? -1.0f : 1.0f);
+}
+
+void VertexPacker::PackIndices16(const int* indices, size_t count, uint16_t* output)
+{
+	for (size_t i = 0; i != count; ++i)
+		output[i] = uint16_t(indices[i]);
+}
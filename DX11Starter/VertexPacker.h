@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Vertex.h"
+
+// GPU side vertex layouts. Packed formats need PackedVertexShader/PackedShadowVS.
+enum VertexFormat
+{
+	// Vertex, 48 bytes of floats
+	VertexFormatFull = 0,
+	// Float positions, octahedral snorm16 normal and tangent, unorm16 UVs, 24 bytes
+	VertexFormatPacked = 1,
+	// As packed with unorm16 positions, 20 bytes
+	VertexFormatQuantized = 2,
+
+	VertexFormatCount = 3
+};
+
+struct PackedVertex
+{
+	DirectX::XMFLOAT3 Position;
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t UV[2];
+};
+
+struct QuantizedVertex
+{
+	// The fourth component only pads to R16G16B16A16
+	uint16_t Position[4];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t UV[2];
+};
+
+// Per-mesh mapping of the unorm16 values back to their range: value * Scale + Offset
+struct VertexDequantization
+{
+	DirectX::XMFLOAT3 PositionScale;
+	DirectX::XMFLOAT3 PositionOffset;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+};
+
+// Largest round-trip error over a set of vertices
+struct QuantizationError
+{
+	float Position;
+	float NormalDegrees;
+	float TangentDegrees;
+	float UV;
+	// Vertices whose tangent handedness did not survive
+	size_t HandednessMismatches;
+};
+
+class VertexPacker
+{
+public:
+	static size_t GetVertexSize(VertexFormat format);
+	static const char* GetFormatName(VertexFormat format);
+
+	// UV range is always used, position range only for VertexFormatQuantized
+	static VertexDequantization ComputeDequantization(const Vertex* vertices, size_t count, VertexFormat format);
+
+	// output must hold count * GetVertexSize(format) bytes
+	static void Pack(const Vertex* vertices, size_t count, VertexFormat format, const VertexDequantization& dequantization, void* output);
+	static void Unpack(const void* packed, size_t count, VertexFormat format, const VertexDequantization& dequantization, Vertex* output);
+
+	static QuantizationError MeasureError(const Vertex* original, const Vertex* unpacked, size_t count);
+
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& direction, int16_t encoded[2]);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const int16_t encoded[2]);
+	// Octahedral tangent with the handedness in the lowest bit of the second component, odd for negative
+	static void EncodeTangent(const DirectX::XMFLOAT4& tangent, int16_t encoded[2]);
+	static DirectX::XMFLOAT4 DecodeTangent(const int16_t encoded[2]);
+
+	// 16-bit indices whenever every vertex of the mesh is reachable with them
+	static bool CanUse16BitIndices(size_t vertexCount) { return vertexCount <= 65536; }
+	static void PackIndices16(const int* indices, size_t count, uint16_t* output);
+};
@@ -32,7 +32,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;     // XYZ position
 	float3 normal		: NORMAL;
 	float2 uv			: TEXCOORD;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;		// w is the handedness of the bitangent
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -51,7 +51,7 @@ struct VertexToPixel
 	float4 worldPos				: POSITION0;
 	float3 normal				: NORMAL;
 	float2 uv					: TEXCOORD;
-	float3 tangent				: TANGENT;
+	float4 tangent				: TANGENT;
 	float4 lViewSpacePos		: POSITION1;
 };
 
@@ -88,7 +88,7 @@ VertexToPixel main( VertexShaderInput input )
 
 	// Update the normal
 	output.normal = mul(input.normal, (float3x3)itworld);
-	output.tangent = mul(input.tangent, (float3x3)itworld);
+	output.tangent = float4(mul(input.tangent.xyz, (float3x3)itworld), input.tangent.w);
 
 	output.uv = input.uv;
 
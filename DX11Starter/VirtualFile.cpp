@@ -0,0 +1,198 @@
+#include "VirtualFile.h"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include "AssetArchive.h"
+#include "AsyncFileReader.h"
+
+// Filled in on the reader's thread, Completed tells the opener it may look
+struct PreloadedFile
+{
+	std::mutex Mutex;
+	std::condition_variable Done;
+	bool Completed;
+	AsyncRead Read;
+};
+
+namespace
+{
+	std::vector<std::unique_ptr<AssetArchive>>& GetMounted()
+	{
+		static std::vector<std::unique_ptr<AssetArchive>> mounted;
+		return mounted;
+	}
+
+	// The newest archive that has the file
+	const AssetArchive* FindArchive(const std::string& filename, const ArchiveEntry*& entry)
+	{
+		const std::vector<std::unique_ptr<AssetArchive>>& mounted = GetMounted();
+		if (mounted.empty()) return nullptr;
+
+		const std::string path = AssetArchive::NormalizePath(filename);
+		for (auto archive = mounted.rbegin(); archive != mounted.rend(); ++archive)
+		{
+			entry = (*archive)->Find(path);
+			if (entry) return archive->get();
+		}
+		return nullptr;
+	}
+
+	struct Preloads
+	{
+		std::mutex Mutex;
+		// Created by the first Preload
+		std::unique_ptr<AsyncFileReader> Reader;
+		// By normalized path, until opened
+		std::unordered_map<std::string, std::shared_ptr<PreloadedFile>> Files;
+	};
+
+	Preloads& GetPreloads()
+	{
+		static Preloads preloads;
+		return preloads;
+	}
+
+	std::shared_ptr<PreloadedFile> TakePreloaded(const std::string& filename)
+	{
+		Preloads& preloads = GetPreloads();
+		std::lock_guard<std::mutex> lock(preloads.Mutex);
+		if (preloads.Files.empty()) return nullptr;
+
+		const auto found = preloads.Files.find(AssetArchive::NormalizePath(filename));
+		if (found == preloads.Files.end()) return nullptr;
+		std::shared_ptr<PreloadedFile> file = std::move(found->second);
+		preloads.Files.erase(found);
+		return file;
+	}
+}
+
+VirtualFile::VirtualFile()
+{
+	data = nullptr;
+	size = 0;
+	opened = false;
+	archived = false;
+}
+
+bool VirtualFile::Open(const std::string& filename, unsigned threadCount)
+{
+	Close();
+
+	if (std::shared_ptr<PreloadedFile> file = TakePreloaded(filename))
+	{
+		std::unique_lock<std::mutex> lock(file->Mutex);
+		file->Done.wait(lock, [&] { return file->Completed; });
+		// A failed read goes through the usual path, which knows how to report it
+		if (file->Read.Succeeded)
+		{
+			data = file->Read.Contents.GetData();
+			size = file->Read.Contents.GetSize();
+			opened = true;
+			preloaded = std::move(file);
+			return true;
+		}
+	}
+
+	const ArchiveEntry* entry = nullptr;
+	const AssetArchive* archive = FindArchive(filename, entry);
+	if (!archive)
+	{
+		if (!mapped.Open(filename)) return false;
+		data = mapped.GetData();
+		size = mapped.GetSize();
+		opened = true;
+		return true;
+	}
+
+	data = archive->GetData(*entry);
+	if (!data)
+	{
+		decompressed.resize(size_t(entry->Size));
+		if (!archive->Read(*entry, decompressed.data(), threadCount))
+		{
+			Close();
+			return false;
+		}
+		data = decompressed.data();
+	}
+	size = size_t(entry->Size);
+	opened = true;
+	archived = true;
+	return true;
+}
+
+void VirtualFile::Close()
+{
+	mapped.Close();
+	preloaded.reset();
+	// Give the memory back, a closed file should not hold on to a decompressed texture
+	std::vector<char>().swap(decompressed);
+	data = nullptr;
+	size = 0;
+	opened = false;
+	archived = false;
+}
+
+bool VirtualFile::Mount(const std::string& archiveFilename)
+{
+	std::unique_ptr<AssetArchive> archive(new AssetArchive());
+	if (!archive->Open(archiveFilename)) return false;
+
+	GetMounted().push_back(std::move(archive));
+	return true;
+}
+
+void VirtualFile::UnmountAll()
+{
+	GetMounted().clear();
+}
+
+bool VirtualFile::Exists(const std::string& filename)
+{
+	const ArchiveEntry* entry = nullptr;
+	return FindArchive(filename, entry) || FileExists(filename);
+}
+
+bool VirtualFile::InArchive(const std::string& filename)
+{
+	const ArchiveEntry* entry = nullptr;
+	return FindArchive(filename, entry);
+}
+
+void VirtualFile::Preload(const std::vector<std::string>& filenames)
+{
+	Preloads& preloads = GetPreloads();
+	std::lock_guard<std::mutex> lock(preloads.Mutex);
+	for (const std::string& filename : filenames)
+	{
+		const ArchiveEntry* entry = nullptr;
+		if (FindArchive(filename, entry) || !FileExists(filename)) continue;
+		std::shared_ptr<PreloadedFile>& file = preloads.Files[AssetArchive::NormalizePath(filename)];
+		if (file) continue;
+
+		file = std::make_shared<PreloadedFile>();
+		file->Completed = false;
+		if (!preloads.Reader) preloads.Reader.reset(new AsyncFileReader());
+		std::shared_ptr<PreloadedFile> target = file;
+		preloads.Reader->Read(filename, [target](AsyncRead& read)
+		{
+			std::lock_guard<std::mutex> lock(target->Mutex);
+			target->Read = std::move(read);
+			target->Completed = true;
+			target->Done.notify_all();
+		});
+	}
+}
+
+void VirtualFile::DropPreloaded()
+{
+	Preloads& preloads = GetPreloads();
+	std::unique_ptr<AsyncFileReader> reader;
+	{
+		std::lock_guard<std::mutex> lock(preloads.Mutex);
+		reader = std::move(preloads.Reader);
+		preloads.Files.clear();
+	}
+	// Waits for the reads in flight, which only touch files they hold on to
+	reader.reset();
+}
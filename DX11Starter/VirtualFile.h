@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "FileSystem.h"
+
+struct PreloadedFile;
+
+// A whole file read through the mounted asset archives, or from the disk when none of them has it. Files stored
+// as they are in an archive are used in place in its mapping, compressed ones are decompressed into memory the
+// file owns. Loose files can be preloaded by an AsyncFileReader ahead of time. Loaders read everything through
+// this, so they do not care where their files come from.
+class VirtualFile
+{
+public:
+	VirtualFile();
+
+	VirtualFile(const VirtualFile&) = delete;
+	VirtualFile& operator=(const VirtualFile&) = delete;
+
+	// Compressed files are decompressed on threadCount threads, 0 picks one per core. Like MappedFile this logs
+	// when a file is on neither, check Exists first on threads that must not log.
+	bool Open(const std::string& filename, unsigned threadCount = 0);
+	void Close();
+
+	bool IsOpen() const { return opened; }
+	// True if the file came from an archive
+	bool IsArchived() const { return archived; }
+
+	// Getters
+	const char* GetData() const { return data; }
+	const char* GetEnd() const { return data + size; }
+	size_t GetSize() const { return size; }
+
+	// Archives mounted later are searched first, only broken ones are logged. Mounting is not thread safe: mount
+	// before any loader runs and unmount after they all finished, files opened from an archive point into it.
+	static bool Mount(const std::string& archiveFilename);
+	static void UnmountAll();
+	static bool Exists(const std::string& filename);
+	// True if a mounted archive has the file, which then hides a loose one of the same name
+	static bool InArchive(const std::string& filename);
+
+	// Start reading loose files in the background, all of them at once, so opening one later finds it in memory or
+	// only waits for the rest of it. The first Open takes the contents, later ones read the file again. Files in a
+	// mounted archive, missing ones and ones already preloaded are skipped. Thread safe.
+	static void Preload(const std::vector<std::string>& filenames);
+	// Wait for preloads still in flight and forget the contents nobody opened
+	static void DropPreloaded();
+
+private:
+	const char* data;
+	size_t size;
+	bool opened;
+	bool archived;
+
+	MappedFile mapped;
+	std::vector<char> decompressed;
+	std::shared_ptr<PreloadedFile> preloaded;
+};
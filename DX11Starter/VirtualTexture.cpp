@@ -0,0 +1,358 @@
+#include "VirtualTexture.h"
+#include <algorithm>
+
+VirtualPageTable::VirtualPageTable(uint32_t pagesX, uint32_t pagesY)
+{
+	pagesX = std::max(pagesX, 1u);
+	pagesY = std::max(pagesY, 1u);
+	for (;;)
+	{
+		Level level;
+		level.PagesX = pagesX;
+		level.PagesY = pagesY;
+		level.Resident.assign(size_t(pagesX) * pagesY, uint32_t(NoSlot));
+		level.Entries.assign(size_t(pagesX) * pagesY, { NoSlot, NoMip });
+		levels.push_back(std::move(level));
+		if (pagesX == 1 && pagesY == 1) break;
+		pagesX = (pagesX + 1) / 2;
+		pagesY = (pagesY + 1) / 2;
+	}
+	dirtyMips = 0;
+}
+
+template<typename Replace>
+void VirtualPageTable::SetCovered(uint32_t mip, uint32_t x, uint32_t y, const VirtualPageEntry& entry, const Replace& replace)
+{
+	for (uint32_t l = mip + 1; l-- > 0;)
+	{
+		Level& level = levels[l];
+		const uint32_t shift = mip - l;
+		const uint32_t x0 = x << shift;
+		const uint32_t y0 = y << shift;
+		const uint32_t x1 = std::min((x + 1) << shift, level.PagesX);
+		const uint32_t y1 = std::min((y + 1) << shift, level.PagesY);
+		bool changed = false;
+		for (uint32_t py = y0; py < y1; ++py)
+		{
+			for (uint32_t px = x0; px < x1; ++px)
+			{
+				VirtualPageEntry& e = level.Entries[size_t(py) * level.PagesX + px];
+				if (!replace(e)) continue;
+				e = entry;
+				changed = true;
+			}
+		}
+		if (changed) dirtyMips |= 1u << l;
+	}
+}
+
+void VirtualPageTable::Map(uint32_t mip, uint32_t x, uint32_t y, uint32_t slot)
+{
+	levels[mip].Resident[size_t(y) * levels[mip].PagesX + x] = slot;
+	// Whatever was coarser than this page under it now gets this page
+	const VirtualPageEntry entry = { slot, uint8_t(mip) };
+	SetCovered(mip, x, y, entry, [mip](const VirtualPageEntry& e) { return e.Mip > mip; });
+}
+
+void VirtualPageTable::Unmap(uint32_t mip, uint32_t x, uint32_t y)
+{
+	levels[mip].Resident[size_t(y) * levels[mip].PagesX + x] = NoSlot;
+	// Everything that had this page falls back to what its parent has
+	VirtualPageEntry parent = { NoSlot, NoMip };
+	if (mip + 1 < levels.size())
+		parent = GetEntry(mip + 1, x >> 1, y >> 1);
+	SetCovered(mip, x, y, parent, [mip](const VirtualPageEntry& e) { return e.Mip == mip; });
+}
+
+bool VirtualPageTable::Validate() const
+{
+	for (uint32_t l = 0; l != levels.size(); ++l)
+	{
+		for (uint32_t y = 0; y != levels[l].PagesY; ++y)
+		{
+			for (uint32_t x = 0; x != levels[l].PagesX; ++x)
+			{
+				VirtualPageEntry expected = { NoSlot, NoMip };
+				for (uint32_t m = l; m != levels.size(); ++m)
+				{
+					const uint32_t slot = GetResidentSlot(m, x >> (m - l), y >> (m - l));
+					if (slot == NoSlot) continue;
+					expected = { slot, uint8_t(m) };
+					break;
+				}
+				const VirtualPageEntry& entry = GetEntry(l, x, y);
+				if (entry.Slot != expected.Slot || entry.Mip != expected.Mip) return false;
+			}
+		}
+	}
+	return true;
+}
+
+VirtualPageId VirtualTextureCache::MakePageId(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y)
+{
+	// 16 bits of texture, 8 of mip and 20 of each coordinate
+	return (VirtualPageId(texture & 0xffff) << 48) | (VirtualPageId(mip & 0xff) << 40) | (VirtualPageId(y & 0xfffff) << 20) | VirtualPageId(x & 0xfffff);
+}
+
+VirtualPage VirtualTextureCache::GetPage(VirtualPageId page)
+{
+	return { uint32_t(page >> 48), uint32_t(page >> 40) & 0xff, uint32_t(page) & 0xfffff, uint32_t(page >> 20) & 0xfffff };
+}
+
+VirtualTextureCache::VirtualTextureCache(const VirtualTextureSettings& settings, size_t bytesPerPage)
+	: settings(settings), bytesPerPage(bytesPerPage)
+{
+	slots.assign(settings.PhysicalPages, { 0, false, false, false, 0, NoSlot, NoSlot });
+	// Handed out from the back, slot 0 first
+	for (uint32_t slot = settings.PhysicalPages; slot-- > 0;)
+		freeSlots.push_back(slot);
+	leastRecent = NoSlot;
+	mostRecent = NoSlot;
+	frame = 0;
+	loadsInFlight = 0;
+	residentPages = 0;
+	loadsFinished = 0;
+	stats = {};
+}
+
+uint32_t VirtualTextureCache::AddTexture(uint32_t width, uint32_t height)
+{
+	tables.emplace_back((width + settings.PageSize - 1) / settings.PageSize, (height + settings.PageSize - 1) / settings.PageSize);
+	return uint32_t(tables.size() - 1);
+}
+
+bool VirtualTextureCache::IsValid(const VirtualPage& page) const
+{
+	if (page.Texture >= tables.size()) return false;
+	const VirtualPageTable& table = tables[page.Texture];
+	return page.Mip < table.GetMipCount() && page.X < table.GetPagesX(page.Mip) && page.Y < table.GetPagesY(page.Mip);
+}
+
+void VirtualTextureCache::Unlink(uint32_t slot)
+{
+	Slot& s = slots[slot];
+	if (s.Previous != NoSlot) slots[s.Previous].Next = s.Next;
+	else leastRecent = s.Next;
+	if (s.Next != NoSlot) slots[s.Next].Previous = s.Previous;
+	else mostRecent = s.Previous;
+	s.Previous = NoSlot;
+	s.Next = NoSlot;
+}
+
+void VirtualTextureCache::LinkLast(uint32_t slot)
+{
+	Slot& s = slots[slot];
+	s.Previous = mostRecent;
+	s.Next = NoSlot;
+	if (mostRecent != NoSlot) slots[mostRecent].Next = slot;
+	else leastRecent = slot;
+	mostRecent = slot;
+}
+
+void VirtualTextureCache::Touch(uint32_t slot)
+{
+	Slot& s = slots[slot];
+	s.LastUsed = frame;
+	// Pinned pages are never evicted and loading ones are not resident yet, neither is in the list
+	if (s.Pinned || s.Loading) return;
+	Unlink(slot);
+	LinkLast(slot);
+}
+
+uint32_t VirtualTextureCache::TakeSlot()
+{
+	if (!freeSlots.empty())
+	{
+		const uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	// Pages seen this frame are all at the end of the list, so if the first one is, every one is
+	const uint32_t slot = leastRecent;
+	if (slot == NoSlot || slots[slot].LastUsed >= frame) return NoSlot;
+	Unlink(slot);
+	const VirtualPage page = GetPage(slots[slot].Page);
+	tables[page.Texture].Unmap(page.Mip, page.X, page.Y);
+	slotsByPage.erase(slots[slot].Page);
+	--residentPages;
+	++stats.Evicted;
+	return slot;
+}
+
+void VirtualTextureCache::Want(VirtualPageId page, uint32_t mip, uint32_t count, bool pinned)
+{
+	const auto found = wantedByPage.find(page);
+	if (found != wantedByPage.end())
+	{
+		wanted[found->second].Count += count;
+		return;
+	}
+	wantedByPage[page] = wanted.size();
+	wanted.push_back({ page, mip, count, pinned });
+}
+
+void VirtualTextureCache::Update(const VirtualPageId* feedback, size_t count, std::vector<VirtualPageLoad>& loads)
+{
+	++frame;
+	stats = {};
+	stats.LoadsFinished = loadsFinished;
+	loadsFinished = 0;
+	wanted.clear();
+	wantedByPage.clear();
+
+	// Every texture needs its coarsest page before anything can sample it
+	for (uint32_t t = 0; t != tables.size(); ++t)
+	{
+		const uint32_t mip = tables[t].GetMipCount() - 1;
+		const VirtualPageId root = MakePageId(t, mip, 0, 0);
+		if (!slotsByPage.count(root))
+			Want(root, mip, 0, true);
+	}
+
+	// Sorting puts repeats of a page together, and pages of the same texture and mip near each other
+	sorted.assign(feedback, feedback + count);
+	std::sort(sorted.begin(), sorted.end());
+	for (size_t i = 0; i != sorted.size();)
+	{
+		const VirtualPageId id = sorted[i];
+		size_t end = i + 1;
+		while (end != sorted.size() && sorted[end] == id)
+			++end;
+		const uint32_t repeats = uint32_t(end - i);
+		i = end;
+
+		const VirtualPage page = GetPage(id);
+		if (!IsValid(page)) continue;
+		++stats.Requested;
+
+		const auto found = slotsByPage.find(id);
+		if (found != slotsByPage.end() && !slots[found->second].Loading)
+		{
+			++stats.Hits;
+			Touch(found->second);
+			continue;
+		}
+
+		// Missing pages sample the finest resident ancestor meanwhile, which is as much in use as a hit.
+		// Every missing page between the two is wanted, coarser ones come in first and cover the others.
+		const VirtualPageTable& table = tables[page.Texture];
+		const VirtualPageEntry& entry = table.GetEntry(page.Mip, page.X, page.Y);
+		if (entry.Slot != VirtualPageTable::NoSlot)
+			Touch(entry.Slot);
+		const uint32_t resident = entry.Mip == VirtualPageTable::NoMip ? table.GetMipCount() : entry.Mip;
+		for (uint32_t m = page.Mip; m < resident; ++m)
+		{
+			const VirtualPageId ancestor = MakePageId(page.Texture, m, page.X >> (m - page.Mip), page.Y >> (m - page.Mip));
+			if (!slotsByPage.count(ancestor))
+				Want(ancestor, m, repeats, false);
+		}
+	}
+
+	std::sort(wanted.begin(), wanted.end(), [](const Wanted& a, const Wanted& b)
+	{
+		if (a.Pinned != b.Pinned) return a.Pinned;
+		if (a.Mip != b.Mip) return a.Mip > b.Mip;
+		if (a.Count != b.Count) return a.Count > b.Count;
+		return a.Page < b.Page;
+	});
+
+	size_t started = 0;
+	for (const Wanted& w : wanted)
+	{
+		if (started >= settings.MaxLoadsPerFrame || loadsInFlight >= settings.MaxLoadsInFlight) break;
+		const uint32_t slot = TakeSlot();
+		if (slot == NoSlot)
+		{
+			stats.Starved = wanted.size() - started;
+			break;
+		}
+
+		Slot& s = slots[slot];
+		s.Page = w.Page;
+		s.Used = true;
+		s.Loading = true;
+		s.Pinned = w.Pinned;
+		s.LastUsed = frame;
+		slotsByPage[w.Page] = slot;
+		loads.push_back({ w.Page, slot });
+		++loadsInFlight;
+		++started;
+	}
+
+	stats.Pending = wanted.size() - started;
+	stats.LoadsStarted = started;
+	stats.LoadsInFlight = loadsInFlight;
+	stats.ResidentPages = residentPages;
+	stats.ResidentBytes = residentPages * bytesPerPage;
+}
+
+void VirtualTextureCache::CompleteLoad(const VirtualPageLoad& load, bool succeeded)
+{
+	Slot& s = slots[load.Slot];
+	s.Loading = false;
+	--loadsInFlight;
+	++loadsFinished;
+	if (succeeded)
+	{
+		const VirtualPage page = GetPage(load.Page);
+		tables[page.Texture].Map(page.Mip, page.X, page.Y, load.Slot);
+		++residentPages;
+		s.LastUsed = frame;
+		if (!s.Pinned) LinkLast(load.Slot);
+	}
+	else
+	{
+		slotsByPage.erase(load.Page);
+		s.Used = false;
+		s.Pinned = false;
+		freeSlots.push_back(load.Slot);
+	}
+}
+
+bool VirtualTextureCache::Validate() const
+{
+	for (const VirtualPageTable& table : tables)
+		if (!table.Validate()) return false;
+
+	size_t used = 0;
+	size_t resident = 0;
+	size_t loading = 0;
+	size_t listed = 0;
+	for (uint32_t slot = 0; slot != slots.size(); ++slot)
+	{
+		const Slot& s = slots[slot];
+		if (!s.Used) continue;
+		++used;
+		const auto found = slotsByPage.find(s.Page);
+		if (found == slotsByPage.end() || found->second != slot) return false;
+		const VirtualPage page = GetPage(s.Page);
+		if (!IsValid(page)) return false;
+		const uint32_t mapped = tables[page.Texture].GetResidentSlot(page.Mip, page.X, page.Y);
+		if (s.Loading)
+		{
+			++loading;
+			if (mapped != VirtualPageTable::NoSlot) return false;
+		}
+		else
+		{
+			++resident;
+			if (mapped != slot) return false;
+			if (!s.Pinned) ++listed;
+		}
+	}
+	if (used + freeSlots.size() != slots.size() || used != slotsByPage.size()) return false;
+	if (resident != residentPages || loading != loadsInFlight) return false;
+
+	// The recency list holds the resident unpinned pages, least recently used first
+	size_t count = 0;
+	uint32_t previous = NoSlot;
+	for (uint32_t slot = leastRecent; slot != NoSlot; slot = slots[slot].Next)
+	{
+		const Slot& s = slots[slot];
+		if (++count > listed || !s.Used || s.Loading || s.Pinned || s.Previous != previous) return false;
+		if (previous != NoSlot && slots[previous].LastUsed > s.LastUsed) return false;
+		previous = slot;
+	}
+	return count == listed && previous == mostRecent;
+}
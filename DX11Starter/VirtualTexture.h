@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// A page of a virtual texture: texture index, mip, and page column and row within the mip
+typedef uint64_t VirtualPageId;
+
+struct VirtualPage
+{
+	uint32_t Texture;
+	uint32_t Mip;
+	uint32_t X;
+	uint32_t Y;
+};
+
+// What the indirection texture holds for a page: the physical slot with the finest resident page covering it
+struct VirtualPageEntry
+{
+	uint32_t Slot;
+	// Mip of that page, NoMip while nothing covering it is resident
+	uint8_t Mip;
+};
+
+// The indirection of one virtual texture. Every page of every mip points at the finest resident page that covers
+// it, itself or an ancestor, so sampling falls back to coarser data while finer pages are loading. Mapping or
+// unmapping a page only touches the entries under it. Pure bookkeeping, see VirtualTextureCache.
+class VirtualPageTable
+{
+public:
+	static const uint8_t NoMip = 0xff;
+	static const uint32_t NoSlot = ~0u;
+
+	// A texture of pagesX by pagesY pages at mip 0, halved each mip (rounding up) down to a single page
+	VirtualPageTable(uint32_t pagesX, uint32_t pagesY);
+
+	uint32_t GetMipCount() const { return uint32_t(levels.size()); }
+	uint32_t GetPagesX(uint32_t mip) const { return levels[mip].PagesX; }
+	uint32_t GetPagesY(uint32_t mip) const { return levels[mip].PagesY; }
+
+	void Map(uint32_t mip, uint32_t x, uint32_t y, uint32_t slot);
+	void Unmap(uint32_t mip, uint32_t x, uint32_t y);
+
+	// Slot of this exact page, NoSlot if it is not resident
+	uint32_t GetResidentSlot(uint32_t mip, uint32_t x, uint32_t y) const { return levels[mip].Resident[y * levels[mip].PagesX + x]; }
+	const VirtualPageEntry& GetEntry(uint32_t mip, uint32_t x, uint32_t y) const { return levels[mip].Entries[y * levels[mip].PagesX + x]; }
+	// Row major entries of one mip, for uploading to the indirection texture
+	const std::vector<VirtualPageEntry>& GetEntries(uint32_t mip) const { return levels[mip].Entries; }
+
+	// Mips whose entries changed since the last ClearDirty, one bit each
+	uint32_t GetDirtyMips() const { return dirtyMips; }
+	void ClearDirty() { dirtyMips = 0; }
+
+	// Check every entry points at the finest resident page covering it, for tests and benchmarks
+	bool Validate() const;
+
+private:
+	struct Level
+	{
+		uint32_t PagesX;
+		uint32_t PagesY;
+		std::vector<uint32_t> Resident;
+		std::vector<VirtualPageEntry> Entries;
+	};
+
+	// Entries of the pages under (mip, x, y) at every finer mip that satisfy replace become entry
+	template<typename Replace>
+	void SetCovered(uint32_t mip, uint32_t x, uint32_t y, const VirtualPageEntry& entry, const Replace& replace);
+
+	std::vector<Level> levels;
+	uint32_t dirtyMips;
+};
+
+struct VirtualTextureSettings
+{
+	// Texels on a side of a page, without the border
+	uint32_t PageSize;
+	// Texels repeated from the neighbours around each page, so filtering does not need them
+	uint32_t PageBorder;
+	// Slots of the physical cache texture, PhysicalColumns pages across
+	uint32_t PhysicalPages;
+	uint32_t PhysicalColumns;
+	// Loads started per frame, and reading at once
+	unsigned MaxLoadsPerFrame;
+	unsigned MaxLoadsInFlight;
+};
+
+// One frame of feedback analysis
+struct VirtualTextureStats
+{
+	// Distinct pages in the feedback, and those that were resident
+	size_t Requested;
+	size_t Hits;
+	// Missing pages that did not get a load this frame
+	size_t Pending;
+	size_t LoadsStarted;
+	size_t LoadsFinished;
+	size_t Evicted;
+	// Loads that found every slot used this frame, the cache is too small for the view
+	size_t Starved;
+	size_t LoadsInFlight;
+	size_t ResidentPages;
+	size_t ResidentBytes;
+};
+
+// A load the analyzer decided on: read the page into the slot, then CompleteLoad
+struct VirtualPageLoad
+{
+	VirtualPageId Page;
+	uint32_t Slot;
+};
+
+// Software virtual texturing: fixed size pages of many virtual textures share one physical cache texture, and a
+// page table per texture says where each page is. Once per frame the feedback of the frame, the pages the GPU wanted
+// at the mip it wanted, goes into Update, which counts hits, keeps the pages in use and the resident ancestors that
+// stand in for missing ones from eviction, and starts loads for the missing pages: coarser mips first, since one
+// coarse page stands in for many finer ones, then the pages asked for most. Slots for loads are free ones or the
+// least recently used page not seen this frame. The single page of each texture's coarsest mip is loaded first and
+// never evicted, so every texel always has something to sample. Pure bookkeeping, loads are up to the caller.
+class VirtualTextureCache
+{
+public:
+	static VirtualPageId MakePageId(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y);
+	static VirtualPage GetPage(VirtualPageId page);
+
+	// bytesPerPage is what a slot takes in the physical texture, border included
+	VirtualTextureCache(const VirtualTextureSettings& settings, size_t bytesPerPage);
+
+	// A virtual texture of width by height texels at mip 0. Returns its index for page ids.
+	uint32_t AddTexture(uint32_t width, uint32_t height);
+
+	// The pages a frame sampled, in any order and with repeats, which count for priority. Appends the loads to start.
+	void Update(const VirtualPageId* feedback, size_t count, std::vector<VirtualPageLoad>& loads);
+	// A load from Update finished. Failed loads free their slot and are asked for again by later feedback.
+	void CompleteLoad(const VirtualPageLoad& load, bool succeeded);
+
+	const VirtualPageTable& GetPageTable(uint32_t texture) const { return tables[texture]; }
+	const VirtualTextureSettings& GetSettings() const { return settings; }
+	// Top left texel of a slot's page border in the physical texture
+	uint32_t GetSlotX(uint32_t slot) const { return slot % settings.PhysicalColumns * (settings.PageSize + 2 * settings.PageBorder); }
+	uint32_t GetSlotY(uint32_t slot) const { return slot / settings.PhysicalColumns * (settings.PageSize + 2 * settings.PageBorder); }
+	// Of the last Update, with the loads finished since the one before
+	const VirtualTextureStats& GetStats() const { return stats; }
+
+	// Check the slots, the recency list and the page tables agree, for tests and benchmarks
+	bool Validate() const;
+
+private:
+	static const uint32_t NoSlot = ~0u;
+
+	struct Slot
+	{
+		VirtualPageId Page;
+		bool Used;
+		bool Loading;
+		bool Pinned;
+		uint64_t LastUsed;
+		// Recency list of resident unpinned slots, least recently used first
+		uint32_t Previous;
+		uint32_t Next;
+	};
+
+	struct Wanted
+	{
+		VirtualPageId Page;
+		uint32_t Mip;
+		uint32_t Count;
+		// The coarsest page of a texture, before anything else
+		bool Pinned;
+	};
+
+	bool IsValid(const VirtualPage& page) const;
+	void Touch(uint32_t slot);
+	void Unlink(uint32_t slot);
+	void LinkLast(uint32_t slot);
+	// A free slot, or the least recently used page not seen this frame evicted. NoSlot if there is none.
+	uint32_t TakeSlot();
+	void Want(VirtualPageId page, uint32_t mip, uint32_t count, bool pinned);
+
+	VirtualTextureSettings settings;
+	size_t bytesPerPage;
+	std::vector<VirtualPageTable> tables;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	uint32_t leastRecent;
+	uint32_t mostRecent;
+	// Resident and loading pages
+	std::unordered_map<VirtualPageId, uint32_t> slotsByPage;
+	uint64_t frame;
+	size_t loadsInFlight;
+	size_t residentPages;
+	size_t loadsFinished;
+
+	std::vector<VirtualPageId> sorted;
+	std::vector<Wanted> wanted;
+	std::unordered_map<VirtualPageId, size_t> wantedByPage;
+	VirtualTextureStats stats;
+};
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include "AssetCache.h"
+#include "Check.h"
+
+namespace
+{
+	std::shared_ptr<void> MakeAsset(int value)
+	{
+		return std::make_shared<int>(value);
+	}
+
+	void TestHitsAndMisses()
+	{
+		AssetCache cache(1000);
+		CHECK(cache.Acquire("a") == nullptr);
+		cache.Insert("a", MakeAsset(1), 100, 50);
+		CHECK(cache.Contains("a") && cache.GetReferences("a") == 1);
+
+		// Hits share the asset and count references
+		const std::shared_ptr<int> a = cache.Acquire<int>("a");
+		CHECK(a && *a == 1 && cache.GetReferences("a") == 2);
+		CHECK(cache.GetStats().Hits == 1 && cache.GetStats().Misses == 1);
+		CHECK(cache.GetStats().Assets == 1 && cache.GetStats().CpuBytes == 100 && cache.GetStats().GpuBytes == 50);
+
+		// Inserting an id that is cached keeps the asset there and references it once more
+		cache.Insert("a", MakeAsset(2), 999, 999);
+		CHECK(*cache.Acquire<int>("a") == 1 && cache.GetReferences("a") == 4);
+		CHECK(cache.GetStats().Assets == 1 && cache.GetStats().CpuBytes == 100);
+
+		// Released by everybody it stays cached, unreferenced
+		for (int i = 0; i != 4; ++i)
+			cache.Release("a");
+		CHECK(cache.Contains("a") && cache.GetReferences("a") == 0 && cache.GetStats().Unreferenced == 1);
+		// Releasing once too often or an unknown id changes nothing
+		cache.Release("a");
+		cache.Release("unknown");
+		CHECK(cache.GetReferences("a") == 0 && cache.GetStats().Unreferenced == 1);
+		CHECK(cache.Validate());
+
+		// Acquired again it is off the recency list
+		CHECK(cache.Acquire("a") != nullptr && cache.GetStats().Unreferenced == 0);
+		CHECK(cache.Validate());
+	}
+
+	void TestEviction()
+	{
+		// Room for three assets of 100 bytes
+		AssetCache cache(300);
+		for (const char* id : { "a", "b", "c" })
+			cache.Insert(id, MakeAsset(0), 60, 40);
+		cache.Release("b");
+		cache.Release("a");
+		cache.Release("c");
+
+		// Least recently released first: b, then a
+		cache.Insert("d", MakeAsset(0), 100, 0);
+		CHECK(!cache.Contains("b") && cache.Contains("a") && cache.Contains("c") && cache.Contains("d"));
+		CHECK(cache.GetStats().Evictions == 1 && cache.GetStats().EvictedBytes == 100);
+
+		// An acquire takes a out of the list, so c goes next
+		cache.Acquire("a");
+		cache.Insert("e", MakeAsset(0), 50, 50);
+		CHECK(!cache.Contains("c") && cache.Contains("a"));
+		CHECK(cache.Validate());
+
+		// Referenced assets stay over the budget, and what is released goes at once
+		cache.Insert("f", MakeAsset(0), 200, 0);
+		CHECK(cache.GetStats().CpuBytes + cache.GetStats().GpuBytes == 500 && cache.GetStats().Unreferenced == 0);
+		CHECK(cache.Validate());
+		cache.Release("f");
+		CHECK(!cache.Contains("f") && cache.GetStats().CpuBytes + cache.GetStats().GpuBytes == 300);
+		CHECK(cache.Validate());
+
+		// A smaller budget evicts down to it, a larger one keeps what is unreferenced
+		cache.SetBudget(10000);
+		cache.Release("a");
+		cache.Release("d");
+		CHECK(cache.GetStats().Unreferenced == 2 && cache.GetStats().Assets == 3);
+		cache.SetBudget(200);
+		CHECK(!cache.Contains("a") && cache.Contains("d") && cache.Contains("e"));
+		CHECK(cache.Validate());
+
+		cache.EvictUnreferenced();
+		CHECK(!cache.Contains("d") && cache.Contains("e") && cache.GetStats().Assets == 1 && cache.GetStats().Unreferenced == 0);
+		CHECK(cache.Validate());
+	}
+
+	void TestAssetLifetime()
+	{
+		AssetCache cache(100);
+		std::weak_ptr<void> weak;
+		{
+			std::shared_ptr<void> asset = MakeAsset(7);
+			weak = asset;
+			cache.Insert("a", std::move(asset), 80, 0);
+		}
+
+		// The cache's pointer keeps the asset while cached, eviction frees it
+		cache.Release("a");
+		CHECK(!weak.expired());
+		cache.Insert("b", MakeAsset(8), 80, 0);
+		CHECK(!cache.Contains("a") && weak.expired());
+
+		// Unless somebody kept a pointer of their own
+		std::shared_ptr<int> kept = cache.Acquire<int>("b");
+		cache.Release("b");
+		cache.Release("b");
+		cache.EvictUnreferenced();
+		CHECK(!cache.Contains("b") && kept && *kept == 8);
+	}
+
+	// Random acquires, inserts, releases and budget changes against a plain reference model: the ids cached with
+	// their references, and the unreferenced ones in release order
+	void TestAgainstReference()
+	{
+		struct Model
+		{
+			int References;
+			size_t Bytes;
+		};
+		std::map<std::string, Model> cached;
+		std::list<std::string> unreferenced;
+		size_t budget = 20000;
+		size_t bytes = 0;
+		const auto trim = [&]()
+		{
+			while (!unreferenced.empty() && bytes > budget)
+			{
+				bytes -= cached[unreferenced.front()].Bytes;
+				cached.erase(unreferenced.front());
+				unreferenced.pop_front();
+			}
+		};
+
+		AssetCache cache(budget);
+		std::mt19937 random(740);
+		std::vector<std::string> held;
+		bool same = true;
+		bool valid = true;
+		for (int i = 0; i != 100000; ++i)
+		{
+			const int operation = int(random() % 100);
+			if (operation < 50)
+			{
+				const std::string id = "asset" + std::to_string(random() % 200);
+				const std::shared_ptr<void> asset = cache.Acquire(id);
+				const auto found = cached.find(id);
+				same = same && (asset != nullptr) == (found != cached.end());
+				if (found != cached.end())
+				{
+					if (found->second.References++ == 0)
+						unreferenced.remove(id);
+				}
+				else
+				{
+					// A miss loads the asset and inserts it
+					const size_t cpuBytes = 100 + random() % 400;
+					const size_t gpuBytes = random() % 2 ? 0 : 500 + random() % 1500;
+					cache.Insert(id, MakeAsset(i), cpuBytes, gpuBytes);
+					cached[id] = { 1, cpuBytes + gpuBytes };
+					bytes += cpuBytes + gpuBytes;
+					trim();
+				}
+				held.push_back(id);
+			}
+			else if (operation < 98)
+			{
+				if (held.empty()) continue;
+				const size_t pick = random() % held.size();
+				const std::string id = held[pick];
+				held[pick] = held.back();
+				held.pop_back();
+				cache.Release(id);
+				if (--cached[id].References == 0)
+				{
+					unreferenced.push_back(id);
+					trim();
+				}
+			}
+			else
+			{
+				budget = 5000 + random() % 30000;
+				cache.SetBudget(budget);
+				trim();
+			}
+
+			if (i % 100 == 0)
+			{
+				valid = valid && cache.Validate();
+				same = same && cache.GetStats().Assets == cached.size() && cache.GetStats().Unreferenced == unreferenced.size() &&
+					cache.GetStats().CpuBytes + cache.GetStats().GpuBytes == bytes;
+				for (const auto& entry : cached)
+					same = same && cache.GetReferences(entry.first) == entry.second.References;
+			}
+		}
+		CHECK(valid && same);
+		CHECK(cache.GetStats().Evictions > 0 && cache.GetStats().Hits > 0);
+
+		// Everything released, then evicted
+		for (const std::string& id : held)
+			cache.Release(id);
+		cache.EvictUnreferenced();
+		CHECK(cache.GetStats().Assets == 0 && cache.GetStats().CpuBytes == 0 && cache.GetStats().GpuBytes == 0);
+		CHECK(cache.Validate());
+		cache.LogStats();
+	}
+}
+
+int main()
+{
+	TestHitsAndMisses();
+	TestEviction();
+	TestAssetLifetime();
+	TestAgainstReference();
+	return CheckResult("AssetCacheTests");
+}
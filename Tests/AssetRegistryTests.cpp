@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "AssetRegistry.h"
+#include "Check.h"
+
+namespace
+{
+	// A version that counts the ones alive and is poisoned when deleted, so a reader holding one past its reclamation
+	// sees it
+	struct Version
+	{
+		Version(uint32_t slot, uint64_t serial, std::atomic<int>* live) : Slot(slot), Serial(serial), Check(serial * 2654435761u + slot), Live(live) { ++*Live; }
+		~Version() { Check = 0; --*Live; }
+		bool IsValid(uint32_t slot) const { return Slot == slot && Check == Serial * 2654435761u + slot; }
+		uint32_t Slot;
+		uint64_t Serial;
+		uint64_t Check;
+		std::atomic<int>* Live;
+	};
+	typedef AssetRegistry<Version> Registry;
+
+	std::unique_ptr<Version> MakeVersion(uint32_t slot, uint64_t serial, std::atomic<int>& live)
+	{
+		return std::unique_ptr<Version>(new Version(slot, serial, &live));
+	}
+
+	void TestSlots()
+	{
+		std::atomic<int> live(0);
+		{
+			Registry registry(3);
+			CHECK(registry.Add(MakeVersion(0, 0, live)) == 0);
+			CHECK(registry.Add(nullptr) == 1);
+			CHECK(registry.Add(MakeVersion(2, 0, live)) == 2);
+			// Full: the version is not taken
+			CHECK(registry.Add(MakeVersion(3, 0, live)) == Registry::NoSlot);
+			CHECK(registry.GetSlotCount() == 3 && live == 2);
+
+			const int reader = registry.RegisterReader();
+			{
+				Registry::ReadScope scope(registry, reader);
+				CHECK(registry.Get(0) && registry.Get(0)->IsValid(0));
+				CHECK(registry.Get(1) == nullptr);
+			}
+
+			// A slot that held nothing retires nothing
+			registry.Publish(1, MakeVersion(1, 1, live));
+			CHECK(registry.GetStats().Published == 1 && registry.GetStats().Pending == 0);
+		}
+		// The current versions go with the registry
+		CHECK(live == 0);
+	}
+
+	void TestReclaim()
+	{
+		std::atomic<int> live(0);
+		{
+			Registry registry(1);
+			registry.Add(MakeVersion(0, 0, live));
+			const int reader = registry.RegisterReader();
+			CHECK(reader >= 0);
+
+			// Nobody inside: the replaced version goes at the next Reclaim
+			registry.Publish(0, MakeVersion(0, 1, live));
+			CHECK(live == 2 && registry.GetStats().Pending == 1);
+			CHECK(registry.Reclaim() == 1 && live == 1);
+
+			// A reader that got the old version keeps it until its Exit, however many frames that takes
+			registry.Enter(reader);
+			const Version* held = registry.Get(0);
+			registry.Publish(0, MakeVersion(0, 2, live));
+			CHECK(registry.Get(0)->Serial == 2);
+			CHECK(registry.Reclaim() == 0 && registry.Reclaim() == 0);
+			CHECK(held->IsValid(0) && held->Serial == 1);
+			registry.Exit(reader);
+			CHECK(registry.Reclaim() == 1 && live == 1);
+
+			// One that entered after the epoch moved on cannot have seen it, and does not hold it back
+			registry.Enter(reader);
+			registry.Publish(0, MakeVersion(0, 3, live));
+			registry.Reclaim();
+			registry.Exit(reader);
+			registry.Enter(reader);
+			CHECK(registry.Reclaim() == 1);
+			// Retired in the epoch the reader is in now, so it stays
+			registry.Publish(0, MakeVersion(0, 4, live));
+			CHECK(registry.Reclaim() == 0);
+			registry.Exit(reader);
+
+			const AssetRegistryStats stats = registry.GetStats();
+			CHECK(stats.Published == 4 && stats.Reclaimed == 3 && stats.Pending == 1);
+			CHECK(stats.Epoch == 8);
+		}
+		// Retired versions nobody reclaimed go with the registry too
+		CHECK(live == 0);
+	}
+
+	void TestReaders()
+	{
+		Registry registry(1);
+		std::vector<int> readers;
+		for (int r = 0; r != Registry::MaxReaders; ++r)
+			readers.push_back(registry.RegisterReader());
+		CHECK(std::find(readers.begin(), readers.end(), -1) == readers.end());
+		CHECK(registry.RegisterReader() == -1);
+
+		// An unregistered reader is free again and no longer holds anything back
+		registry.Enter(readers[5]);
+		registry.UnregisterReader(readers[5]);
+		CHECK(registry.RegisterReader() == readers[5]);
+		std::atomic<int> live(0);
+		registry.Add(MakeVersion(0, 0, live));
+		registry.Publish(0, MakeVersion(0, 1, live));
+		CHECK(registry.Reclaim() == 1);
+	}
+
+	// Readers going through every slot, writers replacing versions of their own slots and Reclaim at frame boundaries,
+	// like BenchmarkAssetRegistry. Every version a reader gets is intact until its Exit, versions of a slot never go
+	// back, and once the readers are gone everything retired is deleted.
+	void TestStress()
+	{
+		const uint32_t slotCount = 256;
+		const int writerCount = 2;
+		const int readerCount = std::max(2, std::min(6, int(std::thread::hardware_concurrency()) - writerCount));
+		std::atomic<int> live(0);
+		{
+			Registry registry(slotCount);
+			for (uint32_t slot = 0; slot != slotCount; ++slot)
+				registry.Add(MakeVersion(slot, 0, live));
+
+			std::atomic<bool> stop(false);
+			std::atomic<bool> consistent(true);
+			std::atomic<size_t> reads(0);
+			std::vector<std::thread> threads;
+			for (int r = 0; r < readerCount; ++r)
+			{
+				threads.emplace_back([&]
+				{
+					const int reader = registry.RegisterReader();
+					std::vector<uint64_t> seen(slotCount, 0);
+					std::vector<const Version*> held(slotCount);
+					size_t count = 0;
+					bool ok = reader >= 0;
+					while (ok && !stop.load(std::memory_order_relaxed))
+					{
+						Registry::ReadScope scope(registry, reader);
+						for (uint32_t slot = 0; slot != slotCount; ++slot)
+						{
+							const Version* version = registry.Get(slot);
+							ok = ok && version && version->IsValid(slot) && version->Serial >= seen[slot];
+							if (!ok) break;
+							seen[slot] = version->Serial;
+							held[slot] = version;
+						}
+						for (uint32_t slot = 0; ok && slot != slotCount; ++slot)
+							ok = held[slot]->IsValid(slot);
+						count += slotCount;
+					}
+					if (reader >= 0) registry.UnregisterReader(reader);
+					if (!ok) consistent = false;
+					reads += count;
+				});
+			}
+			for (int w = 0; w < writerCount; ++w)
+			{
+				threads.emplace_back([&, w]
+				{
+					std::mt19937 random(740 + w);
+					uint64_t serial = 0;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						// Slots of this writer only, so versions of a slot come in order
+						const uint32_t slot = uint32_t(random() % (slotCount / writerCount)) * writerCount + w;
+						registry.Publish(slot, MakeVersion(slot, ++serial, live));
+					}
+				});
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			size_t frames = 0;
+			size_t mostPending = 0;
+			while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500))
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(500));
+				registry.Reclaim();
+				mostPending = std::max(mostPending, registry.GetStats().Pending);
+				++frames;
+			}
+			stop = true;
+			for (std::thread& thread : threads) thread.join();
+
+			registry.Reclaim();
+			const AssetRegistryStats stats = registry.GetStats();
+			CHECK(consistent);
+			CHECK(reads > 0 && stats.Published > 0);
+			CHECK(stats.Pending == 0 && stats.Reclaimed == stats.Published && live == int(slotCount));
+
+			std::cout << "Stress: " << readerCount << " readers did " << reads.load() << " reads while " << writerCount << " writers published "
+				<< stats.Published << " versions, reclaimed over " << frames << " frames with at most " << mostPending << " pending." << std::endl;
+		}
+		CHECK(live == 0);
+	}
+}
+
+int main()
+{
+	TestSlots();
+	TestReclaim();
+	TestReaders();
+	TestStress();
+	return CheckResult("AssetRegistryTests");
+}
@@ -0,0 +1,162 @@
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "AsyncFileReader.h"
+#include "Bench.h"
+#include "FileSystem.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const int Iterations = 10;
+
+	// Drop a file from the file cache so the next read comes from the disk. Linux is told to forget the pages. Windows
+	// purges the cached pages of a file opened without buffering when nothing else has it open, which is as close as
+	// it gets without administrator rights, so cold numbers there are best effort.
+	void EvictFromCache(const std::string& filename)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		const int file = open(filename.c_str(), O_RDONLY);
+		if (file < 0) return;
+		posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+		close(file);
+#endif
+	}
+
+	// Every file under folder except the cooker's temporaries, the assets the game would read
+	std::vector<std::string> ListAssets(const std::string& folder)
+	{
+		std::vector<std::string> assets;
+		for (const std::string& file : ListFiles(folder, ""))
+		{
+			if (file.size() <= 4 || file.compare(file.size() - 4, 4, ".tmp") != 0)
+				assets.push_back(file);
+		}
+		return assets;
+	}
+
+	// Whole files read into memory. Readers finish files in any order, so the hash sums every file's hash and is
+	// taken after the time stops.
+	struct ReadPass
+	{
+		double Seconds;
+		size_t Bytes;
+		uint64_t Hash;
+		unsigned PeakInFlight;
+	};
+
+	// How loaders used to read a file, into a vector through an ifstream, one file after the other
+	ReadPass ReadFilesStream(const std::vector<std::string>& files)
+	{
+		std::vector<std::vector<char>> contents;
+		ReadPass pass = { 0.0, 0, 0, 1 };
+		const Clock::time_point start = Clock::now();
+		for (const std::string& filename : files)
+		{
+			std::ifstream input(filename, std::ios::binary | std::ios::ate);
+			if (!input) continue;
+			std::vector<char> file(size_t(input.tellg()));
+			input.seekg(0);
+			if (!input.read(file.data(), file.size())) continue;
+			pass.Bytes += file.size();
+			contents.push_back(std::move(file));
+		}
+		pass.Seconds = SecondsSince(start);
+		for (const std::vector<char>& file : contents)
+			pass.Hash += HashData(file.data(), file.size());
+		return pass;
+	}
+
+	// Every file queued at once on a fresh reader, starting it is part of the time
+	ReadPass ReadFilesAsync(const std::vector<std::string>& files, unsigned queueDepth, bool direct, AsyncBackend backend)
+	{
+		std::mutex mutex;
+		std::vector<FileBuffer> buffers;
+		ReadPass pass = { 0.0, 0, 0, 0 };
+		const Clock::time_point start = Clock::now();
+		{
+			AsyncFileReader reader(queueDepth, direct, backend);
+			for (const std::string& filename : files)
+				reader.Read(filename, [&](AsyncRead& read)
+				{
+					if (!read.Succeeded) return;
+					std::lock_guard<std::mutex> lock(mutex);
+					pass.Bytes += read.Contents.GetSize();
+					buffers.push_back(std::move(read.Contents));
+				});
+			reader.Wait();
+			pass.PeakInFlight = reader.GetPeakInFlight();
+		}
+		pass.Seconds = SecondsSince(start);
+
+		for (const FileBuffer& buffer : buffers)
+			pass.Hash += HashData(buffer.GetData(), buffer.GetSize());
+		return pass;
+	}
+
+	// One pass with the files dropped from the file cache and the best of several warm ones
+	template <typename Pass>
+	void BenchmarkRead(const std::string& label, const std::vector<std::string>& files, uint64_t expectedHash, const Pass& read)
+	{
+		for (const std::string& filename : files)
+			EvictFromCache(filename);
+		const ReadPass cold = read();
+
+		ReadPass warm = cold;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			const ReadPass pass = read();
+			if (pass.Seconds < warm.Seconds) warm = pass;
+		}
+
+		std::cout << "  " << label << ": cold " << cold.Seconds * 1000.0 << " ms (" << cold.Bytes / cold.Seconds / 1e6 << " MB/s), warm "
+			<< warm.Seconds * 1000.0 << " ms (" << warm.Bytes / warm.Seconds / 1e6 << " MB/s), peak " << cold.PeakInFlight
+			<< " in flight, contents " << (cold.Hash == expectedHash && warm.Hash == expectedHash ? "match" : "MISMATCH") << "." << std::endl;
+	}
+}
+
+// Reading every asset under the model folder into memory with an ifstream per file, then with AsyncFileReader on
+// threads and on io_uring at queue depths 1..64, through the file cache and direct. Cold and warm, with the most reads
+// that were in flight at once, and checks every way reads the same contents.
+int main(int argc, char* argv[])
+{
+	const std::string modelFolder = GetModelFolder(argc, argv);
+	const std::vector<std::string> files = ListAssets(modelFolder);
+	if (files.empty())
+	{
+		std::cout << "No files under \"" << modelFolder << "\"." << std::endl;
+		return 0;
+	}
+
+	const ReadPass reference = ReadFilesStream(files);
+	std::cout << "Reading " << files.size() << " files, " << reference.Bytes << " bytes:" << std::endl;
+	BenchmarkRead("ifstream, one file at a time", files, reference.Hash, [&] { return ReadFilesStream(files); });
+
+	std::vector<AsyncBackend> backends = { AsyncBackendThreads };
+	if (AsyncFileReader(1, false, AsyncBackendIoUring).GetBackend() == AsyncBackendIoUring)
+		backends.push_back(AsyncBackendIoUring);
+	else
+		std::cout << "  io_uring is not available, only timing threads." << std::endl;
+
+	for (AsyncBackend backend : backends)
+		for (bool direct : { false, true })
+			for (unsigned queueDepth : { 1u, 4u, 16u, 64u })
+			{
+				std::ostringstream label;
+				label << (backend == AsyncBackendIoUring ? "io_uring" : "Threads") << (direct ? " direct" : "") << ", queue depth " << queueDepth;
+				BenchmarkRead(label.str(), files, reference.Hash, [&] { return ReadFilesAsync(files, queueDepth, direct, backend); });
+			}
+	return 0;
+}
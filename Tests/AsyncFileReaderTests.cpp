@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "AsyncFileReader.h"
+#include "Check.h"
+
+namespace
+{
+	struct TestFile
+	{
+		std::string Filename;
+		std::vector<char> Contents;
+	};
+
+	// Files of sizes around the block and alignment sizes, an empty one and ones large enough for direct reads
+	// whose last block is short, with random contents
+	std::vector<TestFile> WriteTestFiles()
+	{
+		const size_t sizes[] = { 0, 1, 4095, 4096, 4097, AsyncFileReader::BlockSize * 3 + 123,
+			AsyncFileReader::DirectMinSize, AsyncFileReader::DirectMinSize + 1000, 5 * 1024 * 1024 + 17 };
+		std::mt19937 random(740);
+		std::vector<TestFile> files;
+		for (size_t size : sizes)
+		{
+			TestFile file;
+			file.Filename = "AsyncFileReaderTests." + std::to_string(files.size()) + ".bin";
+			file.Contents.resize(size);
+			for (char& c : file.Contents)
+				c = char(random());
+			std::ofstream out(file.Filename, std::ios::binary | std::ios::trunc);
+			out.write(file.Contents.data(), std::streamsize(size));
+			files.push_back(std::move(file));
+		}
+		return files;
+	}
+
+	struct Result
+	{
+		int Calls;
+		bool Succeeded;
+		std::vector<char> Contents;
+	};
+
+	// Everything queued at once, a missing file among them, and the contents compared byte for byte
+	void TestBatch(const std::vector<TestFile>& files, unsigned queueDepth, bool direct, AsyncBackend backend)
+	{
+		const std::string missing = "AsyncFileReaderTests.missing.bin";
+		std::mutex mutex;
+		std::map<std::string, Result> results;
+		{
+			AsyncFileReader reader(queueDepth, direct, backend);
+			CHECK(reader.GetBackend() == backend);
+			const auto callback = [&](AsyncRead& read)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Result& result = results[read.Filename];
+				++result.Calls;
+				result.Succeeded = read.Succeeded;
+				result.Contents.assign(read.Contents.GetData(), read.Contents.GetData() + read.Contents.GetSize());
+			};
+			for (const TestFile& file : files)
+				reader.Read(file.Filename, callback);
+			reader.Read(missing, callback);
+			reader.Wait();
+			CHECK(reader.GetPeakInFlight() >= 1 && reader.GetPeakInFlight() <= queueDepth);
+
+			// A reader that waited takes more
+			reader.Read(files.back().Filename, callback);
+		}
+
+		CHECK(results.size() == files.size() + 1);
+		for (size_t f = 0; f != files.size(); ++f)
+		{
+			const Result& result = results[files[f].Filename];
+			CHECK(result.Calls == (f + 1 == files.size() ? 2 : 1));
+			CHECK(result.Succeeded);
+			CHECK(result.Contents == files[f].Contents);
+		}
+		CHECK(results[missing].Calls == 1 && !results[missing].Succeeded && results[missing].Contents.empty());
+	}
+}
+
+int main()
+{
+	const std::vector<TestFile> files = WriteTestFiles();
+
+	std::vector<AsyncBackend> backends = { AsyncBackendThreads };
+	if (AsyncFileReader(1, false, AsyncBackendIoUring).GetBackend() == AsyncBackendIoUring)
+		backends.push_back(AsyncBackendIoUring);
+	else
+		std::cout << "io_uring is not available, only testing threads." << std::endl;
+
+	for (AsyncBackend backend : backends)
+		for (bool direct : { false, true })
+			for (unsigned queueDepth : { 1u, 3u, 32u })
+				TestBatch(files, queueDepth, direct, backend);
+
+	for (const TestFile& file : files)
+		std::remove(file.Filename.c_str());
+	return CheckResult("AsyncFileReaderTests");
+}
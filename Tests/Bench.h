@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Helpers for the bench executables. They print what they measured and take the model folder as their argument,
+// "models" like the game's "-benchmark" when there is none.
+typedef std::chrono::high_resolution_clock Clock;
+
+inline double SecondsSince(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+inline std::string GetModelFolder(int argc, char* argv[])
+{
+	return argc > 1 ? argv[1] : "models";
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "Bench.h"
+#include "BlockCompressor.h"
+
+namespace
+{
+	enum TestImage
+	{
+		TestImageColor,
+		TestImageColorAlpha,
+		TestImageNormal,
+		TestImageGray,
+	};
+
+	// Smooth gradients, hard edges and noise, so compression runs without image codecs
+	std::vector<uint8_t> MakeTestImage(TestImage kind, uint32_t width, uint32_t height)
+	{
+		std::mt19937 random(740);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		const auto clamp = [](float value) { return uint8_t(std::min(255.0f, std::max(0.0f, value + 0.5f))); };
+		const float frequency = 6.2831853f * 4.0f / width;
+
+		std::vector<uint8_t> pixels(size_t(width) * height * 4);
+		for (uint32_t y = 0; y != height; ++y)
+			for (uint32_t x = 0; x != width; ++x)
+			{
+				uint8_t* p = &pixels[(size_t(y) * width + x) * 4];
+				const float u = float(x) / width;
+				const float v = float(y) / height;
+				const bool tile = ((x / 64) + (y / 64)) % 2 == 0;
+				switch (kind)
+				{
+				case TestImageColor:
+				case TestImageColorAlpha:
+					p[0] = clamp(255.0f * u + noise(random) + (tile ? 30.0f : 0.0f));
+					p[1] = clamp(255.0f * v + noise(random));
+					p[2] = clamp(128.0f + 100.0f * std::sin(x * frequency) * std::cos(y * frequency) + noise(random));
+					p[3] = kind == TestImageColor ? 255 : clamp(255.0f * (1.0f - std::hypot(u - 0.5f, v - 0.5f) * 1.4f));
+					break;
+				case TestImageNormal:
+				{
+					const float dx = std::cos(x * frequency * 8.0f) * std::cos(y * frequency * 8.0f) * 0.8f;
+					const float dy = -std::sin(x * frequency * 8.0f) * std::sin(y * frequency * 8.0f) * 0.8f;
+					const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+					p[0] = clamp((-dx / length * 0.5f + 0.5f) * 255.0f);
+					p[1] = clamp((-dy / length * 0.5f + 0.5f) * 255.0f);
+					p[2] = clamp((1.0f / length * 0.5f + 0.5f) * 255.0f);
+					p[3] = 255;
+					break;
+				}
+				case TestImageGray:
+					p[0] = p[1] = p[2] = clamp(128.0f + 90.0f * std::sin((x + y) * frequency) + noise(random) + (tile ? 20.0f : -20.0f));
+					p[3] = 255;
+					break;
+				}
+			}
+		return pixels;
+	}
+
+	const int Iterations = 10;
+}
+
+// BC1/BC3/BC4/BC5/BC7 encode throughput with 1..N threads and per channel PSNR on synthetic color, alpha, normal
+// and gray images. Needs no files.
+int main()
+{
+	struct Case
+	{
+		const char* Name;
+		TestImage Image;
+		DXGI_FORMAT Format;
+	};
+	// The format TextureCooker picks for each kind of image, and BC3 as the cheaper alternative for alpha
+	const Case cases[] = {
+		{ "BC1 color", TestImageColor, DXGI_FORMAT_BC1_UNORM_SRGB },
+		{ "BC7 color with alpha", TestImageColorAlpha, DXGI_FORMAT_BC7_UNORM_SRGB },
+		{ "BC3 color with alpha", TestImageColorAlpha, DXGI_FORMAT_BC3_UNORM },
+		{ "BC5 normals", TestImageNormal, DXGI_FORMAT_BC5_UNORM },
+		{ "BC4 gray", TestImageGray, DXGI_FORMAT_BC4_UNORM },
+	};
+	const uint32_t size = 1024;
+	const double megapixels = double(size) * size / 1e6;
+
+	const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	static const char* const ChannelNames[4] = { "R", "G", "B", "A" };
+	for (const Case& test : cases)
+	{
+		const std::vector<uint8_t> pixels = MakeTestImage(test.Image, size, size);
+		std::vector<uint8_t> blocks(BlockCompressor::GetCompressedSize(test.Format, size, size));
+		std::vector<uint8_t> decoded(pixels.size());
+
+		double singleThreaded = 0.0;
+		for (unsigned threads : threadCounts)
+		{
+			const Clock::time_point start = Clock::now();
+			for (int i = 0; i < Iterations; ++i)
+				BlockCompressor::Compress(pixels.data(), size, size, test.Format, blocks.data(), threads);
+			const double seconds = SecondsSince(start) / Iterations;
+			if (threads == 1) singleThreaded = seconds;
+
+			std::cout << "Compress " << size << "x" << size << " " << test.Name << " on " << threads << " threads: " << seconds * 1000.0
+				<< " ms, " << megapixels / seconds << " MP/s, speedup " << singleThreaded / seconds << "x." << std::endl;
+		}
+
+		BlockCompressor::Decompress(blocks.data(), size, size, test.Format, decoded.data());
+		const ChannelPsnr psnr = BlockCompressor::MeasurePsnr(pixels.data(), decoded.data(), size_t(size) * size);
+		std::ostringstream channels;
+		for (int c = 0; c != BlockCompressor::GetChannelCount(test.Format); ++c)
+			channels << (c ? ", " : "") << ChannelNames[c] << " " << psnr.Channels[c] << " dB";
+		std::cout << "  " << test.Name << " PSNR: " << channels.str() << "." << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "BlockCompressor.h"
+#include "Check.h"
+
+namespace
+{
+	enum TestImage
+	{
+		TestImageColor,
+		TestImageColorAlpha,
+		TestImageNormal,
+		TestImageGray,
+	};
+
+	// Smooth gradients, hard edges and noise, like the synthetic images of BlockCompressorBench
+	std::vector<uint8_t> MakeTestImage(TestImage kind, uint32_t width, uint32_t height)
+	{
+		std::mt19937 random(740);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		const auto clamp = [](float value) { return uint8_t(std::min(255.0f, std::max(0.0f, value + 0.5f))); };
+		const float frequency = 6.2831853f * 4.0f / width;
+
+		std::vector<uint8_t> pixels(size_t(width) * height * 4);
+		for (uint32_t y = 0; y != height; ++y)
+			for (uint32_t x = 0; x != width; ++x)
+			{
+				uint8_t* p = &pixels[(size_t(y) * width + x) * 4];
+				const float u = float(x) / width;
+				const float v = float(y) / height;
+				const bool tile = ((x / 64) + (y / 64)) % 2 == 0;
+				switch (kind)
+				{
+				case TestImageColor:
+				case TestImageColorAlpha:
+					p[0] = clamp(255.0f * u + noise(random) + (tile ? 30.0f : 0.0f));
+					p[1] = clamp(255.0f * v + noise(random));
+					p[2] = clamp(128.0f + 100.0f * std::sin(x * frequency) * std::cos(y * frequency) + noise(random));
+					p[3] = kind == TestImageColor ? 255 : clamp(255.0f * (1.0f - std::hypot(u - 0.5f, v - 0.5f) * 1.4f));
+					break;
+				case TestImageNormal:
+				{
+					const float dx = std::cos(x * frequency * 8.0f) * std::cos(y * frequency * 8.0f) * 0.8f;
+					const float dy = -std::sin(x * frequency * 8.0f) * std::sin(y * frequency * 8.0f) * 0.8f;
+					const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+					p[0] = clamp((-dx / length * 0.5f + 0.5f) * 255.0f);
+					p[1] = clamp((-dy / length * 0.5f + 0.5f) * 255.0f);
+					p[2] = clamp((1.0f / length * 0.5f + 0.5f) * 255.0f);
+					p[3] = 255;
+					break;
+				}
+				case TestImageGray:
+					p[0] = p[1] = p[2] = clamp(128.0f + 90.0f * std::sin((x + y) * frequency) + noise(random) + (tile ? 20.0f : -20.0f));
+					p[3] = 255;
+					break;
+				}
+			}
+		return pixels;
+	}
+
+	std::vector<uint8_t> RoundTrip(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, DXGI_FORMAT format)
+	{
+		std::vector<uint8_t> blocks(BlockCompressor::GetCompressedSize(format, width, height));
+		BlockCompressor::Compress(pixels.data(), width, height, format, blocks.data());
+		std::vector<uint8_t> decoded(pixels.size());
+		BlockCompressor::Decompress(blocks.data(), width, height, format, decoded.data());
+		return decoded;
+	}
+
+	float MinimumPsnr(const ChannelPsnr& psnr, int channels)
+	{
+		return *std::min_element(psnr.Channels, psnr.Channels + channels);
+	}
+
+	void TestSizes()
+	{
+		CHECK(BlockCompressor::GetBlockSize(DXGI_FORMAT_BC1_UNORM) == 8 && BlockCompressor::GetBlockSize(DXGI_FORMAT_BC4_UNORM) == 8);
+		CHECK(BlockCompressor::GetBlockSize(DXGI_FORMAT_BC3_UNORM) == 16 && BlockCompressor::GetBlockSize(DXGI_FORMAT_BC5_UNORM) == 16);
+		CHECK(BlockCompressor::GetBlockSize(DXGI_FORMAT_BC7_UNORM_SRGB) == 16);
+		// Partial blocks at the edges count whole
+		CHECK(BlockCompressor::GetCompressedSize(DXGI_FORMAT_BC1_UNORM, 5, 5) == 4 * 8);
+		CHECK(BlockCompressor::GetCompressedSize(DXGI_FORMAT_BC7_UNORM, 1024, 4) == 256 * 16);
+
+		CHECK(BlockCompressor::IsSupported(DXGI_FORMAT_BC1_UNORM_SRGB) && BlockCompressor::IsSupported(DXGI_FORMAT_BC5_UNORM));
+		CHECK(!BlockCompressor::IsSupported(DXGI_FORMAT_BC2_UNORM) && !BlockCompressor::IsSupported(DXGI_FORMAT_R8G8B8A8_UNORM));
+		CHECK(BlockCompressor::GetChannelCount(DXGI_FORMAT_BC4_UNORM) == 1 && BlockCompressor::GetChannelCount(DXGI_FORMAT_BC5_UNORM) == 2);
+		CHECK(BlockCompressor::GetChannelCount(DXGI_FORMAT_BC1_UNORM) == 3 && BlockCompressor::GetChannelCount(DXGI_FORMAT_BC3_UNORM) == 4);
+	}
+
+	void TestSolidBlocks()
+	{
+		// A color 565 holds exactly comes back exactly
+		std::vector<uint8_t> red(4 * 4 * 4);
+		for (size_t p = 0; p != 16; ++p)
+		{
+			red[p * 4] = 255;
+			red[p * 4 + 3] = 255;
+		}
+		CHECK(RoundTrip(red, 4, 4, DXGI_FORMAT_BC1_UNORM) == red);
+		CHECK(RoundTrip(red, 4, 4, DXGI_FORMAT_BC3_UNORM) == red);
+
+		// Any color within one step in BC7, whose endpoints share their lowest bit, and the missing channels
+		// filled in for BC4 and BC5
+		std::vector<uint8_t> color(4 * 4 * 4);
+		for (size_t p = 0; p != 16; ++p)
+		{
+			color[p * 4] = 93;
+			color[p * 4 + 1] = 170;
+			color[p * 4 + 2] = 21;
+			color[p * 4 + 3] = 200;
+		}
+		bool close = true;
+		for (const std::vector<uint8_t>* solid : { &red, &color })
+		{
+			const std::vector<uint8_t> bc7 = RoundTrip(*solid, 4, 4, DXGI_FORMAT_BC7_UNORM);
+			for (size_t i = 0; i != solid->size(); ++i)
+				close = close && std::abs(int(bc7[i]) - int((*solid)[i])) <= 1;
+		}
+		CHECK(close);
+
+		const std::vector<uint8_t> bc4 = RoundTrip(color, 4, 4, DXGI_FORMAT_BC4_UNORM);
+		const std::vector<uint8_t> bc5 = RoundTrip(color, 4, 4, DXGI_FORMAT_BC5_UNORM);
+		bool filled = true;
+		for (size_t p = 0; p != 16; ++p)
+		{
+			filled = filled && bc4[p * 4] == 93 && bc4[p * 4 + 1] == 0 && bc4[p * 4 + 2] == 0 && bc4[p * 4 + 3] == 255;
+			filled = filled && bc5[p * 4] == 93 && bc5[p * 4 + 1] == 170 && bc5[p * 4 + 2] == 0 && bc5[p * 4 + 3] == 255;
+		}
+		CHECK(filled);
+	}
+
+	void TestQuality()
+	{
+		// The format TextureCooker picks for each kind of image, and BC3 as the cheaper one for alpha. Floors a little
+		// under what the encoder reaches now, so a change that costs quality fails.
+		struct Case
+		{
+			TestImage Image;
+			DXGI_FORMAT Format;
+			float MinimumPsnr;
+		};
+		const Case cases[] = {
+			{ TestImageColor, DXGI_FORMAT_BC1_UNORM_SRGB, 30.0f },
+			{ TestImageColorAlpha, DXGI_FORMAT_BC7_UNORM_SRGB, 30.0f },
+			{ TestImageColorAlpha, DXGI_FORMAT_BC3_UNORM, 30.0f },
+			{ TestImageNormal, DXGI_FORMAT_BC5_UNORM, 36.0f },
+			{ TestImageGray, DXGI_FORMAT_BC4_UNORM, 40.0f },
+		};
+		const uint32_t size = 256;
+		for (const Case& test : cases)
+		{
+			const std::vector<uint8_t> pixels = MakeTestImage(test.Image, size, size);
+			const std::vector<uint8_t> decoded = RoundTrip(pixels, size, size, test.Format);
+			const ChannelPsnr psnr = BlockCompressor::MeasurePsnr(pixels.data(), decoded.data(), size_t(size) * size);
+			const float minimum = MinimumPsnr(psnr, BlockCompressor::GetChannelCount(test.Format));
+			CHECK(minimum >= test.MinimumPsnr);
+			std::cout << "Format " << int(test.Format) << " on test image " << int(test.Image) << ": " << minimum << " dB in the worst channel." << std::endl;
+		}
+
+		const std::vector<uint8_t> pixels = MakeTestImage(TestImageColor, 16, 16);
+		CHECK(std::isinf(BlockCompressor::MeasurePsnr(pixels.data(), pixels.data(), 16 * 16).Channels[0]));
+	}
+
+	void TestThreadsAndEdges()
+	{
+		// Rows of blocks spread over threads give the same blocks
+		const uint32_t size = 128;
+		const std::vector<uint8_t> pixels = MakeTestImage(TestImageColorAlpha, size, size);
+		for (DXGI_FORMAT format : { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC7_UNORM })
+		{
+			std::vector<uint8_t> single(BlockCompressor::GetCompressedSize(format, size, size));
+			std::vector<uint8_t> threaded(single.size());
+			BlockCompressor::Compress(pixels.data(), size, size, format, single.data(), 1);
+			BlockCompressor::Compress(pixels.data(), size, size, format, threaded.data(), 5);
+			CHECK(single == threaded);
+		}
+
+		// Sizes that are not whole blocks, the edge blocks repeat the last row and column
+		const uint32_t width = 13, height = 6;
+		const std::vector<uint8_t> odd = MakeTestImage(TestImageGray, width, height);
+		const std::vector<uint8_t> decoded = RoundTrip(odd, width, height, DXGI_FORMAT_BC4_UNORM);
+		CHECK(BlockCompressor::MeasurePsnr(odd.data(), decoded.data(), size_t(width) * height).Channels[0] >= 30.0f);
+	}
+}
+
+int main()
+{
+	TestSizes();
+	TestSolidBlocks();
+	TestQuality();
+	TestThreadsAndEdges();
+	return CheckResult("BlockCompressorTests");
+}
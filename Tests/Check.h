@@ -0,0 +1,32 @@
+#pragma once
+
+#include <iostream>
+
+// Checks for the test executables. A failed CHECK prints where it is and counts, and main returns CheckResult(), so
+// the run fails if any check did.
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			++CheckFailures(); \
+			std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK(" #condition ") failed." << std::endl; \
+		} \
+	} while (false)
+
+inline int CheckResult(const char* name)
+{
+	if (CheckFailures() == 0)
+	{
+		std::cout << name << ": all checks passed." << std::endl;
+		return 0;
+	}
+	std::cerr << name << ": " << CheckFailures() << " checks failed." << std::endl;
+	return 1;
+}
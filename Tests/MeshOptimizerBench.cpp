@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "FileSystem.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+
+namespace
+{
+	// A UV sphere with its triangles in random order and every triangle's corners rotated at random, the worst order
+	// an exporter could give, for when there are no models
+	std::string MakeShuffledSphereObj(int rings, int segments)
+	{
+		std::ostringstream obj;
+		for (int r = 0; r <= rings; ++r)
+		{
+			const float theta = 3.14159265f * r / rings;
+			for (int s = 0; s <= segments; ++s)
+			{
+				const float phi = 6.28318531f * s / segments;
+				obj << "v " << std::sin(theta) * std::cos(phi) << " " << std::cos(theta) << " " << std::sin(theta) * std::sin(phi) << "\n";
+			}
+		}
+
+		std::vector<std::array<int, 3>> triangles;
+		for (int r = 0; r < rings; ++r)
+		{
+			for (int s = 0; s < segments; ++s)
+			{
+				const int a = r * (segments + 1) + s + 1, b = a + 1, c = a + segments + 1, d = c + 1;
+				triangles.push_back({ { a, c, b } });
+				triangles.push_back({ { b, c, d } });
+			}
+		}
+		std::mt19937 random(740);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		for (std::array<int, 3>& triangle : triangles)
+		{
+			std::rotate(triangle.begin(), triangle.begin() + random() % 3, triangle.end());
+			obj << "f " << triangle[0] << " " << triangle[1] << " " << triangle[2] << "\n";
+		}
+		return obj.str();
+	}
+
+	struct Submesh
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<int> Indices;
+	};
+
+	// Every group welded on its own with its vertices in order of first use, the order MeshCooker hands to
+	// MeshOptimizer
+	std::vector<Submesh> WeldGroups(const ObjData& obj)
+	{
+		std::vector<Submesh> submeshes;
+		for (const ObjGroup& group : obj.Groups)
+		{
+			Submesh submesh;
+			std::map<std::array<int, 3>, int> welded;
+			for (size_t f = group.FirstFace; f != group.FirstFace + group.FaceCount; ++f)
+			{
+				for (const ObjIndex& corner : obj.Faces[f].Corners)
+				{
+					const std::array<int, 3> key = { { corner.Position, corner.TexCoord, corner.Normal } };
+					const auto found = welded.insert(std::make_pair(key, int(submesh.Vertices.size())));
+					if (found.second)
+					{
+						Vertex vertex{};
+						vertex.Position = obj.Positions[corner.Position - 1];
+						if (corner.Normal > 0) vertex.Normal = obj.Normals[corner.Normal - 1];
+						if (corner.TexCoord > 0) vertex.UV = obj.TexCoords[corner.TexCoord - 1];
+						submesh.Vertices.push_back(vertex);
+					}
+					submesh.Indices.push_back(found.first->second);
+				}
+			}
+			if (!submesh.Indices.empty()) submeshes.push_back(std::move(submesh));
+		}
+		return submeshes;
+	}
+
+	void PrintMeshStats(const char* label, const Submesh& submesh)
+	{
+		const VertexCacheStats cache = MeshOptimizer::AnalyzeVertexCache(submesh.Indices.data(), submesh.Indices.size(), submesh.Vertices.size());
+		const VertexFetchStats fetch = MeshOptimizer::AnalyzeVertexFetch(submesh.Indices.data(), submesh.Indices.size(), submesh.Vertices.size(),
+			sizeof(Vertex));
+		const OverdrawStats overdraw = MeshOptimizer::AnalyzeOverdraw(submesh.Indices.data(), submesh.Indices.size(), submesh.Vertices.data(),
+			submesh.Vertices.size());
+		std::cout << "  " << label << ": ACMR " << cache.Acmr << ", ATVR " << cache.Atvr << ", overfetch " << fetch.Overfetch
+			<< ", overdraw " << overdraw.Overdraw << "." << std::endl;
+	}
+
+	// Vertex cache, vertex fetch and overdraw statistics of every submesh before and after MeshOptimizer
+	void BenchmarkMesh(const std::string& name, const char* begin, const char* end)
+	{
+		ObjData obj;
+		ObjParser::ParseObj(begin, end, obj);
+		std::vector<Submesh> submeshes = WeldGroups(obj);
+		for (size_t m = 0; m != submeshes.size(); ++m)
+		{
+			Submesh& submesh = submeshes[m];
+			std::cout << "Submesh " << m << " of \"" << name << "\", " << submesh.Indices.size() / 3 << " triangles:" << std::endl;
+			PrintMeshStats("source order", submesh);
+
+			const Clock::time_point start = Clock::now();
+			MeshOptimizer::Optimize(submesh.Vertices.data(), submesh.Vertices.size(), submesh.Indices.data(), submesh.Indices.size());
+			const double seconds = SecondsSince(start);
+
+			PrintMeshStats("optimized", submesh);
+			std::cout << "  optimized in " << seconds * 1000.0 << " ms." << std::endl;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string modelFolder = GetModelFolder(argc, argv);
+	const std::vector<std::string> files = ListFiles(modelFolder, ".obj");
+	for (const std::string& file : files)
+	{
+		MappedFile mapped;
+		if (mapped.Open(file))
+			BenchmarkMesh(file, mapped.GetData(), mapped.GetEnd());
+	}
+	if (files.empty())
+	{
+		std::cout << "No OBJs under \"" << modelFolder << "\", using a generated sphere." << std::endl;
+		const std::string sphere = MakeShuffledSphereObj(128, 256);
+		BenchmarkMesh("<shuffled sphere>", sphere.data(), sphere.data() + sphere.size());
+	}
+	return 0;
+}
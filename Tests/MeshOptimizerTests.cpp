@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	struct TestMesh
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<int> Indices;
+	};
+
+	// A UV sphere, convex so nothing is drawn over from outside, with its triangles in random order and every
+	// triangle's corners rotated at random, the worst order an exporter could give
+	TestMesh MakeShuffledSphere(int rings, int segments)
+	{
+		TestMesh mesh;
+		for (int r = 0; r <= rings; ++r)
+		{
+			const float theta = 3.14159265f * r / rings;
+			for (int s = 0; s <= segments; ++s)
+			{
+				const float phi = 6.28318531f * s / segments;
+				Vertex v{};
+				v.Normal = DirectX::XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				v.Position = v.Normal;
+				v.UV = DirectX::XMFLOAT2(float(s) / segments, float(r) / rings);
+				mesh.Vertices.push_back(v);
+			}
+		}
+
+		std::vector<std::array<int, 3>> triangles;
+		for (int r = 0; r < rings; ++r)
+		{
+			for (int s = 0; s < segments; ++s)
+			{
+				const int a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+				triangles.push_back({ { a, b, c } });
+				triangles.push_back({ { b, d, c } });
+			}
+		}
+		std::mt19937 random(740);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		for (std::array<int, 3>& triangle : triangles)
+		{
+			std::rotate(triangle.begin(), triangle.begin() + random() % 3, triangle.end());
+			mesh.Indices.insert(mesh.Indices.end(), triangle.begin(), triangle.end());
+		}
+		return mesh;
+	}
+
+	// Every triangle as its corners' attributes, starting at the smallest corner so the winding is kept, sorted.
+	// Two meshes with the same ones draw the same whatever order their triangles and vertices are in.
+	std::vector<std::array<float, 15>> GetTriangles(const TestMesh& mesh)
+	{
+		std::vector<std::array<float, 15>> triangles;
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+		{
+			std::array<std::array<float, 5>, 3> corners;
+			for (int c = 0; c < 3; ++c)
+			{
+				const Vertex& v = mesh.Vertices[mesh.Indices[i + c]];
+				corners[c] = { { v.Position.x, v.Position.y, v.Position.z, v.UV.x, v.UV.y } };
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+			std::array<float, 15> triangle;
+			for (int c = 0; c < 3; ++c)
+				std::copy(corners[c].begin(), corners[c].end(), triangle.begin() + 5 * c);
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	void TestAnalyzeVertexCache()
+	{
+		const int one[] = { 0, 1, 2 };
+		VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(one, 3, 3);
+		CHECK(stats.VerticesTransformed == 3 && stats.Acmr == 3.0f && stats.Atvr == 1.0f);
+
+		// The shared edge comes from the cache
+		const int two[] = { 0, 1, 2, 2, 1, 3 };
+		stats = MeshOptimizer::AnalyzeVertexCache(two, 6, 4);
+		CHECK(stats.VerticesTransformed == 4 && stats.Acmr == 2.0f && stats.Atvr == 1.0f);
+
+		// A FIFO of 4 has forgotten vertex 0 after 4 more misses, but not after 3
+		const int evicted[] = { 0, 1, 2, 3, 4, 5, 0, 4, 5 };
+		stats = MeshOptimizer::AnalyzeVertexCache(evicted, 9, 6, 4);
+		CHECK(stats.VerticesTransformed == 7 && stats.Atvr == 7.0f / 6.0f);
+		const int kept[] = { 0, 1, 2, 3, 0, 2 };
+		stats = MeshOptimizer::AnalyzeVertexCache(kept, 6, 4, 4);
+		CHECK(stats.VerticesTransformed == 4);
+	}
+
+	void TestAnalyzeVertexFetch()
+	{
+		// Vertices of a whole cache line read in order: everything fetched once
+		std::vector<int> sequential(96);
+		for (int i = 0; i < 96; ++i) sequential[i] = i;
+		VertexFetchStats stats = MeshOptimizer::AnalyzeVertexFetch(sequential.data(), sequential.size(), 96, 64);
+		CHECK(stats.BytesFetched == 96 * 64 && stats.Overfetch == 1.0f);
+
+		// 16 byte vertices a line apart: a whole line for each of them
+		const int strided[] = { 0, 4, 8 };
+		stats = MeshOptimizer::AnalyzeVertexFetch(strided, 3, 12, 16);
+		CHECK(stats.BytesFetched == 3 * 64 && stats.Overfetch == 4.0f);
+	}
+
+	void TestAnalyzeOverdraw()
+	{
+		// A convex mesh covers every pixel once from outside
+		const TestMesh sphere = MakeShuffledSphere(24, 48);
+		const OverdrawStats stats = MeshOptimizer::AnalyzeOverdraw(sphere.Indices.data(), sphere.Indices.size(), sphere.Vertices.data(), sphere.Vertices.size());
+		CHECK(stats.PixelsCovered > 0);
+		CHECK(stats.Overdraw >= 1.0f && stats.Overdraw < 1.01f);
+
+		// The same sphere drawn twice: every pixel shaded again unless the second one is hidden by depth
+		TestMesh twice = sphere;
+		for (int index : sphere.Indices) twice.Indices.push_back(index);
+		const OverdrawStats doubled = MeshOptimizer::AnalyzeOverdraw(twice.Indices.data(), twice.Indices.size(), twice.Vertices.data(), twice.Vertices.size());
+		CHECK(doubled.PixelsCovered == stats.PixelsCovered && doubled.PixelsShaded >= stats.PixelsShaded);
+	}
+
+	void TestOptimizeVertexFetch()
+	{
+		TestMesh mesh;
+		for (int v = 0; v < 5; ++v)
+		{
+			Vertex vertex{};
+			vertex.Position.x = float(v);
+			mesh.Vertices.push_back(vertex);
+		}
+		mesh.Indices = { 3, 1, 4, 4, 1, 3 };
+
+		// First use order, unreferenced ones last in their order
+		CHECK(MeshOptimizer::OptimizeVertexFetch(mesh.Vertices.data(), mesh.Vertices.size(), mesh.Indices.data(), mesh.Indices.size()) == 3);
+		CHECK((mesh.Indices == std::vector<int>{ 0, 1, 2, 2, 1, 0 }));
+		const float expected[] = { 3.0f, 1.0f, 4.0f, 0.0f, 2.0f };
+		for (int v = 0; v < 5; ++v)
+			CHECK(mesh.Vertices[v].Position.x == expected[v]);
+	}
+
+	void TestOptimize()
+	{
+		TestMesh mesh = MakeShuffledSphere(32, 64);
+		const std::vector<std::array<float, 15>> triangles = GetTriangles(mesh);
+		const size_t vertexCount = mesh.Vertices.size();
+		const size_t indexCount = mesh.Indices.size();
+		const VertexCacheStats input = MeshOptimizer::AnalyzeVertexCache(mesh.Indices.data(), indexCount, vertexCount);
+
+		// Tipsify alone on a grid-like mesh gets well under one vertex per triangle
+		std::vector<int> cacheOrder = mesh.Indices;
+		MeshOptimizer::OptimizeVertexCache(cacheOrder.data(), indexCount, vertexCount);
+		const VertexCacheStats tipsified = MeshOptimizer::AnalyzeVertexCache(cacheOrder.data(), indexCount, vertexCount);
+		const OverdrawStats tipsifiedOverdraw = MeshOptimizer::AnalyzeOverdraw(cacheOrder.data(), indexCount, mesh.Vertices.data(), vertexCount);
+		CHECK(input.Acmr > 1.5f);
+		CHECK(tipsified.Acmr < 0.85f);
+
+		MeshOptimizer::Optimize(mesh.Vertices.data(), vertexCount, mesh.Indices.data(), indexCount);
+		CHECK(GetTriangles(mesh) == triangles);
+
+		// The overdraw pass is kept only when it helps, for at most 5% of the cache
+		const VertexCacheStats output = MeshOptimizer::AnalyzeVertexCache(mesh.Indices.data(), indexCount, vertexCount);
+		const OverdrawStats outputOverdraw = MeshOptimizer::AnalyzeOverdraw(mesh.Indices.data(), indexCount, mesh.Vertices.data(), vertexCount);
+		CHECK(output.Acmr <= tipsified.Acmr * 1.05f);
+		CHECK(outputOverdraw.Overdraw <= tipsifiedOverdraw.Overdraw);
+
+		// Vertices in the order the indices first use them
+		int next = 0;
+		bool firstUseOrder = true;
+		for (int index : mesh.Indices)
+		{
+			firstUseOrder = firstUseOrder && index <= next;
+			if (index == next) ++next;
+		}
+		CHECK(firstUseOrder && size_t(next) == vertexCount);
+		const VertexFetchStats fetch = MeshOptimizer::AnalyzeVertexFetch(mesh.Indices.data(), indexCount, vertexCount, sizeof(Vertex));
+		CHECK(fetch.Overfetch < 1.25f);
+
+		std::cout << "Sphere of " << indexCount / 3 << " triangles: ACMR " << input.Acmr << " to " << output.Acmr << ", ATVR " << input.Atvr
+			<< " to " << output.Atvr << ", overdraw " << tipsifiedOverdraw.Overdraw << " after the cache pass and " << outputOverdraw.Overdraw << " at the end, overfetch "
+			<< fetch.Overfetch << "." << std::endl;
+	}
+}
+
+int main()
+{
+	TestAnalyzeVertexCache();
+	TestAnalyzeVertexFetch();
+	TestAnalyzeOverdraw();
+	TestOptimizeVertexFetch();
+	TestOptimize();
+	return CheckResult("MeshOptimizerTests");
+}
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include "Check.h"
+#include "ObjParser.h"
+
+namespace
+{
+	void Parse(const std::string& text, ObjData& obj)
+	{
+		ObjParser::ParseObj(text.data(), text.data() + text.size(), obj);
+	}
+
+	bool SameObjData(const ObjData& a, const ObjData& b)
+	{
+		if (a.MtlLib != b.MtlLib) return false;
+		if (a.Positions.size() != b.Positions.size() || a.Normals.size() != b.Normals.size() ||
+			a.TexCoords.size() != b.TexCoords.size() || a.Faces.size() != b.Faces.size() || a.Groups.size() != b.Groups.size())
+			return false;
+		if (memcmp(a.Positions.data(), b.Positions.data(), a.Positions.size() * sizeof(DirectX::XMFLOAT3)) != 0) return false;
+		if (memcmp(a.Normals.data(), b.Normals.data(), a.Normals.size() * sizeof(DirectX::XMFLOAT3)) != 0) return false;
+		if (memcmp(a.TexCoords.data(), b.TexCoords.data(), a.TexCoords.size() * sizeof(DirectX::XMFLOAT2)) != 0) return false;
+		for (size_t i = 0; i < a.Faces.size(); ++i)
+		{
+			if (a.Faces[i].HasNormal != b.Faces[i].HasNormal) return false;
+			if (memcmp(a.Faces[i].Corners, b.Faces[i].Corners, sizeof(a.Faces[i].Corners)) != 0) return false;
+		}
+		for (size_t i = 0; i < a.Groups.size(); ++i)
+		{
+			if (a.Groups[i].Material != b.Groups[i].Material || a.Groups[i].FirstFace != b.Groups[i].FirstFace ||
+				a.Groups[i].FaceCount != b.Groups[i].FaceCount)
+				return false;
+		}
+		return true;
+	}
+
+	bool SameIndex(const ObjIndex& index, int position, int texCoord, int normal)
+	{
+		return index.Position == position && index.TexCoord == texCoord && index.Normal == normal;
+	}
+
+	// A model of strips with every face format, relative indices and a material switch every few hundred faces,
+	// the first faces before any usemtl. With broken faces, faces with indices out of range are spread between them,
+	// and faces with absolute indices into the first strip that are not.
+	std::string MakeObj(int strips, int length, bool brokenFaces = false)
+	{
+		std::mt19937 random(740);
+		std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+		std::ostringstream obj;
+		obj << "# generated\nmtllib strips.mtl\n";
+		int faces = 0;
+		for (int s = 0; s < strips; ++s)
+		{
+			for (int i = 0; i <= length; ++i)
+			{
+				obj << "v " << coordinate(random) << " " << coordinate(random) << " " << coordinate(random) << "\n";
+				obj << "v " << coordinate(random) << " " << coordinate(random) << " " << coordinate(random) << "\n";
+				obj << "vt " << coordinate(random) * 0.01f << " " << coordinate(random) * 0.01f << "\n";
+				obj << "vn 0 " << (i % 2 ? "1" : "-1") << " 0\n";
+			}
+			for (int i = 0; i < length; ++i, ++faces)
+			{
+				if (faces % 300 == 299) obj << "usemtl material" << faces / 300 % 4 << "\n";
+				if (brokenFaces && i % 50 == 7)
+				{
+					switch (faces / 50 % 5)
+					{
+					case 0: obj << "f 1 0 2\n"; break;
+					case 1: obj << "f 1 2 " << 2 * (length + 1) * (s + 1) + 1 << "\n"; break;
+					case 2: obj << "f -1 -2 " << -2 * (length + 1) * (s + 1) - 1 << "\n"; break;
+					case 3: obj << "f 1/1/1 2/" << (length + 1) * (s + 1) + 1 << "/1 3/1/1\n"; break;
+					default: obj << "f 1/1/1 2/2/2 3/3/3\n"; break;
+					}
+				}
+				// The corners of the quad between this pair of vertices and the next, counted back from the last ones
+				const int back = 2 * (length - i);
+				const int a = -back - 2, b = -back - 1, c = -back, d = -back + 1;
+				switch (faces % 3)
+				{
+				case 0: obj << "f " << a << " " << b << " " << c << "\n"; break;
+				case 1: obj << "f " << b << "//" << -1 << " " << d << "//" << -1 << " " << c << "//" << -1 << "\n"; break;
+				default: obj << "f\t" << a << "/" << -1 << "/" << -1 << " " << b << "/" << -1 << "/" << -1 << " " << c << "/" << -1 << "/" << -1 << " \r\n"; break;
+				}
+			}
+		}
+		return obj.str();
+	}
+
+	void TestNumbers()
+	{
+		const char* texts[] = { "0", "1.5", "-2.25e2", "+3", "0.000001", "-0.", ".25", "1e-30", "3.4e38", "12345678901234567890123", "0.1234567890123456789012" };
+		for (const char* text : texts)
+		{
+			float value = -1.0f;
+			const char* end = text + strlen(text);
+			CHECK(ObjParser::ParseFloat(text, end, value) == end);
+			const float expected = strtof(text, nullptr);
+			CHECK(std::fabs(value - expected) <= std::fabs(expected) * 1e-6f);
+		}
+
+		// Stops at the first character that is not part of the number
+		float value = 0.0f;
+		const char text[] = "-7.5/2";
+		CHECK(ObjParser::ParseFloat(text, text + 6, value) == text + 4 && value == -7.5f);
+
+		int integer = 0;
+		const char indices[] = "-42/17";
+		CHECK(ObjParser::ParseInt(indices, indices + 6, integer) == indices + 3 && integer == -42);
+		CHECK(ObjParser::ParseInt(indices + 4, indices + 6, integer) == indices + 6 && integer == 17);
+	}
+
+	void TestObj()
+	{
+		ObjData obj;
+		Parse(
+			"# comment\n"
+			"mtllib  model.mtl\n"
+			"v 1 2 3\n"
+			"v 4 5 6\n"
+			"v 7 8 9\r\n"
+			"v 10 11 12\n"
+			"vt 0.25 0.75\n"
+			"vn 0 0 1\n"
+			"f 1 2 3\n"
+			"usemtl first\n"
+			"f 1/1/1 2/1/1 3/1/1\n"
+			"f 4//1 3//1 2//1\n"
+			"usemtl second\n"
+			"f -1/-1 -2/-1 -3/-1 -4/-1\n"
+			"s off\n"
+			"g ignored\n"
+			"f 1 2\n", obj);
+
+		CHECK(obj.MtlLib == "model.mtl");
+		CHECK(obj.Positions.size() == 4 && obj.TexCoords.size() == 1 && obj.Normals.size() == 1);
+		// Into our left-handed space, with v counted from the top
+		CHECK(obj.Positions.size() == 4 && obj.Positions[2].x == 7.0f && obj.Positions[2].y == 8.0f && obj.Positions[2].z == -9.0f);
+		CHECK(obj.TexCoords.size() == 1 && obj.TexCoords[0].x == 0.25f && obj.TexCoords[0].y == 0.25f);
+		CHECK(obj.Normals.size() == 1 && obj.Normals[0].z == -1.0f);
+
+		// Extra corners are dropped and faces with fewer than 3 skipped
+		CHECK(obj.Faces.size() == 4);
+		if (obj.Faces.size() == 4)
+		{
+			CHECK(SameIndex(obj.Faces[0].Corners[0], 1, 0, 0) && !obj.Faces[0].HasNormal);
+			CHECK(SameIndex(obj.Faces[1].Corners[2], 3, 1, 1) && obj.Faces[1].HasNormal);
+			CHECK(SameIndex(obj.Faces[2].Corners[0], 4, 0, 1) && obj.Faces[2].HasNormal);
+			CHECK(SameIndex(obj.Faces[3].Corners[0], 4, 1, 0) && SameIndex(obj.Faces[3].Corners[2], 2, 1, 0));
+		}
+
+		// The faces before the first usemtl belong to it
+		CHECK(obj.Groups.size() == 2);
+		if (obj.Groups.size() == 2)
+		{
+			CHECK(obj.Groups[0].Material == "first" && obj.Groups[0].FirstFace == 0 && obj.Groups[0].FaceCount == 3);
+			CHECK(obj.Groups[1].Material == "second" && obj.Groups[1].FirstFace == 3 && obj.Groups[1].FaceCount == 1);
+		}
+	}
+
+	// Faces are only kept when every index names an attribute declared before them
+	void TestOutOfRange()
+	{
+		ObjData obj;
+		Parse(
+			"v 1 2 3\n"
+			"v 4 5 6\n"
+			"v 7 8 9\n"
+			"vt 0 0\n"
+			"vn 0 0 1\n"
+			"f 1 2 4\n"
+			"f 0 1 2\n"
+			"usemtl first\n"
+			"f -4 -1 -2\n"
+			"f 1/2 2/1 3/1\n"
+			"f 1//2 2//1 3//1\n"
+			"f 1/-3/1 2/1/1 3/1/1\n"
+			"f 3 2 1\n"
+			"usemtl second\n"
+			"f 1 2 5\n"
+			"v 10 11 12\n"
+			"usemtl third\n"
+			"f 1 2 4\n", obj);
+
+		CHECK(obj.Faces.size() == 2);
+		if (obj.Faces.size() == 2)
+		{
+			CHECK(SameIndex(obj.Faces[0].Corners[0], 3, 0, 0));
+			CHECK(SameIndex(obj.Faces[1].Corners[2], 4, 0, 0));
+		}
+		// Groups close over the faces that are left, the first one is renamed as if the broken faces were not there
+		CHECK(obj.Groups.size() == 3);
+		if (obj.Groups.size() == 3)
+		{
+			CHECK(obj.Groups[0].Material == "first" && obj.Groups[0].FirstFace == 0 && obj.Groups[0].FaceCount == 1);
+			CHECK(obj.Groups[1].Material == "second" && obj.Groups[1].FirstFace == 1 && obj.Groups[1].FaceCount == 0);
+			CHECK(obj.Groups[2].Material == "third" && obj.Groups[2].FirstFace == 1 && obj.Groups[2].FaceCount == 1);
+		}
+	}
+
+	// The pieces of the stream parser put together, in pieces of about pieceSize bytes
+	ObjData ParseStream(const std::string& text, size_t pieceSize)
+	{
+		ObjStreamParser stream;
+		ObjData pieces;
+		for (size_t begin = 0; begin < text.size();)
+		{
+			size_t end = std::min(text.size(), begin + pieceSize);
+			while (end < text.size() && text[end - 1] != '\n') ++end;
+			ObjData piece;
+			stream.Parse(text.data() + begin, text.data() + end, piece);
+			pieces.Positions.insert(pieces.Positions.end(), piece.Positions.begin(), piece.Positions.end());
+			pieces.TexCoords.insert(pieces.TexCoords.end(), piece.TexCoords.begin(), piece.TexCoords.end());
+			pieces.Normals.insert(pieces.Normals.end(), piece.Normals.begin(), piece.Normals.end());
+			pieces.Faces.insert(pieces.Faces.end(), piece.Faces.begin(), piece.Faces.end());
+			begin = end;
+		}
+		pieces.Groups = stream.GetGroups();
+		pieces.MtlLib = stream.GetMtlLib();
+		return pieces;
+	}
+
+	void TestParallel()
+	{
+		const std::string text = MakeObj(40, 500);
+		ObjData reference;
+		Parse(text, reference);
+		CHECK(reference.Faces.size() == 40 * 500);
+		CHECK(reference.Groups.size() > 4 && reference.Groups[0].Material == "material0");
+
+		// Chunk borders fall everywhere, relative indices and groups have to come out the same
+		for (unsigned threads : { 2u, 3u, 7u, 16u })
+		{
+			ObjData obj;
+			ObjParser::ParseObjParallel(text.data(), text.data() + text.size(), obj, threads);
+			CHECK(SameObjData(obj, reference));
+		}
+		CHECK(SameObjData(ParseStream(text, 10000), reference));
+
+		// Faces out of range are dropped the same way whichever chunk they are in, while absolute indices into
+		// the chunks before are kept
+		const std::string broken = MakeObj(40, 500, true);
+		ObjData brokenReference;
+		Parse(broken, brokenReference);
+		CHECK(brokenReference.Faces.size() == 40 * 500 + 40 * 10 / 5);
+		for (unsigned threads : { 2u, 3u, 7u, 16u })
+		{
+			ObjData obj;
+			ObjParser::ParseObjParallel(broken.data(), broken.data() + broken.size(), obj, threads);
+			CHECK(SameObjData(obj, brokenReference));
+		}
+		CHECK(SameObjData(ParseStream(broken, 10000), brokenReference));
+		CHECK(SameObjData(ParseStream(broken, 777), brokenReference));
+	}
+
+	void TestMtl()
+	{
+		const std::string text =
+			"Kd 9 9 9\n"
+			"newmtl stone\n"
+			"Ka 0.1 0.2 0.3\n"
+			"Kd 0.5 0.5 0.5\n"
+			"Ks 1 1 1\n"
+			"Ns 32\n"
+			"map_Kd textures/stone.png\n"
+			"map_Bump textures/stone_normal.png\n"
+			"newmtl glass\n"
+			"Ke 0 0 2\n";
+		std::vector<MtlMaterial> materials;
+		ObjParser::ParseMtl(text.data(), text.data() + text.size(), materials);
+		CHECK(materials.size() == 2);
+		if (materials.size() != 2) return;
+
+		const MtlMaterial& stone = materials[0];
+		CHECK(stone.Name == "stone");
+		CHECK(stone.Ambient.x == 0.1f && stone.Ambient.z == 0.3f && stone.Ambient.w == 1.0f);
+		CHECK(stone.Diffuse.x == 0.5f && stone.Specular.y == 1.0f && stone.Shininess == 32.0f);
+		CHECK(stone.DiffuseMap == "textures/stone.png" && stone.NormalMap == "textures/stone_normal.png");
+
+		// Defaults for what is not there
+		const MtlMaterial& glass = materials[1];
+		CHECK(glass.Name == "glass" && glass.Emission.z == 2.0f && glass.Diffuse.x == 0.0f && glass.DiffuseMap.empty());
+
+		const std::string obj = "v 1 2 3\n  mtllib scene.mtl\nmtllib other.mtl\n";
+		CHECK(ObjParser::FindMtlLib(obj.data(), obj.data() + obj.size()) == "scene.mtl");
+	}
+}
+
+int main()
+{
+	TestNumbers();
+	TestObj();
+	TestOutOfRange();
+	TestParallel();
+	TestMtl();
+	return CheckResult("ObjParserTests");
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Scalar stand-in for the part of DirectXMath the device independent code uses, for building the tests where there
+// is no Windows SDK. Same names, types and results as the real library, none of its SIMD.
+namespace DirectX
+{
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMVECTOR
+	{
+		float v[4];
+	};
+	typedef const XMVECTOR& FXMVECTOR;
+
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+	inline XMVECTOR XMVectorZero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+	inline XMVECTOR XMVectorReplicate(float f) { return { { f, f, f, f } }; }
+
+	inline float XMVectorGetX(FXMVECTOR a) { return a.v[0]; }
+	inline float XMVectorGetY(FXMVECTOR a) { return a.v[1]; }
+	inline float XMVectorGetZ(FXMVECTOR a) { return a.v[2]; }
+	inline float XMVectorGetW(FXMVECTOR a) { return a.v[3]; }
+
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* p) { return { { p->x, p->y, p->z, 0.0f } }; }
+	inline void XMStoreFloat4(XMFLOAT4* p, FXMVECTOR a) { *p = XMFLOAT4(a.v[0], a.v[1], a.v[2], a.v[3]); }
+
+	inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b)
+	{
+		return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+	}
+	inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b)
+	{
+		return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+	}
+	inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c)
+	{
+		return { { a.v[0] * b.v[0] + c.v[0], a.v[1] * b.v[1] + c.v[1], a.v[2] * b.v[2] + c.v[2], a.v[3] * b.v[3] + c.v[3] } };
+	}
+	inline XMVECTOR XMVectorScale(FXMVECTOR a, float s) { return { { a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s } }; }
+	// Like minps and maxps: the second operand where either is NaN
+	inline XMVECTOR XMVectorMin(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+		return r;
+	}
+	inline XMVECTOR XMVectorMax(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+		return r;
+	}
+
+	// Comparisons give all bits set where true, Select takes b where control bits are set
+	inline XMVECTOR XMVectorLess(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint32_t mask = a.v[i] < b.v[i] ? ~0u : 0u;
+			memcpy(&r.v[i], &mask, sizeof(mask));
+		}
+		return r;
+	}
+	inline XMVECTOR XMVectorSelect(FXMVECTOR a, FXMVECTOR b, FXMVECTOR control)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; ++i)
+		{
+			uint32_t x, y, c;
+			memcpy(&x, &a.v[i], sizeof(x));
+			memcpy(&y, &b.v[i], sizeof(y));
+			memcpy(&c, &control.v[i], sizeof(c));
+			const uint32_t selected = (x & ~c) | (y & c);
+			memcpy(&r.v[i], &selected, sizeof(selected));
+		}
+		return r;
+	}
+
+	inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]); }
+	inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b)
+	{
+		return { { a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0], 0.0f } };
+	}
+	inline XMVECTOR XMVector3Length(FXMVECTOR a) { return XMVectorReplicate(std::sqrt(XMVectorGetX(XMVector3Dot(a, a)))); }
+	// Zero length stays zero, like the real one
+	inline XMVECTOR XMVector3Normalize(FXMVECTOR a)
+	{
+		const float length = XMVectorGetX(XMVector3Length(a));
+		return length > 0.0f ? XMVectorScale(a, 1.0f / length) : XMVectorZero();
+	}
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "FileSystem.h"
+#include "ObjParser.h"
+#include "RangeAllocator.h"
+
+namespace
+{
+	// Levels of detail MeshCooker::DefaultLodChain aims for, every one with half the triangles of the one before
+	const unsigned LodLevels = 5;
+	const float LodReduction = 0.5f;
+
+	// Vertex and index counts of every group of every OBJ the way Mesh puts them into the arena: its welded vertices,
+	// and the indices of all its levels of detail if simplification reached its targets
+	void AddModelSizes(const std::string& modelFolder, std::vector<uint32_t>& vertexSizes, std::vector<uint32_t>& indexSizes)
+	{
+		for (const std::string& file : ListFiles(modelFolder, ".obj"))
+		{
+			MappedFile mapped;
+			if (!mapped.Open(file)) continue;
+			ObjData obj;
+			ObjParser::ParseObj(mapped.GetData(), mapped.GetEnd(), obj);
+			for (const ObjGroup& group : obj.Groups)
+			{
+				if (group.FaceCount == 0) continue;
+				std::set<std::array<int, 3>> welded;
+				for (size_t f = group.FirstFace; f != group.FirstFace + group.FaceCount; ++f)
+					for (const ObjIndex& corner : obj.Faces[f].Corners)
+						welded.insert({ { corner.Position, corner.TexCoord, corner.Normal } });
+
+				float indexCount = 0.0f;
+				float levelIndices = float(group.FaceCount * 3);
+				for (unsigned l = 0; l != LodLevels; ++l, levelIndices *= LodReduction)
+					indexCount += levelIndices;
+				vertexSizes.push_back(uint32_t(welded.size()));
+				indexSizes.push_back(uint32_t(indexCount));
+			}
+		}
+	}
+
+	// Random allocate and free churn on one allocator, handling a failed allocation the way GeometryArena
+	// does: defragment if the free space is only scattered, grow otherwise
+	void BenchmarkAllocatorChurn(const char* label, const std::vector<uint32_t>& sizes)
+	{
+		const int operations = 200000;
+		const size_t targetLive = 256;
+		std::mt19937 random(740);
+
+		RangeAllocator allocator(1 << 16);
+		std::vector<RangeAllocator::Handle> live;
+		size_t defragments = 0;
+		size_t grows = 0;
+		double fragmentation = 0.0;
+		size_t samples = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (int i = 0; i < operations; ++i)
+		{
+			// Allocate more often below targetLive live ranges, free more often above
+			if (live.empty() || random() % (2 * targetLive) >= live.size())
+			{
+				const uint32_t size = sizes[random() % sizes.size()];
+				RangeAllocator::Handle handle = allocator.Allocate(size);
+				if (handle == RangeAllocator::InvalidHandle)
+				{
+					if (allocator.GetCapacity() - allocator.GetUsed() >= size)
+					{
+						allocator.Defragment();
+						++defragments;
+					}
+					else
+					{
+						allocator.Grow(std::max(allocator.GetCapacity() * 2, allocator.GetUsed() + size));
+						++grows;
+					}
+					handle = allocator.Allocate(size);
+				}
+				live.push_back(handle);
+			}
+			else
+			{
+				const size_t pick = random() % live.size();
+				allocator.Free(live[pick]);
+				live[pick] = live.back();
+				live.pop_back();
+			}
+
+			// Share of the free space outside the largest free range
+			if (i % 1000 == 999)
+			{
+				const uint32_t free = allocator.GetCapacity() - allocator.GetUsed();
+				if (free > 0) fragmentation += 1.0 - double(allocator.GetLargestFreeRange()) / free;
+				++samples;
+			}
+		}
+		const double seconds = SecondsSince(start);
+		const bool churnValid = allocator.Validate();
+
+		std::cout << "  " << label << ": " << seconds * 1e9 / operations << " ns per operation, " << defragments << " defragments, "
+			<< grows << " grows, capacity " << allocator.GetCapacity() << " for " << allocator.GetUsed() << " used, "
+			<< allocator.GetFreeRangeCount() << " free ranges, " << 100.0 * fragmentation / std::max<size_t>(samples, 1)
+			<< "% average fragmentation, " << (churnValid ? "valid" : "INVALID") << "." << std::endl;
+
+		const Clock::time_point defragmentStart = Clock::now();
+		const std::vector<RangeAllocator::Move> moves = allocator.Defragment();
+		const double defragmentSeconds = SecondsSince(defragmentStart);
+		size_t moved = 0;
+		for (const RangeAllocator::Move& move : moves)
+		{
+			if (move.From != move.To) moved += move.Size;
+		}
+
+		std::cout << "    defragment " << live.size() << " allocations: " << defragmentSeconds * 1e6 << " us, " << moves.size()
+			<< " copies moving " << moved << " of " << allocator.GetUsed() << " elements, "
+			<< (allocator.Validate() && allocator.GetFreeRangeCount() <= 1 ? "valid" : "INVALID") << "." << std::endl;
+	}
+}
+
+// Allocate/free churn on the range allocator behind GeometryArena with submesh sized ranges: cost per operation,
+// fragmentation, and what defragmenting costs. The allocator's invariants are checked after the churn and after
+// defragmenting.
+int main(int argc, char* argv[])
+{
+	std::vector<uint32_t> vertexSizes;
+	std::vector<uint32_t> indexSizes;
+	AddModelSizes(GetModelFolder(argc, argv), vertexSizes, indexSizes);
+	const size_t submeshSizes = vertexSizes.size();
+
+	// As many synthetic sizes again, log-uniform from 16 to 64k, so a few models still make a varied mix
+	std::mt19937 random(740);
+	std::uniform_real_distribution<float> exponent(4.0f, 16.0f);
+	for (size_t i = 0; i < std::max<size_t>(submeshSizes, 64); ++i)
+	{
+		const uint32_t vertices = uint32_t(std::exp2(exponent(random)));
+		vertexSizes.push_back(vertices);
+		indexSizes.push_back(vertices * 6);
+	}
+
+	std::cout << "Geometry arena churn with " << submeshSizes << " submesh sizes and " << vertexSizes.size() - submeshSizes
+		<< " synthetic ones." << std::endl;
+	BenchmarkAllocatorChurn("vertices", vertexSizes);
+	BenchmarkAllocatorChurn("indices", indexSizes);
+	return 0;
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "RangeAllocator.h"
+
+namespace
+{
+	typedef RangeAllocator::Handle Handle;
+
+	// A space the allocator's offsets point into, every element holding the handle that owns it. Defragmenting copies
+	// it the way GeometryArena copies its buffers, so a range whose move went wrong no longer reads back its handle.
+	struct Space
+	{
+		std::vector<uint32_t> Elements;
+
+		void Fill(const RangeAllocator& allocator, Handle handle)
+		{
+			Elements.resize(allocator.GetCapacity(), ~0u);
+			std::fill_n(Elements.begin() + allocator.GetOffset(handle), allocator.GetSize(handle), handle);
+		}
+		bool Holds(const RangeAllocator& allocator, Handle handle) const
+		{
+			const auto first = Elements.begin() + allocator.GetOffset(handle);
+			return std::all_of(first, first + allocator.GetSize(handle), [handle](uint32_t e) { return e == handle; });
+		}
+		void Apply(const RangeAllocator& allocator, const std::vector<RangeAllocator::Move>& moves)
+		{
+			std::vector<uint32_t> moved(allocator.GetCapacity(), ~0u);
+			for (const RangeAllocator::Move& move : moves)
+				std::copy_n(Elements.begin() + move.From, move.Size, moved.begin() + move.To);
+			Elements.swap(moved);
+		}
+	};
+
+	void TestAllocate()
+	{
+		RangeAllocator allocator(100);
+		CHECK(allocator.Allocate(0) == RangeAllocator::InvalidHandle);
+		CHECK(allocator.Allocate(101) == RangeAllocator::InvalidHandle);
+
+		const Handle a = allocator.Allocate(10);
+		const Handle b = allocator.Allocate(20);
+		CHECK(a != RangeAllocator::InvalidHandle && b != RangeAllocator::InvalidHandle && a != b);
+		CHECK(allocator.GetOffset(a) == 0 && allocator.GetSize(a) == 10);
+		CHECK(allocator.GetOffset(b) == 10 && allocator.GetSize(b) == 20);
+		CHECK(allocator.GetUsed() == 30);
+		CHECK(allocator.GetAllocationCount() == 2);
+		CHECK(allocator.GetLargestFreeRange() == 70);
+
+		// Everything that is left, then nothing
+		const Handle c = allocator.Allocate(70);
+		CHECK(allocator.GetOffset(c) == 30);
+		CHECK(allocator.GetFreeRangeCount() == 0);
+		CHECK(allocator.Allocate(1) == RangeAllocator::InvalidHandle);
+		CHECK(allocator.Validate());
+
+		// Invalid and freed handles read as empty instead of past the end
+		CHECK(allocator.GetOffset(RangeAllocator::InvalidHandle) == 0 && allocator.GetSize(RangeAllocator::InvalidHandle) == 0);
+		allocator.Free(c);
+		CHECK(allocator.GetSize(c) == 0);
+		allocator.Free(c);
+		allocator.Free(RangeAllocator::InvalidHandle);
+		CHECK(allocator.GetUsed() == 30);
+		CHECK(allocator.Validate());
+	}
+
+	void TestBestFit()
+	{
+		// Free ranges of 30, 10 and 20 between allocations that stay
+		RangeAllocator allocator(100);
+		const Handle h[] = { allocator.Allocate(30), allocator.Allocate(5), allocator.Allocate(10), allocator.Allocate(5), allocator.Allocate(20), allocator.Allocate(30) };
+		allocator.Free(h[0]);
+		allocator.Free(h[2]);
+		allocator.Free(h[4]);
+		CHECK(allocator.GetFreeRangeCount() == 3);
+
+		// The smallest range that fits, whatever its place
+		const Handle a = allocator.Allocate(8);
+		CHECK(allocator.GetOffset(a) == 35);
+		const Handle b = allocator.Allocate(15);
+		CHECK(allocator.GetOffset(b) == 50);
+		const Handle c = allocator.Allocate(25);
+		CHECK(allocator.GetOffset(c) == 0);
+		CHECK(allocator.Validate());
+	}
+
+	void TestCoalesce()
+	{
+		RangeAllocator allocator(40);
+		const Handle a = allocator.Allocate(10);
+		const Handle b = allocator.Allocate(10);
+		const Handle c = allocator.Allocate(10);
+		const Handle d = allocator.Allocate(10);
+
+		// Apart, then merged with the range before, after, and on both sides
+		allocator.Free(a);
+		allocator.Free(c);
+		CHECK(allocator.GetFreeRangeCount() == 2);
+		allocator.Free(b);
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == 30);
+		CHECK(allocator.Validate());
+		allocator.Free(d);
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == 40);
+		CHECK(allocator.GetUsed() == 0 && allocator.GetAllocationCount() == 0);
+		CHECK(allocator.Validate());
+
+		// One range again, so all of it fits
+		const Handle e = allocator.Allocate(40);
+		CHECK(allocator.GetOffset(e) == 0);
+	}
+
+	void TestHandleReuse()
+	{
+		RangeAllocator allocator(100);
+		const Handle a = allocator.Allocate(10);
+		const Handle b = allocator.Allocate(10);
+		allocator.Free(a);
+
+		// A freed handle comes back before new ones are made, for the new range
+		const Handle c = allocator.Allocate(30);
+		CHECK(c == a);
+		CHECK(allocator.GetOffset(c) == 20 && allocator.GetSize(c) == 30);
+		CHECK(allocator.GetOffset(b) == 10);
+		const Handle d = allocator.Allocate(5);
+		CHECK(d != a && d != b);
+		CHECK(allocator.GetAllocationCount() == 3);
+		CHECK(allocator.Validate());
+	}
+
+	void TestGrow()
+	{
+		RangeAllocator empty;
+		CHECK(empty.GetCapacity() == 0 && empty.Allocate(1) == RangeAllocator::InvalidHandle);
+		empty.Grow(16);
+		CHECK(empty.GetOffset(empty.Allocate(16)) == 0);
+
+		RangeAllocator allocator(30);
+		const Handle a = allocator.Allocate(10);
+		const Handle b = allocator.Allocate(15);
+		CHECK(allocator.Allocate(10) == RangeAllocator::InvalidHandle);
+
+		// The 5 free at the end and the new 20 are one range, and allocations keep their offsets
+		allocator.Grow(50);
+		CHECK(allocator.GetCapacity() == 50);
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == 25);
+		CHECK(allocator.GetOffset(a) == 0 && allocator.GetOffset(b) == 10);
+		CHECK(allocator.Validate());
+
+		// Never shrinks
+		allocator.Grow(20);
+		CHECK(allocator.GetCapacity() == 50);
+
+		// Full up to the old end: the new space is a range of its own
+		const Handle c = allocator.Allocate(25);
+		CHECK(allocator.GetOffset(c) == 25);
+		allocator.Grow(60);
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == 10);
+		CHECK(allocator.Validate());
+	}
+
+	void TestDefragment()
+	{
+		RangeAllocator allocator(100);
+		Space space;
+		std::vector<Handle> handles;
+		for (uint32_t size : { 10u, 5u, 20u, 5u, 15u, 10u })
+		{
+			handles.push_back(allocator.Allocate(size));
+			space.Fill(allocator, handles.back());
+		}
+		allocator.Free(handles[1]);
+		allocator.Free(handles[3]);
+		CHECK(allocator.GetLargestFreeRange() == 35);
+
+		const std::vector<RangeAllocator::Move> moves = allocator.Defragment();
+		space.Apply(allocator, moves);
+
+		// Packed in the same order, the first allocation stays and the neighbouring last two move as one
+		CHECK(allocator.GetOffset(handles[0]) == 0);
+		CHECK(allocator.GetOffset(handles[2]) == 10);
+		CHECK(allocator.GetOffset(handles[4]) == 30);
+		CHECK(allocator.GetOffset(handles[5]) == 45);
+		CHECK(moves.size() == 3 && moves[2].From == 40 && moves[2].To == 30 && moves[2].Size == 25);
+		for (Handle h : { handles[0], handles[2], handles[4], handles[5] })
+			CHECK(space.Holds(allocator, h));
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == 45);
+		CHECK(allocator.Validate());
+
+		// Packed already: a single move, everything to where it is
+		const std::vector<RangeAllocator::Move> again = allocator.Defragment();
+		CHECK(again.size() == 1 && again[0].From == again[0].To);
+		CHECK(allocator.GetOffset(handles[5]) == 45);
+
+		// Everything freed leaves one range and no moves
+		for (Handle h : { handles[0], handles[2], handles[4], handles[5] })
+			allocator.Free(h);
+		CHECK(allocator.Defragment().empty());
+		CHECK(allocator.GetFreeRangeCount() == 1 && allocator.Validate());
+	}
+
+	// Random allocate and free churn, with a failed allocation handled the way GeometryArena does: defragment when
+	// the free space is only scattered, grow otherwise. Every live range is checked to still hold its handle after
+	// each defragment, and the bookkeeping to tile the space.
+	void TestChurn()
+	{
+		const int operations = 200000;
+		const size_t targetLive = 256;
+		std::mt19937 random(740);
+		std::uniform_real_distribution<float> exponent(4.0f, 14.0f);
+
+		RangeAllocator allocator(1 << 16);
+		Space space;
+		std::vector<Handle> live;
+		size_t defragments = 0;
+		size_t grows = 0;
+		bool valid = true;
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < operations; ++i)
+		{
+			if (live.empty() || random() % (2 * targetLive) >= live.size())
+			{
+				const uint32_t size = uint32_t(std::exp2(exponent(random)));
+				Handle handle = allocator.Allocate(size);
+				if (handle == RangeAllocator::InvalidHandle)
+				{
+					if (allocator.GetCapacity() - allocator.GetUsed() >= size)
+					{
+						space.Apply(allocator, allocator.Defragment());
+						for (Handle h : live)
+							valid = valid && space.Holds(allocator, h);
+						++defragments;
+					}
+					else
+					{
+						allocator.Grow(std::max(allocator.GetCapacity() * 2, allocator.GetUsed() + size));
+						++grows;
+					}
+					handle = allocator.Allocate(size);
+				}
+				valid = valid && handle != RangeAllocator::InvalidHandle && allocator.GetSize(handle) == size;
+				if (handle == RangeAllocator::InvalidHandle) continue;
+				space.Fill(allocator, handle);
+				live.push_back(handle);
+			}
+			else
+			{
+				const size_t pick = random() % live.size();
+				allocator.Free(live[pick]);
+				live[pick] = live.back();
+				live.pop_back();
+			}
+			if (i % 10000 == 9999)
+				valid = valid && allocator.Validate();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		for (Handle h : live)
+			valid = valid && space.Holds(allocator, h);
+		CHECK(valid);
+		CHECK(defragments > 0 && grows > 0);
+		CHECK(allocator.GetAllocationCount() == live.size());
+		CHECK(allocator.Validate());
+
+		std::cout << "Churn: " << operations << " operations, " << seconds * 1e9 / operations << " ns each with the checks, "
+			<< defragments << " defragments, " << grows << " grows, capacity " << allocator.GetCapacity() << " for "
+			<< allocator.GetUsed() << " used." << std::endl;
+	}
+}
+
+int main()
+{
+	TestAllocate();
+	TestBestFit();
+	TestCoalesce();
+	TestHandleReuse();
+	TestGrow();
+	TestDefragment();
+	TestChurn();
+	return CheckResult("RangeAllocatorTests");
+}
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Check.h"
+#include "TextureResidency.h"
+
+namespace
+{
+	// Stands in for TextureStreamer like the one of BenchmarkTextureStreaming: loads finish latency frames after they
+	// begin, the ones of textures marked to fail fail, and every call is checked against what TextureStreamingDevice
+	// promises
+	class FakeStreamingDevice : public TextureStreamingDevice
+	{
+	public:
+		explicit FakeStreamingDevice(unsigned latency) : valid(true), latency(latency), frame(0) {}
+
+		void AddTexture(uint32_t tail)
+		{
+			resident.push_back(tail);
+			begun.push_back(0);
+			fails.push_back(false);
+			loading.push_back(false);
+			loaded.push_back(~0u);
+		}
+
+		void BeginLoad(int texture, uint32_t firstMip) override
+		{
+			if (loading[texture] || firstMip >= resident[texture]) valid = false;
+			loading[texture] = true;
+			++begun[texture];
+			loads.push_back({ texture, firstMip, frame + latency });
+		}
+
+		void PollLoads(std::vector<TextureLoad>& finished) override
+		{
+			++frame;
+			std::fill(loaded.begin(), loaded.end(), ~0u);
+			for (size_t i = 0; i != loads.size();)
+			{
+				if (loads[i].Due > frame) { ++i; continue; }
+				const bool succeeded = !fails[loads[i].Texture];
+				finished.push_back({ loads[i].Texture, loads[i].FirstMip, succeeded });
+				loading[loads[i].Texture] = false;
+				if (succeeded) loaded[loads[i].Texture] = loads[i].FirstMip;
+				loads[i] = loads.back();
+				loads.pop_back();
+			}
+		}
+
+		void SetResidentMip(int texture, uint32_t firstMip) override
+		{
+			// Finer mips only from a load that finished this frame and brought them
+			if (firstMip < resident[texture] && (loaded[texture] == ~0u || firstMip < loaded[texture])) valid = false;
+			if (loading[texture]) valid = false;
+			resident[texture] = firstMip;
+			loaded[texture] = ~0u;
+		}
+
+		std::vector<uint32_t> resident;
+		std::vector<size_t> begun;
+		std::vector<bool> fails;
+		bool valid;
+
+	private:
+		struct PendingLoad
+		{
+			int Texture;
+			uint32_t FirstMip;
+			uint64_t Due;
+		};
+
+		unsigned latency;
+		uint64_t frame;
+		std::vector<bool> loading;
+		std::vector<uint32_t> loaded;
+		std::vector<PendingLoad> loads;
+	};
+
+	// A square texture of one byte per texel, whose full chain is (4^(mips) - 1) / 3 bytes
+	std::vector<size_t> MakeMipBytes(uint32_t size)
+	{
+		std::vector<size_t> mipBytes;
+		for (uint32_t s = size; ; s /= 2)
+		{
+			mipBytes.push_back(size_t(s) * s);
+			if (s == 1) break;
+		}
+		return mipBytes;
+	}
+
+	int AddTexture(TextureResidency& residency, FakeStreamingDevice& device, uint32_t size, uint32_t coarsestFirstMip = ~0u)
+	{
+		const int texture = residency.Add(size, size, MakeMipBytes(size), coarsestFirstMip);
+		device.AddTexture(residency.GetTailMip(texture));
+		return texture;
+	}
+
+	// Resident bytes as the device has them, which have to be what TextureResidency counts
+	size_t GetDeviceBytes(const TextureResidency& residency, const FakeStreamingDevice& device)
+	{
+		size_t bytes = 0;
+		for (size_t t = 0; t != device.resident.size(); ++t)
+			bytes += residency.GetBytes(int(t), device.resident[t]);
+		return bytes;
+	}
+
+	void TestDesiredMip()
+	{
+		// A texel for every pixel at least, so the mip a texture shown at a quarter of its size wants is 2
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 11, 1024.0f) == 0);
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 11, 4096.0f) == 0);
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 11, 256.0f) == 2);
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 512, 11, 300.0f) == 1);
+		// Clamped to the chain, and the coarsest mip when not seen at all
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 5, 1.0f) == 4);
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 11, 0.0f) == 10);
+		CHECK(TextureResidency::ComputeDesiredMip(1024, 1024, 0, 100.0f) == 0);
+	}
+
+	void TestAdd()
+	{
+		const TextureStreamingSettings settings = { size_t(1) << 40, 64, 4, 5, 0.1f };
+		FakeStreamingDevice device(2);
+		TextureResidency residency(device, settings);
+
+		// The tail starts at the first mip of 64 texels, or at the coarsest one the device can make
+		const int a = AddTexture(residency, device, 1024);
+		const int b = AddTexture(residency, device, 1024, 2);
+		const int c = AddTexture(residency, device, 32);
+		CHECK(residency.GetTailMip(a) == 4 && residency.GetResidentMip(a) == 4 && residency.GetTargetMip(a) == 4);
+		CHECK(residency.GetTailMip(b) == 2);
+		CHECK(residency.GetTailMip(c) == 0);
+
+		// Bytes of a mip and all the coarser ones
+		CHECK(residency.GetBytes(a, 0) == (size_t(1) << 22) / 3 && residency.GetBytes(a, 10) == 1 && residency.GetBytes(a, 11) == 0);
+		CHECK(residency.GetBytes(a, 4) == 4096 + 1024 + 256 + 64 + 16 + 4 + 1);
+	}
+
+	void TestLoadAndEvict()
+	{
+		const TextureStreamingSettings settings = { size_t(1) << 40, 64, 4, 5, 0.1f };
+		FakeStreamingDevice device(2);
+		TextureResidency residency(device, settings);
+		const int texture = AddTexture(residency, device, 1024);
+
+		// Seen up close: mip 0 loads in one go and is resident once the device has it
+		residency.Request(texture, 1024.0f, 1000.0f);
+		residency.Update();
+		CHECK(residency.GetDesiredMip(texture) == 0 && residency.GetTargetMip(texture) == 0);
+		CHECK(device.begun[texture] == 1 && residency.GetStats().LoadsInFlight == 1);
+		CHECK(residency.GetResidentMip(texture) == 4);
+		int frames = 1;
+		while (residency.GetResidentMip(texture) != 0 && frames < 10)
+		{
+			residency.Request(texture, 1024.0f, 1000.0f);
+			residency.Update();
+			++frames;
+		}
+		CHECK(residency.GetResidentMip(texture) == 0 && device.resident[texture] == 0);
+		CHECK(frames == 3 && residency.GetStats().Loaded == 1 && residency.GetStats().LoadsInFlight == 0);
+		CHECK(residency.GetStats().ResidentBytes == residency.GetBytes(texture, 0));
+
+		// Farther away it drops to mip 2 at once, without a load
+		residency.Request(texture, 256.0f, 60.0f);
+		residency.Update();
+		CHECK(residency.GetResidentMip(texture) == 2 && device.resident[texture] == 2 && residency.GetStats().Evicted == 1);
+		CHECK(device.begun[texture] == 1);
+
+		// Not requested, it keeps its mips for KeepFrames frames, then drops to the tail
+		for (unsigned f = 0; f != settings.KeepFrames; ++f)
+		{
+			residency.Update();
+			CHECK(residency.GetResidentMip(texture) == 2);
+		}
+		residency.Update();
+		CHECK(residency.GetResidentMip(texture) == 4 && device.resident[texture] == 4);
+		CHECK(device.valid);
+	}
+
+	void TestBudget()
+	{
+		// Four textures of 1024 texels, 5592404 bytes with all their mips, 1398100 from mip 1 down and 5461 of tails
+		TextureStreamingSettings settings = { 1600000, 64, 4, 5, 0.1f };
+		FakeStreamingDevice device(2);
+		TextureResidency residency(device, settings);
+		for (int t = 0; t != 4; ++t)
+			AddTexture(residency, device, 1024);
+		const auto run = [&](int frames)
+		{
+			bool withinBudget = true;
+			for (int f = 0; f != frames; ++f)
+			{
+				for (int t = 0; t != 4; ++t)
+					residency.Request(t, 1024.0f, 1000.0f * (t + 1));
+				residency.Update();
+				const size_t bytes = GetDeviceBytes(residency, device);
+				withinBudget = withinBudget && bytes == residency.GetStats().ResidentBytes && bytes <= residency.GetSettings().BudgetBytes;
+			}
+			return withinBudget;
+		};
+
+		// Mip 0 of all of them does not fit, mip 1 does, with too little left to take any of them a mip finer
+		CHECK(run(20));
+		const TextureStreamingStats& stats = residency.GetStats();
+		CHECK(stats.MipBias == 1 && stats.Boosted == 0 && stats.DesiredBytes == 4 * residency.GetBytes(0, 0));
+		CHECK(stats.LoadsInFlight == 0 && stats.PendingRequests == 0);
+		for (int t = 0; t != 4; ++t)
+			CHECK(residency.GetResidentMip(t) == 1);
+
+		// Room for one more mip 0 within the hysteresis: the largest on screen gets it
+		settings.BudgetBytes = 2800000;
+		residency.SetSettings(settings);
+		CHECK(run(20));
+		CHECK(stats.MipBias == 1 && stats.Boosted == 1);
+		CHECK(residency.GetResidentMip(3) == 0);
+		for (int t = 0; t != 3; ++t)
+			CHECK(residency.GetResidentMip(t) == 1);
+
+		// Everything would fit, but not with the hysteresis to spare, so the bias stays
+		settings.BudgetBytes = 5800000;
+		residency.SetSettings(settings);
+		CHECK(run(20));
+		CHECK(stats.MipBias == 1);
+
+		settings.BudgetBytes = 6300000;
+		residency.SetSettings(settings);
+		CHECK(run(20));
+		CHECK(stats.MipBias == 0 && stats.LoadsInFlight == 0 && stats.PendingRequests == 0);
+		for (int t = 0; t != 4; ++t)
+			CHECK(residency.GetResidentMip(t) == 0);
+
+		// Less than the tails: nothing loads, and whatever is above them goes
+		settings.BudgetBytes = 1000;
+		residency.SetSettings(settings);
+		run(1);
+		CHECK(stats.MipBias == 4 && stats.ResidentBytes == 4 * residency.GetBytes(0, 4));
+		CHECK(device.valid);
+	}
+
+	void TestLoadLimit()
+	{
+		// Two loads at a time, the largest on screen first
+		const TextureStreamingSettings settings = { size_t(1) << 40, 64, 2, 5, 0.1f };
+		FakeStreamingDevice device(5);
+		TextureResidency residency(device, settings);
+		for (int t = 0; t != 5; ++t)
+			AddTexture(residency, device, 256);
+		for (int t = 0; t != 5; ++t)
+			residency.Request(t, 256.0f, float(t));
+		residency.Update();
+		CHECK(residency.GetStats().LoadsInFlight == 2 && residency.GetStats().PendingRequests == 3);
+		CHECK(device.begun[4] == 1 && device.begun[3] == 1 && device.begun[0] == 0);
+		CHECK(device.valid);
+	}
+
+	void TestFailedLoad()
+	{
+		const TextureStreamingSettings settings = { size_t(1) << 40, 64, 4, 5, 0.1f };
+		FakeStreamingDevice device(1);
+		TextureResidency residency(device, settings);
+		const int texture = AddTexture(residency, device, 512);
+		device.fails[texture] = true;
+
+		// A load that failed keeps the tail and is not tried again
+		for (int f = 0; f != 10; ++f)
+		{
+			residency.Request(texture, 512.0f, 100.0f);
+			residency.Update();
+			if (f == 1) CHECK(residency.GetStats().Failed == 1);
+		}
+		CHECK(device.begun[texture] == 1);
+		CHECK(residency.GetResidentMip(texture) == residency.GetTailMip(texture));
+		CHECK(residency.GetStats().PendingRequests == 0 && residency.GetStats().LoadsInFlight == 0);
+		CHECK(device.valid);
+	}
+
+	struct FlythroughRun
+	{
+		size_t PeakDesired;
+		size_t TailBytes;
+		size_t Loads;
+		uint32_t MaxBias;
+		// Resident bytes never above the budget, or the tails when they alone are over it
+		bool WithinBudget;
+		bool DeviceValid;
+		// Once the camera stops everything reaches its target and the queue empties
+		bool Settled;
+	};
+
+	// The camera of BenchmarkTextureStreaming flying down a row of textured objects and stopping halfway back
+	FlythroughRun RunFlythrough(const std::vector<uint32_t>& sizes, size_t budget)
+	{
+		const int moveFrames = 600;
+		const int settleFrames = 200;
+		const int objectCount = 160;
+		const float spacing = 3.0f;
+		const float farPlane = 60.0f;
+
+		const TextureStreamingSettings settings = { budget, 64, 4, 30, 0.1f };
+		FakeStreamingDevice device(3);
+		TextureResidency residency(device, settings);
+		// Block compressed devices cannot make mips under 4 texels
+		for (uint32_t size : sizes)
+			AddTexture(residency, device, size, uint32_t(std::log2(size)) - 2);
+
+		FlythroughRun run = {};
+		run.WithinBudget = true;
+		for (size_t t = 0; t != sizes.size(); ++t)
+			run.TailBytes += residency.GetBytes(int(t), residency.GetTailMip(int(t)));
+
+		const float rowLength = spacing * objectCount;
+		for (int frame = 0; frame != moveFrames + settleFrames; ++frame)
+		{
+			const float camera = frame < moveFrames ? -20.0f + (rowLength + 40.0f) * frame / moveFrames : rowLength * 0.5f;
+			for (int o = 0; o != objectCount; ++o)
+			{
+				const float distance = o * spacing - camera;
+				if (distance <= 0.0f || distance > farPlane) continue;
+				const float projectedRadius = 600.0f / std::max(distance, 1.0f);
+				residency.Request(int((o * 7) % sizes.size()), projectedRadius, 3.14159265f * projectedRadius * projectedRadius);
+			}
+			residency.Update();
+
+			const TextureStreamingStats& stats = residency.GetStats();
+			const size_t resident = GetDeviceBytes(residency, device);
+			run.WithinBudget = run.WithinBudget && resident == stats.ResidentBytes && resident <= std::max(budget, run.TailBytes);
+			run.PeakDesired = std::max(run.PeakDesired, stats.DesiredBytes);
+			run.Loads += stats.Loaded;
+			run.MaxBias = std::max(run.MaxBias, stats.MipBias);
+		}
+		run.DeviceValid = device.valid;
+
+		const TextureStreamingStats& last = residency.GetStats();
+		run.Settled = last.LoadsInFlight == 0 && last.PendingRequests == 0;
+		for (size_t t = 0; t != sizes.size(); ++t)
+			run.Settled = run.Settled && device.resident[t] == residency.GetTargetMip(int(t)) && residency.GetResidentMip(int(t)) == device.resident[t];
+		return run;
+	}
+
+	// Budgets from none to less than the tails: never over budget, only valid device calls and settled at the end
+	void TestFlythrough()
+	{
+		std::vector<uint32_t> sizes;
+		for (int t = 0; t != 96; ++t)
+			sizes.push_back(256u << (t % 4));
+
+		const FlythroughRun unlimited = RunFlythrough(sizes, size_t(1) << 40);
+		CHECK(unlimited.WithinBudget && unlimited.DeviceValid && unlimited.Settled);
+		CHECK(unlimited.MaxBias == 0 && unlimited.Loads > 0);
+		for (size_t budget : { unlimited.PeakDesired / 2, unlimited.PeakDesired / 8, unlimited.TailBytes / 2 })
+		{
+			const FlythroughRun run = RunFlythrough(sizes, budget);
+			CHECK(run.WithinBudget && run.DeviceValid && run.Settled);
+			CHECK(run.MaxBias > 0);
+			std::cout << "Flythrough with a budget of " << budget << " bytes: " << run.Loads << " loads, mip bias up to " << run.MaxBias << "." << std::endl;
+		}
+	}
+}
+
+int main()
+{
+	TestDesiredMip();
+	TestAdd();
+	TestLoadAndEvict();
+	TestBudget();
+	TestLoadLimit();
+	TestFailedLoad();
+	TestFlythrough();
+	return CheckResult("TextureResidencyTests");
+}
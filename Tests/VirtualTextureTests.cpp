@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "VirtualTexture.h"
+
+namespace
+{
+	bool SameEntry(const VirtualPageEntry& entry, uint32_t slot, uint8_t mip)
+	{
+		return entry.Slot == slot && entry.Mip == mip;
+	}
+
+	// Loads finished in the order Update started them
+	void CompleteAll(VirtualTextureCache& cache, std::vector<VirtualPageLoad>& loads)
+	{
+		for (const VirtualPageLoad& load : loads)
+			cache.CompleteLoad(load, true);
+		loads.clear();
+	}
+
+	// One frame sampling these pages, with its loads finished before the next
+	void Frame(VirtualTextureCache& cache, const std::vector<VirtualPageId>& feedback)
+	{
+		std::vector<VirtualPageLoad> loads;
+		cache.Update(feedback.data(), feedback.size(), loads);
+		CompleteAll(cache, loads);
+	}
+
+	void TestPageId()
+	{
+		const VirtualPageId id = VirtualTextureCache::MakePageId(513, 7, 1000000, 3);
+		const VirtualPage page = VirtualTextureCache::GetPage(id);
+		CHECK(page.Texture == 513 && page.Mip == 7 && page.X == 1000000 && page.Y == 3);
+		// Sorted by texture, then mip, then row
+		CHECK(VirtualTextureCache::MakePageId(0, 1, 0, 0) > VirtualTextureCache::MakePageId(0, 0, 5, 5));
+		CHECK(VirtualTextureCache::MakePageId(1, 0, 0, 0) > VirtualTextureCache::MakePageId(0, 9, 0, 0));
+	}
+
+	void TestPageTable()
+	{
+		// 5 by 3 pages round up to 3 by 2, 2 by 1 and 1 by 1
+		VirtualPageTable table(5, 3);
+		CHECK(table.GetMipCount() == 4);
+		CHECK(table.GetPagesX(1) == 3 && table.GetPagesY(1) == 2 && table.GetPagesX(2) == 2 && table.GetPagesY(2) == 1);
+		CHECK(SameEntry(table.GetEntry(0, 4, 2), VirtualPageTable::NoSlot, VirtualPageTable::NoMip));
+		CHECK(table.GetDirtyMips() == 0);
+
+		// The root covers everything
+		table.Map(3, 0, 0, 0);
+		CHECK(SameEntry(table.GetEntry(0, 4, 2), 0, 3) && SameEntry(table.GetEntry(2, 1, 0), 0, 3));
+		CHECK(table.GetDirtyMips() == 0xf);
+		table.ClearDirty();
+
+		// A mip 1 page covers the four under it and nothing else, a finer one only itself
+		table.Map(1, 1, 0, 5);
+		CHECK(SameEntry(table.GetEntry(0, 2, 0), 5, 1) && SameEntry(table.GetEntry(0, 3, 1), 5, 1));
+		CHECK(SameEntry(table.GetEntry(0, 1, 1), 0, 3) && SameEntry(table.GetEntry(0, 2, 2), 0, 3));
+		CHECK(table.GetDirtyMips() == 0x3);
+		table.Map(0, 2, 0, 6);
+		CHECK(SameEntry(table.GetEntry(0, 2, 0), 6, 0) && SameEntry(table.GetEntry(0, 3, 0), 5, 1));
+		CHECK(table.GetResidentSlot(0, 2, 0) == 6 && table.GetResidentSlot(0, 3, 0) == VirtualPageTable::NoSlot);
+		CHECK(table.Validate());
+
+		// Unmapping falls back to the next resident ancestor, and a coarser page mapped later does not cover a finer one
+		table.Unmap(1, 1, 0);
+		CHECK(SameEntry(table.GetEntry(0, 2, 0), 6, 0) && SameEntry(table.GetEntry(0, 3, 1), 0, 3));
+		table.Map(2, 1, 0, 7);
+		CHECK(SameEntry(table.GetEntry(0, 2, 0), 6, 0) && SameEntry(table.GetEntry(0, 4, 2), 7, 2) && SameEntry(table.GetEntry(1, 2, 1), 7, 2));
+		CHECK(table.Validate());
+
+		// Random maps and unmaps against the brute force check, the edge pages of odd sizes included
+		std::mt19937 random(740);
+		std::vector<std::vector<uint32_t>> resident(table.GetMipCount());
+		for (uint32_t m = 0; m != table.GetMipCount(); ++m)
+			for (uint32_t y = 0; y != table.GetPagesY(m); ++y)
+				for (uint32_t x = 0; x != table.GetPagesX(m); ++x)
+					resident[m].push_back(table.GetResidentSlot(m, x, y));
+		bool valid = true;
+		for (uint32_t i = 0; i != 2000; ++i)
+		{
+			const uint32_t m = random() % table.GetMipCount();
+			const uint32_t x = random() % table.GetPagesX(m);
+			const uint32_t y = random() % table.GetPagesY(m);
+			uint32_t& slot = resident[m][y * table.GetPagesX(m) + x];
+			if (slot == VirtualPageTable::NoSlot)
+			{
+				slot = 100 + i;
+				table.Map(m, x, y, slot);
+			}
+			else
+			{
+				slot = VirtualPageTable::NoSlot;
+				table.Unmap(m, x, y);
+			}
+			valid = valid && table.Validate();
+		}
+		CHECK(valid);
+	}
+
+	const VirtualTextureSettings SmallSettings = { 128, 4, 16, 4, 8, 8 };
+
+	void TestLoads()
+	{
+		VirtualTextureCache cache(SmallSettings, 1000);
+		// 8 by 8 pages, 4 mips
+		const uint32_t texture = cache.AddTexture(1024, 1000);
+		CHECK(cache.GetPageTable(texture).GetMipCount() == 4);
+		CHECK(cache.GetSlotX(5) == 136 && cache.GetSlotY(5) == 136);
+
+		// The root comes first, before any feedback, in slot 0
+		std::vector<VirtualPageLoad> loads;
+		cache.Update(nullptr, 0, loads);
+		CHECK(loads.size() == 1 && loads[0].Page == VirtualTextureCache::MakePageId(texture, 3, 0, 0) && loads[0].Slot == 0);
+		CHECK(cache.GetStats().LoadsInFlight == 1 && cache.Validate());
+		CompleteAll(cache, loads);
+		CHECK(cache.Validate());
+
+		// A mip 0 page wants its missing ancestors too, coarsest first
+		const std::vector<VirtualPageId> feedback(3, VirtualTextureCache::MakePageId(texture, 0, 5, 6));
+		cache.Update(feedback.data(), feedback.size(), loads);
+		CHECK(loads.size() == 3);
+		if (loads.size() == 3)
+		{
+			CHECK(loads[0].Page == VirtualTextureCache::MakePageId(texture, 2, 1, 1));
+			CHECK(loads[1].Page == VirtualTextureCache::MakePageId(texture, 1, 2, 3));
+			CHECK(loads[2].Page == feedback[0]);
+		}
+		CHECK(cache.GetStats().Requested == 1 && cache.GetStats().Hits == 0);
+		// Sampling the root meanwhile
+		CHECK(SameEntry(cache.GetPageTable(texture).GetEntry(0, 5, 6), 0, 3));
+		CHECK(cache.Validate());
+		CompleteAll(cache, loads);
+		CHECK(cache.Validate());
+
+		// Now a hit, with the finished loads counted
+		cache.Update(feedback.data(), feedback.size(), loads);
+		CHECK(loads.empty());
+		CHECK(cache.GetStats().Requested == 1 && cache.GetStats().Hits == 1 && cache.GetStats().LoadsFinished == 3);
+		CHECK(cache.GetStats().ResidentPages == 4 && cache.GetStats().ResidentBytes == 4000);
+		CHECK(cache.GetPageTable(texture).GetEntry(0, 5, 6).Mip == 0);
+
+		// Pages that do not exist are ignored
+		const std::vector<VirtualPageId> invalid = { VirtualTextureCache::MakePageId(texture, 0, 8, 0), VirtualTextureCache::MakePageId(texture, 4, 0, 0),
+			VirtualTextureCache::MakePageId(texture + 1, 0, 0, 0) };
+		cache.Update(invalid.data(), invalid.size(), loads);
+		CHECK(loads.empty() && cache.GetStats().Requested == 0);
+
+		// All of mip 1, asked for more the further down and right: the three missing mip 2 pages come first, the one
+		// covering the most asked for pages before the others, then the mip 1 page asked for most. At most
+		// MaxLoadsPerFrame of the 18 start.
+		std::vector<VirtualPageId> many;
+		for (uint32_t x = 0; x != 4; ++x)
+			for (uint32_t y = 0; y != 4; ++y)
+				many.insert(many.end(), 1 + x + 4 * y, VirtualTextureCache::MakePageId(texture, 1, x, y));
+		cache.Update(many.data(), many.size(), loads);
+		CHECK(loads.size() == SmallSettings.MaxLoadsPerFrame);
+		if (loads.size() == SmallSettings.MaxLoadsPerFrame)
+		{
+			CHECK(loads[0].Page == VirtualTextureCache::MakePageId(texture, 2, 0, 1));
+			CHECK(loads[1].Page == VirtualTextureCache::MakePageId(texture, 2, 1, 0));
+			CHECK(loads[2].Page == VirtualTextureCache::MakePageId(texture, 2, 0, 0));
+			CHECK(loads[3].Page == VirtualTextureCache::MakePageId(texture, 1, 3, 3));
+		}
+		CHECK(cache.GetStats().Requested == 16 && cache.GetStats().Hits == 1);
+		CHECK(cache.GetStats().Pending == 18 - SmallSettings.MaxLoadsPerFrame);
+		CHECK(cache.Validate());
+	}
+
+	void TestEviction()
+	{
+		// The root and three pages fit
+		const VirtualTextureSettings settings = { 128, 4, 4, 2, 8, 8 };
+		VirtualTextureCache cache(settings, 1000);
+		const uint32_t texture = cache.AddTexture(256, 256);
+		const VirtualPageId a = VirtualTextureCache::MakePageId(texture, 0, 0, 0);
+		const VirtualPageId b = VirtualTextureCache::MakePageId(texture, 0, 1, 0);
+		const VirtualPageId c = VirtualTextureCache::MakePageId(texture, 0, 0, 1);
+		const VirtualPageId d = VirtualTextureCache::MakePageId(texture, 0, 1, 1);
+		const VirtualPageTable& table = cache.GetPageTable(texture);
+		Frame(cache, { a });
+		Frame(cache, { b });
+		Frame(cache, { c });
+		CHECK(cache.GetStats().ResidentPages == 3);
+		const uint32_t slotA = table.GetResidentSlot(0, 0, 0);
+
+		// The least recently used page makes room, and what sampled it falls back to the root
+		std::vector<VirtualPageLoad> loads;
+		const std::vector<VirtualPageId> one = { d };
+		cache.Update(one.data(), one.size(), loads);
+		CHECK(cache.GetStats().Evicted == 1 && loads.size() == 1 && loads[0].Slot == slotA);
+		CHECK(table.GetResidentSlot(0, 0, 0) == VirtualPageTable::NoSlot && SameEntry(table.GetEntry(0, 0, 0), 0, 1));
+		CompleteAll(cache, loads);
+		CHECK(cache.Validate());
+
+		// b was seen most recently, so c goes before it
+		Frame(cache, { b });
+		Frame(cache, { a });
+		CHECK(table.GetResidentSlot(0, 1, 0) != VirtualPageTable::NoSlot && table.GetResidentSlot(0, 0, 1) == VirtualPageTable::NoSlot);
+
+		// Every page seen this frame stays: the one that does not fit waits
+		const std::vector<VirtualPageId> all = { a, b, c, d };
+		cache.Update(all.data(), all.size(), loads);
+		CHECK(loads.empty() && cache.GetStats().Starved == 1 && cache.GetStats().Pending == 1 && cache.GetStats().Hits == 3);
+		CHECK(cache.GetStats().Evicted == 0);
+
+		// The root is never evicted, whatever the pressure
+		CHECK(table.GetResidentSlot(1, 0, 0) == 0);
+		CHECK(cache.Validate());
+	}
+
+	void TestFailedLoad()
+	{
+		VirtualTextureCache cache(SmallSettings, 1000);
+		const uint32_t texture = cache.AddTexture(512, 512);
+		Frame(cache, {});
+
+		// A failed load frees its slot and the page is asked for again by the next feedback
+		const std::vector<VirtualPageId> feedback = { VirtualTextureCache::MakePageId(texture, 1, 1, 1) };
+		std::vector<VirtualPageLoad> loads;
+		cache.Update(feedback.data(), feedback.size(), loads);
+		CHECK(loads.size() == 1);
+		for (const VirtualPageLoad& load : loads)
+			cache.CompleteLoad(load, false);
+		loads.clear();
+		CHECK(cache.GetPageTable(texture).GetResidentSlot(1, 1, 1) == VirtualPageTable::NoSlot);
+		CHECK(cache.Validate());
+		cache.Update(feedback.data(), feedback.size(), loads);
+		CHECK(loads.size() == 1 && cache.GetStats().LoadsFinished == 1);
+		CompleteAll(cache, loads);
+		CHECK(cache.GetPageTable(texture).GetResidentSlot(1, 1, 1) != VirtualPageTable::NoSlot);
+		CHECK(cache.Validate());
+	}
+
+	// Random feedback of several textures through a cache too small for it, with loads that finish a few frames
+	// later or fail. The slots, recency list and page tables have to agree after every frame.
+	void TestChurn()
+	{
+		const VirtualTextureSettings settings = { 128, 4, 64, 8, 16, 24 };
+		VirtualTextureCache cache(settings, 1000);
+		for (uint32_t size : { 4096u, 2048u, 1000u, 8192u })
+			cache.AddTexture(size, size);
+
+		std::mt19937 random(740);
+		std::vector<VirtualPageLoad> inFlight;
+		std::vector<VirtualPageLoad> loads;
+		std::vector<VirtualPageId> feedback;
+		bool valid = true;
+		size_t hits = 0;
+		size_t evicted = 0;
+		size_t starved = 0;
+		for (int frame = 0; frame != 2000; ++frame)
+		{
+			// A view that drifts over the pages of one texture at a time, at a mip that changes slowly
+			feedback.clear();
+			const uint32_t texture = uint32_t(frame / 250) % 4;
+			const VirtualPageTable& table = cache.GetPageTable(texture);
+			const uint32_t mip = std::min(uint32_t(frame / 50) % 3, table.GetMipCount() - 1);
+			const uint32_t centerX = uint32_t(frame) % table.GetPagesX(mip);
+			for (int i = 0; i != 200; ++i)
+			{
+				const uint32_t m = std::min(mip + uint32_t(random() % 2), table.GetMipCount() - 1);
+				const uint32_t x = std::min((centerX >> (m - mip)) + uint32_t(random() % 4), table.GetPagesX(m) - 1);
+				const uint32_t y = uint32_t(random()) % table.GetPagesY(m);
+				feedback.push_back(VirtualTextureCache::MakePageId(texture, m, x, y));
+			}
+
+			cache.Update(feedback.data(), feedback.size(), loads);
+			valid = valid && cache.Validate();
+			inFlight.insert(inFlight.end(), loads.begin(), loads.end());
+			loads.clear();
+			const VirtualTextureStats& stats = cache.GetStats();
+			valid = valid && stats.ResidentPages + stats.LoadsInFlight <= settings.PhysicalPages && stats.LoadsInFlight <= settings.MaxLoadsInFlight;
+			hits += stats.Hits;
+			evicted += stats.Evicted;
+			starved += stats.Starved > 0;
+
+			// Some of the loads finish, one in twenty of them failing
+			for (size_t i = 0; i != inFlight.size();)
+			{
+				if (random() % 3 != 0) { ++i; continue; }
+				cache.CompleteLoad(inFlight[i], random() % 20 != 0);
+				inFlight[i] = inFlight.back();
+				inFlight.pop_back();
+			}
+			valid = valid && cache.Validate();
+		}
+		CompleteAll(cache, inFlight);
+		CHECK(valid);
+		CHECK(cache.Validate());
+		CHECK(hits > 0 && evicted > 0);
+
+		// Whatever the churn, the roots are resident in the end
+		Frame(cache, {});
+		Frame(cache, {});
+		for (uint32_t t = 0; t != 4; ++t)
+		{
+			const VirtualPageTable& table = cache.GetPageTable(t);
+			CHECK(table.GetEntry(0, 0, 0).Slot != VirtualPageTable::NoSlot);
+		}
+
+		std::cout << "Churn: " << hits << " hits, " << evicted << " evictions, " << starved << " frames starved." << std::endl;
+	}
+}
+
+int main()
+{
+	TestPageId();
+	TestPageTable();
+	TestLoads();
+	TestEviction();
+	TestFailedLoad();
+	TestChurn();
+	return CheckResult("VirtualTextureTests");
+}